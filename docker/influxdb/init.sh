@@ -0,0 +1,43 @@
+#!/bin/bash
+# Bucket'ы агрегатов и задачи прореживания для power_monitoring.
+#
+# Образ influxdb:2.7 выполняет скрипты из /docker-entrypoint-initdb.d один раз,
+# после первичной настройки (DOCKER_INFLUXDB_INIT_MODE=setup). На уже
+# настроенной базе запустить вручную:
+#   docker exec influxdb /docker-entrypoint-initdb.d/init.sh
+# Повторный запуск ничего не дублирует.
+
+set -e
+
+ORG="${DOCKER_INFLUXDB_INIT_ORG:-home}"
+TASKS_DIR="${POWER_TASKS_DIR:-/etc/power-monitoring/tasks}"
+
+# Сырые данные (power_monitoring) — 30 дней, создаются при setup.
+# Поминутные — 400 дней, часовые — бессрочно.
+create_bucket() {
+    local name="$1"
+    local retention="$2"
+    if influx bucket list --org "$ORG" --name "$name" >/dev/null 2>&1; then
+        echo "[init] Bucket $name exists"
+    else
+        influx bucket create --org "$ORG" --name "$name" --retention "$retention"
+        echo "[init] Bucket $name created (retention $retention)"
+    fi
+}
+
+create_task() {
+    local name="$1"
+    local file="$2"
+    if influx task list --org "$ORG" --hide-headers | grep -qw "$name"; then
+        echo "[init] Task $name exists"
+    else
+        influx task create --org "$ORG" --file "$file" >/dev/null
+        echo "[init] Task $name created from $(basename "$file")"
+    fi
+}
+
+create_bucket power_monitoring_1m 400d
+create_bucket power_monitoring_1h 0
+
+create_task power_downsample_1m "$TASKS_DIR/downsample_1m.flux"
+create_task power_downsample_1h "$TASKS_DIR/downsample_1h.flux"
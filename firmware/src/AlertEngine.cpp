@@ -0,0 +1,231 @@
+#include "AlertEngine.h"
+#include <stdio.h>
+#include <string.h>
+#include "LineProtocol.h"
+
+static const AlertRule defaultRules[] = ALERT_RULES;
+
+static const char* const phaseNames[3] = {"A", "B", "C"};
+
+AlertEngine::AlertEngine()
+    : ruleCount(0),
+      transitionCount(0),
+      lastUpdateMs(0),
+      primed(false) {
+    static_assert(sizeof(defaultRules) / sizeof(defaultRules[0]) <= ALERT_MAX_RULES,
+                  "ALERT_RULES has more than ALERT_MAX_RULES rules");
+    setRules(defaultRules, sizeof(defaultRules) / sizeof(defaultRules[0]));
+}
+
+bool AlertEngine::setRules(const AlertRule* rules, int count) {
+    if (count < 0 || count > ALERT_MAX_RULES) {
+        return false;
+    }
+    // Порог снятия — по ту же сторону, что норма
+    for (int r = 0; r < count; r++) {
+        if (rules[r].direction == ALERT_ABOVE ? rules[r].clearAt > rules[r].raiseAt
+                                              : rules[r].clearAt < rules[r].raiseAt) {
+            return false;
+        }
+    }
+    memcpy(this->rules, rules, sizeof(AlertRule) * count);
+    memset(states, 0, sizeof(states));
+    ruleCount = count;
+    primed = false;
+    return true;
+}
+
+int AlertEngine::update(const PowerData& data, int phases, uint32_t nowMs, AlertEvent* events) {
+    const float voltages[3] = {data.voltageA, data.voltageB, data.voltageC};
+
+    // После долгого перерыва непрерывность значения неизвестна — отсчёты заново
+    if (primed && nowMs - lastUpdateMs > ALERT_MAX_GAP_MS) {
+        for (int r = 0; r < ruleCount; r++) {
+            for (int p = 0; p < 3; p++) {
+                states[r][p].pending = false;
+            }
+        }
+    }
+    lastUpdateMs = nowMs;
+    primed = true;
+
+    int count = 0;
+
+    // Сначала пропажа фаз: в одном измерении её переход идёт первым, а
+    // остальные правила уже знают, какие фазы живы
+    bool lost[3] = {false, false, false};
+    for (int r = 0; r < ruleCount; r++) {
+        if (rules[r].metric != ALERT_PHASE_LOSS) {
+            continue;
+        }
+        for (int p = 0; p < phases; p++) {
+            if (evaluate(r, p, voltages[p], true, nowMs, events[count])) {
+                count++;
+            }
+            lost[p] = lost[p] || states[r][p].active;
+        }
+    }
+    int liveCount = 0;
+    for (int p = 0; p < phases; p++) {
+        lost[p] = lost[p] || voltages[p] < PHASE_LOSS_THRESHOLD;
+        liveCount += lost[p] ? 0 : 1;
+    }
+
+    for (int r = 0; r < ruleCount; r++) {
+        const AlertRule& rule = rules[r];
+        switch (rule.metric) {
+            case ALERT_PHASE_VOLTAGE:
+                for (int p = 0; p < phases; p++) {
+                    if (evaluate(r, p, voltages[p], !lost[p], nowMs, events[count])) {
+                        count++;
+                    }
+                }
+                break;
+            case ALERT_FREQUENCY:
+                if (evaluate(r, 0, data.frequencyAvg, liveCount > 0 && data.frequencyAvg > 0.0f, nowMs,
+                             events[count])) {
+                    count++;
+                }
+                break;
+            case ALERT_UNBALANCE:
+                // Перекос при пропавшей фазе — следствие, о нём уже сказал phase_loss
+                if (evaluate(r, 0, data.unbalance, phases == 3 && liveCount == phases, nowMs, events[count])) {
+                    count++;
+                }
+                break;
+            case ALERT_PHASE_LOSS:
+                break;
+        }
+    }
+    return count;
+}
+
+bool AlertEngine::evaluate(int rule, int phase, float value, bool valid, uint32_t nowMs, AlertEvent& event) {
+    const AlertRule& r = rules[rule];
+    State& state = states[rule][phase];
+    if (!valid) {
+        state.pending = false;
+        return false;
+    }
+
+    bool beyond = r.direction == ALERT_ABOVE ? value > r.raiseAt : value < r.raiseAt;
+    bool back = r.direction == ALERT_ABOVE ? value <= r.clearAt : value >= r.clearAt;
+    bool moving = state.active ? back : beyond;
+    if (!moving) {
+        state.pending = false;
+        return false;
+    }
+    if (!state.pending) {
+        state.pending = true;
+        state.sinceMs = nowMs;
+    }
+    uint32_t heldMs = nowMs - state.sinceMs;
+    if (heldMs < (state.active ? r.clearAfterMs : r.raiseAfterMs)) {
+        return false;
+    }
+
+    state.pending = false;
+    state.active = !state.active;
+    if (state.active) {
+        state.onsetMs = state.sinceMs;
+    }
+    event.seq = ++transitionCount;
+    event.timeMs = nowMs;
+    event.rule = (uint8_t)rule;
+    event.phase = isPerPhase(r) ? (int8_t)phase : (int8_t)-1;
+    event.active = state.active;
+    event.value = value;
+    event.durationMs = state.active ? heldMs : nowMs - state.onsetMs;
+    return true;
+}
+
+bool AlertEngine::isActive(int rule, int phase) const {
+    if (rule < 0 || rule >= ruleCount) {
+        return false;
+    }
+    return states[rule][isPerPhase(rules[rule]) ? phase : 0].active;
+}
+
+int AlertEngine::getActiveCount() const {
+    int count = 0;
+    for (int r = 0; r < ruleCount; r++) {
+        for (int p = 0; p < 3; p++) {
+            count += states[r][p].active ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+uint32_t AlertEngine::getTransitionCount() const {
+    return transitionCount;
+}
+
+int AlertEngine::getRuleCount() const {
+    return ruleCount;
+}
+
+const AlertRule& AlertEngine::getRule(int index) const {
+    return rules[index];
+}
+
+bool AlertEngine::isPerPhase(const AlertRule& rule) {
+    return rule.metric == ALERT_PHASE_VOLTAGE || rule.metric == ALERT_PHASE_LOSS;
+}
+
+const char* AlertEngine::severityName(AlertSeverity severity) {
+    return severity == ALERT_CRITICAL ? "critical" : "warning";
+}
+
+const char* AlertEngine::phaseName(int phase) {
+    return phase >= 0 && phase < 3 ? phaseNames[phase] : nullptr;
+}
+
+/**
+ * Знаков после запятой для значения правила
+ */
+static int decimalsOf(const AlertRule& rule) {
+    return rule.metric == ALERT_FREQUENCY ? 3 : 2;
+}
+
+size_t AlertEngine::writeJson(const AlertEvent& event, const char* deviceId, uint32_t unixTime,
+                              char* buffer, size_t size) const {
+    const AlertRule& rule = rules[event.rule];
+    int decimals = decimalsOf(rule);
+    char phase[16] = "";
+    if (event.phase >= 0) {
+        snprintf(phase, sizeof(phase), ",\"phase\":\"%s\"", phaseName(event.phase));
+    }
+    char time[24] = "";
+    if (unixTime != 0) {
+        snprintf(time, sizeof(time), ",\"time\":%lu", (unsigned long)unixTime);
+    }
+    int length = snprintf(buffer, size,
+                          "{\"device\":\"%s\",\"seq\":%lu,\"alert\":\"%s\",\"state\":\"%s\",\"severity\":\"%s\"%s,"
+                          "\"value\":%.*f,\"raise_at\":%.*f,\"clear_at\":%.*f,\"duration_ms\":%lu,\"uptime_ms\":%lu%s}",
+                          deviceId, (unsigned long)event.seq, rule.name, event.active ? "raised" : "cleared",
+                          severityName(rule.severity), phase, decimals, event.value, decimals, rule.raiseAt,
+                          decimals, rule.clearAt, (unsigned long)event.durationMs, (unsigned long)event.timeMs, time);
+    return length > 0 && (size_t)length < size ? (size_t)length : 0;
+}
+
+size_t AlertEngine::writeLineProtocol(const AlertEvent* events, int count,
+                                      char* buffer, size_t size, const char* deviceId) const {
+    LineWriter out(buffer, size);
+    for (int i = 0; i < count; i++) {
+        const AlertEvent& e = events[i];
+        const AlertRule& rule = rules[e.rule];
+        out.begin("alert");
+        out.tag("device", deviceId);
+        out.tag("rule", rule.name);
+        out.tag("severity", severityName(rule.severity));
+        if (e.phase >= 0) {
+            out.tag("phase", phaseName(e.phase));
+        }
+        out.field("active", (uint32_t)(e.active ? 1 : 0));
+        out.field("value", e.value, decimalsOf(rule));
+        out.field("duration_ms", e.durationMs);
+        out.field("seq", e.seq);
+        out.end();
+    }
+    return out.overflowed() ? 0 : out.length();
+}
@@ -0,0 +1,178 @@
+#ifndef ALERT_ENGINE_H
+#define ALERT_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "PowerData.h"
+
+// Величина правила
+enum AlertMetric : uint8_t {
+    ALERT_PHASE_VOLTAGE,    // Напряжение каждой фазы, В
+    ALERT_PHASE_LOSS,       // Напряжение каждой фазы, В; пропавшая фаза снимается с остальных правил
+    ALERT_FREQUENCY,        // Средняя частота, Гц
+    ALERT_UNBALANCE         // Перекос фаз, %
+};
+
+enum AlertDirection : uint8_t {
+    ALERT_ABOVE,            // Тревога, когда значение выше порога
+    ALERT_BELOW             // Тревога, когда значение ниже порога
+};
+
+enum AlertSeverity : uint8_t {
+    ALERT_WARNING,
+    ALERT_CRITICAL
+};
+
+/**
+ * Правило тревоги (таблица ALERT_RULES в config.h)
+ */
+struct AlertRule {
+    const char* name;           // Имя в уведомлении и теге rule
+    AlertMetric metric;
+    AlertDirection direction;
+    AlertSeverity severity;
+    float raiseAt;              // Порог срабатывания
+    float clearAt;              // Порог снятия; между ними — гистерезис, состояние не меняется
+    uint32_t raiseAfterMs;      // Сколько значение непрерывно за порогом до тревоги
+    uint32_t clearAfterMs;      // Сколько значение непрерывно за порогом снятия до отбоя
+};
+
+// Больше переходов за одно измерение не бывает: каждое правило на каждой фазе
+#define ALERT_MAX_EVENTS (ALERT_MAX_RULES * 3)
+
+// Точки alert на все переходы одного измерения, DEVICE_ID до 32 символов
+#define ALERT_LINE_PROTOCOL_SIZE (ALERT_MAX_EVENTS * 160)
+
+// Уведомление webhook: один переход в JSON
+#define ALERT_PAYLOAD_SIZE 320
+
+/**
+ * Переход тревоги: поднята или снята
+ */
+struct AlertEvent {
+    uint32_t seq;               // Сквозной номер перехода с запуска: пропуск у получателя — потерянное уведомление
+    uint32_t timeMs;            // Время измерения (как передано в update)
+    uint8_t rule;               // Индекс правила
+    int8_t phase;               // 0..2 для напряжений фаз, -1 для остальных
+    bool active;                // true — поднята, false — снята
+    float value;                // Значение в измерении перехода
+    uint32_t durationMs;        // Поднята: сколько значение было за порогом; снята: сколько длилась тревога
+};
+
+/**
+ * Тревоги по правилам с гистерезисом и минимальной длительностью
+ *
+ * На каждое правило (и каждую фазу для напряжений) — состояние: тревога
+ * поднимается, когда значение непрерывно за raiseAt не меньше raiseAfterMs,
+ * и снимается, когда оно непрерывно за clearAt не меньше clearAfterMs.
+ * Значение между порогами (гистерезис) сбрасывает идущий отсчёт, но не
+ * меняет состояние: напряжение, колеблющееся около 242 В, поднимает тревогу
+ * один раз, а не каждую секунду. Отсчёт идёт по времени измерений, поэтому
+ * при измерении раз в секунду 3000 мс — это четыре измерения подряд.
+ *
+ * Пропавшая фаза (ниже PHASE_LOSS_THRESHOLD или с активным phase_loss)
+ * сообщается только правилами ALERT_PHASE_LOSS: её правила напряжения и
+ * правило перекоса замирают до её возвращения, правила частоты работают,
+ * пока есть хоть одна живая фаза.
+ *
+ * Переносимый, без выделений памяти; одно измерение — O(правил × фаз).
+ */
+class AlertEngine {
+public:
+    /**
+     * С правилами ALERT_RULES
+     */
+    AlertEngine();
+
+    /**
+     * Заменить правила (копируются; имена должны жить дольше движка).
+     * Все тревоги сбрасываются без переходов.
+     * @return false если правил больше ALERT_MAX_RULES или порог снятия по ту же
+     *         сторону от порога срабатывания, что и тревога
+     */
+    bool setRules(const AlertRule* rules, int count);
+
+    /**
+     * Оценить измерение
+     * @param data Результат измерения
+     * @param phases Фаз в схеме (PowerAnalyzer::PHASES)
+     * @param nowMs Время измерения, мс (монотонное)
+     * @param events Куда записать переходы (ALERT_MAX_EVENTS)
+     * @return Записано переходов
+     */
+    int update(const PowerData& data, int phases, uint32_t nowMs, AlertEvent* events);
+
+    /**
+     * Поднята ли тревога
+     * @param phase 0..2 для правил фаз, для остальных — любое
+     */
+    bool isActive(int rule, int phase) const;
+
+    /**
+     * Поднятых тревог сейчас
+     */
+    int getActiveCount() const;
+
+    /**
+     * Переходов с начала работы
+     */
+    uint32_t getTransitionCount() const;
+
+    int getRuleCount() const;
+    const AlertRule& getRule(int index) const;
+
+    /**
+     * Правило по фазам (ALERT_PHASE_VOLTAGE, ALERT_PHASE_LOSS)
+     */
+    static bool isPerPhase(const AlertRule& rule);
+
+    static const char* severityName(AlertSeverity severity);
+
+    /**
+     * "A", "B", "C"; nullptr для -1
+     */
+    static const char* phaseName(int phase);
+
+    /**
+     * Уведомление webhook:
+     * {"device":..,"seq":..,"alert":..,"state":"raised|cleared","severity":..,
+     *  "phase":..,"value":..,"raise_at":..,"clear_at":..,"duration_ms":..,
+     *  "uptime_ms":..,"time":..}
+     * @param unixTime Секунды UTC (0 если время не синхронизировано — поле опускается)
+     * @return Длина записанного, 0 если не поместилось
+     */
+    size_t writeJson(const AlertEvent& event, const char* deviceId, uint32_t unixTime,
+                     char* buffer, size_t size) const;
+
+    /**
+     * Точки alert (теги rule, severity, phase); время ставит сервер — отправлять сразу
+     * @return Длина записанного, 0 если не поместилось
+     */
+    size_t writeLineProtocol(const AlertEvent* events, int count,
+                             char* buffer, size_t size, const char* deviceId) const;
+
+private:
+    struct State {
+        bool active;
+        bool pending;           // Идёт отсчёт до подъёма или снятия
+        uint32_t sinceMs;       // Начало отсчёта
+        uint32_t onsetMs;       // Когда значение ушло за порог (для длительности тревоги)
+    };
+
+    AlertRule rules[ALERT_MAX_RULES];
+    State states[ALERT_MAX_RULES][3];
+    int ruleCount;
+    uint32_t transitionCount;
+    uint32_t lastUpdateMs;
+    bool primed;
+
+    /**
+     * Шаг одного состояния
+     * @param valid false — величина не определена: состояние замирает, отсчёт сбрасывается
+     * @return Записан ли переход
+     */
+    bool evaluate(int rule, int phase, float value, bool valid, uint32_t nowMs, AlertEvent& event);
+};
+
+#endif // ALERT_ENGINE_H
@@ -0,0 +1,133 @@
+#include "AlertNotifier.h"
+#include <stdio.h>
+#include <string.h>
+#include "hal/Hal.h"
+
+#define PIN_NAMESPACE "alert"
+#define PIN_KEY "pin"
+
+AlertNotifier::AlertNotifier()
+    : enabled(false),
+      head(0),
+      tail(0),
+      attempts(0),
+      nextAttemptMs(0) {
+    path[0] = '\0';
+    headers[0] = '\0';
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool AlertNotifier::begin(const char* url, const char* extraHeaders) {
+    enabled = false;
+    if (url == nullptr || url[0] == '\0') {
+        return true;
+    }
+    if (!connection.begin(url, HTTP_TIMEOUT_MS)) {
+        Hal::log("[Alerts] Webhook: %s\n", connection.getLastError());
+        return false;
+    }
+
+    // Путь после host[:port]; без него — корень
+    const char* hostStart = strstr(url, "://");
+    const char* pathStart = hostStart != nullptr ? strchr(hostStart + 3, '/') : nullptr;
+    int pathLength = snprintf(path, sizeof(path), "%s", pathStart != nullptr ? pathStart : "/");
+    int headersLength = snprintf(headers, sizeof(headers), "Content-Type: application/json\r\n%s",
+                                 extraHeaders != nullptr ? extraHeaders : "");
+    if (pathLength >= (int)sizeof(path) || headersLength >= (int)sizeof(headers)) {
+        Hal::log("[Alerts] Webhook path or headers too long\n");
+        return false;
+    }
+
+    connection.usePinStorage(PIN_NAMESPACE, PIN_KEY, ALERT_WEBHOOK_TRUST_FIRST_KEY);
+    connection.setIdleTimeout(ALERT_WEBHOOK_KEEPALIVE_IDLE_MS);
+    enabled = true;
+    return true;
+}
+
+bool AlertNotifier::isEnabled() const {
+    return enabled;
+}
+
+bool AlertNotifier::enqueue(const char* payload, size_t length) {
+    uint32_t position = head.load(std::memory_order_relaxed);
+    if (length > ALERT_PAYLOAD_SIZE || position - tail.load(std::memory_order_acquire) >= ALERT_QUEUE_SIZE) {
+        stats.dropped++;
+        return false;
+    }
+    Slot& slot = slots[position % ALERT_QUEUE_SIZE];
+    memcpy(slot.payload, payload, length);
+    slot.length = (uint16_t)length;
+    slot.queuedUs = Hal::micros();
+    head.store(position + 1, std::memory_order_release);
+    stats.queued++;
+    return true;
+}
+
+uint32_t AlertNotifier::service() {
+    for (;;) {
+        uint32_t position = tail.load(std::memory_order_relaxed);
+        if (position == head.load(std::memory_order_acquire)) {
+            return ALERT_NOTIFY_IDLE;
+        }
+        uint32_t now = Hal::millis();
+        if (attempts > 0 && (int32_t)(nextAttemptMs - now) > 0) {
+            return nextAttemptMs - now;
+        }
+
+        const Slot& slot = slots[position % ALERT_QUEUE_SIZE];
+        int code = connection.request("POST", path, headers, slot.payload, slot.length);
+        attempts++;
+        if (code >= 200 && code < 300) {
+            uint32_t latencyUs = Hal::micros() - slot.queuedUs;
+            stats.lastLatencyUs = latencyUs;
+            stats.maxLatencyUs = latencyUs > stats.maxLatencyUs ? latencyUs : stats.maxLatencyUs;
+            stats.delivered++;
+            pop();
+            continue;
+        }
+        // Запрос отклонён как есть — повтор ничего не изменит
+        if (code >= 400 && code < 500 && code != 408 && code != 429) {
+            Hal::log("[Alerts] Webhook rejected notification: HTTP %d %s\n", code, connection.getLastBody());
+            stats.rejected++;
+            pop();
+            continue;
+        }
+        if (attempts >= ALERT_MAX_ATTEMPTS) {
+            Hal::log("[Alerts] Webhook notification dropped after %d attempts\n", ALERT_MAX_ATTEMPTS);
+            stats.expired++;
+            pop();
+            continue;
+        }
+
+        uint32_t delayMs = ALERT_RETRY_MS;
+        for (uint32_t i = 1; i < attempts && delayMs < ALERT_RETRY_MAX_MS; i++) {
+            delayMs *= 2;
+        }
+        delayMs = delayMs < ALERT_RETRY_MAX_MS ? delayMs : ALERT_RETRY_MAX_MS;
+        nextAttemptMs = Hal::millis() + delayMs;
+        stats.retries++;
+        if (code < 0) {
+            Hal::log("[Alerts] Webhook: %s, retry in %lu ms\n", connection.getLastError(), (unsigned long)delayMs);
+        } else {
+            Hal::log("[Alerts] Webhook: HTTP %d, retry in %lu ms\n", code, (unsigned long)delayMs);
+        }
+        return delayMs;
+    }
+}
+
+void AlertNotifier::pop() {
+    attempts = 0;
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+uint32_t AlertNotifier::pending() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+const AlertNotifierStats& AlertNotifier::getStats() const {
+    return stats;
+}
+
+const HttpConnection& AlertNotifier::getConnection() const {
+    return connection;
+}
@@ -0,0 +1,113 @@
+#ifndef ALERT_NOTIFIER_H
+#define ALERT_NOTIFIER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "config.h"
+#include "AlertEngine.h"
+#include "HttpConnection.h"
+
+// service(): очередь пуста, ждать следующего enqueue()
+#define ALERT_NOTIFY_IDLE UINT32_MAX
+
+#define ALERT_WEBHOOK_PATH_SIZE 128
+#define ALERT_WEBHOOK_HEADERS_SIZE 256
+
+/**
+ * Счётчики уведомлений. queued/dropped пишет задача измерений, остальные —
+ * задача уведомлений.
+ */
+struct AlertNotifierStats {
+    uint32_t queued;            // Поставлено в очередь
+    uint32_t dropped;           // Очередь была полна — не поставлено
+    uint32_t delivered;         // Получатель ответил 2xx
+    uint32_t rejected;          // Получатель ответил 4xx (кроме 408 и 429) — не повторяется
+    uint32_t expired;           // ALERT_MAX_ATTEMPTS попыток без 2xx
+    uint32_t retries;           // Повторных попыток
+    uint32_t lastLatencyUs;     // От постановки в очередь до ответа 2xx
+    uint32_t maxLatencyUs;
+};
+
+/**
+ * Доставка переходов тревог на webhook (POST JSON)
+ *
+ * Очередь на ALERT_QUEUE_SIZE уведомлений без блокировок: один писатель
+ * (задача измерений, enqueue) и один читатель (задача уведомлений, service),
+ * как FrequencyTracker. Уведомления уходят строго по порядку: первое в
+ * очереди повторяется с экспоненциальной задержкой (ALERT_RETRY_MS,
+ * удваивается до ALERT_RETRY_MAX_MS), следующие ждут за ним, чтобы отбой не
+ * пришёл раньше тревоги. Полная очередь отбрасывает новое уведомление —
+ * получатель увидит пропуск в seq.
+ *
+ * Соединение одно и постоянное (HttpConnection): на уведомление не тратится
+ * ни подключение, ни рукопожатие TLS, пока сервер держит соединение.
+ * Переносимый: на хосте проверяется bench --alert-sim.
+ */
+class AlertNotifier {
+public:
+    AlertNotifier();
+
+    /**
+     * @param url http(s)://host[:port]/path; пустая строка — уведомления выключены
+     * @param headers Дополнительные заголовки, каждый с \r\n (или "")
+     * @return false если URL не разобран
+     */
+    bool begin(const char* url, const char* headers);
+
+    bool isEnabled() const;
+
+    /**
+     * Поставить уведомление в очередь (только задача измерений)
+     * @return false если очередь полна или уведомление длиннее ALERT_PAYLOAD_SIZE
+     */
+    bool enqueue(const char* payload, size_t length);
+
+    /**
+     * Отправить уведомления, чей срок пришёл (только задача уведомлений;
+     * блокируется на время запросов)
+     * @return Миллисекунд до следующей попытки, ALERT_NOTIFY_IDLE если очередь пуста
+     */
+    uint32_t service();
+
+    /**
+     * Уведомлений в очереди
+     */
+    uint32_t pending() const;
+
+    const AlertNotifierStats& getStats() const;
+
+    /**
+     * Соединение (только для чтения статистики)
+     */
+    const HttpConnection& getConnection() const;
+
+private:
+    struct Slot {
+        char payload[ALERT_PAYLOAD_SIZE];
+        uint16_t length;
+        uint32_t queuedUs;
+    };
+
+    HttpConnection connection;
+    char path[ALERT_WEBHOOK_PATH_SIZE];
+    char headers[ALERT_WEBHOOK_HEADERS_SIZE];
+    bool enabled;
+
+    Slot slots[ALERT_QUEUE_SIZE];
+    std::atomic<uint32_t> head;     // Пишет enqueue()
+    std::atomic<uint32_t> tail;     // Пишет service()
+
+    // Первое в очереди (только service())
+    uint32_t attempts;
+    uint32_t nextAttemptMs;
+
+    AlertNotifierStats stats;
+
+    /**
+     * Убрать первое уведомление из очереди
+     */
+    void pop();
+};
+
+#endif // ALERT_NOTIFIER_H
@@ -0,0 +1,245 @@
+#include "AnomalyDetector.h"
+#include <math.h>
+#include <string.h>
+#include "LineProtocol.h"
+
+#define DAY_S 86400
+#define SLOT_S (DAY_S / ANOMALY_SLOTS)
+
+// Единиц фиксированной точки на вольт и на герц
+static const int32_t VOLTAGE_SCALE = 100;
+static const int32_t FREQUENCY_SCALE = 10000;
+
+// Пороги в сигмах, Q8
+static const int32_t CUSUM_K = (int32_t)(ANOMALY_CUSUM_K * 256);
+static const int32_t CUSUM_H = (int32_t)(ANOMALY_CUSUM_H * 256);
+static const int32_t SPIKE_Z = (int32_t)(ANOMALY_SPIKE_Z * 256);
+static const int32_t CLIP_Z = (int32_t)(ANOMALY_CLIP_Z * 256);
+
+static const uint32_t BASELINE_WEIGHT = 1u << ANOMALY_BASELINE_SHIFT;
+static const uint32_t WINDOW_WEIGHT = BASELINE_WEIGHT / ANOMALY_WINDOW_S;
+
+static const char* const metricNames[ANOMALY_METRICS] = {
+    "voltage_a", "voltage_b", "voltage_c", "frequency"
+};
+
+static int32_t scaleOf(AnomalyMetric metric) {
+    return metric == ANOMALY_FREQUENCY ? FREQUENCY_SCALE : VOLTAGE_SCALE;
+}
+
+/**
+ * Нижняя граница дисперсии (Q16): шум, которого детектор не различает
+ */
+static int64_t minVarianceOf(AnomalyMetric metric) {
+    int64_t sigma = metric == ANOMALY_FREQUENCY
+                        ? (int64_t)(ANOMALY_MIN_SIGMA_HZ * FREQUENCY_SCALE * 256)
+                        : (int64_t)(ANOMALY_MIN_SIGMA_V * VOLTAGE_SCALE * 256);
+    return sigma * sigma;
+}
+
+/**
+ * Целая часть квадратного корня
+ */
+static uint32_t isqrt64(uint64_t value) {
+    uint64_t result = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)result;
+}
+
+static int64_t clip(int64_t value, int64_t limit) {
+    return value > limit ? limit : (value < -limit ? -limit : value);
+}
+
+AnomalyDetector::AnomalyDetector()
+    : eventCount(0) {
+    memset(tracks, 0, sizeof(tracks));
+}
+
+int AnomalyDetector::update(const PowerData& data, int phases, uint32_t timeS, AnomalyEvent* events) {
+    int count = 0;
+    const float voltages[3] = {data.voltageA, data.voltageB, data.voltageC};
+    for (int p = 0; p < phases; p++) {
+        // Потеря фазы — не аномалия напряжения: её отмечает checkThresholds()
+        if (voltages[p] >= PHASE_LOSS_THRESHOLD) {
+            int32_t value = (int32_t)lroundf(voltages[p] * VOLTAGE_SCALE);
+            count += updateTrack((AnomalyMetric)p, value, timeS, events + count);
+        }
+    }
+    if (data.frequencyAvg > 0.0f) {
+        int32_t value = (int32_t)lroundf(data.frequencyAvg * FREQUENCY_SCALE);
+        count += updateTrack(ANOMALY_FREQUENCY, value, timeS, events + count);
+    }
+    eventCount += count;
+    return count;
+}
+
+int AnomalyDetector::updateTrack(AnomalyMetric metric, int32_t value, uint32_t timeS, AnomalyEvent* events) {
+    Track& track = tracks[metric];
+    const int64_t minVariance = minVarianceOf(metric);
+    const int32_t x = value << 8;
+
+    uint32_t daySecond = timeS % DAY_S;
+    int index = daySecond / SLOT_S;
+    Slot& slot = track.slots[index];
+    if (slot.count == 0) {
+        slot.mean = x;
+        slot.variance = minVariance;
+        slot.windowVariance = minVariance;
+    }
+    bool ready = slot.count >= ANOMALY_WARMUP;
+
+    // Ожидаемое значение: между серединами этого и соседнего часа
+    int32_t offset = (int32_t)(daySecond % SLOT_S) - SLOT_S / 2;
+    const Slot& neighbour = track.slots[(index + (offset < 0 ? ANOMALY_SLOTS - 1 : 1)) % ANOMALY_SLOTS];
+    int32_t expected = slot.mean;
+    if (ready && neighbour.count >= ANOMALY_WARMUP) {
+        expected += (int32_t)((int64_t)(neighbour.mean - slot.mean) * (offset < 0 ? -offset : offset) / SLOT_S);
+    }
+
+    int64_t sigma = isqrt64(slot.variance > minVariance ? slot.variance : minVariance);
+    int64_t residual = (int64_t)x - expected;
+    int count = 0;
+
+    const float scale = (float)scaleOf(metric) * 256.0f;
+    if (ready && (residual < 0 ? -residual : residual) * 256 > SPIKE_Z * sigma) {
+        AnomalyEvent& e = events[count++];
+        e.timeS = timeS;
+        e.metric = metric;
+        e.kind = AnomalyKind::SPIKE;
+        e.score = (float)(residual < 0 ? -residual : residual) / sigma;
+        e.value = x / scale;
+        e.baseline = expected / scale;
+        e.sigma = sigma / scale;
+        // В окно и в базовую линию всплеск не входит целиком
+        residual = clip(residual, sigma * SPIKE_Z / 256);
+    }
+
+    // Базовая линия часа: пока измерений мало — простое среднее, затем EWMA
+    uint32_t weight = slot.count < BASELINE_WEIGHT ? slot.count + 1 : BASELINE_WEIGHT;
+    int64_t learnLimit = ready ? sigma * CLIP_Z / 256 : INT32_MAX;
+    int64_t deviation = clip((int64_t)x - slot.mean, learnLimit);
+    int64_t learned = clip(residual, learnLimit);
+    slot.mean += (int32_t)(deviation / (int64_t)weight);
+    slot.variance += (learned * learned - slot.variance) / (int64_t)weight;
+    if (slot.count < UINT32_MAX) {
+        slot.count++;
+    }
+
+    // Окно закрыто: шаг CUSUM по среднему остатку
+    track.windowSum += residual;
+    if (++track.windowCount < ANOMALY_WINDOW_S) {
+        return count;
+    }
+    int64_t mean = track.windowSum / track.windowCount;
+    track.windowSum = 0;
+    track.windowCount = 0;
+
+    int64_t windowSigma = isqrt64(slot.windowVariance > minVariance / ANOMALY_WINDOW_S
+                                      ? slot.windowVariance
+                                      : minVariance / ANOMALY_WINDOW_S);
+    uint32_t windowWeight = slot.count / ANOMALY_WINDOW_S < WINDOW_WEIGHT ? slot.count / ANOMALY_WINDOW_S + 1
+                                                                          : WINDOW_WEIGHT;
+    int64_t learnedMean = ready ? clip(mean, windowSigma * CLIP_Z / 256) : mean;
+    slot.windowVariance += (learnedMean * learnedMean - slot.windowVariance) / (int64_t)windowWeight;
+
+    if (!ready) {
+        track.cusumUp = track.cusumDown = 0;
+        track.activeUp = track.activeDown = false;
+        return count;
+    }
+
+    int32_t z = (int32_t)clip(mean * 256 / windowSigma, INT32_MAX / 4);
+    int32_t up = track.cusumUp + z - CUSUM_K;
+    int32_t down = track.cusumDown - z - CUSUM_K;
+    track.cusumUp = up > 0 ? up : 0;
+    track.cusumDown = down > 0 ? down : 0;
+
+    bool fired[2] = {false, false};
+    bool* active[2] = {&track.activeUp, &track.activeDown};
+    int32_t* cusum[2] = {&track.cusumUp, &track.cusumDown};
+    for (int side = 0; side < 2; side++) {
+        if (*cusum[side] > CUSUM_H) {
+            // Пока отклонение идёт, статистика не растёт выше порога: конец виден сразу
+            *cusum[side] = CUSUM_H;
+            fired[side] = !*active[side];
+            *active[side] = true;
+        } else if (*cusum[side] == 0) {
+            *active[side] = false;
+        }
+        if (fired[side]) {
+            AnomalyEvent& e = events[count++];
+            e.timeS = timeS;
+            e.metric = metric;
+            e.kind = side == 0 ? AnomalyKind::SHIFT_UP : AnomalyKind::SHIFT_DOWN;
+            e.score = (float)(mean < 0 ? -mean : mean) / windowSigma;
+            e.value = (expected + mean) / scale;
+            e.baseline = expected / scale;
+            e.sigma = windowSigma / scale;
+        }
+    }
+    return count;
+}
+
+bool AnomalyDetector::isActive(AnomalyMetric metric) const {
+    return tracks[metric].activeUp || tracks[metric].activeDown;
+}
+
+bool AnomalyDetector::isWarmedUp(AnomalyMetric metric) const {
+    for (int s = 0; s < ANOMALY_SLOTS; s++) {
+        if (tracks[metric].slots[s].count < ANOMALY_WARMUP) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t AnomalyDetector::getEventCount() const {
+    return eventCount;
+}
+
+const char* AnomalyDetector::metricName(AnomalyMetric metric) {
+    return metric < ANOMALY_METRICS ? metricNames[metric] : "unknown";
+}
+
+const char* AnomalyDetector::kindName(AnomalyKind kind) {
+    switch (kind) {
+        case AnomalyKind::SPIKE:
+            return "spike";
+        case AnomalyKind::SHIFT_UP:
+            return "shift_up";
+        case AnomalyKind::SHIFT_DOWN:
+            return "shift_down";
+    }
+    return "unknown";
+}
+
+size_t AnomalyDetector::writeLineProtocol(const AnomalyEvent* events, int count,
+                                          char* buffer, size_t size, const char* deviceId) {
+    LineWriter out(buffer, size);
+    for (int i = 0; i < count; i++) {
+        const AnomalyEvent& e = events[i];
+        int decimals = e.metric == ANOMALY_FREQUENCY ? 3 : 2;
+        out.begin("anomaly");
+        out.tag("device", deviceId);
+        out.tag("metric", metricName(e.metric));
+        out.tag("kind", kindName(e.kind));
+        out.field("score", e.score, 1);
+        out.field("value", e.value, decimals);
+        out.field("baseline", e.baseline, decimals);
+        out.field("sigma", e.sigma, 3);
+        out.end();
+    }
+    return out.overflowed() ? 0 : out.length();
+}
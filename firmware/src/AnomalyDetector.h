@@ -0,0 +1,136 @@
+#ifndef ANOMALY_DETECTOR_H
+#define ANOMALY_DETECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "PowerData.h"
+
+// Отслеживаемые величины: напряжения фаз и частота
+enum AnomalyMetric : uint8_t {
+    ANOMALY_VOLTAGE_A = 0,
+    ANOMALY_VOLTAGE_B,
+    ANOMALY_VOLTAGE_C,
+    ANOMALY_FREQUENCY,
+    ANOMALY_METRICS
+};
+
+// Больше событий за одно измерение не бывает: по всплеску и сдвигу на величину
+#define ANOMALY_MAX_EVENTS (2 * ANOMALY_METRICS)
+
+// Точки anomaly на все события одного измерения, DEVICE_ID до 32 символов
+#define ANOMALY_LINE_PROTOCOL_SIZE 1536
+
+enum class AnomalyKind : uint8_t {
+    SPIKE,          // Одно измерение дальше ANOMALY_SPIKE_Z от базовой линии
+    SHIFT_UP,       // CUSUM: устойчивый сдвиг или дрейф вверх
+    SHIFT_DOWN      // CUSUM: устойчивый сдвиг или дрейф вниз
+};
+
+/**
+ * Аномалия: начало отклонения (окончание событием не отмечается)
+ */
+struct AnomalyEvent {
+    uint32_t timeS;             // Время измерения (как передано в update)
+    AnomalyMetric metric;
+    AnomalyKind kind;
+    float score;                // Отклонение в сигмах: измерения для SPIKE, среднего окна для SHIFT_*
+    float value;                // Измерение (SPIKE) или среднее окна (SHIFT_*), В или Гц
+    float baseline;             // Ожидаемое значение в этот час суток
+    float sigma;                // Сигма, в которой посчитан score
+};
+
+/**
+ * Потоковый детектор аномалий напряжения и частоты
+ *
+ * Базовая линия величины — ANOMALY_SLOTS значений по часам суток: в каждом
+ * EWMA среднего и дисперсии остатка с весом 2^-ANOMALY_BASELINE_SHIFT (пока
+ * измерений мало — простое среднее). Ожидаемое значение линейно
+ * интерполируется между серединами соседних часов, так что обычный суточный
+ * ход не считается аномалией, а его внезапное изменение — считается.
+ * Остатки (измерение минус ожидаемое):
+ *   - по одному сравниваются с ANOMALY_SPIKE_Z сигм — всплеск;
+ *   - усредняются по ANOMALY_WINDOW_S измерениям и идут в двусторонний CUSUM
+ *     в сигмах среднего окна: S+ = max(0, S+ + z - k), S- = max(0, S- - z - k).
+ *     Превышение ANOMALY_CUSUM_H — сдвиг или дрейф. Усреднение гасит
+ *     коррелированный шум (медленные блуждания частоты), на котором CUSUM по
+ *     отдельным измерениям срабатывал бы постоянно.
+ * Событие выдаётся один раз при начале отклонения; повторное — после
+ * возврата CUSUM к нулю. Базовая линия учится на остатках, обрезанных по
+ * ANOMALY_CLIP_Z сигм: долгая аномалия почти не сдвигает её, а медленный
+ * дрейф не растворяется в ней и доходит до CUSUM.
+ *
+ * Вся арифметика целочисленная: значения в 0.01 В и 0.0001 Гц, средние в Q8,
+ * дисперсии в Q16, сигмы — целочисленным корнем. Память постоянна
+ * (sizeof(AnomalyDetector)), одно измерение — O(1).
+ */
+class AnomalyDetector {
+public:
+    AnomalyDetector();
+
+    /**
+     * Добавить измерение
+     * @param data Результат измерения
+     * @param phases Фаз в схеме (PowerAnalyzer::PHASES)
+     * @param timeS Время измерения, с: Unix-время (NTP) или время работы —
+     *              от него зависит только, какой час суток учится
+     * @param events Куда записать события (ANOMALY_MAX_EVENTS)
+     * @return Записано событий
+     */
+    int update(const PowerData& data, int phases, uint32_t timeS, AnomalyEvent* events);
+
+    /**
+     * Идёт ли отклонение (CUSUM выше нуля после события)
+     */
+    bool isActive(AnomalyMetric metric) const;
+
+    /**
+     * Набрали ли все часы суток ANOMALY_WARMUP измерений
+     */
+    bool isWarmedUp(AnomalyMetric metric) const;
+
+    /**
+     * Событий с начала работы
+     */
+    uint32_t getEventCount() const;
+
+    static const char* metricName(AnomalyMetric metric);
+    static const char* kindName(AnomalyKind kind);
+
+    /**
+     * Точки anomaly (теги metric, kind); время ставит сервер — отправлять сразу
+     * @return Длина записанного, 0 если не поместилось
+     */
+    static size_t writeLineProtocol(const AnomalyEvent* events, int count,
+                                    char* buffer, size_t size, const char* deviceId);
+
+private:
+    // Базовая линия одного часа суток
+    struct Slot {
+        int32_t mean;           // Q8
+        int64_t variance;       // Остатка измерения, Q16
+        int64_t windowVariance; // Среднего окна, Q16
+        uint32_t count;
+    };
+
+    struct Track {
+        Slot slots[ANOMALY_SLOTS];
+        int64_t windowSum;      // Q8
+        uint16_t windowCount;
+        int32_t cusumUp;        // Сигмы, Q8
+        int32_t cusumDown;
+        bool activeUp;
+        bool activeDown;
+    };
+
+    Track tracks[ANOMALY_METRICS];
+    uint32_t eventCount;
+
+    /**
+     * Одна величина в единицах фиксированной точки
+     * @return Записано событий
+     */
+    int updateTrack(AnomalyMetric metric, int32_t value, uint32_t timeS, AnomalyEvent* events);
+};
+
+#endif // ANOMALY_DETECTOR_H
@@ -0,0 +1,82 @@
+#include "BootTimeline.h"
+#include <stdio.h>
+#include <string.h>
+#include "LineProtocol.h"
+
+BootTimeline::BootTimeline()
+    : fastConnect(false),
+      backfillS(0) {
+    memset(stageMs, 0, sizeof(stageMs));
+    memset(stageReached, 0, sizeof(stageReached));
+}
+
+bool BootTimeline::mark(BootStage stage, uint32_t ms) {
+    int index = (int)stage;
+    if (index >= STAGES || stageReached[index]) {
+        return false;
+    }
+    stageMs[index] = ms;
+    stageReached[index] = true;
+    return true;
+}
+
+bool BootTimeline::reached(BootStage stage) const {
+    return (int)stage < STAGES && stageReached[(int)stage];
+}
+
+uint32_t BootTimeline::at(BootStage stage) const {
+    return reached(stage) ? stageMs[(int)stage] : 0;
+}
+
+void BootTimeline::setFastConnect(bool fast) {
+    fastConnect = fast;
+}
+
+bool BootTimeline::isFastConnect() const {
+    return fastConnect;
+}
+
+void BootTimeline::addBackfill(uint32_t seconds) {
+    backfillS += seconds;
+}
+
+uint32_t BootTimeline::getBackfill() const {
+    return backfillS;
+}
+
+size_t BootTimeline::writeLineProtocol(char* buffer, size_t size, const char* deviceId,
+                                       const char* resetReason) const {
+    LineWriter out(buffer, size);
+    out.begin("boot");
+    out.tag("device", deviceId);
+    out.tag("reset", resetReason);
+    out.tag("wifi", fastConnect ? "fast" : "scan");
+    for (int i = 0; i < STAGES; i++) {
+        if (!stageReached[i]) {
+            continue;
+        }
+        char key[32];
+        snprintf(key, sizeof(key), "%s_ms", stageName((BootStage)i));
+        out.field(key, stageMs[i]);
+    }
+    out.field("backfill_s", backfillS);
+    out.end();
+    return out.overflowed() ? 0 : out.length();
+}
+
+const char* BootTimeline::stageName(BootStage stage) {
+    switch (stage) {
+        case BootStage::FIRST_SAMPLE:
+            return "first_sample";
+        case BootStage::WIFI:
+            return "wifi";
+        case BootStage::INFLUX:
+            return "influx";
+        case BootStage::NTP:
+            return "ntp";
+        case BootStage::FIRST_UPLOAD:
+            return "first_upload";
+        default:
+            return "unknown";
+    }
+}
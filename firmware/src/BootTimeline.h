@@ -0,0 +1,84 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+/**
+ * Этапы запуска в порядке, в котором они обычно наступают
+ */
+enum class BootStage : uint8_t {
+    FIRST_SAMPLE,   // Первое измерение готово (и записано в историю)
+    WIFI,           // WiFi подключен, адрес получен
+    INFLUX,         // InfluxDB ответил на /ping
+    NTP,            // Часы синхронизированы
+    FIRST_UPLOAD,   // Первое измерение дошло выбранным транспортом
+    COUNT
+};
+
+/**
+ * Хронология запуска: когда (мс от включения) наступил каждый этап
+ *
+ * Измерение начинается раньше сети, поэтому время до первого измерения и
+ * время до первой отправки — разные величины, и обе стоит видеть после
+ * каждого восстановления питания. Отметки ставит loop(); первая отметка
+ * этапа окончательная, повторные (переподключения) её не меняют.
+ *
+ * Точка boot (InfluxDB):
+ *   boot,device=...,reset=power_on,wifi=fast first_sample_ms=480i,wifi_ms=1210i,
+ *       influx_ms=1260i,ntp_ms=1900i,first_upload_ms=1490i,backfill_s=2i
+ * Поля не наступивших этапов не пишутся.
+ */
+class BootTimeline {
+public:
+    BootTimeline();
+
+    /**
+     * Отметить этап
+     * @param ms millis() момента
+     * @return true если это первая отметка этапа
+     */
+    bool mark(BootStage stage, uint32_t ms);
+
+    bool reached(BootStage stage) const;
+
+    /**
+     * Мс от включения до этапа (0 — не наступил)
+     */
+    uint32_t at(BootStage stage) const;
+
+    /**
+     * WiFi подключился по сохранённым BSSID/каналу (без сканирования)
+     */
+    void setFastConnect(bool fast);
+    bool isFastConnect() const;
+
+    /**
+     * Досланные из истории секунды, измеренные до первой отправки
+     */
+    void addBackfill(uint32_t seconds);
+    uint32_t getBackfill() const;
+
+    /**
+     * Сформировать точку boot
+     * @param resetReason Причина перезагрузки (FlightRecorder::resetReasonName)
+     * @return Длина, 0 если не поместилось
+     */
+    size_t writeLineProtocol(char* buffer, size_t size, const char* deviceId, const char* resetReason) const;
+
+    /**
+     * Имя этапа для логов и полей (first_sample, wifi, ...)
+     */
+    static const char* stageName(BootStage stage);
+
+private:
+    static const int STAGES = (int)BootStage::COUNT;
+
+    uint32_t stageMs[STAGES];
+    bool stageReached[STAGES];
+    bool fastConnect;
+    uint32_t backfillS;
+};
+
+#endif // BOOT_TIMELINE_H
@@ -0,0 +1,60 @@
+#ifndef CAPTURE_FORMAT_H
+#define CAPTURE_FORMAT_H
+
+#include <stdint.h>
+
+/**
+ * Формат файла захвата сырых отсчётов АЦП (little-endian, без выравнивания)
+ *
+ *   CaptureHeader
+ *   CaptureBlockHeader + frameCount × channelCount int16 (кадры подряд: A, B, C, A, B, C, ...)
+ *   CaptureBlockHeader + ...
+ *
+ * Один блок = одно окно измерения PowerAnalyzer (MEASUREMENT_WINDOW_MS).
+ * Заголовок хранит всё, что нужно для воспроизведения на хосте без config.h
+ * устройства: схему подключения, частоту оцифровки, назначение каналов,
+ * смещения и калибровку.
+ *
+ * Версия 2: до 8 каналов и схема подключения (файлы версии 1 не читаются).
+ */
+
+#define CAPTURE_MAGIC 0x4350534F          // "OSPC" (little-endian)
+#define CAPTURE_BLOCK_MAGIC 0x4B4C4243    // "CBLK"
+#define CAPTURE_VERSION 2
+#define CAPTURE_MAX_CHANNELS 8
+#define CAPTURE_DEVICE_ID_LEN 16
+
+// Флаги блока
+#define CAPTURE_BLOCK_LATE 0x0001         // Кадры позже расписания больше SAMPLE_JITTER_THRESHOLD_US
+
+struct __attribute__((packed)) CaptureHeader {
+    uint32_t magic;                             // CAPTURE_MAGIC
+    uint16_t version;                           // CAPTURE_VERSION
+    uint16_t headerSize;                        // sizeof(CaptureHeader), для будущих расширений
+    uint32_t sampleRateHz;                      // Частота кадров (отсчётов одного канала в секунду)
+    uint8_t channelCount;
+    uint8_t adcBits;
+    uint16_t framesPerBlock;                    // Максимум кадров в блоке
+    uint8_t topology;                           // TOPOLOGY_* (config.h)
+    uint8_t voltageChannels;                    // Первые каналы — напряжения схемы, остальные — токи ТТ
+    uint16_t reserved;
+    char channelMap[CAPTURE_MAX_CHANNELS];      // 'A', 'B', 'C' ('1', '2' — split-phase), 'I' — ток ТТ, 0 — нет
+    uint8_t channelPins[CAPTURE_MAX_CHANNELS];  // GPIO канала на устройстве
+    float offsets[CAPTURE_MAX_CHANNELS];        // Смещение нуля, единицы кадра (2^(adcBits - 12) на отсчёт)
+    float calibration[CAPTURE_MAX_CHANNELS];    // В на единицу кадра (CALIBRATION_COEFF_* / 2^(adcBits - 12))
+    uint32_t startUnixTime;                     // 0 если время не синхронизировано
+    char deviceId[CAPTURE_DEVICE_ID_LEN];       // Без завершающего нуля, если занимает всё поле
+};
+
+struct __attribute__((packed)) CaptureBlockHeader {
+    uint32_t magic;             // CAPTURE_BLOCK_MAGIC (ресинхронизация после повреждения)
+    uint32_t seq;               // Номер блока (пропуски = потерянные блоки)
+    uint32_t timestampMs;       // millis() в конце блока (PowerData.timestamp)
+    uint16_t frameCount;        // Кадров в блоке
+    uint16_t flags;             // CAPTURE_BLOCK_*
+};
+
+static_assert(sizeof(CaptureHeader) == 120, "CaptureHeader layout changed");
+static_assert(sizeof(CaptureBlockHeader) == 16, "CaptureBlockHeader layout changed");
+
+#endif // CAPTURE_FORMAT_H
@@ -0,0 +1,97 @@
+#include "CaptureRecorder.h"
+#include <time.h>
+
+CaptureRecorder::CaptureRecorder()
+    : recording(false),
+      channels(0),
+      blocksLeft(0),
+      blocksWritten(0),
+      bytesWritten(0) {
+}
+
+bool CaptureRecorder::start(fs::FS& fs, const char* path, uint32_t blocks,
+                            const PowerAnalyzer& analyzer, const char* deviceId) {
+    if (recording) {
+        stop();
+    }
+
+    file = fs.open(path, "w");
+    if (!file) {
+        Serial.printf("[CaptureRecorder] Cannot open %s\n", path);
+        return false;
+    }
+
+    time_t now = time(nullptr);
+    CaptureHeader header;
+    analyzer.describeCapture(header, deviceId, now > 1700000000 ? (uint32_t)now : 0);
+
+    file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+
+    recording = true;
+    channels = header.channelCount;
+    blocksLeft = blocks;
+    blocksWritten = 0;
+    bytesWritten = sizeof(header);
+
+    Serial.printf("[CaptureRecorder] Recording %lu blocks to %s\n", (unsigned long)blocks, path);
+    return true;
+}
+
+void CaptureRecorder::append(const int16_t* block, int frames, uint32_t timestampMs) {
+    if (!recording) {
+        return;
+    }
+
+    size_t payload = (size_t)frames * channels * sizeof(int16_t);
+    if (bytesWritten + sizeof(CaptureBlockHeader) + payload > CAPTURE_MAX_BYTES) {
+        Serial.println("[CaptureRecorder] Size limit reached");
+        stop();
+        return;
+    }
+
+    CaptureBlockHeader header;
+    header.magic = CAPTURE_BLOCK_MAGIC;
+    header.seq = blocksWritten;
+    header.timestampMs = timestampMs;
+    header.frameCount = frames;
+    header.flags = 0;
+
+    size_t written = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+    written += file.write(reinterpret_cast<const uint8_t*>(block), payload);
+    if (written != sizeof(header) + payload) {
+        // Кончилось место: файл остаётся читаемым до последнего целого блока
+        Serial.println("[CaptureRecorder] Write failed (filesystem full?)");
+        stop();
+        return;
+    }
+
+    blocksWritten++;
+    bytesWritten += written;
+
+    if (--blocksLeft == 0) {
+        stop();
+    }
+}
+
+void CaptureRecorder::stop() {
+    if (!recording) {
+        return;
+    }
+    file.close();
+    recording = false;
+
+    Serial.printf("[CaptureRecorder] Stopped: %lu blocks, %lu bytes\n",
+                  (unsigned long)blocksWritten, (unsigned long)bytesWritten);
+}
+
+bool CaptureRecorder::isRecording() const {
+    return recording;
+}
+
+uint32_t CaptureRecorder::getBlocksWritten() const {
+    return blocksWritten;
+}
+
+uint32_t CaptureRecorder::getBytesWritten() const {
+    return bytesWritten;
+}
@@ -0,0 +1,62 @@
+#ifndef CAPTURE_RECORDER_H
+#define CAPTURE_RECORDER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "config.h"
+#include "CaptureFormat.h"
+#include "PowerAnalyzer.h"
+
+/**
+ * Запись сырых блоков АЦП в файл захвата (CaptureFormat.h) на LittleFS
+ *
+ * Пишется ровно то, что анализировал PowerAnalyzer, со смещениями и калибровкой
+ * в заголовке, поэтому на хосте тот же PowerAnalyzer::analyze() даёт те же PowerData.
+ * Запись блока (~12 КБ) занимает десятки миллисекунд — вызывать из loop()
+ * после измерения, не из обработчиков веб-сервера.
+ */
+class CaptureRecorder {
+public:
+    CaptureRecorder();
+
+    /**
+     * Начать новый файл (старый перезаписывается)
+     * @param fs Файловая система (LittleFS)
+     * @param path Путь к файлу
+     * @param blocks Сколько блоков записать
+     * @param analyzer Источник смещений и калибровки
+     * @param deviceId Идентификатор устройства для заголовка
+     * @return false если файл не открылся
+     */
+    bool start(fs::FS& fs, const char* path, uint32_t blocks,
+               const PowerAnalyzer& analyzer, const char* deviceId);
+
+    /**
+     * Дописать блок; по достижении лимита блоков или CAPTURE_MAX_BYTES файл закрывается
+     * @param block Кадры по PowerAnalyzer::CHANNELS отсчётов
+     * @param frames Количество кадров
+     * @param timestampMs PowerData.timestamp этого блока
+     */
+    void append(const int16_t* block, int frames, uint32_t timestampMs);
+
+    /**
+     * Закрыть файл досрочно
+     */
+    void stop();
+
+    bool isRecording() const;
+
+    uint32_t getBlocksWritten() const;
+
+    uint32_t getBytesWritten() const;
+
+private:
+    fs::File file;
+    bool recording;
+    uint8_t channels;
+    uint32_t blocksLeft;
+    uint32_t blocksWritten;
+    uint32_t bytesWritten;
+};
+
+#endif // CAPTURE_RECORDER_H
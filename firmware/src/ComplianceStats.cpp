@@ -0,0 +1,284 @@
+#include "ComplianceStats.h"
+#include <math.h>
+#include <string.h>
+#include "LineProtocol.h"
+
+// 1970-01-05 — первый понедельник эпохи Unix
+#define FIRST_MONDAY_S (4 * 86400)
+#define WEEK_S (7 * 86400)
+
+template <int Bins>
+void BinnedHistogram<Bins>::reset(float lo, float step) {
+    this->lo = lo;
+    this->step = step;
+    total = 0;
+    memset(counts, 0, sizeof(counts));
+}
+
+template <int Bins>
+void BinnedHistogram<Bins>::add(float value) {
+    int bin = (int)floorf((value - lo) / step);
+    if (bin < 0) {
+        bin = 0;
+    } else if (bin >= Bins) {
+        bin = Bins - 1;
+    }
+    counts[bin]++;
+    total++;
+}
+
+template <int Bins>
+float BinnedHistogram<Bins>::percentile(float fraction) const {
+    if (total == 0) {
+        return 0.0f;
+    }
+    uint32_t target = (uint32_t)ceilf(fraction * total);
+    if (target == 0) {
+        target = 1;
+    }
+    uint32_t cumulative = 0;
+    for (int i = 0; i < Bins; i++) {
+        cumulative += counts[i];
+        if (cumulative >= target) {
+            return lo + (i + 0.5f) * step;
+        }
+    }
+    return lo + (Bins - 0.5f) * step;
+}
+
+/**
+ * Доля в процентах (100 если значений нет: нарушений не было)
+ */
+static float percentOf(uint32_t part, uint32_t total) {
+    return total > 0 ? 100.0f * part / total : 100.0f;
+}
+
+ComplianceStats::ComplianceStats()
+    : phases(0),
+      started(false),
+      hasInterval(false) {
+    memset(&interval, 0, sizeof(interval));
+    memset(&frequencyInterval, 0, sizeof(frequencyInterval));
+    memset(&lastInterval, 0, sizeof(lastInterval));
+    memset(&summary, 0, sizeof(summary));
+    resetWeek(0);
+}
+
+uint32_t ComplianceStats::weekStart(uint32_t unixTime) {
+    return (unixTime - FIRST_MONDAY_S) / WEEK_S * WEEK_S + FIRST_MONDAY_S;
+}
+
+void ComplianceStats::resetWeek(uint32_t startS) {
+    memset(&week, 0, sizeof(week));
+    week.startS = startS;
+    for (int p = 0; p < 3; p++) {
+        week.voltage[p].reset(-25.0f, 0.1f);
+        week.thd[p].reset(0.0f, 0.05f);
+    }
+    week.frequency.reset(-8.0f, 0.02f);
+    week.unbalance.reset(0.0f, 0.02f);
+}
+
+bool ComplianceStats::update(const PowerData& data, const float* thdPercent, int phases, uint32_t unixTime) {
+    // Перерыв питания — не отклонение напряжения: в статистику не входит
+    if (data.voltageAvg < PHASE_LOSS_THRESHOLD) {
+        return false;
+    }
+    this->phases = phases;
+
+    uint32_t index = unixTime / COMPLIANCE_INTERVAL_S;
+    uint32_t frequencyIndex = unixTime / COMPLIANCE_FREQUENCY_INTERVAL_S;
+    bool closed = false;
+
+    if (!started) {
+        started = true;
+        interval.index = index;
+        frequencyInterval.index = frequencyIndex;
+        resetWeek(weekStart(unixTime));
+    }
+
+    // Смена интервала (в том числе скачок часов назад после синхронизации NTP)
+    if (frequencyIndex != frequencyInterval.index) {
+        closeFrequencyInterval();
+        frequencyInterval.index = frequencyIndex;
+    }
+    if (index != interval.index) {
+        if (interval.count > 0) {
+            closeInterval();
+            closed = true;
+        }
+        memset(&interval, 0, sizeof(interval));
+        interval.index = index;
+
+        // Интервал в новой неделе: итог прошлой уже опубликован с её последним интервалом
+        uint32_t start = weekStart(unixTime);
+        if (start != week.startS) {
+            resetWeek(start);
+        }
+    }
+
+    const float voltages[3] = {data.voltageA, data.voltageB, data.voltageC};
+    for (int p = 0; p < phases; p++) {
+        interval.sumSquares[p] += (double)voltages[p] * voltages[p];
+        interval.thdSquares[p] += (double)thdPercent[p] * thdPercent[p];
+    }
+    interval.unbalanceSquares += (double)data.unbalance * data.unbalance;
+    interval.frequencySum += data.frequencyAvg;
+    interval.count++;
+
+    if (data.frequencyAvg > 0.0f) {
+        frequencyInterval.frequencySum += data.frequencyAvg;
+        frequencyInterval.count++;
+    }
+    return closed;
+}
+
+void ComplianceStats::closeFrequencyInterval() {
+    if (frequencyInterval.count == 0) {
+        return;
+    }
+    float frequency = (float)(frequencyInterval.frequencySum / frequencyInterval.count);
+    float deviation = (frequency - NOMINAL_FREQUENCY) / NOMINAL_FREQUENCY * 100.0f;
+
+    week.frequencyValues++;
+    if (fabsf(deviation) <= EN50160_FREQUENCY_BAND) {
+        week.frequencyInBand++;
+    }
+    if (deviation >= EN50160_FREQUENCY_LOW_LIMIT && deviation <= EN50160_FREQUENCY_HIGH_LIMIT) {
+        week.frequencyInLimits++;
+    }
+    week.frequency.add(deviation);
+
+    frequencyInterval.frequencySum = 0.0;
+    frequencyInterval.count = 0;
+}
+
+void ComplianceStats::closeInterval() {
+    ComplianceInterval& value = lastInterval;
+    memset(&value, 0, sizeof(value));
+    value.startS = interval.index * COMPLIANCE_INTERVAL_S;
+    value.measurements = interval.count;
+    for (int p = 0; p < phases; p++) {
+        value.voltage[p] = (float)sqrt(interval.sumSquares[p] / interval.count);
+        value.thd[p] = (float)sqrt(interval.thdSquares[p] / interval.count);
+    }
+    value.unbalance = (float)sqrt(interval.unbalanceSquares / interval.count);
+    value.frequency = (float)(interval.frequencySum / interval.count);
+
+    week.intervals++;
+    for (int p = 0; p < phases; p++) {
+        float deviation = (value.voltage[p] - NOMINAL_VOLTAGE) / NOMINAL_VOLTAGE * 100.0f;
+        if (fabsf(deviation) <= EN50160_VOLTAGE_BAND) {
+            week.voltageInBand[p]++;
+        }
+        if (deviation >= EN50160_VOLTAGE_LOW_LIMIT && deviation <= EN50160_VOLTAGE_BAND) {
+            week.voltageInLimits[p]++;
+        }
+        week.voltage[p].add(deviation);
+
+        if (value.thd[p] <= EN50160_THD_LIMIT) {
+            week.thdInLimit[p]++;
+        }
+        week.thd[p].add(value.thd[p]);
+    }
+    if (value.unbalance <= EN50160_UNBALANCE_LIMIT) {
+        week.unbalanceInLimit++;
+    }
+    week.unbalance.add(value.unbalance);
+
+    hasInterval = true;
+    summarize();
+}
+
+void ComplianceStats::summarize() {
+    ComplianceSummary& s = summary;
+    s.weekStartS = week.startS;
+    s.intervals = week.intervals;
+    s.frequencyValues = week.frequencyValues;
+
+    s.voltageInBandPct = 100.0f;
+    s.thdInLimitPct = 100.0f;
+    s.voltageAllInLimits = true;
+    s.voltageP05 = 1e9f;
+    s.voltageP95 = -1e9f;
+    s.thdP95 = 0.0f;
+    for (int p = 0; p < phases; p++) {
+        s.voltageInBandPct = fminf(s.voltageInBandPct, percentOf(week.voltageInBand[p], week.intervals));
+        s.thdInLimitPct = fminf(s.thdInLimitPct, percentOf(week.thdInLimit[p], week.intervals));
+        s.voltageAllInLimits = s.voltageAllInLimits && week.voltageInLimits[p] == week.intervals;
+        s.voltageP05 = fminf(s.voltageP05, week.voltage[p].percentile(0.05f));
+        s.voltageP95 = fmaxf(s.voltageP95, week.voltage[p].percentile(0.95f));
+        s.thdP95 = fmaxf(s.thdP95, week.thd[p].percentile(0.95f));
+    }
+    // Процентили напряжения — в вольтах
+    s.voltageP05 = NOMINAL_VOLTAGE * (1.0f + s.voltageP05 / 100.0f);
+    s.voltageP95 = NOMINAL_VOLTAGE * (1.0f + s.voltageP95 / 100.0f);
+
+    s.frequencyInBandPct = percentOf(week.frequencyInBand, week.frequencyValues);
+    s.frequencyAllInLimits = week.frequencyInLimits == week.frequencyValues;
+    s.frequencyP005 = NOMINAL_FREQUENCY * (1.0f + week.frequency.percentile(0.005f) / 100.0f);
+    s.frequencyP995 = NOMINAL_FREQUENCY * (1.0f + week.frequency.percentile(0.995f) / 100.0f);
+
+    s.unbalanceInLimitPct = percentOf(week.unbalanceInLimit, week.intervals);
+    s.unbalanceP95 = week.unbalance.percentile(0.95f);
+
+    s.compliant = s.voltageInBandPct >= 95.0f && s.voltageAllInLimits &&
+                  s.frequencyInBandPct >= 99.5f && s.frequencyAllInLimits &&
+                  s.unbalanceInLimitPct >= 95.0f && s.thdInLimitPct >= 95.0f;
+}
+
+const ComplianceInterval& ComplianceStats::getLastInterval() const {
+    return lastInterval;
+}
+
+const ComplianceSummary& ComplianceStats::getSummary() const {
+    return summary;
+}
+
+size_t ComplianceStats::writeLineProtocol(char* buffer, size_t size, const char* deviceId) const {
+    if (!hasInterval) {
+        return 0;
+    }
+    static const char* const voltageFields[3] = {"voltage_a", "voltage_b", "voltage_c"};
+    static const char* const thdFields[3] = {"thd_a", "thd_b", "thd_c"};
+
+    LineWriter out(buffer, size);
+
+    out.begin("power_quality");
+    out.tag("device", deviceId);
+    for (int p = 0; p < phases; p++) {
+        out.field(voltageFields[p], lastInterval.voltage[p], 2);
+        out.field(thdFields[p], lastInterval.thd[p], 2);
+    }
+    if (phases > 1) {
+        out.field("unbalance", lastInterval.unbalance, 2);
+    }
+    out.field("frequency", lastInterval.frequency, 3);
+    out.field("measurements", lastInterval.measurements);
+    out.field("interval_start", lastInterval.startS);
+    out.end();
+
+    out.begin("en50160");
+    out.tag("device", deviceId);
+    out.field("week_start", summary.weekStartS);
+    out.field("intervals", summary.intervals);
+    out.field("frequency_values", summary.frequencyValues);
+    out.field("voltage_in_band_pct", summary.voltageInBandPct, 2);
+    out.field("voltage_all_in_limits", (uint32_t)summary.voltageAllInLimits);
+    out.field("voltage_p05", summary.voltageP05, 1);
+    out.field("voltage_p95", summary.voltageP95, 1);
+    out.field("frequency_in_band_pct", summary.frequencyInBandPct, 2);
+    out.field("frequency_all_in_limits", (uint32_t)summary.frequencyAllInLimits);
+    out.field("frequency_p005", summary.frequencyP005, 3);
+    out.field("frequency_p995", summary.frequencyP995, 3);
+    if (phases > 1) {
+        out.field("unbalance_in_limit_pct", summary.unbalanceInLimitPct, 2);
+        out.field("unbalance_p95", summary.unbalanceP95, 2);
+    }
+    out.field("thd_in_limit_pct", summary.thdInLimitPct, 2);
+    out.field("thd_p95", summary.thdP95, 2);
+    out.field("compliant", (uint32_t)summary.compliant);
+    out.end();
+
+    return out.overflowed() ? 0 : out.length();
+}
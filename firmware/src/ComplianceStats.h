@@ -0,0 +1,162 @@
+#ifndef COMPLIANCE_STATS_H
+#define COMPLIANCE_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "PowerData.h"
+
+// Две точки Line Protocol (power_quality и en50160), DEVICE_ID до 32 символов
+#define COMPLIANCE_LINE_PROTOCOL_SIZE 1024
+
+/**
+ * Гистограмма с корзинами равной ширины [lo + i·step, lo + (i+1)·step).
+ * Значения за краями попадают в крайние корзины.
+ */
+template <int Bins>
+struct BinnedHistogram {
+    float lo;
+    float step;
+    uint32_t total;
+    uint16_t counts[Bins];      // 10-с значений за неделю — 60480, помещается
+
+    void reset(float lo, float step);
+    void add(float value);
+
+    /**
+     * Значение, ниже которого fraction всех (середина корзины)
+     */
+    float percentile(float fraction) const;
+};
+
+/**
+ * 10-минутное значение (среднеквадратичное измерений интервала)
+ */
+struct ComplianceInterval {
+    uint32_t startS;            // Unix-время начала интервала
+    uint32_t measurements;      // Измерений в интервале
+    float voltage[3];
+    float unbalance;
+    float thd[3];
+    float frequency;            // Среднее за интервал (сами нормы — по 10-с значениям)
+};
+
+/**
+ * Итог недели по EN 50160 на момент последнего закрытого интервала
+ */
+struct ComplianceSummary {
+    uint32_t weekStartS;        // Понедельник 00:00 UTC
+    uint32_t intervals;         // 10-мин значений
+    uint32_t frequencyValues;   // 10-с значений
+
+    // Доля значений в пределах, % (по фазам — худшая)
+    float voltageInBandPct;     // ±EN50160_VOLTAGE_BAND, норма 95 %
+    float frequencyInBandPct;   // ±EN50160_FREQUENCY_BAND, норма 99.5 %
+    float unbalanceInLimitPct;  // ≤ EN50160_UNBALANCE_LIMIT, норма 95 %
+    float thdInLimitPct;        // ≤ EN50160_THD_LIMIT, норма 95 %
+
+    // Все значения в широких пределах (норма 100 %)
+    bool voltageAllInLimits;
+    bool frequencyAllInLimits;
+
+    // Процентили (по фазам — худшие)
+    float voltageP05;
+    float voltageP95;
+    float frequencyP005;
+    float frequencyP995;
+    float unbalanceP95;
+    float thdP95;
+
+    bool compliant;
+};
+
+/**
+ * Статистика соответствия EN 50160, считаемая на устройстве по ходу измерений
+ *
+ * Каждое измерение (раз в секунду) добавляется в текущий 10-секундный интервал
+ * частоты и 10-минутный интервал напряжения, перекоса и THD. Интервалы
+ * выровнены по часам (Unix-время). Закрытый интервал сразу попадает в
+ * недельные счётчики и гистограммы, поэтому память не растёт с длиной недели,
+ * а итог недели готов после каждого интервала — без обхода сырых точек.
+ *
+ * Измерения раз в секунду по окну 200 мс, а не непрерывно, как в классе A
+ * EN 61000-4-30: 10-минутное значение — по 600 окнам, а не по 3000. Флаги
+ * провалов не ставятся; перерывы питания (< PHASE_LOSS_THRESHOLD) пропускаются.
+ * Статистика недели живёт в RAM и после перезапуска начинается заново
+ * (intervals показывает, сколько недели покрыто).
+ */
+class ComplianceStats {
+public:
+    ComplianceStats();
+
+    /**
+     * Добавить измерение
+     * @param data Результат измерения
+     * @param thdPercent THD фаз, % (PowerAnalyzer::harmonicDistortion)
+     * @param phases Фаз в схеме (PowerAnalyzer::PHASES)
+     * @param unixTime Время измерения (NTP)
+     * @return true если закрылся 10-минутный интервал — пора публиковать
+     */
+    bool update(const PowerData& data, const float* thdPercent, int phases, uint32_t unixTime);
+
+    /**
+     * Последний закрытый 10-минутный интервал и итог его недели
+     */
+    const ComplianceInterval& getLastInterval() const;
+    const ComplianceSummary& getSummary() const;
+
+    /**
+     * power_quality (10-минутное значение) и en50160 (итог недели)
+     * @return Длина записанного, 0 если не поместилось или интервалов ещё не было
+     */
+    size_t writeLineProtocol(char* buffer, size_t size, const char* deviceId) const;
+
+    /**
+     * Начало недели (понедельник 00:00 UTC), которой принадлежит момент
+     */
+    static uint32_t weekStart(uint32_t unixTime);
+
+private:
+    // Накопление текущих интервалов
+    struct IntervalAccumulator {
+        uint32_t index;         // unixTime / длина интервала
+        uint32_t count;
+        double sumSquares[3];   // Напряжения фаз
+        double unbalanceSquares;
+        double thdSquares[3];
+        double frequencySum;
+    };
+
+    // Неделя: счётчики и гистограммы закрытых интервалов
+    struct Week {
+        uint32_t startS;
+        uint32_t intervals;
+        uint32_t voltageInBand[3];
+        uint32_t voltageInLimits[3];
+        uint32_t unbalanceInLimit;
+        uint32_t thdInLimit[3];
+        uint32_t frequencyValues;
+        uint32_t frequencyInBand;
+        uint32_t frequencyInLimits;
+        BinnedHistogram<500> voltage[3];    // Отклонение от NOMINAL_VOLTAGE, ±25 % по 0.1 %
+        BinnedHistogram<800> frequency;     // Отклонение от NOMINAL_FREQUENCY, ±8 % по 0.02 %
+        BinnedHistogram<500> unbalance;     // 0..10 % по 0.02 %
+        BinnedHistogram<400> thd[3];        // 0..20 % по 0.05 %
+    };
+
+    int phases;
+    bool started;
+    IntervalAccumulator interval;
+    IntervalAccumulator frequencyInterval;
+    Week week;
+    ComplianceInterval lastInterval;
+    ComplianceSummary summary;
+    bool hasInterval;
+
+    void resetWeek(uint32_t startS);
+    void closeFrequencyInterval();
+    void closeInterval();
+    void summarize();
+};
+
+#endif // COMPLIANCE_STATS_H
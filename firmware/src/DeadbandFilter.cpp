@@ -0,0 +1,125 @@
+#include "DeadbandFilter.h"
+#include "TelemetryCodec.h"
+#include <math.h>
+#include <string.h>
+
+DeadbandFilter::DeadbandFilter()
+    : heartbeatMs(DEADBAND_HEARTBEAT_MS),
+      lastFlags(0),
+      primed(false),
+      enabled(DEADBAND_ENABLED != 0) {
+    memset(lastSent, 0, sizeof(lastSent));
+    memset(lastSentMs, 0, sizeof(lastSentMs));
+    memset(&stats, 0, sizeof(stats));
+
+    setThreshold(DEADBAND_FIELD_VOLTAGE_A, DEADBAND_VOLTAGE_PCT, true);
+    setThreshold(DEADBAND_FIELD_VOLTAGE_B, DEADBAND_VOLTAGE_PCT, true);
+    setThreshold(DEADBAND_FIELD_VOLTAGE_C, DEADBAND_VOLTAGE_PCT, true);
+    setThreshold(DEADBAND_FIELD_LINE_AB, DEADBAND_LINE_VOLTAGE_PCT, true);
+    setThreshold(DEADBAND_FIELD_LINE_BC, DEADBAND_LINE_VOLTAGE_PCT, true);
+    setThreshold(DEADBAND_FIELD_LINE_CA, DEADBAND_LINE_VOLTAGE_PCT, true);
+    setThreshold(DEADBAND_FIELD_FREQUENCY, DEADBAND_FREQUENCY_HZ, false);
+    setThreshold(DEADBAND_FIELD_UNBALANCE, DEADBAND_UNBALANCE_PCT, false);
+    setThreshold(DEADBAND_FIELD_POWER, DEADBAND_POWER_W, false);
+    setThreshold(DEADBAND_FIELD_ENERGY, DEADBAND_ENERGY_KWH, false);
+}
+
+void DeadbandFilter::setThreshold(uint16_t field, float value, bool percent) {
+    for (int i = 0; i < DEADBAND_FIELD_COUNT; i++) {
+        if (field & (1 << i)) {
+            thresholds[i].value = value;
+            thresholds[i].percent = percent;
+        }
+    }
+}
+
+void DeadbandFilter::setHeartbeat(uint32_t intervalMs) {
+    heartbeatMs = intervalMs;
+}
+
+void DeadbandFilter::setEnabled(bool enabled) {
+    this->enabled = enabled;
+}
+
+bool DeadbandFilter::isEnabled() const {
+    return enabled;
+}
+
+float DeadbandFilter::fieldValue(const PowerData& data, int index) {
+    switch (index) {
+        case 0: return data.voltageA;
+        case 1: return data.voltageB;
+        case 2: return data.voltageC;
+        case 3: return data.voltageAB;
+        case 4: return data.voltageBC;
+        case 5: return data.voltageCA;
+        case 6: return data.frequencyAvg;
+        case 7: return data.unbalance;
+        case 8: return data.activePower;
+        default: return data.energyImportKwh - data.energyExportKwh;
+    }
+}
+
+bool DeadbandFilter::exceeds(int index, float value) const {
+    const DeadbandThreshold& threshold = thresholds[index];
+    float delta = fabsf(value - lastSent[index]);
+
+    float limit = threshold.value;
+    if (threshold.percent) {
+        limit = fabsf(lastSent[index]) * threshold.value / 100.0f;
+    }
+    // Строго больше: при нулевом пороге повтор того же значения не отправляется
+    return delta > limit;
+}
+
+uint16_t DeadbandFilter::update(const PowerData& data, uint32_t nowMs) {
+    uint8_t flags = TelemetryCodec::problemFlags(data);
+
+    // Старт, смена флагов проблем или выключенный фильтр — отправляем всё
+    bool forceAll = !enabled || !primed || flags != lastFlags;
+    lastFlags = flags;
+    primed = true;
+
+    uint16_t mask = 0;
+    for (int i = 0; i < DEADBAND_FIELD_COUNT; i++) {
+        float value = fieldValue(data, i);
+        stats.evaluated++;
+
+        bool send;
+        if (forceAll) {
+            send = true;
+            stats.forced++;
+        } else if (exceeds(i, value)) {
+            send = true;
+        } else if (heartbeatMs > 0 && nowMs - lastSentMs[i] >= heartbeatMs) {
+            send = true;
+            stats.heartbeats++;
+        } else {
+            send = false;
+        }
+
+        if (send) {
+            mask |= (1 << i);
+            lastSent[i] = value;
+            lastSentMs[i] = nowMs;
+            stats.sent++;
+        }
+    }
+
+    return mask;
+}
+
+void DeadbandFilter::invalidate() {
+    primed = false;
+}
+
+DeadbandStats DeadbandFilter::getStats() const {
+    return stats;
+}
+
+float DeadbandFilter::getSuppressionRatio() const {
+    if (stats.evaluated == 0) {
+        return 0.0f;
+    }
+    return 1.0f - (float)stats.sent / (float)stats.evaluated;
+}
@@ -0,0 +1,120 @@
+#ifndef DEADBAND_FILTER_H
+#define DEADBAND_FILTER_H
+
+#include <stdint.h>
+#include "PowerData.h"
+#include "config.h"
+
+// Скалярные величины PowerData, которые уходят точками в InfluxDB (биты маски)
+#define DEADBAND_FIELD_VOLTAGE_A 0x01
+#define DEADBAND_FIELD_VOLTAGE_B 0x02
+#define DEADBAND_FIELD_VOLTAGE_C 0x04
+#define DEADBAND_FIELD_LINE_AB 0x08
+#define DEADBAND_FIELD_LINE_BC 0x10
+#define DEADBAND_FIELD_LINE_CA 0x20
+#define DEADBAND_FIELD_FREQUENCY 0x40
+#define DEADBAND_FIELD_UNBALANCE 0x80
+#define DEADBAND_FIELD_POWER 0x100      // Суммарная активная мощность (все строки power)
+#define DEADBAND_FIELD_ENERGY 0x200     // Счётчик энергии (сальдо импорт - экспорт)
+#define DEADBAND_VOLTAGE_FIELDS 0xFF
+#define DEADBAND_ALL_FIELDS 0x3FF
+#define DEADBAND_FIELD_COUNT 10
+
+/**
+ * Порог зоны нечувствительности для одной величины
+ */
+struct DeadbandThreshold {
+    float value;        // Порог (0 = отправлять каждое изменение)
+    bool percent;       // true: value в % от последнего отправленного значения
+};
+
+/**
+ * Статистика фильтра (в точках, т.е. в отдельных величинах)
+ */
+struct DeadbandStats {
+    uint32_t evaluated;     // Сколько величин проверено
+    uint32_t sent;          // Сколько отправлено
+    uint32_t heartbeats;    // Из них — по истечении heartbeat
+    uint32_t forced;        // Из них — принудительно (старт, смена флагов, сбой отправки)
+};
+
+/**
+ * Отчёт по исключению (report-by-exception) для скалярной телеметрии
+ *
+ * Величина отправляется, только если ушла от последнего отправленного
+ * значения дальше порога или с её последней отправки прошло
+ * DEADBAND_HEARTBEAT_MS. Смена флагов проблем отправляет все величины сразу.
+ * Не зависит от Arduino — можно собрать на хосте и прогнать записанные данные.
+ */
+class DeadbandFilter {
+public:
+    DeadbandFilter();
+
+    /**
+     * Задать порог для величины
+     * @param field Один бит DEADBAND_FIELD_*
+     * @param value Порог в единицах величины или в процентах
+     * @param percent true если порог относительный
+     */
+    void setThreshold(uint16_t field, float value, bool percent);
+
+    /**
+     * Задать интервал принудительной отправки
+     * @param intervalMs 0 = без heartbeat
+     */
+    void setHeartbeat(uint32_t intervalMs);
+
+    /**
+     * Включить/выключить фильтр (выключенный отправляет всё)
+     */
+    void setEnabled(bool enabled);
+
+    bool isEnabled() const;
+
+    /**
+     * Решить, какие величины отправлять, и запомнить их как отправленные
+     * @param data Результат измерения
+     * @param nowMs Текущее время (millis())
+     * @return Маска DEADBAND_FIELD_* (0 = отправлять нечего)
+     */
+    uint16_t update(const PowerData& data, uint32_t nowMs);
+
+    /**
+     * Забыть отправленные значения: следующий update() отправит всё.
+     * Вызывать, если отправка не удалась, чтобы сервер не остался со старыми данными.
+     */
+    void invalidate();
+
+    /**
+     * Статистика с момента запуска
+     */
+    DeadbandStats getStats() const;
+
+    /**
+     * Доля подавленных точек (0..1)
+     */
+    float getSuppressionRatio() const;
+
+    /**
+     * Значение величины из PowerData по номеру бита маски (0..DEADBAND_FIELD_COUNT-1)
+     */
+    static float fieldValue(const PowerData& data, int index);
+
+private:
+    DeadbandThreshold thresholds[DEADBAND_FIELD_COUNT];
+    float lastSent[DEADBAND_FIELD_COUNT];
+    uint32_t lastSentMs[DEADBAND_FIELD_COUNT];
+    uint32_t heartbeatMs;
+    uint8_t lastFlags;
+    bool primed;
+    bool enabled;
+
+    DeadbandStats stats;
+
+    /**
+     * Вышла ли величина за порог относительно последнего отправленного значения
+     */
+    bool exceeds(int index, float value) const;
+};
+
+#endif // DEADBAND_FILTER_H
@@ -0,0 +1,122 @@
+#include "Decimator.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+Decimator::Decimator()
+    : channels(0),
+      factor(1),
+      taps(0),
+      fractionBits(0),
+      position(0),
+      coefficients(nullptr),
+      history(nullptr) {
+}
+
+Decimator::~Decimator() {
+    free(coefficients);
+    free(history);
+}
+
+bool Decimator::begin(int channels, int factor, int tapsPerPhase, int fractionBits) {
+    int length = factor * tapsPerPhase - 1;
+    if (channels < 1 || factor < 2 || tapsPerPhase < 2 || length > DECIMATOR_MAX_TAPS || fractionBits < 0 ||
+        ((int32_t)ADC_MAX_VALUE << fractionBits) > INT16_MAX) {
+        return false;
+    }
+    free(coefficients);
+    free(history);
+    coefficients = static_cast<int16_t*>(malloc(length * sizeof(int16_t)));
+    history = static_cast<int16_t*>(malloc(channels * 2 * length * sizeof(int16_t)));
+    if (coefficients == nullptr || history == nullptr) {
+        free(coefficients);
+        free(history);
+        coefficients = nullptr;
+        history = nullptr;
+        return false;
+    }
+    this->channels = channels;
+    this->factor = factor;
+    this->fractionBits = fractionBits;
+    taps = length;
+
+    // Оконный sinc: срез на fs / (2·factor) относительно частоты подкадров
+    const double cutoff = 0.5 / factor;
+    const int middle = (taps - 1) / 2;
+    double ideal[DECIMATOR_MAX_TAPS];
+    double sum = 0.0;
+    for (int n = 0; n < taps; n++) {
+        int m = n - middle;
+        double sinc = m == 0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * m) / (M_PI * m);
+        double window = 0.42 - 0.5 * cos(2.0 * M_PI * n / (taps - 1)) + 0.08 * cos(4.0 * M_PI * n / (taps - 1));
+        ideal[n] = sinc * window;
+        sum += ideal[n];
+    }
+    // Q15 с суммой ровно 32768: остаток округления — в центральный отвод
+    int32_t total = 0;
+    for (int n = 0; n < taps; n++) {
+        coefficients[n] = (int16_t)lround(ideal[n] / sum * 32768.0);
+        total += coefficients[n];
+    }
+    coefficients[middle] += (int16_t)(32768 - total);
+
+    reset(ADC_OFFSET);
+    return true;
+}
+
+void Decimator::reset(int16_t level) {
+    for (int i = 0; i < channels * 2 * taps; i++) {
+        history[i] = level;
+    }
+    position = 0;
+}
+
+int Decimator::getFactor() const {
+    return factor;
+}
+
+int Decimator::getTaps() const {
+    return taps;
+}
+
+int Decimator::getFractionBits() const {
+    return fractionBits;
+}
+
+const int16_t* Decimator::getCoefficients() const {
+    return coefficients;
+}
+
+int Decimator::getDelaySubframes() const {
+    return (taps - 1) / 2;
+}
+
+float Decimator::getNoiseGain() const {
+    double sumSquares = 0.0;
+    for (int n = 0; n < taps; n++) {
+        double h = coefficients[n] / 32768.0;
+        sumSquares += h * h;
+    }
+    return (float)sqrt(sumSquares);
+}
+
+float Decimator::getEnobGain(float inputSigma) const {
+    if (taps == 0 || inputSigma <= 0.0f) {
+        return 0.0f;
+    }
+    const float gain = getNoiseGain();
+    const float step = 1.0f / (1 << fractionBits);
+    return log2f(inputSigma / sqrtf(gain * gain * inputSigma * inputSigma + step * step / 12.0f));
+}
+
+float Decimator::responseDb(float frequency, float inputRateHz) const {
+    double re = 0.0;
+    double im = 0.0;
+    for (int n = 0; n < taps; n++) {
+        double angle = 2.0 * M_PI * frequency / inputRateHz * n;
+        re += coefficients[n] * cos(angle);
+        im -= coefficients[n] * sin(angle);
+    }
+    double gain = sqrt(re * re + im * im) / 32768.0;
+    return (float)(20.0 * log10(gain > 1e-12 ? gain : 1e-12));
+}
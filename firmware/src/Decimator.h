@@ -0,0 +1,122 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Наибольшая длина фильтра, отводов (OVERSAMPLE_FACTOR × OVERSAMPLE_TAPS_PER_PHASE - 1)
+#define DECIMATOR_MAX_TAPS 255
+
+/**
+ * Фильтр-дециматор входного тракта АЦП: подкадры с частотой factor × fs
+ * в кадры с частотой fs
+ *
+ * КИХ с линейной фазой, factor × tapsPerPhase - 1 отводов (нечётное число,
+ * задержка — целое число подкадров), окно Блэкмана, срез на частоте Найквиста
+ * выходного потока. Коэффициенты Q15 с суммой ровно 32768: постоянная
+ * составляющая (смещение АЦП) проходит без изменений, калибровка смещения
+ * остаётся верной. Полифазная схема: shift() только кладёт подкадр в
+ * историю, свёртка считается в output() раз на factor подкадров — по
+ * tapsPerPhase умножений на подкадр и канал.
+ *
+ * История каждого канала хранится дважды подряд (кольцо 2 × taps), чтобы
+ * окно свёртки всегда было непрерывным: в горячем цикле нет деления по
+ * модулю. Свёртка — int16 × Q15 в int32 без переполнения (12-битный вход).
+ *
+ * Выход округляется не до целого отсчёта, а до 1/2^fractionBits: шум после
+ * фильтра меньше LSB, и округление до целых съело бы выигрыш. Кадр —
+ * отсчёты << fractionBits (до 15 бит, помещается в int16).
+ */
+class Decimator {
+public:
+    Decimator();
+    ~Decimator();
+
+    /**
+     * Рассчитать коэффициенты и выделить историю
+     * @param channels Каналов в кадре
+     * @param factor Подкадров на кадр (2..)
+     * @param tapsPerPhase Отводов на фазу полифазного разложения
+     * @param fractionBits Бит ниже LSB АЦП в кадре (0..3)
+     * @return false если фильтр длиннее DECIMATOR_MAX_TAPS или нет памяти
+     */
+    bool begin(int channels, int factor, int tapsPerPhase, int fractionBits);
+
+    /**
+     * Заполнить историю уровнем (смещение АЦП в отсчётах подкадра) — до первого подкадра
+     */
+    void reset(int16_t level);
+
+    /**
+     * Подкадр АЦП в историю
+     */
+    inline void shift(const int16_t* subframe) {
+        for (int ch = 0; ch < channels; ch++) {
+            int16_t* h = history + ch * 2 * taps;
+            h[position] = subframe[ch];
+            h[position + taps] = subframe[ch];
+        }
+        if (++position == taps) {
+            position = 0;
+        }
+    }
+
+    /**
+     * Кадр по последним taps подкадрам (отсчёты << fractionBits). Описывает
+     * момент на getDelaySubframes() подкадров раньше последнего.
+     */
+    inline void output(int16_t* frame) const {
+        const int shift = 15 - fractionBits;
+        const int32_t maxValue = (int32_t)ADC_MAX_VALUE << fractionBits;
+        for (int ch = 0; ch < channels; ch++) {
+            const int16_t* x = history + ch * 2 * taps + position;
+            int32_t acc = (int32_t)1 << (shift - 1);
+            for (int k = 0; k < taps; k++) {
+                acc += (int32_t)coefficients[k] * x[k];
+            }
+            int32_t value = acc >> shift;
+            frame[ch] = (int16_t)(value < 0 ? 0 : (value > maxValue ? maxValue : value));
+        }
+    }
+
+    int getFactor() const;
+    int getTaps() const;
+    int getFractionBits() const;
+    const int16_t* getCoefficients() const;
+
+    /**
+     * Групповая задержка, подкадров ((taps - 1) / 2)
+     */
+    int getDelaySubframes() const;
+
+    /**
+     * Во сколько раз падает СКО белого шума (√Σh², меньше 1)
+     */
+    float getNoiseGain() const;
+
+    /**
+     * Прибавка эффективных бит для белого шума σ (отсчётов) на входе — с
+     * округлением кадра до 1/2^fractionBits: log2(σ / √(g²σ² + q²/12))
+     */
+    float getEnobGain(float inputSigma) const;
+
+    /**
+     * АЧХ по коэффициентам Q15
+     * @param frequency Частота на входе, Гц
+     * @param inputRateHz Частота подкадров
+     * @return Усиление, дБ
+     */
+    float responseDb(float frequency, float inputRateHz) const;
+
+private:
+    int channels;
+    int factor;
+    int taps;
+    int fractionBits;
+    int position;
+    int16_t* coefficients;
+    int16_t* history;
+};
+
+#endif // DECIMATOR_H
@@ -0,0 +1,394 @@
+#include "DeepCapture.h"
+#include <string.h>
+#include "hal/Hal.h"
+
+DeepCapture::DeepCapture()
+    : buffer(nullptr),
+      bufferSize(0),
+      samples(nullptr),
+      blockHeaders(nullptr),
+      envelopeFinal(false),
+      channels(0),
+      framesPerBlock(0),
+      sampleRateHz(0),
+      maxBlocks(0),
+      targetBlocks(0),
+      state((uint8_t)DeepCaptureState::IDLE),
+      generation(0),
+      committedBlocks(0),
+      stopRequested(false),
+      lateFrames(0),
+      maxLateUs(0) {
+    memset(envelope, 0, sizeof(envelope));
+    memset(envelopeCapacity, 0, sizeof(envelopeCapacity));
+    for (int level = 0; level < DEEP_ENVELOPE_LEVELS; level++) {
+        envelopeCount[level].store(0, std::memory_order_relaxed);
+    }
+    memset(&header, 0, sizeof(header));
+}
+
+DeepCapture::~DeepCapture() {
+    if (buffer != nullptr) {
+        Hal::freeExternal(buffer);
+    }
+}
+
+bool DeepCapture::begin(int channels, int framesPerBlock, uint32_t sampleRateHz) {
+    this->channels = channels;
+    this->framesPerBlock = framesPerBlock;
+    this->sampleRateHz = sampleRateHz;
+
+    uint64_t maxFrames = (uint64_t)DEEP_CAPTURE_MAX_SECONDS * sampleRateHz;
+    maxBlocks = (uint32_t)((maxFrames + framesPerBlock - 1) / framesPerBlock);
+    maxFrames = (uint64_t)maxBlocks * framesPerBlock;
+
+    // Один буфер: кадры, заголовки блоков, уровни пирамиды (все по 2 байта на отсчёт)
+    size_t sampleBytes = (size_t)maxFrames * channels * sizeof(int16_t);
+    size_t headerBytes = maxBlocks * sizeof(CaptureBlockHeader);
+    size_t envelopeBytes = 0;
+    uint64_t bucketFrames = DEEP_ENVELOPE_BUCKET_FRAMES;
+    for (int level = 0; level < DEEP_ENVELOPE_LEVELS; level++) {
+        envelopeCapacity[level] = (uint32_t)((maxFrames + bucketFrames - 1) / bucketFrames);
+        envelopeBytes += (size_t)envelopeCapacity[level] * channels * 2 * sizeof(int16_t);
+        bucketFrames *= DEEP_ENVELOPE_FACTOR;
+    }
+
+    bufferSize = sampleBytes + headerBytes + envelopeBytes;
+    buffer = static_cast<uint8_t*>(Hal::allocExternal(bufferSize));
+    if (buffer == nullptr) {
+        Hal::log("[DeepCapture] No external memory for %u bytes, deep capture disabled\n", (unsigned)bufferSize);
+        bufferSize = 0;
+        return false;
+    }
+
+    samples = reinterpret_cast<int16_t*>(buffer);
+    blockHeaders = reinterpret_cast<CaptureBlockHeader*>(buffer + sampleBytes);
+    int16_t* next = reinterpret_cast<int16_t*>(buffer + sampleBytes + headerBytes);
+    for (int level = 0; level < DEEP_ENVELOPE_LEVELS; level++) {
+        envelope[level] = next;
+        next += (size_t)envelopeCapacity[level] * channels * 2;
+    }
+
+    Hal::log("[DeepCapture] %u KB buffer: up to %d s, %lu blocks x %d frames x %d channels\n",
+             (unsigned)(bufferSize / 1024), DEEP_CAPTURE_MAX_SECONDS, (unsigned long)maxBlocks,
+             framesPerBlock, channels);
+    return true;
+}
+
+bool DeepCapture::isAvailable() const {
+    return buffer != nullptr;
+}
+
+bool DeepCapture::start(uint32_t seconds, const CaptureHeader& header) {
+    if (buffer == nullptr || isCapturing()) {
+        return false;
+    }
+    if (seconds > DEEP_CAPTURE_MAX_SECONDS) {
+        seconds = DEEP_CAPTURE_MAX_SECONDS;
+    }
+
+    uint64_t frames = (uint64_t)seconds * sampleRateHz;
+    targetBlocks = (uint32_t)((frames + framesPerBlock - 1) / framesPerBlock);
+    if (targetBlocks == 0) {
+        targetBlocks = 1;
+    }
+
+    this->header = header;
+    for (int level = 0; level < DEEP_ENVELOPE_LEVELS; level++) {
+        envelopeCount[level].store(0, std::memory_order_relaxed);
+    }
+    envelopeFinal = false;
+    lateFrames = 0;
+    maxLateUs = 0;
+    committedBlocks.store(0, std::memory_order_relaxed);
+    stopRequested.store(false, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_relaxed);
+    state.store((uint8_t)DeepCaptureState::CAPTURING, std::memory_order_release);
+
+    Hal::log("[DeepCapture] Recording %lu s (%lu blocks)\n", (unsigned long)seconds, (unsigned long)targetBlocks);
+    return true;
+}
+
+void DeepCapture::stop() {
+    stopRequested.store(true, std::memory_order_relaxed);
+}
+
+bool DeepCapture::isCapturing() const {
+    return state.load(std::memory_order_acquire) == (uint8_t)DeepCaptureState::CAPTURING;
+}
+
+int16_t* DeepCapture::nextBlock() {
+    uint32_t blocks = committedBlocks.load(std::memory_order_relaxed);
+    if (blocks >= targetBlocks || stopRequested.load(std::memory_order_relaxed)) {
+        if (isCapturing()) {
+            state.store((uint8_t)DeepCaptureState::DONE, std::memory_order_release);
+            Hal::log("[DeepCapture] Done: %lu blocks, %lu late frames (max %lu us)\n",
+                     (unsigned long)blocks, (unsigned long)lateFrames, (unsigned long)maxLateUs);
+        }
+        return nullptr;
+    }
+    return samples + (size_t)blocks * framesPerBlock * channels;
+}
+
+void DeepCapture::commitBlock(uint32_t timestampMs, uint32_t lateFrames, uint32_t maxLateUs) {
+    uint32_t blocks = committedBlocks.load(std::memory_order_relaxed);
+
+    CaptureBlockHeader& block = blockHeaders[blocks];
+    block.magic = CAPTURE_BLOCK_MAGIC;
+    block.seq = blocks;
+    block.timestampMs = timestampMs;
+    block.frameCount = framesPerBlock;
+    block.flags = lateFrames > 0 ? CAPTURE_BLOCK_LATE : 0;
+
+    this->lateFrames += lateFrames;
+    if (maxLateUs > this->maxLateUs) {
+        this->maxLateUs = maxLateUs;
+    }
+
+    // Кадры и заголовок видны читателям раньше, чем новый счётчик блоков
+    committedBlocks.store(blocks + 1, std::memory_order_release);
+}
+
+void DeepCapture::update() {
+    if (buffer == nullptr || envelopeFinal) {
+        return;
+    }
+
+    // Сначала состояние, потом счётчик: после DONE блоков больше не будет
+    bool done = state.load(std::memory_order_acquire) == (uint8_t)DeepCaptureState::DONE;
+    uint32_t frames = committedBlocks.load(std::memory_order_acquire) * framesPerBlock;
+
+    // Уровень 0: только полные интервалы, хвост — когда запись закончена.
+    // Интервал публикуется счётчиком после того, как записан (читают веб-обработчики)
+    uint32_t count = envelopeCount[0].load(std::memory_order_relaxed);
+    while ((count + 1) * DEEP_ENVELOPE_BUCKET_FRAMES <= frames) {
+        buildBase(count, count * DEEP_ENVELOPE_BUCKET_FRAMES, DEEP_ENVELOPE_BUCKET_FRAMES);
+        envelopeCount[0].store(++count, std::memory_order_release);
+    }
+    if (done && count * DEEP_ENVELOPE_BUCKET_FRAMES < frames) {
+        buildBase(count, count * DEEP_ENVELOPE_BUCKET_FRAMES, frames - count * DEEP_ENVELOPE_BUCKET_FRAMES);
+        envelopeCount[0].store(++count, std::memory_order_release);
+    }
+
+    for (int level = 1; level < DEEP_ENVELOPE_LEVELS; level++) {
+        uint32_t children = count;
+        count = envelopeCount[level].load(std::memory_order_relaxed);
+        while ((count + 1) * DEEP_ENVELOPE_FACTOR <= children) {
+            buildLevel(level, count, DEEP_ENVELOPE_FACTOR);
+            envelopeCount[level].store(++count, std::memory_order_release);
+        }
+        if (done && count * DEEP_ENVELOPE_FACTOR < children) {
+            buildLevel(level, count, children - count * DEEP_ENVELOPE_FACTOR);
+            envelopeCount[level].store(++count, std::memory_order_release);
+        }
+    }
+
+    envelopeFinal = done;
+}
+
+void DeepCapture::buildBase(uint32_t bucket, uint32_t firstFrame, uint32_t count) {
+    int16_t* out = envelope[0] + (size_t)bucket * channels * 2;
+    const int16_t* frame = samples + (size_t)firstFrame * channels;
+    for (int ch = 0; ch < channels; ch++) {
+        out[ch * 2] = frame[ch];
+        out[ch * 2 + 1] = frame[ch];
+    }
+    for (uint32_t i = 1; i < count; i++) {
+        frame += channels;
+        for (int ch = 0; ch < channels; ch++) {
+            if (frame[ch] < out[ch * 2]) {
+                out[ch * 2] = frame[ch];
+            }
+            if (frame[ch] > out[ch * 2 + 1]) {
+                out[ch * 2 + 1] = frame[ch];
+            }
+        }
+    }
+}
+
+void DeepCapture::buildLevel(int level, uint32_t bucket, uint32_t count) {
+    int16_t* out = envelope[level] + (size_t)bucket * channels * 2;
+    const int16_t* child = envelope[level - 1] + (size_t)bucket * DEEP_ENVELOPE_FACTOR * channels * 2;
+    memcpy(out, child, channels * 2 * sizeof(int16_t));
+    for (uint32_t i = 1; i < count; i++) {
+        child += channels * 2;
+        for (int ch = 0; ch < channels; ch++) {
+            if (child[ch * 2] < out[ch * 2]) {
+                out[ch * 2] = child[ch * 2];
+            }
+            if (child[ch * 2 + 1] > out[ch * 2 + 1]) {
+                out[ch * 2 + 1] = child[ch * 2 + 1];
+            }
+        }
+    }
+}
+
+const int16_t* DeepCapture::latestBlock(uint32_t& seq, uint32_t& timestampMs) const {
+    uint32_t blocks = committedBlocks.load(std::memory_order_acquire);
+    if (buffer == nullptr || blocks == 0) {
+        return nullptr;
+    }
+    seq = blocks - 1;
+    timestampMs = blockHeaders[seq].timestampMs;
+    return samples + (size_t)seq * framesPerBlock * channels;
+}
+
+DeepCaptureStatus DeepCapture::getStatus() const {
+    DeepCaptureStatus status;
+    status.state = (DeepCaptureState)state.load(std::memory_order_acquire);
+    status.generation = generation.load(std::memory_order_relaxed);
+    status.blocks = committedBlocks.load(std::memory_order_acquire);
+    status.frames = status.blocks * framesPerBlock;
+    status.targetFrames = targetBlocks * framesPerBlock;
+    status.lateFrames = lateFrames;
+    status.maxLateUs = maxLateUs;
+    uint32_t envelopeFrames = envelopeCount[0].load(std::memory_order_acquire) * DEEP_ENVELOPE_BUCKET_FRAMES;
+    status.envelopeFrames = envelopeFrames < status.frames ? envelopeFrames : status.frames;
+    return status;
+}
+
+const CaptureHeader& DeepCapture::getHeader() const {
+    return header;
+}
+
+size_t DeepCapture::blockStride() const {
+    return sizeof(CaptureBlockHeader) + (size_t)framesPerBlock * channels * sizeof(int16_t);
+}
+
+size_t DeepCapture::readStream(uint32_t generation, size_t offset, uint8_t* out, size_t maxLen) const {
+    if (buffer == nullptr || generation != this->generation.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    bool capturing = isCapturing();
+    size_t available = sizeof(CaptureHeader) + committedBlocks.load(std::memory_order_acquire) * blockStride();
+    if (offset >= available) {
+        return capturing ? DEEP_STREAM_WAIT : 0;
+    }
+
+    size_t written = 0;
+    while (written < maxLen && offset < available) {
+        const uint8_t* source;
+        size_t length;
+        if (offset < sizeof(CaptureHeader)) {
+            source = reinterpret_cast<const uint8_t*>(&header) + offset;
+            length = sizeof(CaptureHeader) - offset;
+        } else {
+            // Блок в потоке — заголовок и кадры подряд, в буфере они лежат раздельно
+            size_t position = offset - sizeof(CaptureHeader);
+            size_t block = position / blockStride();
+            size_t within = position % blockStride();
+            if (within < sizeof(CaptureBlockHeader)) {
+                source = reinterpret_cast<const uint8_t*>(&blockHeaders[block]) + within;
+                length = sizeof(CaptureBlockHeader) - within;
+            } else {
+                within -= sizeof(CaptureBlockHeader);
+                source = reinterpret_cast<const uint8_t*>(samples + block * framesPerBlock * channels) + within;
+                length = blockStride() - sizeof(CaptureBlockHeader) - within;
+            }
+        }
+        if (length > maxLen - written) {
+            length = maxLen - written;
+        }
+        memcpy(out + written, source, length);
+        written += length;
+        offset += length;
+    }
+    return written;
+}
+
+DeepEnvelopeQuery DeepCapture::makeEnvelopeQuery(uint32_t fromFrame, uint32_t toFrame, uint32_t points) const {
+    DeepEnvelopeQuery query;
+    query.generation = generation.load(std::memory_order_relaxed);
+    query.level = 0;
+    query.firstBucket = 0;
+    query.bucketCount = 0;
+
+    if (toFrame <= fromFrame || points == 0) {
+        return query;
+    }
+
+    // Самый грубый уровень, который ещё даёт не меньше points интервалов на диапазон
+    uint32_t span = toFrame - fromFrame;
+    for (int level = DEEP_ENVELOPE_LEVELS - 1; level > 0; level--) {
+        if (span / framesPerBucket(level) >= points) {
+            query.level = level;
+            break;
+        }
+    }
+
+    uint32_t size = framesPerBucket(query.level);
+    uint32_t first = fromFrame / size;
+    uint32_t last = (toFrame + size - 1) / size;
+    uint32_t ready = envelopeCount[query.level].load(std::memory_order_acquire);
+    if (last > ready) {
+        last = ready;
+    }
+    if (first < last) {
+        query.firstBucket = first;
+        query.bucketCount = last - first;
+        if (query.bucketCount > DEEP_ENVELOPE_MAX_POINTS) {
+            query.bucketCount = DEEP_ENVELOPE_MAX_POINTS;
+        }
+    }
+    return query;
+}
+
+size_t DeepCapture::readEnvelope(const DeepEnvelopeQuery& query, size_t offset, uint8_t* out, size_t maxLen) const {
+    if (buffer == nullptr || query.generation != generation.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    DeepEnvelopeHeader head;
+    head.magic = DEEP_ENVELOPE_MAGIC;
+    head.level = query.level;
+    head.channelCount = channels;
+    head.reserved = 0;
+    head.framesPerBucket = framesPerBucket(query.level);
+    head.firstFrame = query.firstBucket * head.framesPerBucket;
+    head.bucketCount = query.bucketCount;
+
+    // Интервалы уровня лежат подряд: ответ — заголовок и один непрерывный участок
+    size_t bodySize = (size_t)query.bucketCount * channels * 2 * sizeof(int16_t);
+    const uint8_t* body = reinterpret_cast<const uint8_t*>(envelope[query.level] +
+                                                            (size_t)query.firstBucket * channels * 2);
+    size_t written = 0;
+    while (written < maxLen && offset < sizeof(head) + bodySize) {
+        const uint8_t* source;
+        size_t length;
+        if (offset < sizeof(head)) {
+            source = reinterpret_cast<const uint8_t*>(&head) + offset;
+            length = sizeof(head) - offset;
+        } else {
+            source = body + (offset - sizeof(head));
+            length = sizeof(head) + bodySize - offset;
+        }
+        if (length > maxLen - written) {
+            length = maxLen - written;
+        }
+        memcpy(out + written, source, length);
+        written += length;
+        offset += length;
+    }
+    return written;
+}
+
+uint32_t DeepCapture::framesPerBucket(int level) const {
+    uint32_t frames = DEEP_ENVELOPE_BUCKET_FRAMES;
+    for (int i = 0; i < level; i++) {
+        frames *= DEEP_ENVELOPE_FACTOR;
+    }
+    return frames;
+}
+
+const int16_t* DeepCapture::envelopeBucket(int level, uint32_t bucket) const {
+    return envelope[level] + (size_t)bucket * channels * 2;
+}
+
+uint32_t DeepCapture::envelopeBuckets(int level) const {
+    return envelopeCount[level].load(std::memory_order_acquire);
+}
+
+size_t DeepCapture::getBufferSize() const {
+    return bufferSize;
+}
@@ -0,0 +1,224 @@
+#ifndef DEEP_CAPTURE_H
+#define DEEP_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "config.h"
+#include "CaptureFormat.h"
+
+#define DEEP_ENVELOPE_MAGIC 0x564E4544    // "DENV" (little-endian)
+
+// readStream(): данных ещё нет, но запись идёт — спросить позже
+#define DEEP_STREAM_WAIT ((size_t)-1)
+
+enum class DeepCaptureState : uint8_t {
+    IDLE,           // Записи не было
+    CAPTURING,      // Задача оцифровки пишет блоки
+    DONE            // Буфер заполнен или запись остановлена
+};
+
+/**
+ * Состояние записи для /deep и журнала
+ */
+struct DeepCaptureStatus {
+    DeepCaptureState state;
+    uint32_t generation;        // Номер записи (растёт с каждым start)
+    uint32_t blocks;            // Записано блоков
+    uint32_t frames;            // Записано кадров
+    uint32_t targetFrames;      // Запрошено кадров
+    uint32_t lateFrames;        // Кадров позже расписания больше SAMPLE_JITTER_THRESHOLD_US
+    uint32_t maxLateUs;
+    uint32_t envelopeFrames;    // Кадров, уже разложенных в пирамиду огибающей
+};
+
+/**
+ * Заголовок ответа /deep/envelope (little-endian, без выравнивания).
+ * За ним bucketCount интервалов, в каждом по каналу пара int16 (min, max)
+ * в единицах кадра (отсчёты ADC, с передискретизацией × 2^OVERSAMPLE_FRACTION_BITS):
+ * вольты — (отсчёт - offset) × calibration из /deep.
+ */
+struct __attribute__((packed)) DeepEnvelopeHeader {
+    uint32_t magic;             // DEEP_ENVELOPE_MAGIC
+    uint8_t level;              // Уровень пирамиды (0 — самый подробный)
+    uint8_t channelCount;
+    uint16_t reserved;
+    uint32_t framesPerBucket;
+    uint32_t firstFrame;        // Первый кадр первого интервала
+    uint32_t bucketCount;
+};
+
+static_assert(sizeof(DeepEnvelopeHeader) == 20, "DeepEnvelopeHeader layout changed");
+
+/**
+ * Выборка огибающей для одного ответа (makeEnvelopeQuery)
+ */
+struct DeepEnvelopeQuery {
+    uint32_t generation;
+    uint8_t level;
+    uint32_t firstBucket;
+    uint32_t bucketCount;
+};
+
+/**
+ * Глубокий захват: секунды сырых отсчётов без разрывов во внешней памяти (PSRAM)
+ *
+ * Писатель — задача оцифровки: берёт место под блок (nextBlock), заполняет его
+ * PowerAnalyzer::acquire() по расписанию встык с предыдущим и публикует
+ * (commitBlock). Всё остальное идёт из других задач и писателя не задерживает:
+ *   - update() в loop() достраивает пирамиду min/max по готовым блокам:
+ *     уровень 0 — DEEP_ENVELOPE_BUCKET_FRAMES кадров на интервал, каждый
+ *     следующий объединяет DEEP_ENVELOPE_FACTOR интервалов предыдущего.
+ *     Обзор всей записи на экран — несколько сотен интервалов верхнего уровня
+ *     вместо сотен тысяч кадров;
+ *   - readStream() и readEnvelope() отдают веб-серверу данные кусками по
+ *     смещению, прямо из буфера, пока запись ещё идёт.
+ * Полное разрешение отдаётся в формате файла захвата (CaptureFormat.h),
+ * поэтому его воспроизводит bench --replay.
+ *
+ * Буфер выделяется один раз в begin() на DEEP_CAPTURE_MAX_SECONDS и
+ * переиспользуется; новая запись делает недействительными потоки прошлой
+ * (generation).
+ */
+class DeepCapture {
+public:
+    DeepCapture();
+    ~DeepCapture();
+
+    /**
+     * Выделить буфер под кадры, заголовки блоков и пирамиду
+     * @param channels Каналов в кадре (PowerAnalyzer::CHANNELS)
+     * @param framesPerBlock Кадров в блоке (PowerAnalyzer::FRAMES_PER_BLOCK)
+     * @param sampleRateHz Кадров в секунду
+     * @return false если внешней памяти нет или не хватает
+     */
+    bool begin(int channels, int framesPerBlock, uint32_t sampleRateHz);
+
+    /**
+     * Есть ли буфер (PSRAM найдена и выделена)
+     */
+    bool isAvailable() const;
+
+    /**
+     * Начать новую запись (прошлая теряется). Вызывать, когда писатель не работает.
+     * @param seconds Длительность, не больше DEEP_CAPTURE_MAX_SECONDS
+     * @param header Заголовок потока (PowerAnalyzer::describeCapture)
+     * @return false если буфера нет или идёт запись
+     */
+    bool start(uint32_t seconds, const CaptureHeader& header);
+
+    /**
+     * Попросить писателя остановиться после текущего блока
+     */
+    void stop();
+
+    bool isCapturing() const;
+
+    /**
+     * Место под следующий блок (только писатель)
+     * @return nullptr если запись закончена — буфер заполнен или был stop()
+     */
+    int16_t* nextBlock();
+
+    /**
+     * Опубликовать заполненный блок (только писатель)
+     * @param timestampMs millis() в конце блока
+     */
+    void commitBlock(uint32_t timestampMs, uint32_t lateFrames, uint32_t maxLateUs);
+
+    /**
+     * Достроить пирамиду огибающей по опубликованным блокам (из loop())
+     */
+    void update();
+
+    /**
+     * Последний опубликованный блок (для измерений во время записи)
+     * @param seq Номер блока
+     * @param timestampMs Метка времени блока
+     * @return nullptr если блоков ещё нет
+     */
+    const int16_t* latestBlock(uint32_t& seq, uint32_t& timestampMs) const;
+
+    DeepCaptureStatus getStatus() const;
+
+    const CaptureHeader& getHeader() const;
+
+    /**
+     * Кусок потока полного разрешения: CaptureHeader, затем блоки
+     * @param generation Номер записи, с которой начат поток
+     * @param offset Смещение в потоке
+     * @return Записано байт; 0 — конец (или началась новая запись);
+     *         DEEP_STREAM_WAIT — данные ещё пишутся
+     */
+    size_t readStream(uint32_t generation, size_t offset, uint8_t* out, size_t maxLen) const;
+
+    /**
+     * Выбрать уровень и интервалы огибающей для показа кадров [fromFrame, toFrame)
+     * не меньше чем points точками (или самым подробным уровнем)
+     */
+    DeepEnvelopeQuery makeEnvelopeQuery(uint32_t fromFrame, uint32_t toFrame, uint32_t points) const;
+
+    /**
+     * Кусок ответа огибающей: DeepEnvelopeHeader, затем интервалы
+     * @return Записано байт; 0 — конец (или началась новая запись)
+     */
+    size_t readEnvelope(const DeepEnvelopeQuery& query, size_t offset, uint8_t* out, size_t maxLen) const;
+
+    /**
+     * Кадров в интервале уровня
+     */
+    uint32_t framesPerBucket(int level) const;
+
+    /**
+     * Интервал уровня: по каналу пара (min, max); только готовые интервалы
+     */
+    const int16_t* envelopeBucket(int level, uint32_t bucket) const;
+
+    /**
+     * Готовых интервалов уровня
+     */
+    uint32_t envelopeBuckets(int level) const;
+
+    /**
+     * Размер буфера, байт
+     */
+    size_t getBufferSize() const;
+
+private:
+    uint8_t* buffer;
+    size_t bufferSize;
+    int16_t* samples;
+    CaptureBlockHeader* blockHeaders;
+    int16_t* envelope[DEEP_ENVELOPE_LEVELS];
+    uint32_t envelopeCapacity[DEEP_ENVELOPE_LEVELS];
+    std::atomic<uint32_t> envelopeCount[DEEP_ENVELOPE_LEVELS];     // Готовые интервалы (пишет update())
+    bool envelopeFinal;
+
+    int channels;
+    int framesPerBlock;
+    uint32_t sampleRateHz;
+    uint32_t maxBlocks;
+    uint32_t targetBlocks;
+    CaptureHeader header;
+
+    std::atomic<uint8_t> state;
+    std::atomic<uint32_t> generation;
+    std::atomic<uint32_t> committedBlocks;
+    std::atomic<bool> stopRequested;
+    uint32_t lateFrames;
+    uint32_t maxLateUs;
+
+    size_t blockStride() const;
+
+    /**
+     * Интервал уровня 0 из кадров [first, first + count)
+     */
+    void buildBase(uint32_t bucket, uint32_t firstFrame, uint32_t count);
+
+    /**
+     * Интервал уровня level из count интервалов уровня level - 1
+     */
+    void buildLevel(int level, uint32_t bucket, uint32_t count);
+};
+
+#endif // DEEP_CAPTURE_H
@@ -0,0 +1,190 @@
+#include "DeepCaptureServer.h"
+#include <time.h>
+
+DeepCaptureServer::DeepCaptureServer(PowerAnalyzer& analyzer, DeepCapture& capture)
+    : analyzer(analyzer),
+      capture(capture),
+      samplerTask(nullptr),
+      samplerRunning(false),
+      pendingSeconds(0) {
+}
+
+void DeepCaptureServer::begin(AsyncWebServer& server) {
+    server.on("/deep", HTTP_POST, [this](AsyncWebServerRequest* request) {
+        if (!capture.isAvailable()) {
+            request->send(503, "text/plain", "no PSRAM");
+            return;
+        }
+        if (request->hasParam("stop")) {
+            pendingSeconds = -1;
+            request->send(200, "text/plain", "stopping");
+            return;
+        }
+        int32_t seconds = DEEP_CAPTURE_DEFAULT_SECONDS;
+        if (request->hasParam("seconds")) {
+            seconds = request->getParam("seconds")->value().toInt();
+        }
+        if (seconds <= 0 || seconds > DEEP_CAPTURE_MAX_SECONDS) {
+            request->send(400, "text/plain", "seconds must be 1.." + String(DEEP_CAPTURE_MAX_SECONDS));
+            return;
+        }
+        pendingSeconds = seconds;
+        request->send(202, "text/plain", "recording");
+    });
+    server.on("/deep/envelope", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleEnvelope(request);
+    });
+    server.on("/deep/data", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleData(request);
+    });
+    server.on("/deep", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleStatus(request);
+    });
+
+    Serial.printf("[DeepCapture] Endpoints at /deep, /deep/envelope, /deep/data (%s)\n",
+                  capture.isAvailable() ? "PSRAM ready" : "no PSRAM");
+}
+
+void DeepCaptureServer::handleStatus(AsyncWebServerRequest* request) {
+    DeepCaptureStatus status = capture.getStatus();
+    const CaptureHeader& header = capture.getHeader();
+    static const char* const STATES[] = {"idle", "capturing", "done"};
+
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->printf("{\"available\":%s,\"state\":\"%s\",\"generation\":%lu,"
+                     "\"frames\":%lu,\"target_frames\":%lu,\"envelope_frames\":%lu,"
+                     "\"late_frames\":%lu,\"max_late_us\":%lu,",
+                     capture.isAvailable() ? "true" : "false", STATES[(int)status.state],
+                     (unsigned long)status.generation, (unsigned long)status.frames,
+                     (unsigned long)status.targetFrames, (unsigned long)status.envelopeFrames,
+                     (unsigned long)status.lateFrames, (unsigned long)status.maxLateUs);
+    response->printf("\"sample_rate_hz\":%lu,\"channels\":%d,\"frames_per_block\":%d,"
+                     "\"envelope\":{\"bucket_frames\":%d,\"factor\":%d,\"levels\":%d,\"max_points\":%d},",
+                     (unsigned long)PowerAnalyzer::SAMPLE_RATE_HZ, PowerAnalyzer::CHANNELS,
+                     PowerAnalyzer::FRAMES_PER_BLOCK, DEEP_ENVELOPE_BUCKET_FRAMES,
+                     DEEP_ENVELOPE_FACTOR, DEEP_ENVELOPE_LEVELS, DEEP_ENVELOPE_MAX_POINTS);
+
+    // Смещения и калибровка — из заголовка записи, а не текущие: те продолжают подстраиваться
+    response->print("\"channel_map\":\"");
+    for (int ch = 0; ch < PowerAnalyzer::CHANNELS; ch++) {
+        response->print(header.channelMap[ch] != 0 ? header.channelMap[ch] : '-');
+    }
+    response->print("\",\"offsets\":[");
+    for (int ch = 0; ch < PowerAnalyzer::CHANNELS; ch++) {
+        response->printf("%s%.2f", ch > 0 ? "," : "", header.offsets[ch]);
+    }
+    response->print("],\"calibration\":[");
+    for (int ch = 0; ch < PowerAnalyzer::CHANNELS; ch++) {
+        response->printf("%s%.6f", ch > 0 ? "," : "", header.calibration[ch]);
+    }
+    response->printf("],\"start_unix_time\":%lu}", (unsigned long)header.startUnixTime);
+    request->send(response);
+}
+
+void DeepCaptureServer::handleEnvelope(AsyncWebServerRequest* request) {
+    DeepCaptureStatus status = capture.getStatus();
+    uint32_t from = 0;
+    uint32_t to = status.envelopeFrames;
+    uint32_t points = 1000;
+    if (request->hasParam("from")) {
+        from = request->getParam("from")->value().toInt();
+    }
+    if (request->hasParam("to")) {
+        to = request->getParam("to")->value().toInt();
+    }
+    if (request->hasParam("points")) {
+        points = request->getParam("points")->value().toInt();
+    }
+    if (points == 0 || points > DEEP_ENVELOPE_MAX_POINTS) {
+        points = DEEP_ENVELOPE_MAX_POINTS;
+    }
+
+    DeepEnvelopeQuery query = capture.makeEnvelopeQuery(from, to, points);
+    DeepCapture* source = &capture;
+    AsyncWebServerResponse* response = request->beginChunkedResponse(
+        "application/octet-stream",
+        [source, query](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            return source->readEnvelope(query, index, buffer, maxLen);
+        });
+    request->send(response);
+}
+
+void DeepCaptureServer::handleData(AsyncWebServerRequest* request) {
+    if (capture.getStatus().state == DeepCaptureState::IDLE) {
+        request->send(404, "text/plain", "no deep capture");
+        return;
+    }
+
+    uint32_t generation = capture.getStatus().generation;
+    DeepCapture* source = &capture;
+    AsyncWebServerResponse* response = request->beginChunkedResponse(
+        "application/octet-stream",
+        [source, generation](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            size_t length = source->readStream(generation, index, buffer, maxLen);
+            return length == DEEP_STREAM_WAIT ? RESPONSE_TRY_AGAIN : length;
+        });
+    response->addHeader("Content-Disposition", "attachment; filename=deep.bin");
+    request->send(response);
+}
+
+void DeepCaptureServer::loop(bool adcBusy) {
+    int32_t request = pendingSeconds;
+    if (request != 0) {
+        pendingSeconds = 0;
+        if (request < 0) {
+            capture.stop();
+        } else if (samplerRunning) {
+            Serial.println("[DeepCapture] Already recording");
+        } else if (adcBusy) {
+            Serial.println("[DeepCapture] ADC busy (PMU mode), not started");
+        } else {
+            CaptureHeader header;
+            time_t now = time(nullptr);
+            analyzer.describeCapture(header, DEVICE_ID, now > 1700000000 ? (uint32_t)now : 0);
+            if (capture.start(request, header)) {
+                samplerRunning = true;
+                if (xTaskCreatePinnedToCore(samplerLoop, "deep_capture", 4096, this,
+                                            DEEP_CAPTURE_PRIORITY, &samplerTask, DEEP_CAPTURE_CORE) != pdPASS) {
+                    Serial.println("[DeepCapture] Sampler task not created");
+                    // Писателя нет: stop() и nextBlock() закрывают пустую запись
+                    capture.stop();
+                    capture.nextBlock();
+                    samplerRunning = false;
+                }
+            }
+        }
+    }
+
+    capture.update();
+}
+
+bool DeepCaptureServer::isSampling() const {
+    return samplerRunning;
+}
+
+bool DeepCaptureServer::hasStartRequest() const {
+    return pendingSeconds > 0;
+}
+
+void DeepCaptureServer::samplerLoop(void* arg) {
+    DeepCaptureServer* self = static_cast<DeepCaptureServer*>(arg);
+
+    // Задача не уступает процессор всю запись: сторож простоя ядра 0 молчит до конца
+    disableCore0WDT();
+
+    // Расписание сквозное: блок n начинается ровно там, где закончился n-1
+    const uint32_t blockUs = PowerAnalyzer::FRAMES_PER_BLOCK * PowerAnalyzer::INTERVAL_US;
+    uint32_t startUs = PowerAnalyzer::startNowUs();
+    int16_t* block;
+    while ((block = self->capture.nextBlock()) != nullptr) {
+        uint32_t maxLateUs;
+        uint32_t late = self->analyzer.acquire(block, startUs, maxLateUs);
+        self->capture.commitBlock(Hal::millis(), late, maxLateUs);
+        startUs += blockUs;
+    }
+
+    enableCore0WDT();
+    self->samplerRunning = false;
+    self->samplerTask = nullptr;
+    vTaskDelete(nullptr);
+}
@@ -0,0 +1,66 @@
+#ifndef DEEP_CAPTURE_SERVER_H
+#define DEEP_CAPTURE_SERVER_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "PowerAnalyzer.h"
+#include "DeepCapture.h"
+
+/**
+ * HTTP-управление глубоким захватом и задача оцифровки
+ *
+ *   POST /deep?seconds=N   — начать запись (POST /deep?stop=1 — остановить)
+ *   GET  /deep             — состояние и параметры для перевода отсчётов в вольты
+ *   GET  /deep/envelope    — огибающая min/max диапазона кадров (DeepEnvelopeHeader)
+ *   GET  /deep/data        — полное разрешение в формате файла захвата
+ *
+ * Ответы /deep/envelope и /deep/data идут chunked прямо из буфера PSRAM;
+ * /deep/data можно начать качать во время записи — сервер ждёт новые блоки.
+ * Пока идёт запись, АЦП занят задачей оцифровки на DEEP_CAPTURE_CORE.
+ */
+class DeepCaptureServer {
+public:
+    DeepCaptureServer(PowerAnalyzer& analyzer, DeepCapture& capture);
+
+    /**
+     * Зарегистрировать обработчики на веб-сервере
+     */
+    void begin(AsyncWebServer& server);
+
+    /**
+     * Запуск/остановка по запросам и достройка огибающей (из loop())
+     * @param adcBusy АЦП занят другой задачей (режим PMU) — запись не начинается
+     */
+    void loop(bool adcBusy);
+
+    /**
+     * Работает ли задача оцифровки (loop() не должен трогать АЦП)
+     */
+    bool isSampling() const;
+
+    /**
+     * Запрошен ли запуск (loop() ещё не обработал): АЦП скоро понадобится
+     */
+    bool hasStartRequest() const;
+
+private:
+    PowerAnalyzer& analyzer;
+    DeepCapture& capture;
+    TaskHandle_t samplerTask;
+    volatile bool samplerRunning;
+
+    // Запрос из веб-обработчика (задача async_tcp): >0 — секунды записи, -1 — остановить
+    volatile int32_t pendingSeconds;
+
+    void handleStatus(AsyncWebServerRequest* request);
+    void handleEnvelope(AsyncWebServerRequest* request);
+    void handleData(AsyncWebServerRequest* request);
+
+    /**
+     * Задача оцифровки: блоки встык по расписанию, пока DeepCapture даёт место
+     */
+    static void samplerLoop(void* arg);
+};
+
+#endif // DEEP_CAPTURE_SERVER_H
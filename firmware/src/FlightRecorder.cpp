@@ -0,0 +1,300 @@
+#include "FlightRecorder.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include "LineProtocol.h"
+
+#define FLIGHTREC_MAGIC 0x464C5243u     // "FLRC"
+#define FLIGHTREC_VERSION 1
+
+// Смещение записи — uint32: база переносится раньше, чем оно переполнится (~24 дня)
+#define FLIGHTREC_REBASE_MS 0x7FFFFFFFull
+
+static_assert(sizeof(FlightRecord) == 12, "FlightRecord must stay 12 bytes");
+static_assert(sizeof(FlightRecorderHeader) + FLIGHTREC_RECORDS * sizeof(FlightRecord) <= RETAINED_MEMORY_BYTES,
+              "FLIGHTREC_RECORDS does not fit RETAINED_MEMORY_BYTES");
+
+FlightRecorder::FlightRecorder()
+    : header(nullptr),
+      ring(nullptr),
+      ready(false),
+      channels(0),
+      intervalUs(0),
+      periodFrames(1),
+      nominalFrequency(NOMINAL_FREQUENCY),
+      cycleFrames(0),
+      frameCount(0),
+      anchorFrame(0),
+      anchorUtcUs(0),
+      recordCount(0),
+      preserved(nullptr),
+      preservedCount(0),
+      resetReason(ResetReason::POWER_ON),
+      preservedBaseMs(0),
+      preservedTimeValid(false),
+      preservedChannels(0),
+      preservedNominal(NOMINAL_FREQUENCY) {
+    memset(offsets, 0, sizeof(offsets));
+    memset(scales, 0, sizeof(scales));
+    memset(sumSquares, 0, sizeof(sumSquares));
+}
+
+FlightRecorder::~FlightRecorder() {
+    releasePreserved();
+}
+
+bool FlightRecorder::attach() {
+    if (header != nullptr) {
+        return true;
+    }
+    size_t size;
+    uint8_t* memory = static_cast<uint8_t*>(Hal::retainedMemory(size));
+    if (memory == nullptr || size < sizeof(FlightRecorderHeader) + FLIGHTREC_RECORDS * sizeof(FlightRecord)) {
+        return false;
+    }
+    header = reinterpret_cast<FlightRecorderHeader*>(memory);
+    ring = reinterpret_cast<FlightRecord*>(memory + sizeof(FlightRecorderHeader));
+    return true;
+}
+
+int FlightRecorder::restore(ResetReason reason) {
+    releasePreserved();
+    resetReason = reason;
+    if (!attach()) {
+        return 0;
+    }
+
+    // После включения питания содержимое случайно — даже верная сумма ничего не значит
+    const FlightRecorderHeader& h = *header;
+    bool valid = reason != ResetReason::POWER_ON && h.magic == FLIGHTREC_MAGIC && h.version == FLIGHTREC_VERSION &&
+                 h.capacity == FLIGHTREC_RECORDS && h.channels >= 1 && h.channels <= FLIGHTREC_MAX_CHANNELS &&
+                 h.checksum == headerChecksum(h);
+    if (valid) {
+        uint32_t head = h.head;
+        int count = head < FLIGHTREC_RECORDS ? (int)head : FLIGHTREC_RECORDS;
+        if (count > 0) {
+            preserved = static_cast<FlightRecord*>(malloc(count * sizeof(FlightRecord)));
+        }
+        if (preserved != nullptr) {
+            // Старейшая запись первой
+            for (int i = 0; i < count; i++) {
+                preserved[i] = ring[(head - count + i) % FLIGHTREC_RECORDS];
+            }
+            preservedCount = count;
+            preservedBaseMs = h.baseMs;
+            preservedTimeValid = h.timeValid != 0;
+            preservedChannels = h.channels;
+            preservedNominal = h.nominalFrequency;
+        }
+    }
+
+    initHeader(0, false);
+    return preservedCount;
+}
+
+bool FlightRecorder::begin(int channels, uint32_t sampleRateHz, float nominalFrequency,
+                           const float* offsets, const float* sensitivities) {
+    ready = false;
+    if (!attach() || channels < 1 || channels > FLIGHTREC_MAX_CHANNELS || sampleRateHz == 0 ||
+        1000000 % sampleRateHz != 0) {
+        return false;
+    }
+    this->channels = channels;
+    this->nominalFrequency = nominalFrequency;
+    intervalUs = 1000000 / sampleRateHz;
+    periodFrames = (uint32_t)lroundf(sampleRateHz / nominalFrequency);
+    for (int ch = 0; ch < channels; ch++) {
+        this->offsets[ch] = offsets[ch];
+        scales[ch] = sensitivities[ch] * 10.0f;
+        sumSquares[ch] = 0.0f;
+    }
+    cycleFrames = 0;
+    frameCount = 0;
+    anchorFrame = 0;
+    anchorUtcUs = 0;
+    ready = true;
+    return true;
+}
+
+void FlightRecorder::initHeader(uint64_t baseMs, bool timeValid) {
+    // head — первым: сброс посреди записи оставит пустое кольцо или неверную сумму
+    header->head = 0;
+    header->magic = FLIGHTREC_MAGIC;
+    header->version = FLIGHTREC_VERSION;
+    header->capacity = FLIGHTREC_RECORDS;
+    header->channels = (uint8_t)(channels > 0 ? channels : 1);
+    header->timeValid = timeValid ? 1 : 0;
+    header->reserved = 0;
+    header->nominalFrequency = nominalFrequency;
+    header->baseMs = baseMs;
+    header->checksum = headerChecksum(*header);
+}
+
+void FlightRecorder::beginBlock(uint64_t utcUs, bool timeValid) {
+    if (!ready) {
+        return;
+    }
+    anchorFrame = frameCount;
+    anchorUtcUs = utcUs;
+
+    // Новая база: до первой записи, при смене источника времени или настроек, перед переполнением смещения
+    const FlightRecorderHeader& h = *header;
+    uint64_t blockMs = utcUs / 1000;
+    if (h.head == 0 || h.timeValid != (timeValid ? 1 : 0) || h.channels != channels ||
+        h.nominalFrequency != nominalFrequency || blockMs < h.baseMs || blockMs - h.baseMs > FLIGHTREC_REBASE_MS) {
+        initHeader(blockMs, timeValid);
+    }
+}
+
+void FlightRecorder::push(const int16_t* frame, float frequency) {
+    if (!ready) {
+        return;
+    }
+    for (int ch = 0; ch < channels; ch++) {
+        float d = frame[ch] - offsets[ch];
+        sumSquares[ch] += d * d;
+    }
+    frameCount++;
+    if (++cycleFrames == periodFrames) {
+        finishCycle(frequency);
+    }
+}
+
+void FlightRecorder::finishCycle(float frequency) {
+    FlightRecord record;
+    uint64_t endUs = anchorUtcUs + (uint64_t)(frameCount - anchorFrame) * intervalUs;
+    record.timeOffsetMs = (uint32_t)(endUs / 1000 - header->baseMs);
+    if (isnan(frequency)) {
+        record.frequencyMhz = FLIGHTREC_NO_FREQUENCY;
+    } else {
+        long mhz = lroundf((frequency - nominalFrequency) * 1000.0f);
+        record.frequencyMhz = (int16_t)(mhz < -32767 ? -32767 : (mhz > 32767 ? 32767 : mhz));
+    }
+    for (int ch = 0; ch < FLIGHTREC_MAX_CHANNELS; ch++) {
+        float rms = 0.0f;
+        if (ch < channels) {
+            rms = sqrtf(sumSquares[ch] / cycleFrames) * scales[ch];
+            sumSquares[ch] = 0.0f;
+        }
+        record.rmsDeciV[ch] = (uint16_t)(rms < 65535.0f ? rms + 0.5f : 65535.0f);
+    }
+    cycleFrames = 0;
+
+    uint32_t head = header->head;
+    ring[head % FLIGHTREC_RECORDS] = record;
+    // Запись — до head: сброс между ними оставляет недописанную запись за кольцом
+    std::atomic_signal_fence(std::memory_order_release);
+    header->head = head + 1;
+    recordCount++;
+}
+
+uint32_t FlightRecorder::getRecordCount() const {
+    return recordCount;
+}
+
+int FlightRecorder::getPreservedCount() const {
+    return preservedCount;
+}
+
+ResetReason FlightRecorder::getResetReason() const {
+    return resetReason;
+}
+
+const FlightRecord* FlightRecorder::getPreserved() const {
+    return preserved;
+}
+
+float FlightRecorder::getPreservedMinVoltage() const {
+    uint16_t minimum = UINT16_MAX;
+    for (int i = 0; i < preservedCount; i++) {
+        for (int ch = 0; ch < preservedChannels; ch++) {
+            if (preserved[i].rmsDeciV[ch] < minimum) {
+                minimum = preserved[i].rmsDeciV[ch];
+            }
+        }
+    }
+    return preservedCount > 0 ? minimum / 10.0f : 0.0f;
+}
+
+uint32_t FlightRecorder::getPreservedSpanMs() const {
+    if (preservedCount == 0) {
+        return 0;
+    }
+    return preserved[preservedCount - 1].timeOffsetMs - preserved[0].timeOffsetMs;
+}
+
+void FlightRecorder::releasePreserved() {
+    free(preserved);
+    preserved = nullptr;
+    preservedCount = 0;
+}
+
+size_t FlightRecorder::writeLineProtocol(int first, int count, char* buffer, size_t size,
+                                         const char* deviceId, uint64_t bootUtcMs) const {
+    static const char* const voltageKeys[FLIGHTREC_MAX_CHANNELS] = {"v_a", "v_b", "v_c"};
+    LineWriter out(buffer, size);
+    if (first < 0 || first >= preservedCount) {
+        return 0;
+    }
+    if (count > preservedCount - first) {
+        count = preservedCount - first;
+    }
+    const uint32_t lastOffsetMs = preserved[preservedCount - 1].timeOffsetMs;
+    for (int i = first; i < first + count; i++) {
+        const FlightRecord& r = preserved[i];
+        uint64_t timeMs = preservedTimeValid ? preservedBaseMs + r.timeOffsetMs
+                                             : bootUtcMs - (lastOffsetMs - r.timeOffsetMs);
+        out.begin("flight_record");
+        out.tag("device", deviceId);
+        out.tag("reset", resetReasonName(resetReason));
+        // Без NTP до сброса метки отсчитаны от этой загрузки: время перезапуска не учтено
+        out.tag("clock", preservedTimeValid ? "ntp" : "boot");
+        for (int ch = 0; ch < preservedChannels; ch++) {
+            out.field(voltageKeys[ch], r.rmsDeciV[ch] / 10.0f, 1);
+        }
+        if (r.frequencyMhz != FLIGHTREC_NO_FREQUENCY) {
+            out.field("frequency", preservedNominal + r.frequencyMhz / 1000.0f, 3);
+        }
+        out.end(timeMs);
+    }
+    return out.overflowed() ? 0 : out.length();
+}
+
+const char* FlightRecorder::resetReasonName(ResetReason reason) {
+    switch (reason) {
+        case ResetReason::POWER_ON:
+            return "power_on";
+        case ResetReason::BROWNOUT:
+            return "brownout";
+        case ResetReason::WATCHDOG:
+            return "watchdog";
+        case ResetReason::PANIC:
+            return "panic";
+        case ResetReason::SOFTWARE:
+            return "software";
+        default:
+            return "other";
+    }
+}
+
+uint32_t FlightRecorder::headerChecksum(const FlightRecorderHeader& h) {
+    // FNV-1a по полям, кроме head и самой суммы
+    uint32_t words[6];
+    uint32_t nominalBits;
+    memcpy(&nominalBits, &h.nominalFrequency, sizeof(nominalBits));
+    words[0] = h.magic;
+    words[1] = h.version | ((uint32_t)h.capacity << 16);
+    words[2] = h.channels | ((uint32_t)h.timeValid << 8) | ((uint32_t)h.reserved << 16);
+    words[3] = nominalBits;
+    words[4] = (uint32_t)h.baseMs;
+    words[5] = (uint32_t)(h.baseMs >> 32);
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        for (int b = 0; b < 4; b++) {
+            hash ^= (words[i] >> (8 * b)) & 0xFF;
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,169 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "hal/Hal.h"
+
+// Каналов напряжения в записи (трёхфазная схема)
+#define FLIGHTREC_MAX_CHANNELS 3
+
+// Точки flight_record одного запроса (DEVICE_ID до 32 символов)
+#define FLIGHTREC_LINE_PROTOCOL_SIZE (FLIGHTREC_UPLOAD_CHUNK * 160)
+
+// Частоты в записи нет (ни у одной фазы свежего периода)
+#define FLIGHTREC_NO_FREQUENCY INT16_MIN
+
+/**
+ * Запись одного номинального периода, 12 байт
+ */
+struct FlightRecord {
+    uint32_t timeOffsetMs;      // Конец периода от FlightRecorderHeader::baseMs
+    int16_t frequencyMhz;       // f - f0, мГц; FLIGHTREC_NO_FREQUENCY — нет
+    uint16_t rmsDeciV[FLIGHTREC_MAX_CHANNELS];  // RMS фаз за период, 0.1 В
+};
+
+/**
+ * Заголовок кольца в RTC-памяти. Всё, кроме head, меняется редко (запуск,
+ * синхронизация NTP) и закрыто checksum: сброс посреди его записи даёт
+ * пустое кольцо, а не чужие данные.
+ */
+struct FlightRecorderHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t capacity;
+    uint8_t channels;
+    uint8_t timeValid;          // baseMs — UTC (иначе millis() прошлой загрузки)
+    uint16_t reserved;
+    float nominalFrequency;
+    uint64_t baseMs;
+    uint32_t checksum;
+    volatile uint32_t head;     // Записей с baseMs; растёт после записи, поэтому недописанная не видна
+};
+
+/**
+ * Бортовой самописец: RMS и частота каждого периода в памяти, которую
+ * перезагрузка не стирает (Hal::retainedMemory(), на ESP32 — RTC slow memory)
+ *
+ * Задача оцифровки отдаёт каждый кадр в push() вместе с текущей частотой
+ * FrequencyTracker. Кадр стоит умножение и сложение на канал; раз в
+ * номинальный период (кадров SAMPLE_RATE / f0, без подстройки под частоту —
+ * при отклонении на 1 % RMS дрожит в пределах долей процента) запись
+ * уходит в кольцо на FLIGHTREC_RECORDS периодов.
+ *
+ * При загрузке restore() по причине сброса решает, чему верить: после
+ * включения питания память не определена, иначе проверенное кольцо
+ * копируется в обычную RAM (для отправки) и запись начинается заново.
+ * Время записей — смещение от baseMs заголовка; при смене источника
+ * времени (NTP) и раз в ~24 дня кольцо начинается заново с новой базой.
+ */
+class FlightRecorder {
+public:
+    FlightRecorder();
+    ~FlightRecorder();
+
+    /**
+     * При загрузке, до запуска оцифровки: сохранить кольцо прошлой загрузки
+     * и подготовить пустое
+     * @param reason Hal::resetReason()
+     * @return Сохранённых записей (0 — после включения питания или кольцо испорчено)
+     */
+    int restore(ResetReason reason);
+
+    /**
+     * Настроить запись (при запуске задачи оцифровки)
+     * @param channels Каналов напряжения (первые в кадре)
+     * @param sampleRateHz Кадров в секунду
+     * @param nominalFrequency f0, Гц
+     * @param offsets Смещения каналов, отсчёты АЦП
+     * @param sensitivities Вольт на отсчёт (PowerAnalyzer::getSensitivity())
+     * @return false если памяти RETAINED_MEMORY_BYTES не хватает на кольцо
+     */
+    bool begin(int channels, uint32_t sampleRateHz, float nominalFrequency,
+               const float* offsets, const float* sensitivities);
+
+    /**
+     * Начало блока кадров (задача оцифровки)
+     * @param utcUs Время первого кадра блока
+     * @param timeValid Время от NTP (иначе — с загрузки)
+     */
+    void beginBlock(uint64_t utcUs, bool timeValid);
+
+    /**
+     * Кадр АЦП (задача оцифровки)
+     * @param frequency FrequencyTracker::getFrequency(), NAN — нет
+     */
+    void push(const int16_t* frame, float frequency);
+
+    /**
+     * Записей в кольцо с загрузки
+     */
+    uint32_t getRecordCount() const;
+
+    /**
+     * Сохранённая при загрузке запись (до releasePreserved())
+     */
+    int getPreservedCount() const;
+    ResetReason getResetReason() const;
+    const FlightRecord* getPreserved() const;
+
+    /**
+     * Наименьшее напряжение и длительность сохранённой записи (для журнала)
+     */
+    float getPreservedMinVoltage() const;
+    uint32_t getPreservedSpanMs() const;
+
+    /**
+     * Освободить сохранённую запись после отправки
+     */
+    void releasePreserved();
+
+    /**
+     * Сохранённые записи [first, first + count) как точки flight_record
+     * @param bootUtcMs UTC этой загрузки: метки записей без NTP отсчитываются
+     *        так, чтобы последняя пришлась на неё
+     * @return Длина или 0 при переполнении буфера
+     */
+    size_t writeLineProtocol(int first, int count, char* buffer, size_t size,
+                             const char* deviceId, uint64_t bootUtcMs) const;
+
+    /**
+     * Значение тега reset
+     */
+    static const char* resetReasonName(ResetReason reason);
+
+private:
+    FlightRecorderHeader* header;
+    FlightRecord* ring;
+    bool ready;
+
+    int channels;
+    uint32_t intervalUs;
+    uint32_t periodFrames;
+    float nominalFrequency;
+    float offsets[FLIGHTREC_MAX_CHANNELS];
+    float scales[FLIGHTREC_MAX_CHANNELS];       // 0.1 В на отсчёт RMS
+
+    float sumSquares[FLIGHTREC_MAX_CHANNELS];
+    uint32_t cycleFrames;
+    uint32_t frameCount;
+    uint32_t anchorFrame;
+    uint64_t anchorUtcUs;
+    uint32_t recordCount;
+
+    FlightRecord* preserved;
+    int preservedCount;
+    ResetReason resetReason;
+    uint64_t preservedBaseMs;
+    bool preservedTimeValid;
+    int preservedChannels;
+    float preservedNominal;
+
+    bool attach();
+    void initHeader(uint64_t baseMs, bool timeValid);
+    void finishCycle(float frequency);
+    static uint32_t headerChecksum(const FlightRecorderHeader& h);
+};
+
+#endif // FLIGHT_RECORDER_H
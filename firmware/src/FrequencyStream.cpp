@@ -0,0 +1,210 @@
+#include "FrequencyStream.h"
+#include <sys/time.h>
+
+FrequencyStream::FrequencyStream(PowerAnalyzer& analyzer, FlightRecorder& recorder, VoltageHistogram* histogram)
+    : analyzer(analyzer),
+      recorder(recorder),
+      histogram(histogram),
+      samplerTask(nullptr),
+      samplerRunning(false),
+      stopRequested(false),
+      disabled(!FREQSTREAM_ENABLED),
+      committedBlocks(0),
+      lateFrames(0),
+      maxLateUs(0) {
+    for (int i = 0; i < HANDOFF_BLOCKS; i++) {
+        blocks[i] = nullptr;
+        blockTimestampMs[i] = 0;
+    }
+}
+
+void FrequencyStream::begin(AsyncWebServer& server) {
+    server.on("/frequency", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleStatus(request);
+    });
+    Serial.printf("[FreqStream] Endpoint at /frequency, %d values/s, ROCOF window %d ms%s\n", FREQSTREAM_RATE,
+                  FREQSTREAM_ROCOF_WINDOW_MS, disabled ? " (disabled)" : "");
+}
+
+void FrequencyStream::handleStatus(AsyncWebServerRequest* request) {
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->printf("{\"running\":%s,\"values\":%lu,\"dropped\":%lu,\"events\":%lu,\"event_active\":%s,"
+                     "\"late_frames\":%lu,\"max_late_us\":%lu,",
+                     samplerRunning ? "true" : "false", (unsigned long)tracker.getSampleCount(),
+                     (unsigned long)tracker.getDropped(), (unsigned long)tracker.getEventCount(),
+                     tracker.isEventActive() ? "true" : "false", (unsigned long)lateFrames,
+                     (unsigned long)maxLateUs);
+    FrequencySample last;
+    if (!tracker.getLastSample(last)) {
+        response->print("\"last\":null}");
+    } else if (isnan(last.rocof)) {
+        response->printf("\"last\":{\"time_ms\":%llu,\"frequency\":%.4f,\"rocof\":null}}",
+                         (unsigned long long)last.timeMs, last.frequency);
+    } else {
+        response->printf("\"last\":{\"time_ms\":%llu,\"frequency\":%.4f,\"rocof\":%.3f}}",
+                         (unsigned long long)last.timeMs, last.frequency, last.rocof);
+    }
+    request->send(response);
+}
+
+void FrequencyStream::loop(bool yieldAdc) {
+    if (yieldAdc) {
+        if (samplerRunning) {
+            stop();
+        }
+    } else if (!samplerRunning && !disabled && !start()) {
+        // Без памяти под блоки или задачу повторять бессмысленно: измерения идут по-старому
+        disabled = true;
+        Serial.println("[FreqStream] Not started, falling back to windowed measurements");
+    }
+}
+
+bool FrequencyStream::start() {
+    const size_t blockBytes = PowerAnalyzer::BLOCK_SAMPLES * sizeof(int16_t);
+    for (int i = 0; i < HANDOFF_BLOCKS; i++) {
+        if (blocks[i] == nullptr) {
+            blocks[i] = (int16_t*)Hal::allocExternal(blockBytes);
+        }
+        if (blocks[i] == nullptr) {
+            blocks[i] = (int16_t*)malloc(blockBytes);
+        }
+        if (blocks[i] == nullptr) {
+            Serial.println("[FreqStream] No memory for sample blocks");
+            return false;
+        }
+    }
+
+    const int channels = PowerAnalyzer::VOLTAGE_CHANNELS < FREQUENCY_TRACKER_MAX_CHANNELS
+                         ? PowerAnalyzer::VOLTAGE_CHANNELS : FREQUENCY_TRACKER_MAX_CHANNELS;
+    float offsets[FREQUENCY_TRACKER_MAX_CHANNELS];
+    float sensitivities[FREQUENCY_TRACKER_MAX_CHANNELS];
+    for (int ch = 0; ch < channels; ch++) {
+        offsets[ch] = analyzer.getOffset(ch);
+        sensitivities[ch] = analyzer.getSensitivity(ch);
+    }
+    if (!tracker.begin(channels, PowerAnalyzer::SAMPLE_RATE_HZ, NOMINAL_FREQUENCY, offsets,
+                       FREQSTREAM_HYSTERESIS_COUNTS * PowerAnalyzer::FRAME_SCALE)) {
+        Serial.printf("[FreqStream] %d values/s do not fit %lu Hz sampling\n", FREQSTREAM_RATE,
+                      (unsigned long)PowerAnalyzer::SAMPLE_RATE_HZ);
+        return false;
+    }
+
+    // Без самописца поток работает: push() пустой
+    if (FLIGHTREC_ENABLED &&
+        !recorder.begin(channels, PowerAnalyzer::SAMPLE_RATE_HZ, NOMINAL_FREQUENCY, offsets, sensitivities)) {
+        Serial.println("[FlightRec] Retained memory too small, recorder off");
+    }
+    if (histogram != nullptr) {
+        float histogramOffsets[VOLTAGE_HISTOGRAM_MAX_PHASES];
+        float histogramSensitivities[VOLTAGE_HISTOGRAM_MAX_PHASES];
+        const int phases = PowerAnalyzer::VOLTAGE_CHANNELS < VOLTAGE_HISTOGRAM_MAX_PHASES
+                           ? PowerAnalyzer::VOLTAGE_CHANNELS : VOLTAGE_HISTOGRAM_MAX_PHASES;
+        for (int ph = 0; ph < phases; ph++) {
+            histogramOffsets[ph] = analyzer.getOffset(ph);
+            histogramSensitivities[ph] = analyzer.getSensitivity(ph);
+        }
+        histogram->begin(phases, PowerAnalyzer::PERIOD_FRAMES, histogramOffsets, histogramSensitivities);
+    }
+
+    stopRequested = false;
+    samplerRunning = true;
+    if (xTaskCreatePinnedToCore(samplerLoop, "freq_sampler", 4096, this, FREQSTREAM_PRIORITY, &samplerTask,
+                                FREQSTREAM_CORE) != pdPASS) {
+        samplerRunning = false;
+        return false;
+    }
+    Serial.println("[FreqStream] Sampling continuously");
+    return true;
+}
+
+void FrequencyStream::stop() {
+    stopRequested = true;
+    // Задача заканчивает текущий блок (MEASUREMENT_WINDOW_MS)
+    uint32_t startMs = millis();
+    while (samplerRunning && millis() - startMs < 4 * MEASUREMENT_WINDOW_MS) {
+        delay(1);
+    }
+    if (samplerRunning) {
+        Serial.println("[FreqStream] Sampler did not stop in time");
+    }
+}
+
+bool FrequencyStream::isSampling() const {
+    return samplerRunning;
+}
+
+const int16_t* FrequencyStream::latestBlock(uint32_t& seq, uint32_t& timestampMs) const {
+    uint32_t committed = committedBlocks.load(std::memory_order_acquire);
+    if (committed == 0) {
+        return nullptr;
+    }
+    seq = committed - 1;
+    timestampMs = blockTimestampMs[seq % HANDOFF_BLOCKS];
+    return blocks[seq % HANDOFF_BLOCKS];
+}
+
+bool FrequencyStream::holdsBlock(uint32_t seq) const {
+    // Блок committed пишется в слот committed % HANDOFF_BLOCKS сразу после публикации предыдущего
+    return committedBlocks.load(std::memory_order_acquire) - seq < HANDOFF_BLOCKS;
+}
+
+FrequencyTracker& FrequencyStream::getTracker() {
+    return tracker;
+}
+
+uint32_t FrequencyStream::getLateFrames() const {
+    return lateFrames;
+}
+
+uint32_t FrequencyStream::getMaxLateUs() const {
+    return maxLateUs;
+}
+
+void FrequencyStream::samplerLoop(void* arg) {
+    FrequencyStream* self = static_cast<FrequencyStream*>(arg);
+
+    // Задача не уступает процессор, пока идёт поток: сторож простоя ядра 0 молчит до остановки
+    disableCore0WDT();
+
+    const uint32_t blockUs = PowerAnalyzer::FRAMES_PER_BLOCK * PowerAnalyzer::INTERVAL_US;
+    uint32_t startUs = PowerAnalyzer::startNowUs();
+    uint32_t seq = self->committedBlocks.load(std::memory_order_relaxed);
+    self->tracker.reset();
+    VoltageHistogram* histogram = self->histogram;
+    while (!self->stopRequested) {
+        // UTC начала блока — только для меток значений; периоды считаются по кадрам
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        uint32_t nowUs = Hal::micros();
+        uint64_t blockUtcUs = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec - (int32_t)(nowUs - startUs);
+        self->tracker.beginBlock(blockUtcUs);
+        self->recorder.beginBlock(blockUtcUs, tv.tv_sec > 1700000000);
+        if (histogram != nullptr) {
+            histogram->beginBlock((uint32_t)(blockUtcUs / 1000000), tv.tv_sec > 1700000000);
+        }
+
+        int16_t* block = self->blocks[seq % HANDOFF_BLOCKS];
+        uint32_t blockMaxLateUs;
+        uint32_t late = self->analyzer.acquire(block, startUs, blockMaxLateUs,
+                                               [self, histogram](const int16_t* frame, int i) {
+            self->tracker.push(frame);
+            self->recorder.push(frame, self->tracker.getFrequency());
+            if (histogram != nullptr) {
+                histogram->push(frame);
+            }
+        });
+
+        self->blockTimestampMs[seq % HANDOFF_BLOCKS] = Hal::millis();
+        self->committedBlocks.store(++seq, std::memory_order_release);
+        self->lateFrames += late;
+        if (blockMaxLateUs > self->maxLateUs) {
+            self->maxLateUs = blockMaxLateUs;
+        }
+        startUs += blockUs;
+    }
+
+    enableCore0WDT();
+    self->samplerRunning = false;
+    self->samplerTask = nullptr;
+    vTaskDelete(nullptr);
+}
@@ -0,0 +1,105 @@
+#ifndef FREQUENCY_STREAM_H
+#define FREQUENCY_STREAM_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <atomic>
+#include "config.h"
+#include "PowerAnalyzer.h"
+#include "FrequencyTracker.h"
+#include "FlightRecorder.h"
+#include "VoltageHistogram.h"
+
+/**
+ * Непрерывная оцифровка для частоты по периодам и ROCOF
+ *
+ *   GET /frequency     — последнее значение, ROCOF, события, счётчики
+ *
+ * Задача оцифровки на FREQSTREAM_CORE владеет АЦП, пока глубокий захват и
+ * режим PMU не заняты: блоки встык по расписанию, каждый кадр сразу идёт в
+ * FrequencyTracker, бортовой самописец FlightRecorder и гистограмму периодов
+ * VoltageHistogram (acquire() с обработкой кадра). Значения и события
+ * забирает loop() и отправляет пачками. Блоки для измерения и осциллографа
+ * loop() берёт через latestBlock(), как при глубоком захвате.
+ *
+ * Запросу глубокого захвата или PMU поток уступает АЦП: loop(true)
+ * останавливает задачу и ждёт конца её блока; после них поток
+ * возобновляется, а в ряду частоты остаётся разрыв.
+ */
+class FrequencyStream {
+public:
+    /**
+     * @param histogram nullptr — без гистограммы периодов
+     */
+    FrequencyStream(PowerAnalyzer& analyzer, FlightRecorder& recorder, VoltageHistogram* histogram);
+
+    /**
+     * Зарегистрировать обработчик на веб-сервере
+     */
+    void begin(AsyncWebServer& server);
+
+    /**
+     * Запуск и остановка (из loop())
+     * @param yieldAdc АЦП нужен другой задаче оцифровки: остановиться и дождаться
+     */
+    void loop(bool yieldAdc);
+
+    /**
+     * Работает ли задача оцифровки (loop() не должен трогать АЦП)
+     */
+    bool isSampling() const;
+
+    /**
+     * Последний оцифрованный блок (FRAMES_PER_BLOCK кадров) для измерения
+     * @param seq Номер блока (растёт на единицу)
+     * @param timestampMs millis() конца блока
+     * @return nullptr если блоков ещё нет. Слот перепишется через HANDOFF_BLOCKS - 1
+     *         блоков: копировать и проверять holdsBlock()
+     */
+    const int16_t* latestBlock(uint32_t& seq, uint32_t& timestampMs) const;
+
+    /**
+     * Блок seq ещё не начал перезаписываться (всё прочитанное из него до этого вызова цело)
+     */
+    bool holdsBlock(uint32_t seq) const;
+
+    FrequencyTracker& getTracker();
+
+    /**
+     * Кадры, снятые позже расписания, и наибольшее опоздание с запуска
+     */
+    uint32_t getLateFrames() const;
+    uint32_t getMaxLateUs() const;
+
+private:
+    // Блоки для измерения: пока loop() копирует один, задача пишет другой. Копия
+    // сверяется с holdsBlock() — медленный проход loop() не видит чужой блок
+    static const int HANDOFF_BLOCKS = 3;
+
+    PowerAnalyzer& analyzer;
+    FlightRecorder& recorder;
+    VoltageHistogram* histogram;
+    FrequencyTracker tracker;
+    TaskHandle_t samplerTask;
+    volatile bool samplerRunning;
+    volatile bool stopRequested;
+    bool disabled;
+
+    int16_t* blocks[HANDOFF_BLOCKS];
+    uint32_t blockTimestampMs[HANDOFF_BLOCKS];
+    std::atomic<uint32_t> committedBlocks;
+
+    volatile uint32_t lateFrames;
+    volatile uint32_t maxLateUs;
+
+    bool start();
+    void stop();
+    void handleStatus(AsyncWebServerRequest* request);
+
+    /**
+     * Задача оцифровки: блоки встык, кадры — в FrequencyTracker, FlightRecorder и VoltageHistogram
+     */
+    static void samplerLoop(void* arg);
+};
+
+#endif // FREQUENCY_STREAM_H
@@ -0,0 +1,332 @@
+#include "FrequencyTracker.h"
+#include <math.h>
+#include <string.h>
+#include "LineProtocol.h"
+
+FrequencyTracker::FrequencyTracker()
+    : channels(0),
+      sampleRateHz(0),
+      nominalFrequency(NOMINAL_FREQUENCY),
+      intervalUs(0),
+      filterFrames(1),
+      filterPosition(0),
+      filled(0),
+      frameCount(0),
+      slotFrames(0),
+      nextSlotFrame(0),
+      staleFrames(0),
+      anchorFrame(0),
+      anchorUtcUs(0),
+      aligned(false),
+      historyPosition(0),
+      validRun(0),
+      rocofWindow(2),
+      lastFrequency(NAN),
+      eventActive(false),
+      lastAboveMs(0),
+      clearSlots(0),
+      clearNeeded(1),
+      sampleHead(0),
+      sampleTail(0),
+      eventHead(0),
+      eventTail(0),
+      dropped(0),
+      sampleCount(0),
+      eventCount(0) {
+    memset(offsets, 0, sizeof(offsets));
+    memset(channel, 0, sizeof(channel));
+    memset(filterRing, 0, sizeof(filterRing));
+    memset(history, 0, sizeof(history));
+    memset(&event, 0, sizeof(event));
+}
+
+bool FrequencyTracker::begin(int channels, uint32_t sampleRateHz, float nominalFrequency, const float* offsets,
+                             float hysteresis) {
+    const int window = FREQSTREAM_ROCOF_WINDOW_MS * FREQSTREAM_RATE / 1000 / 2 * 2;
+    if (channels < 1 || channels > FREQUENCY_TRACKER_MAX_CHANNELS || sampleRateHz % FREQSTREAM_RATE != 0 ||
+        1000000 % sampleRateHz != 0 || FREQSTREAM_FILTER_FRAMES < 1 ||
+        FREQSTREAM_FILTER_FRAMES > FREQUENCY_TRACKER_MAX_FILTER || window < 2 || window > FREQUENCY_TRACKER_HISTORY) {
+        return false;
+    }
+    this->channels = channels;
+    this->sampleRateHz = sampleRateHz;
+    this->nominalFrequency = nominalFrequency;
+    intervalUs = 1000000 / sampleRateHz;
+    filterFrames = FREQSTREAM_FILTER_FRAMES;
+    this->hysteresis = hysteresis;
+    slotFrames = sampleRateHz / FREQSTREAM_RATE;
+    staleFrames = (uint32_t)(1.5f * sampleRateHz / nominalFrequency);
+    rocofWindow = window;
+    clearNeeded = FREQSTREAM_ROCOF_CLEAR_MS * FREQSTREAM_RATE / 1000;
+    if (clearNeeded < 1) {
+        clearNeeded = 1;
+    }
+    for (int ch = 0; ch < channels; ch++) {
+        this->offsets[ch] = offsets[ch];
+    }
+    reset();
+    return true;
+}
+
+void FrequencyTracker::reset() {
+    for (int ch = 0; ch < channels; ch++) {
+        Channel& c = channel[ch];
+        memset(&c, 0, sizeof(c));
+        c.threshold = (int32_t)lroundf(offsets[ch] * filterFrames);
+        c.armLevel = (int32_t)lroundf((offsets[ch] - hysteresis) * filterFrames);
+    }
+    memset(filterRing, 0, sizeof(filterRing));
+    filterPosition = 0;
+    filled = 0;
+    aligned = false;
+    validRun = 0;
+    lastFrequency = NAN;
+}
+
+void FrequencyTracker::beginBlock(uint64_t utcUs) {
+    anchorFrame = frameCount;
+    anchorUtcUs = utcUs;
+    if (!aligned) {
+        // Первый интервал заканчивается на ближайшей границе сетки UTC
+        const uint64_t slotUs = 1000000 / FREQSTREAM_RATE;
+        uint64_t untilUs = (slotUs - utcUs % slotUs) % slotUs;
+        nextSlotFrame = frameCount + (uint32_t)((untilUs + intervalUs - 1) / intervalUs);
+        if (nextSlotFrame == frameCount) {
+            nextSlotFrame += slotFrames;
+        }
+        aligned = true;
+    }
+}
+
+void FrequencyTracker::push(const int16_t* frame) {
+    int16_t* ring = &filterRing[filterPosition * FREQUENCY_TRACKER_MAX_CHANNELS];
+    bool ready = filled >= filterFrames;
+    for (int ch = 0; ch < channels; ch++) {
+        Channel& c = channel[ch];
+        int32_t sum = c.sum + frame[ch] - ring[ch];
+        ring[ch] = frame[ch];
+        c.sum = sum;
+        if (ready) {
+            if (!c.armed) {
+                c.armed = sum < c.armLevel;
+            } else if (sum >= c.threshold) {
+                crossing(c, sum);
+            }
+        }
+        c.previousSum = sum;
+    }
+    if (++filterPosition == filterFrames) {
+        filterPosition = 0;
+    }
+    if (!ready) {
+        filled++;
+    }
+
+    frameCount++;
+    if (aligned && frameCount == nextSlotFrame) {
+        finishSlot();
+        nextSlotFrame += slotFrames;
+    }
+}
+
+void FrequencyTracker::crossing(Channel& c, int32_t sum) {
+    // Переход между предыдущим кадром и этим: доля кадра по линейной интерполяции
+    float fraction = (float)(c.threshold - c.previousSum) / (float)(sum - c.previousSum);
+    uint32_t frame = frameCount - 1;
+    if (c.hasCrossing) {
+        float period = (float)(frame - c.crossingFrame) + (fraction - c.crossingFraction);
+        float frequency = sampleRateHz / period;
+        if (frequency > 0.8f * nominalFrequency && frequency < 1.2f * nominalFrequency) {
+            c.frequency = frequency;
+            c.cycleEndFrame = frameCount;
+            c.valid = true;
+        }
+    }
+    c.crossingFrame = frame;
+    c.crossingFraction = fraction;
+    c.hasCrossing = true;
+    c.armed = false;
+}
+
+void FrequencyTracker::finishSlot() {
+    float sum = 0.0f;
+    int count = 0;
+    for (int ch = 0; ch < channels; ch++) {
+        const Channel& c = channel[ch];
+        if (c.valid && frameCount - c.cycleEndFrame <= staleFrames) {
+            sum += c.frequency;
+            count++;
+        }
+    }
+    float frequency = count > 0 ? sum / count : NAN;
+    lastFrequency = frequency;
+
+    history[historyPosition] = frequency;
+    if (++historyPosition == FREQUENCY_TRACKER_HISTORY) {
+        historyPosition = 0;
+    }
+    validRun = count > 0 ? validRun + 1 : 0;
+
+    // Средние двух половин окна: [старая половина][новая половина]
+    float rocof = NAN;
+    if (validRun >= rocofWindow) {
+        const int half = rocofWindow / 2;
+        float recent = 0.0f;
+        float older = 0.0f;
+        for (int i = 0; i < half; i++) {
+            recent += history[(historyPosition + FREQUENCY_TRACKER_HISTORY - 1 - i) % FREQUENCY_TRACKER_HISTORY];
+            older += history[(historyPosition + FREQUENCY_TRACKER_HISTORY - 1 - half - i) % FREQUENCY_TRACKER_HISTORY];
+        }
+        rocof = (recent - older) / half * FREQSTREAM_RATE / half;
+    }
+
+    uint64_t timeMs = (anchorUtcUs + (uint64_t)(frameCount - anchorFrame) * intervalUs) / 1000;
+    if (count > 0) {
+        FrequencySample sample;
+        sample.timeMs = timeMs;
+        sample.frequency = frequency;
+        sample.rocof = rocof;
+        uint32_t head = sampleHead.load(std::memory_order_relaxed);
+        if (head - sampleTail.load(std::memory_order_acquire) < FREQSTREAM_BUFFER_SLOTS) {
+            samples[head % FREQSTREAM_BUFFER_SLOTS] = sample;
+            sampleHead.store(head + 1, std::memory_order_release);
+        } else {
+            dropped++;
+        }
+        sampleCount++;
+        lastSample.write(sample);
+    }
+    updateEvent(timeMs, frequency, rocof);
+}
+
+void FrequencyTracker::updateEvent(uint64_t timeMs, float frequency, float rocof) {
+    bool above = !isnan(rocof) && fabsf(rocof) >= FREQSTREAM_ROCOF_THRESHOLD;
+    if (!eventActive) {
+        if (above) {
+            eventActive = true;
+            eventCount++;
+            event.startMs = timeMs;
+            event.durationMs = 0;
+            event.active = true;
+            event.rocof = rocof;
+            event.frequencyMin = frequency;
+            event.frequencyMax = frequency;
+            lastAboveMs = timeMs;
+            clearSlots = 0;
+            pushEvent(event);
+        }
+        return;
+    }
+
+    if (!isnan(frequency)) {
+        event.frequencyMin = fminf(event.frequencyMin, frequency);
+        event.frequencyMax = fmaxf(event.frequencyMax, frequency);
+    }
+    if (!isnan(rocof) && fabsf(rocof) > fabsf(event.rocof)) {
+        event.rocof = rocof;
+    }
+    if (above) {
+        lastAboveMs = timeMs;
+    }
+
+    // Окончание — ниже порога с гистерезисом (или без ROCOF) FREQSTREAM_ROCOF_CLEAR_MS подряд
+    if (isnan(rocof) || fabsf(rocof) < FREQSTREAM_ROCOF_THRESHOLD * FREQSTREAM_ROCOF_CLEAR_RATIO) {
+        if (++clearSlots >= clearNeeded) {
+            eventActive = false;
+            event.active = false;
+            event.durationMs = (uint32_t)(lastAboveMs - event.startMs);
+            pushEvent(event);
+        }
+    } else {
+        clearSlots = 0;
+    }
+}
+
+void FrequencyTracker::pushEvent(const FrequencyEvent& e) {
+    uint32_t head = eventHead.load(std::memory_order_relaxed);
+    if (head - eventTail.load(std::memory_order_acquire) < FREQUENCY_TRACKER_MAX_EVENTS) {
+        events[head % FREQUENCY_TRACKER_MAX_EVENTS] = e;
+        eventHead.store(head + 1, std::memory_order_release);
+    }
+}
+
+int FrequencyTracker::readSamples(FrequencySample* out, int max) {
+    uint32_t tail = sampleTail.load(std::memory_order_relaxed);
+    uint32_t head = sampleHead.load(std::memory_order_acquire);
+    int count = 0;
+    while (tail != head && count < max) {
+        out[count++] = samples[tail % FREQSTREAM_BUFFER_SLOTS];
+        tail++;
+    }
+    sampleTail.store(tail, std::memory_order_release);
+    return count;
+}
+
+int FrequencyTracker::readEvents(FrequencyEvent* out, int max) {
+    uint32_t tail = eventTail.load(std::memory_order_relaxed);
+    uint32_t head = eventHead.load(std::memory_order_acquire);
+    int count = 0;
+    while (tail != head && count < max) {
+        out[count++] = events[tail % FREQUENCY_TRACKER_MAX_EVENTS];
+        tail++;
+    }
+    eventTail.store(tail, std::memory_order_release);
+    return count;
+}
+
+uint32_t FrequencyTracker::getDropped() const {
+    return dropped;
+}
+
+uint32_t FrequencyTracker::getSampleCount() const {
+    return sampleCount;
+}
+
+uint32_t FrequencyTracker::getEventCount() const {
+    return eventCount;
+}
+
+bool FrequencyTracker::isEventActive() const {
+    return eventActive;
+}
+
+float FrequencyTracker::getFrequency() const {
+    return lastFrequency;
+}
+
+bool FrequencyTracker::getLastSample(FrequencySample& out) const {
+    return lastSample.read(out) && out.timeMs != 0;
+}
+
+size_t FrequencyTracker::writeLineProtocol(const FrequencySample* samples, int count,
+                                           char* buffer, size_t size, const char* deviceId) {
+    LineWriter out(buffer, size);
+    for (int i = 0; i < count; i++) {
+        out.begin("frequency_cycle");
+        out.tag("device", deviceId);
+        out.field("value", samples[i].frequency, 3);
+        if (!isnan(samples[i].rocof)) {
+            out.field("rocof", samples[i].rocof, 3);
+        }
+        out.end(samples[i].timeMs);
+    }
+    return out.overflowed() ? 0 : out.length();
+}
+
+size_t FrequencyTracker::writeEventLineProtocol(const FrequencyEvent* events, int count,
+                                                char* buffer, size_t size, const char* deviceId) {
+    LineWriter out(buffer, size);
+    for (int i = 0; i < count; i++) {
+        const FrequencyEvent& e = events[i];
+        out.begin("rocof_event");
+        out.tag("device", deviceId);
+        out.tag("state", e.active ? "start" : "end");
+        out.field("rocof", e.rocof, 3);
+        out.field("f_min", e.frequencyMin, 3);
+        out.field("f_max", e.frequencyMax, 3);
+        out.field("duration_ms", e.durationMs);
+        // Начало и окончание — разные точки одного момента: тег state их различает
+        out.end(e.startMs);
+    }
+    return out.overflowed() ? 0 : out.length();
+}
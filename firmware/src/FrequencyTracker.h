@@ -0,0 +1,231 @@
+#ifndef FREQUENCY_TRACKER_H
+#define FREQUENCY_TRACKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "config.h"
+#include "SeqLock.h"
+
+// Каналов напряжения в слежении (трёхфазная схема)
+#define FREQUENCY_TRACKER_MAX_CHANNELS 3
+
+// Наибольшее окно скользящего среднего, кадров
+#define FREQUENCY_TRACKER_MAX_FILTER 32
+
+// Наибольшее окно ROCOF, значений (FREQSTREAM_ROCOF_WINDOW_MS при FREQSTREAM_RATE)
+#define FREQUENCY_TRACKER_HISTORY 64
+
+// Событий ROCOF в очереди на отправку
+#define FREQUENCY_TRACKER_MAX_EVENTS 8
+
+// Точки frequency_cycle одной пачки (DEVICE_ID до 32 символов)
+#define FREQSTREAM_LINE_PROTOCOL_SIZE (FREQSTREAM_RATE * FREQSTREAM_BATCH_S * 100)
+
+// Точки rocof_event всей очереди событий
+#define FREQSTREAM_EVENT_LINE_PROTOCOL_SIZE (FREQUENCY_TRACKER_MAX_EVENTS * 160)
+
+/**
+ * Значение частоты на интервал 1/FREQSTREAM_RATE
+ */
+struct FrequencySample {
+    uint64_t timeMs;            // UTC конца интервала
+    float frequency;            // Гц: среднее по каналам частот последних периодов
+    float rocof;                // Гц/с; NAN, пока окно не набралось без пропусков
+};
+
+/**
+ * Событие ROCOF: начало (active) и окончание со сводкой
+ */
+struct FrequencyEvent {
+    uint64_t startMs;           // UTC значения, на котором |ROCOF| превысил порог
+    uint32_t durationMs;        // До последнего значения выше порога (0 у начала)
+    bool active;                // true — начало, false — окончание
+    float rocof;                // При начале — ROCOF срабатывания, при окончании — пиковый (со знаком)
+    float frequencyMin;         // За событие, Гц (у начала — текущая частота)
+    float frequencyMax;
+};
+
+/**
+ * Частота каждого периода и ROCOF по потоку кадров АЦП
+ *
+ * Каждый канал напряжения сглаживается скользящим средним на
+ * FREQSTREAM_FILTER_FRAMES кадров (шум АЦП, высшие гармоники) и следит за
+ * переходами через смещение снизу вверх: момент перехода интерполируется
+ * между кадрами, канал снова взводится только ниже смещения на гистерезис
+ * (FREQSTREAM_HYSTERESIS_COUNTS) — шум у нуля не даёт ложных переходов.
+ * Между соседними переходами — период и частота канала; периоды вне
+ * ±20 % номинала (обрыв фазы, помеха) отбрасываются.
+ *
+ * Раз в 1/FREQSTREAM_RATE с по кадрам (интервалы выровнены по UTC при
+ * первом блоке) значение — среднее частот последних периодов каналов, у
+ * которых период закончился не раньше полутора номинальных периодов назад.
+ * ROCOF — разность средних двух половин окна FREQSTREAM_ROCOF_WINDOW_MS,
+ * делённая на длину половины: для линейного изменения частоты это точный
+ * наклон, а шум отдельных периодов усредняется. Задержка ROCOF — половина
+ * окна.
+ *
+ * Значения и события складываются в кольца с одним писателем (задача
+ * оцифровки) и одним читателем (loop()): без блокировок, при переполнении
+ * новые значения теряются и считаются. Кадр стоит сложение и сравнение на
+ * канал; всё остальное — раз на период или интервал.
+ */
+class FrequencyTracker {
+public:
+    FrequencyTracker();
+
+    /**
+     * @param channels Каналов напряжения (первые в кадре)
+     * @param sampleRateHz Кадров в секунду (кратно FREQSTREAM_RATE)
+     * @param nominalFrequency f0, Гц
+     * @param offsets Смещение АЦП каждого канала, единицы кадра
+     * @param hysteresis Взвод ниже смещения на столько (FREQSTREAM_HYSTERESIS_COUNTS
+     *                   в единицах кадра)
+     * @return false если параметры не подходят
+     */
+    bool begin(int channels, uint32_t sampleRateHz, float nominalFrequency, const float* offsets,
+               float hysteresis);
+
+    /**
+     * Разрыв в потоке кадров: переходы и окно ROCOF начинаются заново
+     */
+    void reset();
+
+    /**
+     * UTC следующего кадра (в начале каждого блока). Метки значений
+     * считаются от последней привязки по числу кадров
+     */
+    void beginBlock(uint64_t utcUs);
+
+    /**
+     * Добавить кадр (кадры подряд с шагом 1/sampleRateHz)
+     */
+    void push(const int16_t* frame);
+
+    /**
+     * Забрать накопленные значения (из другой задачи, чем push())
+     * @return Прочитано значений
+     */
+    int readSamples(FrequencySample* out, int max);
+
+    /**
+     * Забрать события
+     */
+    int readEvents(FrequencyEvent* out, int max);
+
+    /**
+     * Значений, не поместившихся в кольцо
+     */
+    uint32_t getDropped() const;
+
+    /**
+     * Значений с начала работы и событий (начал) ROCOF
+     */
+    uint32_t getSampleCount() const;
+    uint32_t getEventCount() const;
+
+    /**
+     * Идёт ли событие ROCOF
+     */
+    bool isEventActive() const;
+
+    /**
+     * Частота последнего интервала для задачи оцифровки (FlightRecorder)
+     * @return NAN если ни у одной фазы нет свежего периода
+     */
+    float getFrequency() const;
+
+    /**
+     * Последнее значение (из любой задачи)
+     * @return false если значений ещё не было
+     */
+    bool getLastSample(FrequencySample& out) const;
+
+    /**
+     * Точки frequency_cycle (поля value, rocof) с метками времени, мс
+     * @return Длина записанного, 0 если не поместилось
+     */
+    static size_t writeLineProtocol(const FrequencySample* samples, int count,
+                                    char* buffer, size_t size, const char* deviceId);
+
+    /**
+     * Точки rocof_event (тег state=start|end) с метками времени начала события
+     */
+    static size_t writeEventLineProtocol(const FrequencyEvent* events, int count,
+                                         char* buffer, size_t size, const char* deviceId);
+
+private:
+    struct Channel {
+        int32_t threshold;      // Смещение × окно фильтра
+        int32_t armLevel;       // (Смещение - гистерезис) × окно фильтра
+        int32_t sum;            // Скользящая сумма
+        int32_t previousSum;
+        bool armed;
+        bool hasCrossing;
+        uint32_t crossingFrame; // Кадр перед переходом
+        float crossingFraction; // Доля кадра до перехода
+        uint32_t cycleEndFrame;
+        float frequency;        // Последнего принятого периода
+        bool valid;
+    };
+
+    int channels;
+    uint32_t sampleRateHz;
+    float nominalFrequency;
+    uint32_t intervalUs;
+    int filterFrames;
+    float hysteresis;
+    float offsets[FREQUENCY_TRACKER_MAX_CHANNELS];
+
+    Channel channel[FREQUENCY_TRACKER_MAX_CHANNELS];
+    int16_t filterRing[FREQUENCY_TRACKER_MAX_FILTER * FREQUENCY_TRACKER_MAX_CHANNELS];
+    int filterPosition;
+    int filled;
+
+    // Кадры и интервалы: номер кадра — часы потока, UTC — только для меток
+    uint32_t frameCount;
+    uint32_t slotFrames;
+    uint32_t nextSlotFrame;
+    uint32_t staleFrames;       // Полтора номинальных периода
+    uint32_t anchorFrame;
+    uint64_t anchorUtcUs;
+    bool aligned;
+
+    // Частоты последних интервалов для ROCOF
+    float history[FREQUENCY_TRACKER_HISTORY];
+    int historyPosition;
+    int validRun;               // Интервалов подряд со значением
+    int rocofWindow;            // Интервалов в окне (чётное)
+    float lastFrequency;
+
+    // Текущее событие
+    bool eventActive;
+    FrequencyEvent event;
+    uint64_t lastAboveMs;
+    int clearSlots;
+    int clearNeeded;
+
+    // Кольца: пишет push(), читает read*()
+    FrequencySample samples[FREQSTREAM_BUFFER_SLOTS];
+    std::atomic<uint32_t> sampleHead;
+    std::atomic<uint32_t> sampleTail;
+    FrequencyEvent events[FREQUENCY_TRACKER_MAX_EVENTS];
+    std::atomic<uint32_t> eventHead;
+    std::atomic<uint32_t> eventTail;
+    volatile uint32_t dropped;
+    volatile uint32_t sampleCount;
+    volatile uint32_t eventCount;
+    SeqLock<FrequencySample> lastSample;
+
+    void crossing(Channel& c, int32_t sum);
+
+    /**
+     * Закрыть интервал: значение, ROCOF, событие
+     */
+    void finishSlot();
+
+    void updateEvent(uint64_t timeMs, float frequency, float rocof);
+    void pushEvent(const FrequencyEvent& e);
+};
+
+#endif // FREQUENCY_TRACKER_H
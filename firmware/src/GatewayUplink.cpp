@@ -0,0 +1,81 @@
+#include "GatewayUplink.h"
+#include <time.h>
+
+GatewayUplink::GatewayUplink()
+    : gatewayHost(nullptr),
+      gatewayPort(0),
+      deviceId(""),
+      recordSeq(0),
+      successCount(0),
+      failCount(0) {
+}
+
+void GatewayUplink::begin(const char* host, uint16_t port, const char* id) {
+    gatewayHost = host;
+    gatewayPort = port;
+    deviceId = id;
+
+    Serial.printf("[GatewayUplink] Gateway %s:%u (UDP)\n", host, port);
+}
+
+uint32_t GatewayUplink::unixTime() const {
+    time_t now = time(nullptr);
+    return now > 1700000000 ? (uint32_t)now : 0;  // До синхронизации NTP — 0, шлюз подставит своё время
+}
+
+SendStatus GatewayUplink::publishPower(const PowerData& data, bool withEvent, uint8_t previousFlags) {
+    uint32_t now = unixTime();
+    size_t offset = sizeof(FrameHeader);
+    uint8_t records = 0;
+
+    offset += TelemetryCodec::encodePower(data, recordSeq++, now,
+                                          buffer + offset, sizeof(buffer) - offset);
+    records++;
+
+    if (withEvent) {
+        offset += TelemetryCodec::encodeEvent(data, previousFlags, recordSeq++, now,
+                                              buffer + offset, sizeof(buffer) - offset);
+        records++;
+    }
+
+    return sendFrame(records, offset);
+}
+
+SendStatus GatewayUplink::publishWaveform(const WaveformData& waveform,
+                                          float offsetA, float offsetB, float offsetC) {
+    size_t offset = sizeof(FrameHeader);
+    offset += TelemetryCodec::encodeWaveform(waveform, offsetA, offsetB, offsetC,
+                                             recordSeq++, unixTime(),
+                                             buffer + offset, sizeof(buffer) - offset);
+    return sendFrame(1, offset);
+}
+
+SendStatus GatewayUplink::sendFrame(uint8_t recordCount, size_t length) {
+    if (WiFi.status() != WL_CONNECTED) {
+        failCount++;
+        return SendStatus::WIFI_DISCONNECTED;
+    }
+
+    TelemetryCodec::writeFrameHeader(buffer, deviceId, recordCount, (uint16_t)length);
+
+    if (!udp.beginPacket(gatewayHost, gatewayPort)) {
+        failCount++;
+        return SendStatus::CONNECTION_FAILED;
+    }
+    udp.write(buffer, length);
+    if (!udp.endPacket()) {
+        failCount++;
+        return SendStatus::CONNECTION_FAILED;
+    }
+
+    successCount++;
+    return SendStatus::SUCCESS;
+}
+
+unsigned long GatewayUplink::getSuccessCount() const {
+    return successCount;
+}
+
+unsigned long GatewayUplink::getFailCount() const {
+    return failCount;
+}
@@ -0,0 +1,63 @@
+#ifndef GATEWAY_UPLINK_H
+#define GATEWAY_UPLINK_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "config.h"
+#include "PowerData.h"
+#include "WaveformData.h"
+#include "TelemetryCodec.h"
+#include "InfluxClient.h"  // SendStatus
+
+/**
+ * Транспорт на шлюз парка устройств (gateway/): бинарные кадры по UDP
+ *
+ * Один датаграмм = FrameHeader + записи TelemetryCodec. Шлюз собирает кадры
+ * от многих устройств и пишет их в InfluxDB крупными пачками, поэтому
+ * устройству не нужно ни TCP-соединение, ни HTTP, ни Line Protocol.
+ */
+class GatewayUplink {
+public:
+    GatewayUplink();
+
+    /**
+     * @param host Адрес шлюза
+     * @param port UDP-порт шлюза
+     * @param deviceId Идентификатор устройства (до FRAME_DEVICE_ID_LEN символов)
+     */
+    void begin(const char* host, uint16_t port, const char* deviceId);
+
+    /**
+     * Отправить измерения, а при смене флагов — и событие, в одном кадре
+     * @param withEvent Добавить запись события
+     * @param previousFlags Маска флагов до перехода
+     */
+    SendStatus publishPower(const PowerData& data, bool withEvent, uint8_t previousFlags);
+
+    /**
+     * Отправить осциллограмму отдельным кадром
+     */
+    SendStatus publishWaveform(const WaveformData& waveform,
+                               float offsetA, float offsetB, float offsetC);
+
+    unsigned long getSuccessCount() const;
+    unsigned long getFailCount() const;
+
+private:
+    WiFiUDP udp;
+    const char* gatewayHost;
+    uint16_t gatewayPort;
+    const char* deviceId;
+
+    uint32_t recordSeq;
+    unsigned long successCount;
+    unsigned long failCount;
+
+    uint8_t buffer[FRAME_MAX_SIZE];
+
+    uint32_t unixTime() const;
+    SendStatus sendFrame(uint8_t recordCount, size_t length);
+};
+
+#endif // GATEWAY_UPLINK_H
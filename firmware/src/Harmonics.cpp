@@ -0,0 +1,41 @@
+#include "Harmonics.h"
+#include <math.h>
+
+float Harmonics::thdPercent(const int16_t* frames, int frameCount, int stride, float offset,
+                            float frequency, uint32_t sampleRateHz, int maxHarmonic) {
+    if (frequency < 40.0f || frequency > 70.0f) {
+        frequency = NOMINAL_FREQUENCY;
+    }
+
+    // Целое число периодов: при 49.7 Гц в 2000 кадрах 9 периодов, а не 9.94
+    int cycles = (int)(frameCount * frequency / sampleRateHz);
+    int count = (int)(cycles * sampleRateHz / frequency + 0.5f);
+    if (cycles < 1 || count > frameCount) {
+        return 0.0f;
+    }
+
+    const float step = 2.0f * (float)M_PI * frequency / sampleRateHz;
+    float fundamental = goertzelPower(frames, count, stride, offset, step);
+    if (fundamental <= 0.0f) {
+        return 0.0f;
+    }
+
+    float distortion = 0.0f;
+    for (int h = 2; h <= maxHarmonic && h * frequency < sampleRateHz / 2.0f; h++) {
+        distortion += goertzelPower(frames, count, stride, offset, h * step);
+    }
+    return 100.0f * sqrtf(distortion / fundamental);
+}
+
+float Harmonics::goertzelPower(const int16_t* frames, int count, int stride, float offset, float omega) {
+    const float coeff = 2.0f * cosf(omega);
+    float s1 = 0.0f;
+    float s2 = 0.0f;
+    for (int i = 0; i < count; i++) {
+        float s0 = (frames[i * stride] - offset) + coeff * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    float power = s1 * s1 + s2 * s2 - coeff * s1 * s2;
+    return power > 0.0f ? power : 0.0f;
+}
@@ -0,0 +1,37 @@
+#ifndef HARMONICS_H
+#define HARMONICS_H
+
+#include <stdint.h>
+#include "config.h"
+
+/**
+ * Гармоники напряжения по блоку отсчётов
+ *
+ * Окно — целое число периодов измеренной частоты внутри блока (10 периодов
+ * при 50 Гц и 200-мс окне, как в EN 61000-4-7), поэтому гармоники не
+ * растекаются по соседним частотам без оконной функции. Амплитуда каждой
+ * гармоники — алгоритм Гёрцеля, без БПФ и без буферов.
+ */
+class Harmonics {
+public:
+    /**
+     * Коэффициент гармонических искажений THD, %
+     * @param frames Первый отсчёт канала в кадрах
+     * @param frameCount Кадров в блоке
+     * @param stride Отсчётов в кадре (каналов)
+     * @param offset Смещение нуля канала, отсчёты ADC
+     * @param frequency Частота основной гармоники (вне 40..70 Гц — NOMINAL_FREQUENCY)
+     * @param maxHarmonic Последняя учитываемая гармоника (ограничивается частотой Найквиста)
+     * @return THD (0 если в блоке нет целого периода или нет сигнала)
+     */
+    static float thdPercent(const int16_t* frames, int frameCount, int stride, float offset,
+                            float frequency, uint32_t sampleRateHz, int maxHarmonic = THD_MAX_HARMONIC);
+
+private:
+    /**
+     * Квадрат амплитуды гармоники (в единицах N²/4 · A²) по Гёрцелю
+     */
+    static float goertzelPower(const int16_t* frames, int count, int stride, float offset, float omega);
+};
+
+#endif // HARMONICS_H
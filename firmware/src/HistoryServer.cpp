@@ -0,0 +1,99 @@
+#include "HistoryServer.h"
+#include <stdlib.h>
+#include <string.h>
+#include "hal/Hal.h"
+
+HistoryServer::HistoryServer(HistoryStore& store)
+    : store(store) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+void HistoryServer::begin(AsyncWebServer& server) {
+    server.on("/history/status", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleStatus(request);
+    });
+    server.on("/history", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleQuery(request);
+    });
+
+    Serial.println("[History] Endpoints at /history, /history/status");
+}
+
+/**
+ * Беззнаковый параметр запроса (unix-время не помещается в toInt() после 2038)
+ */
+static uint32_t paramU32(AsyncWebServerRequest* request, const char* name, uint32_t fallback) {
+    if (!request->hasParam(name)) {
+        return fallback;
+    }
+    return (uint32_t)strtoul(request->getParam(name)->value().c_str(), nullptr, 10);
+}
+
+void HistoryServer::handleQuery(AsyncWebServerRequest* request) {
+    if (store.getMemorySize() == 0) {
+        request->send(503, "text/plain", "history not allocated");
+        return;
+    }
+
+    uint32_t now = store.now();
+    uint32_t last = paramU32(request, "last", HISTORY_SECONDS);
+    uint32_t from = paramU32(request, "from", now > last ? now - last + 1 : 0);
+    uint32_t to = paramU32(request, "to", now + 1);
+    uint32_t step = paramU32(request, "step", 1);
+    if (from >= to) {
+        request->send(400, "text/plain", "from must be before to");
+        return;
+    }
+
+    HistoryQuery query = store.makeQuery(from, to, step);
+    HistoryStore* source = &store;
+    HistoryQueryStats* totals = &stats;
+    uint32_t startedUs = Hal::micros();
+    uint32_t heapBefore = Hal::freeHeap();
+    uint32_t heapLowest = heapBefore;
+    uint32_t renderUs = 0;
+    size_t sent = 0;
+    AsyncWebServerResponse* response = request->beginChunkedResponse(
+        "application/json",
+        [source, totals, query, startedUs, heapBefore, heapLowest, renderUs, sent](
+            uint8_t* buffer, size_t maxLen, size_t index) mutable -> size_t {
+            uint32_t heap = Hal::freeHeap();
+            heapLowest = heap < heapLowest ? heap : heapLowest;
+            uint32_t began = Hal::micros();
+            size_t length = source->readJson(query, index, buffer, maxLen);
+            renderUs += Hal::micros() - began;
+            sent += length;
+            if (length == 0) {
+                totals->count++;
+                totals->rows = query.rows;
+                totals->bytes = (uint32_t)sent;
+                totals->renderUs = renderUs;
+                totals->totalUs = Hal::micros() - startedUs;
+                totals->heapUsed = heapBefore - heapLowest;
+                totals->maxRenderUs = renderUs > totals->maxRenderUs ? renderUs : totals->maxRenderUs;
+            }
+            return length;
+        });
+    request->send(response);
+}
+
+void HistoryServer::handleStatus(AsyncWebServerRequest* request) {
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->printf("{\"clock\":\"%s\",\"now\":%lu,\"memory_bytes\":%lu,"
+                     "\"seconds\":{\"capacity\":%d,\"stored\":%lu},"
+                     "\"minutes\":{\"capacity\":%d,\"stored\":%lu},\"max_points\":%d,",
+                     store.hasUnixTime() ? "unix" : "uptime", (unsigned long)store.now(),
+                     (unsigned long)store.getMemorySize(), HISTORY_SECONDS,
+                     (unsigned long)store.storedPoints(0), HISTORY_MINUTES,
+                     (unsigned long)store.storedPoints(1), HISTORY_MAX_POINTS);
+    response->printf("\"last_query\":{\"count\":%lu,\"rows\":%lu,\"bytes\":%lu,\"render_us\":%lu,"
+                     "\"total_us\":%lu,\"heap_used\":%lu,\"max_render_us\":%lu}}",
+                     (unsigned long)stats.count, (unsigned long)stats.rows, (unsigned long)stats.bytes,
+                     (unsigned long)stats.renderUs, (unsigned long)stats.totalUs, (unsigned long)stats.heapUsed,
+                     (unsigned long)stats.maxRenderUs);
+    request->send(response);
+}
+
+const HistoryQueryStats& HistoryServer::getStats() const {
+    return stats;
+}
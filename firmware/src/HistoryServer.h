@@ -0,0 +1,51 @@
+#ifndef HISTORY_SERVER_H
+#define HISTORY_SERVER_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "HistoryStore.h"
+
+/**
+ * Итоги последнего ответа /history (для /history/status и вывода в Serial)
+ */
+struct HistoryQueryStats {
+    uint32_t count;          // Ответов с запуска
+    uint32_t rows;
+    uint32_t bytes;
+    uint32_t renderUs;       // Генерация JSON из колец, сумма по кускам
+    uint32_t totalUs;        // От запроса до последнего куска (с передачей по сети)
+    uint32_t heapUsed;       // Свободная куча перед ответом минус наименьшая во время
+    uint32_t maxRenderUs;    // Наибольшее renderUs с запуска
+};
+
+/**
+ * HTTP-доступ к истории в памяти устройства
+ *
+ *   GET /history?last=S&step=S           — последние S секунд (по умолчанию 600)
+ *   GET /history?from=T&to=T&step=S      — диапазон в часах ответа (clock)
+ *   GET /history/status                  — заполненность колец, память, последний ответ
+ *
+ * Ответ /history идёт chunked прямо из колец HistoryStore: сколько бы строк
+ * ни было, куча держит лишь кусок, который просит веб-сервер.
+ */
+class HistoryServer {
+public:
+    explicit HistoryServer(HistoryStore& store);
+
+    /**
+     * Зарегистрировать обработчики на веб-сервере
+     */
+    void begin(AsyncWebServer& server);
+
+    const HistoryQueryStats& getStats() const;
+
+private:
+    HistoryStore& store;
+    HistoryQueryStats stats;
+
+    void handleQuery(AsyncWebServerRequest* request);
+    void handleStatus(AsyncWebServerRequest* request);
+};
+
+#endif // HISTORY_SERVER_H
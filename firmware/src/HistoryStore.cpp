@@ -0,0 +1,398 @@
+#include "HistoryStore.h"
+#include "LineProtocol.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+static const char JSON_FOOTER[] = "]}\n";
+static const size_t JSON_FOOTER_LENGTH = sizeof(JSON_FOOTER) - 1;
+
+static uint16_t toCenti(float value) {
+    long centi = lroundf(value * 100.0f);
+    return (uint16_t)(centi < 0 ? 0 : (centi > 65535 ? 65535 : centi));
+}
+
+static int16_t toMilliHz(float frequency) {
+    long mhz = lroundf((frequency - NOMINAL_FREQUENCY) * 1000.0f);
+    return (int16_t)(mhz < -32768 ? -32768 : (mhz > 32767 ? 32767 : mhz));
+}
+
+HistoryStore::HistoryStore()
+    : memory(nullptr),
+      memorySize(0),
+      lastUptimeS(0),
+      unixOffset(0),
+      phases(3) {
+    memset(tiers, 0, sizeof(tiers));
+    memset(&minute, 0, sizeof(minute));
+    minute.minute = EMPTY;
+}
+
+HistoryStore::~HistoryStore() {
+    free(memory);
+}
+
+bool HistoryStore::begin() {
+    static const uint32_t capacities[2] = {HISTORY_SECONDS, HISTORY_MINUTES};
+    static const uint32_t resolutions[2] = {1, 60};
+    if (memory != nullptr) {
+        return true;
+    }
+
+    size_t size = 0;
+    for (int t = 0; t < 2; t++) {
+        size += capacities[t] * (sizeof(HistoryPoint) + sizeof(uint32_t));
+    }
+    memory = static_cast<uint8_t*>(malloc(size));
+    if (memory == nullptr) {
+        return false;
+    }
+    memorySize = size;
+
+    // Времена — первыми: выравнивание по 4 байта
+    uint8_t* next = memory;
+    for (int t = 0; t < 2; t++) {
+        tiers[t].times = reinterpret_cast<volatile uint32_t*>(next);
+        next += capacities[t] * sizeof(uint32_t);
+    }
+    for (int t = 0; t < 2; t++) {
+        tiers[t].points = reinterpret_cast<HistoryPoint*>(next);
+        next += capacities[t] * sizeof(HistoryPoint);
+        tiers[t].capacity = capacities[t];
+        tiers[t].resolutionS = resolutions[t];
+        for (uint32_t i = 0; i < capacities[t]; i++) {
+            tiers[t].times[i] = EMPTY;
+        }
+    }
+    return true;
+}
+
+void HistoryStore::store(uint8_t tier, uint32_t timeS, const HistoryPoint& point) {
+    Tier& t = tiers[tier];
+    uint32_t slot = timeS / t.resolutionS % t.capacity;
+    t.times[slot] = EMPTY;
+    std::atomic_thread_fence(std::memory_order_release);
+    t.points[slot] = point;
+    std::atomic_thread_fence(std::memory_order_release);
+    t.times[slot] = timeS;
+}
+
+bool HistoryStore::load(uint8_t tier, uint32_t timeS, HistoryPoint& out) const {
+    const Tier& t = tiers[tier];
+    uint32_t slot = timeS / t.resolutionS % t.capacity;
+    if (t.times[slot] != timeS) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    out = t.points[slot];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return t.times[slot] == timeS;
+}
+
+void HistoryStore::add(const PowerData& data, int phases, uint32_t uptimeS, uint32_t unixTime) {
+    if (memory == nullptr) {
+        return;
+    }
+    if (phases > 3) {
+        phases = 3;
+    }
+    this->phases = phases;
+    // Секунды работы и unix-время тикают не вместе: смещение дрожит на секунду,
+    // его меняем только при скачке часов (синхронизация NTP)
+    if (unixTime > 1700000000 && unixTime > uptimeS) {
+        uint32_t offset = unixTime - uptimeS;
+        uint32_t current = unixOffset;
+        if (current == 0 || offset > current + 1 || offset + 1 < current) {
+            unixOffset = offset;
+        }
+    }
+
+    const float voltages[3] = {data.voltageA, data.voltageB, data.voltageC};
+    HistoryPoint point;
+    memset(&point, 0, sizeof(point));
+    float low = voltages[0];
+    float high = voltages[0];
+    for (int ph = 0; ph < phases; ph++) {
+        point.voltageCv[ph] = toCenti(voltages[ph]);
+        low = voltages[ph] < low ? voltages[ph] : low;
+        high = voltages[ph] > high ? voltages[ph] : high;
+    }
+    point.voltageMinCv = toCenti(low);
+    point.voltageMaxCv = toCenti(high);
+    point.frequencyMhz = toMilliHz(data.frequencyAvg);
+    point.unbalanceCpct = toCenti(data.unbalance);
+    point.count = 1;
+    point.activePowerW = (int32_t)lroundf(data.activePower);
+    store(0, uptimeS, point);
+
+    // Минута закрывается первым измерением следующей
+    uint32_t minuteStart = uptimeS - uptimeS % 60;
+    if (minute.minute != minuteStart) {
+        flushMinute();
+        memset(&minute, 0, sizeof(minute));
+        minute.minute = minuteStart;
+        minute.voltageMin = low;
+        minute.voltageMax = high;
+    }
+    for (int ph = 0; ph < phases; ph++) {
+        minute.voltageSum[ph] += voltages[ph];
+    }
+    minute.voltageMin = low < minute.voltageMin ? low : minute.voltageMin;
+    minute.voltageMax = high > minute.voltageMax ? high : minute.voltageMax;
+    minute.frequencySum += data.frequencyAvg;
+    minute.unbalanceSum += data.unbalance;
+    minute.activePowerSum += data.activePower;
+    minute.count++;
+    lastUptimeS = uptimeS;
+}
+
+void HistoryStore::flushMinute() {
+    if (minute.count == 0 || minute.minute == EMPTY) {
+        return;
+    }
+    const float n = (float)minute.count;
+    HistoryPoint point;
+    memset(&point, 0, sizeof(point));
+    for (int ph = 0; ph < phases; ph++) {
+        point.voltageCv[ph] = toCenti(minute.voltageSum[ph] / n);
+    }
+    point.voltageMinCv = toCenti(minute.voltageMin);
+    point.voltageMaxCv = toCenti(minute.voltageMax);
+    point.frequencyMhz = toMilliHz(minute.frequencySum / n);
+    point.unbalanceCpct = toCenti(minute.unbalanceSum / n);
+    point.count = (uint16_t)minute.count;
+    point.activePowerW = (int32_t)lroundf(minute.activePowerSum / n);
+    store(1, minute.minute, point);
+}
+
+bool HistoryStore::aggregate(uint8_t tier, uint32_t fromS, uint32_t stepS, HistoryPoint& out) const {
+    const Tier& t = tiers[tier];
+    if (memory == nullptr) {
+        return false;
+    }
+    uint32_t count = 0;
+    uint64_t voltageSum[3] = {0, 0, 0};
+    uint16_t low = 0xFFFF;
+    uint16_t high = 0;
+    int64_t frequencySum = 0;
+    uint64_t unbalanceSum = 0;
+    int64_t powerSum = 0;
+    for (uint32_t time = fromS - fromS % t.resolutionS; time < fromS + stepS; time += t.resolutionS) {
+        HistoryPoint point;
+        if (!load(tier, time, point)) {
+            continue;
+        }
+        // Средние взвешиваются числом измерений в точке
+        for (int ph = 0; ph < 3; ph++) {
+            voltageSum[ph] += (uint64_t)point.voltageCv[ph] * point.count;
+        }
+        low = point.voltageMinCv < low ? point.voltageMinCv : low;
+        high = point.voltageMaxCv > high ? point.voltageMaxCv : high;
+        frequencySum += (int64_t)point.frequencyMhz * point.count;
+        unbalanceSum += (uint64_t)point.unbalanceCpct * point.count;
+        powerSum += (int64_t)point.activePowerW * point.count;
+        count += point.count;
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    const uint32_t half = count / 2;
+    for (int ph = 0; ph < 3; ph++) {
+        out.voltageCv[ph] = (uint16_t)((voltageSum[ph] + half) / count);
+    }
+    out.voltageMinCv = low;
+    out.voltageMaxCv = high;
+    out.frequencyMhz = (int16_t)llround((double)frequencySum / count);
+    out.unbalanceCpct = (uint16_t)((unbalanceSum + half) / count);
+    out.activePowerW = (int32_t)llround((double)powerSum / count);
+    out.count = (uint16_t)(count > 65535 ? 65535 : count);
+    return true;
+}
+
+HistoryQuery HistoryStore::makeQuery(uint32_t from, uint32_t to, uint32_t stepS) const {
+    HistoryQuery query;
+    memset(&query, 0, sizeof(query));
+    query.unixOffset = unixOffset;
+
+    // В секунды работы
+    uint32_t offset = query.unixOffset;
+    uint32_t fromS = from > offset ? from - offset : 0;
+    uint32_t toS = to > offset ? to - offset : 0;
+    uint32_t endS = lastUptimeS + 1;
+    toS = toS < endS ? toS : endS;
+    fromS = fromS < toS ? fromS : toS;
+
+    uint32_t oldestSecond = endS > HISTORY_SECONDS ? endS - HISTORY_SECONDS : 0;
+    query.tier = (stepS < 60 && fromS >= oldestSecond) ? 0 : 1;
+    uint32_t resolution = tiers[query.tier].resolutionS != 0 ? tiers[query.tier].resolutionS : 1;
+
+    uint32_t span = toS - fromS;
+    uint32_t minStep = (span + HISTORY_MAX_POINTS - 1) / HISTORY_MAX_POINTS;
+    stepS = stepS > minStep ? stepS : minStep;
+    stepS = stepS > resolution ? stepS : resolution;
+    stepS = (stepS + resolution - 1) / resolution * resolution;
+
+    // Строки выровнены по шагу от начала работы: у соседних запросов совпадают
+    fromS -= fromS % stepS;
+    query.fromS = fromS;
+    query.stepS = stepS;
+    query.rows = (toS - fromS + stepS - 1) / stepS;
+    query.toS = fromS + query.rows * stepS;
+
+    char header[HISTORY_HEADER_SIZE];
+    query.headerLength = writeHeader(query, header, sizeof(header));
+    return query;
+}
+
+size_t HistoryStore::writeHeader(const HistoryQuery& query, char* out, size_t size) const {
+    int length = snprintf(out, size,
+                          "{\"clock\":\"%s\",\"resolution\":%lu,\"step\":%lu,\"from\":%lu,\"to\":%lu,"
+                          "\"columns\":[\"t\",\"v_a\",\"v_b\",\"v_c\",\"v_min\",\"v_max\",\"frequency\","
+                          "\"unbalance\",\"power\"],\"points\":[\n",
+                          query.unixOffset != 0 ? "unix" : "uptime",
+                          (unsigned long)(query.tier == 0 ? 1 : 60), (unsigned long)query.stepS,
+                          (unsigned long)(query.fromS + query.unixOffset),
+                          (unsigned long)(query.toS + query.unixOffset));
+    return length > 0 && (size_t)length < size ? (size_t)length : 0;
+}
+
+void HistoryStore::writeRow(const HistoryQuery& query, uint32_t row, char* out) const {
+    uint32_t timeS = query.fromS + row * query.stepS;
+    unsigned long t = (unsigned long)(timeS + query.unixOffset);
+    HistoryPoint point;
+    int length;
+    if (!aggregate(query.tier, timeS, query.stepS, point)) {
+        length = snprintf(out, HISTORY_ROW_CHARS + 1, "[%lu,null,null,null,null,null,null,null,null]", t);
+    } else {
+        char voltages[3][8];
+        for (int ph = 0; ph < 3; ph++) {
+            if (ph < phases) {
+                snprintf(voltages[ph], sizeof(voltages[ph]), "%u.%02u", point.voltageCv[ph] / 100,
+                         point.voltageCv[ph] % 100);
+            } else {
+                strcpy(voltages[ph], "null");
+            }
+        }
+        // Частота целыми мГц: без плавающей точки в printf
+        long mhz = lroundf(NOMINAL_FREQUENCY * 1000.0f) + point.frequencyMhz;
+        length = snprintf(out, HISTORY_ROW_CHARS + 1, "[%lu,%s,%s,%s,%u.%02u,%u.%02u,%ld.%03ld,%u.%02u,%ld]", t,
+                          voltages[0], voltages[1], voltages[2], point.voltageMinCv / 100, point.voltageMinCv % 100,
+                          point.voltageMaxCv / 100, point.voltageMaxCv % 100, mhz / 1000, mhz % 1000,
+                          point.unbalanceCpct / 100, point.unbalanceCpct % 100, (long)point.activePowerW);
+    }
+
+    // Дополнить пробелами до ширины строки; последняя — без запятой
+    if (length < 0 || length > HISTORY_ROW_CHARS - 2) {
+        length = 0;
+    }
+    memset(out + length, ' ', HISTORY_ROW_CHARS - length);
+    out[HISTORY_ROW_CHARS - 2] = row + 1 < query.rows ? ',' : ' ';
+    out[HISTORY_ROW_CHARS - 1] = '\n';
+}
+
+size_t HistoryStore::jsonLength(const HistoryQuery& query) const {
+    return query.headerLength + (size_t)query.rows * HISTORY_ROW_CHARS + JSON_FOOTER_LENGTH;
+}
+
+size_t HistoryStore::readJson(const HistoryQuery& query, size_t offset, uint8_t* out, size_t maxLen) const {
+    const size_t rowsEnd = query.headerLength + (size_t)query.rows * HISTORY_ROW_CHARS;
+    const size_t total = rowsEnd + JSON_FOOTER_LENGTH;
+    if (query.headerLength == 0) {
+        return 0;
+    }
+
+    char part[HISTORY_HEADER_SIZE > HISTORY_ROW_CHARS + 1 ? HISTORY_HEADER_SIZE : HISTORY_ROW_CHARS + 1];
+    size_t written = 0;
+    while (written < maxLen && offset < total) {
+        size_t base;
+        size_t length;
+        if (offset < query.headerLength) {
+            base = 0;
+            length = writeHeader(query, part, sizeof(part));
+        } else if (offset < rowsEnd) {
+            uint32_t row = (uint32_t)((offset - query.headerLength) / HISTORY_ROW_CHARS);
+            base = query.headerLength + (size_t)row * HISTORY_ROW_CHARS;
+            length = HISTORY_ROW_CHARS;
+            writeRow(query, row, part);
+        } else {
+            base = rowsEnd;
+            length = JSON_FOOTER_LENGTH;
+            memcpy(part, JSON_FOOTER, JSON_FOOTER_LENGTH);
+        }
+        size_t within = offset - base;
+        size_t chunk = length - within;
+        chunk = chunk < maxLen - written ? chunk : maxLen - written;
+        memcpy(out + written, part + within, chunk);
+        written += chunk;
+        offset += chunk;
+    }
+    return written;
+}
+
+size_t HistoryStore::writeLineProtocol(uint32_t fromS, uint32_t toS, char* buffer, size_t size,
+                                       const char* deviceId) const {
+    static const char* const phaseNames[3] = {"A", "B", "C"};
+    const uint32_t offset = unixOffset;
+    if (memory == nullptr || offset == 0) {
+        return 0;
+    }
+
+    LineWriter out(buffer, size);
+    for (uint32_t t = fromS; t < toS; t++) {
+        HistoryPoint point;
+        if (!load(0, t, point)) {
+            continue;
+        }
+        const uint64_t timeMs = (uint64_t)(t + offset) * 1000;
+        for (int ph = 0; ph < phases; ph++) {
+            out.begin("voltage");
+            out.tag("device", deviceId);
+            out.tag("phase", phaseNames[ph]);
+            out.field("value", point.voltageCv[ph] / 100.0f, 2);
+            out.end(timeMs);
+        }
+        out.begin("frequency");
+        out.tag("device", deviceId);
+        out.field("value", NOMINAL_FREQUENCY + point.frequencyMhz / 1000.0f, 3);
+        out.end(timeMs);
+        if (phases == 3) {
+            out.begin("unbalance");
+            out.tag("device", deviceId);
+            out.field("value", point.unbalanceCpct / 100.0f, 2);
+            out.end(timeMs);
+        }
+    }
+    return out.overflowed() ? 0 : out.length();
+}
+
+uint32_t HistoryStore::now() const {
+    return lastUptimeS + unixOffset;
+}
+
+bool HistoryStore::hasUnixTime() const {
+    return unixOffset != 0;
+}
+
+uint32_t HistoryStore::storedPoints(uint8_t tier) const {
+    const Tier& t = tiers[tier];
+    if (memory == nullptr) {
+        return 0;
+    }
+    uint32_t span = t.capacity * t.resolutionS;
+    uint32_t newest = lastUptimeS;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < t.capacity; i++) {
+        uint32_t time = t.times[i];
+        if (time != EMPTY && time <= newest && newest - time < span) {
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t HistoryStore::getMemorySize() const {
+    return memorySize;
+}
@@ -0,0 +1,182 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "PowerData.h"
+
+// Строка ответа /history фиксированной ширины (дополняется пробелами):
+// смещение в ответе однозначно даёт номер строки, как в readEnvelope()
+#define HISTORY_ROW_CHARS 80
+
+// Заголовок ответа до массива точек
+#define HISTORY_HEADER_SIZE 320
+
+/**
+ * Точка истории: среднее за секунду или за минуту
+ */
+struct HistoryPoint {
+    uint16_t voltageCv[3];   // Средние напряжения фаз, 0.01 В (0 — фазы нет)
+    uint16_t voltageMinCv;   // Наименьшее и наибольшее напряжение фаз внутри точки
+    uint16_t voltageMaxCv;
+    int16_t frequencyMhz;    // Отклонение от NOMINAL_FREQUENCY, мГц
+    uint16_t unbalanceCpct;  // Перекос, 0.01 %
+    uint16_t count;          // Измерений в точке
+    int32_t activePowerW;    // Суммарная активная мощность
+};
+
+static_assert(sizeof(HistoryPoint) == 20, "HistoryPoint layout changed");
+
+/**
+ * Выборка для одного ответа (makeQuery): строки по stepS секунд времени работы
+ * [fromS, toS) из уровня tier
+ */
+struct HistoryQuery {
+    uint8_t tier;           // 0 — секундный уровень, 1 — минутный
+    uint32_t fromS;
+    uint32_t toS;
+    uint32_t stepS;
+    uint32_t rows;
+    uint32_t unixOffset;    // Unix-время минус время работы; 0 — часы не синхронизированы
+    uint32_t headerLength;
+};
+
+/**
+ * История измерений в памяти устройства: видна без InfluxDB и без сети
+ *
+ * Два кольца фиксированного размера, выделяемые один раз в begin():
+ *   - HISTORY_SECONDS точек раз в секунду (последние 10 минут);
+ *   - HISTORY_MINUTES точек раз в минуту (последние сутки): средние за минуту,
+ *     наименьшее и наибольшее напряжение. Минута уходит в кольцо, когда
+ *     начинается следующая.
+ * Ячейка — время % ёмкость; рядом с точкой хранится её время, поэтому
+ * перезаписанные и пропущенные (перезапуск измерений, захват АЦП) секунды
+ * видны как пустые.
+ *
+ * Время точек — секунды работы устройства: история пишется и до синхронизации
+ * NTP. Ответ переводит его в unix-время, как только известно смещение.
+ *
+ * Писатель — loop(), читатель — веб-сервер (задача async_tcp). Писатель
+ * обнуляет время ячейки, пишет точку и ставит новое время; читатель
+ * копирует точку и сверяет время ещё раз, так что рваная точка не попадёт
+ * в ответ (seqlock на ячейку, как SeqLock.h, без ожидания писателя).
+ *
+ * Ответ — JSON, который readJson() генерирует кусками прямо из колец:
+ * документ целиком в памяти не собирается.
+ * {"clock":"unix","resolution":1,"step":10,"from":..,"to":..,"columns":[..],"points":[
+ * [t,v_a,v_b,v_c,v_min,v_max,frequency,unbalance,power],
+ * ...
+ * ]}
+ * Строки фиксированной ширины HISTORY_ROW_CHARS; интервал без измерений —
+ * строка с null вместо значений (разрыв на графике).
+ */
+class HistoryStore {
+public:
+    HistoryStore();
+    ~HistoryStore();
+
+    /**
+     * Выделить кольца
+     * @return false если не хватило памяти (история отключена)
+     */
+    bool begin();
+
+    /**
+     * Добавить измерение
+     * @param data Результаты за секунду
+     * @param phases Фаз напряжения (остальные не пишутся)
+     * @param uptimeS Время работы, с
+     * @param unixTime Unix-время (0 или до 2023 года — часы не синхронизированы)
+     */
+    void add(const PowerData& data, int phases, uint32_t uptimeS, uint32_t unixTime);
+
+    /**
+     * Выбрать уровень и шаг для [from, to) (в единицах clock: unix-время после
+     * синхронизации часов, иначе время работы) не больше чем HISTORY_MAX_POINTS
+     * строками. Шаг меньше минуты берётся из секундного уровня, если тот
+     * покрывает from; шаг округляется вверх до кратного разрешения уровня.
+     */
+    HistoryQuery makeQuery(uint32_t from, uint32_t to, uint32_t stepS) const;
+
+    /**
+     * Кусок ответа JSON
+     * @return Записано байт; 0 — конец
+     */
+    size_t readJson(const HistoryQuery& query, size_t offset, uint8_t* out, size_t maxLen) const;
+
+    /**
+     * Полная длина ответа, байт
+     */
+    size_t jsonLength(const HistoryQuery& query) const;
+
+    /**
+     * Свести точки уровня за [fromS, fromS + stepS)
+     * @return false если в интервале нет измерений
+     */
+    bool aggregate(uint8_t tier, uint32_t fromS, uint32_t stepS, HistoryPoint& out) const;
+
+    /**
+     * Line Protocol секунд работы [fromS, toS) секундного уровня с метками
+     * времени (мс): voltage, frequency, unbalance — те же ряды, что шлёт
+     * измерение, для досылки того, что измерено до первой отправки
+     * @return Длина; 0 — нет точек, часы не синхронизированы или не поместилось
+     */
+    size_t writeLineProtocol(uint32_t fromS, uint32_t toS, char* buffer, size_t size,
+                             const char* deviceId) const;
+
+    /**
+     * Текущие часы ответа: unix-время после синхронизации, иначе время работы
+     */
+    uint32_t now() const;
+    bool hasUnixTime() const;
+
+    /**
+     * Заполненных точек уровня (за последний оборот кольца)
+     */
+    uint32_t storedPoints(uint8_t tier) const;
+
+    /**
+     * Занято памяти колец, байт (0 — не выделены)
+     */
+    size_t getMemorySize() const;
+
+private:
+    struct Tier {
+        HistoryPoint* points;
+        volatile uint32_t* times;   // Время начала точки; EMPTY — ячейка пишется или пуста
+        uint32_t capacity;
+        uint32_t resolutionS;
+    };
+
+    // Сумма минуты до записи в кольцо
+    struct Accumulator {
+        uint32_t minute;
+        uint32_t count;
+        float voltageSum[3];
+        float voltageMin;
+        float voltageMax;
+        float frequencySum;
+        float unbalanceSum;
+        float activePowerSum;
+    };
+
+    static const uint32_t EMPTY = 0xFFFFFFFFu;
+
+    Tier tiers[2];
+    uint8_t* memory;
+    size_t memorySize;
+    Accumulator minute;
+    volatile uint32_t lastUptimeS;
+    volatile uint32_t unixOffset;
+    volatile int phases;
+
+    void store(uint8_t tier, uint32_t timeS, const HistoryPoint& point);
+    bool load(uint8_t tier, uint32_t timeS, HistoryPoint& out) const;
+    void flushMinute();
+
+    size_t writeHeader(const HistoryQuery& query, char* out, size_t size) const;
+    void writeRow(const HistoryQuery& query, uint32_t row, char* out) const;
+};
+
+#endif // HISTORY_STORE_H
@@ -0,0 +1,407 @@
+#include "HttpConnection.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "hal/Hal.h"
+
+// readByte(): конец потока и ошибка чтения
+#define RX_EOF -1
+#define RX_ERROR -2
+
+static void toHex(const uint8_t* data, size_t length, char* out) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < length; i++) {
+        out[i * 2] = digits[data[i] >> 4];
+        out[i * 2 + 1] = digits[data[i] & 0x0F];
+    }
+    out[length * 2] = '\0';
+}
+
+/**
+ * Значение заголовка содержит слово (без учёта регистра)
+ */
+static bool hasToken(const char* value, const char* token) {
+    size_t length = strlen(token);
+    for (; *value != '\0'; value++) {
+        if (strncasecmp(value, token, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+HttpConnection::HttpConnection()
+    : port(0),
+      secure(false),
+      configured(false),
+      timeoutMs(HTTP_TIMEOUT_MS),
+      idleTimeoutMs(0),
+      lastUsedMs(0),
+      pinNamespace(nullptr),
+      pinKey(nullptr),
+      trustFirstKey(false),
+      pinned(false),
+      rxStart(0),
+      rxEnd(0),
+      rxClosed(false) {
+    host[0] = '\0';
+    memset(pin, 0, sizeof(pin));
+    lastBody[0] = '\0';
+    lastError[0] = '\0';
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool HttpConnection::begin(const char* url, uint32_t timeoutMs) {
+    close();
+    configured = false;
+    this->timeoutMs = timeoutMs;
+
+    const char* rest;
+    if (strncmp(url, "https://", 8) == 0) {
+        secure = true;
+        port = 443;
+        rest = url + 8;
+    } else if (strncmp(url, "http://", 7) == 0) {
+        secure = false;
+        port = 80;
+        rest = url + 7;
+    } else {
+        snprintf(lastError, sizeof(lastError), "unsupported URL %s", url);
+        return false;
+    }
+
+    size_t hostLength = strcspn(rest, ":/");
+    if (hostLength == 0 || hostLength >= sizeof(host)) {
+        snprintf(lastError, sizeof(lastError), "bad host in %s", url);
+        return false;
+    }
+    memcpy(host, rest, hostLength);
+    host[hostLength] = '\0';
+    if (rest[hostLength] == ':') {
+        long value = strtol(rest + hostLength + 1, nullptr, 10);
+        if (value <= 0 || value > 65535) {
+            snprintf(lastError, sizeof(lastError), "bad port in %s", url);
+            return false;
+        }
+        port = (uint16_t)value;
+    }
+    configured = true;
+    return true;
+}
+
+void HttpConnection::usePinStorage(const char* ns, const char* key, bool trustFirstKey) {
+    static const uint8_t none[32] = {0};
+    pinNamespace = ns;
+    pinKey = key;
+    this->trustFirstKey = trustFirstKey;
+    pinned = Hal::storageRead(ns, key, pin, sizeof(pin)) && memcmp(pin, none, sizeof(pin)) != 0;
+    if (!pinned) {
+        memset(pin, 0, sizeof(pin));
+    }
+}
+
+void HttpConnection::setPin(const uint8_t* sha256) {
+    pinned = sha256 != nullptr;
+    if (pinned) {
+        memcpy(pin, sha256, sizeof(pin));
+    } else {
+        memset(pin, 0, sizeof(pin));
+    }
+    if (pinNamespace != nullptr) {
+        Hal::storageWrite(pinNamespace, pinKey, pin, sizeof(pin));
+    }
+    // Сессия выдана сервером, сверенным со старым отпечатком
+    socket.close();
+    socket.forgetSession();
+}
+
+bool HttpConnection::getPin(uint8_t sha256[32]) const {
+    if (pinned) {
+        memcpy(sha256, pin, sizeof(pin));
+    }
+    return pinned;
+}
+
+void HttpConnection::setIdleTimeout(uint32_t ms) {
+    idleTimeoutMs = ms;
+}
+
+int HttpConnection::request(const char* method, const char* path, const char* headers,
+                            const void* body, size_t length) {
+    if (!configured) {
+        return ERROR_URL;
+    }
+    char head[HTTP_REQUEST_HEAD_SIZE];
+    char hostHeader[HTTP_HOST_SIZE + 8];
+    if (port == (secure ? 443 : 80)) {
+        snprintf(hostHeader, sizeof(hostHeader), "%s", host);
+    } else {
+        snprintf(hostHeader, sizeof(hostHeader), "%s:%u", host, port);
+    }
+    int headLength = snprintf(head, sizeof(head),
+                              "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\nContent-Length: %u\r\n%s\r\n",
+                              method, path, hostHeader, (unsigned)length, headers != nullptr ? headers : "");
+    if (headLength < 0 || headLength >= (int)sizeof(head)) {
+        snprintf(lastError, sizeof(lastError), "request head over %d B", HTTP_REQUEST_HEAD_SIZE);
+        return ERROR_IO;
+    }
+
+    stats.requests++;
+    lastBody[0] = '\0';
+    if (socket.isOpen() && idleTimeoutMs > 0 && Hal::millis() - lastUsedMs > idleTimeoutMs) {
+        socket.close();
+    }
+    bool reused = socket.isOpen();
+    for (;;) {
+        if (!socket.isOpen()) {
+            int result = open();
+            if (result < 0) {
+                return result;
+            }
+        }
+
+        rxStart = 0;
+        rxEnd = 0;
+        rxClosed = false;
+        bool keepOpen = false;
+        int code = 0;
+        if (socket.write(head, (size_t)headLength) && (length == 0 || socket.write(body, length))) {
+            code = readResponse(keepOpen);
+        }
+
+        // Сервер закрыл простаивавшее соединение: запрос до него не дошёл
+        if (code == 0 && reused) {
+            stats.staleRetries++;
+            socket.close();
+            reused = false;
+            continue;
+        }
+        if (code <= 0) {
+            snprintf(lastError, sizeof(lastError), "%s", socket.getError());
+            socket.close();
+            return code == 0 ? ERROR_IO : code;
+        }
+
+        if (reused) {
+            stats.reusedRequests++;
+        }
+        if (!keepOpen) {
+            socket.close();
+        }
+        lastUsedMs = Hal::millis();
+        return code;
+    }
+}
+
+void HttpConnection::close() {
+    socket.close();
+}
+
+bool HttpConnection::isConnected() const {
+    return socket.isOpen();
+}
+
+bool HttpConnection::isSecure() const {
+    return secure;
+}
+
+const char* HttpConnection::getLastBody() const {
+    return lastBody;
+}
+
+const char* HttpConnection::getLastError() const {
+    return lastError;
+}
+
+const HttpConnectionStats& HttpConnection::getStats() const {
+    return stats;
+}
+
+float HttpConnection::getResumeRate() const {
+    return stats.sessionOffers > 0 ? (float)stats.resumedHandshakes / stats.sessionOffers : 0.0f;
+}
+
+uint32_t HttpConnection::getAverageHandshakeUs(bool resumed) const {
+    uint32_t count = resumed ? stats.resumedHandshakes : stats.fullHandshakes;
+    uint64_t total = resumed ? stats.resumedHandshakeUsTotal : stats.fullHandshakeUsTotal;
+    return count > 0 ? (uint32_t)(total / count) : 0;
+}
+
+int HttpConnection::open() {
+    if (!socket.connect(host, port, secure, timeoutMs)) {
+        stats.connectFailures++;
+        snprintf(lastError, sizeof(lastError), "%s", socket.getError());
+        return ERROR_CONNECT;
+    }
+    if (secure) {
+        uint32_t us = socket.getHandshakeUs();
+        stats.lastHandshakeUs = us;
+        if (socket.wasSessionOffered()) {
+            stats.sessionOffers++;
+        }
+        if (socket.wasResumed()) {
+            stats.resumedHandshakes++;
+            stats.resumedHandshakeUsTotal += us;
+        } else {
+            stats.fullHandshakes++;
+            stats.fullHandshakeUsTotal += us;
+            stats.maxFullHandshakeUs = us > stats.maxFullHandshakeUs ? us : stats.maxFullHandshakeUs;
+            if (!checkPeerKey()) {
+                stats.pinFailures++;
+                stats.connectFailures++;
+                socket.close();
+                socket.forgetSession();
+                return ERROR_PIN;
+            }
+        }
+    }
+    stats.connects++;
+    return 0;
+}
+
+bool HttpConnection::checkPeerKey() {
+    uint8_t key[32];
+    if (!socket.getPeerKeyHash(key)) {
+        snprintf(lastError, sizeof(lastError), "no server key");
+        return false;
+    }
+    char hex[65];
+    toHex(key, sizeof(key), hex);
+    if (pinned) {
+        if (memcmp(key, pin, sizeof(pin)) != 0) {
+            snprintf(lastError, sizeof(lastError), "server key %.16s... does not match the pin", hex);
+            return false;
+        }
+        return true;
+    }
+    if (trustFirstKey) {
+        memcpy(pin, key, sizeof(pin));
+        pinned = true;
+        if (pinNamespace != nullptr) {
+            Hal::storageWrite(pinNamespace, pinKey, pin, sizeof(pin));
+        }
+        Hal::log("[Http] Pinned %s key on first use: %s\n", host, hex);
+    }
+    return true;
+}
+
+int HttpConnection::readResponse(bool& keepOpen) {
+    int first = readByte();
+    if (first < 0) {
+        return 0;
+    }
+    rxStart--;
+
+    char line[128];
+    int major = 0;
+    int minor = 0;
+    int code = 0;
+    if (readLine(line, sizeof(line)) < 0 || sscanf(line, "HTTP/%d.%d %d", &major, &minor, &code) != 3) {
+        return ERROR_RESPONSE;
+    }
+    keepOpen = major == 1 && minor >= 1;
+
+    long contentLength = -1;
+    bool chunked = false;
+    for (;;) {
+        int lineLength = readLine(line, sizeof(line));
+        if (lineLength < 0) {
+            return ERROR_IO;
+        }
+        if (lineLength == 0) {
+            break;
+        }
+        if (strncasecmp(line, "content-length:", 15) == 0) {
+            contentLength = strtol(line + 15, nullptr, 10);
+        } else if (strncasecmp(line, "transfer-encoding:", 18) == 0) {
+            chunked = hasToken(line + 18, "chunked");
+        } else if (strncasecmp(line, "connection:", 11) == 0) {
+            if (hasToken(line + 11, "close")) {
+                keepOpen = false;
+            } else if (hasToken(line + 11, "keep-alive")) {
+                keepOpen = true;
+            }
+        }
+    }
+
+    if (code == 204 || code == 304 || (code >= 100 && code < 200)) {
+        return code;
+    }
+    if (chunked) {
+        for (;;) {
+            if (readLine(line, sizeof(line)) < 0) {
+                return ERROR_IO;
+            }
+            size_t size = (size_t)strtoul(line, nullptr, 16);
+            if (size == 0) {
+                break;
+            }
+            if (!readBody(size) || readLine(line, sizeof(line)) != 0) {
+                return ERROR_IO;
+            }
+        }
+        // Завершающие заголовки до пустой строки
+        int lineLength;
+        while ((lineLength = readLine(line, sizeof(line))) > 0) {
+        }
+        return lineLength == 0 ? code : ERROR_IO;
+    }
+    if (contentLength >= 0) {
+        return readBody((size_t)contentLength) ? code : ERROR_IO;
+    }
+    // Ни длины, ни chunked: тело до закрытия соединения
+    keepOpen = false;
+    readBody(SIZE_MAX);
+    return code;
+}
+
+int HttpConnection::readByte() {
+    if (rxStart == rxEnd) {
+        if (rxClosed) {
+            return RX_EOF;
+        }
+        int received = socket.read(rx, sizeof(rx));
+        if (received <= 0) {
+            rxClosed = received == 0;
+            return received == 0 ? RX_EOF : RX_ERROR;
+        }
+        rxStart = 0;
+        rxEnd = (size_t)received;
+    }
+    return rx[rxStart++];
+}
+
+int HttpConnection::readLine(char* line, size_t size) {
+    size_t length = 0;
+    for (;;) {
+        int c = readByte();
+        if (c < 0) {
+            return c;
+        }
+        if (c == '\n') {
+            break;
+        }
+        // Длинные строки (ненужные заголовки) обрезаются
+        if (c != '\r' && length + 1 < size) {
+            line[length++] = (char)c;
+        }
+    }
+    line[length] = '\0';
+    return (int)length;
+}
+
+bool HttpConnection::readBody(size_t length) {
+    size_t stored = strlen(lastBody);
+    for (size_t i = 0; i < length; i++) {
+        int c = readByte();
+        if (c < 0) {
+            return c == RX_EOF && length == SIZE_MAX;
+        }
+        if (stored < HTTP_BODY_SNIPPET_SIZE) {
+            lastBody[stored++] = (char)c;
+            lastBody[stored] = '\0';
+        }
+    }
+    return true;
+}
@@ -0,0 +1,170 @@
+#ifndef HTTP_CONNECTION_H
+#define HTTP_CONNECTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "hal/TlsSocket.h"
+
+#define HTTP_HOST_SIZE 64
+#define HTTP_REQUEST_HEAD_SIZE 512      // Строка запроса и заголовки (с токеном InfluxDB)
+#define HTTP_BODY_SNIPPET_SIZE 160      // Начало тела ответа — для журнала ошибок
+
+/**
+ * Счётчики соединения: переиспользование и стоимость рукопожатий
+ */
+struct HttpConnectionStats {
+    uint32_t requests;              // Запросов
+    uint32_t reusedRequests;        // Из них по уже открытому соединению
+    uint32_t staleRetries;          // Открытое соединение оказалось закрытым сервером — повтор по новому
+    uint32_t connects;              // Соединений (TCP и, для https, рукопожатие со сверкой ключа)
+    uint32_t connectFailures;       // Неудачных подключений, включая несовпадение ключа
+    uint32_t pinFailures;           // Ключ сервера не совпал с отпечатком
+    uint32_t fullHandshakes;
+    uint32_t resumedHandshakes;
+    uint32_t sessionOffers;         // Рукопожатий с предложенной сессией (знаменатель доли возобновлений)
+    uint32_t lastHandshakeUs;
+    uint32_t maxFullHandshakeUs;
+    uint64_t fullHandshakeUsTotal;
+    uint64_t resumedHandshakeUsTotal;
+};
+
+/**
+ * HTTP/1.1 клиент одного сервера с постоянным соединением (http:// и https://)
+ *
+ * Соединение остаётся открытым между запросами (keep-alive); закрытое
+ * сервером за время простоя обнаруживается на следующем запросе, и запрос
+ * один раз повторяется по новому соединению. Новое соединение https
+ * предлагает сохранённую сессию TLS (TlsSocket), так что полное рукопожатие
+ * бывает только при первом подключении и после истечения сессии на сервере.
+ *
+ * Отпечаток ключа сервера (SHA-256 SubjectPublicKeyInfo) хранится в NVS
+ * (usePinStorage) и сверяется после каждого полного рукопожатия; при
+ * несовпадении соединение и сессия сбрасываются, запрос не уходит.
+ *
+ * Переносимый: на ESP32 и на хосте (bench --tls-check) один и тот же код.
+ * Один экземпляр — одна задача: ping() InfluxClient из фоновой задачи
+ * идёт через свой экземпляр.
+ */
+class HttpConnection {
+public:
+    static const int ERROR_URL = -1;           // URL не разобран
+    static const int ERROR_CONNECT = -2;       // TCP или рукопожатие TLS
+    static const int ERROR_PIN = -3;           // Ключ сервера не совпал с отпечатком
+    static const int ERROR_IO = -4;            // Запись, чтение или таймаут
+    static const int ERROR_RESPONSE = -5;      // Ответ не разобран
+
+    HttpConnection();
+
+    /**
+     * @param url http://host[:port] или https://host[:port]; путь, если есть, игнорируется
+     * @param timeoutMs Таймаут подключения и ожидания ответа
+     * @return false если URL не разобран
+     */
+    bool begin(const char* url, uint32_t timeoutMs);
+
+    /**
+     * Хранить отпечаток ключа в NVS (Hal::storageRead/storageWrite)
+     * @param trustFirstKey Нет отпечатка — запомнить ключ первого полного рукопожатия
+     */
+    void usePinStorage(const char* ns, const char* key, bool trustFirstKey);
+
+    /**
+     * Задать отпечаток (и записать в NVS, если usePinStorage); nullptr — снять.
+     * Открытое соединение и сессия сбрасываются: следующее рукопожатие полное.
+     */
+    void setPin(const uint8_t* sha256);
+    bool getPin(uint8_t sha256[32]) const;
+
+    /**
+     * Соединение, простаивавшее дольше, перед запросом открывается заново
+     * (по сохранённой сессии): не ждать таймаута на полуоткрытом после смены
+     * сети или NAT. 0 — без ограничения.
+     */
+    void setIdleTimeout(uint32_t ms);
+
+    /**
+     * Выполнить запрос и прочитать ответ целиком
+     * @param headers Дополнительные строки заголовков, каждая с "\r\n" (или nullptr)
+     * @return Код HTTP или ERROR_*
+     */
+    int request(const char* method, const char* path, const char* headers, const void* body, size_t length);
+
+    /**
+     * Закрыть соединение (сессия TLS сохраняется)
+     */
+    void close();
+
+    bool isConnected() const;
+    bool isSecure() const;
+
+    /**
+     * Начало тела последнего ответа (для журнала), строка
+     */
+    const char* getLastBody() const;
+
+    /**
+     * Причина последней ошибки подключения
+     */
+    const char* getLastError() const;
+
+    const HttpConnectionStats& getStats() const;
+
+    /**
+     * Доля предложенных сессий, принятых сервером (0-1)
+     */
+    float getResumeRate() const;
+
+    /**
+     * Среднее время рукопожатия, мкс (0 — не было)
+     */
+    uint32_t getAverageHandshakeUs(bool resumed) const;
+
+private:
+    TlsSocket socket;
+    char host[HTTP_HOST_SIZE];
+    uint16_t port;
+    bool secure;
+    bool configured;
+    uint32_t timeoutMs;
+    uint32_t idleTimeoutMs;
+    uint32_t lastUsedMs;
+
+    const char* pinNamespace;
+    const char* pinKey;
+    bool trustFirstKey;
+    bool pinned;
+    uint8_t pin[32];
+
+    // Буфер приёма ответа
+    uint8_t rx[256];
+    size_t rxStart;
+    size_t rxEnd;
+    bool rxClosed;
+
+    char lastBody[HTTP_BODY_SNIPPET_SIZE + 1];
+    char lastError[96];
+    HttpConnectionStats stats;
+
+    /**
+     * Подключиться и сверить ключ
+     * @return 0 или ERROR_CONNECT / ERROR_PIN
+     */
+    int open();
+
+    bool checkPeerKey();
+    bool sendRequest(const char* method, const char* path, const char* headers, const void* body, size_t length);
+
+    /**
+     * Прочитать ответ
+     * @param keepOpen Сервер оставляет соединение открытым
+     * @return Код HTTP, ERROR_IO / ERROR_RESPONSE; 0 — соединение закрыто до первого байта ответа
+     */
+    int readResponse(bool& keepOpen);
+
+    int readByte();
+    int readLine(char* line, size_t size);
+    bool readBody(size_t length);
+};
+
+#endif // HTTP_CONNECTION_H
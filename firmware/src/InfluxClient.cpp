@@ -1,5 +1,9 @@
 #include "InfluxClient.h"
 
+// Отпечаток ключа сервера в NVS
+#define PIN_NAMESPACE "influx"
+#define PIN_KEY "pin"
+
 InfluxClient::InfluxClient() 
     : lastStatus(SendStatus::SUCCESS),
       lastHttpCode(0),
@@ -14,28 +18,70 @@ void InfluxClient::begin(const char* url, const char* org, const char* bucket, c
     authToken = token;
     
     buildWriteUrl();
+    headers = "Content-Type: text/plain\r\nAuthorization: Token ";
+    headers += authToken;
+    headers += "\r\n";
+    
+    if (!connection.begin(url, HTTP_TIMEOUT_MS) || !pingConnection.begin(url, HTTP_TIMEOUT_MS)) {
+        Serial.printf("[InfluxClient] Error: %s\n", connection.getLastError());
+    }
+    connection.usePinStorage(PIN_NAMESPACE, PIN_KEY, INFLUXDB_TLS_TRUST_FIRST_KEY);
+    connection.setIdleTimeout(INFLUXDB_KEEPALIVE_IDLE_MS);
+    // /ping без данных и токена: сверяет ключ, если он уже известен, но не запоминает
+    pingConnection.usePinStorage(PIN_NAMESPACE, PIN_KEY, false);
     
     Serial.println("[InfluxClient] Initialized");
     Serial.print("[InfluxClient] Write URL: ");
     Serial.println(writeUrl);
+    if (connection.isSecure()) {
+        uint8_t pin[32];
+        if (connection.getPin(pin)) {
+            Serial.printf("[InfluxClient] TLS, server key pinned: %02x%02x%02x%02x...\n", pin[0], pin[1], pin[2], pin[3]);
+        } else if (INFLUXDB_TLS_TRUST_FIRST_KEY) {
+            Serial.println("[InfluxClient] TLS, server key will be pinned on first connect");
+        } else {
+            Serial.println("[InfluxClient] Warning: TLS without a pinned server key, server is not verified");
+        }
+    }
 }
 
 void InfluxClient::buildWriteUrl() {
     // InfluxDB 2.x API endpoint для записи:
     // POST /api/v2/write?org=<org>&bucket=<bucket>&precision=ms
     
-    writeUrl = serverUrl;
-    if (!writeUrl.endsWith("/")) {
-        writeUrl += "/";
+    // Путь после host[:port] — префикс (InfluxDB за обратным прокси)
+    int hostStart = serverUrl.indexOf("://");
+    int pathStart = hostStart >= 0 ? serverUrl.indexOf('/', hostStart + 3) : -1;
+    String prefix = pathStart >= 0 ? serverUrl.substring(pathStart) : String("");
+    if (!prefix.endsWith("/")) {
+        prefix += "/";
     }
-    writeUrl += "api/v2/write?org=";
-    writeUrl += organization;
-    writeUrl += "&bucket=";
-    writeUrl += bucketName;
-    writeUrl += "&precision=ms";
+    
+    writePath = prefix;
+    writePath += "api/v2/write?org=";
+    writePath += organization;
+    writePath += "&bucket=";
+    writePath += bucketName;
+    writePath += "&precision=ms";
+    pingPath = prefix + "ping";
+    
+    writeUrl = pathStart >= 0 ? serverUrl.substring(0, pathStart) : serverUrl;
+    writeUrl += writePath;
 }
 
 SendStatus InfluxClient::send(const String& lineProtocol) {
+    return send(lineProtocol.c_str(), lineProtocol.length());
+}
+
+SendStatus InfluxClient::send(const char* payload, size_t length) {
+    // Пустое тело = сериализатор не уместился в буфер
+    if (length == 0) {
+        lastStatus = SendStatus::HTTP_ERROR;
+        failCount++;
+        Serial.println("[InfluxClient] Error: empty payload (line protocol buffer too small?)");
+        return lastStatus;
+    }
+    
     // Проверяем подключение к WiFi
     if (WiFi.status() != WL_CONNECTED) {
         lastStatus = SendStatus::WIFI_DISCONNECTED;
@@ -47,9 +93,7 @@ SendStatus InfluxClient::send(const String& lineProtocol) {
     // Важно: не добавляем timestamp на стороне ESP32.
     // Если device time не синхронизирован (NTP), timestamp будет около 1970 года,
     // и Grafana (Last 5m) ничего не покажет. InfluxDB сам проставит server time.
-    String payload = lineProtocol;
-    
-    int httpCode = httpPost(payload);
+    int httpCode = httpPost(payload, length);
     
     if (httpCode == 204) {
         // 204 No Content - успешная запись
@@ -59,7 +103,7 @@ SendStatus InfluxClient::send(const String& lineProtocol) {
     } else if (httpCode < 0) {
         lastStatus = SendStatus::CONNECTION_FAILED;
         failCount++;
-        Serial.printf("[InfluxClient] Connection failed: %d\n", httpCode);
+        Serial.printf("[InfluxClient] Connection failed: %d (%s)\n", httpCode, connection.getLastError());
         return lastStatus;
     } else {
         lastStatus = SendStatus::HTTP_ERROR;
@@ -86,33 +130,15 @@ SendStatus InfluxClient::sendBatch(const String* lines, size_t count) {
     return send(payload);
 }
 
-int InfluxClient::httpPost(const String& payload) {
-    HTTPClient http;
-    
-    // Настройка таймаутов
-    http.setTimeout(HTTP_TIMEOUT_MS);
-    http.setConnectTimeout(HTTP_TIMEOUT_MS);
-    
-    if (!http.begin(writeUrl)) {
-        Serial.println("[InfluxClient] Failed to begin HTTP");
-        return -1;
-    }
-    
-    // Заголовки
-    http.addHeader("Content-Type", "text/plain");
-    http.addHeader("Authorization", "Token " + authToken);
-    
-    // Отправка
-    lastHttpCode = http.POST(payload);
+int InfluxClient::httpPost(const char* payload, size_t length) {
+    // Соединение остаётся открытым до следующей записи
+    lastHttpCode = connection.request("POST", writePath.c_str(), headers.c_str(), payload, length);
     
     // Если ошибка, выводим тело ответа для отладки
     if (lastHttpCode != 204 && lastHttpCode > 0) {
-        String response = http.getString();
-        Serial.printf("[InfluxClient] Response (%d): %s\n", lastHttpCode, response.c_str());
+        Serial.printf("[InfluxClient] Response (%d): %s\n", lastHttpCode, connection.getLastBody());
     }
     
-    http.end();
-    
     return lastHttpCode;
 }
 
@@ -128,6 +154,8 @@ String InfluxClient::getLastStatusString() const {
             return "HTTP_ERROR";
         case SendStatus::TIMEOUT:
             return "TIMEOUT";
+        case SendStatus::QUEUE_FULL:
+            return "QUEUE_FULL";
         default:
             return "UNKNOWN";
     }
@@ -155,22 +183,27 @@ bool InfluxClient::ping() {
         return false;
     }
     
-    HTTPClient http;
-    http.setTimeout(5000);
-    
-    String pingUrl = serverUrl;
-    if (!pingUrl.endsWith("/")) {
-        pingUrl += "/";
-    }
-    pingUrl += "ping";
-    
-    if (!http.begin(pingUrl)) {
-        return false;
-    }
-    
-    int httpCode = http.GET();
-    http.end();
+    int httpCode = pingConnection.request("GET", pingPath.c_str(), nullptr, nullptr, 0);
+    // Проверка разовая: буферы TLS не держим
+    pingConnection.close();
     
     // InfluxDB возвращает 204 на /ping
     return (httpCode == 204);
 }
+
+void InfluxClient::disconnect() {
+    connection.close();
+}
+
+void InfluxClient::setPin(const uint8_t* sha256) {
+    connection.setPin(sha256);
+    pingConnection.usePinStorage(PIN_NAMESPACE, PIN_KEY, false);
+}
+
+bool InfluxClient::getPin(uint8_t sha256[32]) const {
+    return connection.getPin(sha256);
+}
+
+const HttpConnection& InfluxClient::getConnection() const {
+    return connection;
+}
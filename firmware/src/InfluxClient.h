@@ -3,8 +3,8 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <HTTPClient.h>
 #include "config.h"
+#include "HttpConnection.h"
 
 /**
  * Статус последней отправки
@@ -14,11 +14,16 @@ enum class SendStatus {
     WIFI_DISCONNECTED,
     CONNECTION_FAILED,
     HTTP_ERROR,
-    TIMEOUT
+    TIMEOUT,
+    QUEUE_FULL
 };
 
 /**
  * Класс для отправки данных в InfluxDB 2.x через HTTP API
+ *
+ * Запись идёт по постоянному соединению (HttpConnection): http:// или
+ * https:// с возобновлением сессий TLS и отпечатком ключа сервера в NVS.
+ * ping() вызывается из фоновой задачи и ходит через своё соединение.
  */
 class InfluxClient {
 public:
@@ -26,7 +31,7 @@ public:
     
     /**
      * Инициализация клиента с параметрами подключения
-     * @param url URL сервера InfluxDB (например, "http://192.168.1.100:8086")
+     * @param url URL сервера InfluxDB (например, "http://192.168.1.100:8086" или "https://influx.example:8086")
      * @param org Организация в InfluxDB
      * @param bucket Bucket для записи данных
      * @param token Токен авторизации
@@ -40,6 +45,14 @@ public:
      */
     SendStatus send(const String& lineProtocol);
     
+    /**
+     * Отправить данные из готового буфера (без копирования в String)
+     * @param payload Line Protocol
+     * @param length Длина в байтах
+     * @return Статус отправки
+     */
+    SendStatus send(const char* payload, size_t length);
+    
     /**
      * Отправить несколько строк данных (batch)
      * @param lines Массив строк Line Protocol
@@ -78,13 +91,36 @@ public:
      * @return true если сервер отвечает
      */
     bool ping();
+    
+    /**
+     * Закрыть соединение записи (после потери WiFi); сессия TLS сохраняется
+     */
+    void disconnect();
+    
+    /**
+     * Задать отпечаток ключа сервера (SHA-256 SPKI) и сохранить в NVS
+     * @param sha256 nullptr — снять отпечаток
+     */
+    void setPin(const uint8_t* sha256);
+    bool getPin(uint8_t sha256[32]) const;
+    
+    /**
+     * Соединение записи: счётчики переиспользования и рукопожатий
+     */
+    const HttpConnection& getConnection() const;
 
 private:
     String serverUrl;
     String organization;
     String bucketName;
     String authToken;
-    String writeUrl;  // Полный URL для записи
+    String writeUrl;  // Полный URL для записи (для журнала)
+    String writePath; // Путь с параметрами запроса
+    String pingPath;
+    String headers;   // Content-Type и Authorization
+    
+    HttpConnection connection;
+    HttpConnection pingConnection;
     
     SendStatus lastStatus;
     int lastHttpCode;
@@ -92,16 +128,17 @@ private:
     unsigned long failCount;
     
     /**
-     * Построить URL для API записи
+     * Построить URL и пути для API записи и /ping
      */
     void buildWriteUrl();
     
     /**
      * Выполнить HTTP POST запрос
      * @param payload Тело запроса
+     * @param length Длина тела
      * @return HTTP код ответа или отрицательное значение при ошибке
      */
-    int httpPost(const String& payload);
+    int httpPost(const char* payload, size_t length);
 };
 
 #endif // INFLUX_CLIENT_H
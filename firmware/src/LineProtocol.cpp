@@ -0,0 +1,174 @@
+#include "LineProtocol.h"
+#include <math.h>
+
+LineWriter::LineWriter(char* buffer, size_t capacity)
+    : buffer(buffer),
+      capacity(capacity),
+      pos(0),
+      lineStart(0),
+      firstField(true),
+      lineFailed(false),
+      overflow(false) {
+    if (capacity > 0) {
+        buffer[0] = '\0';
+    }
+}
+
+void LineWriter::append(char c) {
+    // Последний байт буфера всегда под завершающий ноль
+    if (lineFailed || pos + 1 >= capacity) {
+        lineFailed = true;
+        return;
+    }
+    buffer[pos++] = c;
+}
+
+void LineWriter::append(const char* text) {
+    while (*text) {
+        append(*text++);
+    }
+}
+
+void LineWriter::appendInt(uint32_t value) {
+    char digits[10];
+    int count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    while (count > 0) {
+        append(digits[--count]);
+    }
+}
+
+void LineWriter::begin(const char* measurement) {
+    lineStart = pos;
+    firstField = true;
+    lineFailed = false;
+    append(measurement);
+}
+
+void LineWriter::tag(const char* key, const char* value) {
+    append(',');
+    append(key);
+    append('=');
+    append(value);
+}
+
+void LineWriter::tag(const char* key, int value) {
+    append(',');
+    append(key);
+    append('=');
+    if (value < 0) {
+        append('-');
+        value = -value;
+    }
+    appendInt((uint32_t)value);
+}
+
+void LineWriter::field(const char* key, float value, int decimals) {
+    static const uint32_t scales[] = {1, 10, 100, 1000};
+    if (decimals < 0) {
+        decimals = 0;
+    } else if (decimals > 3) {
+        decimals = 3;
+    }
+
+    append(firstField ? ' ' : ',');
+    firstField = false;
+    append(key);
+    append('=');
+
+    // NaN/inf Line Protocol не принимает — вся пачка была бы отклонена
+    if (!isfinite(value)) {
+        value = 0.0f;
+    }
+    bool negative = value < 0.0f;
+    if (negative) {
+        value = -value;
+    }
+
+    // Округление до нужного знака в целых: 221.534 -> 22153 -> "221.53"
+    uint32_t scale = scales[decimals];
+    float scaled = value * scale + 0.5f;
+    uint32_t fixed = scaled < 4294967040.0f ? (uint32_t)scaled : 4294967040u;
+
+    // -0.004 с двумя знаками — это "0.00", а не "-0.00"
+    if (negative && fixed > 0) {
+        append('-');
+    }
+
+    appendInt(fixed / scale);
+    if (decimals > 0) {
+        append('.');
+        uint32_t fraction = fixed % scale;
+        for (uint32_t digit = scale / 10; digit > 0; digit /= 10) {
+            append('0' + (fraction / digit) % 10);
+        }
+    }
+}
+
+void LineWriter::field(const char* key, uint32_t value) {
+    append(firstField ? ' ' : ',');
+    firstField = false;
+    append(key);
+    append('=');
+    appendInt(value);
+    append('i');
+}
+
+void LineWriter::field(const char* key, const char* value) {
+    append(firstField ? ' ' : ',');
+    firstField = false;
+    append(key);
+    append('=');
+    append('"');
+    while (*value) {
+        if (*value == '"' || *value == '\\') {
+            append('\\');
+        }
+        append(*value++);
+    }
+    append('"');
+}
+
+void LineWriter::end(uint64_t timestamp) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = '0' + timestamp % 10;
+        timestamp /= 10;
+    } while (timestamp > 0);
+
+    append(' ');
+    while (count > 0) {
+        append(digits[--count]);
+    }
+    end();
+}
+
+void LineWriter::end() {
+    append('\n');
+
+    if (lineFailed) {
+        // Обрезаем незаконченную точку, чтобы сервер не получил полстроки
+        pos = lineStart;
+        overflow = true;
+    }
+    if (capacity > 0) {
+        buffer[pos] = '\0';
+    }
+}
+
+size_t LineWriter::length() const {
+    return pos;
+}
+
+const char* LineWriter::c_str() const {
+    return buffer;
+}
+
+bool LineWriter::overflowed() const {
+    return overflow;
+}
@@ -0,0 +1,81 @@
+#ifndef LINE_PROTOCOL_H
+#define LINE_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Запись InfluxDB Line Protocol в заранее выделенный буфер
+ *
+ * Без кучи и без snprintf на каждое число: сериализация одинаково работает
+ * на ESP32 и на хосте и не фрагментирует память. При нехватке места
+ * запись обрезается по последней целой строке, overflowed() == true.
+ *
+ *   LineWriter out(buffer, sizeof(buffer));
+ *   out.begin("voltage"); out.tag("device", id); out.tag("phase", "A");
+ *   out.field("value", 221.53f, 2); out.end();
+ */
+class LineWriter {
+public:
+    LineWriter(char* buffer, size_t capacity);
+
+    /**
+     * Начать точку с имени измерения
+     */
+    void begin(const char* measurement);
+
+    void tag(const char* key, const char* value);
+    void tag(const char* key, int value);
+
+    /**
+     * Поле с фиксированным числом знаков после запятой (0..3)
+     */
+    void field(const char* key, float value, int decimals);
+
+    /**
+     * Целочисленное поле (суффикс i): счётчики, байты
+     */
+    void field(const char* key, uint32_t value);
+
+    /**
+     * Строковое поле в кавычках (кавычки и обратная косая черта экранируются)
+     */
+    void field(const char* key, const char* value);
+
+    /**
+     * Завершить точку переводом строки
+     */
+    void end();
+
+    /**
+     * Завершить точку меткой времени (в единицах precision запроса) и переводом строки
+     */
+    void end(uint64_t timestamp);
+
+    /**
+     * Длина без завершающего нуля
+     */
+    size_t length() const;
+
+    const char* c_str() const;
+
+    /**
+     * Не поместилась хотя бы одна точка
+     */
+    bool overflowed() const;
+
+private:
+    char* buffer;
+    size_t capacity;
+    size_t pos;
+    size_t lineStart;   // Начало текущей точки (для отката при переполнении)
+    bool firstField;
+    bool lineFailed;
+    bool overflow;
+
+    void append(const char* text);
+    void append(char c);
+    void appendInt(uint32_t value);
+};
+
+#endif // LINE_PROTOCOL_H
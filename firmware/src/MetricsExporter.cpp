@@ -0,0 +1,218 @@
+#include "MetricsExporter.h"
+
+MetricsExporter::MetricsExporter(const PowerAnalyzerBase& analyzer, const InfluxClient& influx,
+                                 const DeadbandFilter& deadband, const AlertEngine& alerts,
+                                 const AlertNotifier& notifier)
+    : analyzer(analyzer),
+      influx(influx),
+      deadband(deadband),
+      alerts(alerts),
+      notifier(notifier),
+      scrapeCount(0) {
+}
+
+void MetricsExporter::begin(AsyncWebServer& server) {
+    server.on(METRICS_PATH, HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleRequest(request);
+    });
+
+    Serial.printf("[MetricsExporter] Prometheus endpoint at %s\n", METRICS_PATH);
+}
+
+void MetricsExporter::publish() {
+    MetricsStats next;
+    memset(&next, 0, sizeof(next));
+    for (int r = 0; r < alerts.getRuleCount(); r++) {
+        for (int p = 0; p < PowerAnalyzer::PHASES; p++) {
+            next.alertActive[r] |= alerts.isActive(r, p) ? 1 << p : 0;
+        }
+    }
+    next.alertTransitions = alerts.getTransitionCount();
+
+    // Уведомления отправляет своя задача: поля по отдельности 32-битные, читаются атомарно
+    next.webhookEnabled = notifier.isEnabled();
+    if (next.webhookEnabled) {
+        next.webhook = notifier.getStats();
+        next.webhookPending = notifier.pending();
+    }
+
+    next.influxSuccess = influx.getSuccessCount();
+    next.influxFail = influx.getFailCount();
+    const HttpConnection& connection = influx.getConnection();
+    next.influxSecure = connection.isSecure();
+    next.http = connection.getStats();
+    next.fullHandshakeUs = connection.getAverageHandshakeUs(false);
+    next.resumedHandshakeUs = connection.getAverageHandshakeUs(true);
+    next.resumeRate = connection.getResumeRate();
+
+    next.deadband = deadband.getStats();
+    next.suppressionRatio = deadband.getSuppressionRatio();
+    stats.write(next);
+}
+
+void MetricsExporter::handleRequest(AsyncWebServerRequest* request) {
+    PowerSnapshot snapshot;
+    MetricsStats current;
+    if (!analyzer.readSnapshot(snapshot) || !stats.read(current)) {
+        // Писатели публикуют раз в цикл, сюда попадаем только при сбое
+        request->send(503, "text/plain", "snapshot busy");
+        return;
+    }
+
+    scrapeCount++;
+
+    AsyncResponseStream* response = request->beginResponseStream("text/plain; version=0.0.4");
+    render(*response, snapshot, current, DEVICE_ID);
+    request->send(response);
+}
+
+void MetricsExporter::writeHeader(Print& out, const char* name, const char* type, const char* help) {
+    out.printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void MetricsExporter::render(Print& out, const PowerSnapshot& snapshot, const MetricsStats& stats,
+                             const char* deviceId) const {
+    const PowerData& d = snapshot.data;
+    // Фазы схемы (TopologyTraits::PHASES): остальные в PowerData — нули
+    const float voltages[3] = {d.voltageA, d.voltageB, d.voltageC};
+    const float frequencies[3] = {d.frequencyA, d.frequencyB, d.frequencyC};
+    const uint16_t fields = PowerAnalyzer::Traits::FIELDS;
+
+    writeHeader(out, "power_voltage_volts", "gauge", "Phase RMS voltage");
+    for (int p = 0; p < PowerAnalyzer::PHASES; p++) {
+        out.printf("power_voltage_volts{device=\"%s\",phase=\"%s\"} %.2f\n", deviceId, AlertEngine::phaseName(p),
+                   voltages[p]);
+    }
+
+    if (fields & (DEADBAND_FIELD_LINE_AB | DEADBAND_FIELD_LINE_BC | DEADBAND_FIELD_LINE_CA)) {
+        writeHeader(out, "power_line_voltage_volts", "gauge", "Line-to-line voltage");
+    }
+    if (fields & DEADBAND_FIELD_LINE_AB) {
+        out.printf("power_line_voltage_volts{device=\"%s\",phases=\"AB\"} %.2f\n", deviceId, d.voltageAB);
+    }
+    if (fields & DEADBAND_FIELD_LINE_BC) {
+        out.printf("power_line_voltage_volts{device=\"%s\",phases=\"BC\"} %.2f\n", deviceId, d.voltageBC);
+    }
+    if (fields & DEADBAND_FIELD_LINE_CA) {
+        out.printf("power_line_voltage_volts{device=\"%s\",phases=\"CA\"} %.2f\n", deviceId, d.voltageCA);
+    }
+
+    writeHeader(out, "power_frequency_hertz", "gauge", "Grid frequency per phase");
+    for (int p = 0; p < PowerAnalyzer::PHASES; p++) {
+        out.printf("power_frequency_hertz{device=\"%s\",phase=\"%s\"} %.3f\n", deviceId, AlertEngine::phaseName(p),
+                   frequencies[p]);
+    }
+    out.printf("power_frequency_hertz{device=\"%s\",phase=\"avg\"} %.3f\n", deviceId, d.frequencyAvg);
+
+    if (fields & DEADBAND_FIELD_UNBALANCE) {
+        writeHeader(out, "power_unbalance_percent", "gauge", "Voltage unbalance");
+        out.printf("power_unbalance_percent{device=\"%s\"} %.2f\n", deviceId, d.unbalance);
+    }
+
+    writeHeader(out, "power_problem", "gauge", "Active problem flags (1 = active)");
+    out.printf("power_problem{device=\"%s\",type=\"low_voltage\"} %d\n", deviceId, d.lowVoltage ? 1 : 0);
+    out.printf("power_problem{device=\"%s\",type=\"high_voltage\"} %d\n", deviceId, d.highVoltage ? 1 : 0);
+    out.printf("power_problem{device=\"%s\",type=\"unbalance\"} %d\n", deviceId, d.highUnbalance ? 1 : 0);
+    out.printf("power_problem{device=\"%s\",type=\"frequency_deviation\"} %d\n", deviceId, d.frequencyDeviation ? 1 : 0);
+
+    writeHeader(out, "power_events_total", "counter", "Problem events, kept across restarts in NVS");
+    out.printf("power_events_total{device=\"%s\",type=\"low_voltage\"} %lu\n", deviceId, (unsigned long)snapshot.events.lowVoltage);
+    out.printf("power_events_total{device=\"%s\",type=\"high_voltage\"} %lu\n", deviceId, (unsigned long)snapshot.events.highVoltage);
+    out.printf("power_events_total{device=\"%s\",type=\"unbalance\"} %lu\n", deviceId, (unsigned long)snapshot.events.highUnbalance);
+    out.printf("power_events_total{device=\"%s\",type=\"frequency_deviation\"} %lu\n", deviceId, (unsigned long)snapshot.events.frequencyDeviation);
+
+    // Тревоги с гистерезисом (AlertEngine), в отличие от мгновенных power_problem.
+    // Таблица правил не меняется после запуска, состояния — из снимка
+    writeHeader(out, "power_alert_active", "gauge", "Alerts after hysteresis and minimum duration (1 = raised)");
+    for (int r = 0; r < alerts.getRuleCount(); r++) {
+        const AlertRule& rule = alerts.getRule(r);
+        if (AlertEngine::isPerPhase(rule)) {
+            for (int p = 0; p < PowerAnalyzer::PHASES; p++) {
+                out.printf("power_alert_active{device=\"%s\",rule=\"%s\",severity=\"%s\",phase=\"%s\"} %d\n", deviceId,
+                           rule.name, AlertEngine::severityName(rule.severity), AlertEngine::phaseName(p),
+                           (stats.alertActive[r] >> p) & 1);
+            }
+        } else {
+            out.printf("power_alert_active{device=\"%s\",rule=\"%s\",severity=\"%s\"} %d\n", deviceId,
+                       rule.name, AlertEngine::severityName(rule.severity), stats.alertActive[r] & 1);
+        }
+    }
+    writeHeader(out, "power_alert_transitions_total", "counter", "Alerts raised and cleared since boot");
+    out.printf("power_alert_transitions_total{device=\"%s\"} %lu\n", deviceId,
+               (unsigned long)stats.alertTransitions);
+    if (stats.webhookEnabled) {
+        const AlertNotifierStats& webhook = stats.webhook;
+        writeHeader(out, "alert_webhook_notifications_total", "counter", "Webhook notifications by outcome");
+        out.printf("alert_webhook_notifications_total{device=\"%s\",result=\"delivered\"} %lu\n", deviceId,
+                   (unsigned long)webhook.delivered);
+        out.printf("alert_webhook_notifications_total{device=\"%s\",result=\"queue_full\"} %lu\n", deviceId,
+                   (unsigned long)webhook.dropped);
+        out.printf("alert_webhook_notifications_total{device=\"%s\",result=\"rejected\"} %lu\n", deviceId,
+                   (unsigned long)webhook.rejected);
+        out.printf("alert_webhook_notifications_total{device=\"%s\",result=\"expired\"} %lu\n", deviceId,
+                   (unsigned long)webhook.expired);
+        writeHeader(out, "alert_webhook_retries_total", "counter", "Webhook attempts repeated after a failure");
+        out.printf("alert_webhook_retries_total{device=\"%s\"} %lu\n", deviceId, (unsigned long)webhook.retries);
+        writeHeader(out, "alert_webhook_pending", "gauge", "Notifications waiting in the queue");
+        out.printf("alert_webhook_pending{device=\"%s\"} %lu\n", deviceId, (unsigned long)stats.webhookPending);
+        writeHeader(out, "alert_webhook_latency_seconds", "gauge", "Time from queueing to a 2xx answer");
+        out.printf("alert_webhook_latency_seconds{device=\"%s\",stat=\"last\"} %.6f\n", deviceId,
+                   webhook.lastLatencyUs / 1e6f);
+        out.printf("alert_webhook_latency_seconds{device=\"%s\",stat=\"max\"} %.6f\n", deviceId,
+                   webhook.maxLatencyUs / 1e6f);
+    }
+
+    writeHeader(out, "power_measurements_total", "counter", "Completed measurement windows");
+    out.printf("power_measurements_total{device=\"%s\"} %lu\n", deviceId, (unsigned long)snapshot.measurementCount);
+
+    writeHeader(out, "power_measurement_age_seconds", "gauge", "Time since the last measurement");
+    out.printf("power_measurement_age_seconds{device=\"%s\"} %.3f\n", deviceId,
+               (millis() - d.timestamp) / 1000.0f);
+
+    writeHeader(out, "influx_writes_total", "counter", "InfluxDB write attempts by result");
+    out.printf("influx_writes_total{device=\"%s\",result=\"success\"} %lu\n", deviceId,
+               (unsigned long)stats.influxSuccess);
+    out.printf("influx_writes_total{device=\"%s\",result=\"fail\"} %lu\n", deviceId, (unsigned long)stats.influxFail);
+    
+    // Соединение записи: переиспользование и рукопожатия TLS
+    const HttpConnectionStats& http = stats.http;
+    writeHeader(out, "influx_connections_total", "counter", "Connections opened to InfluxDB");
+    out.printf("influx_connections_total{device=\"%s\"} %lu\n", deviceId, (unsigned long)http.connects);
+    writeHeader(out, "influx_requests_reused_total", "counter", "Writes sent over an already open connection");
+    out.printf("influx_requests_reused_total{device=\"%s\"} %lu\n", deviceId, (unsigned long)http.reusedRequests);
+    if (stats.influxSecure) {
+        writeHeader(out, "influx_tls_handshakes_total", "counter", "TLS handshakes by kind");
+        out.printf("influx_tls_handshakes_total{device=\"%s\",kind=\"full\"} %lu\n", deviceId,
+                   (unsigned long)http.fullHandshakes);
+        out.printf("influx_tls_handshakes_total{device=\"%s\",kind=\"resumed\"} %lu\n", deviceId,
+                   (unsigned long)http.resumedHandshakes);
+        writeHeader(out, "influx_tls_handshake_seconds", "gauge", "Average TLS handshake time by kind");
+        out.printf("influx_tls_handshake_seconds{device=\"%s\",kind=\"full\"} %.6f\n", deviceId,
+                   stats.fullHandshakeUs / 1e6f);
+        out.printf("influx_tls_handshake_seconds{device=\"%s\",kind=\"resumed\"} %.6f\n", deviceId,
+                   stats.resumedHandshakeUs / 1e6f);
+        writeHeader(out, "influx_tls_resume_ratio", "gauge", "Share of offered TLS sessions the server resumed");
+        out.printf("influx_tls_resume_ratio{device=\"%s\"} %.4f\n", deviceId, stats.resumeRate);
+        writeHeader(out, "influx_tls_pin_failures_total", "counter", "Connections refused: server key did not match the pin");
+        out.printf("influx_tls_pin_failures_total{device=\"%s\"} %lu\n", deviceId, (unsigned long)http.pinFailures);
+    }
+
+    const DeadbandStats& db = stats.deadband;
+    writeHeader(out, "power_deadband_points_total", "counter", "Scalar points by deadband decision");
+    out.printf("power_deadband_points_total{device=\"%s\",result=\"sent\"} %lu\n", deviceId, (unsigned long)db.sent);
+    out.printf("power_deadband_points_total{device=\"%s\",result=\"suppressed\"} %lu\n", deviceId,
+               (unsigned long)(db.evaluated - db.sent));
+
+    writeHeader(out, "power_deadband_heartbeats_total", "counter", "Unchanged points resent by heartbeat");
+    out.printf("power_deadband_heartbeats_total{device=\"%s\"} %lu\n", deviceId, (unsigned long)db.heartbeats);
+
+    writeHeader(out, "power_deadband_suppression_ratio", "gauge", "Share of scalar points not sent since boot");
+    out.printf("power_deadband_suppression_ratio{device=\"%s\"} %.4f\n", deviceId, stats.suppressionRatio);
+
+    writeHeader(out, "device_uptime_seconds", "gauge", "Time since boot");
+    out.printf("device_uptime_seconds{device=\"%s\"} %lu\n", deviceId, millis() / 1000);
+}
+
+unsigned long MetricsExporter::getScrapeCount() const {
+    return scrapeCount;
+}
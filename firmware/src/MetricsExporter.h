@@ -0,0 +1,91 @@
+#ifndef METRICS_EXPORTER_H
+#define METRICS_EXPORTER_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "PowerAnalyzer.h"
+#include "InfluxClient.h"
+#include "DeadbandFilter.h"
+#include "AlertEngine.h"
+#include "AlertNotifier.h"
+#include "SeqLock.h"
+
+/**
+ * Счётчики отправки, deadband и тревог на момент publish()
+ */
+struct MetricsStats {
+    uint8_t alertActive[ALERT_MAX_RULES];   // Бит p — тревога поднята по фазе p
+    uint32_t alertTransitions;
+    bool webhookEnabled;
+    AlertNotifierStats webhook;
+    uint32_t webhookPending;
+    uint32_t influxSuccess;
+    uint32_t influxFail;
+    bool influxSecure;
+    HttpConnectionStats http;
+    uint32_t fullHandshakeUs;               // Среднее рукопожатие
+    uint32_t resumedHandshakeUs;
+    float resumeRate;
+    DeadbandStats deadband;
+    float suppressionRatio;
+};
+
+/**
+ * Pull-эндпоинт /metrics в текстовом формате Prometheus
+ *
+ * Данные берутся из lock-free снимков: измерения — PowerAnalyzer, счётчики
+ * отправки, deadband и тревог — свой снимок, который цикл измерений
+ * обновляет через publish(). Обработчик в задаче async_tcp не читает
+ * объекты, которые в это время меняет loop(). Печатается прямо в буфер
+ * HTTP-ответа (AsyncResponseStream), без промежуточных String.
+ * Опрос Prometheus не задерживает цикл измерений.
+ */
+class MetricsExporter {
+public:
+    MetricsExporter(const PowerAnalyzerBase& analyzer, const InfluxClient& influx, const DeadbandFilter& deadband,
+                    const AlertEngine& alerts, const AlertNotifier& notifier);
+
+    /**
+     * Зарегистрировать обработчик METRICS_PATH на веб-сервере
+     */
+    void begin(AsyncWebServer& server);
+
+    /**
+     * Скопировать счётчики в снимок для обработчика (только из loop())
+     */
+    void publish();
+
+    /**
+     * Сформировать тело ответа. Фазные серии — только по PowerAnalyzer::PHASES
+     * фазам, линейные напряжения и несимметрия — если они есть в схеме
+     * @param out Поток вывода (буфер ответа)
+     * @param snapshot Снимок данных анализатора
+     * @param stats Снимок счётчиков (publish())
+     * @param deviceId Идентификатор устройства (метка device)
+     */
+    void render(Print& out, const PowerSnapshot& snapshot, const MetricsStats& stats, const char* deviceId) const;
+
+    /**
+     * Количество обработанных запросов
+     */
+    unsigned long getScrapeCount() const;
+
+private:
+    const PowerAnalyzerBase& analyzer;
+    const InfluxClient& influx;
+    const DeadbandFilter& deadband;
+    const AlertEngine& alerts;
+    const AlertNotifier& notifier;
+    SeqLock<MetricsStats> stats;
+    unsigned long scrapeCount;
+
+    void handleRequest(AsyncWebServerRequest* request);
+
+    /**
+     * Заголовки # HELP / # TYPE для метрики
+     */
+    static void writeHeader(Print& out, const char* name, const char* type, const char* help);
+};
+
+#endif // METRICS_EXPORTER_H
@@ -0,0 +1,242 @@
+#include "MqttUplink.h"
+#include <time.h>
+
+MqttUplink::MqttUplink()
+    : enabled(false),
+      configured(false),
+      lastConnectAttempt(0),
+      mux(portMUX_INITIALIZER_UNLOCKED),
+      recordSeq(0),
+      windowStart(0),
+      windowAcked(0),
+      windowBytes(0),
+      windowLatencySumMs(0),
+      windowLatencyMaxMs(0) {
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        inflight[i].state = SlotState::FREE;
+        inflight[i].packetId = 0;
+    }
+    memset(&stats, 0, sizeof(stats));
+}
+
+void MqttUplink::begin(const char* host, uint16_t port, const char* deviceId,
+                       const char* user, const char* password) {
+    snprintf(clientId, sizeof(clientId), "oscillator-%s", deviceId);
+    snprintf(topicData, sizeof(topicData), "%s/%s/data", MQTT_TOPIC_PREFIX, deviceId);
+    snprintf(topicEvent, sizeof(topicEvent), "%s/%s/event", MQTT_TOPIC_PREFIX, deviceId);
+    snprintf(topicWaveform, sizeof(topicWaveform), "%s/%s/waveform", MQTT_TOPIC_PREFIX, deviceId);
+    snprintf(topicStatus, sizeof(topicStatus), "%s/%s/status", MQTT_TOPIC_PREFIX, deviceId);
+
+    client.setServer(host, port);
+    client.setClientId(clientId);
+    client.setKeepAlive(MQTT_KEEPALIVE_SEC);
+    client.setWill(topicStatus, 1, true, "offline");
+    if (user != nullptr && user[0] != '\0') {
+        client.setCredentials(user, password);
+    }
+
+    client.onConnect([this](bool sessionPresent) {
+        Serial.println("[MqttUplink] Connected");
+        client.publish(topicStatus, 1, true, "online");
+    });
+
+    client.onDisconnect([this](AsyncMqttClientDisconnectReason reason) {
+        Serial.printf("[MqttUplink] Disconnected (reason %d)\n", (int)reason);
+        dropInflight();
+    });
+
+    client.onPublish([this](uint16_t packetId) {
+        onAck(packetId);
+    });
+
+    configured = true;
+    windowStart = millis();
+
+    Serial.printf("[MqttUplink] Broker %s:%u, topics %s/%s/*\n",
+                  host, port, MQTT_TOPIC_PREFIX, deviceId);
+}
+
+void MqttUplink::setEnabled(bool value) {
+    if (enabled == value) {
+        return;
+    }
+    enabled = value;
+
+    if (!enabled && client.connected()) {
+        client.publish(topicStatus, 1, true, "offline");
+        client.disconnect();
+    }
+    lastConnectAttempt = millis() - MQTT_RECONNECT_INTERVAL_MS;
+}
+
+bool MqttUplink::isConnected() const {
+    return client.connected();
+}
+
+void MqttUplink::loop() {
+    if (!configured || !enabled) {
+        return;
+    }
+
+    unsigned long now = millis();
+
+    // Переподключение без блокировки цикла измерений
+    if (!client.connected() && WiFi.status() == WL_CONNECTED &&
+        now - lastConnectAttempt >= MQTT_RECONNECT_INTERVAL_MS) {
+        lastConnectAttempt = now;
+        portENTER_CRITICAL(&mux);
+        stats.reconnects++;
+        portEXIT_CRITICAL(&mux);
+        client.connect();
+    }
+
+    expireInflight(now);
+
+    // Пересчёт пропускной способности и задержки раз в 10 секунд
+    unsigned long elapsed = now - windowStart;
+    if (elapsed >= 10000) {
+        portENTER_CRITICAL(&mux);
+        float seconds = elapsed / 1000.0f;
+        stats.messagesPerSecond = windowAcked / seconds;
+        stats.bytesPerSecond = windowBytes / seconds;
+        stats.avgLatencyMs = windowAcked > 0 ? windowLatencySumMs / windowAcked : 0.0f;
+        stats.maxLatencyMs = windowLatencyMaxMs;
+        windowAcked = 0;
+        windowBytes = 0;
+        windowLatencySumMs = 0;
+        windowLatencyMaxMs = 0;
+        windowStart = now;
+        portEXIT_CRITICAL(&mux);
+    }
+}
+
+uint32_t MqttUplink::unixTime() const {
+    time_t now = time(nullptr);
+    return now > 1700000000 ? (uint32_t)now : 0;  // До синхронизации NTP — 0
+}
+
+SendStatus MqttUplink::publishPower(const PowerData& data) {
+    size_t length = TelemetryCodec::encodePower(data, recordSeq++, unixTime(), buffer, sizeof(buffer));
+    return publishReliable(topicData, length);
+}
+
+SendStatus MqttUplink::publishEvent(const PowerData& data, uint8_t previousFlags) {
+    size_t length = TelemetryCodec::encodeEvent(data, previousFlags, recordSeq++, unixTime(),
+                                                buffer, sizeof(buffer));
+    return publishReliable(topicEvent, length);
+}
+
+SendStatus MqttUplink::publishWaveform(const WaveformData& waveform,
+                                       float offsetA, float offsetB, float offsetC) {
+    if (!client.connected()) {
+        return SendStatus::CONNECTION_FAILED;
+    }
+
+    size_t length = TelemetryCodec::encodeWaveform(waveform, offsetA, offsetB, offsetC,
+                                                   recordSeq++, unixTime(), buffer, sizeof(buffer));
+    client.publish(topicWaveform, 0, false, (const char*)buffer, length);
+    return SendStatus::SUCCESS;
+}
+
+SendStatus MqttUplink::publishReliable(const char* topic, size_t length) {
+    if (!client.connected()) {
+        portENTER_CRITICAL(&mux);
+        stats.dropped++;
+        portEXIT_CRITICAL(&mux);
+        return WiFi.status() == WL_CONNECTED ? SendStatus::CONNECTION_FAILED
+                                             : SendStatus::WIFI_DISCONNECTED;
+    }
+
+    // Ищем свободный слот окна до отправки
+    int slot = -1;
+    portENTER_CRITICAL(&mux);
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        if (inflight[i].state == SlotState::FREE) {
+            inflight[i].state = SlotState::RESERVED;
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        stats.dropped++;
+    }
+    portEXIT_CRITICAL(&mux);
+
+    if (slot < 0) {
+        // Брокер не успевает подтверждать — теряем запись, а не блокируем измерения
+        return SendStatus::QUEUE_FULL;
+    }
+
+    unsigned long sentUs = micros();
+    uint16_t packetId = client.publish(topic, 1, false, (const char*)buffer, length);
+
+    portENTER_CRITICAL(&mux);
+    if (packetId == 0) {
+        inflight[slot].state = SlotState::FREE;
+        stats.dropped++;
+    } else {
+        // PUBACK требует круга по сети, поэтому приходит заведомо позже этой записи
+        inflight[slot].state = SlotState::PENDING;
+        inflight[slot].packetId = packetId;
+        inflight[slot].length = (uint16_t)length;
+        inflight[slot].sentUs = sentUs;
+        inflight[slot].sentMs = millis();
+        stats.published++;
+    }
+    portEXIT_CRITICAL(&mux);
+
+    return packetId == 0 ? SendStatus::CONNECTION_FAILED : SendStatus::SUCCESS;
+}
+
+void MqttUplink::onAck(uint16_t packetId) {
+    unsigned long nowUs = micros();
+
+    portENTER_CRITICAL(&mux);
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        if (inflight[i].state == SlotState::PENDING && inflight[i].packetId == packetId) {
+            float latencyMs = (nowUs - inflight[i].sentUs) / 1000.0f;
+            stats.acked++;
+            windowAcked++;
+            windowBytes += inflight[i].length;
+            windowLatencySumMs += latencyMs;
+            if (latencyMs > windowLatencyMaxMs) {
+                windowLatencyMaxMs = latencyMs;
+            }
+            inflight[i].state = SlotState::FREE;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void MqttUplink::expireInflight(unsigned long nowMs) {
+    portENTER_CRITICAL(&mux);
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        if (inflight[i].state == SlotState::PENDING &&
+            nowMs - inflight[i].sentMs >= MQTT_ACK_TIMEOUT_MS) {
+            inflight[i].state = SlotState::FREE;
+            stats.lost++;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+void MqttUplink::dropInflight() {
+    // AsyncMqttClient не переотправляет QoS 1 после разрыва — считаем потерянными
+    portENTER_CRITICAL(&mux);
+    for (int i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+        if (inflight[i].state == SlotState::PENDING) {
+            inflight[i].state = SlotState::FREE;
+            stats.lost++;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+MqttStats MqttUplink::getStats() const {
+    MqttStats copy;
+    portENTER_CRITICAL(&mux);
+    copy = stats;
+    portEXIT_CRITICAL(&mux);
+    return copy;
+}
@@ -0,0 +1,129 @@
+#ifndef MQTT_UPLINK_H
+#define MQTT_UPLINK_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <AsyncMqttClient.h>
+#include "config.h"
+#include "PowerData.h"
+#include "WaveformData.h"
+#include "TelemetryCodec.h"
+#include "InfluxClient.h"  // SendStatus
+
+/**
+ * Статистика MQTT-аплинка
+ */
+struct MqttStats {
+    unsigned long published;     // Отправлено QoS 1 сообщений
+    unsigned long acked;         // Получено PUBACK
+    unsigned long dropped;       // Не отправлено: окно заполнено или нет связи
+    unsigned long lost;          // Отправлено, но PUBACK не пришёл (таймаут/разрыв)
+    unsigned long reconnects;
+    float avgLatencyMs;          // Среднее время publish → PUBACK за окно статистики
+    float maxLatencyMs;
+    float messagesPerSecond;     // Подтверждённых сообщений в секунду
+    float bytesPerSecond;        // Подтверждённых байт полезной нагрузки в секунду
+};
+
+/**
+ * Альтернативный транспорт: постоянное MQTT-соединение
+ *
+ * Публикует бинарные записи TelemetryCodec в топики устройства:
+ *   <prefix>/<device>/data      — PowerData, QoS 1
+ *   <prefix>/<device>/event     — смена флагов проблем, QoS 1
+ *   <prefix>/<device>/waveform  — осциллограмма, QoS 0
+ *   <prefix>/<device>/status    — online/offline (retained, LWT)
+ * Число неподтверждённых QoS 1 сообщений ограничено окном MQTT_INFLIGHT_WINDOW.
+ */
+class MqttUplink {
+public:
+    MqttUplink();
+
+    /**
+     * Настроить клиента (соединение устанавливается в loop(), если транспорт включён)
+     */
+    void begin(const char* host, uint16_t port, const char* deviceId,
+               const char* user, const char* password);
+
+    /**
+     * Включить/выключить транспорт (при выключении соединение закрывается)
+     */
+    void setEnabled(bool enabled);
+
+    /**
+     * Переподключение, таймауты PUBACK, пересчёт статистики
+     */
+    void loop();
+
+    bool isConnected() const;
+
+    /**
+     * Опубликовать измерения (QoS 1)
+     */
+    SendStatus publishPower(const PowerData& data);
+
+    /**
+     * Опубликовать событие смены флагов проблем (QoS 1)
+     * @param previousFlags Маска флагов до перехода
+     */
+    SendStatus publishEvent(const PowerData& data, uint8_t previousFlags);
+
+    /**
+     * Опубликовать осциллограмму (QoS 0, не занимает окно)
+     */
+    SendStatus publishWaveform(const WaveformData& waveform,
+                               float offsetA, float offsetB, float offsetC);
+
+    /**
+     * Получить статистику (задержка и пропускная способность за последнее окно)
+     */
+    MqttStats getStats() const;
+
+private:
+    enum class SlotState : uint8_t {
+        FREE,
+        RESERVED,                // Слот занят, publish() ещё не вернул packetId
+        PENDING                  // Ждём PUBACK
+    };
+
+    struct InFlight {
+        SlotState state;
+        uint16_t packetId;
+        uint16_t length;
+        unsigned long sentUs;
+        unsigned long sentMs;
+    };
+
+    AsyncMqttClient client;
+    bool enabled;
+    bool configured;
+    unsigned long lastConnectAttempt;
+
+    char clientId[40];
+    char topicData[64];
+    char topicEvent[64];
+    char topicWaveform[64];
+    char topicStatus[64];
+
+    InFlight inflight[MQTT_INFLIGHT_WINDOW];
+    mutable portMUX_TYPE mux;
+
+    uint32_t recordSeq;
+    uint8_t buffer[TELEMETRY_MAX_RECORD_SIZE];
+
+    // Счётчики (изменяются под mux: PUBACK приходит из задачи async_tcp)
+    MqttStats stats;
+    unsigned long windowStart;
+    unsigned long windowAcked;
+    unsigned long windowBytes;
+    float windowLatencySumMs;
+    float windowLatencyMaxMs;
+
+    SendStatus publishReliable(const char* topic, size_t length);
+    void onAck(uint16_t packetId);
+    void expireInflight(unsigned long nowMs);
+    void dropInflight();
+    uint32_t unixTime() const;
+};
+
+#endif // MQTT_UPLINK_H
@@ -1,88 +1,92 @@
 #include "Oscilloscope.h"
-#include <time.h>
+#include <string.h>
+#include "LineProtocol.h"
 
-Oscilloscope::Oscilloscope(int pinA, int pinB, int pinC)
-    : _pinA(pinA), _pinB(pinB), _pinC(pinC) {
+// Синхронизация: переход вверх через смещение, за TRIGGER_LAG_FRAMES кадров до
+// него фаза ниже смещения на TRIGGER_HYSTERESIS отсчётов АЦП (шум на спаде не срабатывает)
+#define TRIGGER_LAG_FRAMES 4
+#define TRIGGER_HYSTERESIS 16
+
+Oscilloscope::Oscilloscope()
+    : _generation(0) {
     memset(&_data, 0, sizeof(_data));
 }
 
-void Oscilloscope::begin() {
-    pinMode(_pinA, INPUT);
-    pinMode(_pinB, INPUT);
-    pinMode(_pinC, INPUT);
-    analogReadResolution(ADC_RESOLUTION);
-    analogSetAttenuation(ADC_11db);
-}
+int Oscilloscope::tap(const int16_t* frames, int frameCount, int stride, int phases,
+                      const float* offsets, const float* voltsPerCount, int frameScale,
+                      uint32_t frameIntervalUs, unsigned long timestampMs, int searchFrom) {
+    int16_t* const samples[3] = {_data.phaseA, _data.phaseB, _data.phaseC};
+    int step = frameIntervalUs < WAVEFORM_INTERVAL_US ? (int)(WAVEFORM_INTERVAL_US / frameIntervalUs) : 1;
+    int count = frameCount / step < WAVEFORM_SAMPLES ? frameCount / step : WAVEFORM_SAMPLES;
 
-void Oscilloscope::capture() {
-    // Захватываем все три фазы "почти одновременно"
-    // ESP32 ADC работает последовательно, но при 5kHz это достаточно быстро
-    
-    unsigned long startTime = micros();
-    _data.captureTime = millis();
-    
-    for (int i = 0; i < WAVEFORM_SAMPLES; i++) {
-        // Читаем все три канала подряд (минимальная задержка между ними)
-        _data.phaseA[i] = analogRead(_pinA);
-        _data.phaseB[i] = analogRead(_pinB);
-        _data.phaseC[i] = analogRead(_pinC);
-        
-        // Ждём до следующего отсчёта для точного timing
-        while (micros() - startTime < (unsigned long)(i + 1) * WAVEFORM_INTERVAL_US) {
-            // busy wait
+    // Первый подходящий переход, пока после него помещается всё окно
+    int first = searchFrom > 0 ? searchFrom : 0;
+    int lastStart = frameCount - count * step;
+    if (first > lastStart) {
+        return -1;
+    }
+    if (phases > 0) {
+        const float trigger = offsets[0];
+        const float hysteresis = (float)TRIGGER_HYSTERESIS * frameScale;
+        for (int i = first > TRIGGER_LAG_FRAMES ? first : TRIGGER_LAG_FRAMES; i <= lastStart; i++) {
+            if (frames[(size_t)i * stride] >= trigger &&
+                frames[(size_t)(i - TRIGGER_LAG_FRAMES) * stride] < trigger - hysteresis) {
+                first = i;
+                break;
+            }
         }
     }
-    
-    _data.sampleCount = WAVEFORM_SAMPLES;
+
+    // Кадр — отсчёты × frameScale; в снимок — отсчёты АЦП: в них считают line protocol,
+    // запись телеметрии и кадр осциллографа
+    for (int i = 0; i < count; i++) {
+        const int16_t* frame = frames + (size_t)(first + i * step) * stride;
+        for (int ph = 0; ph < 3; ph++) {
+            // Фазы, которой нет в схеме, — ровная линия на смещении
+            samples[ph][i] = ph < phases ? (int16_t)((frame[ph] + frameScale / 2) / frameScale) : ADC_OFFSET;
+        }
+    }
+    for (int ph = 0; ph < 3; ph++) {
+        _data.offsets[ph] = ph < phases ? offsets[ph] / frameScale : ADC_OFFSET;
+        _data.voltsPerCount[ph] = ph < phases ? voltsPerCount[ph] * frameScale : 0.0f;
+    }
+
+    _data.sampleCount = count;
+    _data.captureTime = timestampMs;
+    _generation++;
+    return first;
 }
 
 const WaveformData& Oscilloscope::getData() const {
     return _data;
 }
 
-String Oscilloscope::toLineProtocol(const char* deviceId, float offsetA, float offsetB, float offsetC) const {
+uint32_t Oscilloscope::getGeneration() const {
+    return _generation;
+}
+
+size_t Oscilloscope::writeLineProtocol(char* buffer, size_t size, const char* deviceId) const {
     // Формат: waveform,device=xxx,phase=A,idx=0 value=123.45
     // idx как TAG для уникальности записи в InfluxDB
     // Без timestamp - InfluxDB назначит сам
-    
-    String lines;
-    lines.reserve(WAVEFORM_SAMPLES * 3 * 70);
-    
+
+    static const char* const phases[3] = {"A", "B", "C"};
+    const int16_t* samples[3] = {_data.phaseA, _data.phaseB, _data.phaseC};
+
+    LineWriter out(buffer, size);
+
     for (int i = 0; i < (int)_data.sampleCount; i++) {
-        // Нормализуем значения относительно offset (центрируем около 0)
-        float valA = (_data.phaseA[i] - offsetA);
-        float valB = (_data.phaseB[i] - offsetB);
-        float valC = (_data.phaseC[i] - offsetC);
-        
-        // Phase A - idx как TAG
-        lines += "waveform,device=";
-        lines += deviceId;
-        lines += ",phase=A,idx=";
-        lines += String(i);
-        lines += " value=";
-        lines += String(valA, 1);
-        lines += "\n";
-        
-        // Phase B
-        lines += "waveform,device=";
-        lines += deviceId;
-        lines += ",phase=B,idx=";
-        lines += String(i);
-        lines += " value=";
-        lines += String(valB, 1);
-        lines += "\n";
-        
-        // Phase C
-        lines += "waveform,device=";
-        lines += deviceId;
-        lines += ",phase=C,idx=";
-        lines += String(i);
-        lines += " value=";
-        lines += String(valC, 1);
-        if (i < (int)_data.sampleCount - 1) {
-            lines += "\n";
+        for (int ph = 0; ph < 3; ph++) {
+            // Нормализуем значения относительно offset (центрируем около 0)
+            out.begin("waveform");
+            out.tag("device", deviceId);
+            out.tag("phase", phases[ph]);
+            out.tag("idx", i);
+            out.field("value", samples[ph][i] - _data.offsets[ph], 1);
+            out.end();
         }
     }
-    
-    return lines;
+
+    // Обрезанная осциллограмма бесполезна — не отправляем вовсе
+    return out.overflowed() ? 0 : out.length();
 }
@@ -1,59 +1,66 @@
 #ifndef OSCILLOSCOPE_H
 #define OSCILLOSCOPE_H
 
-#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "config.h"
-
-// Параметры захвата waveform
-#define WAVEFORM_SAMPLES 100      // Точек на фазу (2-3 периода при 50Hz)
-#define WAVEFORM_INTERVAL_US 200  // Интервал между отсчётами (200us = 5kHz)
+#include "WaveformData.h"
 
 /**
- * Структура для хранения waveform данных трёх фаз
- */
-struct WaveformData {
-    int16_t phaseA[WAVEFORM_SAMPLES];
-    int16_t phaseB[WAVEFORM_SAMPLES];
-    int16_t phaseC[WAVEFORM_SAMPLES];
-    uint32_t sampleCount;
-    unsigned long captureTime;  // millis() когда захвачено
-};
-
-/**
- * Класс для захвата осциллограмм трёх фаз
- * Захватывает "сырые" данные ADC для отображения синусоид
+ * Осциллограммы трёх фаз — срез блока, по которому анализатор считал RMS и частоту
+ *
+ * Своей оцифровки нет: tap() копирует WAVEFORM_SAMPLES кадров (каждый
+ * WAVEFORM_INTERVAL_US) из блока, только что отданного анализу, вместе со
+ * смещениями и калибровкой анализатора. Осциллограмма и отправленные
+ * RMS/частота — одни и те же отсчёты, время АЦП на осциллограф не тратится.
+ * Окно начинается с перехода фазы A через смещение вверх (синхронизация, как
+ * у осциллографа), так что соседние снимки совпадают по фазе. Из одного блока
+ * можно снять несколько окон подряд (searchFrom) — живой осциллограф так
+ * получает кадры чаще, чем приходят блоки.
  */
 class Oscilloscope {
 public:
-    Oscilloscope(int pinA, int pinB, int pinC);
-    
-    /**
-     * Инициализация
-     */
-    void begin();
-    
+    Oscilloscope();
+
     /**
-     * Захватить waveform всех трёх фаз одновременно
-     * Блокирующий вызов ~20-40ms
+     * Снять осциллограмму с проанализированного блока (копия, ~1 мкс на точку)
+     * @param frames Кадры по stride отсчётов, первые phases — фазы A, B, C
+     * @param frameCount Кадров в блоке
+     * @param offsets Смещение АЦП каждой фазы (из анализатора)
+     * @param voltsPerCount В/отсчёт каждой фазы (из анализатора)
+     * @param frameScale Кадр = отсчёт АЦП × frameScale (PowerAnalyzer::FRAME_SCALE); снимок в отсчётах
+     * @param frameIntervalUs Шаг кадров: берётся каждый WAVEFORM_INTERVAL_US / frameIntervalUs-й
+     * @param timestampMs millis() блока
+     * @param searchFrom Кадр, с которого искать переход
+     * @return Первый кадр окна; -1 если после searchFrom окно не помещается (снимок не меняется)
      */
-    void capture();
-    
+    int tap(const int16_t* frames, int frameCount, int stride, int phases,
+            const float* offsets, const float* voltsPerCount, int frameScale,
+            uint32_t frameIntervalUs, unsigned long timestampMs, int searchFrom = 0);
+
     /**
      * Получить последние захваченные данные
      */
     const WaveformData& getData() const;
-    
+
+    /**
+     * Номер снимка (растёт с каждым tap(); 0 — снимков ещё не было)
+     */
+    uint32_t getGeneration() const;
+
     /**
-     * Сформировать Line Protocol для отправки в InfluxDB
+     * Сформировать Line Protocol для отправки в InfluxDB (отсчёты центрированы
+     * смещениями анализатора)
+     * @param buffer Буфер (WAVEFORM_LINE_PROTOCOL_SIZE хватает на DEVICE_ID до 16 символов)
+     * @param size Размер буфера
      * @param deviceId ID устройства
-     * @param offset смещение ADC (для центрирования)
-     * @return Строка Line Protocol (много строк через \n)
+     * @return Длина записанного (много строк через \n), 0 если не поместилось
      */
-    String toLineProtocol(const char* deviceId, float offsetA, float offsetB, float offsetC) const;
+    size_t writeLineProtocol(char* buffer, size_t size, const char* deviceId) const;
 
 private:
-    int _pinA, _pinB, _pinC;
     WaveformData _data;
+    uint32_t _generation;
 };
 
 #endif // OSCILLOSCOPE_H
@@ -0,0 +1,177 @@
+#include "PersistentStats.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "hal/Hal.h"
+
+PersistentStats::PersistentStats()
+    : lastUpdateMs(0),
+      uptimeRemainderMs(0),
+      lastWriteMs(0),
+      writeCount(0),
+      writeFailures(0) {
+    memset(&record, 0, sizeof(record));
+    record.version = PERSIST_RECORD_VERSION;
+    record.size = sizeof(PersistentRecord);
+    saved = record;
+}
+
+bool PersistentStats::begin(uint32_t nowMs) {
+    bool found = false;
+    int foundSlot = 0;
+    for (int slot = 0; slot < PERSIST_SLOTS; slot++) {
+        char key[8];
+        slotKey(slot, key, sizeof(key));
+
+        PersistentRecord candidate;
+        if (!Hal::storageRead(PERSIST_NAMESPACE, key, &candidate, sizeof(candidate))) {
+            continue;
+        }
+        // Оборванная запись или другая версия структуры — слот пропускаем
+        if (candidate.version != PERSIST_RECORD_VERSION || candidate.size != sizeof(PersistentRecord) ||
+            candidate.crc != crc32(&candidate, offsetof(PersistentRecord, crc))) {
+            Hal::log("[PersistentStats] Slot %d invalid, skipped\n", slot);
+            continue;
+        }
+        if (!found || candidate.sequence > record.sequence) {
+            record = candidate;
+            foundSlot = slot;
+            found = true;
+        }
+    }
+
+    saved = record;
+    record.bootCount++;
+    lastUpdateMs = nowMs;
+    lastWriteMs = nowMs;
+
+    if (found) {
+        Hal::log("[PersistentStats] Restored checkpoint #%lu from slot %d: boot %lu, %.3f kWh imported\n",
+                 (unsigned long)record.sequence, foundSlot, (unsigned long)record.bootCount,
+                 record.energyImportKwh);
+    } else {
+        Hal::log("[PersistentStats] No checkpoint, starting from zero\n");
+    }
+    return found;
+}
+
+void PersistentStats::restoreInto(PowerAnalyzerBase& analyzer) const {
+    analyzer.restoreCounters(record.events, record.energyImportKwh, record.energyExportKwh);
+}
+
+void PersistentStats::update(const PowerAnalyzerBase& analyzer, uint32_t nowMs) {
+    // Наработка по разностям millis(): переполнение через 49 суток не мешает
+    uint32_t elapsedMs = nowMs - lastUpdateMs + uptimeRemainderMs;
+    lastUpdateMs = nowMs;
+    record.uptimeS += elapsedMs / 1000;
+    uptimeRemainderMs = elapsedMs % 1000;
+
+    record.energyImportKwh = analyzer.getEnergyImportKwh();
+    record.energyExportKwh = analyzer.getEnergyExportKwh();
+    record.events = analyzer.getEventCounters();
+
+    PowerData data = analyzer.getLastData();
+    const float voltages[3] = {data.voltageA, data.voltageB, data.voltageC};
+    for (int i = 0; i < 3; i++) {
+        // Отсутствующие в схеме фазы и обрыв фазы — не экстремумы напряжения
+        if (voltages[i] < PHASE_LOSS_THRESHOLD) {
+            continue;
+        }
+        if (record.maxVoltage == 0.0f || voltages[i] < record.minVoltage) {
+            record.minVoltage = voltages[i];
+        }
+        if (voltages[i] > record.maxVoltage) {
+            record.maxVoltage = voltages[i];
+        }
+    }
+}
+
+bool PersistentStats::checkpoint(uint32_t nowMs) {
+    uint32_t sinceMs = nowMs - lastWriteMs;
+    if (sinceMs < PERSIST_MIN_INTERVAL_MS || !changed()) {
+        return false;
+    }
+
+    bool newEvents = memcmp(&record.events, &saved.events, sizeof(record.events)) != 0;
+    double energyKwh = (record.energyImportKwh - saved.energyImportKwh) +
+                       (record.energyExportKwh - saved.energyExportKwh);
+    bool energyStep = energyKwh >= PERSIST_ENERGY_STEP_KWH;
+    bool due = sinceMs >= PERSIST_INTERVAL_MS;
+
+    if (!newEvents && !energyStep && !due) {
+        return false;
+    }
+    return write(nowMs);
+}
+
+bool PersistentStats::flush(uint32_t nowMs) {
+    if (nowMs - lastWriteMs < PERSIST_MIN_INTERVAL_MS || !changed()) {
+        return false;
+    }
+    return write(nowMs);
+}
+
+void PersistentStats::resetExtremes() {
+    record.minVoltage = 0.0f;
+    record.maxVoltage = 0.0f;
+    record.extremesSinceS = record.uptimeS;
+}
+
+const PersistentRecord& PersistentStats::getRecord() const {
+    return record;
+}
+
+const PersistentRecord& PersistentStats::getCheckpoint() const {
+    return saved;
+}
+
+uint32_t PersistentStats::getWriteCount() const {
+    return writeCount;
+}
+
+uint32_t PersistentStats::getWriteFailures() const {
+    return writeFailures;
+}
+
+bool PersistentStats::changed() const {
+    // sequence и crc у текущих значений не обновляются до записи
+    return memcmp(&record.bootCount, &saved.bootCount,
+                  offsetof(PersistentRecord, crc) - offsetof(PersistentRecord, bootCount)) != 0;
+}
+
+bool PersistentStats::write(uint32_t nowMs) {
+    // Неудачная запись тоже сдвигает интервал: не долбим флеш каждую секунду
+    lastWriteMs = nowMs;
+
+    record.sequence = saved.sequence + 1;
+    record.crc = crc32(&record, offsetof(PersistentRecord, crc));
+
+    char key[8];
+    slotKey(record.sequence % PERSIST_SLOTS, key, sizeof(key));
+    if (!Hal::storageWrite(PERSIST_NAMESPACE, key, &record, sizeof(record))) {
+        writeFailures++;
+        Hal::log("[PersistentStats] Write to %s failed\n", key);
+        return false;
+    }
+
+    saved = record;
+    writeCount++;
+    return true;
+}
+
+uint32_t PersistentStats::crc32(const void* data, size_t size) {
+    // CRC-32 (IEEE 802.3), побитно: запись раз в минуты, таблица не нужна
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+void PersistentStats::slotKey(int slot, char* key, size_t size) {
+    snprintf(key, size, "slot%d", slot);
+}
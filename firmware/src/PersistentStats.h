@@ -0,0 +1,113 @@
+#ifndef PERSISTENT_STATS_H
+#define PERSISTENT_STATS_H
+
+#include <stdint.h>
+#include "config.h"
+#include "PowerAnalyzer.h"
+
+#define PERSIST_RECORD_VERSION 1
+
+/**
+ * Накопители, которые переживают перезапуск (одна контрольная точка в слоте NVS)
+ */
+struct PersistentRecord {
+    uint16_t version;           // PERSIST_RECORD_VERSION
+    uint16_t size;              // sizeof(PersistentRecord): другая структура не читается
+    uint32_t sequence;          // Номер контрольной точки, у новейшей наибольший
+    uint32_t bootCount;         // Запусков с первого включения
+    uint32_t uptimeS;           // Суммарная наработка, с
+    double energyImportKwh;
+    double energyExportKwh;
+    PowerEventCounters events;
+    float minVoltage;           // Фазное напряжение с последнего сброса: наименьшее
+    float maxVoltage;           // и наибольшее (0 — ещё не было; ниже PHASE_LOSS_THRESHOLD не считается)
+    uint32_t extremesSinceS;    // Наработка (uptimeS) на момент сброса min/max
+    uint32_t crc;               // CRC-32 всех предыдущих байт
+};
+
+/**
+ * Накопители в RAM с контрольными точками в NVS
+ *
+ * Значения обновляются после каждого измерения, а во флеш уходят редко:
+ * не чаще PERSIST_MIN_INTERVAL_MS и только если есть что сохранить — новые
+ * события, PERSIST_ENERGY_STEP_KWH энергии или PERSIST_INTERVAL_MS с прошлой
+ * записи. Записи по кругу ложатся в PERSIST_SLOTS ключей с CRC, поэтому
+ * оборванная при пропадании питания запись портит только один слот, и при
+ * запуске восстанавливается предыдущая целая. Потеря при отключении питания —
+ * накопленное с последней контрольной точки (оценка: bench --persist-sim).
+ */
+class PersistentStats {
+public:
+    PersistentStats();
+
+    /**
+     * Восстановить новейшую целую контрольную точку и посчитать запуск
+     * @param nowMs millis() — от него отсчитывается первый интервал записи
+     * @return false если сохранённых данных нет (первый запуск)
+     */
+    bool begin(uint32_t nowMs);
+
+    /**
+     * Продолжить счётчики энергии и событий анализатора с восстановленных значений
+     */
+    void restoreInto(PowerAnalyzerBase& analyzer) const;
+
+    /**
+     * Взять счётчики и напряжения из последнего измерения (только RAM)
+     */
+    void update(const PowerAnalyzerBase& analyzer, uint32_t nowMs);
+
+    /**
+     * Записать контрольную точку, если пора по правилам выше
+     * @return true если запись была
+     */
+    bool checkpoint(uint32_t nowMs);
+
+    /**
+     * Записать несохранённое перед ESP.restart() (не чаще PERSIST_MIN_INTERVAL_MS:
+     * цикл перезапусков не должен изнашивать флеш)
+     * @return true если запись была
+     */
+    bool flush(uint32_t nowMs);
+
+    /**
+     * Начать min/max напряжения заново (сохранится со следующей контрольной точкой)
+     */
+    void resetExtremes();
+
+    /**
+     * Текущие значения и последняя записанная контрольная точка
+     */
+    const PersistentRecord& getRecord() const;
+    const PersistentRecord& getCheckpoint() const;
+
+    /**
+     * Записей во флеш с запуска и неудачных из них
+     */
+    uint32_t getWriteCount() const;
+    uint32_t getWriteFailures() const;
+
+private:
+    PersistentRecord record;
+    PersistentRecord saved;
+    uint32_t lastUpdateMs;
+    uint32_t uptimeRemainderMs;
+    uint32_t lastWriteMs;
+    uint32_t writeCount;
+    uint32_t writeFailures;
+
+    /**
+     * Отличаются ли текущие значения от записанных
+     */
+    bool changed() const;
+
+    /**
+     * Записать текущие значения в следующий по кругу слот
+     */
+    bool write(uint32_t nowMs);
+
+    static uint32_t crc32(const void* data, size_t size);
+    static void slotKey(int slot, char* key, size_t size);
+};
+
+#endif // PERSISTENT_STATS_H
@@ -0,0 +1,326 @@
+#include "PmuServer.h"
+#include <sys/time.h>
+#include <time.h>
+#include "esp_sntp.h"
+
+// Имена каналов в CFG-2 по букве канала схемы (A, B, C или 1, 2)
+static const char* const CHANNEL_NAMES[SYNCHROPHASOR_MAX_CHANNELS] = {"VA", "VB", "VC"};
+static const char* const SPLIT_PHASE_NAMES[SYNCHROPHASOR_MAX_CHANNELS] = {"V1", "V2", "-"};
+
+volatile uint32_t PmuServer::lastSyncMs = 0;
+
+PmuServer::PmuServer(PowerAnalyzer& analyzer)
+    : analyzer(analyzer),
+      samplerTask(nullptr),
+      senderTask(nullptr),
+      queue(nullptr),
+      samplerRunning(false),
+      stopRequested(false),
+      channels(0),
+      rate(PMU_DEFAULT_RATE),
+      configCount(0),
+      pendingRate(0),
+      committedBlocks(0),
+      framesSent(0),
+      framesFailed(0),
+      framesDropped(0),
+      lateFrames(0),
+      maxLateUs(0) {
+    for (int i = 0; i < HANDOFF_BLOCKS; i++) {
+        blocks[i] = nullptr;
+        blockTimestampMs[i] = 0;
+    }
+}
+
+void PmuServer::onTimeSync(struct timeval* tv) {
+    lastSyncMs = millis() | 1;
+}
+
+uint32_t PmuServer::timeErrorUs() {
+    uint32_t syncMs = lastSyncMs;
+    if (syncMs == 0) {
+        return UINT32_MAX;
+    }
+    // Между синхронизациями часы идут по кварцу: ошибка растёт на PMU_CLOCK_DRIFT_PPM
+    uint32_t sinceMs = millis() - syncMs;
+    return PMU_NTP_ERROR_US + (uint32_t)((uint64_t)sinceMs * PMU_CLOCK_DRIFT_PPM / 1000);
+}
+
+void PmuServer::begin(AsyncWebServer& server) {
+    sntp_set_time_sync_notification_cb(onTimeSync);
+    // Первая синхронизация прошла до регистрации обработчика (setup())
+    if (time(nullptr) > 1700000000 && lastSyncMs == 0) {
+        lastSyncMs = millis() | 1;
+    }
+
+    server.on("/pmu", HTTP_POST, [this](AsyncWebServerRequest* request) {
+        if (request->hasParam("stop")) {
+            pendingRate = -1;
+            request->send(200, "text/plain", "stopping");
+            return;
+        }
+        int32_t value = PMU_DEFAULT_RATE;
+        if (request->hasParam("rate")) {
+            value = request->getParam("rate")->value().toInt();
+        }
+        if (value <= 0 || !PhasorEstimator::isValidRate((uint32_t)value, NOMINAL_FREQUENCY)) {
+            request->send(400, "text/plain",
+                          NOMINAL_FREQUENCY == 50.0f ? "rate must be 10, 25 or 50" : "rate must be 10, 12, 15, 20, 30 or 60");
+            return;
+        }
+        pendingRate = value;
+        request->send(202, "text/plain", "starting");
+    });
+    server.on("/pmu", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleStatus(request);
+    });
+
+    Serial.printf("[PMU] Endpoint at /pmu, frames to %s:%u\n", PMU_UDP_HOST, PMU_UDP_PORT);
+}
+
+void PmuServer::handleStatus(AsyncWebServerRequest* request) {
+    uint32_t error = timeErrorUs();
+    bool synced = error != UINT32_MAX;
+    AsyncResponseStream* response = request->beginResponseStream("application/json");
+    response->printf("{\"running\":%s,\"rate\":%lu,\"idcode\":%d,\"window_frames\":%d,"
+                     "\"frames_sent\":%lu,\"frames_failed\":%lu,\"frames_dropped\":%lu,"
+                     "\"late_frames\":%lu,\"max_late_us\":%lu,",
+                     samplerRunning ? "true" : "false", (unsigned long)rate, PMU_IDCODE,
+                     estimator.getWindowFrames(), (unsigned long)framesSent, (unsigned long)framesFailed,
+                     (unsigned long)framesDropped, (unsigned long)lateFrames, (unsigned long)maxLateUs);
+    response->printf("\"time\":{\"synced\":%s,\"error_us\":%lu,\"since_sync_s\":%lu,\"tq\":%u},",
+                     synced ? "true" : "false", synced ? (unsigned long)error : 0UL,
+                     synced ? (unsigned long)((millis() - lastSyncMs) / 1000) : 0UL,
+                     (unsigned)SynchrophasorCodec::timeQuality(synced, error));
+
+    SynchrophasorFrame frame;
+    if (!lastFrame.read(frame) || frame.channels == 0) {
+        response->print("\"last\":null}");
+        request->send(response);
+        return;
+    }
+    response->printf("\"last\":{\"soc\":%lu,\"frac_us\":%lu,\"frequency\":%.4f,\"rocof\":%.3f,\"phasors\":[",
+                     (unsigned long)frame.soc, (unsigned long)frame.fracUs, frame.frequency, frame.rocof);
+    for (int ch = 0; ch < frame.channels; ch++) {
+        response->printf("%s{\"magnitude\":%.2f,\"angle_deg\":%.3f}", ch > 0 ? "," : "", frame.magnitude[ch],
+                         frame.angle[ch] * 180.0f / (float)M_PI);
+    }
+    response->printf("],\"positive\":{\"magnitude\":%.2f,\"angle_deg\":%.3f}}}", frame.positiveMagnitude,
+                     frame.positiveAngle * 180.0f / (float)M_PI);
+    request->send(response);
+}
+
+void PmuServer::loop(bool adcBusy) {
+    int32_t request = pendingRate;
+    if (request == 0) {
+        return;
+    }
+    pendingRate = 0;
+    if (request < 0) {
+        stopRequested = true;
+    } else if (samplerRunning || senderTask != nullptr) {
+        Serial.println("[PMU] Already running (POST /pmu?stop=1 first)");
+    } else if (adcBusy) {
+        Serial.println("[PMU] ADC busy (deep capture), not started");
+    } else if (!start((uint32_t)request)) {
+        Serial.println("[PMU] Not started");
+    }
+}
+
+bool PmuServer::start(uint32_t rate) {
+    const size_t blockBytes = PowerAnalyzer::BLOCK_SAMPLES * sizeof(int16_t);
+    for (int i = 0; i < HANDOFF_BLOCKS; i++) {
+        if (blocks[i] == nullptr) {
+            blocks[i] = (int16_t*)Hal::allocExternal(blockBytes);
+        }
+        if (blocks[i] == nullptr) {
+            blocks[i] = (int16_t*)malloc(blockBytes);
+        }
+        if (blocks[i] == nullptr) {
+            Serial.println("[PMU] No memory for sample blocks");
+            return false;
+        }
+    }
+    if (queue == nullptr) {
+        queue = xQueueCreate(PMU_QUEUE_FRAMES, sizeof(SynchrophasorFrame));
+        if (queue == nullptr) {
+            Serial.println("[PMU] No memory for the frame queue");
+            return false;
+        }
+    }
+
+    channels = PowerAnalyzer::VOLTAGE_CHANNELS < SYNCHROPHASOR_MAX_CHANNELS ? PowerAnalyzer::VOLTAGE_CHANNELS
+                                                                            : SYNCHROPHASOR_MAX_CHANNELS;
+    float calibration[SYNCHROPHASOR_MAX_CHANNELS];
+    for (int ch = 0; ch < channels; ch++) {
+        calibration[ch] = analyzer.getSensitivity(ch);
+    }
+    if (!estimator.begin(channels, PowerAnalyzer::SAMPLE_RATE_HZ, NOMINAL_FREQUENCY, calibration,
+                         PMU_CHANNEL_SKEW_US, rate)) {
+        Serial.printf("[PMU] Phasor window does not fit %lu Hz sampling\n",
+                      (unsigned long)PowerAnalyzer::SAMPLE_RATE_HZ);
+        return false;
+    }
+
+    this->rate = rate;
+    configCount++;
+    framesSent = framesFailed = framesDropped = 0;
+    lateFrames = maxLateUs = 0;
+    stopRequested = false;
+    samplerRunning = true;
+    xQueueReset(queue);
+
+    if (xTaskCreatePinnedToCore(samplerLoop, "pmu_sampler", 4096, this, PMU_PRIORITY, &samplerTask,
+                                PMU_CORE) != pdPASS) {
+        samplerRunning = false;
+        return false;
+    }
+    if (xTaskCreatePinnedToCore(senderLoop, "pmu_sender", 4096, this, 1, &senderTask, 1) != pdPASS) {
+        // Задача оцифровки без отправителя: остановить, отчёты никому не нужны
+        stopRequested = true;
+        return false;
+    }
+    Serial.printf("[PMU] Streaming %lu frames/s, window %d frames, time error %s\n", (unsigned long)rate,
+                  estimator.getWindowFrames(),
+                  timeErrorUs() == UINT32_MAX ? "unknown (no NTP)" : String(timeErrorUs()).c_str());
+    return true;
+}
+
+bool PmuServer::isSampling() const {
+    return samplerRunning;
+}
+
+bool PmuServer::hasStartRequest() const {
+    return pendingRate > 0;
+}
+
+const int16_t* PmuServer::latestBlock(uint32_t& seq, uint32_t& timestampMs) const {
+    uint32_t committed = committedBlocks.load(std::memory_order_acquire);
+    if (committed == 0) {
+        return nullptr;
+    }
+    seq = committed - 1;
+    timestampMs = blockTimestampMs[seq % HANDOFF_BLOCKS];
+    return blocks[seq % HANDOFF_BLOCKS];
+}
+
+bool PmuServer::holdsBlock(uint32_t seq) const {
+    // Блок committed пишется в слот committed % HANDOFF_BLOCKS сразу после публикации предыдущего
+    return committedBlocks.load(std::memory_order_acquire) - seq < HANDOFF_BLOCKS;
+}
+
+uint32_t PmuServer::getFramesSent() const {
+    return framesSent;
+}
+
+uint32_t PmuServer::getFramesFailed() const {
+    return framesFailed;
+}
+
+uint32_t PmuServer::getFramesDropped() const {
+    return framesDropped;
+}
+
+uint32_t PmuServer::getRate() const {
+    return rate;
+}
+
+void PmuServer::sendConfig() {
+    uint8_t buffer[C37_CONFIG_FRAME_MAX];
+    const char* const* names = PowerAnalyzer::Traits::channelName(0) == 'A' ? CHANNEL_NAMES : SPLIT_PHASE_NAMES;
+    size_t length = SynchrophasorCodec::encodeConfig(PMU_IDCODE, DEVICE_ID, channels, names,
+                                                     NOMINAL_FREQUENCY, (uint16_t)rate, configCount,
+                                                     (uint32_t)time(nullptr), buffer, sizeof(buffer));
+    if (length > 0 && udp.beginPacket(PMU_UDP_HOST, PMU_UDP_PORT)) {
+        udp.write(buffer, length);
+        udp.endPacket();
+    }
+}
+
+void PmuServer::samplerLoop(void* arg) {
+    PmuServer* self = static_cast<PmuServer*>(arg);
+
+    // Задача не уступает процессор, пока идёт поток: сторож простоя ядра 0 молчит до остановки
+    disableCore0WDT();
+
+    const uint32_t blockUs = PowerAnalyzer::FRAMES_PER_BLOCK * PowerAnalyzer::INTERVAL_US;
+    uint32_t startUs = PowerAnalyzer::startNowUs();
+    uint32_t seq = self->committedBlocks.load(std::memory_order_relaxed);
+    while (!self->stopRequested) {
+        // UTC начала блока: часы системы минус прошедшее с начала расписания.
+        // Пересчёт на каждый блок подхватывает подстройку часов SNTP
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        uint32_t nowUs = Hal::micros();
+        const uint64_t utcStartUs = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec - (int32_t)(nowUs - startUs);
+
+        int16_t* block = self->blocks[seq % HANDOFF_BLOCKS];
+        uint32_t blockMaxLateUs;
+        uint32_t late = self->analyzer.acquire(block, startUs, blockMaxLateUs, [self, utcStartUs](const int16_t* frame, int i) {
+            if (self->estimator.push(frame, utcStartUs + (uint64_t)i * PowerAnalyzer::INTERVAL_US)) {
+                if (xQueueSend(self->queue, &self->estimator.getFrame(), 0) != pdTRUE) {
+                    self->framesDropped++;
+                }
+            }
+        });
+
+        self->blockTimestampMs[seq % HANDOFF_BLOCKS] = Hal::millis();
+        self->committedBlocks.store(++seq, std::memory_order_release);
+        self->lateFrames += late;
+        if (blockMaxLateUs > self->maxLateUs) {
+            self->maxLateUs = blockMaxLateUs;
+        }
+        startUs += blockUs;
+    }
+
+    enableCore0WDT();
+    self->samplerRunning = false;
+    self->samplerTask = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void PmuServer::senderLoop(void* arg) {
+    PmuServer* self = static_cast<PmuServer*>(arg);
+    uint32_t nextConfigS = 0;
+    uint8_t buffer[C37_DATA_FRAME_MAX];
+
+    for (;;) {
+        SynchrophasorFrame frame;
+        if (xQueueReceive(self->queue, &frame, pdMS_TO_TICKS(100)) != pdTRUE) {
+            if (!self->samplerRunning) {
+                break;
+            }
+            continue;
+        }
+        self->lastFrame.write(frame);
+        // Пока истории углов мало, частоты нет: такие отчёты не отправляем
+        if (!frame.frequencyValid) {
+            continue;
+        }
+
+        // Приёмник без конфигурации кадры данных не разберёт: CFG-2 первым и затем периодически
+        if (frame.soc >= nextConfigS) {
+            self->sendConfig();
+            nextConfigS = frame.soc + PMU_CONFIG_INTERVAL_S;
+        }
+
+        uint32_t error = timeErrorUs();
+        bool synced = error != UINT32_MAX;
+        uint32_t unlockedS = synced ? (millis() - lastSyncMs) / 1000 : 0;
+        size_t length = SynchrophasorCodec::encodeData(frame, PMU_IDCODE,
+                                                       SynchrophasorCodec::timeQuality(synced, error),
+                                                       SynchrophasorCodec::status(synced, error, unlockedS),
+                                                       NOMINAL_FREQUENCY, buffer, sizeof(buffer));
+        if (length > 0 && self->udp.beginPacket(PMU_UDP_HOST, PMU_UDP_PORT) &&
+            self->udp.write(buffer, length) == length && self->udp.endPacket()) {
+            self->framesSent++;
+        } else {
+            self->framesFailed++;
+        }
+    }
+
+    Serial.printf("[PMU] Stopped: sent=%lu, failed=%lu, dropped=%lu\n", (unsigned long)self->framesSent,
+                  (unsigned long)self->framesFailed, (unsigned long)self->framesDropped);
+    self->senderTask = nullptr;
+    vTaskDelete(nullptr);
+}
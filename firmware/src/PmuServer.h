@@ -0,0 +1,136 @@
+#ifndef PMU_SERVER_H
+#define PMU_SERVER_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <WiFiUdp.h>
+#include <atomic>
+#include "config.h"
+#include "PowerAnalyzer.h"
+#include "SeqLock.h"
+#include "Synchrophasor.h"
+
+/**
+ * Режим PMU: синхрофазоры в кадрах C37.118 по UDP
+ *
+ *   POST /pmu?rate=N   — начать (POST /pmu?stop=1 — остановить)
+ *   GET  /pmu          — состояние, качество времени и последний отчёт
+ *
+ * Задача оцифровки на PMU_CORE владеет АЦП: блоки встык по расписанию, и
+ * каждый кадр сразу идёт в PhasorEstimator (acquire() с обработкой кадра).
+ * Готовые отчёты через очередь забирает задача отправки на ядре 1: кадр
+ * данных на каждый отчёт и CFG-2 раз в PMU_CONFIG_INTERVAL_S. Оцифрованные
+ * блоки измерение в loop() берёт через latestBlock(), как при глубоком захвате.
+ *
+ * Время кадров — от NTP: качество (TQ в FRACSEC, биты 8-4 STAT) считается
+ * по времени с последней синхронизации SNTP и PMU_CLOCK_DRIFT_PPM.
+ */
+class PmuServer {
+public:
+    explicit PmuServer(PowerAnalyzer& analyzer);
+
+    /**
+     * Зарегистрировать обработчики на веб-сервере
+     */
+    void begin(AsyncWebServer& server);
+
+    /**
+     * Запуск/остановка по запросам (из loop())
+     * @param adcBusy АЦП занят другой задачей (глубокий захват) — запуск отклоняется
+     */
+    void loop(bool adcBusy);
+
+    /**
+     * Работает ли задача оцифровки (loop() не должен трогать АЦП)
+     */
+    bool isSampling() const;
+
+    /**
+     * Запрошен ли запуск (loop() ещё не обработал): АЦП скоро понадобится
+     */
+    bool hasStartRequest() const;
+
+    /**
+     * Последний оцифрованный блок (FRAMES_PER_BLOCK кадров) для измерения
+     * @param seq Номер блока (растёт на единицу)
+     * @param timestampMs millis() конца блока
+     * @return nullptr если блоков ещё нет. Слот перепишется через HANDOFF_BLOCKS - 1
+     *         блоков: копировать и проверять holdsBlock()
+     */
+    const int16_t* latestBlock(uint32_t& seq, uint32_t& timestampMs) const;
+
+    /**
+     * Блок seq ещё не начал перезаписываться (всё прочитанное из него до этого вызова цело)
+     */
+    bool holdsBlock(uint32_t seq) const;
+
+    /**
+     * Отправлено кадров данных, не отправлено (UDP) и потеряно в очереди
+     */
+    uint32_t getFramesSent() const;
+    uint32_t getFramesFailed() const;
+    uint32_t getFramesDropped() const;
+
+    uint32_t getRate() const;
+
+    /**
+     * Текущая оценка ошибки часов, мкс (UINT32_MAX — время не синхронизировано)
+     */
+    static uint32_t timeErrorUs();
+
+private:
+    // Блоки для измерения: пока loop() копирует один, задача пишет другой. Копия
+    // сверяется с holdsBlock() — медленный проход loop() не видит чужой блок
+    static const int HANDOFF_BLOCKS = 3;
+
+    PowerAnalyzer& analyzer;
+    PhasorEstimator estimator;
+    WiFiUDP udp;
+    TaskHandle_t samplerTask;
+    TaskHandle_t senderTask;
+    QueueHandle_t queue;
+    volatile bool samplerRunning;
+    volatile bool stopRequested;
+    int channels;
+    uint32_t rate;
+    uint16_t configCount;
+
+    // Запрос из веб-обработчика (задача async_tcp): >0 — частота отчётов, -1 — остановить
+    volatile int32_t pendingRate;
+
+    int16_t* blocks[HANDOFF_BLOCKS];
+    uint32_t blockTimestampMs[HANDOFF_BLOCKS];
+    std::atomic<uint32_t> committedBlocks;
+
+    volatile uint32_t framesSent;
+    volatile uint32_t framesFailed;
+    volatile uint32_t framesDropped;
+    volatile uint32_t lateFrames;
+    volatile uint32_t maxLateUs;
+    SeqLock<SynchrophasorFrame> lastFrame;
+
+    // Последняя синхронизация SNTP (millis()), 0 — не было
+    static volatile uint32_t lastSyncMs;
+
+    bool start(uint32_t rate);
+    void handleStatus(AsyncWebServerRequest* request);
+
+    /**
+     * Отправить кадр конфигурации 2
+     */
+    void sendConfig();
+
+    /**
+     * Задача оцифровки: блоки встык, кадры — в оценку синхрофазоров
+     */
+    static void samplerLoop(void* arg);
+
+    /**
+     * Задача отправки: отчёты из очереди — в UDP
+     */
+    static void senderLoop(void* arg);
+
+    static void onTimeSync(struct timeval* tv);
+};
+
+#endif // PMU_SERVER_H
@@ -1,124 +1,121 @@
 #include "PowerAnalyzer.h"
-#include <algorithm>
 #include <cmath>
-
-PowerAnalyzer::PowerAnalyzer() 
-    : sensorA(PIN_PHASE_A, CALIBRATION_COEFF_A),
-      sensorB(PIN_PHASE_B, CALIBRATION_COEFF_B),
-      sensorC(PIN_PHASE_C, CALIBRATION_COEFF_C) {
+#include <string.h>
+#include "LineProtocol.h"
+#include "TelemetryCodec.h"
+
+PowerAnalyzerBase::PowerAnalyzerBase(uint16_t topologyFields, int powerPhases)
+    : topologyFields(topologyFields),
+      powerPhases(powerPhases),
+      measurementCount(0),
+      energyImportKwh(0.0),
+      energyExportKwh(0.0),
+      lastEnergyMs(0),
+      energyPrimed(false) {
     memset(&lastData, 0, sizeof(lastData));
+    memset(&eventCounters, 0, sizeof(eventCounters));
 }
 
-void PowerAnalyzer::begin() {
-    Serial.println("[PowerAnalyzer] Initializing sensors...");
-    
-    sensorA.begin();
-    sensorB.begin();
-    sensorC.begin();
+void PowerAnalyzerBase::publish(PowerData& data, int phases) {
+    // Проверка пороговых значений
+    checkThresholds(data, phases);
     
-    // Небольшая задержка для стабилизации ADC
-    delay(100);
+    if (powerPhases > 0) {
+        integrateEnergy(data);
+    }
     
-    // Автокалибровка смещения
-    calibrate();
+    // Считаем события до перезаписи предыдущих данных
+    countEvents(lastData, data);
     
-    Serial.println("[PowerAnalyzer] Initialization complete");
+    // Сохраняем последние данные
+    lastData = data;
+    measurementCount++;
+    
+    // Публикуем снимок для читателей из других задач
+    PowerSnapshot published;
+    published.data = data;
+    published.events = eventCounters;
+    published.measurementCount = measurementCount;
+    snapshot.write(published);
 }
 
-void PowerAnalyzer::calibrate() {
-    Serial.println("[PowerAnalyzer] Calibrating offset...");
-    
-    sensorA.calibrateOffset();
-    sensorB.calibrateOffset();
-    sensorC.calibrateOffset();
+void PowerAnalyzerBase::integrateEnergy(PowerData& data) {
+    uint32_t nowMs = (uint32_t)data.timestamp;
+    
+    // Мощность окна считаем постоянной до следующего измерения; после долгого
+    // перерыва (перезапуск Wi-Fi, остановка цикла) промежуток не засчитываем
+    if (energyPrimed) {
+        uint32_t gapMs = nowMs - lastEnergyMs;
+        if (gapMs <= ENERGY_MAX_GAP_MS) {
+            // Вт · мс -> кВт·ч
+            double kwh = (double)data.activePower * gapMs / 3.6e9;
+            if (kwh > 0.0) {
+                energyImportKwh += kwh;
+            } else {
+                energyExportKwh -= kwh;
+            }
+        }
+    }
+    lastEnergyMs = nowMs;
+    energyPrimed = true;
     
-    Serial.println("[PowerAnalyzer] Calibration complete");
+    data.energyImportKwh = (float)energyImportKwh;
+    data.energyExportKwh = (float)energyExportKwh;
 }
 
-PowerData PowerAnalyzer::measure() {
-    PowerData data;
-    
-    // Читаем RMS напряжения с каждой фазы
-    // Измеряем последовательно для точности (не параллельно)
-    data.voltageA = sensorA.readRMS();
-    data.frequencyA = sensorA.getFrequency();
-    
-    data.voltageB = sensorB.readRMS();
-    data.frequencyB = sensorB.getFrequency();
-    
-    data.voltageC = sensorC.readRMS();
-    data.frequencyC = sensorC.getFrequency();
-    
-    // Среднее напряжение
-    data.voltageAvg = (data.voltageA + data.voltageB + data.voltageC) / 3.0f;
-    
-    // Средняя частота
-    data.frequencyAvg = (data.frequencyA + data.frequencyB + data.frequencyC) / 3.0f;
-    
-    // Межфазные (линейные) напряжения
-    // Для симметричной трёхфазной системы: Uл = Uф * √3
-    // Для реальной системы с учётом сдвига фаз на 120°:
-    // Uab = √(Ua² + Ub² - 2*Ua*Ub*cos(120°)) = √(Ua² + Ub² + Ua*Ub)
-    // Упрощённо (для почти симметричной системы): Uл ≈ Uф * 1.732
-    data.voltageAB = sqrt(data.voltageA * data.voltageA + 
-                         data.voltageB * data.voltageB + 
-                         data.voltageA * data.voltageB);
-    
-    data.voltageBC = sqrt(data.voltageB * data.voltageB + 
-                         data.voltageC * data.voltageC + 
-                         data.voltageB * data.voltageC);
-    
-    data.voltageCA = sqrt(data.voltageC * data.voltageC + 
-                         data.voltageA * data.voltageA + 
-                         data.voltageC * data.voltageA);
-    
-    // Перекос фаз
-    data.unbalance = calculateUnbalance(data.voltageA, data.voltageB, data.voltageC);
-    
-    // Метка времени
-    data.timestamp = millis();
-    
-    // Проверка пороговых значений
-    checkThresholds(data);
-    
-    // Сохраняем последние данные
-    lastData = data;
-    
-    return data;
+PowerData PowerAnalyzerBase::getLastData() const {
+    return lastData;
 }
 
-PowerData PowerAnalyzer::getLastData() const {
-    return lastData;
+PowerEventCounters PowerAnalyzerBase::getEventCounters() const {
+    return eventCounters;
 }
 
-float PowerAnalyzer::calculateUnbalance(float ua, float ub, float uc) {
-    // Коэффициент несимметрии напряжений по обратной последовательности
-    // Упрощённый расчёт по ГОСТ 13109-97:
-    // K2U = (Umax - Umin) / Uavg * 100%
-    
-    float maxV = std::max({ua, ub, uc});
-    float minV = std::min({ua, ub, uc});
-    float avgV = (ua + ub + uc) / 3.0f;
-    
-    if (avgV < 1.0f) {
-        return 0.0f;  // Избегаем деления на ноль при отсутствии напряжения
+double PowerAnalyzerBase::getEnergyImportKwh() const {
+    return energyImportKwh;
+}
+
+double PowerAnalyzerBase::getEnergyExportKwh() const {
+    return energyExportKwh;
+}
+
+void PowerAnalyzerBase::restoreCounters(const PowerEventCounters& events, double importKwh, double exportKwh) {
+    eventCounters = events;
+    energyImportKwh = importKwh;
+    energyExportKwh = exportKwh;
+}
+
+bool PowerAnalyzerBase::readSnapshot(PowerSnapshot& out) const {
+    return snapshot.read(out);
+}
+
+void PowerAnalyzerBase::countEvents(const PowerData& previous, const PowerData& current) {
+    if (current.lowVoltage && !previous.lowVoltage) {
+        eventCounters.lowVoltage++;
+    }
+    if (current.highVoltage && !previous.highVoltage) {
+        eventCounters.highVoltage++;
+    }
+    if (current.highUnbalance && !previous.highUnbalance) {
+        eventCounters.highUnbalance++;
+    }
+    if (current.frequencyDeviation && !previous.frequencyDeviation) {
+        eventCounters.frequencyDeviation++;
     }
-    
-    return ((maxV - minV) / avgV) * 100.0f;
 }
 
-void PowerAnalyzer::checkThresholds(PowerData& data) {
-    // Проверка низкого напряжения (< 198В для 220В сети, -10%)
-    float lowThreshold = NOMINAL_VOLTAGE * 0.9f;
-    data.lowVoltage = (data.voltageA < lowThreshold || 
-                       data.voltageB < lowThreshold || 
-                       data.voltageC < lowThreshold);
+void PowerAnalyzerBase::checkThresholds(PowerData& data, int phases) {
+    const float voltages[3] = {data.voltageA, data.voltageB, data.voltageC};
     
-    // Проверка высокого напряжения (> 242В для 220В сети, +10%)
+    // Проверка низкого (< 198В для 220В сети, -10%) и высокого (> 242В, +10%) напряжения
+    float lowThreshold = NOMINAL_VOLTAGE * 0.9f;
     float highThreshold = NOMINAL_VOLTAGE * 1.1f;
-    data.highVoltage = (data.voltageA > highThreshold || 
-                        data.voltageB > highThreshold || 
-                        data.voltageC > highThreshold);
+    data.lowVoltage = false;
+    data.highVoltage = false;
+    for (int i = 0; i < phases; i++) {
+        data.lowVoltage = data.lowVoltage || voltages[i] < lowThreshold;
+        data.highVoltage = data.highVoltage || voltages[i] > highThreshold;
+    }
     
     // Перекос фаз > 2% - норма по ГОСТ 13109-97
     // > 4% - предельно допустимое
@@ -128,95 +125,128 @@ void PowerAnalyzer::checkThresholds(PowerData& data) {
     data.frequencyDeviation = (fabs(data.frequencyAvg - NOMINAL_FREQUENCY) > FREQUENCY_DEVIATION_THRESHOLD);
 }
 
-String PowerAnalyzer::toLineProtocol(const char* deviceId) const {
+size_t PowerAnalyzerBase::writeLineProtocol(char* buffer, size_t size, const char* deviceId,
+                                        uint16_t fieldMask) const {
     // Формат InfluxDB Line Protocol (без timestamp — InfluxDB выставит server time):
     // voltage,device=...,phase=A value=221.5
     // frequency,device=... value=50.02
     // unbalance,device=... value=1.23
     // line_voltage,device=...,phases=AB value=383.5
+    // power,device=...,phase=A current=4.52,active=962.1,reactive=201.3,apparent=994.4,pf=0.968,angle=11.8
+    // power,device=...,phase=total active=2890.4,reactive=610.0,apparent=2990.2,pf=0.967
+    // energy,device=... import_kwh=12.345,export_kwh=0.000
+    // В режиме deadband в строку попадают только величины из fieldMask.
+
+    struct Point {
+        uint16_t field;
+        const char* measurement;
+        const char* tagKey;
+        const char* tagValue;
+        float value;
+    };
+
+    const Point points[] = {
+        // Фазные напряжения
+        {DEADBAND_FIELD_VOLTAGE_A, "voltage", "phase", "A", lastData.voltageA},
+        {DEADBAND_FIELD_VOLTAGE_B, "voltage", "phase", "B", lastData.voltageB},
+        {DEADBAND_FIELD_VOLTAGE_C, "voltage", "phase", "C", lastData.voltageC},
+        // Межфазные напряжения
+        {DEADBAND_FIELD_LINE_AB, "line_voltage", "phases", "AB", lastData.voltageAB},
+        {DEADBAND_FIELD_LINE_BC, "line_voltage", "phases", "BC", lastData.voltageBC},
+        {DEADBAND_FIELD_LINE_CA, "line_voltage", "phases", "CA", lastData.voltageCA},
+        // Частота и перекос
+        {DEADBAND_FIELD_FREQUENCY, "frequency", nullptr, nullptr, lastData.frequencyAvg},
+        {DEADBAND_FIELD_UNBALANCE, "unbalance", nullptr, nullptr, lastData.unbalance},
+    };
+
+    LineWriter out(buffer, size);
+    // Величин, которых нет в схеме подключения (фаза C в split-phase и т.п.), не отправляем
+    fieldMask &= topologyFields;
+
+    for (const Point& point : points) {
+        if (!(fieldMask & point.field)) {
+            continue;
+        }
+        out.begin(point.measurement);
+        out.tag("device", deviceId);
+        if (point.tagKey != nullptr) {
+            out.tag(point.tagKey, point.tagValue);
+        }
+        out.field("value", point.value, 2);
+        out.end();
+    }
+
+    // Мощности уходят все вместе: по отдельности фазы и сумма расходились бы
+    if (fieldMask & DEADBAND_FIELD_POWER) {
+        const char* const phaseNames[3] = {"A", "B", "C"};
+        const float current[3] = {lastData.currentA, lastData.currentB, lastData.currentC};
+        const float active[3] = {lastData.activePowerA, lastData.activePowerB, lastData.activePowerC};
+        const float reactive[3] = {lastData.reactivePowerA, lastData.reactivePowerB, lastData.reactivePowerC};
+        const float apparent[3] = {lastData.apparentPowerA, lastData.apparentPowerB, lastData.apparentPowerC};
+        const float factor[3] = {lastData.powerFactorA, lastData.powerFactorB, lastData.powerFactorC};
+        const float angle[3] = {lastData.phaseAngleA, lastData.phaseAngleB, lastData.phaseAngleC};
+
+        for (int k = 0; k < powerPhases; k++) {
+            out.begin("power");
+            out.tag("device", deviceId);
+            out.tag("phase", phaseNames[k]);
+            out.field("current", current[k], 3);
+            out.field("active", active[k], 1);
+            out.field("reactive", reactive[k], 1);
+            out.field("apparent", apparent[k], 1);
+            out.field("pf", factor[k], 3);
+            out.field("angle", angle[k], 1);
+            out.end();
+        }
+
+        out.begin("power");
+        out.tag("device", deviceId);
+        out.tag("phase", "total");
+        out.field("active", lastData.activePower, 1);
+        out.field("reactive", lastData.reactivePower, 1);
+        out.field("apparent", lastData.apparentPower, 1);
+        out.field("pf", lastData.powerFactor, 3);
+        out.end();
+    }
 
-    String lines;
-
-    // Фазные напряжения
-    lines += "voltage,device=";
-    lines += deviceId;
-    lines += ",phase=A value=";
-    lines += String(lastData.voltageA, 2);
-    lines += "\n";
-
-    lines += "voltage,device=";
-    lines += deviceId;
-    lines += ",phase=B value=";
-    lines += String(lastData.voltageB, 2);
-    lines += "\n";
-
-    lines += "voltage,device=";
-    lines += deviceId;
-    lines += ",phase=C value=";
-    lines += String(lastData.voltageC, 2);
-    lines += "\n";
-
-    // Межфазные напряжения
-    lines += "line_voltage,device=";
-    lines += deviceId;
-    lines += ",phases=AB value=";
-    lines += String(lastData.voltageAB, 2);
-    lines += "\n";
-
-    lines += "line_voltage,device=";
-    lines += deviceId;
-    lines += ",phases=BC value=";
-    lines += String(lastData.voltageBC, 2);
-    lines += "\n";
-
-    lines += "line_voltage,device=";
-    lines += deviceId;
-    lines += ",phases=CA value=";
-    lines += String(lastData.voltageCA, 2);
-    lines += "\n";
-
-    // Частота и перекос
-    lines += "frequency,device=";
-    lines += deviceId;
-    lines += " value=";
-    lines += String(lastData.frequencyAvg, 2);
-    lines += "\n";
-
-    lines += "unbalance,device=";
-    lines += deviceId;
-    lines += " value=";
-    lines += String(lastData.unbalance, 2);
-
-    return lines;
+    if (fieldMask & DEADBAND_FIELD_ENERGY) {
+        out.begin("energy");
+        out.tag("device", deviceId);
+        out.field("import_kwh", lastData.energyImportKwh, 3);
+        out.field("export_kwh", lastData.energyExportKwh, 3);
+        out.end();
+    }
+
+    return out.overflowed() ? 0 : out.length();
 }
 
-bool PowerAnalyzer::hasProblems() const {
+bool PowerAnalyzerBase::hasProblems() const {
     return lastData.lowVoltage || 
            lastData.highVoltage || 
            lastData.highUnbalance || 
            lastData.frequencyDeviation;
 }
 
-String PowerAnalyzer::getProblemsDescription() const {
-    if (!hasProblems()) {
-        return "OK";
-    }
-    
-    String desc = "";
-    
-    if (lastData.lowVoltage) {
-        desc += "LOW_V ";
-    }
-    if (lastData.highVoltage) {
-        desc += "HIGH_V ";
-    }
-    if (lastData.highUnbalance) {
-        desc += "UNBALANCE ";
-    }
-    if (lastData.frequencyDeviation) {
-        desc += "FREQ_DEV ";
-    }
-    
-    desc.trim();
-    return desc;
+const char* PowerAnalyzerBase::getProblemsDescription() const {
+    // Все 16 комбинаций PROBLEM_* заранее, чтобы не собирать строку при каждом выводе
+    static const char* const descriptions[16] = {
+        "OK",
+        "LOW_V",
+        "HIGH_V",
+        "LOW_V HIGH_V",
+        "UNBALANCE",
+        "LOW_V UNBALANCE",
+        "HIGH_V UNBALANCE",
+        "LOW_V HIGH_V UNBALANCE",
+        "FREQ_DEV",
+        "LOW_V FREQ_DEV",
+        "HIGH_V FREQ_DEV",
+        "LOW_V HIGH_V FREQ_DEV",
+        "UNBALANCE FREQ_DEV",
+        "LOW_V UNBALANCE FREQ_DEV",
+        "HIGH_V UNBALANCE FREQ_DEV",
+        "LOW_V HIGH_V UNBALANCE FREQ_DEV",
+    };
+    
+    return descriptions[TelemetryCodec::problemFlags(lastData) & 0x0F];
 }
@@ -1,53 +1,315 @@
 #ifndef POWER_ANALYZER_H
 #define POWER_ANALYZER_H
 
-#include <Arduino.h>
+#include <stddef.h>
+#include <string.h>
 #include "VoltageSensor.h"
+#include "PowerData.h"
+#include "SeqLock.h"
+#include "DeadbandFilter.h"
+#include "CaptureFormat.h"
+#include "Topology.h"
+#include "Harmonics.h"
+#include "Decimator.h"
 #include "config.h"
+#include "hal/Hal.h"
+
+// Буфер Line Protocol для 8 точек напряжения, 4 строк power и energy (DEVICE_ID до 32 символов)
+#define POWER_LINE_PROTOCOL_SIZE 2048
 
 /**
- * Структура для хранения результатов измерений трёхфазной сети
+ * Счётчики событий (переходов флага проблемы из false в true)
  */
-struct PowerData {
-    // Фазные напряжения (RMS)
-    float voltageA;
-    float voltageB;
-    float voltageC;
+struct PowerEventCounters {
+    uint32_t lowVoltage;
+    uint32_t highVoltage;
+    uint32_t highUnbalance;
+    uint32_t frequencyDeviation;
+};
+
+/**
+ * Согласованный снимок для чтения из других задач (HTTP /metrics)
+ */
+struct PowerSnapshot {
+    PowerData data;
+    PowerEventCounters events;
+    uint32_t measurementCount;
+};
+
+/**
+ * Общая часть анализатора, не зависящая от числа каналов и схемы:
+ * последние данные, события, снимок для других задач, сериализация.
+ * MetricsExporter и ScopeServer работают через неё с любым вариантом платы.
+ */
+class PowerAnalyzerBase {
+public:
+    /**
+     * Получить последние измеренные данные без нового измерения
+     */
+    PowerData getLastData() const;
     
-    // Частоты фаз (Гц)
-    float frequencyA;
-    float frequencyB;
-    float frequencyC;
-    float frequencyAvg;
+    /**
+     * Получить счётчики событий с момента запуска
+     */
+    PowerEventCounters getEventCounters() const;
     
-    // Межфазные (линейные) напряжения
-    float voltageAB;  // Uab = Ua * √3 (для симметричной нагрузки)
-    float voltageBC;
-    float voltageCA;
+    /**
+     * Счётчики энергии (кВт·ч) в полной точности
+     */
+    double getEnergyImportKwh() const;
+    double getEnergyExportKwh() const;
     
-    // Перекос фаз (%)
-    float unbalance;
+    /**
+     * Продолжить счётчики с сохранённых значений (PersistentStats, до первого измерения)
+     */
+    void restoreCounters(const PowerEventCounters& events, double importKwh, double exportKwh);
     
-    // Среднее напряжение
-    float voltageAvg;
+    /**
+     * Прочитать снимок последних данных без блокировок.
+     * Безопасно вызывать из другой задачи: измерения никогда не ждут читателя.
+     * @param out Куда скопировать снимок
+     * @return false если снимок не удалось прочитать согласованно
+     */
+    bool readSnapshot(PowerSnapshot& out) const;
     
-    // Метка времени
-    unsigned long timestamp;
+    /**
+     * Форматировать данные в InfluxDB Line Protocol
+     * @param buffer Буфер (POWER_LINE_PROTOCOL_SIZE)
+     * @param size Размер буфера
+     * @param deviceId Идентификатор устройства
+     * @param fieldMask Какие величины включить (DEADBAND_FIELD_*, по умолчанию все,
+     *                  которые есть в схеме подключения)
+     * @return Длина записанного, 0 если не поместилось
+     */
+    size_t writeLineProtocol(char* buffer, size_t size, const char* deviceId,
+                             uint16_t fieldMask = DEADBAND_ALL_FIELDS) const;
+    
+    /**
+     * Проверить наличие проблем в последнем измерении
+     * @return true если есть проблемы
+     */
+    bool hasProblems() const;
+    
+    /**
+     * Получить текстовое описание проблем ("OK" или "LOW_V UNBALANCE" и т.п.)
+     */
+    const char* getProblemsDescription() const;
+
+protected:
+    /**
+     * @param topologyFields Величины PowerData, которые есть в схеме (TopologyTraits::FIELDS)
+     * @param powerPhases Фаз с трансформатором тока (0 — мощность и энергия не считаются)
+     */
+    PowerAnalyzerBase(uint16_t topologyFields, int powerPhases);
+    
+    /**
+     * Проверить пороги по первым phases фазным напряжениям, посчитать события
+     * и энергию и опубликовать результат как последние данные и снимок
+     */
+    void publish(PowerData& data, int phases);
+
+private:
+    uint16_t topologyFields;
+    int powerPhases;
+    PowerData lastData;
+    PowerEventCounters eventCounters;
+    uint32_t measurementCount;
+    SeqLock<PowerSnapshot> snapshot;
+    
+    // Счётчики энергии копятся в double: float теряет ватт-часы уже после ~10 МВт·ч
+    double energyImportKwh;
+    double energyExportKwh;
+    uint32_t lastEnergyMs;
+    bool energyPrimed;
+    
+    /**
+     * Проинтегрировать суммарную активную мощность за время с прошлого измерения
+     * и записать счётчики в data
+     */
+    void integrateEnergy(PowerData& data);
+    
+    /**
+     * Посчитать новые события по переходам флагов проблем
+     */
+    void countEvents(const PowerData& previous, const PowerData& current);
+    
+    /**
+     * Проверить пороговые значения и установить флаги проблем
+     */
+    void checkThresholds(PowerData& data, int phases);
+};
+
+/**
+ * Накопители одного окна для всех каналов блока
+ */
+template <int Channels>
+struct WindowAccumulator {
+    float offset[Channels];
+    uint64_t sumSquares[Channels];
+    int zeroCrossings[Channels];
+    int firstCrossing[Channels];
+    int lastCrossing[Channels];
+    bool above[Channels];
+};
+
+/**
+ * Ядро канала Ch для одного кадра. Рекурсия по Ch раскрывается при компиляции:
+ * кадр из Channels отсчётов обрабатывается прямым кодом, без цикла и без
+ * выбора канала во время выполнения.
+ */
+template <int Ch, int Channels>
+struct ChannelKernel {
+    /**
+     * Оцифровать кадр: по отсчёту с каждого вывода
+     */
+    __attribute__((always_inline)) static inline void acquire(const int* pins, int16_t* frame) {
+        frame[Ch] = Hal::adcRead(pins[Ch]);
+        ChannelKernel<Ch + 1, Channels>::acquire(pins, frame);
+    }
+    
+    /**
+     * Сумма квадратов и переходы через ноль (та же арифметика, что в VoltageSensor::analyze)
+     */
+    __attribute__((always_inline)) static inline void accumulate(const int16_t* frame, int index,
+                                                                 WindowAccumulator<Channels>& acc) {
+        int raw = frame[Ch];
+        float value = raw - acc.offset[Ch];
+        acc.sumSquares[Ch] += (uint64_t)(value * value);
+        
+        bool isAbove = raw > acc.offset[Ch];
+        if (isAbove != acc.above[Ch]) {
+            if (acc.zeroCrossings[Ch] == 0) {
+                acc.firstCrossing[Ch] = index;
+            }
+            acc.lastCrossing[Ch] = index;
+            acc.zeroCrossings[Ch]++;
+            acc.above[Ch] = isAbove;
+        }
+        ChannelKernel<Ch + 1, Channels>::accumulate(frame, index, acc);
+    }
+};
+
+template <int Channels>
+struct ChannelKernel<Channels, Channels> {
+    static inline void acquire(const int* pins, int16_t* frame) {
+    }
+    
+    static inline void accumulate(const int16_t* frame, int index, WindowAccumulator<Channels>& acc) {
+    }
+};
+
+/**
+ * Накопители мощности для пар напряжение–ток одного окна
+ */
+template <int Pairs>
+struct PowerAccumulator {
+    int shift[Pairs];           // Целая часть сдвига напряжения к току (кадры)
+    int quarterShift[Pairs];    // То же минус четверть периода — для реактивной мощности
+    float fraction[Pairs];      // Дробная часть сдвига 0..1 (линейная интерполяция)
+    float sumActive[Pairs];     // Σ u(i + s) · i(i)
+    float sumReactive[Pairs];   // Σ u(i + s - T/4) · i(i)
+};
+
+/**
+ * Ядро пары K (напряжение K, ток VoltageChannels + K) для одного кадра.
+ * Ток берётся из текущего кадра, напряжение — из того же блока со сдвигом
+ * на компенсацию фазы ТТ; сдвиг за край окна переносится на соседний период
+ * (окно — целое число периодов номинальной частоты).
+ */
+template <int K, int Pairs, int Channels, int VoltageChannels, int PeriodFrames>
+struct PairKernel {
+    __attribute__((always_inline)) static inline float voltageAt(const int16_t* samples, int index, int frames,
+                                                                 float fraction, float offset) {
+        if (index < 0) {
+            index += PeriodFrames;
+        } else if (index + 1 >= frames) {
+            index -= PeriodFrames;
+        }
+        float a = samples[index * Channels + K];
+        float b = samples[(index + 1) * Channels + K];
+        return a + fraction * (b - a) - offset;
+    }
     
-    // Флаги проблем
-    bool lowVoltage;
-    bool highVoltage;
-    bool highUnbalance;
-    bool frequencyDeviation;
+    template <typename Accumulator>
+    __attribute__((always_inline)) static inline void accumulate(const int16_t* samples, int index, int frames,
+                                                                 const float* offset, Accumulator& acc) {
+        float current = samples[index * Channels + VoltageChannels + K] - offset[VoltageChannels + K];
+        acc.sumActive[K] += current * voltageAt(samples, index + acc.shift[K], frames, acc.fraction[K], offset[K]);
+        acc.sumReactive[K] += current * voltageAt(samples, index + acc.quarterShift[K], frames, acc.fraction[K],
+                                                  offset[K]);
+        PairKernel<K + 1, Pairs, Channels, VoltageChannels, PeriodFrames>::accumulate(samples, index, frames,
+                                                                                     offset, acc);
+    }
+};
+
+template <int Pairs, int Channels, int VoltageChannels, int PeriodFrames>
+struct PairKernel<Pairs, Pairs, Channels, VoltageChannels, PeriodFrames> {
+    template <typename Accumulator>
+    static inline void accumulate(const int16_t* samples, int index, int frames,
+                                  const float* offset, Accumulator& acc) {
+    }
 };
 
 /**
- * Класс для анализа трёхфазной сети
- * Собирает данные с 3 датчиков ZMPT101B и вычисляет производные величины
+ * Анализатор сети для платы с Channels каналами АЦП
+ *
+ * Первые TopologyTraits<T>::VOLTAGE_CHANNELS каналов — напряжения по схеме T,
+ * остальные — токи ТТ, парами к напряжениям по порядку: ток 1 к напряжению 1
+ * и т.д. В том же проходе по кадрам, что и суммы квадратов, копятся U·I
+ * (активная мощность) и U·I со сдвигом на четверть периода (реактивная). Размер блока, шаг
+ * оцифровки и границы циклов выводятся из параметров при компиляции,
+ * поэтому в горячем цикле нет ветвлений по конфигурации платы.
+ *
+ * @tparam T Схема подключения
+ * @tparam Channels Каналов в кадре (1..CAPTURE_MAX_CHANNELS)
+ * @tparam SampleRateHz Кадров в секунду (целое число микросекунд на кадр)
  */
-class PowerAnalyzer {
+template <Topology T, int Channels, uint32_t SampleRateHz>
+class BasicPowerAnalyzer : public PowerAnalyzerBase {
 public:
-    PowerAnalyzer();
+    typedef TopologyTraits<T> Traits;
+    
+    static constexpr int CHANNELS = Channels;
+    static constexpr int VOLTAGE_CHANNELS = Traits::VOLTAGE_CHANNELS;
+    static constexpr int PHASES = Traits::PHASES;
+    static constexpr uint32_t SAMPLE_RATE_HZ = SampleRateHz;
+    static constexpr uint32_t INTERVAL_US = 1000000 / SampleRateHz;
+    static constexpr int FRAMES_PER_BLOCK = (int)(SampleRateHz * MEASUREMENT_WINDOW_MS / 1000);
+    static constexpr int BLOCK_SAMPLES = FRAMES_PER_BLOCK * Channels;
+    static constexpr int CURRENT_CHANNELS = Channels - Traits::VOLTAGE_CHANNELS;
+    static constexpr int PERIOD_FRAMES = (int)(SampleRateHz / NOMINAL_FREQUENCY + 0.5f);
+    static constexpr int QUARTER_FRAMES = (int)(SampleRateHz / (4 * NOMINAL_FREQUENCY) + 0.5f);
+    static constexpr uint32_t SUBFRAME_US = INTERVAL_US / OVERSAMPLE_FACTOR;
+    static constexpr int FRONT_END_TAPS = OVERSAMPLE_FACTOR > 1 ? OVERSAMPLE_FACTOR * OVERSAMPLE_TAPS_PER_PHASE - 1 : 1;
+    // Первый подкадр окна кадра — раньше самого кадра на половину фильтра
+    static constexpr uint32_t FRONT_END_LEAD_US = (FRONT_END_TAPS - 1) / 2 * SUBFRAME_US;
+    // Кадр — отсчёты АЦП × FRAME_SCALE: с передискретизацией шум фильтра не
+    // округляется до целых отсчётов. Смещения и В/отсчёт — в единицах кадра
+    static constexpr int FRAME_FRACTION_BITS = OVERSAMPLE_FACTOR > 1 ? OVERSAMPLE_FRACTION_BITS : 0;
+    static constexpr int FRAME_SCALE = 1 << FRAME_FRACTION_BITS;
+    
+    static_assert(Channels >= Traits::VOLTAGE_CHANNELS, "Not enough channels for the topology");
+    static_assert(CURRENT_CHANNELS <= Traits::VOLTAGE_CHANNELS, "Each current channel needs a voltage channel");
+    static_assert(CURRENT_CHANNELS == 0 || Traits::PHASE_POWER,
+                  "Current channels need phase-to-neutral voltages (not supported for delta)");
+    static_assert(CURRENT_CHANNELS == 0 || FRAMES_PER_BLOCK >= 2 * PERIOD_FRAMES,
+                  "Power needs a window of at least two nominal periods");
+    static_assert(Channels <= CAPTURE_MAX_CHANNELS, "Too many channels for the capture format");
+    static_assert(SampleRateHz > 0 && 1000000 % SampleRateHz == 0,
+                  "Sample interval must be a whole number of microseconds");
+    static_assert(FRAMES_PER_BLOCK > 0 && FRAMES_PER_BLOCK <= 65535,
+                  "Window must fit the capture block frame counter");
+    static_assert(OVERSAMPLE_FACTOR >= 1 && INTERVAL_US % OVERSAMPLE_FACTOR == 0,
+                  "Sub-frame interval must be a whole number of microseconds");
+    static_assert(FRONT_END_TAPS <= DECIMATOR_MAX_TAPS, "Oversampling filter too long");
+    static_assert(FRAME_FRACTION_BITS >= 0 && (ADC_MAX_VALUE << FRAME_FRACTION_BITS) <= INT16_MAX,
+                  "Frames with OVERSAMPLE_FRACTION_BITS do not fit int16");
+    
+    /**
+     * @param pins Вывод АЦП каждого канала
+     * @param calibration Коэффициент (В/отсчёт) каждого канала
+     */
+    BasicPowerAnalyzer(const int (&pins)[Channels], const float (&calibration)[Channels]);
     
     /**
      * Инициализация анализатора и всех датчиков
@@ -56,55 +318,660 @@ public:
     
     /**
      * Калибровка смещения всех датчиков (вызывать при отсутствии напряжения или после прогрева)
+     *
+     * Один блок всех каналов сразу (FRAMES_PER_BLOCK * INTERVAL_US, 200 мс):
+     * смещение — среднее по целым периодам канала (между первым и последним
+     * переходом вверх), синусоида в нём сокращается и при частоте не на
+     * номинале. Раньше каждый датчик усреднял 5000 отсчётов по очереди
+     * (~0.25 с на канал, дважды при запуске) по нецелому числу периодов.
      */
     void calibrate();
     
     /**
      * Выполнить измерение и анализ всех параметров
+     * Оцифровывает все каналы одновременно (чередуя их) в блок и вызывает analyze()
      * @return Структура с результатами измерений
      */
     PowerData measure();
     
     /**
-     * Получить последние измеренные данные без нового измерения
+     * Начало расписания для acquire(), чтобы первый кадр пришёлся на «сейчас».
+     * С передискретизацией (OVERSAMPLE_FACTOR > 1) кадр — середина окна
+     * подкадров, и первые подкадры снимаются на FRONT_END_LEAD_US раньше
+     * startUs: расписание начинается на столько же позже.
      */
-    PowerData getLastData() const;
+    static uint32_t startNowUs();
     
     /**
-     * Форматировать данные в InfluxDB Line Protocol
-     * @param deviceId Идентификатор устройства
-     * @return Строка в формате Line Protocol
+     * Оцифровать блок из FRAMES_PER_BLOCK кадров по расписанию: кадр i — в
+     * startUs + i·INTERVAL_US. Блоки с расписаниями встык идут без разрыва (DeepCapture).
+     * С передискретизацией кадр i — выход фильтра-дециматора с центром в
+     * startUs + i·INTERVAL_US (без задержки: фазы синхрофазоров не сдвигаются);
+     * блок встык продолжает историю фильтра, иначе она набирается заново.
+     * @param frames Куда писать кадры (BLOCK_SAMPLES отсчётов)
+     * @param maxLateUs Наибольшее опоздание кадра, мкс
+     * @return Кадров, снятых позже расписания больше чем на SAMPLE_JITTER_THRESHOLD_US
      */
-    String toLineProtocol(const char* deviceId) const;
+    uint32_t acquire(int16_t* frames, uint32_t startUs, uint32_t& maxLateUs) const;
     
     /**
-     * Проверить наличие проблем в последнем измерении
-     * @return true если есть проблемы
+     * То же, но каждый кадр сразу после оцифровки отдаётся onFrame(frame, index)
+     * в ожидании следующего: потоковая обработка (синхрофазоры) идёт в темпе
+     * оцифровки, не дожидаясь конца блока. onFrame должен укладываться в
+     * INTERVAL_US, иначе следующие кадры опоздают.
      */
-    bool hasProblems() const;
+    template <typename OnFrame>
+    uint32_t acquire(int16_t* frames, uint32_t startUs, uint32_t& maxLateUs, OnFrame onFrame) const;
+    
+    /**
+     * Проанализировать готовый блок отсчётов (с устройства или из файла захвата)
+     * @param samples Кадры по CHANNELS отсчётов ADC
+     * @param frames Количество кадров (шаг — INTERVAL_US)
+     * @param timestampMs Метка времени результата (millis())
+     * @return Структура с результатами измерений
+     */
+    PowerData analyze(const int16_t* samples, int frames, uint32_t timestampMs);
+    
+    /**
+     * Скопировать чужой блок (задачи оцифровки) в свой: getLastBlock() отдаёт копию,
+     * которую задача уже не перепишет, пока её читают
+     * @param samples Кадры по CHANNELS отсчётов
+     * @param frames Количество кадров (до FRAMES_PER_BLOCK)
+     */
+    void loadBlock(const int16_t* samples, int frames);
+    
+    /**
+     * Последний оцифрованный блок (для записи захвата)
+     */
+    const int16_t* getLastBlock() const;
+    
+    /**
+     * Количество кадров в последнем блоке
+     */
+    int getLastBlockFrames() const;
+    
+    /**
+     * Кадры последнего блока, снятые позже расписания больше чем на
+     * SAMPLE_JITTER_THRESHOLD_US, и наибольшее опоздание (мкс)
+     */
+    uint32_t getLateSamples() const;
+    uint32_t getMaxSampleLateUs() const;
+    
+    /**
+     * Фильтр передискретизации (getTaps() == 0 — выключен)
+     */
+    const Decimator& getFrontEnd() const;
+    
+    /**
+     * Доля времени последнего блока с передискретизацией на чтение АЦП и на
+     * фильтр, % ядра оцифровки (остальное — ожидание расписания и onFrame)
+     */
+    float getFrontEndReadLoad() const;
+    float getFrontEndFilterLoad() const;
+    
+    /**
+     * СКО шума АЦП на входе фильтра за последний блок, отсчёты: по вторым
+     * разностям подкадров канала 0 (σ² = E[d²] / 6, синус сети на частоте
+     * подкадров почти не даёт вклада). Для getFrontEnd().getEnobGain()
+     */
+    float getFrontEndInputNoise() const;
+    
+    /**
+     * RMS канала за последнее окно (в единицах калибровки: В для напряжений, А для токов)
+     */
+    float getChannelRms(int channel) const;
+    
+    /**
+     * THD канала напряжения в блоке, % (частота и смещение — с последнего analyze())
+     * @param samples Блок, который только что прошёл analyze()
+     */
+    float harmonicDistortion(const int16_t* samples, int frames, int channel) const;
     
     /**
-     * Получить текстовое описание проблем
+     * Компенсация фазы трансформатора тока пары
+     * @param pair Номер тока (0..CURRENT_CHANNELS-1)
+     * @param degrees На сколько градусов номинальной частоты отсчёт тока опережает
+     *                отсчёт напряжения (CT_PHASE_CORRECTION_*), не больше ±90
      */
-    String getProblemsDescription() const;
+    void setPhaseCorrection(int pair, float degrees);
+    float getPhaseCorrection(int pair) const;
+    
+    /**
+     * Смещение и калибровка канала
+     */
+    float getOffset(int channel) const;
+    float getSensitivity(int channel) const;
+    
+    /**
+     * Задать смещение и калибровку канала (воспроизведение захвата с другого устройства)
+     */
+    void setChannel(int channel, float offset, float sensitivity);
+    
+    /**
+     * Заполнить заголовок файла захвата: схема, каналы, частота, смещения, калибровка
+     * @param unixTime Время начала записи (0 если не синхронизировано)
+     */
+    void describeCapture(CaptureHeader& header, const char* deviceId, uint32_t unixTime) const;
+    
+    /**
+     * Подходит ли файл захвата этому варианту (схема, каналы, частота)
+     */
+    static bool matches(const CaptureHeader& header);
 
 private:
-    VoltageSensor sensorA;
-    VoltageSensor sensorB;
-    VoltageSensor sensorC;
+    // Массивы пар не бывают нулевой длины
+    static constexpr int PAIR_SLOTS = CURRENT_CHANNELS > 0 ? CURRENT_CHANNELS : 1;
     
-    PowerData lastData;
+    int pins[Channels];
+    VoltageSensor sensors[Channels];
+    float phaseCorrection[PAIR_SLOTS];
+    
+    int16_t block[BLOCK_SAMPLES];
+    int blockFrames;
+    uint32_t lateSamples;
+    uint32_t maxSampleLateUs;
+    
+    // Состояние входного тракта переходит из блока в блок, а acquire() — const
+    mutable Decimator frontEnd;
+    mutable uint32_t frontEndNextUs;
+    mutable bool frontEndPrimed;
+    mutable float frontEndReadLoad;
+    mutable float frontEndFilterLoad;
+    mutable float frontEndInputNoise;
+    mutable int16_t frontEndPrevious[2];
     
     /**
-     * Вычислить коэффициент перекоса фаз по ГОСТ 13109-97
-     * K2U = (Umax - Umin) / Uavg * 100%
+     * acquire() с передискретизацией
      */
-    float calculateUnbalance(float ua, float ub, float uc);
+    template <typename OnFrame>
+    uint32_t acquireOversampled(int16_t* frames, uint32_t startUs, uint32_t& maxLateUs, OnFrame onFrame) const;
     
     /**
-     * Проверить пороговые значения и установить флаги проблем
+     * Мощности, коэффициенты мощности и токи фаз из накопителей окна
      */
-    void checkThresholds(PowerData& data);
+    void derivePower(const PowerAccumulator<PAIR_SLOTS>& power, int frames, PowerData& data) const;
 };
 
+template <Topology T, int Channels, uint32_t SampleRateHz>
+BasicPowerAnalyzer<T, Channels, SampleRateHz>::BasicPowerAnalyzer(const int (&pins)[Channels],
+                                                                  const float (&calibration)[Channels])
+    : PowerAnalyzerBase(Traits::FIELDS | (CURRENT_CHANNELS > 0 ? DEADBAND_FIELD_POWER | DEADBAND_FIELD_ENERGY : 0),
+                        CURRENT_CHANNELS),
+      blockFrames(0),
+      lateSamples(0),
+      maxSampleLateUs(0),
+      frontEndNextUs(0),
+      frontEndPrimed(false),
+      frontEndReadLoad(0.0f),
+      frontEndFilterLoad(0.0f),
+      frontEndInputNoise(0.0f),
+      frontEndPrevious{ADC_OFFSET, ADC_OFFSET} {
+    if (OVERSAMPLE_FACTOR > 1) {
+        frontEnd.begin(Channels, OVERSAMPLE_FACTOR, OVERSAMPLE_TAPS_PER_PHASE, FRAME_FRACTION_BITS);
+    }
+    for (int ch = 0; ch < Channels; ch++) {
+        this->pins[ch] = pins[ch];
+        // Калибровка в config.h — В на отсчёт АЦП
+        sensors[ch] = VoltageSensor(pins[ch], calibration[ch] / FRAME_SCALE);
+        if (ch >= Traits::VOLTAGE_CHANNELS) {
+            sensors[ch].setNoiseFloor(CT_NOISE_FLOOR_A);
+        }
+    }
+    
+    const float corrections[3] = {CT_PHASE_CORRECTION_A, CT_PHASE_CORRECTION_B, CT_PHASE_CORRECTION_C};
+    for (int k = 0; k < PAIR_SLOTS; k++) {
+        setPhaseCorrection(k, corrections[k]);
+    }
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+void BasicPowerAnalyzer<T, Channels, SampleRateHz>::begin() {
+    Hal::log("[PowerAnalyzer] Initializing %d channels (%d voltage, %d current)...\n", Channels,
+             Traits::VOLTAGE_CHANNELS, CURRENT_CHANNELS);
+    
+    // Смещения — из общего блока в calibrate(), не по датчику
+    for (int ch = 0; ch < Channels; ch++) {
+        sensors[ch].begin(false);
+    }
+    
+    if (OVERSAMPLE_FACTOR > 1 && frontEnd.getTaps() == 0) {
+        Hal::log("[PowerAnalyzer] ERROR: No memory for the oversampling filter, one read per frame\n");
+    } else if (OVERSAMPLE_FACTOR > 1) {
+        const float inputRateHz = (float)SampleRateHz * OVERSAMPLE_FACTOR;
+        Hal::log("[PowerAnalyzer] Oversampling x%d (%lu us sub-frames): %d taps, noise x%.3f, frames 1/%d count, "
+                 "%.2f dB at 2 kHz, %.1f dB at %lu Hz\n",
+                 OVERSAMPLE_FACTOR, (unsigned long)SUBFRAME_US, frontEnd.getTaps(), frontEnd.getNoiseGain(),
+                 FRAME_SCALE, frontEnd.responseDb(2000.0f, inputRateHz),
+                 frontEnd.responseDb(SampleRateHz - 2000.0f, inputRateHz), (unsigned long)(SampleRateHz - 2000));
+    }
+    
+    // Небольшая задержка для стабилизации ADC
+    Hal::delayMs(100);
+    
+    // Автокалибровка смещения
+    calibrate();
+    
+    if (OVERSAMPLE_FACTOR > 1 && frontEnd.getTaps() > 0) {
+        Hal::log("[PowerAnalyzer] ADC noise %.2f counts, +%.2f bits after the filter\n", frontEndInputNoise,
+                 frontEnd.getEnobGain(frontEndInputNoise));
+    }
+    
+    Hal::log("[PowerAnalyzer] Initialization complete\n");
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+void BasicPowerAnalyzer<T, Channels, SampleRateHz>::calibrate() {
+    Hal::log("[PowerAnalyzer] Calibrating offset...\n");
+    
+    // Блок не отдаётся в измерение: blockFrames не меняется
+    uint32_t maxLateUs;
+    acquire(block, startNowUs(), maxLateUs);
+    
+    // Шум у перехода не должен давать лишних периодов
+    const int hysteresis = 16 * FRAME_SCALE;
+    const int frames = FRAMES_PER_BLOCK / PERIOD_FRAMES * PERIOD_FRAMES;
+    for (int ch = 0; ch < Channels; ch++) {
+        int64_t sum = 0;
+        for (int i = 0; i < frames; i++) {
+            sum += block[i * Channels + ch];
+        }
+        float offset = (float)sum / frames;
+        
+        // Сеть не точно на номинале: остаток периода сдвигает среднее (при
+        // 49.7 Гц — на единицы отсчётов). Уточняем по целым фактическим
+        // периодам: от первого перехода вверх через грубое смещение до последнего
+        int first = -1;
+        int last = -1;
+        bool below = false;
+        for (int i = 0; i < FRAMES_PER_BLOCK; i++) {
+            int16_t value = block[i * Channels + ch];
+            if (value < offset - hysteresis) {
+                below = true;
+            } else if (below && value >= offset) {
+                first = first < 0 ? i : first;
+                last = i;
+                below = false;
+            }
+        }
+        // Без сигнала (ток без нагрузки) переходов нет — грубое среднее и так точное
+        if (first >= 0 && last - first >= PERIOD_FRAMES / 2) {
+            sum = 0;
+            for (int i = first; i < last; i++) {
+                sum += block[i * Channels + ch];
+            }
+            offset = (float)sum / (last - first);
+        }
+        sensors[ch].setOffset(offset);
+        Hal::log("[PowerAnalyzer] Channel %d offset %.1f\n", ch, offset);
+    }
+    
+    Hal::log("[PowerAnalyzer] Calibration complete\n");
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+PowerData BasicPowerAnalyzer<T, Channels, SampleRateHz>::measure() {
+    // Оцифровываем все каналы чередуя их: все видят одно и то же окно,
+    // и блок можно записать и воспроизвести как есть
+    lateSamples = acquire(block, startNowUs(), maxSampleLateUs);
+    blockFrames = FRAMES_PER_BLOCK;
+    
+    return analyze(block, blockFrames, Hal::millis());
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+uint32_t BasicPowerAnalyzer<T, Channels, SampleRateHz>::startNowUs() {
+    return Hal::micros() + FRONT_END_LEAD_US;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+uint32_t BasicPowerAnalyzer<T, Channels, SampleRateHz>::acquire(int16_t* frames, uint32_t startUs,
+                                                                uint32_t& maxLateUs) const {
+    return acquire(frames, startUs, maxLateUs, [](const int16_t*, int) {});
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+template <typename OnFrame>
+uint32_t BasicPowerAnalyzer<T, Channels, SampleRateHz>::acquire(int16_t* frames, uint32_t startUs,
+                                                                uint32_t& maxLateUs, OnFrame onFrame) const {
+    if (OVERSAMPLE_FACTOR > 1 && frontEnd.getTaps() > 0) {
+        return acquireOversampled(frames, startUs, maxLateUs, onFrame);
+    }
+    
+    uint32_t late = 0;
+    maxLateUs = 0;
+    
+    for (int i = 0; i < FRAMES_PER_BLOCK; i++) {
+        ChannelKernel<0, Channels>::acquire(pins, &frames[i * Channels]);
+        // Фильтр не выделился: кадры всё равно в единицах кадра
+        for (int ch = 0; FRAME_FRACTION_BITS > 0 && ch < Channels; ch++) {
+            frames[i * Channels + ch] = (int16_t)(frames[i * Channels + ch] << FRAME_FRACTION_BITS);
+        }
+        onFrame(&frames[i * Channels], i);
+        
+        // Опоздание следующего кадра (прерывания WiFi, вытеснение задачей с большим приоритетом)
+        uint32_t lateUs = Hal::waitUntilUs(startUs, (uint32_t)(i + 1) * INTERVAL_US);
+        if (lateUs > SAMPLE_JITTER_THRESHOLD_US) {
+            late++;
+        }
+        if (lateUs > maxLateUs) {
+            maxLateUs = lateUs;
+        }
+    }
+    return late;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+template <typename OnFrame>
+uint32_t BasicPowerAnalyzer<T, Channels, SampleRateHz>::acquireOversampled(int16_t* frames, uint32_t startUs,
+                                                                           uint32_t& maxLateUs,
+                                                                           OnFrame onFrame) const {
+    // Подкадр k — в baseUs + k·SUBFRAME_US; кадру i нужны подкадры i·R .. i·R + taps - 1
+    const int taps = frontEnd.getTaps();
+    const uint32_t baseUs = startUs - FRONT_END_LEAD_US;
+    int16_t subframe[Channels];
+    uint32_t readCycles = 0;
+    uint32_t filterCycles = 0;
+    uint32_t late = 0;
+    maxLateUs = 0;
+    // Вторые разности подкадров канала 0 — оценка шума на входе
+    int32_t before = frontEndPrevious[0];
+    int32_t previous = frontEndPrevious[1];
+    uint64_t noiseSquares = 0;
+    
+    // Блок встык: первые taps - R подкадров уже в истории с прошлого блока
+    if (!frontEndPrimed || startUs != frontEndNextUs) {
+        for (int k = 0; k < taps - OVERSAMPLE_FACTOR; k++) {
+            Hal::waitUntilUs(baseUs, (uint32_t)k * SUBFRAME_US);
+            ChannelKernel<0, Channels>::acquire(pins, subframe);
+            frontEnd.shift(subframe);
+            before = previous;
+            previous = subframe[0];
+        }
+    }
+    
+    uint32_t k = taps - OVERSAMPLE_FACTOR;
+    for (int i = 0; i < FRAMES_PER_BLOCK; i++) {
+        uint32_t lateUs = 0;
+        for (int r = 0; r < OVERSAMPLE_FACTOR; r++, k++) {
+            uint32_t subLateUs = Hal::waitUntilUs(baseUs, k * SUBFRAME_US);
+            if (subLateUs > lateUs) {
+                lateUs = subLateUs;
+            }
+            uint32_t readStart = Hal::cycleCount();
+            ChannelKernel<0, Channels>::acquire(pins, subframe);
+            frontEnd.shift(subframe);
+            int32_t difference = subframe[0] - 2 * previous + before;
+            noiseSquares += (uint32_t)(difference * difference);
+            before = previous;
+            previous = subframe[0];
+            readCycles += Hal::cycleCount() - readStart;
+        }
+        uint32_t filterStart = Hal::cycleCount();
+        frontEnd.output(&frames[i * Channels]);
+        filterCycles += Hal::cycleCount() - filterStart;
+        onFrame(&frames[i * Channels], i);
+        
+        // Опоздание кадра — наибольшее из его подкадров
+        if (lateUs > SAMPLE_JITTER_THRESHOLD_US) {
+            late++;
+        }
+        if (lateUs > maxLateUs) {
+            maxLateUs = lateUs;
+        }
+    }
+    
+    frontEndNextUs = startUs + FRAMES_PER_BLOCK * INTERVAL_US;
+    frontEndPrimed = true;
+    const float blockCycles = (float)Hal::cyclesPerUs() * FRAMES_PER_BLOCK * INTERVAL_US;
+    frontEndReadLoad = readCycles * 100.0f / blockCycles;
+    frontEndFilterLoad = filterCycles * 100.0f / blockCycles;
+    frontEndInputNoise = sqrtf((float)noiseSquares / (6.0f * FRAMES_PER_BLOCK * OVERSAMPLE_FACTOR));
+    frontEndPrevious[0] = (int16_t)before;
+    frontEndPrevious[1] = (int16_t)previous;
+    return late;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+PowerData BasicPowerAnalyzer<T, Channels, SampleRateHz>::analyze(const int16_t* samples, int frames,
+                                                                 uint32_t timestampMs) {
+    // Один проход по кадрам для всех каналов сразу: блок читается из памяти один раз
+    WindowAccumulator<Channels> acc;
+    for (int ch = 0; ch < Channels; ch++) {
+        acc.offset[ch] = sensors[ch].getOffset();
+        acc.sumSquares[ch] = 0;
+        acc.zeroCrossings[ch] = 0;
+        acc.firstCrossing[ch] = 0;
+        acc.lastCrossing[ch] = 0;
+        acc.above[ch] = frames > 0 && samples[ch] > acc.offset[ch];
+    }
+    
+    // Пары напряжение–ток: сдвиг напряжения в кадрах из компенсации фазы ТТ
+    PowerAccumulator<PAIR_SLOTS> power;
+    for (int k = 0; k < PAIR_SLOTS; k++) {
+        float shift = phaseCorrection[k] / 360.0f * PERIOD_FRAMES;
+        power.shift[k] = (int)floorf(shift);
+        power.quarterShift[k] = power.shift[k] - QUARTER_FRAMES;
+        power.fraction[k] = shift - power.shift[k];
+        power.sumActive[k] = 0.0f;
+        power.sumReactive[k] = 0.0f;
+    }
+    
+    // Короткий блок (воспроизведение обрезанного захвата) — без мощности
+    if (CURRENT_CHANNELS > 0 && frames >= 2 * PERIOD_FRAMES) {
+        for (int i = 0; i < frames; i++) {
+            ChannelKernel<0, Channels>::accumulate(samples + i * Channels, i, acc);
+            PairKernel<0, CURRENT_CHANNELS, Channels, Traits::VOLTAGE_CHANNELS, PERIOD_FRAMES>::accumulate(
+                samples, i, frames, acc.offset, power);
+        }
+    } else {
+        for (int i = 0; i < frames; i++) {
+            ChannelKernel<0, Channels>::accumulate(samples + i * Channels, i, acc);
+        }
+    }
+    
+    float rms[Channels];
+    for (int ch = 0; ch < Channels; ch++) {
+        rms[ch] = sensors[ch].finishWindow(acc.sumSquares[ch], frames, acc.zeroCrossings[ch],
+                                           acc.firstCrossing[ch], acc.lastCrossing[ch], INTERVAL_US);
+    }
+    
+    PowerData data;
+    memset(&data, 0, sizeof(data));
+    
+    // Фазные и линейные напряжения, перекос — по схеме подключения
+    Traits::derive(rms, data);
+    
+    // Частоты каналов напряжения и средняя
+    float frequencies[3] = {0.0f, 0.0f, 0.0f};
+    float frequencySum = 0.0f;
+    for (int ch = 0; ch < Traits::VOLTAGE_CHANNELS; ch++) {
+        frequencies[ch] = sensors[ch].getFrequency();
+        frequencySum += frequencies[ch];
+    }
+    data.frequencyA = frequencies[0];
+    data.frequencyB = frequencies[1];
+    data.frequencyC = frequencies[2];
+    data.frequencyAvg = frequencySum / Traits::VOLTAGE_CHANNELS;
+    
+    if (CURRENT_CHANNELS > 0) {
+        derivePower(power, frames >= 2 * PERIOD_FRAMES ? frames : 0, data);
+    }
+    
+    // Метка времени
+    data.timestamp = timestampMs;
+    
+    publish(data, Traits::PHASES);
+    return data;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+void BasicPowerAnalyzer<T, Channels, SampleRateHz>::loadBlock(const int16_t* samples, int frames) {
+    blockFrames = frames < FRAMES_PER_BLOCK ? frames : FRAMES_PER_BLOCK;
+    memcpy(block, samples, (size_t)blockFrames * Channels * sizeof(int16_t));
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+const int16_t* BasicPowerAnalyzer<T, Channels, SampleRateHz>::getLastBlock() const {
+    return block;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+int BasicPowerAnalyzer<T, Channels, SampleRateHz>::getLastBlockFrames() const {
+    return blockFrames;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+uint32_t BasicPowerAnalyzer<T, Channels, SampleRateHz>::getLateSamples() const {
+    return lateSamples;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+const Decimator& BasicPowerAnalyzer<T, Channels, SampleRateHz>::getFrontEnd() const {
+    return frontEnd;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+float BasicPowerAnalyzer<T, Channels, SampleRateHz>::getFrontEndReadLoad() const {
+    return frontEndReadLoad;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+float BasicPowerAnalyzer<T, Channels, SampleRateHz>::getFrontEndFilterLoad() const {
+    return frontEndFilterLoad;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+float BasicPowerAnalyzer<T, Channels, SampleRateHz>::getFrontEndInputNoise() const {
+    return frontEndInputNoise;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+uint32_t BasicPowerAnalyzer<T, Channels, SampleRateHz>::getMaxSampleLateUs() const {
+    return maxSampleLateUs;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+float BasicPowerAnalyzer<T, Channels, SampleRateHz>::getChannelRms(int channel) const {
+    return sensors[channel].getLastRMS();
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+float BasicPowerAnalyzer<T, Channels, SampleRateHz>::harmonicDistortion(const int16_t* samples, int frames,
+                                                                        int channel) const {
+    return Harmonics::thdPercent(samples + channel, frames, Channels, sensors[channel].getOffset(),
+                                 sensors[channel].getFrequency(), SampleRateHz);
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+void BasicPowerAnalyzer<T, Channels, SampleRateHz>::setPhaseCorrection(int pair, float degrees) {
+    // Больше четверти периода сдвиг уходит за соседний период при переносе через край окна
+    if (degrees > 90.0f) {
+        degrees = 90.0f;
+    } else if (degrees < -90.0f) {
+        degrees = -90.0f;
+    }
+    phaseCorrection[pair] = degrees;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+float BasicPowerAnalyzer<T, Channels, SampleRateHz>::getPhaseCorrection(int pair) const {
+    return phaseCorrection[pair];
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+void BasicPowerAnalyzer<T, Channels, SampleRateHz>::derivePower(const PowerAccumulator<PAIR_SLOTS>& power,
+                                                                int frames, PowerData& data) const {
+    float* const current[3] = {&data.currentA, &data.currentB, &data.currentC};
+    float* const active[3] = {&data.activePowerA, &data.activePowerB, &data.activePowerC};
+    float* const reactive[3] = {&data.reactivePowerA, &data.reactivePowerB, &data.reactivePowerC};
+    float* const apparent[3] = {&data.apparentPowerA, &data.apparentPowerB, &data.apparentPowerC};
+    float* const factor[3] = {&data.powerFactorA, &data.powerFactorB, &data.powerFactorC};
+    float* const angle[3] = {&data.phaseAngleA, &data.phaseAngleB, &data.phaseAngleC};
+    
+    for (int k = 0; k < CURRENT_CHANNELS; k++) {
+        const VoltageSensor& voltage = sensors[k];
+        const VoltageSensor& amps = sensors[Traits::VOLTAGE_CHANNELS + k];
+        
+        // Ниже порога шума тока или напряжения нагрузки нет: мощности 0
+        float p = 0.0f;
+        float q = 0.0f;
+        float s = 0.0f;
+        if (frames > 0 && voltage.getLastRMS() > 0.0f && amps.getLastRMS() > 0.0f) {
+            float scale = voltage.getSensitivity() * amps.getSensitivity() / frames;
+            p = power.sumActive[k] * scale;
+            q = power.sumReactive[k] * scale;
+            s = voltage.getLastRMS() * amps.getLastRMS();
+        }
+        
+        *current[k] = amps.getLastRMS();
+        *active[k] = p;
+        *reactive[k] = q;
+        *apparent[k] = s;
+        *factor[k] = s > 0.0f ? fmaxf(-1.0f, fminf(1.0f, p / s)) : 0.0f;
+        *angle[k] = s > 0.0f ? atan2f(q, p) * 180.0f / (float)M_PI : 0.0f;
+        
+        data.activePower += p;
+        data.reactivePower += q;
+        data.apparentPower += s;
+    }
+    
+    // Суммарный PF — через арифметическую полную мощность (сумму S фаз)
+    data.powerFactor = data.apparentPower > 0.0f
+                       ? fmaxf(-1.0f, fminf(1.0f, data.activePower / data.apparentPower))
+                       : 0.0f;
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+float BasicPowerAnalyzer<T, Channels, SampleRateHz>::getOffset(int channel) const {
+    return sensors[channel].getOffset();
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+float BasicPowerAnalyzer<T, Channels, SampleRateHz>::getSensitivity(int channel) const {
+    return sensors[channel].getSensitivity();
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+void BasicPowerAnalyzer<T, Channels, SampleRateHz>::setChannel(int channel, float offset, float sensitivity) {
+    sensors[channel].setOffset(offset);
+    sensors[channel].setSensitivity(sensitivity);
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+void BasicPowerAnalyzer<T, Channels, SampleRateHz>::describeCapture(CaptureHeader& header, const char* deviceId,
+                                                                    uint32_t unixTime) const {
+    memset(&header, 0, sizeof(header));
+    header.magic = CAPTURE_MAGIC;
+    header.version = CAPTURE_VERSION;
+    header.headerSize = sizeof(CaptureHeader);
+    header.sampleRateHz = SampleRateHz;
+    header.channelCount = Channels;
+    header.adcBits = ADC_RESOLUTION + FRAME_FRACTION_BITS;
+    header.framesPerBlock = FRAMES_PER_BLOCK;
+    header.topology = (uint8_t)T;
+    header.voltageChannels = Traits::VOLTAGE_CHANNELS;
+    for (int ch = 0; ch < Channels; ch++) {
+        header.channelMap[ch] = ch < Traits::VOLTAGE_CHANNELS ? Traits::channelName(ch) : 'I';
+        header.channelPins[ch] = pins[ch];
+        header.offsets[ch] = getOffset(ch);
+        header.calibration[ch] = getSensitivity(ch);
+    }
+    header.startUnixTime = unixTime;
+    memcpy(header.deviceId, deviceId, strnlen(deviceId, CAPTURE_DEVICE_ID_LEN));
+}
+
+template <Topology T, int Channels, uint32_t SampleRateHz>
+bool BasicPowerAnalyzer<T, Channels, SampleRateHz>::matches(const CaptureHeader& header) {
+    return header.topology == (uint8_t)T &&
+           header.channelCount == Channels &&
+           header.voltageChannels == Traits::VOLTAGE_CHANNELS &&
+           header.sampleRateHz == SampleRateHz;
+}
+
+/**
+ * Анализатор этой платы (config.h: ANALYZER_*)
+ */
+typedef BasicPowerAnalyzer<static_cast<Topology>(ANALYZER_TOPOLOGY), ANALYZER_CHANNELS, ANALYZER_SAMPLE_RATE_HZ>
+    PowerAnalyzer;
+
 #endif // POWER_ANALYZER_H
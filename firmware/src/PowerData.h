@@ -0,0 +1,78 @@
+#ifndef POWER_DATA_H
+#define POWER_DATA_H
+
+#include <stdint.h>
+
+/**
+ * Структура для хранения результатов измерений трёхфазной сети
+ */
+struct PowerData {
+    // Фазные напряжения (RMS)
+    float voltageA;
+    float voltageB;
+    float voltageC;
+    
+    // Частоты фаз (Гц)
+    float frequencyA;
+    float frequencyB;
+    float frequencyC;
+    float frequencyAvg;
+    
+    // Межфазные (линейные) напряжения
+    float voltageAB;  // Uab = Ua * √3 (для симметричной нагрузки)
+    float voltageBC;
+    float voltageCA;
+    
+    // Перекос фаз (%)
+    float unbalance;
+    
+    // Среднее напряжение
+    float voltageAvg;
+    
+    // Токи фаз (RMS, А) — при трансформаторах тока, иначе 0
+    float currentA;
+    float currentB;
+    float currentC;
+    
+    // Мощности фаз: активная (Вт), реактивная (вар, > 0 — индуктивная нагрузка),
+    // полная (ВА) = U * I
+    float activePowerA;
+    float activePowerB;
+    float activePowerC;
+    float reactivePowerA;
+    float reactivePowerB;
+    float reactivePowerC;
+    float apparentPowerA;
+    float apparentPowerB;
+    float apparentPowerC;
+    
+    // Коэффициент мощности P / S (< 0 — отдача в сеть) и угол сдвига тока
+    // относительно напряжения atan2(Q, P) в градусах
+    float powerFactorA;
+    float powerFactorB;
+    float powerFactorC;
+    float phaseAngleA;
+    float phaseAngleB;
+    float phaseAngleC;
+    
+    // Суммарные по фазам
+    float activePower;
+    float reactivePower;
+    float apparentPower;
+    float powerFactor;
+    
+    // Счётчики энергии с запуска (кВт·ч): потреблено из сети и отдано в сеть
+    float energyImportKwh;
+    float energyExportKwh;
+    
+    // Метка времени
+    unsigned long timestamp;
+    
+    // Флаги проблем
+    bool lowVoltage;
+    bool highVoltage;
+    bool highUnbalance;
+    bool frequencyDeviation;
+};
+
+#endif // POWER_DATA_H
@@ -0,0 +1,144 @@
+#include "Profiler.h"
+#include <string.h>
+#include "LineProtocol.h"
+
+static const uint32_t bucketBoundsUs[PROFILE_BUCKET_COUNT - 1] = {
+    50, 100, 200, 500,
+    1000, 2000, 5000,
+    10000, 20000, 50000,
+    100000, 150000, 200000, 250000, 300000, 500000,
+    1000000, 2000000, 5000000
+};
+
+// Имена полей кумулятивных корзин (как le в Prometheus): le_200 — не дольше 200 мкс
+static const char* const bucketFields[PROFILE_BUCKET_COUNT] = {
+    "le_50", "le_100", "le_200", "le_500",
+    "le_1000", "le_2000", "le_5000",
+    "le_10000", "le_20000", "le_50000",
+    "le_100000", "le_150000", "le_200000", "le_250000", "le_300000", "le_500000",
+    "le_1000000", "le_2000000", "le_5000000", "le_inf"
+};
+
+static const char* const stageNames[PROFILE_STAGE_COUNT] = {
+    "measure",
+    "power_serialize",
+    "power_send",
+    "waveform_capture",
+    "waveform_serialize",
+    "waveform_send",
+    "compliance",
+    "cycle"
+};
+
+static StageHistogram stages[PROFILE_STAGE_COUNT];
+static LoopHealth health;
+
+void Profiler::record(ProfileStage stage, uint32_t cycles) {
+    uint32_t us = cycles / Hal::cyclesPerUs();
+    StageHistogram& h = stages[(int)stage];
+
+    int bucket = 0;
+    while (bucket < PROFILE_BUCKET_COUNT - 1 && us > bucketBoundsUs[bucket]) {
+        bucket++;
+    }
+    h.buckets[bucket]++;
+    h.count++;
+    h.sumUs += us;
+    if (us > h.maxUs) {
+        h.maxUs = us;
+    }
+}
+
+void Profiler::recordLoopLateness(uint32_t lateMs) {
+    if (lateMs > LOOP_OVERRUN_SLACK_MS) {
+        health.overruns++;
+    }
+    if (lateMs > health.maxLateMs) {
+        health.maxLateMs = lateMs;
+    }
+}
+
+void Profiler::recordSampling(uint32_t lateSamples, uint32_t maxLateUs) {
+    health.lateSamples += lateSamples;
+    if (maxLateUs > health.maxSampleLateUs) {
+        health.maxSampleLateUs = maxLateUs;
+    }
+}
+
+const StageHistogram& Profiler::getStage(ProfileStage stage) {
+    return stages[(int)stage];
+}
+
+const LoopHealth& Profiler::getHealth() {
+    return health;
+}
+
+uint32_t Profiler::percentileUs(const StageHistogram& histogram, float q) {
+    if (histogram.count == 0) {
+        return 0;
+    }
+    uint32_t rank = (uint32_t)(q * histogram.count + 0.5f);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    uint32_t cumulative = 0;
+    for (int i = 0; i < PROFILE_BUCKET_COUNT - 1; i++) {
+        cumulative += histogram.buckets[i];
+        if (cumulative >= rank) {
+            return bucketBoundsUs[i] < histogram.maxUs ? bucketBoundsUs[i] : histogram.maxUs;
+        }
+    }
+    return histogram.maxUs;
+}
+
+const char* Profiler::stageName(ProfileStage stage) {
+    return stageNames[(int)stage];
+}
+
+size_t Profiler::writeLineProtocol(char* buffer, size_t size, const char* deviceId) {
+    LineWriter out(buffer, size);
+
+    out.begin("device_stats");
+    out.tag("device", deviceId);
+    out.field("uptime_s", Hal::millis() / 1000);
+    out.field("cpu_mhz", Hal::cyclesPerUs());
+    out.field("free_heap", Hal::freeHeap());
+    out.field("min_free_heap", Hal::minFreeHeap());
+    out.field("loop_overruns", health.overruns);
+    out.field("loop_late_max_ms", health.maxLateMs);
+    out.field("late_samples", health.lateSamples);
+    out.field("sample_late_max_us", health.maxSampleLateUs);
+    out.end();
+
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        const StageHistogram& h = stages[s];
+        if (h.count == 0) {
+            continue;
+        }
+        out.begin("device_stats");
+        out.tag("device", deviceId);
+        out.tag("stage", stageNames[s]);
+        out.field("count", h.count);
+        out.field("mean_us", (uint32_t)(h.sumUs / h.count));
+        out.field("p50_us", percentileUs(h, 0.50f));
+        out.field("p90_us", percentileUs(h, 0.90f));
+        out.field("p99_us", percentileUs(h, 0.99f));
+        out.field("max_us", h.maxUs);
+
+        uint32_t cumulative = 0;
+        for (int i = 0; i < PROFILE_BUCKET_COUNT; i++) {
+            cumulative += h.buckets[i];
+            out.field(bucketFields[i], cumulative);
+        }
+        out.end();
+    }
+
+    return out.overflowed() ? 0 : out.length();
+}
+
+void Profiler::resetWindow() {
+    memset(stages, 0, sizeof(stages));
+    health.maxLateMs = 0;
+    health.maxSampleLateUs = 0;
+}
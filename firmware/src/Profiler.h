@@ -0,0 +1,137 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "hal/Hal.h"
+
+/**
+ * Стадии цикла, время которых собирается в гистограммы
+ */
+enum class ProfileStage : uint8_t {
+    MEASURE,                // PowerAnalyzer::measure()
+    POWER_SERIALIZE,        // PowerAnalyzer::writeLineProtocol()
+    POWER_SEND,             // Отправка PowerData выбранным транспортом
+    WAVEFORM_CAPTURE,       // Oscilloscope::tap()
+    WAVEFORM_SERIALIZE,     // Oscilloscope::writeLineProtocol()
+    WAVEFORM_SEND,          // Отправка осциллограммы
+    COMPLIANCE,             // THD фаз и ComplianceStats::update()
+    CYCLE,                  // Весь цикл измерения в loop()
+    COUNT
+};
+
+#define PROFILE_STAGE_COUNT ((int)ProfileStage::COUNT)
+
+// Корзины: 1-2-5 по декадам плюс 150/250/300 мс вокруг 200-мс окна измерения;
+// последняя корзина — всё, что больше 5 с
+#define PROFILE_BUCKET_COUNT 20
+
+/**
+ * Гистограмма задержек одной стадии (мкс)
+ */
+struct StageHistogram {
+    uint32_t count;
+    uint64_t sumUs;
+    uint32_t maxUs;
+    uint32_t buckets[PROFILE_BUCKET_COUNT];
+};
+
+/**
+ * Состояние цикла: опоздания и куча
+ */
+struct LoopHealth {
+    uint32_t overruns;          // Измерений, начатых позже LOOP_OVERRUN_SLACK_MS (с запуска)
+    uint32_t maxLateMs;         // Наибольшее опоздание начала измерения (за интервал)
+    uint32_t lateSamples;       // Кадров АЦП позже SAMPLE_JITTER_THRESHOLD_US (с запуска)
+    uint32_t maxSampleLateUs;   // Наибольшее опоздание кадра (за интервал)
+};
+
+/**
+ * Профилирование горячего пути
+ *
+ * Время стадий снимается счётчиком тактов (Hal::cycleCount) и раскладывается
+ * по фиксированным корзинам — без кучи и без деления на каждой записи, кроме
+ * перевода тактов в микросекунды. Все записи идут из задачи loop(), поэтому
+ * блокировок нет. Гистограммы и максимумы покрывают один интервал
+ * DEVICE_STATS_INTERVAL_MS и обнуляются после публикации.
+ */
+class Profiler {
+public:
+    /**
+     * Записать длительность стадии
+     * @param cycles Разность Hal::cycleCount()
+     */
+    static void record(ProfileStage stage, uint32_t cycles);
+
+    /**
+     * Записать опоздание начала измерения относительно SEND_INTERVAL_MS
+     */
+    static void recordLoopLateness(uint32_t lateMs);
+
+    /**
+     * Записать джиттер оцифровки последнего блока (PowerAnalyzer::getLateSamples)
+     */
+    static void recordSampling(uint32_t lateSamples, uint32_t maxLateUs);
+
+    static const StageHistogram& getStage(ProfileStage stage);
+    static const LoopHealth& getHealth();
+
+    /**
+     * Оценка перцентиля по корзинам (верхняя граница корзины, не больше максимума)
+     * @param q Доля 0..1
+     */
+    static uint32_t percentileUs(const StageHistogram& histogram, float q);
+
+    /**
+     * Имя стадии для тега stage
+     */
+    static const char* stageName(ProfileStage stage);
+
+    /**
+     * Сформировать измерение device_stats: строка состояния и по строке
+     * на каждую стадию, у которой были записи за интервал
+     * @return Длина записанного, 0 если не поместилось
+     */
+    static size_t writeLineProtocol(char* buffer, size_t size, const char* deviceId);
+
+    /**
+     * Обнулить гистограммы и максимумы интервала (счётчики с запуска остаются)
+     */
+    static void resetWindow();
+};
+
+// Буфер device_stats: строка состояния и 7 стадий по ~450 байт
+#define DEVICE_STATS_LINE_PROTOCOL_SIZE 4096
+
+/**
+ * Замер области видимости: от конструктора до деструктора
+ */
+class ScopedTimer {
+public:
+    explicit ScopedTimer(ProfileStage stage)
+        : stage(stage),
+          start(Hal::cycleCount()) {
+    }
+
+    ~ScopedTimer() {
+        Profiler::record(stage, Hal::cycleCount() - start);
+    }
+
+private:
+    ProfileStage stage;
+    uint32_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// PROFILE_SCOPE(ProfileStage::MEASURE); — замер до конца блока.
+// При PROFILING_ENABLED 0 не остаётся ни вызова, ни чтения счётчика.
+#if PROFILING_ENABLED
+#define PROFILE_SCOPE(stage) ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(stage)
+#else
+#define PROFILE_SCOPE(stage) do {} while (0)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,187 @@
+#include "ScopeServer.h"
+
+ScopeServer::ScopeServer()
+    : ws(SCOPE_WS_PATH),
+      clientsMux(portMUX_INITIALIZER_UNLOCKED),
+      frameSeq(0),
+      framesSent(0),
+      framesDropped(0),
+      lastCleanup(0) {
+    memset(clients, 0, sizeof(clients));
+}
+
+void ScopeServer::begin(AsyncWebServer& server) {
+    ws.onEvent([this](AsyncWebSocket* server, AsyncWebSocketClient* client,
+                      AwsEventType type, void* arg, uint8_t* data, size_t len) {
+        onEvent(client, type);
+    });
+    server.addHandler(&ws);
+
+    Serial.printf("[ScopeServer] WebSocket at %s, %d ms/frame, %d points/phase\n",
+                  SCOPE_WS_PATH, SCOPE_FRAME_INTERVAL_MS, SCOPE_FRAME_MAX_POINTS);
+}
+
+void ScopeServer::onEvent(AsyncWebSocketClient* client, AwsEventType type) {
+    if (type == WS_EVT_CONNECT) {
+        bool accepted = false;
+
+        portENTER_CRITICAL(&clientsMux);
+        for (int i = 0; i < SCOPE_MAX_CLIENTS; i++) {
+            if (!clients[i].used) {
+                clients[i].id = client->id();
+                clients[i].used = true;
+                clients[i].sent = 0;
+                clients[i].dropped = 0;
+                accepted = true;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&clientsMux);
+
+        if (!accepted) {
+            // Все слоты заняты — не даём новому зрителю тормозить остальных
+            Serial.printf("[ScopeServer] Client #%lu rejected: too many viewers\n", (unsigned long)client->id());
+            client->close();
+            return;
+        }
+        Serial.printf("[ScopeServer] Client #%lu connected\n", (unsigned long)client->id());
+    } else if (type == WS_EVT_DISCONNECT) {
+        ClientSlot slot = {};
+
+        portENTER_CRITICAL(&clientsMux);
+        for (int i = 0; i < SCOPE_MAX_CLIENTS; i++) {
+            if (clients[i].used && clients[i].id == client->id()) {
+                slot = clients[i];
+                clients[i].used = false;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&clientsMux);
+
+        Serial.printf("[ScopeServer] Client #%lu disconnected (sent=%lu, dropped=%lu)\n",
+                      (unsigned long)client->id(), slot.sent, slot.dropped);
+    }
+}
+
+void ScopeServer::loop() {
+    unsigned long now = millis();
+    if (now - lastCleanup >= 1000) {
+        lastCleanup = now;
+        ws.cleanupClients(SCOPE_MAX_CLIENTS);
+    }
+}
+
+bool ScopeServer::hasClients() const {
+    for (int i = 0; i < SCOPE_MAX_CLIENTS; i++) {
+        if (clients[i].used) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t ScopeServer::buildFrame(const WaveformData& waveform, const PowerData& data,
+                               float offsetA, float offsetB, float offsetC) {
+    ScopeFrameHeader* header = reinterpret_cast<ScopeFrameHeader*>(frameBuffer);
+
+    // Децимация: берём каждый SCOPE_DECIMATION-й отсчёт
+    uint16_t points = (waveform.sampleCount + SCOPE_DECIMATION - 1) / SCOPE_DECIMATION;
+    if (points > SCOPE_FRAME_MAX_POINTS) {
+        points = SCOPE_FRAME_MAX_POINTS;
+    }
+
+    int16_t* outA = reinterpret_cast<int16_t*>(frameBuffer + sizeof(ScopeFrameHeader));
+    int16_t* outB = outA + points;
+    int16_t* outC = outB + points;
+
+    for (uint16_t p = 0; p < points; p++) {
+        uint32_t i = (uint32_t)p * SCOPE_DECIMATION;
+        outA[p] = (int16_t)lroundf(waveform.phaseA[i] - offsetA);
+        outB[p] = (int16_t)lroundf(waveform.phaseB[i] - offsetB);
+        outC[p] = (int16_t)lroundf(waveform.phaseC[i] - offsetC);
+    }
+
+    header->magic = SCOPE_FRAME_MAGIC;
+    header->version = SCOPE_FRAME_VERSION;
+    header->flags = (data.lowVoltage ? 0x01 : 0) |
+                    (data.highVoltage ? 0x02 : 0) |
+                    (data.highUnbalance ? 0x04 : 0) |
+                    (data.frequencyDeviation ? 0x08 : 0);
+    header->seq = frameSeq++;
+    header->captureTime = waveform.captureTime;
+    header->pointCount = points;
+    header->pointIntervalUs = WAVEFORM_INTERVAL_US * SCOPE_DECIMATION;
+    header->voltsPerCount[0] = waveform.voltsPerCount[0];
+    header->voltsPerCount[1] = waveform.voltsPerCount[1];
+    header->voltsPerCount[2] = waveform.voltsPerCount[2];
+
+    header->voltageA = data.voltageA;
+    header->voltageB = data.voltageB;
+    header->voltageC = data.voltageC;
+    header->voltageAB = data.voltageAB;
+    header->voltageBC = data.voltageBC;
+    header->voltageCA = data.voltageCA;
+    header->voltageAvg = data.voltageAvg;
+    header->frequencyAvg = data.frequencyAvg;
+    header->unbalance = data.unbalance;
+
+    return sizeof(ScopeFrameHeader) + 3 * points * sizeof(int16_t);
+}
+
+void ScopeServer::publish(const WaveformData& waveform, const PowerData& data,
+                          float offsetA, float offsetB, float offsetC) {
+    // Снимок списка клиентов: события WebSocket приходят из другой задачи
+    uint32_t ids[SCOPE_MAX_CLIENTS];
+    int count = 0;
+
+    portENTER_CRITICAL(&clientsMux);
+    for (int i = 0; i < SCOPE_MAX_CLIENTS; i++) {
+        if (clients[i].used) {
+            ids[count++] = clients[i].id;
+        }
+    }
+    portEXIT_CRITICAL(&clientsMux);
+
+    if (count == 0) {
+        return;
+    }
+
+    size_t frameSize = buildFrame(waveform, data, offsetA, offsetB, offsetC);
+
+    for (int i = 0; i < count; i++) {
+        AsyncWebSocketClient* client = ws.client(ids[i]);
+        if (client == nullptr) {
+            continue;
+        }
+
+        // Backpressure: медленный клиент теряет кадр, а не задерживает измерения
+        bool dropped = client->queueIsFull();
+        if (dropped) {
+            framesDropped++;
+        } else {
+            client->binary(frameBuffer, frameSize);
+            framesSent++;
+        }
+
+        portENTER_CRITICAL(&clientsMux);
+        for (int j = 0; j < SCOPE_MAX_CLIENTS; j++) {
+            if (clients[j].used && clients[j].id == ids[i]) {
+                if (dropped) {
+                    clients[j].dropped++;
+                } else {
+                    clients[j].sent++;
+                }
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&clientsMux);
+    }
+}
+
+unsigned long ScopeServer::getFramesSent() const {
+    return framesSent;
+}
+
+unsigned long ScopeServer::getFramesDropped() const {
+    return framesDropped;
+}
@@ -0,0 +1,121 @@
+#ifndef SCOPE_SERVER_H
+#define SCOPE_SERVER_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "PowerAnalyzer.h"
+#include "Oscilloscope.h"
+
+#define SCOPE_FRAME_MAGIC 0x5053    // "SP" (little-endian)
+#define SCOPE_FRAME_VERSION 1
+#define SCOPE_FRAME_MAX_POINTS ((WAVEFORM_SAMPLES + SCOPE_DECIMATION - 1) / SCOPE_DECIMATION)
+
+/**
+ * Заголовок бинарного WebSocket-кадра (little-endian, без выравнивания).
+ * За заголовком следуют pointCount отсчётов int16 фазы A, затем B, затем C.
+ * Отсчёты уже центрированы (ADC - offset), в вольты переводятся через voltsPerCount.
+ */
+struct __attribute__((packed)) ScopeFrameHeader {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t flags;              // бит 0 LOW_V, 1 HIGH_V, 2 UNBALANCE, 3 FREQ_DEV
+    uint32_t seq;               // Сквозной номер кадра (пропуски = отброшенные кадры)
+    uint32_t captureTime;       // millis() момента захвата waveform
+    uint16_t pointCount;        // Точек на фазу после децимации
+    uint16_t pointIntervalUs;   // Интервал между точками после децимации
+    float voltsPerCount[3];     // Калибровка A, B, C
+
+    // Последние результаты PowerAnalyzer
+    float voltageA;
+    float voltageB;
+    float voltageC;
+    float voltageAB;
+    float voltageBC;
+    float voltageCA;
+    float voltageAvg;
+    float frequencyAvg;
+    float unbalance;
+};
+
+// Смещения полей зашиты в data/index.html
+static_assert(sizeof(ScopeFrameHeader) == 64, "ScopeFrameHeader layout changed");
+
+/**
+ * Живой осциллограф через WebSocket
+ * Рассылает децимированные осциллограммы трёх фаз и последние PowerData
+ * всем подключённым клиентам. Медленные клиенты пропускают кадры
+ * (очередь клиента заполнена → кадр отбрасывается), измерения не блокируются.
+ */
+class ScopeServer {
+public:
+    ScopeServer();
+
+    /**
+     * Зарегистрировать WebSocket-обработчик на веб-сервере
+     * @param server Общий асинхронный веб-сервер
+     */
+    void begin(AsyncWebServer& server);
+
+    /**
+     * Периодическое обслуживание (очистка отключившихся клиентов)
+     */
+    void loop();
+
+    /**
+     * Есть ли подключённые зрители (чтобы не захватывать waveform впустую)
+     */
+    bool hasClients() const;
+
+    /**
+     * Сформировать кадр и разослать его всем клиентам
+     * @param waveform Свежий захват осциллографа
+     * @param data Последние результаты измерений
+     * @param offsetA/B/C Смещения ADC для центрирования
+     */
+    void publish(const WaveformData& waveform, const PowerData& data,
+                 float offsetA, float offsetB, float offsetC);
+
+    /**
+     * Количество доставленных в очередь кадров (сумма по клиентам)
+     */
+    unsigned long getFramesSent() const;
+
+    /**
+     * Количество кадров, отброшенных из-за переполненной очереди клиента
+     */
+    unsigned long getFramesDropped() const;
+
+private:
+    struct ClientSlot {
+        uint32_t id;
+        bool used;
+        unsigned long sent;
+        unsigned long dropped;
+    };
+
+    AsyncWebSocket ws;
+    ClientSlot clients[SCOPE_MAX_CLIENTS];
+    portMUX_TYPE clientsMux;
+
+    uint32_t frameSeq;
+    unsigned long framesSent;
+    unsigned long framesDropped;
+    unsigned long lastCleanup;
+
+    uint8_t frameBuffer[sizeof(ScopeFrameHeader) + 3 * SCOPE_FRAME_MAX_POINTS * sizeof(int16_t)];
+
+    /**
+     * Обработчик событий WebSocket (выполняется в задаче async_tcp)
+     */
+    void onEvent(AsyncWebSocketClient* client, AwsEventType type);
+
+    /**
+     * Собрать кадр в frameBuffer
+     * @return Размер кадра в байтах
+     */
+    size_t buildFrame(const WaveformData& waveform, const PowerData& data,
+                      float offsetA, float offsetB, float offsetC);
+};
+
+#endif // SCOPE_SERVER_H
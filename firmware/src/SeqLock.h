@@ -0,0 +1,70 @@
+#ifndef SEQ_LOCK_H
+#define SEQ_LOCK_H
+
+#include <atomic>
+#include <string.h>
+
+/**
+ * Однописательный seqlock для обмена снимком данных между задачами.
+ *
+ * Писатель (цикл измерений) никогда не ждёт читателя: он лишь дважды
+ * увеличивает счётчик вокруг копирования. Читатель (HTTP-обработчик в задаче
+ * async_tcp) повторяет копирование, если попал на запись.
+ * T должен быть тривиально копируемым.
+ */
+template <typename T>
+class SeqLock {
+public:
+    SeqLock() : sequence(0) {
+        memset(&value, 0, sizeof(value));
+    }
+
+    /**
+     * Опубликовать новое значение (только из одной задачи-писателя)
+     */
+    void write(const T& newValue) {
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        memcpy(&value, &newValue, sizeof(T));
+
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     * Прочитать согласованный снимок
+     * @param out Куда скопировать значение
+     * @param maxAttempts Сколько раз повторять при гонке с писателем
+     * @return true если снимок согласован
+     */
+    bool read(T& out, int maxAttempts = 16) const {
+        for (int attempt = 0; attempt < maxAttempts; attempt++) {
+            uint32_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;  // Идёт запись
+            }
+
+            memcpy(&out, &value, sizeof(T));
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Номер версии (чётный, растёт с каждой публикацией)
+     */
+    uint32_t version() const {
+        return sequence.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<uint32_t> sequence;
+    T value;
+};
+
+#endif // SEQ_LOCK_H
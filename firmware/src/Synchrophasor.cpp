@@ -0,0 +1,526 @@
+#include "Synchrophasor.h"
+#include <math.h>
+#include <string.h>
+
+static const float PI_F = 3.14159265f;
+static const float TWO_PI = 6.28318531f;
+
+// Таблица поворотов, Q14
+static const float TWIDDLE_SCALE = 16384.0f;
+
+/**
+ * Угол в -π..π
+ */
+static float wrapAngle(float angle) {
+    angle = fmodf(angle + PI_F, TWO_PI);
+    if (angle < 0.0f) {
+        angle += TWO_PI;
+    }
+    return angle - PI_F;
+}
+
+/**
+ * Дробная часть числа периодов, 0..1
+ */
+static float cycleFraction(float cycles) {
+    return cycles - floorf(cycles);
+}
+
+PhasorEstimator::PhasorEstimator()
+    : channels(0),
+      sampleRateHz(0),
+      nominalFrequency(0.0f),
+      reportRate(0),
+      windowFrames(0),
+      windowCycles(0),
+      channelSkewUs(0.0f),
+      halfWindowUs(0),
+      halfWindowExactUs(0.0f) {
+    memset(calibration, 0, sizeof(calibration));
+    memset(cosTable, 0, sizeof(cosTable));
+    memset(sinTable, 0, sizeof(sinTable));
+    reset();
+}
+
+bool PhasorEstimator::isValidRate(uint32_t rate, float nominalFrequency) {
+    if (nominalFrequency == 50.0f) {
+        return rate == 10 || rate == 25 || rate == 50;
+    }
+    if (nominalFrequency == 60.0f) {
+        return rate == 10 || rate == 12 || rate == 15 || rate == 20 || rate == 30 || rate == 60;
+    }
+    return false;
+}
+
+bool PhasorEstimator::begin(int channels, uint32_t sampleRateHz, float nominalFrequency,
+                            const float* calibration, float channelSkewUs, uint32_t reportRate) {
+    if (channels < 1 || channels > SYNCHROPHASOR_MAX_CHANNELS || !isValidRate(reportRate, nominalFrequency)) {
+        return false;
+    }
+
+    // Наименьшее число периодов (от двух), укладывающееся в целое число кадров
+    uint32_t f0 = (uint32_t)nominalFrequency;
+    int cycles = 0;
+    for (int k = 2; k <= 8; k++) {
+        if (sampleRateHz * k % f0 == 0) {
+            cycles = k;
+            break;
+        }
+    }
+    if (cycles == 0 || sampleRateHz * cycles / f0 > SYNCHROPHASOR_MAX_WINDOW) {
+        return false;
+    }
+
+    this->channels = channels;
+    this->sampleRateHz = sampleRateHz;
+    this->nominalFrequency = nominalFrequency;
+    this->reportRate = reportRate;
+    this->channelSkewUs = channelSkewUs;
+    windowCycles = cycles;
+    windowFrames = (int)(sampleRateHz * cycles / f0);
+    for (int ch = 0; ch < channels; ch++) {
+        this->calibration[ch] = calibration[ch];
+    }
+    for (int i = 0; i < windowFrames; i++) {
+        double angle = 2.0 * M_PI * i / windowFrames;
+        cosTable[i] = (int16_t)lround(cos(angle) * TWIDDLE_SCALE);
+        sinTable[i] = (int16_t)lround(sin(angle) * TWIDDLE_SCALE);
+    }
+    halfWindowExactUs = (windowFrames - 1) * 500000.0f / sampleRateHz;
+    halfWindowUs = (uint32_t)halfWindowExactUs;
+    reset();
+    return true;
+}
+
+void PhasorEstimator::reset() {
+    memset(ring, 0, sizeof(ring));
+    memset(bins, 0, sizeof(bins));
+    memset(twiddle, 0, sizeof(twiddle));
+    memset(angleHistory, 0, sizeof(angleHistory));
+    memset(frequencyHistory, 0, sizeof(frequencyHistory));
+    memset(&frame, 0, sizeof(frame));
+    position = 0;
+    filled = 0;
+    reportSecond = 0;
+    reportIndex = 0;
+    nextReportUs = 0;
+    reportPrimed = false;
+    historyCount = 0;
+    frequencyCount = 0;
+}
+
+bool PhasorEstimator::push(const int16_t* samples, uint64_t utcUs) {
+    int16_t* oldest = &ring[position * SYNCHROPHASOR_MAX_CHANNELS];
+    for (int ch = 0; ch < channels; ch++) {
+        // x(n) - x(n-N): поворот для n и n-N один и тот же
+        int32_t diff = (int32_t)samples[ch] - oldest[ch];
+        oldest[ch] = samples[ch];
+        if (diff != 0) {
+            Bins& b = bins[ch];
+            for (int i = 0; i < 3; i++) {
+                b.re[i] += (int64_t)diff * cosTable[twiddle[i]];
+                b.im[i] -= (int64_t)diff * sinTable[twiddle[i]];
+            }
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        twiddle[i] += windowCycles - 1 + i;
+        if (twiddle[i] >= windowFrames) {
+            twiddle[i] -= windowFrames;
+        }
+    }
+    if (++position == windowFrames) {
+        position = 0;
+    }
+    if (filled < windowFrames) {
+        filled++;
+        if (filled < windowFrames) {
+            return false;
+        }
+    }
+
+    // Середина окна — (N-1)/2 кадров назад; в горячем пути только целые
+    uint64_t centerUs = utcUs - halfWindowUs;
+    if (!reportPrimed) {
+        primeReport(centerUs);
+    }
+    int64_t sinceReportUs = (int64_t)(centerUs - nextReportUs);
+    if (sinceReportUs < 0) {
+        // Часы отступили (синхронизация NTP): отчёты — с нового времени
+        if (sinceReportUs < -2000000) {
+            primeReport(centerUs);
+        }
+        return false;
+    }
+    if (sinceReportUs * reportRate >= 1000000) {
+        // Разрыв или скачок часов вперёд: пропущенные отчёты не выдаём
+        primeReport(centerUs + 1);
+        return false;
+    }
+
+    estimate(utcUs);
+    if (++reportIndex == reportRate) {
+        reportIndex = 0;
+        reportSecond++;
+    }
+    nextReportUs = reportTimeUs();
+    return true;
+}
+
+uint64_t PhasorEstimator::reportTimeUs() const {
+    return (uint64_t)reportSecond * 1000000 + (uint64_t)reportIndex * 1000000 / reportRate;
+}
+
+void PhasorEstimator::primeReport(uint64_t timeUs) {
+    reportSecond = (uint32_t)(timeUs / 1000000);
+    uint64_t fraction = timeUs % 1000000;
+    reportIndex = (uint32_t)((fraction * reportRate + 999999) / 1000000);
+    // Округление отчёта вниз до микросекунды может оставить его раньше timeUs
+    if (reportTimeUs() < timeUs) {
+        reportIndex++;
+    }
+    if (reportIndex >= reportRate) {
+        reportIndex = 0;
+        reportSecond++;
+    }
+    nextReportUs = reportTimeUs();
+    reportPrimed = true;
+}
+
+void PhasorEstimator::estimate(uint64_t utcUs) {
+    // Отчёт пятьдесят раз в секунду: float (на ESP32-S3 аппаратный), double — программный
+    const int n = windowFrames;
+    const float f0 = nominalFrequency;
+    const float f = frame.frequencyValid ? frame.frequency : f0;
+
+    // e^(jΔ·n0): сдвиг окна Ханна к его первому кадру
+    const float cn = cosTable[position] / TWIDDLE_SCALE;
+    const float sn = sinTable[position] / TWIDDLE_SCALE;
+
+    // Поворот бина k к середине окна и отклик окна Ханна при отклонении частоты
+    const float centerPhase = TWO_PI * cycleFraction(windowCycles * (position + (n - 1) * 0.5f) / n);
+    float delta = (f - f0) * n / sampleRateHz;
+    float response = 1.0f;
+    if (fabsf(delta) > 1e-6f && fabsf(delta) < 0.9f) {
+        response = sinf(PI_F * delta) / (PI_F * delta) / (1.0f - delta * delta);
+    }
+
+    // Середина окна от начала секунды UTC и от момента отчёта, мкс
+    const float centerFracUs = (float)(utcUs % 1000000) - halfWindowExactUs;
+    const float centerToReportUs = (float)(int64_t)(nextReportUs - utcUs) + halfWindowExactUs;
+
+    float re[SYNCHROPHASOR_MAX_CHANNELS] = {0.0f, 0.0f, 0.0f};
+    float im[SYNCHROPHASOR_MAX_CHANNELS] = {0.0f, 0.0f, 0.0f};
+    for (int ch = 0; ch < channels; ch++) {
+        const Bins& b = bins[ch];
+        const float re0 = (float)b.re[0], im0 = (float)b.im[0];
+        const float re2 = (float)b.re[2], im2 = (float)b.im[2];
+        float hannRe = 0.5f * b.re[1] - 0.25f * ((cn * re0 + sn * im0) + (cn * re2 - sn * im2));
+        float hannIm = 0.5f * b.im[1] - 0.25f * ((cn * im0 - sn * re0) + (cn * im2 + sn * re2));
+
+        float amplitude = 4.0f * sqrtf(hannRe * hannRe + hannIm * hannIm) / n / TWIDDLE_SCALE;
+        float magnitude = amplitude * (float)M_SQRT1_2 * calibration[ch] / response;
+
+        // Фаза сигнала в середине окна, затем угол относительно cos(2π·f0·t) в момент отчёта.
+        // Периоды f0 считаются от доли секунды: произведение в мкс float не удержит
+        float nominalCycles = (centerFracUs + ch * channelSkewUs) * 1e-6f * f0;
+        float angle = atan2f(hannIm, hannRe) + centerPhase - TWO_PI * cycleFraction(nominalCycles);
+        angle += TWO_PI * (f - f0) * centerToReportUs * 1e-6f;
+        angle = wrapAngle(angle);
+
+        frame.magnitude[ch] = magnitude;
+        frame.angle[ch] = angle;
+        re[ch] = magnitude * cosf(angle);
+        im[ch] = magnitude * sinf(angle);
+    }
+    frame.channels = channels;
+    frame.soc = reportSecond;
+    frame.fracUs = (uint32_t)(nextReportUs % 1000000);
+
+    // Прямая последовательность (Xa + a·Xb + a²·Xc) / 3, a = e^(j2π/3)
+    float positiveRe = re[0];
+    float positiveIm = im[0];
+    if (channels == 3) {
+        const float ar = -0.5f;
+        const float ai = 0.8660254f;
+        positiveRe = (re[0] + (ar * re[1] - ai * im[1]) + (ar * re[2] + ai * im[2])) / 3.0f;
+        positiveIm = (im[0] + (ar * im[1] + ai * re[1]) + (ar * im[2] - ai * re[2])) / 3.0f;
+    }
+    frame.positiveMagnitude = sqrtf(positiveRe * positiveRe + positiveIm * positiveIm);
+    frame.positiveAngle = atan2f(positiveIm, positiveRe);
+
+    // Частота — по приращению угла за ~100 мс, ROCOF — по приращению частоты
+    const int span = reportRate / 10 > 1 ? (int)(reportRate / 10) : 1;
+    memmove(angleHistory + 1, angleHistory, sizeof(angleHistory) - sizeof(angleHistory[0]));
+    angleHistory[0] = frame.positiveAngle;
+    if (historyCount < SYNCHROPHASOR_HISTORY) {
+        historyCount++;
+    }
+    if (historyCount > span) {
+        // Приращение за span отчётов бывает больше π (5 Гц за 100 мс): разворачиваем
+        // по соседним отчётам, где до неоднозначности далеко
+        float coarse = wrapAngle(angleHistory[0] - angleHistory[1]) * span;
+        float step = coarse + wrapAngle(angleHistory[0] - angleHistory[span] - coarse);
+        float frequency = f0 + step * reportRate / (TWO_PI * span);
+        memmove(frequencyHistory + 1, frequencyHistory, sizeof(frequencyHistory) - sizeof(frequencyHistory[0]));
+        frequencyHistory[0] = frequency;
+        if (frequencyCount < SYNCHROPHASOR_HISTORY) {
+            frequencyCount++;
+        }
+        frame.frequency = frequency;
+        frame.rocof = frequencyCount > span ? (frequencyHistory[0] - frequencyHistory[span]) * reportRate / span
+                                            : 0.0f;
+        frame.frequencyValid = true;
+    } else {
+        frame.frequency = f0;
+        frame.rocof = 0.0f;
+        frame.frequencyValid = false;
+    }
+}
+
+const SynchrophasorFrame& PhasorEstimator::getFrame() const {
+    return frame;
+}
+
+int PhasorEstimator::getWindowFrames() const {
+    return windowFrames;
+}
+
+// ============================================================================
+// SynchrophasorCodec
+// ============================================================================
+
+static uint8_t* put16(uint8_t* p, uint16_t value) {
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+    return p + 2;
+}
+
+static uint8_t* put32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+    return p + 4;
+}
+
+static uint8_t* putName(uint8_t* p, const char* name) {
+    size_t length = name != nullptr ? strlen(name) : 0;
+    for (size_t i = 0; i < C37_NAME_LEN; i++) {
+        p[i] = i < length ? (uint8_t)name[i] : ' ';
+    }
+    return p + C37_NAME_LEN;
+}
+
+static uint16_t get16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void getName(const uint8_t* p, char* name) {
+    memcpy(name, p, C37_NAME_LEN);
+    int length = C37_NAME_LEN;
+    while (length > 0 && (name[length - 1] == ' ' || name[length - 1] == 0)) {
+        length--;
+    }
+    name[length] = 0;
+}
+
+static int16_t toInt16(double value) {
+    long rounded = lround(value);
+    return (int16_t)(rounded > 32767 ? 32767 : (rounded < -32767 ? -32767 : rounded));
+}
+
+/**
+ * Проверить синхрослово, длину и CRC кадра
+ * @return Длина кадра, 0 если кадр не годится
+ */
+static size_t checkFrame(const uint8_t* data, size_t length, uint16_t sync) {
+    if (length < 16 || get16(data) != sync) {
+        return 0;
+    }
+    size_t frameSize = get16(data + 2);
+    if (frameSize < 16 || frameSize > length ||
+        SynchrophasorCodec::crc(data, frameSize - 2) != get16(data + frameSize - 2)) {
+        return 0;
+    }
+    return frameSize;
+}
+
+int SynchrophasorCodec::phasorCount(int channels) {
+    return channels == 3 ? 4 : channels;
+}
+
+uint16_t SynchrophasorCodec::crc(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint8_t SynchrophasorCodec::timeQuality(bool synced, uint32_t errorUs) {
+    if (!synced) {
+        return 0xF;
+    }
+    // 0x4 — 1 мкс, каждый следующий код в 10 раз грубее, 0xB — 10 с
+    uint8_t code = 0x4;
+    uint64_t limit = 1;
+    while (errorUs > limit && code < 0xB) {
+        code++;
+        limit *= 10;
+    }
+    return errorUs > limit ? 0xF : code;
+}
+
+uint16_t SynchrophasorCodec::status(bool synced, uint32_t errorUs, uint32_t unlockedS) {
+    if (!synced) {
+        return C37_STAT_NOT_SYNCED | (7 << 6) | (3 << 4);
+    }
+    // Биты 8-6: 2 — до 1 мкс, 3 — 10 мкс, 4 — 100 мкс, 5 — 1 мс, 6 — 10 мс, 7 — больше
+    uint16_t quality = 2;
+    uint32_t limit = 1;
+    while (errorUs > limit && quality < 7) {
+        quality++;
+        limit *= 10;
+    }
+    uint16_t unlocked = unlockedS < 10 ? 0 : (unlockedS < 100 ? 1 : (unlockedS < 1000 ? 2 : 3));
+    return (uint16_t)((quality << 6) | (unlocked << 4));
+}
+
+size_t SynchrophasorCodec::encodeData(const SynchrophasorFrame& frame, uint16_t idcode, uint8_t timeQuality,
+                                      uint16_t stat, float nominalFrequency, uint8_t* buffer, size_t size) {
+    const int phasors = phasorCount(frame.channels);
+    const size_t frameSize = 22 + 4 * phasors;
+    if (size < frameSize) {
+        return 0;
+    }
+    const double scale = 1e5 / C37_PHASOR_UNIT;
+
+    uint8_t* p = buffer;
+    p = put16(p, C37_SYNC_DATA);
+    p = put16(p, (uint16_t)frameSize);
+    p = put16(p, idcode);
+    p = put32(p, frame.soc);
+    p = put32(p, ((uint32_t)(timeQuality & 0x0F) << 24) | (frame.fracUs & 0xFFFFFF));
+    p = put16(p, stat);
+    for (int i = 0; i < phasors; i++) {
+        bool positive = i == frame.channels;
+        double magnitude = positive ? frame.positiveMagnitude : frame.magnitude[i];
+        double angle = positive ? frame.positiveAngle : frame.angle[i];
+        p = put16(p, (uint16_t)toInt16(magnitude * cos(angle) * scale));
+        p = put16(p, (uint16_t)toInt16(magnitude * sin(angle) * scale));
+    }
+    p = put16(p, (uint16_t)toInt16((frame.frequency - nominalFrequency) * 1000.0));
+    p = put16(p, (uint16_t)toInt16(frame.rocof * 100.0));
+    put16(p, crc(buffer, frameSize - 2));
+    return frameSize;
+}
+
+size_t SynchrophasorCodec::encodeConfig(uint16_t idcode, const char* station, int channels,
+                                        const char* const* names, float nominalFrequency, uint16_t rate,
+                                        uint16_t configCount, uint32_t soc, uint8_t* buffer, size_t size) {
+    const int phasors = phasorCount(channels);
+    const size_t frameSize = 54 + (C37_NAME_LEN + 4) * phasors;
+    if (size < frameSize) {
+        return 0;
+    }
+
+    uint8_t* p = buffer;
+    p = put16(p, C37_SYNC_CONFIG2);
+    p = put16(p, (uint16_t)frameSize);
+    p = put16(p, idcode);
+    p = put32(p, soc);
+    p = put32(p, 0);                        // FRACSEC
+    p = put32(p, C37_TIME_BASE);
+    p = put16(p, 1);                        // NUM_PMU
+    p = putName(p, station);
+    p = put16(p, idcode);
+    p = put16(p, 0);                        // FORMAT: всё int16, векторы в прямоугольных координатах
+    p = put16(p, (uint16_t)phasors);        // PHNMR
+    p = put16(p, 0);                        // ANNMR
+    p = put16(p, 0);                        // DGNMR
+    for (int i = 0; i < phasors; i++) {
+        p = putName(p, i < channels ? names[i] : "V1");
+    }
+    for (int i = 0; i < phasors; i++) {
+        p = put32(p, C37_PHASOR_UNIT);      // Напряжение, 10^-5 В на единицу
+    }
+    p = put16(p, nominalFrequency == 50.0f ? 1 : 0);
+    p = put16(p, configCount);
+    p = put16(p, rate);
+    put16(p, crc(buffer, frameSize - 2));
+    return frameSize;
+}
+
+bool SynchrophasorCodec::decodeConfig(const uint8_t* data, size_t length, SynchrophasorConfig& config) {
+    size_t frameSize = checkFrame(data, length, C37_SYNC_CONFIG2);
+    if (frameSize < 54 || get32(data + 14) != C37_TIME_BASE || get16(data + 18) != 1) {
+        return false;
+    }
+    const uint8_t* p = data + 20;
+    memset(&config, 0, sizeof(config));
+    getName(p, config.station);
+    config.idcode = get16(p + 16);
+    uint16_t format = get16(p + 18);
+    int phasors = get16(p + 20);
+    if (format != 0 || phasors < 1 || phasors > C37_MAX_PHASORS || get16(p + 22) != 0 || get16(p + 24) != 0 ||
+        frameSize != 54 + (size_t)(C37_NAME_LEN + 4) * phasors) {
+        return false;
+    }
+    config.phasors = phasors;
+    p += 26;
+    for (int i = 0; i < phasors; i++) {
+        getName(p, config.names[i]);
+        p += C37_NAME_LEN;
+    }
+    config.phasorUnit = get32(p) & 0xFFFFFF;
+    p += 4 * phasors;
+    config.nominalFrequency = (get16(p) & 1) ? 50.0f : 60.0f;
+    config.configCount = get16(p + 2);
+    config.rate = get16(p + 4);
+    return true;
+}
+
+bool SynchrophasorCodec::decodeData(const uint8_t* data, size_t length, const SynchrophasorConfig& config,
+                                    SynchrophasorFrame& frame, uint8_t& timeQuality, uint16_t& stat) {
+    size_t frameSize = checkFrame(data, length, C37_SYNC_DATA);
+    if (frameSize != 22 + 4 * (size_t)config.phasors || get16(data + 4) != config.idcode) {
+        return false;
+    }
+    memset(&frame, 0, sizeof(frame));
+    frame.soc = get32(data + 6);
+    uint32_t fracsec = get32(data + 10);
+    timeQuality = (uint8_t)((fracsec >> 24) & 0x0F);
+    frame.fracUs = fracsec & 0xFFFFFF;
+    stat = get16(data + 14);
+
+    frame.channels = config.phasors == 4 ? 3 : config.phasors;
+    const double scale = config.phasorUnit * 1e-5;
+    const uint8_t* p = data + 16;
+    for (int i = 0; i < config.phasors; i++) {
+        double re = (int16_t)get16(p) * scale;
+        double im = (int16_t)get16(p + 2) * scale;
+        p += 4;
+        float magnitude = (float)sqrt(re * re + im * im);
+        float angle = (float)atan2(im, re);
+        if (i < frame.channels) {
+            frame.magnitude[i] = magnitude;
+            frame.angle[i] = angle;
+        }
+        if (i == frame.channels || (config.phasors < 4 && i == 0)) {
+            frame.positiveMagnitude = magnitude;
+            frame.positiveAngle = angle;
+        }
+    }
+    frame.frequency = config.nominalFrequency + (int16_t)get16(p) / 1000.0f;
+    frame.rocof = (int16_t)get16(p + 2) / 100.0f;
+    frame.frequencyValid = true;
+    return true;
+}
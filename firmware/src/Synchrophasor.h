@@ -0,0 +1,261 @@
+#ifndef SYNCHROPHASOR_H
+#define SYNCHROPHASOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Каналов напряжения в оценке (трёхфазная схема)
+#define SYNCHROPHASOR_MAX_CHANNELS 3
+
+// Наибольшее окно, кадров: 2 периода 50 Гц или 3 периода 60 Гц при 10 кГц
+#define SYNCHROPHASOR_MAX_WINDOW 512
+
+// Отчётов в истории угла и частоты (rate/10 + 1 при rate до 60)
+#define SYNCHROPHASOR_HISTORY 8
+
+// Синхрослова кадров C37.118.2-2011 (версия 1)
+#define C37_SYNC_DATA 0xAA01
+#define C37_SYNC_CONFIG2 0xAA31
+
+// TIME_BASE: FRACSEC в микросекундах
+#define C37_TIME_BASE 1000000
+
+// Вектор в кадре — int16 Re/Im в 0.01 В (PHUNIT в единицах 10^-5 В)
+#define C37_PHASOR_UNIT 1000
+
+// Фазоров в кадре: каналы и прямая последовательность для трёх фаз
+#define C37_MAX_PHASORS (SYNCHROPHASOR_MAX_CHANNELS + 1)
+
+// Длина имени станции и канала в конфигурации
+#define C37_NAME_LEN 16
+
+// Размеры кадров с C37_MAX_PHASORS векторами
+#define C37_DATA_FRAME_MAX (22 + 4 * C37_MAX_PHASORS)
+#define C37_CONFIG_FRAME_MAX (54 + (C37_NAME_LEN + 4) * C37_MAX_PHASORS)
+
+// STAT: бит 13 — нет синхронизации с UTC
+#define C37_STAT_NOT_SYNCED 0x2000
+
+/**
+ * Синхрофазоры одного отчёта
+ *
+ * Угол — относительно cos(2π·f0·t), где t отсчитывается от начала секунды
+ * UTC: у сигнала √2·X·cos(2π·f0·t + φ) фазор X∠φ. При частоте не f0 угол
+ * вращается со скоростью 2π·(f - f0) рад/с, как требует C37.118.1.
+ */
+struct SynchrophasorFrame {
+    uint32_t soc;               // Секунда UTC отчёта
+    uint32_t fracUs;            // Микросекунды от начала секунды
+    int channels;               // Каналов (1..SYNCHROPHASOR_MAX_CHANNELS)
+    float magnitude[SYNCHROPHASOR_MAX_CHANNELS];    // RMS основной гармоники, В
+    float angle[SYNCHROPHASOR_MAX_CHANNELS];        // Рад, -π..π
+    float positiveMagnitude;    // Прямая последовательность (при одном-двух каналах — канал 0)
+    float positiveAngle;
+    float frequency;            // Гц
+    float rocof;                // Гц/с
+    bool frequencyValid;        // Истории углов хватило на частоту
+};
+
+/**
+ * Оценка синхрофазоров прямо по потоку кадров АЦП
+ *
+ * Окно — N = k·fs/f0 кадров, k — наименьшее число периодов (не меньше двух),
+ * при котором N целое: 400 кадров при 50 Гц и 500 при 60 Гц на 10 кГц.
+ * Для каждого канала скользящее ДПФ трёх соседних бинов k-1, k, k+1
+ * обновляется каждым кадром: S_b += (x(n) - x(n-N))·e^(-j2πbn/N), в int64 с
+ * таблицей поворотов Q14. Сумма точная, поэтому не накапливает ошибку за
+ * часы работы, а постоянная составляющая (смещение АЦП) в бины не попадает.
+ * Окно Ханна — комбинацией трёх бинов, амплитуда — с поправкой на его
+ * отклик при отклонении частоты от f0.
+ *
+ * Отчёты — в моменты UTC секунда + i/rate: отчёт выдаётся тем кадром, на
+ * котором середина окна проходит момент отчёта. Частота — по приращению угла
+ * прямой последовательности за ~100 мс, скорость её изменения — по
+ * приращению частоты за то же время.
+ *
+ * Кадр стоит O(каналы × 3) умножений; расчёт фазоров — только на отчёт.
+ */
+class PhasorEstimator {
+public:
+    PhasorEstimator();
+
+    /**
+     * @param channels Каналов напряжения (первые в кадре)
+     * @param sampleRateHz Кадров в секунду
+     * @param nominalFrequency f0, Гц (50 или 60)
+     * @param calibration В/отсчёт каждого канала
+     * @param channelSkewUs Сдвиг оцифровки соседних каналов кадра, мкс
+     * @param reportRate Отчётов в секунду (isValidRate)
+     * @return false если частота отчётов недопустима или окно не помещается
+     */
+    bool begin(int channels, uint32_t sampleRateHz, float nominalFrequency,
+               const float* calibration, float channelSkewUs, uint32_t reportRate);
+
+    /**
+     * Начать окно заново (разрыв в потоке кадров)
+     */
+    void reset();
+
+    /**
+     * Добавить кадр
+     * @param frame Отсчёты АЦП кадра (первые channels каналов)
+     * @param utcUs Время оцифровки кадра, мкс UTC
+     * @return true если готов отчёт (getFrame())
+     */
+    bool push(const int16_t* frame, uint64_t utcUs);
+
+    /**
+     * Последний отчёт
+     */
+    const SynchrophasorFrame& getFrame() const;
+
+    /**
+     * Окно, кадров
+     */
+    int getWindowFrames() const;
+
+    /**
+     * Отчётов в секунду, допустимых для f0 по C37.118.1:
+     * 10, 25, 50 при 50 Гц; 10, 12, 15, 20, 30, 60 при 60 Гц
+     */
+    static bool isValidRate(uint32_t rate, float nominalFrequency);
+
+private:
+    struct Bins {
+        int64_t re[3];          // k-1, k, k+1
+        int64_t im[3];
+    };
+
+    int channels;
+    uint32_t sampleRateHz;
+    float nominalFrequency;
+    uint32_t reportRate;
+    int windowFrames;
+    int windowCycles;
+    float calibration[SYNCHROPHASOR_MAX_CHANNELS];
+    float channelSkewUs;
+    uint32_t halfWindowUs;      // От середины окна до последнего кадра, целые мкс
+    float halfWindowExactUs;
+
+    // Таблица e^(-j2πi/N), Q14
+    int16_t cosTable[SYNCHROPHASOR_MAX_WINDOW];
+    int16_t sinTable[SYNCHROPHASOR_MAX_WINDOW];
+
+    // Кольцо последних N кадров и скользящие суммы
+    int16_t ring[SYNCHROPHASOR_MAX_WINDOW * SYNCHROPHASOR_MAX_CHANNELS];
+    Bins bins[SYNCHROPHASOR_MAX_CHANNELS];
+    int position;               // Номер кадра по модулю N (индекс самого старого в кольце)
+    int twiddle[3];             // b·n mod N для бинов k-1, k, k+1
+    int filled;
+
+    // Следующий момент отчёта
+    uint32_t reportSecond;
+    uint32_t reportIndex;
+    uint64_t nextReportUs;      // reportTimeUs(), чтобы не делить в каждом кадре
+    bool reportPrimed;
+
+    // История угла и частоты прямой последовательности по отчётам
+    float angleHistory[SYNCHROPHASOR_HISTORY];
+    float frequencyHistory[SYNCHROPHASOR_HISTORY];
+    int historyCount;
+    int frequencyCount;
+
+    SynchrophasorFrame frame;
+
+    /**
+     * Время отчёта reportIndex в секунде reportSecond, мкс UTC
+     */
+    uint64_t reportTimeUs() const;
+
+    /**
+     * Первый момент отчёта не раньше timeUs
+     */
+    void primeReport(uint64_t timeUs);
+
+    /**
+     * Фазоры по текущим суммам для отчёта в момент reportTimeUs()
+     * @param utcUs Время последнего кадра окна, мкс UTC
+     */
+    void estimate(uint64_t utcUs);
+};
+
+/**
+ * Конфигурация потока (CFG-2) в разобранном виде
+ */
+struct SynchrophasorConfig {
+    uint16_t idcode;
+    char station[C37_NAME_LEN + 1];
+    int phasors;
+    char names[C37_MAX_PHASORS][C37_NAME_LEN + 1];
+    uint32_t phasorUnit;        // 10^-5 В на единицу
+    float nominalFrequency;
+    uint16_t rate;
+    uint16_t configCount;
+};
+
+/**
+ * Кадры IEEE C37.118.2-2011 (big-endian, CRC-CCITT): данных и конфигурации 2
+ *
+ * Данные: FORMAT = 0 — векторы int16 в прямоугольных координатах, частота и
+ * её производная int16 (отклонение в мГц, Гц/с × 100), без аналоговых и
+ * дискретных каналов. 38 байт на три фазы и прямую последовательность.
+ * Декодирование — для стендовой проверки и приёмника на хосте.
+ */
+class SynchrophasorCodec {
+public:
+    /**
+     * Векторов в кадре при channels каналах
+     */
+    static int phasorCount(int channels);
+
+    /**
+     * Код качества времени (младшие 4 бита TQ в FRACSEC) по ошибке часов
+     * @param synced Часы синхронизированы с UTC
+     * @param errorUs Оценка ошибки, мкс
+     */
+    static uint8_t timeQuality(bool synced, uint32_t errorUs);
+
+    /**
+     * Слово STAT: синхронизация, качество времени PMU (биты 8-6) и время
+     * без синхронизации (биты 5-4)
+     * @param unlockedS Секунд с последней синхронизации
+     */
+    static uint16_t status(bool synced, uint32_t errorUs, uint32_t unlockedS);
+
+    /**
+     * Закодировать кадр данных
+     * @return Длина кадра или 0 если буфер мал
+     */
+    static size_t encodeData(const SynchrophasorFrame& frame, uint16_t idcode, uint8_t timeQuality,
+                             uint16_t stat, float nominalFrequency, uint8_t* buffer, size_t size);
+
+    /**
+     * Закодировать кадр конфигурации 2
+     * @param names Имена каналов (channels штук; прямая последовательность — "V1")
+     * @param soc Секунда UTC кадра
+     * @return Длина кадра или 0 если буфер мал
+     */
+    static size_t encodeConfig(uint16_t idcode, const char* station, int channels,
+                               const char* const* names, float nominalFrequency, uint16_t rate,
+                               uint16_t configCount, uint32_t soc, uint8_t* buffer, size_t size);
+
+    /**
+     * Разобрать кадр конфигурации 2
+     * @return false если кадр не CFG-2, повреждён или вне поддерживаемого формата
+     */
+    static bool decodeConfig(const uint8_t* data, size_t length, SynchrophasorConfig& config);
+
+    /**
+     * Разобрать кадр данных потока с конфигурацией config
+     * @return false если кадр не данных, повреждён или другого потока
+     */
+    static bool decodeData(const uint8_t* data, size_t length, const SynchrophasorConfig& config,
+                           SynchrophasorFrame& frame, uint8_t& timeQuality, uint16_t& stat);
+
+    /**
+     * CRC-CCITT (многочлен 0x1021, начальное 0xFFFF)
+     */
+    static uint16_t crc(const uint8_t* data, size_t length);
+};
+
+#endif // SYNCHROPHASOR_H
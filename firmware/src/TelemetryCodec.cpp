@@ -0,0 +1,217 @@
+#include "TelemetryCodec.h"
+#include <math.h>
+#include <string.h>
+
+uint8_t TelemetryCodec::problemFlags(const PowerData& data) {
+    return (data.lowVoltage ? PROBLEM_LOW_VOLTAGE : 0) |
+           (data.highVoltage ? PROBLEM_HIGH_VOLTAGE : 0) |
+           (data.highUnbalance ? PROBLEM_UNBALANCE : 0) |
+           (data.frequencyDeviation ? PROBLEM_FREQUENCY : 0);
+}
+
+uint16_t TelemetryCodec::toFixed(float value, float scale) {
+    // Насыщение вместо переполнения: 700 В не должно превратиться в 44 В
+    float scaled = value * scale + 0.5f;
+    if (!(scaled > 0.0f)) {
+        return 0;
+    }
+    if (scaled >= 65535.0f) {
+        return 65535;
+    }
+    return (uint16_t)scaled;
+}
+
+void TelemetryCodec::writeHeader(uint8_t* buffer, uint8_t type, uint16_t length,
+                                 uint32_t seq, uint32_t unixTime, uint32_t uptimeMs) {
+    RecordHeader header;
+    header.type = type;
+    header.version = TELEMETRY_VERSION;
+    header.length = length;
+    header.seq = seq;
+    header.unixTime = unixTime;
+    header.uptimeMs = uptimeMs;
+    memcpy(buffer, &header, sizeof(header));
+}
+
+size_t TelemetryCodec::encodePower(const PowerData& data, uint32_t seq, uint32_t unixTime,
+                                   uint8_t* buffer, size_t size) {
+    const size_t total = sizeof(RecordHeader) + sizeof(PowerRecord);
+    if (size < total) {
+        return 0;
+    }
+
+    PowerRecord record;
+    record.voltage[0] = toFixed(data.voltageA, 100.0f);
+    record.voltage[1] = toFixed(data.voltageB, 100.0f);
+    record.voltage[2] = toFixed(data.voltageC, 100.0f);
+    record.lineVoltage[0] = toFixed(data.voltageAB, 100.0f);
+    record.lineVoltage[1] = toFixed(data.voltageBC, 100.0f);
+    record.lineVoltage[2] = toFixed(data.voltageCA, 100.0f);
+    record.frequency[0] = toFixed(data.frequencyA, 1000.0f);
+    record.frequency[1] = toFixed(data.frequencyB, 1000.0f);
+    record.frequency[2] = toFixed(data.frequencyC, 1000.0f);
+    record.frequency[3] = toFixed(data.frequencyAvg, 1000.0f);
+    record.unbalance = toFixed(data.unbalance, 100.0f);
+    record.problemFlags = problemFlags(data);
+    record.reserved = 0;
+
+    writeHeader(buffer, RECORD_POWER, sizeof(record), seq, unixTime, (uint32_t)data.timestamp);
+    memcpy(buffer + sizeof(RecordHeader), &record, sizeof(record));
+    return total;
+}
+
+size_t TelemetryCodec::encodeEvent(const PowerData& data, uint8_t previousFlags, uint32_t seq,
+                                   uint32_t unixTime, uint8_t* buffer, size_t size) {
+    const size_t total = sizeof(RecordHeader) + sizeof(EventRecord);
+    if (size < total) {
+        return 0;
+    }
+
+    uint8_t flags = problemFlags(data);
+
+    EventRecord record;
+    record.problemFlags = flags;
+    record.raised = flags & ~previousFlags;
+    record.cleared = previousFlags & ~flags;
+    record.reserved = 0;
+    record.voltage[0] = toFixed(data.voltageA, 100.0f);
+    record.voltage[1] = toFixed(data.voltageB, 100.0f);
+    record.voltage[2] = toFixed(data.voltageC, 100.0f);
+    record.frequency = toFixed(data.frequencyAvg, 1000.0f);
+
+    writeHeader(buffer, RECORD_EVENT, sizeof(record), seq, unixTime, (uint32_t)data.timestamp);
+    memcpy(buffer + sizeof(RecordHeader), &record, sizeof(record));
+    return total;
+}
+
+size_t TelemetryCodec::encodeWaveform(const WaveformData& waveform,
+                                      float offsetA, float offsetB, float offsetC,
+                                      uint32_t seq, uint32_t unixTime,
+                                      uint8_t* buffer, size_t size) {
+    uint32_t count = waveform.sampleCount;
+    if (count > WAVEFORM_SAMPLES) {
+        count = WAVEFORM_SAMPLES;
+    }
+
+    const size_t payload = sizeof(WaveformRecordHeader) + 3 * count * sizeof(int16_t);
+    const size_t total = sizeof(RecordHeader) + payload;
+    if (size < total) {
+        return 0;
+    }
+
+    WaveformRecordHeader wave;
+    wave.sampleCount = (uint16_t)count;
+    wave.intervalUs = WAVEFORM_INTERVAL_US;
+
+    writeHeader(buffer, RECORD_WAVEFORM, (uint16_t)payload, seq, unixTime, (uint32_t)waveform.captureTime);
+    memcpy(buffer + sizeof(RecordHeader), &wave, sizeof(wave));
+
+    uint8_t* out = buffer + sizeof(RecordHeader) + sizeof(wave);
+    const int16_t* phases[3] = { waveform.phaseA, waveform.phaseB, waveform.phaseC };
+    const float offsets[3] = { offsetA, offsetB, offsetC };
+
+    for (int p = 0; p < 3; p++) {
+        for (uint32_t i = 0; i < count; i++) {
+            int16_t value = (int16_t)lroundf(phases[p][i] - offsets[p]);
+            memcpy(out, &value, sizeof(value));
+            out += sizeof(value);
+        }
+    }
+
+    return total;
+}
+
+void TelemetryCodec::writeFrameHeader(uint8_t* buffer, const char* deviceId,
+                                      uint8_t recordCount, uint16_t length) {
+    FrameHeader header;
+    header.magic = FRAME_MAGIC;
+    header.version = TELEMETRY_VERSION;
+    header.recordCount = recordCount;
+    header.length = length;
+    header.reserved = 0;
+    memset(header.deviceId, 0, FRAME_DEVICE_ID_LEN);
+    memcpy(header.deviceId, deviceId, strnlen(deviceId, FRAME_DEVICE_ID_LEN));
+    memcpy(buffer, &header, sizeof(header));
+}
+
+bool TelemetryCodec::decodeFrameHeader(const uint8_t* buffer, size_t size, FrameHeader& out) {
+    if (size < sizeof(FrameHeader)) {
+        return false;
+    }
+    memcpy(&out, buffer, sizeof(out));
+    return out.magic == FRAME_MAGIC &&
+           out.version == TELEMETRY_VERSION &&
+           out.length >= sizeof(FrameHeader) &&
+           out.length <= FRAME_MAX_SIZE;
+}
+
+bool TelemetryCodec::decodeRecordHeader(const uint8_t* buffer, size_t size, RecordHeader& out) {
+    if (size < sizeof(RecordHeader)) {
+        return false;
+    }
+    memcpy(&out, buffer, sizeof(out));
+    return out.version == TELEMETRY_VERSION &&
+           sizeof(RecordHeader) + out.length <= size;
+}
+
+bool TelemetryCodec::decodePower(const RecordHeader& header, const uint8_t* payload, PowerData& out) {
+    if (header.type != RECORD_POWER || header.length < sizeof(PowerRecord)) {
+        return false;
+    }
+
+    PowerRecord record;
+    memcpy(&record, payload, sizeof(record));
+
+    out.voltageA = record.voltage[0] / 100.0f;
+    out.voltageB = record.voltage[1] / 100.0f;
+    out.voltageC = record.voltage[2] / 100.0f;
+    out.voltageAB = record.lineVoltage[0] / 100.0f;
+    out.voltageBC = record.lineVoltage[1] / 100.0f;
+    out.voltageCA = record.lineVoltage[2] / 100.0f;
+    out.frequencyA = record.frequency[0] / 1000.0f;
+    out.frequencyB = record.frequency[1] / 1000.0f;
+    out.frequencyC = record.frequency[2] / 1000.0f;
+    out.frequencyAvg = record.frequency[3] / 1000.0f;
+    out.unbalance = record.unbalance / 100.0f;
+    out.voltageAvg = (out.voltageA + out.voltageB + out.voltageC) / 3.0f;
+    out.timestamp = header.uptimeMs;
+    out.lowVoltage = (record.problemFlags & PROBLEM_LOW_VOLTAGE) != 0;
+    out.highVoltage = (record.problemFlags & PROBLEM_HIGH_VOLTAGE) != 0;
+    out.highUnbalance = (record.problemFlags & PROBLEM_UNBALANCE) != 0;
+    out.frequencyDeviation = (record.problemFlags & PROBLEM_FREQUENCY) != 0;
+    return true;
+}
+
+bool TelemetryCodec::decodeEvent(const RecordHeader& header, const uint8_t* payload, EventRecord& out) {
+    if (header.type != RECORD_EVENT || header.length < sizeof(EventRecord)) {
+        return false;
+    }
+    memcpy(&out, payload, sizeof(out));
+    return true;
+}
+
+bool TelemetryCodec::decodeWaveform(const RecordHeader& header, const uint8_t* payload, WaveformData& out) {
+    if (header.type != RECORD_WAVEFORM || header.length < sizeof(WaveformRecordHeader)) {
+        return false;
+    }
+
+    WaveformRecordHeader wave;
+    memcpy(&wave, payload, sizeof(wave));
+    if (wave.sampleCount > WAVEFORM_SAMPLES ||
+        header.length < sizeof(wave) + 3 * wave.sampleCount * sizeof(int16_t)) {
+        return false;
+    }
+
+    const uint8_t* in = payload + sizeof(wave);
+    memcpy(out.phaseA, in, wave.sampleCount * sizeof(int16_t));
+    in += wave.sampleCount * sizeof(int16_t);
+    memcpy(out.phaseB, in, wave.sampleCount * sizeof(int16_t));
+    in += wave.sampleCount * sizeof(int16_t);
+    memcpy(out.phaseC, in, wave.sampleCount * sizeof(int16_t));
+
+    out.sampleCount = wave.sampleCount;
+    out.captureTime = header.uptimeMs;
+    memset(out.offsets, 0, sizeof(out.offsets));
+    memset(out.voltsPerCount, 0, sizeof(out.voltsPerCount));
+    return true;
+}
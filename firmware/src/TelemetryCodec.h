@@ -0,0 +1,165 @@
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "PowerData.h"
+#include "WaveformData.h"
+
+/**
+ * Компактный бинарный формат телеметрии (little-endian, без выравнивания)
+ *
+ * Каждая запись = RecordHeader + полезная нагрузка указанного типа.
+ * Величины передаются целыми в фиксированных единицах:
+ *   напряжение — 0.01 В (uint16, до 655.35 В)
+ *   частота    — 0.001 Гц (uint16, до 65.535 Гц)
+ *   перекос    — 0.01 %
+ * Запись PowerData занимает 40 байт вместо ~400 байт Line Protocol.
+ *
+ * Для шлюза (UDP/TCP) записи упаковываются в кадр: FrameHeader + записи подряд.
+ * Устройство в MQTT определяется топиком, в кадре — полем deviceId.
+ */
+
+#define TELEMETRY_VERSION 1
+
+// Типы записей
+#define RECORD_POWER 1
+#define RECORD_EVENT 2
+#define RECORD_WAVEFORM 3
+
+// Биты флагов проблем
+#define PROBLEM_LOW_VOLTAGE 0x01
+#define PROBLEM_HIGH_VOLTAGE 0x02
+#define PROBLEM_UNBALANCE 0x04
+#define PROBLEM_FREQUENCY 0x08
+
+struct __attribute__((packed)) RecordHeader {
+    uint8_t type;               // RECORD_*
+    uint8_t version;            // TELEMETRY_VERSION
+    uint16_t length;            // Длина полезной нагрузки после заголовка
+    uint32_t seq;               // Сквозной номер записи устройства
+    uint32_t unixTime;          // Секунды UTC (0 если время не синхронизировано)
+    uint32_t uptimeMs;          // millis() в момент измерения
+};
+
+struct __attribute__((packed)) PowerRecord {
+    uint16_t voltage[3];        // A, B, C
+    uint16_t lineVoltage[3];    // AB, BC, CA
+    uint16_t frequency[4];      // A, B, C, среднее
+    uint16_t unbalance;
+    uint8_t problemFlags;       // PROBLEM_*
+    uint8_t reserved;
+};
+
+struct __attribute__((packed)) EventRecord {
+    uint8_t problemFlags;       // Флаги после перехода
+    uint8_t raised;             // Флаги, которые установились
+    uint8_t cleared;            // Флаги, которые сбросились
+    uint8_t reserved;
+    uint16_t voltage[3];        // Напряжения в момент события
+    uint16_t frequency;         // Средняя частота
+};
+
+struct __attribute__((packed)) WaveformRecordHeader {
+    uint16_t sampleCount;       // Отсчётов на фазу
+    uint16_t intervalUs;        // Интервал между отсчётами
+    // Далее int16 отсчёты (ADC - offset): sampleCount фазы A, затем B, затем C
+};
+
+#define FRAME_MAGIC 0x464F              // "OF" (little-endian)
+#define FRAME_DEVICE_ID_LEN 16
+#define FRAME_MAX_SIZE 1400             // Укладывается в один UDP-датаграмм без фрагментации
+
+struct __attribute__((packed)) FrameHeader {
+    uint16_t magic;                     // FRAME_MAGIC
+    uint8_t version;                    // TELEMETRY_VERSION
+    uint8_t recordCount;
+    uint16_t length;                    // Полная длина кадра вместе с заголовком
+    uint16_t reserved;
+    char deviceId[FRAME_DEVICE_ID_LEN]; // Без завершающего нуля, если занимает всё поле
+};
+
+static_assert(sizeof(FrameHeader) == 24, "FrameHeader layout changed");
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader layout changed");
+static_assert(sizeof(PowerRecord) == 24, "PowerRecord layout changed");
+static_assert(sizeof(EventRecord) == 12, "EventRecord layout changed");
+
+#define TELEMETRY_MAX_RECORD_SIZE \
+    (sizeof(RecordHeader) + sizeof(WaveformRecordHeader) + 3 * WAVEFORM_SAMPLES * sizeof(int16_t))
+
+/**
+ * Кодирование PowerData, событий и осциллограмм в бинарные записи
+ */
+class TelemetryCodec {
+public:
+    /**
+     * Свернуть флаги проблем PowerData в битовую маску PROBLEM_*
+     */
+    static uint8_t problemFlags(const PowerData& data);
+
+    /**
+     * Закодировать запись измерений
+     * @return Размер записи или 0 если буфер мал
+     */
+    static size_t encodePower(const PowerData& data, uint32_t seq, uint32_t unixTime,
+                              uint8_t* buffer, size_t size);
+
+    /**
+     * Закодировать событие смены флагов проблем
+     * @param previousFlags Маска флагов до перехода
+     * @return Размер записи или 0 если буфер мал
+     */
+    static size_t encodeEvent(const PowerData& data, uint8_t previousFlags, uint32_t seq,
+                              uint32_t unixTime, uint8_t* buffer, size_t size);
+
+    /**
+     * Закодировать осциллограмму (отсчёты центрируются по offset)
+     * @return Размер записи или 0 если буфер мал
+     */
+    static size_t encodeWaveform(const WaveformData& waveform,
+                                 float offsetA, float offsetB, float offsetC,
+                                 uint32_t seq, uint32_t unixTime,
+                                 uint8_t* buffer, size_t size);
+
+    /**
+     * Записать заголовок кадра для шлюза
+     * @param length Полная длина кадра (заголовок + записи)
+     */
+    static void writeFrameHeader(uint8_t* buffer, const char* deviceId,
+                                 uint8_t recordCount, uint16_t length);
+
+    /**
+     * Разобрать заголовок кадра
+     * @return false если данных мало, неверный magic/версия или длина
+     */
+    static bool decodeFrameHeader(const uint8_t* buffer, size_t size, FrameHeader& out);
+
+    /**
+     * Разобрать заголовок записи
+     * @return false если данных меньше, чем заголовок + объявленная нагрузка
+     */
+    static bool decodeRecordHeader(const uint8_t* buffer, size_t size, RecordHeader& out);
+
+    /**
+     * Восстановить PowerData из записи RECORD_POWER
+     * @param payload Нагрузка сразу после RecordHeader
+     */
+    static bool decodePower(const RecordHeader& header, const uint8_t* payload, PowerData& out);
+
+    /**
+     * Разобрать запись RECORD_EVENT
+     */
+    static bool decodeEvent(const RecordHeader& header, const uint8_t* payload, EventRecord& out);
+
+    /**
+     * Восстановить WaveformData из записи RECORD_WAVEFORM (отсчёты центрированы)
+     */
+    static bool decodeWaveform(const RecordHeader& header, const uint8_t* payload, WaveformData& out);
+
+private:
+    static uint16_t toFixed(float value, float scale);
+    static void writeHeader(uint8_t* buffer, uint8_t type, uint16_t length,
+                            uint32_t seq, uint32_t unixTime, uint32_t uptimeMs);
+};
+
+#endif // TELEMETRY_CODEC_H
@@ -0,0 +1,170 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <math.h>
+#include <stdint.h>
+#include "config.h"
+#include "PowerData.h"
+#include "DeadbandFilter.h"
+
+/**
+ * Схема подключения каналов напряжения (ANALYZER_TOPOLOGY в config.h)
+ */
+enum class Topology : uint8_t {
+    SINGLE_PHASE = TOPOLOGY_SINGLE_PHASE,   // L-N
+    SPLIT_PHASE = TOPOLOGY_SPLIT_PHASE,     // L1-N, L2-N в противофазе
+    WYE = TOPOLOGY_WYE,                     // A-N, B-N, C-N
+    DELTA = TOPOLOGY_DELTA                  // A-B, B-C, C-A (без нейтрали)
+};
+
+/**
+ * Перекос напряжений по ГОСТ 13109-97 (упрощённо): (Umax - Umin) / Uavg * 100%
+ * @param count Число напряжений (меньше двух — перекоса нет)
+ */
+inline float voltageUnbalance(const float* voltages, int count) {
+    if (count < 2) {
+        return 0.0f;
+    }
+
+    float maxV = voltages[0];
+    float minV = voltages[0];
+    float sum = voltages[0];
+    for (int i = 1; i < count; i++) {
+        maxV = voltages[i] > maxV ? voltages[i] : maxV;
+        minV = voltages[i] < minV ? voltages[i] : minV;
+        sum += voltages[i];
+    }
+    float avgV = sum / count;
+
+    if (avgV < 1.0f) {
+        return 0.0f;  // Избегаем деления на ноль при отсутствии напряжения
+    }
+
+    return ((maxV - minV) / avgV) * 100.0f;
+}
+
+/**
+ * Свойства схемы подключения, известные при компиляции
+ *
+ *   VOLTAGE_CHANNELS — сколько первых каналов блока измеряют напряжение
+ *   PHASES           — сколько фазных напряжений заполняется в PowerData
+ *   FIELDS           — величины PowerData, которые имеют смысл (DEADBAND_FIELD_*)
+ *   PHASE_POWER      — каналы напряжения фазные: мощность фазы = U канала × I пары
+ *   channelName(ch)  — буква канала в заголовке захвата
+ *   derive(rms, d)   — фазные, линейные напряжения и перекос из RMS каналов
+ */
+template <Topology T>
+struct TopologyTraits;
+
+template <>
+struct TopologyTraits<Topology::SINGLE_PHASE> {
+    static constexpr int VOLTAGE_CHANNELS = 1;
+    static constexpr int PHASES = 1;
+    static constexpr bool PHASE_POWER = true;
+    static constexpr uint16_t FIELDS = DEADBAND_FIELD_VOLTAGE_A | DEADBAND_FIELD_FREQUENCY;
+
+    static char channelName(int channel) {
+        return 'A';
+    }
+
+    static void derive(const float* rms, PowerData& data) {
+        data.voltageA = rms[0];
+        data.voltageB = 0.0f;
+        data.voltageC = 0.0f;
+        data.voltageAB = 0.0f;
+        data.voltageBC = 0.0f;
+        data.voltageCA = 0.0f;
+        data.voltageAvg = rms[0];
+        data.unbalance = 0.0f;
+    }
+};
+
+template <>
+struct TopologyTraits<Topology::SPLIT_PHASE> {
+    static constexpr int VOLTAGE_CHANNELS = 2;
+    static constexpr int PHASES = 2;
+    static constexpr bool PHASE_POWER = true;
+    static constexpr uint16_t FIELDS = DEADBAND_FIELD_VOLTAGE_A | DEADBAND_FIELD_VOLTAGE_B |
+                                      DEADBAND_FIELD_LINE_AB | DEADBAND_FIELD_FREQUENCY |
+                                      DEADBAND_FIELD_UNBALANCE;
+
+    static char channelName(int channel) {
+        return channel == 0 ? '1' : '2';
+    }
+
+    static void derive(const float* rms, PowerData& data) {
+        data.voltageA = rms[0];
+        data.voltageB = rms[1];
+        data.voltageC = 0.0f;
+        // Полуобмотки в противофазе: L1-L2 = U1 + U2
+        data.voltageAB = rms[0] + rms[1];
+        data.voltageBC = 0.0f;
+        data.voltageCA = 0.0f;
+        data.voltageAvg = (rms[0] + rms[1]) / 2.0f;
+        data.unbalance = voltageUnbalance(rms, 2);
+    }
+};
+
+template <>
+struct TopologyTraits<Topology::WYE> {
+    static constexpr int VOLTAGE_CHANNELS = 3;
+    static constexpr int PHASES = 3;
+    static constexpr bool PHASE_POWER = true;
+    static constexpr uint16_t FIELDS = DEADBAND_VOLTAGE_FIELDS;
+
+    static char channelName(int channel) {
+        return 'A' + channel;
+    }
+
+    static void derive(const float* rms, PowerData& data) {
+        data.voltageA = rms[0];
+        data.voltageB = rms[1];
+        data.voltageC = rms[2];
+
+        // Межфазные (линейные) напряжения
+        // Для симметричной трёхфазной системы: Uл = Uф * √3
+        // Для реальной системы с учётом сдвига фаз на 120°:
+        // Uab = √(Ua² + Ub² - 2*Ua*Ub*cos(120°)) = √(Ua² + Ub² + Ua*Ub)
+        data.voltageAB = sqrt(rms[0] * rms[0] + rms[1] * rms[1] + rms[0] * rms[1]);
+        data.voltageBC = sqrt(rms[1] * rms[1] + rms[2] * rms[2] + rms[1] * rms[2]);
+        data.voltageCA = sqrt(rms[2] * rms[2] + rms[0] * rms[0] + rms[2] * rms[0]);
+
+        data.voltageAvg = (rms[0] + rms[1] + rms[2]) / 3.0f;
+        data.unbalance = voltageUnbalance(rms, 3);
+    }
+};
+
+template <>
+struct TopologyTraits<Topology::DELTA> {
+    static constexpr int VOLTAGE_CHANNELS = 3;
+    static constexpr int PHASES = 3;
+    // Без нейтрали мощность по фазам не считается (метод двух ваттметров не реализован)
+    static constexpr bool PHASE_POWER = false;
+    static constexpr uint16_t FIELDS = DEADBAND_VOLTAGE_FIELDS;
+
+    // Каналы — линейные напряжения AB, BC, CA; в захвате помечены фазой начала
+    static char channelName(int channel) {
+        return 'A' + channel;
+    }
+
+    static void derive(const float* rms, PowerData& data) {
+        float ab = rms[0];
+        float bc = rms[1];
+        float ca = rms[2];
+        data.voltageAB = ab;
+        data.voltageBC = bc;
+        data.voltageCA = ca;
+
+        // Фазные — до искусственной нейтрали (центра треугольника напряжений):
+        // 2/3 медианы, Ua = √(2·Uab² + 2·Uca² - Ubc²) / 3; в симметрии Uл / √3
+        data.voltageA = sqrt(fmaxf(2 * ab * ab + 2 * ca * ca - bc * bc, 0.0f)) / 3.0f;
+        data.voltageB = sqrt(fmaxf(2 * ab * ab + 2 * bc * bc - ca * ca, 0.0f)) / 3.0f;
+        data.voltageC = sqrt(fmaxf(2 * bc * bc + 2 * ca * ca - ab * ab, 0.0f)) / 3.0f;
+
+        data.voltageAvg = (data.voltageA + data.voltageB + data.voltageC) / 3.0f;
+        // Без нейтрали перекос определяется по линейным напряжениям
+        data.unbalance = voltageUnbalance(rms, 3);
+    }
+};
+
+#endif // TOPOLOGY_H
@@ -0,0 +1,259 @@
+#include "VoltageHistogram.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "LineProtocol.h"
+
+VoltageHistogram::VoltageHistogram()
+    : phases(0),
+      started(false),
+      takenVersion(0),
+      periodFrames(0),
+      framesInPeriod(0),
+      blockTime(0),
+      blockTimeValid(false) {
+    memset(&current, 0, sizeof(current));
+    memset(&last, 0, sizeof(last));
+    memset(offsets, 0, sizeof(offsets));
+    memset(sensitivities, 0, sizeof(sensitivities));
+    memset(sumSquares, 0, sizeof(sumSquares));
+}
+
+int VoltageHistogram::bucketOf(float rms) {
+    int bucket = (int)floorf((rms - VOLTAGE_HISTOGRAM_LOW_V) / VOLTAGE_HISTOGRAM_BUCKET_V);
+    if (bucket < 0) {
+        return 0;
+    }
+    return bucket < VOLTAGE_HISTOGRAM_BUCKETS ? bucket : VOLTAGE_HISTOGRAM_BUCKETS - 1;
+}
+
+bool VoltageHistogram::addBlock(const int16_t* frames, int frameCount, int stride, int phases, int periodFrames,
+                                const float* offsets, const float* sensitivities, uint32_t unixTime) {
+    if (phases > VOLTAGE_HISTOGRAM_MAX_PHASES) {
+        phases = VOLTAGE_HISTOGRAM_MAX_PHASES;
+    }
+    this->phases = phases;
+
+    // Интервал закрывается первым блоком следующего
+    bool intervalClosed = advanceTo(unixTime);
+
+    for (int start = 0; start + periodFrames <= frameCount; start += periodFrames) {
+        for (int ph = 0; ph < phases; ph++) {
+            const int16_t* sample = frames + start * stride + ph;
+            float sumSquares = 0.0f;
+            for (int i = 0; i < periodFrames; i++, sample += stride) {
+                float d = *sample - offsets[ph];
+                sumSquares += d * d;
+            }
+            float rms = sqrtf(sumSquares / periodFrames) * sensitivities[ph];
+            current.counts[ph][bucketOf(rms)]++;
+        }
+        current.cycles++;
+    }
+    return intervalClosed;
+}
+
+bool VoltageHistogram::advanceTo(uint32_t unixTime) {
+    uint32_t startS = unixTime - unixTime % VOLTAGE_HISTOGRAM_PERIOD_S;
+    if (started && startS == current.startS) {
+        return false;
+    }
+    bool intervalClosed = started && current.cycles > 0;
+    if (intervalClosed) {
+        closed.write(current);
+    }
+    memset(&current, 0, sizeof(current));
+    current.startS = startS;
+    started = true;
+    return intervalClosed;
+}
+
+void VoltageHistogram::begin(int phases, int periodFrames, const float* offsets, const float* sensitivities) {
+    this->phases = phases < VOLTAGE_HISTOGRAM_MAX_PHASES ? phases : VOLTAGE_HISTOGRAM_MAX_PHASES;
+    this->periodFrames = periodFrames;
+    for (int ph = 0; ph < this->phases; ph++) {
+        this->offsets[ph] = offsets[ph];
+        this->sensitivities[ph] = sensitivities[ph];
+    }
+    memset(sumSquares, 0, sizeof(sumSquares));
+    framesInPeriod = 0;
+    blockTimeValid = false;
+}
+
+void VoltageHistogram::beginBlock(uint32_t unixTime, bool timeValid) {
+    blockTime = unixTime;
+    blockTimeValid = timeValid;
+}
+
+void VoltageHistogram::push(const int16_t* frame) {
+    for (int ph = 0; ph < phases; ph++) {
+        float d = frame[ph] - offsets[ph];
+        sumSquares[ph] += d * d;
+    }
+    if (++framesInPeriod < periodFrames) {
+        return;
+    }
+
+    // Период закрыт: до NTP не считается — интервалы выровнены по часам
+    if (blockTimeValid) {
+        advanceTo(blockTime);
+        for (int ph = 0; ph < phases; ph++) {
+            float rms = sqrtf(sumSquares[ph] / periodFrames) * sensitivities[ph];
+            current.counts[ph][bucketOf(rms)]++;
+        }
+        current.cycles++;
+    }
+    memset(sumSquares, 0, sizeof(sumSquares));
+    framesInPeriod = 0;
+}
+
+bool VoltageHistogram::takeClosed() {
+    // Закрылся ещё один, пока копировали, — заберём его в следующий раз
+    uint32_t version = closed.version();
+    if (version == takenVersion || !closed.read(last) || closed.version() != version) {
+        return false;
+    }
+    takenVersion = version;
+    return true;
+}
+
+uint32_t VoltageHistogram::getCurrentStartS() const {
+    return current.startS;
+}
+
+uint32_t VoltageHistogram::getCurrentCycles() const {
+    return current.cycles;
+}
+
+uint32_t VoltageHistogram::getLastStartS() const {
+    return last.startS;
+}
+
+uint32_t VoltageHistogram::getLastCycles() const {
+    return last.cycles;
+}
+
+const uint32_t* VoltageHistogram::getLastCounts(int phase) const {
+    return last.counts[phase];
+}
+
+size_t VoltageHistogram::writeLineProtocol(char* buffer, size_t size, const char* deviceId) const {
+    static const char* const phaseKeys[VOLTAGE_HISTOGRAM_MAX_PHASES] = {"a", "b", "c"};
+    LineWriter out(buffer, size);
+    if (last.cycles == 0) {
+        return 0;
+    }
+    char rle[VOLTAGE_HISTOGRAM_RLE_SIZE];
+    out.begin("voltage_histogram");
+    out.tag("device", deviceId);
+    out.field("low", VOLTAGE_HISTOGRAM_LOW_V, 1);
+    out.field("step", VOLTAGE_HISTOGRAM_BUCKET_V, 2);
+    out.field("buckets", (uint32_t)VOLTAGE_HISTOGRAM_BUCKETS);
+    out.field("period", (uint32_t)VOLTAGE_HISTOGRAM_PERIOD_S);
+    out.field("cycles", last.cycles);
+    for (int ph = 0; ph < phases; ph++) {
+        if (encodeRle(last.counts[ph], VOLTAGE_HISTOGRAM_BUCKETS, rle, sizeof(rle)) == 0) {
+            return 0;
+        }
+        out.field(phaseKeys[ph], rle);
+    }
+    out.end((uint64_t)last.startS * 1000);
+    return out.overflowed() ? 0 : out.length();
+}
+
+/**
+ * Десятичная запись без snprintf
+ * @return Новая позиция, 0 если не поместилось
+ */
+static size_t appendNumber(char* out, size_t pos, size_t size, uint32_t value) {
+    char digits[10];
+    int count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    if (pos + count >= size) {
+        return 0;
+    }
+    while (count > 0) {
+        out[pos++] = digits[--count];
+    }
+    return pos;
+}
+
+size_t VoltageHistogram::encodeRle(const uint32_t* counts, int buckets, char* out, size_t size) {
+    // Нули в конце не пишем: длина задана полем buckets
+    int used = buckets;
+    while (used > 0 && counts[used - 1] == 0) {
+        used--;
+    }
+    if (size == 0) {
+        return 0;
+    }
+    size_t pos = 0;
+    for (int i = 0; i < used;) {
+        int run = 1;
+        while (i + run < used && counts[i + run] == counts[i]) {
+            run++;
+        }
+        if (i > 0) {
+            if (pos + 1 >= size) {
+                return 0;
+            }
+            out[pos++] = ',';
+        }
+        pos = appendNumber(out, pos, size, counts[i]);
+        if (pos != 0 && run > 1) {
+            out[pos++] = '*';
+            pos = appendNumber(out, pos, size, (uint32_t)run);
+        }
+        if (pos == 0) {
+            return 0;
+        }
+        i += run;
+    }
+    out[pos] = '\0';
+    // Пустая гистограмма — «0», чтобы поле не было пустой строкой
+    if (pos == 0) {
+        if (size < 2) {
+            return 0;
+        }
+        out[pos++] = '0';
+        out[pos] = '\0';
+    }
+    return pos;
+}
+
+bool VoltageHistogram::decodeRle(const char* text, uint32_t* counts, int buckets) {
+    memset(counts, 0, buckets * sizeof(uint32_t));
+    int bucket = 0;
+    const char* p = text;
+    while (*p != '\0') {
+        char* end;
+        unsigned long value = strtoul(p, &end, 10);
+        if (end == p) {
+            return false;
+        }
+        unsigned long run = 1;
+        p = end;
+        if (*p == '*') {
+            run = strtoul(p + 1, &end, 10);
+            if (end == p + 1 || run < 2) {
+                return false;
+            }
+            p = end;
+        }
+        if (bucket + run > (unsigned long)buckets) {
+            return false;
+        }
+        for (unsigned long i = 0; i < run; i++) {
+            counts[bucket++] = (uint32_t)value;
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
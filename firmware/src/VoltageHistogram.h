@@ -0,0 +1,145 @@
+#ifndef VOLTAGE_HISTOGRAM_H
+#define VOLTAGE_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "SeqLock.h"
+
+#define VOLTAGE_HISTOGRAM_MAX_PHASES 3
+
+// Счётчики корзины в RLE: до 10 цифр, '*', длина серии, ','
+#define VOLTAGE_HISTOGRAM_RLE_SIZE (VOLTAGE_HISTOGRAM_BUCKETS * 11 + 1)
+
+// Точка voltage_histogram с тремя фазами в худшем случае (все корзины разные), DEVICE_ID до 32 символов
+#define VOLTAGE_HISTOGRAM_LINE_PROTOCOL_SIZE (160 + VOLTAGE_HISTOGRAM_MAX_PHASES * (VOLTAGE_HISTOGRAM_RLE_SIZE + 8))
+
+/**
+ * Распределение напряжения по периодам за интервал, выровненный по часам
+ *
+ * Кадры режутся на номинальные периоды, RMS периода каждой фазы попадает в
+ * корзину шириной VOLTAGE_HISTOGRAM_BUCKET_V от VOLTAGE_HISTOGRAM_LOW_V (за
+ * краями — в крайние корзины). Интервал VOLTAGE_HISTOGRAM_PERIOD_S
+ * закрывается первым периодом следующего и уходит одной точкой: счётчики
+ * корзин каждой фазы — строкой RLE, так что тепловой карте Grafana нужна
+ * одна точка на интервал, а не на период.
+ *
+ * RLE: счётчики корзин по порядку через запятую, серия из n ≥ 2 одинаковых —
+ * «значение*n», нули в конце опускаются: «0*47,3,12,80,2*2,0*3,1».
+ *
+ * Пока идёт непрерывная оцифровка, задача FrequencyStream отдаёт каждый кадр
+ * в push(), как FlightRecorder: считаются все периоды. Без неё цикл измерений
+ * добавляет свои блоки addBlock() — только периоды окон измерений (10 из 50
+ * при 50 Гц), равномерная выборка, доли корзин от неё не смещаются.
+ * Закрытый интервал переходит к циклу измерений через SeqLock: takeClosed().
+ */
+class VoltageHistogram {
+public:
+    VoltageHistogram();
+
+    /**
+     * Добавить периоды блока
+     * @param frames Кадры по stride отсчётов, фазы — первые phases каналов
+     * @param frameCount Кадров в блоке (неполный период в конце отбрасывается)
+     * @param periodFrames Кадров в номинальном периоде
+     * @param offsets Смещение АЦП каждой фазы
+     * @param sensitivities В/отсчёт каждой фазы
+     * @param unixTime Время блока (NTP)
+     * @return true если закрылся интервал — пора публиковать
+     */
+    bool addBlock(const int16_t* frames, int frameCount, int stride, int phases, int periodFrames,
+                  const float* offsets, const float* sensitivities, uint32_t unixTime);
+
+    /**
+     * Настроить покадровый счёт (при запуске задачи оцифровки); неполный период сбрасывается
+     * @param phases Фаз (первые каналы кадра)
+     * @param offsets Смещение АЦП каждой фазы
+     * @param sensitivities В/отсчёт каждой фазы
+     */
+    void begin(int phases, int periodFrames, const float* offsets, const float* sensitivities);
+
+    /**
+     * Начало блока кадров (задача оцифровки)
+     * @param unixTime Время блока
+     * @param timeValid Время от NTP; без него периоды не считаются
+     */
+    void beginBlock(uint32_t unixTime, bool timeValid);
+
+    /**
+     * Кадр АЦП (задача оцифровки)
+     */
+    void push(const int16_t* frame);
+
+    /**
+     * Забрать интервал, закрытый с прошлого вызова (только цикл измерений):
+     * после true его отдают getLast*() и writeLineProtocol()
+     */
+    bool takeClosed();
+
+    /**
+     * Текущий интервал: начало и периодов в нём
+     */
+    uint32_t getCurrentStartS() const;
+    uint32_t getCurrentCycles() const;
+
+    /**
+     * Последний забранный takeClosed() интервал (0 периодов — ещё не было)
+     */
+    uint32_t getLastStartS() const;
+    uint32_t getLastCycles() const;
+    const uint32_t* getLastCounts(int phase) const;
+
+    /**
+     * Точка voltage_histogram последнего забранного интервала
+     * @return Длина записанного, 0 если не поместилось или интервалов ещё не было
+     */
+    size_t writeLineProtocol(char* buffer, size_t size, const char* deviceId) const;
+
+    /**
+     * Счётчики корзин в RLE
+     * @return Длина строки, 0 если не поместилось
+     */
+    static size_t encodeRle(const uint32_t* counts, int buckets, char* out, size_t size);
+
+    /**
+     * Обратно из RLE (недостающие корзины в конце — нули)
+     * @return false если строка испорчена или корзин больше buckets
+     */
+    static bool decodeRle(const char* text, uint32_t* counts, int buckets);
+
+    /**
+     * Корзина для RMS периода
+     */
+    static int bucketOf(float rms);
+
+private:
+    struct Period {
+        uint32_t startS;
+        uint32_t cycles;
+        uint32_t counts[VOLTAGE_HISTOGRAM_MAX_PHASES][VOLTAGE_HISTOGRAM_BUCKETS];
+    };
+
+    int phases;
+    bool started;
+    Period current;
+    SeqLock<Period> closed;     // Пишет тот, кто считает; читает takeClosed()
+    uint32_t takenVersion;
+    Period last;                // Копия забранного интервала (цикл измерений)
+
+    // Покадровый счёт
+    int periodFrames;
+    float offsets[VOLTAGE_HISTOGRAM_MAX_PHASES];
+    float sensitivities[VOLTAGE_HISTOGRAM_MAX_PHASES];
+    float sumSquares[VOLTAGE_HISTOGRAM_MAX_PHASES];
+    int framesInPeriod;
+    uint32_t blockTime;
+    bool blockTimeValid;
+
+    /**
+     * Перейти к интервалу, содержащему unixTime; прежний непустой — в closed
+     * @return true если интервал закрылся
+     */
+    bool advanceTo(uint32_t unixTime);
+};
+
+#endif // VOLTAGE_HISTOGRAM_H
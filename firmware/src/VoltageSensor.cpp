@@ -1,4 +1,10 @@
 #include "VoltageSensor.h"
+#include <math.h>
+#include "hal/Hal.h"
+
+VoltageSensor::VoltageSensor()
+    : VoltageSensor(-1, 1.0f) {
+}
 
 VoltageSensor::VoltageSensor(int pin, float sensitivity) {
     _pin = pin;
@@ -6,17 +12,19 @@ VoltageSensor::VoltageSensor(int pin, float sensitivity) {
     _offset = ADC_OFFSET;  // Default offset (VCC/2)
     _voltageRMS = 0;
     _frequency = NOMINAL_FREQUENCY;
+    _noiseFloor = 5.0f;
     _lastCrossingTime = 0;
     _crossingCount = 0;
 }
 
-void VoltageSensor::begin() {
-    pinMode(_pin, INPUT);
-    analogReadResolution(ADC_RESOLUTION);
-    analogSetAttenuation(ADC_11db);  // Full range 0-3.3V
+void VoltageSensor::begin(bool calibrate) {
+    Hal::adcBegin(_pin);
+    if (!calibrate) {
+        return;
+    }
     
     // Allow ADC to stabilize
-    delay(100);
+    Hal::delayMs(100);
     
     // Calibrate offset
     calibrateOffset();
@@ -31,76 +39,111 @@ void VoltageSensor::calibrateOffset() {
     const int calibrationSamples = 5000;
     
     for (int i = 0; i < calibrationSamples; i++) {
-        sum += analogRead(_pin);
-        delayMicroseconds(50);
+        sum += Hal::adcRead(_pin);
+        Hal::delayUs(50);
     }
     
     _offset = (float)sum / calibrationSamples;
     
-    Serial.printf("[VoltageSensor] Pin %d offset calibrated: %.1f\n", _pin, _offset);
+    Hal::log("[VoltageSensor] Pin %d offset calibrated: %.1f\n", _pin, _offset);
 }
 
 void VoltageSensor::setSensitivity(float sensitivity) {
     _sensitivity = sensitivity;
 }
 
+void VoltageSensor::setNoiseFloor(float noiseFloor) {
+    _noiseFloor = noiseFloor;
+}
+
 float VoltageSensor::getSensitivity() const {
     return _sensitivity;
 }
 
+void VoltageSensor::setOffset(float offset) {
+    _offset = offset;
+}
+
 float VoltageSensor::readRMS(int samples) {
-    long sumSquares = 0;
-    int lastValue = analogRead(_pin);
-    bool wasAboveZero = lastValue > _offset;
+    // Single-channel acquisition into a buffer, then the same analysis as for
+    // interleaved blocks (PowerAnalyzer) and for replayed captures
+    static int16_t buffer[SAMPLES_PER_READING];
+    if (samples > SAMPLES_PER_READING) {
+        samples = SAMPLES_PER_READING;
+    }
+    
+    uint32_t startTime = Hal::micros();
+    for (int i = 0; i < samples; i++) {
+        buffer[i] = Hal::adcRead(_pin);
+        
+        // Maintain consistent sampling rate
+        Hal::waitUntilUs(startTime, (uint32_t)(i + 1) * SAMPLE_INTERVAL_US);
+    }
+    
+    return analyze(buffer, samples, 1, SAMPLE_INTERVAL_US);
+}
+
+float VoltageSensor::analyze(const int16_t* samples, int count, int stride, uint32_t intervalUs) {
+    if (count <= 0) {
+        return _voltageRMS;
+    }
+    
+    // 64-bit: 2000 samples of ~1000 counts RMS already exceed a 32-bit long on ESP32
+    uint64_t sumSquares = 0;
+    bool wasAboveZero = samples[0] > _offset;
     
-    unsigned long startTime = micros();
     int zeroCrossings = 0;
-    unsigned long firstCrossingTime = 0;
-    unsigned long lastCrossingTime = 0;
+    int firstCrossing = 0;
+    int lastCrossing = 0;
     
-    for (int i = 0; i < samples; i++) {
-        int raw = analogRead(_pin);
+    for (int i = 0; i < count; i++) {
+        int raw = samples[i * stride];
         
         // Calculate deviation from offset
         float value = raw - _offset;
-        sumSquares += (long)(value * value);
+        sumSquares += (uint64_t)(value * value);
         
         // Zero-crossing detection for frequency measurement
+        // (crossing time = sample index, sampling is paced at intervalUs)
         bool isAboveZero = raw > _offset;
         if (isAboveZero != wasAboveZero) {
-            // Zero crossing detected
-            unsigned long now = micros();
             if (zeroCrossings == 0) {
-                firstCrossingTime = now;
+                firstCrossing = i;
             }
-            lastCrossingTime = now;
+            lastCrossing = i;
             zeroCrossings++;
             wasAboveZero = isAboveZero;
         }
-        
-        // Maintain consistent sampling rate
-        while (micros() - startTime < (i + 1) * SAMPLE_INTERVAL_US) {
-            // Busy wait for precise timing
-        }
+    }
+    
+    return finishWindow(sumSquares, count, zeroCrossings, firstCrossing, lastCrossing, intervalUs);
+}
+
+float VoltageSensor::finishWindow(uint64_t sumSquares, int count, int zeroCrossings,
+                                  int firstCrossing, int lastCrossing, uint32_t intervalUs) {
+    if (count <= 0) {
+        return _voltageRMS;
     }
     
     // Calculate RMS from ADC values
-    float meanSquare = (float)sumSquares / samples;
+    float meanSquare = (float)sumSquares / count;
     float rmsADC = sqrt(meanSquare);
     
     // Convert ADC RMS to voltage using calibration coefficient
     _voltageRMS = rmsADC * _sensitivity;
     
-    // Filter out noise (anything below 5V is probably noise)
-    if (_voltageRMS < 5.0) {
+    // Filter out noise (anything below the floor, 5V by default, is probably noise)
+    if (_voltageRMS < _noiseFloor) {
         _voltageRMS = 0.0;
     }
     
     // Calculate frequency from zero crossings
     // Each full cycle has 2 zero crossings
-    if (zeroCrossings >= 4 && lastCrossingTime > firstCrossingTime) {
-        float timePeriod = (lastCrossingTime - firstCrossingTime) / 1000000.0; // Convert to seconds
-        int fullCycles = (zeroCrossings - 1) / 2;
+    if (zeroCrossings >= 4 && lastCrossing > firstCrossing) {
+        float timePeriod = (float)(lastCrossing - firstCrossing) * intervalUs / 1000000.0f; // Seconds
+        // Between the first and last crossing there are (N - 1) half-cycles;
+        // integer division here used to drop a half-cycle and read ~48 Hz on a 50 Hz grid
+        float fullCycles = (zeroCrossings - 1) / 2.0f;
         if (fullCycles > 0) {
             _frequency = fullCycles / timePeriod;
             
@@ -123,7 +166,7 @@ float VoltageSensor::getFrequency() const {
 }
 
 int VoltageSensor::readRaw() {
-    return analogRead(_pin);
+    return Hal::adcRead(_pin);
 }
 
 float VoltageSensor::getOffset() const {
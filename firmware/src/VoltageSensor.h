@@ -1,5 +1,5 @@
 #pragma once
-#include <Arduino.h>
+#include <stdint.h>
 #include "config.h"
 
 /**
@@ -15,12 +15,18 @@ private:
     float _offset;
     float _voltageRMS;
     float _frequency;
+    float _noiseFloor;
     
     // Zero-crossing detection
     unsigned long _lastCrossingTime;
     int _crossingCount;
     
 public:
+    /**
+     * Unassigned channel (pin -1); assign a configured sensor before begin()
+     */
+    VoltageSensor();
+    
     /**
      * Constructor
      * @param pin GPIO pin connected to ZMPT101B output
@@ -30,8 +36,11 @@ public:
     
     /**
      * Initialize the sensor and calibrate offset
+     * @param calibrate false: skip the ADC settle delay and calibration, the
+     *                  caller sets the offset (PowerAnalyzer calibrates all
+     *                  channels from one interleaved block)
      */
-    void begin();
+    void begin(bool calibrate = true);
     
     /**
      * Calibrate the DC offset (should be called when no AC is connected or at startup)
@@ -50,6 +59,12 @@ public:
      */
     float getSensitivity() const;
     
+    /**
+     * Set the RMS below which the reading is treated as noise and reported as 0
+     * @param noiseFloor In calibrated units (default 5 V; CT channels use amperes)
+     */
+    void setNoiseFloor(float noiseFloor);
+    
     /**
      * Read RMS voltage from the sensor
      * @param samples Number of ADC samples to take (default: SAMPLES_PER_READING)
@@ -57,6 +72,31 @@ public:
      */
     float readRMS(int samples = SAMPLES_PER_READING);
     
+    /**
+     * Calculate RMS voltage and frequency from already captured samples
+     * @param samples First sample of this channel
+     * @param count Number of samples
+     * @param stride Distance between consecutive samples (channel count for interleaved blocks)
+     * @param intervalUs Sampling interval
+     * @return RMS voltage in Volts
+     */
+    float analyze(const int16_t* samples, int count, int stride, uint32_t intervalUs);
+    
+    /**
+     * Finish a window accumulated elsewhere (PowerAnalyzer kernels process all
+     * channels of a frame in one pass): RMS from the sum of squares, frequency
+     * from the zero-crossing sample indices
+     * @param sumSquares Sum of (raw - offset)^2 over the window
+     * @param count Number of samples
+     * @param zeroCrossings Number of zero crossings
+     * @param firstCrossing Sample index of the first crossing
+     * @param lastCrossing Sample index of the last crossing
+     * @param intervalUs Sampling interval
+     * @return RMS voltage in Volts
+     */
+    float finishWindow(uint64_t sumSquares, int count, int zeroCrossings,
+                       int firstCrossing, int lastCrossing, uint32_t intervalUs);
+    
     /**
      * Get the last calculated RMS voltage without new measurement
      */
@@ -76,4 +116,9 @@ public:
      * Get the calibrated offset value
      */
     float getOffset() const;
+    
+    /**
+     * Set the offset explicitly (e.g. from a capture file header)
+     */
+    void setOffset(float offset);
 };
@@ -0,0 +1,30 @@
+#ifndef WAVEFORM_DATA_H
+#define WAVEFORM_DATA_H
+
+#include <stdint.h>
+
+// Параметры захвата waveform
+#define WAVEFORM_SAMPLES 100      // Точек на фазу (2-3 периода при 50Hz)
+#define WAVEFORM_INTERVAL_US 200  // Интервал между отсчётами (200us = 5kHz), кратен шагу кадров анализатора
+
+// Буфер Line Protocol осциллограммы: 3 строки по ~56 байт на точку (DEVICE_ID до 16 символов)
+#define WAVEFORM_LINE_PROTOCOL_SIZE (WAVEFORM_SAMPLES * 3 * 64)
+
+/**
+ * Структура для хранения waveform данных трёх фаз
+ */
+struct WaveformData {
+    int16_t phaseA[WAVEFORM_SAMPLES];
+    int16_t phaseB[WAVEFORM_SAMPLES];
+    int16_t phaseC[WAVEFORM_SAMPLES];
+    uint32_t sampleCount;
+    unsigned long captureTime;  // millis() когда захвачено
+    
+    // Смещение АЦП и В/отсчёт фаз, с которыми анализатор считал RMS этого блока
+    // в отсчётах АЦП, как и phaseA..C, при любом PowerAnalyzer::FRAME_SCALE
+    // (после декодирования записи — 0: отсчёты уже центрированы)
+    float offsets[3];
+    float voltsPerCount[3];
+};
+
+#endif // WAVEFORM_DATA_H
@@ -0,0 +1,784 @@
+#include "AlertSim.h"
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../config.h"
+#include "../hal/Hal.h"
+#include "../hal/HalNative.h"
+#include "../AlertEngine.h"
+#include "../AlertNotifier.h"
+
+#define STEP_MS 1000
+#define HOVER_S 600                 // Напряжение около VOLTAGE_MAX, секунд
+#define HOVER_NOISE_V 1.5f          // ± вокруг VOLTAGE_MAX
+#define LOSS_CYCLES 10              // Пропаж фазы при проверке задержки уведомлений
+#define LOSS_HOLD_S 10              // Секунд без фазы и с фазой в каждом цикле
+#define UNIX_TIME 1760000000u
+#define WEBHOOK_PATH "/hooks/power"
+#define WEBHOOK_HEADERS "X-Alert-Token: sim\r\n"
+#define MAX_LATENCY_MS 50.0         // От измерения до получения на 127.0.0.1
+
+using Clock = std::chrono::steady_clock;
+
+static bool check(const char* name, bool ok, const char* detail) {
+    printf("%-44s %-8s %s\n", name, ok ? "ok" : "FAIL", detail);
+    return ok;
+}
+
+static PowerData nominal() {
+    PowerData data;
+    memset(&data, 0, sizeof(data));
+    data.voltageA = NOMINAL_VOLTAGE;
+    data.voltageB = NOMINAL_VOLTAGE;
+    data.voltageC = NOMINAL_VOLTAGE;
+    data.frequencyA = NOMINAL_FREQUENCY;
+    data.frequencyB = NOMINAL_FREQUENCY;
+    data.frequencyC = NOMINAL_FREQUENCY;
+    data.frequencyAvg = NOMINAL_FREQUENCY;
+    data.unbalance = 0.5f;
+    return data;
+}
+
+static int ruleIndex(const AlertEngine& engine, const char* name) {
+    for (int r = 0; r < engine.getRuleCount(); r++) {
+        if (strcmp(engine.getRule(r).name, name) == 0) {
+            return r;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Измерения раз в секунду через один AlertEngine; все переходы сохраняются
+ */
+struct Run {
+    AlertEngine engine;
+    uint32_t nowMs;
+    std::vector<AlertEvent> events;
+
+    Run() : nowMs(0) {
+    }
+
+    int step(const PowerData& data, uint32_t stepMs = STEP_MS) {
+        nowMs += stepMs;
+        AlertEvent out[ALERT_MAX_EVENTS];
+        int count = engine.update(data, 3, nowMs, out);
+        events.insert(events.end(), out, out + count);
+        return count;
+    }
+
+    int hold(const PowerData& data, int seconds) {
+        int count = 0;
+        for (int s = 0; s < seconds; s++) {
+            count += step(data);
+        }
+        return count;
+    }
+
+    /**
+     * Время следующего измерения
+     */
+    uint32_t next() const {
+        return nowMs + STEP_MS;
+    }
+
+    const AlertEvent* find(int rule, int phase, bool active) const {
+        for (const AlertEvent& e : events) {
+            if (e.rule == rule && e.phase == phase && e.active == active) {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * Переход ровно в ожидаемое время
+ */
+static bool at(const AlertEvent* event, uint32_t timeMs) {
+    return event != nullptr && event->timeMs == timeMs;
+}
+
+static bool checkRules(const AlertEngine& engine, const char* const* names, int count) {
+    char detail[160] = "";
+    for (int i = 0; i < count; i++) {
+        if (ruleIndex(engine, names[i]) < 0) {
+            snprintf(detail + strlen(detail), sizeof(detail) - strlen(detail), " %s", names[i]);
+        }
+    }
+    char line[200];
+    snprintf(line, sizeof(line), "%d rules%s%s", engine.getRuleCount(), detail[0] != '\0' ? ", missing:" : "", detail);
+    return check("ALERT_RULES loaded", detail[0] == '\0', line);
+}
+
+static bool checkHover() {
+    Run run;
+    int rule = ruleIndex(run.engine, "overvoltage");
+    const AlertRule& r = run.engine.getRule(rule);
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> noise(-HOVER_NOISE_V, HOVER_NOISE_V);
+    PowerData data = nominal();
+    int flagChanges = 0;
+    bool high = false;
+    for (int s = 0; s < HOVER_S; s++) {
+        data.voltageA = VOLTAGE_MAX + noise(random);
+        // Как PowerAnalyzer::checkThresholds
+        flagChanges += (data.voltageA > VOLTAGE_MAX) != high ? 1 : 0;
+        high = data.voltageA > VOLTAGE_MAX;
+        run.step(data);
+    }
+    char detail[160];
+    snprintf(detail, sizeof(detail), "%d highVoltage flag changes -> %d transitions",
+             flagChanges, (int)run.events.size());
+    bool ok = check("Hovering at VOLTAGE_MAX: one alert", run.events.size() == 1 && run.events[0].rule == rule &&
+                    run.events[0].phase == 0 && run.events[0].active && flagChanges > 100, detail);
+
+    data = nominal();
+    uint32_t backMs = run.next();
+    run.hold(data, (int)(r.clearAfterMs / STEP_MS) + 5);
+    const AlertEvent* cleared = run.find(rule, 0, false);
+    snprintf(detail, sizeof(detail), "cleared %ld ms after return (expected %lu)",
+             cleared != nullptr ? (long)(cleared->timeMs - backMs) : -1L, (unsigned long)r.clearAfterMs);
+    ok &= check("Back to nominal: cleared after clear delay", at(cleared, backMs + r.clearAfterMs) &&
+                run.events.size() == 2, detail);
+    return ok;
+}
+
+static bool checkSwell() {
+    Run run;
+    int rule = ruleIndex(run.engine, "overvoltage");
+    const AlertRule& r = run.engine.getRule(rule);
+    int raiseSteps = (int)(r.raiseAfterMs / STEP_MS);
+    PowerData data = nominal();
+    run.hold(data, 5);
+
+    // Выброс на raiseSteps измерений: за порогом (raiseSteps - 1) секунд — меньше задержки
+    data.voltageA = VOLTAGE_MAX + 8.0f;
+    run.hold(data, raiseSteps);
+    run.hold(nominal(), 5);
+    char detail[160];
+    snprintf(detail, sizeof(detail), "%d measurements above %.0f V: %d transitions", raiseSteps, VOLTAGE_MAX,
+             (int)run.events.size());
+    bool ok = check("Short swell ignored", run.events.empty(), detail);
+
+    uint32_t onsetMs = run.next();
+    run.hold(data, raiseSteps + 3);
+    const AlertEvent* raised = run.find(rule, 0, true);
+    snprintf(detail, sizeof(detail), "raised %ld ms after onset (expected %lu), duration %lu ms",
+             raised != nullptr ? (long)(raised->timeMs - onsetMs) : -1L, (unsigned long)r.raiseAfterMs,
+             raised != nullptr ? (unsigned long)raised->durationMs : 0UL);
+    ok &= check("Sustained swell raised after raise delay", at(raised, onsetMs + r.raiseAfterMs) &&
+                raised->durationMs == r.raiseAfterMs && run.events.size() == 1, detail);
+
+    // Выше критического порога — в том же измерении
+    Run surge;
+    int critical = ruleIndex(surge.engine, "overvoltage_critical");
+    surge.hold(nominal(), 3);
+    data = nominal();
+    data.voltageC = NOMINAL_VOLTAGE * 1.25f;
+    uint32_t surgeMs = surge.next();
+    surge.step(data);
+    snprintf(detail, sizeof(detail), "%.0f V on C: %d transitions in the first measurement",
+             data.voltageC, (int)surge.events.size());
+    ok &= check("Surge raised at once", at(surge.find(critical, 2, true), surgeMs), detail);
+    return ok;
+}
+
+static bool checkPhaseLoss() {
+    Run run;
+    int rule = ruleIndex(run.engine, "phase_loss");
+    const AlertRule& r = run.engine.getRule(rule);
+    run.hold(nominal(), 5);
+
+    // Без фазы B: напряжение около нуля, перекос огромный
+    PowerData data = nominal();
+    data.voltageB = 3.0f;
+    data.frequencyB = 0.0f;
+    data.unbalance = 66.0f;
+    uint32_t lossMs = run.next();
+    run.hold(data, 30);
+
+    // Возвращается через полосу гистерезиса
+    data.voltageB = (PHASE_LOSS_THRESHOLD + r.clearAt) / 2.0f;
+    data.unbalance = 30.0f;
+    run.hold(data, 10);
+    uint32_t backMs = run.next();
+    run.hold(nominal(), 30);
+
+    const AlertEvent* raised = run.find(rule, 1, true);
+    const AlertEvent* cleared = run.find(rule, 1, false);
+    char detail[160];
+    snprintf(detail, sizeof(detail), "raised +%ld ms, cleared %ld ms after return (expected %lu), %d transitions",
+             raised != nullptr ? (long)(raised->timeMs - lossMs) : -1L,
+             cleared != nullptr ? (long)(cleared->timeMs - backMs) : -1L, (unsigned long)r.clearAfterMs,
+             (int)run.events.size());
+    return check("Phase loss: only phase_loss, raised at once", at(raised, lossMs) &&
+                 at(cleared, backMs + r.clearAfterMs) && run.events.size() == 2, detail);
+}
+
+static bool checkFrequency() {
+    Run run;
+    int rule = ruleIndex(run.engine, "frequency_high");
+    const AlertRule& r = run.engine.getRule(rule);
+    run.hold(nominal(), 3);
+
+    PowerData data = nominal();
+    data.frequencyAvg = r.raiseAt + 0.05f;
+    uint32_t onsetMs = run.next();
+    run.hold(data, (int)(r.raiseAfterMs / STEP_MS) + 3);
+
+    // В полосе гистерезиса тревога держится
+    data.frequencyAvg = (r.raiseAt + r.clearAt) / 2.0f;
+    run.hold(data, 60);
+    size_t inBand = run.events.size();
+
+    uint32_t backMs = run.next();
+    run.hold(nominal(), (int)(r.clearAfterMs / STEP_MS) + 3);
+
+    char detail[160];
+    snprintf(detail, sizeof(detail), "%.2f Hz raised +%lu ms, held 60 s at %.2f Hz, cleared +%lu ms",
+             r.raiseAt + 0.05f, (unsigned long)r.raiseAfterMs, (r.raiseAt + r.clearAt) / 2.0f,
+             (unsigned long)r.clearAfterMs);
+    return check("Frequency: hysteresis band holds the alert", at(run.find(rule, -1, true), onsetMs + r.raiseAfterMs) &&
+                 inBand == 1 && at(run.find(rule, -1, false), backMs + r.clearAfterMs) && run.events.size() == 2,
+                 detail);
+}
+
+static bool checkUnbalanceAndGap() {
+    Run run;
+    int rule = ruleIndex(run.engine, "unbalance");
+    const AlertRule& r = run.engine.getRule(rule);
+    run.hold(nominal(), 3);
+    PowerData data = nominal();
+    data.unbalance = r.raiseAt + 1.0f;
+    uint32_t onsetMs = run.next();
+    run.hold(data, (int)(r.raiseAfterMs / STEP_MS) + 3);
+    char detail[160];
+    snprintf(detail, sizeof(detail), "%.1f %% raised +%lu ms", data.unbalance, (unsigned long)r.raiseAfterMs);
+    bool ok = check("Unbalance raised after raise delay", at(run.find(rule, -1, true), onsetMs + r.raiseAfterMs) &&
+                    run.events.size() == 1, detail);
+
+    // Пропуск измерений длиннее ALERT_MAX_GAP_MS: отсчёт начинается заново
+    Run gap;
+    int overvoltage = ruleIndex(gap.engine, "overvoltage");
+    const AlertRule& o = gap.engine.getRule(overvoltage);
+    gap.hold(nominal(), 3);
+    data = nominal();
+    data.voltageA = VOLTAGE_MAX + 8.0f;
+    gap.step(data);
+    gap.step(data, ALERT_MAX_GAP_MS + o.raiseAfterMs);
+    uint32_t resumedMs = gap.nowMs;
+    size_t afterGap = gap.events.size();
+    gap.hold(data, (int)(o.raiseAfterMs / STEP_MS) + 1);
+    snprintf(detail, sizeof(detail), "%lu ms gap, raised +%lu ms after it",
+             (unsigned long)(ALERT_MAX_GAP_MS + o.raiseAfterMs), (unsigned long)o.raiseAfterMs);
+    ok &= check("Measurement gap restarts the raise delay", afterGap == 0 &&
+                at(gap.find(overvoltage, 0, true), resumedMs + o.raiseAfterMs), detail);
+    return ok;
+}
+
+/**
+ * Получатель webhook: HTTP/1.1 с keep-alive на 127.0.0.1, по одному соединению
+ */
+class Receiver {
+public:
+    struct Request {
+        std::string head;
+        std::string body;
+        Clock::time_point at;
+    };
+
+    std::atomic<uint32_t> connections;
+    std::atomic<uint32_t> requests;
+
+    Receiver() : connections(0), requests(0), listenFd(-1), port(0), failCount(0), failStatus(0), stopping(false) {
+    }
+
+    ~Receiver() {
+        stop();
+    }
+
+    bool start() {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (bind(listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, 4) != 0 ||
+            getsockname(listenFd, (struct sockaddr*)&address, &length) != 0) {
+            return false;
+        }
+        port = ntohs(address.sin_port);
+        thread = std::thread(&Receiver::run, this);
+        return true;
+    }
+
+    void stop() {
+        stopping = true;
+        if (thread.joinable()) {
+            thread.join();
+        }
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            listenFd = -1;
+        }
+    }
+
+    uint16_t getPort() const {
+        return port;
+    }
+
+    /**
+     * Ответить на следующие count запросов кодом status (0 — закрыть соединение без ответа)
+     */
+    void failNext(int count, int status) {
+        failStatus = status;
+        failCount = count;
+    }
+
+    /**
+     * Забрать принятые (ответ 204) запросы
+     */
+    std::vector<Request> take() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Request> out;
+        out.swap(accepted);
+        return out;
+    }
+
+private:
+    int listenFd;
+    uint16_t port;
+    std::atomic<int> failCount;
+    std::atomic<int> failStatus;
+    std::atomic<bool> stopping;
+    std::thread thread;
+    std::mutex mutex;
+    std::vector<Request> accepted;
+
+    void run() {
+        while (!stopping) {
+            struct pollfd waiting = {listenFd, POLLIN, 0};
+            if (poll(&waiting, 1, 20) != 1) {
+                continue;
+            }
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                connections++;
+                serve(fd);
+                ::close(fd);
+            }
+        }
+    }
+
+    int receive(int fd, char* buffer, size_t size) {
+        while (!stopping) {
+            struct pollfd waiting = {fd, POLLIN, 0};
+            if (poll(&waiting, 1, 20) == 1) {
+                return (int)recv(fd, buffer, size, 0);
+            }
+        }
+        return -1;
+    }
+
+    bool readRequest(int fd, std::string& pending, std::string& head, std::string& body) {
+        size_t headEnd;
+        char buffer[1024];
+        while ((headEnd = pending.find("\r\n\r\n")) == std::string::npos) {
+            int received = receive(fd, buffer, sizeof(buffer));
+            if (received <= 0) {
+                return false;
+            }
+            pending.append(buffer, (size_t)received);
+        }
+        head = pending.substr(0, headEnd + 2);
+        pending.erase(0, headEnd + 4);
+        size_t length = 0;
+        size_t field = head.find("\r\nContent-Length:");
+        if (field != std::string::npos) {
+            length = strtoul(head.c_str() + field + 17, nullptr, 10);
+        }
+        while (pending.size() < length) {
+            int received = receive(fd, buffer, sizeof(buffer));
+            if (received <= 0) {
+                return false;
+            }
+            pending.append(buffer, (size_t)received);
+        }
+        body = pending.substr(0, length);
+        pending.erase(0, length);
+        return true;
+    }
+
+    void respond(int fd, const char* response) {
+        send(fd, response, strlen(response), MSG_NOSIGNAL);
+    }
+
+    void serve(int fd) {
+        std::string pending;
+        Request request;
+        while (!stopping && readRequest(fd, pending, request.head, request.body)) {
+            request.at = Clock::now();
+            requests++;
+            if (failCount > 0) {
+                failCount--;
+                if (failStatus == 0) {
+                    return;
+                }
+                char response[128];
+                snprintf(response, sizeof(response), "HTTP/1.1 %d Failed\r\nContent-Length: 6\r\n\r\nfailed",
+                         (int)failStatus);
+                respond(fd, response);
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                accepted.push_back(request);
+            }
+            respond(fd, "HTTP/1.1 204 No Content\r\n\r\n");
+        }
+    }
+};
+
+static uint32_t seqOf(const std::string& body) {
+    size_t field = body.find("\"seq\":");
+    return field != std::string::npos ? (uint32_t)strtoul(body.c_str() + field + 6, nullptr, 10) : 0;
+}
+
+static bool hasField(const std::string& body, const char* field) {
+    return body.find(field) != std::string::npos;
+}
+
+/**
+ * Вызывать service(), двигая виртуальные часы на возвращённую задержку, пока очередь не опустеет
+ * @param delays Куда записать задержки
+ * @return Всего ожидания, мс
+ */
+static uint64_t drain(AlertNotifier& notifier, std::vector<uint32_t>& delays) {
+    uint64_t waitedMs = 0;
+    uint32_t waitMs;
+    while ((waitMs = notifier.service()) != ALERT_NOTIFY_IDLE && delays.size() < 100) {
+        delays.push_back(waitMs);
+        waitedMs += waitMs;
+        NativeHal::advanceUs(waitMs * 1000u);
+    }
+    return waitedMs;
+}
+
+static bool enqueueText(AlertNotifier& notifier, uint32_t seq) {
+    char payload[64];
+    int length = snprintf(payload, sizeof(payload), "{\"device\":\"" DEVICE_ID "\",\"seq\":%lu}", (unsigned long)seq);
+    return notifier.enqueue(payload, (size_t)length);
+}
+
+static bool checkWebhook() {
+    Receiver receiver;
+    if (!receiver.start()) {
+        return check("Webhook receiver", false, "cannot listen on 127.0.0.1");
+    }
+    char url[96];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u" WEBHOOK_PATH, receiver.getPort());
+    AlertNotifier notifier;
+    if (!notifier.begin(url, WEBHOOK_HEADERS)) {
+        return check("Webhook URL", false, url);
+    }
+
+    // Пропажи фазы B: переход, запрос, ответ — от измерения до получения
+    Run run;
+    struct Sent {
+        uint32_t seq;
+        Clock::time_point measuredAt;
+    };
+    std::vector<Sent> sent;
+    PowerData lost = nominal();
+    lost.voltageB = 0.0f;
+    lost.unbalance = 66.0f;
+    for (int second = 0; second < LOSS_CYCLES * 2 * LOSS_HOLD_S; second++) {
+        PowerData data = (second / LOSS_HOLD_S) % 2 == 0 ? lost : nominal();
+        Clock::time_point measuredAt = Clock::now();
+        AlertEvent events[ALERT_MAX_EVENTS];
+        run.nowMs += STEP_MS;
+        int count = run.engine.update(data, 3, run.nowMs, events);
+        for (int i = 0; i < count; i++) {
+            char payload[ALERT_PAYLOAD_SIZE];
+            size_t length = run.engine.writeJson(events[i], DEVICE_ID, UNIX_TIME, payload, sizeof(payload));
+            notifier.enqueue(payload, length);
+            sent.push_back({events[i].seq, measuredAt});
+        }
+        if (count > 0) {
+            notifier.service();
+        }
+    }
+    std::vector<Receiver::Request> received = receiver.take();
+    std::vector<double> latencies;
+    bool ordered = received.size() == sent.size();
+    for (size_t i = 0; ordered && i < received.size(); i++) {
+        ordered = seqOf(received[i].body) == sent[i].seq;
+        latencies.push_back(std::chrono::duration<double, std::milli>(received[i].at - sent[i].measuredAt).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double medianMs = latencies.empty() ? 0.0 : latencies[latencies.size() / 2];
+    double maxMs = latencies.empty() ? 0.0 : latencies.back();
+    char detail[200];
+    snprintf(detail, sizeof(detail), "%d of %d in order, median %.3f ms, max %.3f ms",
+             (int)received.size(), (int)sent.size(), medianMs, maxMs);
+    bool ok = check("Measurement to webhook latency", ordered && sent.size() == LOSS_CYCLES * 2 &&
+                    maxMs < MAX_LATENCY_MS, detail);
+    snprintf(detail, sizeof(detail), "%lu connections for %lu notifications",
+             (unsigned long)receiver.connections.load(), (unsigned long)receiver.requests.load());
+    ok &= check("Notifications share one connection", receiver.connections == 1, detail);
+
+    std::string first = received.empty() ? std::string() : received[0].body;
+    std::string head = received.empty() ? std::string() : received[0].head;
+    ok &= check("JSON notification and request headers",
+                head.compare(0, strlen("POST " WEBHOOK_PATH " HTTP/1.1"), "POST " WEBHOOK_PATH " HTTP/1.1") == 0 &&
+                hasField(head, "\r\nContent-Type: application/json\r\n") && hasField(head, "\r\n" WEBHOOK_HEADERS) &&
+                hasField(first, "\"device\":\"" DEVICE_ID "\"") && hasField(first, "\"alert\":\"phase_loss\"") &&
+                hasField(first, "\"state\":\"raised\"") && hasField(first, "\"severity\":\"critical\"") &&
+                hasField(first, "\"phase\":\"B\"") && hasField(first, "\"time\":1760000000"),
+                first.c_str());
+
+    // 503 трижды: повторы через ALERT_RETRY_MS, x2, x4 по виртуальным часам
+    AlertNotifierStats before = notifier.getStats();
+    receiver.failNext(3, 503);
+    enqueueText(notifier, 1001);
+    uint32_t firstWait = notifier.service();
+    uint32_t requestsBefore = receiver.requests;
+    NativeHal::advanceUs((firstWait - 1) * 1000u);
+    uint32_t early = notifier.service();
+    bool waited = early == 1 && receiver.requests == requestsBefore;
+    std::vector<uint32_t> delays;
+    delays.push_back(firstWait);
+    NativeHal::advanceUs(1000);
+    drain(notifier, delays);
+    received = receiver.take();
+    const AlertNotifierStats& stats = notifier.getStats();
+    const uint32_t retryMs = ALERT_RETRY_MS;
+    const uint32_t retryMaxMs = ALERT_RETRY_MAX_MS;
+    bool backoff = delays.size() == 3 && delays[0] == retryMs && delays[1] == std::min(2 * retryMs, retryMaxMs) &&
+                   delays[2] == std::min(4 * retryMs, retryMaxMs);
+    snprintf(detail, sizeof(detail), "retries after %lu, %lu, %lu ms, delivered on attempt %lu",
+             (unsigned long)(delays.size() > 0 ? delays[0] : 0), (unsigned long)(delays.size() > 1 ? delays[1] : 0),
+             (unsigned long)(delays.size() > 2 ? delays[2] : 0), (unsigned long)(stats.retries - before.retries + 1));
+    ok &= check("HTTP 503: retried with doubling delay", waited && backoff && received.size() == 1 &&
+                seqOf(received[0].body) == 1001 && stats.delivered == before.delivered + 1, detail);
+
+    // Следующие ждут за повторяемым
+    receiver.failNext(2, 503);
+    enqueueText(notifier, 2001);
+    enqueueText(notifier, 2002);
+    delays.clear();
+    drain(notifier, delays);
+    received = receiver.take();
+    snprintf(detail, sizeof(detail), "%d delivered after %d retries", (int)received.size(), (int)delays.size());
+    ok &= check("Order kept behind a retried notification", received.size() == 2 && seqOf(received[0].body) == 2001 &&
+                seqOf(received[1].body) == 2002, detail);
+
+    // 4xx не повторяется
+    before = notifier.getStats();
+    receiver.failNext(1, 400);
+    enqueueText(notifier, 3001);
+    enqueueText(notifier, 3002);
+    uint32_t idle = notifier.service();
+    received = receiver.take();
+    snprintf(detail, sizeof(detail), "rejected %lu, next delivered %s",
+             (unsigned long)(notifier.getStats().rejected - before.rejected),
+             received.size() == 1 && seqOf(received[0].body) == 3002 ? "yes" : "no");
+    ok &= check("HTTP 400: dropped without retries", idle == ALERT_NOTIFY_IDLE && received.size() == 1 &&
+                seqOf(received[0].body) == 3002 && notifier.getStats().rejected == before.rejected + 1, detail);
+
+    // Получатель закрывает соединение без ответа: отказ после ALERT_MAX_ATTEMPTS
+    before = notifier.getStats();
+    receiver.failNext(1000, 0);
+    enqueueText(notifier, 4001);
+    delays.clear();
+    uint64_t waitedMs = drain(notifier, delays);
+    receiver.failNext(0, 0);
+    uint64_t expectedMs = 0;
+    uint32_t delayMs = ALERT_RETRY_MS;
+    for (int attempt = 1; attempt < ALERT_MAX_ATTEMPTS; attempt++) {
+        expectedMs += std::min(delayMs, (uint32_t)ALERT_RETRY_MAX_MS);
+        delayMs *= 2;
+    }
+    snprintf(detail, sizeof(detail), "%d attempts over %.0f s (expected %.0f s), expired %lu",
+             (int)delays.size() + 1, waitedMs / 1000.0, expectedMs / 1000.0,
+             (unsigned long)(notifier.getStats().expired - before.expired));
+    ok &= check("No response: dropped after max attempts", (int)delays.size() == ALERT_MAX_ATTEMPTS - 1 &&
+                waitedMs == expectedMs && notifier.getStats().expired == before.expired + 1, detail);
+
+    // Граница очереди: лишние отбрасываются, принятые доходят по порядку
+    before = notifier.getStats();
+    int queued = 0;
+    for (int i = 0; i < ALERT_QUEUE_SIZE + 4; i++) {
+        queued += enqueueText(notifier, 5001 + i) ? 1 : 0;
+    }
+    uint32_t pendingFull = notifier.pending();
+    delays.clear();
+    drain(notifier, delays);
+    received = receiver.take();
+    bool contiguous = (int)received.size() == ALERT_QUEUE_SIZE;
+    for (size_t i = 0; contiguous && i < received.size(); i++) {
+        contiguous = seqOf(received[i].body) == 5001 + i;
+    }
+    snprintf(detail, sizeof(detail), "%d queued (%lu pending), %lu dropped, %d delivered in order",
+             queued, (unsigned long)pendingFull, (unsigned long)(notifier.getStats().dropped - before.dropped),
+             (int)received.size());
+    ok &= check("Queue bounded at ALERT_QUEUE_SIZE", queued == ALERT_QUEUE_SIZE && contiguous &&
+                notifier.getStats().dropped == before.dropped + 4, detail);
+
+    receiver.stop();
+    return ok;
+}
+
+static int columnOf(const std::vector<std::string>& header, const char* name) {
+    for (size_t i = 0; i < header.size(); i++) {
+        if (header[i] == name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static std::vector<std::string> splitCsv(const char* line) {
+    std::vector<std::string> fields;
+    std::string field;
+    for (const char* c = line; *c != '\0' && *c != '\n' && *c != '\r'; c++) {
+        if (*c == ',') {
+            fields.push_back(field);
+            field.clear();
+        } else {
+            field += *c;
+        }
+    }
+    fields.push_back(field);
+    return fields;
+}
+
+static int runTrace(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return 1;
+    }
+    static char line[1024];
+    if (fgets(line, sizeof(line), file) == nullptr) {
+        fprintf(stderr, "%s: empty\n", path);
+        fclose(file);
+        return 1;
+    }
+    std::vector<std::string> header = splitCsv(line);
+    int timeColumn = columnOf(header, "timestamp_ms");
+    int voltageColumns[3] = {columnOf(header, "voltage_a"), columnOf(header, "voltage_b"), columnOf(header, "voltage_c")};
+    int frequencyColumns[3] = {columnOf(header, "frequency_a"), columnOf(header, "frequency_b"), columnOf(header, "frequency_c")};
+    int unbalanceColumn = columnOf(header, "unbalance");
+    int flagsColumn = columnOf(header, "problem_flags");
+    if (timeColumn < 0 || voltageColumns[0] < 0 || frequencyColumns[0] < 0) {
+        fprintf(stderr, "%s: needs timestamp_ms, voltage_a and frequency_a columns (bench --replay --csv)\n", path);
+        fclose(file);
+        return 1;
+    }
+
+    AlertEngine engine;
+    AlertEvent events[ALERT_MAX_EVENTS];
+    uint32_t rows = 0;
+    uint32_t firstMs = 0;
+    uint32_t lastMs = 0;
+    int flagChanges = 0;
+    long lastFlags = -1;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        std::vector<std::string> fields = splitCsv(line);
+        if ((int)fields.size() < (int)header.size()) {
+            continue;
+        }
+        PowerData data;
+        memset(&data, 0, sizeof(data));
+        float voltages[3] = {0.0f, 0.0f, 0.0f};
+        int phases = 0;
+        for (int p = 0; p < 3 && voltageColumns[p] >= 0; p++) {
+            voltages[p] = (float)atof(fields[voltageColumns[p]].c_str());
+            phases = p + 1;
+        }
+        float frequencySum = 0.0f;
+        int frequencyCount = 0;
+        for (int p = 0; p < 3 && frequencyColumns[p] >= 0; p++) {
+            float f = (float)atof(fields[frequencyColumns[p]].c_str());
+            if (f > 0.0f) {
+                frequencySum += f;
+                frequencyCount++;
+            }
+        }
+        data.voltageA = voltages[0];
+        data.voltageB = voltages[1];
+        data.voltageC = voltages[2];
+        data.frequencyAvg = frequencyCount > 0 ? frequencySum / frequencyCount : 0.0f;
+        data.unbalance = unbalanceColumn >= 0 ? (float)atof(fields[unbalanceColumn].c_str()) : 0.0f;
+        if (flagsColumn >= 0) {
+            long flags = strtol(fields[flagsColumn].c_str(), nullptr, 10);
+            flagChanges += lastFlags >= 0 && flags != lastFlags ? 1 : 0;
+            lastFlags = flags;
+        }
+
+        uint32_t timeMs = (uint32_t)strtoull(fields[timeColumn].c_str(), nullptr, 10);
+        if (rows == 0) {
+            firstMs = timeMs;
+        }
+        lastMs = timeMs;
+        rows++;
+
+        int count = engine.update(data, phases, timeMs, events);
+        for (int i = 0; i < count; i++) {
+            const AlertEvent& e = events[i];
+            const AlertRule& rule = engine.getRule(e.rule);
+            printf("%10.1f s: %-22s %-8s %-7s phase %s, %.2f (%s %lu ms)\n", e.timeMs / 1000.0f, rule.name,
+                   AlertEngine::severityName(rule.severity), e.active ? "raised" : "cleared",
+                   e.phase >= 0 ? AlertEngine::phaseName(e.phase) : "-", e.value,
+                   e.active ? "beyond threshold" : "lasted", (unsigned long)e.durationMs);
+        }
+    }
+    fclose(file);
+
+    printf("%u measurements over %.1f min: %d problem flag changes, %lu alert transitions, %d active at the end\n",
+           rows, (lastMs - firstMs) / 60000.0f, flagChanges, (unsigned long)engine.getTransitionCount(),
+           engine.getActiveCount());
+    return 0;
+}
+
+int runAlertSim(const char* csvPath) {
+    if (csvPath != nullptr) {
+        return runTrace(csvPath);
+    }
+
+    printf("Alert check: ALERT_RULES, measurements every %d ms, webhook on 127.0.0.1\n\n", STEP_MS);
+    static const char* const names[] = {
+        "phase_loss", "overvoltage", "overvoltage_critical", "unbalance", "frequency_high"
+    };
+    AlertEngine engine;
+    if (!checkRules(engine, names, sizeof(names) / sizeof(names[0]))) {
+        printf("\nAlert check FAILED\n");
+        return 1;
+    }
+
+    bool ok = checkHover();
+    ok &= checkSwell();
+    ok &= checkPhaseLoss();
+    ok &= checkFrequency();
+    ok &= checkUnbalanceAndGap();
+    ok &= checkWebhook();
+
+    printf("\nAlert check %s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
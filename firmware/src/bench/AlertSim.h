@@ -0,0 +1,25 @@
+#ifndef ALERT_SIM_H
+#define ALERT_SIM_H
+
+/**
+ * Проверка тревог (AlertEngine) и их доставки на webhook (AlertNotifier)
+ *
+ * Без файла — сценарии измерений раз в секунду с правилами ALERT_RULES:
+ * напряжение, колеблющееся около VOLTAGE_MAX (одна тревога вместо десятков
+ * смен флага highVoltage), короткий и длительный выброс, скачок выше
+ * критического порога, пропажа и возвращение фазы (без попутных тревог
+ * напряжения и перекоса), частота в полосе гистерезиса, перекос, пропуск
+ * измерений. Затем уведомления уходят на встроенный получатель (HTTP на
+ * 127.0.0.1): задержка от измерения до получения, одно соединение на все,
+ * повторы с удвоением задержки по виртуальным часам, порядок за
+ * повторяемым, 4xx без повторов, отказ после ALERT_MAX_ATTEMPTS, граница
+ * очереди.
+ *
+ * С файлом — запись PowerData в CSV (bench --replay --csv) прогоняется через
+ * правила: печатаются переходы и сравниваются со сменами problem_flags.
+ * @param csvPath nullptr — сценарии
+ * @return Код выхода процесса (1 — проверка не прошла)
+ */
+int runAlertSim(const char* csvPath);
+
+#endif // ALERT_SIM_H
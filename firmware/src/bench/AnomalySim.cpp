@@ -0,0 +1,315 @@
+#include "AnomalySim.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "../config.h"
+#include "../AnomalyDetector.h"
+
+/**
+ * Детерминированный xorshift32: один и тот же прогон при каждом запуске
+ */
+static uint32_t randomState = 2463534242u;
+
+static uint32_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+/**
+ * Нормальное распределение (Бокс — Мюллер)
+ */
+static float gaussian(float sigma) {
+    float u1 = (nextRandom() % 1000000 + 1) / 1000001.0f;
+    float u2 = (nextRandom() % 1000000) / 1000000.0f;
+    return sigma * sqrtf(-2.0f * logf(u1)) * cosf(2.0f * (float)M_PI * u2);
+}
+
+/**
+ * Медленное блуждание AR(1): постоянная времени tauS, разброс sigma
+ */
+struct Wander {
+    float value;
+    float decay;
+    float innovation;
+
+    Wander(float tauS, float sigma)
+        : value(0.0f),
+          decay(expf(-1.0f / tauS)),
+          innovation(sigma * sqrtf(1.0f - expf(-2.0f / tauS))) {}
+
+    float next() {
+        value = value * decay + gaussian(innovation);
+        return value;
+    }
+};
+
+/**
+ * Вставленная аномалия и что детектор должен о ней сказать
+ */
+struct Injected {
+    const char* name;
+    AnomalyMetric metric;
+    AnomalyKind kind;
+    uint32_t startS;            // От начала записи
+    uint32_t endS;
+    uint32_t maxDelayS;         // Допустимая задержка обнаружения
+    uint32_t detectedS;         // 0 — не найдена
+};
+
+#define DAY_S 86400
+#define HOUR_S 3600
+
+// Событие того же ряда в пределах этого времени после конца аномалии — её хвост
+#define TAIL_S 1800
+
+int runAnomalySim(uint32_t days) {
+    if (days < 7) {
+        fprintf(stderr, "--anomaly-sim needs at least 7 days (2 to learn, then anomalies)\n");
+        return 1;
+    }
+
+    // Номера суток считаются от 0; первые двое — только обучение
+    Injected injected[] = {
+        {"sag 1 s, phase A -30 V", ANOMALY_VOLTAGE_A, AnomalyKind::SPIKE,
+         3 * DAY_S + 10 * HOUR_S, 3 * DAY_S + 10 * HOUR_S + 1, 0, 0},
+        {"step phase B +4 V, 2 h", ANOMALY_VOLTAGE_B, AnomalyKind::SHIFT_UP,
+         3 * DAY_S + 14 * HOUR_S, 3 * DAY_S + 16 * HOUR_S, 600, 0},
+        {"frequency -0.1 Hz, 20 min", ANOMALY_FREQUENCY, AnomalyKind::SHIFT_DOWN,
+         4 * DAY_S + 3 * HOUR_S, 4 * DAY_S + 3 * HOUR_S + 1200, 300, 0},
+        {"new evening sag A -6 V", ANOMALY_VOLTAGE_A, AnomalyKind::SHIFT_DOWN,
+         5 * DAY_S + 18 * HOUR_S, 5 * DAY_S + 22 * HOUR_S, 900, 0},
+        {"drift phase C +1.5 V/day", ANOMALY_VOLTAGE_C, AnomalyKind::SHIFT_UP,
+         4 * DAY_S, days * DAY_S, 2 * DAY_S, 0},
+    };
+    const int injectedCount = sizeof(injected) / sizeof(injected[0]);
+
+    AnomalyDetector detector;
+    AnomalyEvent events[ANOMALY_MAX_EVENTS];
+    const uint32_t start = 1760000000u / DAY_S * DAY_S;
+    const uint32_t total = days * DAY_S;
+
+    Wander voltageWander[3] = {Wander(120.0f, 0.8f), Wander(120.0f, 0.8f), Wander(120.0f, 0.8f)};
+    Wander commonWander(600.0f, 0.6f);
+    Wander frequencyWander(60.0f, 0.02f);
+    const float phaseOffset[3] = {0.0f, -1.5f, 1.0f};
+
+    uint32_t falseEvents[ANOMALY_METRICS] = {0, 0, 0, 0};
+    uint32_t learnS = 2 * DAY_S;
+    double updateNs = 0.0;
+    size_t lineLength = 0;
+    static char lines[ANOMALY_LINE_PROTOCOL_SIZE];
+    static char lastLines[ANOMALY_LINE_PROTOCOL_SIZE];
+
+    printf("Anomaly detector: %u days of 1 s measurements, learning for the first %u\n", days, learnS / DAY_S);
+    for (uint32_t t = 0; t < total; t++) {
+        float hour = (t % DAY_S) / (float)HOUR_S;
+        float daily = 0.04f * NOMINAL_VOLTAGE * sinf(2.0f * (float)M_PI * (hour - 9.0f) / 24.0f);
+        float common = commonWander.next();
+
+        PowerData data;
+        memset(&data, 0, sizeof(data));
+        float voltages[3];
+        for (int p = 0; p < 3; p++) {
+            voltages[p] = NOMINAL_VOLTAGE + daily + phaseOffset[p] + common + voltageWander[p].next() + gaussian(0.15f);
+        }
+        data.frequencyAvg = NOMINAL_FREQUENCY + frequencyWander.next() + gaussian(0.002f);
+
+        // Размеченные аномалии
+        if (t == injected[0].startS) {
+            voltages[0] -= 30.0f;
+        }
+        if (t >= injected[1].startS && t < injected[1].endS) {
+            voltages[1] += 4.0f;
+        }
+        if (t >= injected[2].startS && t < injected[2].endS) {
+            data.frequencyAvg -= 0.1f;
+        }
+        if (t >= injected[3].startS && t < injected[3].endS) {
+            voltages[0] -= 6.0f * fminf(1.0f, (t - injected[3].startS) / 600.0f);
+        }
+        if (t >= injected[4].startS) {
+            voltages[2] += 1.5f * (t - injected[4].startS) / DAY_S;
+        }
+        data.voltageA = voltages[0];
+        data.voltageB = voltages[1];
+        data.voltageC = voltages[2];
+        data.voltageAvg = (voltages[0] + voltages[1] + voltages[2]) / 3.0f;
+
+        auto began = std::chrono::steady_clock::now();
+        int count = detector.update(data, 3, start + t, events);
+        updateNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - began).count();
+
+        for (int i = 0; i < count; i++) {
+            const AnomalyEvent& e = events[i];
+            bool matched = false;
+            for (int k = 0; k < injectedCount; k++) {
+                Injected& a = injected[k];
+                if (e.metric != a.metric || t < a.startS || t >= a.endS + TAIL_S) {
+                    continue;
+                }
+                matched = true;
+                if (a.detectedS == 0 && e.kind == a.kind) {
+                    a.detectedS = t + 1;
+                }
+            }
+            if (!matched && t >= learnS) {
+                falseEvents[e.metric]++;
+                printf("  false: day %u %02u:%02u:%02u %s %s score %.1f, %.3f vs %.3f (sigma %.3f)\n",
+                       t / DAY_S, t % DAY_S / HOUR_S, t % HOUR_S / 60, t % 60,
+                       AnomalyDetector::metricName(e.metric), AnomalyDetector::kindName(e.kind),
+                       e.score, e.value, e.baseline, e.sigma);
+            }
+        }
+        if (count > 0) {
+            lineLength = AnomalyDetector::writeLineProtocol(events, count, lines, sizeof(lines), "esp32-001");
+            if (lineLength > 0) {
+                memcpy(lastLines, lines, lineLength + 1);
+            }
+        }
+    }
+
+    bool ok = true;
+    printf("\n%-28s %-10s %-10s %12s %10s\n", "injected", "metric", "expect", "delay", "limit");
+    for (int k = 0; k < injectedCount; k++) {
+        const Injected& a = injected[k];
+        bool found = a.detectedS != 0 && a.detectedS - 1 - a.startS <= a.maxDelayS;
+        ok = ok && found;
+        if (a.detectedS == 0) {
+            printf("%-28s %-10s %-10s %12s %9us  MISSED\n", a.name, AnomalyDetector::metricName(a.metric),
+                   AnomalyDetector::kindName(a.kind), "-", a.maxDelayS);
+        } else {
+            printf("%-28s %-10s %-10s %11us %9us%s\n", a.name, AnomalyDetector::metricName(a.metric),
+                   AnomalyDetector::kindName(a.kind), a.detectedS - 1 - a.startS, a.maxDelayS,
+                   found ? "" : "  LATE");
+        }
+    }
+
+    // Ложные события: не больше одного на ряд за неделю
+    float monitoredDays = (float)(total - learnS) / DAY_S;
+    uint32_t falseTotal = 0;
+    printf("\nFalse events after learning (%.0f days):", monitoredDays);
+    for (int m = 0; m < ANOMALY_METRICS; m++) {
+        printf(" %s %u", AnomalyDetector::metricName((AnomalyMetric)m), falseEvents[m]);
+        falseTotal += falseEvents[m];
+    }
+    float perMetricWeek = falseTotal / (float)ANOMALY_METRICS / monitoredDays * 7.0f;
+    printf(" -> %.2f per series per week%s\n", perMetricWeek, perMetricWeek <= 1.0f ? "" : "  TOO MANY");
+    ok = ok && perMetricWeek <= 1.0f;
+
+    printf("Cost:           update %.0f ns/measurement (%d series), state %zu bytes\n",
+           updateNs / total, ANOMALY_METRICS, sizeof(AnomalyDetector));
+    printf("Published:      %zu bytes for the last events:\n%s", lineLength, lastLines);
+    return ok ? 0 : 1;
+}
+
+/**
+ * Номер столбца по заголовку CSV, -1 если нет
+ */
+static int columnOf(const std::vector<std::string>& header, const char* name) {
+    for (size_t i = 0; i < header.size(); i++) {
+        if (header[i] == name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static std::vector<std::string> splitCsv(const char* line) {
+    std::vector<std::string> fields;
+    std::string field;
+    for (const char* c = line; *c != '\0' && *c != '\n' && *c != '\r'; c++) {
+        if (*c == ',') {
+            fields.push_back(field);
+            field.clear();
+        } else {
+            field += *c;
+        }
+    }
+    fields.push_back(field);
+    return fields;
+}
+
+int runAnomalyTrace(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return 1;
+    }
+    static char line[1024];
+    if (fgets(line, sizeof(line), file) == nullptr) {
+        fprintf(stderr, "%s: empty\n", path);
+        fclose(file);
+        return 1;
+    }
+    std::vector<std::string> header = splitCsv(line);
+    int timeColumn = columnOf(header, "timestamp_ms");
+    int voltageColumns[3] = {columnOf(header, "voltage_a"), columnOf(header, "voltage_b"), columnOf(header, "voltage_c")};
+    int frequencyColumns[3] = {columnOf(header, "frequency_a"), columnOf(header, "frequency_b"), columnOf(header, "frequency_c")};
+    if (timeColumn < 0 || voltageColumns[0] < 0 || frequencyColumns[0] < 0) {
+        fprintf(stderr, "%s: needs timestamp_ms, voltage_a and frequency_a columns (bench --replay --csv)\n", path);
+        fclose(file);
+        return 1;
+    }
+
+    AnomalyDetector detector;
+    AnomalyEvent events[ANOMALY_MAX_EVENTS];
+    uint32_t rows = 0;
+    uint32_t firstS = 0;
+    uint32_t lastS = 0;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        std::vector<std::string> fields = splitCsv(line);
+        if ((int)fields.size() < (int)header.size()) {
+            continue;
+        }
+        PowerData data;
+        memset(&data, 0, sizeof(data));
+        float voltages[3] = {0.0f, 0.0f, 0.0f};
+        int phases = 0;
+        for (int p = 0; p < 3 && voltageColumns[p] >= 0; p++) {
+            voltages[p] = (float)atof(fields[voltageColumns[p]].c_str());
+            phases = p + 1;
+        }
+        float frequencySum = 0.0f;
+        int frequencyCount = 0;
+        for (int p = 0; p < 3 && frequencyColumns[p] >= 0; p++) {
+            float f = (float)atof(fields[frequencyColumns[p]].c_str());
+            if (f > 0.0f) {
+                frequencySum += f;
+                frequencyCount++;
+            }
+        }
+        data.voltageA = voltages[0];
+        data.voltageB = voltages[1];
+        data.voltageC = voltages[2];
+        data.frequencyAvg = frequencyCount > 0 ? frequencySum / frequencyCount : 0.0f;
+
+        uint32_t timeS = (uint32_t)(strtoull(fields[timeColumn].c_str(), nullptr, 10) / 1000);
+        if (rows == 0) {
+            firstS = timeS;
+        }
+        lastS = timeS;
+        rows++;
+
+        int count = detector.update(data, phases, timeS, events);
+        for (int i = 0; i < count; i++) {
+            const AnomalyEvent& e = events[i];
+            printf("%u s: %s %s score %.1f, %.3f vs baseline %.3f (sigma %.3f)\n",
+                   e.timeS, AnomalyDetector::metricName(e.metric), AnomalyDetector::kindName(e.kind),
+                   e.score, e.value, e.baseline, e.sigma);
+        }
+    }
+    fclose(file);
+
+    bool warmedUp = detector.isWarmedUp(ANOMALY_VOLTAGE_A);
+    printf("%u measurements over %.1f h, %u events\n", rows, (lastS - firstS) / 3600.0f, detector.getEventCount());
+    if (!warmedUp) {
+        printf("Baselines still learning: each hour of day needs %d measurements before events\n", ANOMALY_WARMUP);
+    }
+    return 0;
+}
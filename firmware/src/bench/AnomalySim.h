@@ -0,0 +1,29 @@
+#ifndef ANOMALY_SIM_H
+#define ANOMALY_SIM_H
+
+#include <stdint.h>
+
+/**
+ * Проверка AnomalyDetector на размеченной записи
+ *
+ * Сутки измерений раз в секунду: суточный ход напряжения, коррелированные
+ * блуждания напряжения и частоты (AR(1)) и белый шум. С четвёртых суток
+ * вставлены размеченные аномалии: одиночный провал, ступень на фазе B,
+ * ступень частоты, вечерняя просадка, которой не было в прошлые дни, и
+ * медленный дрейф фазы C. Запись прогоняется через детектор; печатается
+ * задержка обнаружения каждой аномалии, ложные события на ряд в неделю и стоимость
+ * update().
+ * @param days Моделируемых суток (не меньше 7)
+ * @return Код выхода процесса (1 — аномалия не найдена или ложных событий много)
+ */
+int runAnomalySim(uint32_t days);
+
+/**
+ * Прогнать через AnomalyDetector запись PowerData в CSV (bench --replay --csv
+ * или выгрузка истории с теми же столбцами) и напечатать события.
+ * Время — timestamp_ms / 1000.
+ * @return Код выхода процесса
+ */
+int runAnomalyTrace(const char* path);
+
+#endif // ANOMALY_SIM_H
@@ -0,0 +1,549 @@
+/**
+ * Бенчмарк измерительного конвейера на хосте ([env:native])
+ *
+ * Синтетическая трёхфазная сеть подаётся через NativeHal на те же классы,
+ * что работают на ESP32. Для каждой стадии печатаются нс/операцию,
+ * отсчётов/с и выделения памяти на операцию, чтобы регрессии были видны
+ * до прошивки устройств.
+ *
+ *   pio run -e native && .pio/build/native/program --voltage 230 --csv
+ *
+ * Воспроизведение захвата с устройства (CaptureFormat.h):
+ *   program --replay capture.bin --csv > golden.csv      PowerData каждого блока
+ *   program --replay capture.bin --repeat 100            пропускная способность
+ *   program --write-capture synth.bin --blocks 3600      час синтетической сети
+ *
+ * Износ флеша и потери накопителей при отключении питания (PersistentStats):
+ *   program --persist-sim 30
+ *
+ * Статистика EN 50160 (THD и недельные итоги ComplianceStats против эталона):
+ *   program --compliance-sim 2
+ *
+ * Детектор аномалий (AnomalyDetector): размеченная запись с ровно известными
+ * аномалиями или CSV, снятый --replay --csv:
+ *   program --anomaly-sim 7
+ *   program --anomaly-trace golden.csv
+ *
+ * Синхрофазоры (PhasorEstimator, кадры C37.118): TVE, FE и RFE на
+ * синтетических сигналах с известными фазорами:
+ *   program --pmu-check
+ *
+ * Частота по периодам и ROCOF (FrequencyTracker): ход частоты с известным
+ * наклоном, отключение генератора, обрыв фазы:
+ *   program --rocof-sim
+ *
+ * Бортовой самописец (FlightRecorder): провал напряжения, перезагрузка по
+ * просадке и восстановление записи из сохраняемой памяти:
+ *   program --flight-sim
+ *
+ * Входной тракт с передискретизацией (Decimator): АЧХ, подавление наложения,
+ * снижение шума, цена кадра, выигрыш бит в кадрах против getEnobGain();
+ * путь через анализатор при OVERSAMPLE_FACTOR > 1:
+ *   program --frontend-check
+ *
+ * Распределение напряжения по периодам (VoltageHistogram): счётчики корзин,
+ * RLE точки voltage_histogram и её размер:
+ *   program --histogram-sim
+ *
+ * История в памяти (HistoryStore): уровни, шаг, пропуски, ответ JSON по
+ * кускам и время его генерации:
+ *   program --history-sim
+ *
+ * Быстрый запуск: время до первого измерения и смещения по одному блоку,
+ * досылка секунд до первой отправки из истории, точка boot:
+ *   program --boot-sim
+ *
+ * HTTPS к InfluxDB (HttpConnection): постоянное соединение, возобновление
+ * сессий TLS, отпечаток ключа — против встроенной заглушки или своего
+ * сервера за TLS (например, stunnel перед InfluxDB):
+ *   program --tls-check [https://host:port]
+ *
+ * Тревоги (AlertEngine, AlertNotifier): гистерезис, минимальная длительность,
+ * пропажа фазы, доставка на webhook с повторами и границей очереди; или
+ * переходы по CSV, снятому --replay --csv:
+ *   program --alert-sim [golden.csv]
+ *
+ * Report-by-exception (DeadbandFilter): доля подавленных точек, интервал
+ * heartbeat, полная отправка при смене флагов — на синтетике или по CSV,
+ * снятому --replay --csv:
+ *   program --deadband-sim [golden.csv]
+ *
+ * Глубокий захват (DeepCapture): запись встык, огибающая и поток по кускам;
+ * с --write-capture поток сохраняется для --replay:
+ *   program --deep-capture 10 [--write-capture deep.bin]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include "../config.h"
+#include "../hal/Hal.h"
+#include "../hal/HalNative.h"
+#include "../PowerAnalyzer.h"
+#include "../Oscilloscope.h"
+#include "../TelemetryCodec.h"
+#include "../DeadbandFilter.h"
+#include "../Profiler.h"
+#include "SyntheticGrid.h"
+#include "Replay.h"
+#include "PersistSim.h"
+#include "DeepCaptureBench.h"
+#include "ComplianceSim.h"
+#include "AnomalySim.h"
+#include "PmuCheck.h"
+#include "RocofSim.h"
+#include "FlightSim.h"
+#include "FrontEndCheck.h"
+#include "HistogramSim.h"
+#include "HistorySim.h"
+#include "BootSim.h"
+#include "TlsCheck.h"
+#include "AlertSim.h"
+#include "DeadbandSim.h"
+#include "BoardVariants.h"
+
+// =============================================================================
+// Подсчёт выделений памяти (глобальные operator new/delete)
+// =============================================================================
+static std::atomic<uint64_t> allocCount(0);
+static std::atomic<uint64_t> allocBytes(0);
+
+void* operator new(size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+// =============================================================================
+// Замер стадии
+// =============================================================================
+struct BenchOptions {
+    float voltage = NOMINAL_VOLTAGE;
+    float frequency = NOMINAL_FREQUENCY;
+    int noise = 8;
+    float current = 10.0f;
+    float lag = 30.0f;
+    int minMs = 300;
+    bool csv = false;
+    const char* replayPath = nullptr;
+    const char* capturePath = nullptr;
+    int repeat = 1;
+    uint32_t blocks = 60;
+    uint32_t persistDays = 0;
+    uint32_t deepSeconds = 0;
+    uint32_t complianceWeeks = 0;
+    uint32_t anomalyDays = 0;
+    const char* anomalyTracePath = nullptr;
+    bool pmuCheck = false;
+    bool rocofSim = false;
+    bool flightSim = false;
+    bool frontEndCheck = false;
+    bool histogramSim = false;
+    bool historySim = false;
+    bool bootSim = false;
+    bool tlsCheck = false;
+    const char* tlsUrl = nullptr;
+    bool alertSim = false;
+    const char* alertTracePath = nullptr;
+    bool deadbandSim = false;
+    const char* deadbandTracePath = nullptr;
+};
+
+static BenchOptions options;
+
+/**
+ * Выполнять op партиями, пока суммарное время не превысит options.minMs
+ * @param samplesPerOp Отсчётов АЦП за одну операцию (0 — не печатать отсчёты/с)
+ */
+template <typename Op>
+static void runStage(const char* name, uint32_t samplesPerOp, Op op) {
+    using Clock = std::chrono::steady_clock;
+
+    // Прогрев (кэши, ленивые инициализации)
+    for (int i = 0; i < 3; i++) {
+        op();
+    }
+
+    uint64_t ops = 0;
+    uint64_t allocsBefore = allocCount.load();
+    uint64_t bytesBefore = allocBytes.load();
+    double elapsedNs = 0;
+    uint64_t batch = 1;
+
+    while (elapsedNs < options.minMs * 1e6) {
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < batch; i++) {
+            op();
+        }
+        elapsedNs += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        ops += batch;
+        if (batch < (1u << 20)) {
+            batch *= 2;
+        }
+    }
+
+    double nsPerOp = elapsedNs / ops;
+    double samplesPerSec = samplesPerOp > 0 ? samplesPerOp * 1e9 / nsPerOp : 0;
+    double allocsPerOp = (double)(allocCount.load() - allocsBefore) / ops;
+    double bytesPerOp = (double)(allocBytes.load() - bytesBefore) / ops;
+
+    if (options.csv) {
+        printf("%s,%llu,%.1f,%.0f,%.2f,%.1f\n", name, (unsigned long long)ops, nsPerOp,
+               samplesPerSec, allocsPerOp, bytesPerOp);
+    } else if (samplesPerOp > 0) {
+        printf("%-34s %10.0f %14.0f %10.2f %10.1f\n", name, nsPerOp, samplesPerSec, allocsPerOp, bytesPerOp);
+    } else {
+        printf("%-34s %10.0f %14s %10.2f %10.1f\n", name, nsPerOp, "-", allocsPerOp, bytesPerOp);
+    }
+}
+
+/**
+ * Замер ядра analyze() другого варианта платы на блоке с синтетической сети
+ */
+template <typename Analyzer>
+static void runVariant(const char* name, const int (&pins)[Analyzer::CHANNELS]) {
+    float calibration[Analyzer::CHANNELS];
+    for (int ch = 0; ch < Analyzer::CHANNELS; ch++) {
+        calibration[ch] = ch < Analyzer::VOLTAGE_CHANNELS ? CALIBRATION_COEFF_A : CT_CALIBRATION_A;
+    }
+    static Analyzer analyzer(pins, calibration);
+    analyzer.begin();
+    PowerData data = analyzer.measure();
+
+    runStage(name, Analyzer::BLOCK_SAMPLES, [&]() {
+        data = analyzer.analyze(analyzer.getLastBlock(), analyzer.getLastBlockFrames(), data.timestamp);
+    });
+}
+
+/**
+ * Осциллограмма — те же отсчёты, что и измерение: RMS по целым периодам
+ * окна со смещениями и калибровкой из снимка против RMS блока
+ */
+static void printScopeCheck(const WaveformData& waveform, const PowerData& data) {
+    static const char names[3] = {'A', 'B', 'C'};
+    const int16_t* samples[3] = {waveform.phaseA, waveform.phaseB, waveform.phaseC};
+    const float measured[3] = {data.voltageA, data.voltageB, data.voltageC};
+    int periodPoints = (int)(1000000.0f / NOMINAL_FREQUENCY / WAVEFORM_INTERVAL_US + 0.5f);
+    int points = (int)waveform.sampleCount / periodPoints * periodPoints;
+
+    printf("Scope tap:     ");
+    for (int ph = 0; ph < 3 && points > 0; ph++) {
+        double sumSquares = 0.0;
+        for (int i = 0; i < points; i++) {
+            double d = samples[ph][i] - waveform.offsets[ph];
+            sumSquares += d * d;
+        }
+        printf(" %c=%.1f V (measured %.1f)", names[ph], sqrt(sumSquares / points) * waveform.voltsPerCount[ph],
+               measured[ph]);
+    }
+    printf(", %d points from the analyzed block\n\n", (int)waveform.sampleCount);
+}
+
+/**
+ * Проверка мощности на плате с трансформаторами тока: синтетические токи
+ * без фазовой ошибки ТТ, поэтому компенсация выключена
+ */
+static void printLoadCheck() {
+    static WyeSixChannelAnalyzer analyzer({PIN_PHASE_A, PIN_PHASE_B, PIN_PHASE_C,
+                                           PIN_CURRENT_A, PIN_CURRENT_B, PIN_CURRENT_C},
+                                          {CALIBRATION_COEFF_A, CALIBRATION_COEFF_B, CALIBRATION_COEFF_C,
+                                           CT_CALIBRATION_A, CT_CALIBRATION_B, CT_CALIBRATION_C});
+    for (int k = 0; k < WyeSixChannelAnalyzer::CURRENT_CHANNELS; k++) {
+        analyzer.setPhaseCorrection(k, 0.0f);
+    }
+    analyzer.begin();
+    PowerData data = analyzer.measure();
+
+    printf("Load:           %.1f A lagging %.1f deg\n", options.current, options.lag);
+    printf("Measured:       I=%.2f A, P=%.1f W, Q=%.1f var, S=%.1f VA, PF=%.3f, angle=%.1f deg\n\n",
+           data.currentA, data.activePower, data.reactivePower, data.apparentPower,
+           data.powerFactor, data.phaseAngleA);
+}
+
+static void parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--voltage") == 0 && hasValue) {
+            options.voltage = atof(argv[++i]);
+        } else if (strcmp(arg, "--frequency") == 0 && hasValue) {
+            options.frequency = atof(argv[++i]);
+        } else if (strcmp(arg, "--noise") == 0 && hasValue) {
+            options.noise = atoi(argv[++i]);
+        } else if (strcmp(arg, "--current") == 0 && hasValue) {
+            options.current = atof(argv[++i]);
+        } else if (strcmp(arg, "--lag") == 0 && hasValue) {
+            options.lag = atof(argv[++i]);
+        } else if (strcmp(arg, "--min-ms") == 0 && hasValue) {
+            options.minMs = atoi(argv[++i]);
+        } else if (strcmp(arg, "--csv") == 0) {
+            options.csv = true;
+        } else if (strcmp(arg, "--replay") == 0 && hasValue) {
+            options.replayPath = argv[++i];
+        } else if (strcmp(arg, "--repeat") == 0 && hasValue) {
+            options.repeat = atoi(argv[++i]);
+        } else if (strcmp(arg, "--write-capture") == 0 && hasValue) {
+            options.capturePath = argv[++i];
+        } else if (strcmp(arg, "--blocks") == 0 && hasValue) {
+            options.blocks = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(arg, "--persist-sim") == 0 && hasValue) {
+            options.persistDays = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(arg, "--compliance-sim") == 0 && hasValue) {
+            options.complianceWeeks = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(arg, "--anomaly-sim") == 0 && hasValue) {
+            options.anomalyDays = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(arg, "--anomaly-trace") == 0 && hasValue) {
+            options.anomalyTracePath = argv[++i];
+        } else if (strcmp(arg, "--pmu-check") == 0) {
+            options.pmuCheck = true;
+        } else if (strcmp(arg, "--rocof-sim") == 0) {
+            options.rocofSim = true;
+        } else if (strcmp(arg, "--flight-sim") == 0) {
+            options.flightSim = true;
+        } else if (strcmp(arg, "--frontend-check") == 0) {
+            options.frontEndCheck = true;
+        } else if (strcmp(arg, "--histogram-sim") == 0) {
+            options.histogramSim = true;
+        } else if (strcmp(arg, "--history-sim") == 0) {
+            options.historySim = true;
+        } else if (strcmp(arg, "--boot-sim") == 0) {
+            options.bootSim = true;
+        } else if (strcmp(arg, "--tls-check") == 0) {
+            options.tlsCheck = true;
+            if (hasValue && argv[i + 1][0] != '-') {
+                options.tlsUrl = argv[++i];
+            }
+        } else if (strcmp(arg, "--alert-sim") == 0) {
+            options.alertSim = true;
+            if (hasValue && argv[i + 1][0] != '-') {
+                options.alertTracePath = argv[++i];
+            }
+        } else if (strcmp(arg, "--deadband-sim") == 0) {
+            options.deadbandSim = true;
+            if (hasValue && argv[i + 1][0] != '-') {
+                options.deadbandTracePath = argv[++i];
+            }
+        } else if (strcmp(arg, "--deep-capture") == 0 && hasValue) {
+            options.deepSeconds = strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--voltage V] [--frequency HZ] [--noise COUNTS] [--current A] [--lag DEG]\n"
+                    "          [--min-ms MS] [--csv]\n"
+                    "       %s --replay FILE [--repeat N] [--csv]\n"
+                    "       %s --write-capture FILE [--blocks N] [--voltage V] [--frequency HZ] [--noise COUNTS]\n"
+                    "       %s --persist-sim DAYS\n"
+                    "       %s --compliance-sim WEEKS\n"
+                    "       %s --anomaly-sim DAYS | --anomaly-trace CSV\n"
+                    "       %s --pmu-check\n"
+                    "       %s --rocof-sim\n"
+                    "       %s --flight-sim\n"
+                    "       %s --frontend-check\n"
+                    "       %s --histogram-sim\n"
+                    "       %s --history-sim\n"
+                    "       %s --boot-sim\n"
+                    "       %s --tls-check [URL]\n"
+                    "       %s --alert-sim [CSV]\n"
+                    "       %s --deadband-sim [CSV]\n"
+                    "       %s --deep-capture SECONDS [--write-capture FILE] [--voltage V] [--noise COUNTS]\n",
+                    argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
+                    argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+            exit(2);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    parseArgs(argc, argv);
+
+    NativeHal::setLogEnabled(false);
+
+    if (options.replayPath != nullptr) {
+        return runReplay(options.replayPath, options.repeat > 0 ? options.repeat : 1, options.csv);
+    }
+    if (options.persistDays > 0) {
+        return runPersistSim(options.persistDays);
+    }
+    if (options.complianceWeeks > 0) {
+        return runComplianceSim(options.complianceWeeks);
+    }
+    if (options.anomalyDays > 0) {
+        return runAnomalySim(options.anomalyDays);
+    }
+    if (options.anomalyTracePath != nullptr) {
+        return runAnomalyTrace(options.anomalyTracePath);
+    }
+    if (options.pmuCheck) {
+        return runPmuCheck();
+    }
+    if (options.rocofSim) {
+        return runRocofSim();
+    }
+    if (options.flightSim) {
+        return runFlightSim();
+    }
+    if (options.frontEndCheck) {
+        return runFrontEndCheck();
+    }
+    if (options.histogramSim) {
+        return runHistogramSim();
+    }
+    if (options.historySim) {
+        return runHistorySim();
+    }
+    if (options.bootSim) {
+        return runBootSim();
+    }
+    if (options.tlsCheck) {
+        return runTlsCheck(options.tlsUrl);
+    }
+    if (options.alertSim) {
+        return runAlertSim(options.alertTracePath);
+    }
+    if (options.deadbandSim) {
+        return runDeadbandSim(options.deadbandTracePath);
+    }
+
+    SyntheticGrid grid(options.voltage, options.frequency, options.noise);
+    grid.setLoad(options.current, options.lag);
+    if (options.deepSeconds > 0) {
+        return runDeepCaptureBench(options.deepSeconds, grid, options.voltage, options.capturePath);
+    }
+    if (options.capturePath != nullptr) {
+        return writeSyntheticCapture(options.capturePath, options.blocks, grid);
+    }
+    NativeHal::setAdcSource(&grid);
+
+    PowerAnalyzer analyzer(ANALYZER_CHANNEL_PINS, ANALYZER_CHANNEL_CALIBRATION);
+    analyzer.begin();
+
+    Oscilloscope oscilloscope;
+    float offsets[PowerAnalyzer::VOLTAGE_CHANNELS];
+    float sensitivities[PowerAnalyzer::VOLTAGE_CHANNELS];
+
+    // Проверка, что конвейер считает правильно, иначе скорость ничего не значит
+    PowerData data = analyzer.measure();
+    for (int ch = 0; ch < PowerAnalyzer::VOLTAGE_CHANNELS; ch++) {
+        offsets[ch] = analyzer.getOffset(ch);
+        sensitivities[ch] = analyzer.getSensitivity(ch);
+    }
+    auto tap = [&]() {
+        oscilloscope.tap(analyzer.getLastBlock(), analyzer.getLastBlockFrames(), PowerAnalyzer::CHANNELS,
+                         PowerAnalyzer::VOLTAGE_CHANNELS, offsets, sensitivities, PowerAnalyzer::FRAME_SCALE,
+                         PowerAnalyzer::INTERVAL_US, data.timestamp);
+    };
+    tap();
+    const WaveformData& waveform = oscilloscope.getData();
+
+    if (!options.csv) {
+        printf("Synthetic grid: %.1f V, %.2f Hz, noise ±%d counts\n",
+               options.voltage, options.frequency, options.noise);
+        printf("Measured:       A=%.1f B=%.1f C=%.1f V, AB=%.1f V, f=%.3f Hz, unbalance=%.2f %%, %s\n\n",
+               data.voltageA, data.voltageB, data.voltageC, data.voltageAB,
+               data.frequencyAvg, data.unbalance, analyzer.getProblemsDescription());
+        printScopeCheck(waveform, data);
+        printLoadCheck();
+        printf("%-34s %10s %14s %10s %10s\n", "stage", "ns/op", "samples/s", "allocs/op", "bytes/op");
+    } else {
+        printf("stage,ops,ns_per_op,samples_per_s,allocs_per_op,bytes_per_op\n");
+    }
+
+    static char powerLines[POWER_LINE_PROTOCOL_SIZE];
+    static char waveformLines[WAVEFORM_LINE_PROTOCOL_SIZE];
+    static uint8_t record[TELEMETRY_MAX_RECORD_SIZE];
+    DeadbandFilter deadband;
+    uint32_t seq = 0;
+    volatile size_t sink = 0;
+
+    runStage("VoltageSensor::readRMS (1 phase)", SAMPLES_PER_READING, [&]() {
+        VoltageSensor sensor(PIN_PHASE_A, CALIBRATION_COEFF_A);
+        sink = sink + (size_t)sensor.readRMS();
+    });
+
+    runStage("PowerAnalyzer::measure", PowerAnalyzer::BLOCK_SAMPLES, [&]() {
+        data = analyzer.measure();
+    });
+
+    runStage("PowerAnalyzer::analyze (block)", PowerAnalyzer::BLOCK_SAMPLES, [&]() {
+        data = analyzer.analyze(analyzer.getLastBlock(), analyzer.getLastBlockFrames(), data.timestamp);
+    });
+
+    // Те же ядра для других плат (bench/BoardVariants.h)
+    runVariant<SinglePhaseAnalyzer>("analyze: single-phase x1", {PIN_PHASE_A});
+    runVariant<SplitPhaseAnalyzer>("analyze: split-phase x2", {PIN_PHASE_A, PIN_PHASE_B});
+    runVariant<DeltaAnalyzer>("analyze: delta x3", {PIN_PHASE_A, PIN_PHASE_B, PIN_PHASE_C});
+    runVariant<WyeSixChannelAnalyzer>("analyze: wye x6 (V+I)", {PIN_PHASE_A, PIN_PHASE_B, PIN_PHASE_C,
+                                                                PIN_CURRENT_A, PIN_CURRENT_B, PIN_CURRENT_C});
+
+    runStage("Oscilloscope::tap", 3 * WAVEFORM_SAMPLES, tap);
+
+    runStage("DeadbandFilter::update", 0, [&]() {
+        sink = sink + deadband.update(data, seq++ * SEND_INTERVAL_MS);
+    });
+
+    runStage("PowerAnalyzer::writeLineProtocol", 0, [&]() {
+        sink = sink + analyzer.writeLineProtocol(powerLines, sizeof(powerLines), DEVICE_ID);
+    });
+
+    runStage("Oscilloscope::writeLineProtocol", 0, [&]() {
+        sink = sink + oscilloscope.writeLineProtocol(waveformLines, sizeof(waveformLines), DEVICE_ID);
+    });
+
+    runStage("TelemetryCodec::encodePower", 0, [&]() {
+        sink = sink + TelemetryCodec::encodePower(data, seq++, 0, record, sizeof(record));
+    });
+
+    runStage("TelemetryCodec::encodeWaveform", 0, [&]() {
+        sink = sink + TelemetryCodec::encodeWaveform(waveform, waveform.offsets[0], waveform.offsets[1],
+                                                     waveform.offsets[2], seq++, 0, record, sizeof(record));
+    });
+
+    // Цена замера стадии на горячем пути
+    runStage("PROFILE_SCOPE (empty)", 0, [&]() {
+        PROFILE_SCOPE(ProfileStage::CYCLE);
+        sink = sink + 1;
+    });
+
+    static char statsLines[DEVICE_STATS_LINE_PROTOCOL_SIZE];
+    runStage("Profiler::writeLineProtocol", 0, [&]() {
+        sink = sink + Profiler::writeLineProtocol(statsLines, sizeof(statsLines), DEVICE_ID);
+    });
+
+    // Полный цикл одного измерения, как в loop(): измерить, отфильтровать, сериализовать
+    runStage("cycle: measure+deadband+line", PowerAnalyzer::BLOCK_SAMPLES, [&]() {
+        data = analyzer.measure();
+        uint16_t mask = deadband.update(data, Hal::millis());
+        if (mask != 0) {
+            sink = sink + analyzer.writeLineProtocol(powerLines, sizeof(powerLines), DEVICE_ID, mask);
+        }
+    });
+
+    return 0;
+}
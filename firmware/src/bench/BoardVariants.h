@@ -0,0 +1,16 @@
+#ifndef BOARD_VARIANTS_H
+#define BOARD_VARIANTS_H
+
+#include "../config.h"
+#include "../PowerAnalyzer.h"
+
+/**
+ * Варианты плат, которые собираются на хосте рядом с PowerAnalyzer этой платы:
+ * ядро каждого попадает в бенчмарк, а захват с любой из них можно воспроизвести
+ */
+typedef BasicPowerAnalyzer<Topology::SINGLE_PHASE, 1, ANALYZER_SAMPLE_RATE_HZ> SinglePhaseAnalyzer;
+typedef BasicPowerAnalyzer<Topology::SPLIT_PHASE, 2, ANALYZER_SAMPLE_RATE_HZ> SplitPhaseAnalyzer;
+typedef BasicPowerAnalyzer<Topology::DELTA, 3, ANALYZER_SAMPLE_RATE_HZ> DeltaAnalyzer;
+typedef BasicPowerAnalyzer<Topology::WYE, 6, ANALYZER_SAMPLE_RATE_HZ> WyeSixChannelAnalyzer;
+
+#endif // BOARD_VARIANTS_H
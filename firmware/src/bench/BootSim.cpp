@@ -0,0 +1,239 @@
+#include "BootSim.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../config.h"
+#include "../hal/Hal.h"
+#include "../hal/HalNative.h"
+#include "../PowerAnalyzer.h"
+#include "../VoltageSensor.h"
+#include "../HistoryStore.h"
+#include "../BootTimeline.h"
+#include "SyntheticGrid.h"
+
+// Время до первого измерения: задержка стабилизации АЦП, блок калибровки,
+// блок измерения (мс виртуальных часов) и запас на вычисления
+#define FIRST_SAMPLE_LIMIT_MS (100 + 2 * MEASUREMENT_WINDOW_MS + 20)
+
+// Ошибка смещения, отсчётов АЦП (шум ±8 усредняется до ~0.1)
+#define OFFSET_LIMIT_COUNTS 0.5
+
+// Досылка: измерения с секунды FIRST_S, пропуск GAP_S, NTP с SYNC_S, первая отправка в UPLOAD_S
+#define FIRST_S 1u
+#define GAP_S 7u
+#define SYNC_S 12u
+#define UPLOAD_S 25u
+#define UNIX_OFFSET 1704067200u
+
+// Самый длинный DEVICE_ID, для которого рассчитан BOOT_LINE_PROTOCOL_SIZE
+#define LONG_DEVICE_ID "power-monitor-substation-07-ab12"
+
+static bool check(const char* name, bool ok, const char* detail) {
+    printf("%-44s %-8s %s\n", name, ok ? "ok" : "FAIL", detail);
+    return ok;
+}
+
+static void dataAt(uint32_t t, PowerData& data) {
+    memset(&data, 0, sizeof(data));
+    data.voltageA = 228.0f + (t % 9) * 0.37f;
+    data.voltageB = 231.0f - (t % 5) * 0.21f;
+    data.voltageC = 226.5f + (t % 4) * 0.5f;
+    data.frequencyAvg = NOMINAL_FREQUENCY + ((int)(t % 7) - 3) * 0.011f;
+    data.unbalance = 0.4f + (t % 3) * 0.15f;
+}
+
+/**
+ * Время до первого измерения и ошибка смещений: прежняя калибровка
+ * (по датчику, 5000 отсчётов через 50 мкс) и блок всех каналов
+ */
+static bool checkStart(float frequency) {
+    SyntheticGrid grid(230.0f, frequency, 8);
+    NativeHal::setAdcSource(&grid);
+    const int pins[PowerAnalyzer::CHANNELS] = ANALYZER_CHANNEL_PINS;
+    const float calibration[PowerAnalyzer::CHANNELS] = ANALYZER_CHANNEL_CALIBRATION;
+
+    uint32_t started = Hal::millis();
+    double legacyError = 0.0;
+    for (int ch = 0; ch < PowerAnalyzer::CHANNELS; ch++) {
+        VoltageSensor sensor(pins[ch], calibration[ch]);
+        sensor.begin();
+        double error = fabs(sensor.getOffset() - ADC_OFFSET);
+        legacyError = error > legacyError ? error : legacyError;
+    }
+    uint32_t legacyMs = Hal::millis() - started;
+
+    PowerAnalyzer analyzer(pins, calibration);
+    started = Hal::millis();
+    analyzer.begin();
+    PowerData data = analyzer.measure();
+    uint32_t firstSampleMs = Hal::millis() - started;
+    double error = 0.0;
+    for (int ch = 0; ch < PowerAnalyzer::CHANNELS; ch++) {
+        double e = fabs(analyzer.getOffset(ch) / PowerAnalyzer::FRAME_SCALE - ADC_OFFSET);
+        error = e > error ? e : error;
+    }
+    NativeHal::setAdcSource(nullptr);
+
+    char name[64];
+    char detail[160];
+    snprintf(name, sizeof(name), "first sample at %.1f Hz", frequency);
+    snprintf(detail, sizeof(detail), "%lu ms (limit %d), %.1f V; per-sensor calibration alone %lu ms",
+             (unsigned long)firstSampleMs, FIRST_SAMPLE_LIMIT_MS, data.voltageA, (unsigned long)legacyMs);
+    bool pass = check(name, firstSampleMs <= FIRST_SAMPLE_LIMIT_MS && fabsf(data.voltageA - 230.0f) < 2.3f, detail);
+    snprintf(name, sizeof(name), "block offsets at %.1f Hz", frequency);
+    snprintf(detail, sizeof(detail), "max error %.2f counts (per-sensor %.2f)", error, legacyError);
+    return check(name, error <= OFFSET_LIMIT_COUNTS, detail) && pass;
+}
+
+/**
+ * Строка досылки: измерение, фаза (или пусто), значение, метка
+ */
+struct BackfillLine {
+    char measurement[16];
+    char phase[4];
+    double value;
+    unsigned long long timeMs;
+};
+
+static bool parseLine(const char* line, BackfillLine& out) {
+    memset(&out, 0, sizeof(out));
+    const char* comma = strchr(line, ',');
+    const char* space = strchr(line, ' ');
+    if (comma == nullptr || space == nullptr || comma - line >= (int)sizeof(out.measurement)) {
+        return false;
+    }
+    memcpy(out.measurement, line, comma - line);
+    const char* phase = strstr(line, ",phase=");
+    if (phase != nullptr && phase < space) {
+        out.phase[0] = phase[7];
+    }
+    return sscanf(space, " value=%lf %llu", &out.value, &out.timeMs) == 2;
+}
+
+/**
+ * Досылка из истории кусками по BOOT_BACKFILL_CHUNK_S
+ */
+static bool checkBackfill() {
+    static HistoryStore store;
+    static char lines[BOOT_LINE_PROTOCOL_SIZE];
+    bool pass = true;
+    char detail[160];
+    if (!store.begin()) {
+        return check("backfill history allocated", false, "");
+    }
+
+    for (uint32_t t = FIRST_S; t <= UPLOAD_S + 3; t++) {
+        if (t == GAP_S) {
+            continue;
+        }
+        PowerData data;
+        dataAt(t, data);
+        store.add(data, 3, t, t >= SYNC_S ? UNIX_OFFSET + t : 0);
+        if (t == SYNC_S - 1) {
+            size_t length = store.writeLineProtocol(FIRST_S, t + 1, lines, sizeof(lines), DEVICE_ID);
+            pass = check("no backfill before NTP", length == 0, "") && pass;
+        }
+    }
+
+    uint32_t seconds[UPLOAD_S + 1] = {0};
+    uint32_t lineCount = 0;
+    uint32_t badLines = 0;
+    uint32_t chunks = 0;
+    size_t largest = 0;
+    for (uint32_t from = FIRST_S; from < UPLOAD_S; from += BOOT_BACKFILL_CHUNK_S) {
+        uint32_t to = from + BOOT_BACKFILL_CHUNK_S < UPLOAD_S ? from + BOOT_BACKFILL_CHUNK_S : UPLOAD_S;
+        size_t length = store.writeLineProtocol(from, to, lines, sizeof(lines), LONG_DEVICE_ID);
+        largest = length > largest ? length : largest;
+        chunks++;
+        for (char* line = strtok(length > 0 ? lines : nullptr, "\n"); line != nullptr; line = strtok(nullptr, "\n")) {
+            BackfillLine parsed;
+            lineCount++;
+            if (!parseLine(line, parsed) || parsed.timeMs % 1000 != 0) {
+                badLines++;
+                continue;
+            }
+            unsigned long long unixS = parsed.timeMs / 1000;
+            uint32_t t = (uint32_t)(unixS - UNIX_OFFSET);
+            if (unixS < UNIX_OFFSET + from || unixS >= UNIX_OFFSET + to) {
+                badLines++;
+                continue;
+            }
+            PowerData data;
+            dataAt(t, data);
+            double expected;
+            if (strcmp(parsed.measurement, "voltage") == 0) {
+                const float voltages[3] = {data.voltageA, data.voltageB, data.voltageC};
+                expected = parsed.phase[0] >= 'A' && parsed.phase[0] <= 'C' ? voltages[parsed.phase[0] - 'A'] : -1.0;
+            } else if (strcmp(parsed.measurement, "frequency") == 0) {
+                expected = data.frequencyAvg;
+            } else if (strcmp(parsed.measurement, "unbalance") == 0) {
+                expected = data.unbalance;
+            } else {
+                expected = -1.0;
+            }
+            if (fabs(parsed.value - expected) > 0.006) {
+                badLines++;
+                continue;
+            }
+            seconds[t]++;
+        }
+    }
+
+    uint32_t complete = 0;
+    for (uint32_t t = FIRST_S; t < UPLOAD_S; t++) {
+        complete += seconds[t] == 5 ? 1 : 0;
+    }
+    const uint32_t expectedSeconds = UPLOAD_S - FIRST_S - 1;
+    snprintf(detail, sizeof(detail), "%lu of %lu s, %lu lines in %lu chunks, %lu bad",
+             (unsigned long)complete, (unsigned long)expectedSeconds, (unsigned long)lineCount,
+             (unsigned long)chunks, (unsigned long)badLines);
+    pass = check("seconds before first upload backfilled", complete == expectedSeconds && badLines == 0 &&
+                 lineCount == expectedSeconds * 5, detail) && pass;
+    snprintf(detail, sizeof(detail), "second %lu absent, pre-NTP seconds stamped from the NTP offset",
+             (unsigned long)GAP_S);
+    pass = check("gap skipped, timestamps unix ms", seconds[GAP_S] == 0 && seconds[FIRST_S] == 5, detail) && pass;
+    snprintf(detail, sizeof(detail), "largest %lu B of %d (%d s, 32-char device id)", (unsigned long)largest,
+             BOOT_LINE_PROTOCOL_SIZE, BOOT_BACKFILL_CHUNK_S);
+    return check("chunk fits BOOT_LINE_PROTOCOL_SIZE", largest > 0 && largest < BOOT_LINE_PROTOCOL_SIZE, detail) &&
+           pass;
+}
+
+/**
+ * Отметки этапов и точка boot
+ */
+static bool checkTimeline() {
+    BootTimeline timeline;
+    bool pass = true;
+    bool first = timeline.mark(BootStage::FIRST_SAMPLE, 480);
+    bool again = timeline.mark(BootStage::FIRST_SAMPLE, 1480);
+    timeline.mark(BootStage::WIFI, 1210);
+    timeline.mark(BootStage::FIRST_UPLOAD, 1490);
+    timeline.setFastConnect(true);
+    timeline.addBackfill(2);
+    pass = check("stage marked once", first && !again && timeline.at(BootStage::FIRST_SAMPLE) == 480 &&
+                 !timeline.reached(BootStage::NTP) && timeline.at(BootStage::NTP) == 0, "") && pass;
+
+    char line[256];
+    size_t length = timeline.writeLineProtocol(line, sizeof(line), DEVICE_ID, "brownout");
+    const char* expected = "boot,device=" DEVICE_ID ",reset=brownout,wifi=fast first_sample_ms=480i,"
+                           "wifi_ms=1210i,first_upload_ms=1490i,backfill_s=2i\n";
+    pass = check("boot point", length == strlen(expected) && strcmp(line, expected) == 0, "") && pass;
+    if (length != strlen(expected) || strcmp(line, expected) != 0) {
+        printf("  got:      %s  expected: %s", line, expected);
+    }
+    return pass;
+}
+
+int runBootSim() {
+    printf("Boot check: first sample before the network, backfill of the seconds before the first upload\n\n");
+    NativeHal::setLogEnabled(false);
+
+    bool pass = checkStart(NOMINAL_FREQUENCY);
+    pass = checkStart(NOMINAL_FREQUENCY - 0.3f) && pass;
+    pass = checkBackfill() && pass;
+    pass = checkTimeline() && pass;
+
+    printf("\n%s\n", pass ? "Boot check passed" : "Boot check FAILED");
+    return pass ? 0 : 1;
+}
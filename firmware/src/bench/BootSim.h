@@ -0,0 +1,18 @@
+#ifndef BOOT_SIM_H
+#define BOOT_SIM_H
+
+/**
+ * Проверка быстрого запуска
+ *
+ * Время до первого измерения по виртуальным часам NativeHal: begin()
+ * анализатора (смещения по одному блоку всех каналов) и первое measure()
+ * против прежней калибровки по 5000 отсчётов на канал; ошибка смещений
+ * обоих способов при номинальной и сдвинутой частоте. Досылка из истории:
+ * секунды до первой отправки с пропуском и синхронизацией NTP посередине
+ * разбираются по строкам и сверяются с измеренным (метки, значения,
+ * пропуск, размер куска). В конце — точка boot и однократность отметок.
+ * @return Код выхода процесса (1 — проверка не прошла)
+ */
+int runBootSim();
+
+#endif // BOOT_SIM_H
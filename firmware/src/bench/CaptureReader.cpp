@@ -0,0 +1,137 @@
+#include "CaptureReader.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CaptureReader::CaptureReader()
+    : data(nullptr),
+      size(0),
+      position(0),
+      firstBlock(0),
+      resyncCount(0),
+      error("") {
+    memset(&header, 0, sizeof(header));
+}
+
+CaptureReader::~CaptureReader() {
+    close();
+}
+
+bool CaptureReader::fail(const char* message) {
+    error = message;
+    close();
+    return false;
+}
+
+bool CaptureReader::open(const char* path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return fail("cannot open file");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CaptureHeader)) {
+        ::close(fd);
+        return fail("file too short for a capture header");
+    }
+
+    size = (size_t)st.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        size = 0;
+        return fail("mmap failed");
+    }
+    data = static_cast<const uint8_t*>(mapped);
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != CAPTURE_MAGIC) {
+        return fail("not a capture file (bad magic)");
+    }
+    if (header.version != CAPTURE_VERSION) {
+        return fail("unsupported capture version");
+    }
+    if (header.headerSize < sizeof(CaptureHeader) || header.headerSize > size) {
+        return fail("bad header size");
+    }
+    if (header.channelCount == 0 || header.channelCount > CAPTURE_MAX_CHANNELS) {
+        return fail("bad channel count");
+    }
+    if (header.sampleRateHz == 0) {
+        return fail("bad sample rate");
+    }
+
+    firstBlock = header.headerSize;
+    position = firstBlock;
+    resyncCount = 0;
+    error = "";
+    return true;
+}
+
+void CaptureReader::close() {
+    if (data != nullptr) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+    data = nullptr;
+    size = 0;
+    position = 0;
+}
+
+const CaptureHeader& CaptureReader::getHeader() const {
+    return header;
+}
+
+bool CaptureReader::next(CaptureBlock& out) {
+    while (data != nullptr && position + sizeof(CaptureBlockHeader) <= size) {
+        const CaptureBlockHeader* block = reinterpret_cast<const CaptureBlockHeader*>(data + position);
+        size_t payload = (size_t)block->frameCount * header.channelCount * sizeof(int16_t);
+
+        if (block->magic != CAPTURE_BLOCK_MAGIC || block->frameCount == 0) {
+            // Повреждение: ищем следующий блок (блоки выровнены на 2 байта)
+            resyncCount++;
+            position += 2;
+            while (position + sizeof(uint32_t) <= size) {
+                uint32_t magic;
+                memcpy(&magic, data + position, sizeof(magic));
+                if (magic == CAPTURE_BLOCK_MAGIC) {
+                    break;
+                }
+                position += 2;
+            }
+            continue;
+        }
+
+        if (position + sizeof(CaptureBlockHeader) + payload > size) {
+            // Недописанный хвост
+            position = size;
+            return false;
+        }
+
+        out.header = block;
+        out.samples = reinterpret_cast<const int16_t*>(data + position + sizeof(CaptureBlockHeader));
+        position += sizeof(CaptureBlockHeader) + payload;
+        return true;
+    }
+    return false;
+}
+
+void CaptureReader::rewind() {
+    position = firstBlock;
+}
+
+uint32_t CaptureReader::getResyncCount() const {
+    return resyncCount;
+}
+
+size_t CaptureReader::getFileSize() const {
+    return size;
+}
+
+const char* CaptureReader::getError() const {
+    return error;
+}
@@ -0,0 +1,71 @@
+#ifndef CAPTURE_READER_H
+#define CAPTURE_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../CaptureFormat.h"
+
+/**
+ * Блок файла захвата: указатели прямо в отображённый файл, без копирования
+ */
+struct CaptureBlock {
+    const CaptureBlockHeader* header;
+    const int16_t* samples;     // header->frameCount × channelCount отсчётов
+};
+
+/**
+ * Чтение файла захвата через mmap (только хост)
+ *
+ * Файл целиком отображается в память, блоки отдаются по указателям,
+ * поэтому часы записи прогоняются через анализ со скоростью памяти.
+ * Повреждённый блок пропускается поиском следующего CAPTURE_BLOCK_MAGIC;
+ * недописанный последний блок (кончилось место на устройстве) игнорируется.
+ */
+class CaptureReader {
+public:
+    CaptureReader();
+    ~CaptureReader();
+
+    /**
+     * Открыть и проверить заголовок
+     * @return false при ошибке, текст — в getError()
+     */
+    bool open(const char* path);
+
+    void close();
+
+    const CaptureHeader& getHeader() const;
+
+    /**
+     * Следующий блок
+     * @return false в конце файла
+     */
+    bool next(CaptureBlock& out);
+
+    /**
+     * Вернуться к первому блоку
+     */
+    void rewind();
+
+    /**
+     * Сколько раз пришлось искать начало блока после повреждения
+     */
+    uint32_t getResyncCount() const;
+
+    size_t getFileSize() const;
+
+    const char* getError() const;
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+    size_t firstBlock;
+    uint32_t resyncCount;
+    CaptureHeader header;
+    const char* error;
+
+    bool fail(const char* message);
+};
+
+#endif // CAPTURE_READER_H
@@ -0,0 +1,272 @@
+#include "ComplianceSim.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "../config.h"
+#include "../PowerAnalyzer.h"
+#include "../ComplianceStats.h"
+
+/**
+ * Детерминированный xorshift32: один и тот же прогон при каждом запуске
+ */
+static uint32_t randomState = 2463534242u;
+
+static uint32_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static float uniform(float lo, float hi) {
+    return lo + (hi - lo) * (nextRandom() % 100000) / 100000.0f;
+}
+
+// =============================================================================
+// THD
+// =============================================================================
+
+// Гармоники, % основной: THD = √(5² + 3² + 1²) = 5.916 %
+static const int HARMONIC_ORDERS[] = {5, 7, 11};
+static const float HARMONIC_PERCENT[] = {5.0f, 3.0f, 1.0f};
+
+static bool checkThd(PowerAnalyzer& analyzer, float frequency, double& nsPerCall) {
+    static int16_t block[PowerAnalyzer::BLOCK_SAMPLES];
+    const float amplitude = 230.0f * sqrtf(2.0f) / CALIBRATION_COEFF_A;
+    for (int i = 0; i < PowerAnalyzer::FRAMES_PER_BLOCK; i++) {
+        for (int ch = 0; ch < PowerAnalyzer::CHANNELS; ch++) {
+            float phase = 2.0f * (float)M_PI * frequency * i / PowerAnalyzer::SAMPLE_RATE_HZ -
+                          ch * 2.0f * (float)M_PI / 3.0f;
+            float value = sinf(phase);
+            for (int k = 0; k < 3; k++) {
+                value += HARMONIC_PERCENT[k] / 100.0f * sinf(HARMONIC_ORDERS[k] * phase);
+            }
+            int noise = (int)(nextRandom() % 17) - 8;
+            block[i * PowerAnalyzer::CHANNELS + ch] =
+                (int16_t)(lroundf(ADC_OFFSET + amplitude * value + noise) * PowerAnalyzer::FRAME_SCALE);
+        }
+    }
+
+    analyzer.analyze(block, PowerAnalyzer::FRAMES_PER_BLOCK, 0);
+    const float expected = sqrtf(25.0f + 9.0f + 1.0f);
+    float thd[3] = {0.0f, 0.0f, 0.0f};
+    const int repeat = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++) {
+        for (int p = 0; p < PowerAnalyzer::PHASES; p++) {
+            thd[p] = analyzer.harmonicDistortion(block, PowerAnalyzer::FRAMES_PER_BLOCK, p);
+        }
+    }
+    nsPerCall = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                (repeat * PowerAnalyzer::PHASES);
+
+    bool ok = true;
+    printf("THD @ %.1f Hz:  ", frequency);
+    for (int p = 0; p < PowerAnalyzer::PHASES; p++) {
+        printf("%.3f %% ", thd[p]);
+        ok = ok && fabsf(thd[p] - expected) < 0.1f;
+    }
+    printf("(expected %.3f %%) %s\n", expected, ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+// =============================================================================
+// Недели измерений
+// =============================================================================
+
+struct WeekReference {
+    std::vector<float> voltage[3];
+    std::vector<float> unbalance;
+    std::vector<float> thd[3];
+    std::vector<float> frequency;
+};
+
+/**
+ * Значение, ниже которого fraction всех (как BinnedHistogram, без корзин)
+ */
+static float exactPercentile(std::vector<float> values, float fraction) {
+    if (values.empty()) {
+        return 0.0f;
+    }
+    std::sort(values.begin(), values.end());
+    size_t target = (size_t)ceilf(fraction * values.size());
+    return values[target > 0 ? target - 1 : 0];
+}
+
+static float percentWhere(const std::vector<float>& values, float lo, float hi) {
+    if (values.empty()) {
+        return 100.0f;
+    }
+    size_t inside = 0;
+    for (float v : values) {
+        inside += v >= lo && v <= hi;
+    }
+    return 100.0f * inside / values.size();
+}
+
+static bool near(float a, float b, float tolerance) {
+    return fabsf(a - b) <= tolerance;
+}
+
+/**
+ * Сверить итог недели с подсчётом по сохранённым значениям
+ */
+static bool checkWeek(const ComplianceSummary& s, const WeekReference& ref, int phases) {
+    float voltageBand = 100.0f;
+    float thdLimit = 100.0f;
+    bool voltageAll = true;
+    float voltageP05 = 1e9f;
+    float voltageP95 = -1e9f;
+    float thdP95 = 0.0f;
+    const float band = NOMINAL_VOLTAGE * EN50160_VOLTAGE_BAND / 100.0f;
+    for (int p = 0; p < phases; p++) {
+        voltageBand = std::min(voltageBand, percentWhere(ref.voltage[p], NOMINAL_VOLTAGE - band, NOMINAL_VOLTAGE + band));
+        voltageAll = voltageAll && percentWhere(ref.voltage[p], NOMINAL_VOLTAGE * (1.0f + EN50160_VOLTAGE_LOW_LIMIT / 100.0f),
+                                                NOMINAL_VOLTAGE + band) == 100.0f;
+        thdLimit = std::min(thdLimit, percentWhere(ref.thd[p], 0.0f, EN50160_THD_LIMIT));
+        voltageP05 = std::min(voltageP05, exactPercentile(ref.voltage[p], 0.05f));
+        voltageP95 = std::max(voltageP95, exactPercentile(ref.voltage[p], 0.95f));
+        thdP95 = std::max(thdP95, exactPercentile(ref.thd[p], 0.95f));
+    }
+    const float fBand = NOMINAL_FREQUENCY * EN50160_FREQUENCY_BAND / 100.0f;
+    float frequencyBand = percentWhere(ref.frequency, NOMINAL_FREQUENCY - fBand, NOMINAL_FREQUENCY + fBand);
+    float unbalanceLimit = percentWhere(ref.unbalance, 0.0f, EN50160_UNBALANCE_LIMIT);
+
+    // Счётчики — точно (с точностью до float на границах), процентили — до ширины корзины
+    bool ok = s.intervals == ref.voltage[0].size() && s.frequencyValues == ref.frequency.size() &&
+              near(s.voltageInBandPct, voltageBand, 0.2f) && s.voltageAllInLimits == voltageAll &&
+              near(s.thdInLimitPct, thdLimit, 0.2f) && near(s.frequencyInBandPct, frequencyBand, 0.01f) &&
+              near(s.unbalanceInLimitPct, unbalanceLimit, 0.2f) &&
+              near(s.voltageP05, voltageP05, NOMINAL_VOLTAGE * 0.001f + 0.01f) &&
+              near(s.voltageP95, voltageP95, NOMINAL_VOLTAGE * 0.001f + 0.01f) &&
+              near(s.thdP95, thdP95, 0.05f) &&
+              near(s.unbalanceP95, exactPercentile(ref.unbalance, 0.95f), 0.02f) &&
+              near(s.frequencyP995, exactPercentile(ref.frequency, 0.995f), NOMINAL_FREQUENCY * 0.0002f + 0.001f);
+
+    printf("  %u x 10 min, %u x 10 s | V in band %.2f %% (ref %.2f), all in limits %s | f %.3f %% (ref %.3f) | "
+           "unb %.2f %% | THD %.2f %% (ref %.2f), p95 %.2f (ref %.2f) | V p05..p95 %.1f..%.1f (ref %.1f..%.1f) -> %s%s\n",
+           s.intervals, s.frequencyValues, s.voltageInBandPct, voltageBand, s.voltageAllInLimits ? "yes" : "no",
+           s.frequencyInBandPct, frequencyBand, s.unbalanceInLimitPct, s.thdInLimitPct, thdLimit,
+           s.thdP95, thdP95, s.voltageP05, s.voltageP95, voltageP05, voltageP95,
+           s.compliant ? "compliant" : "not compliant", ok ? "" : "  MISMATCH");
+    return ok;
+}
+
+int runComplianceSim(uint32_t weeks) {
+    bool ok = true;
+
+    PowerAnalyzer analyzer(ANALYZER_CHANNEL_PINS, ANALYZER_CHANNEL_CALIBRATION);
+    analyzer.begin();
+    double thdNs = 0.0;
+    for (float frequency : {49.5f, 50.0f, 50.5f}) {
+        ok = checkThd(analyzer, frequency, thdNs) && ok;
+    }
+
+    ComplianceStats stats;
+    const int phases = PowerAnalyzer::PHASES;
+    const uint32_t start = ComplianceStats::weekStart(1760000000u);
+    const uint32_t end = start + weeks * 7 * 86400;
+
+    WeekReference ref;
+    double sumSquares[3] = {0, 0, 0};
+    double thdSquares[3] = {0, 0, 0};
+    double unbalanceSquares = 0;
+    uint32_t count = 0;
+    double frequencySum = 0;
+    uint32_t frequencyCount = 0;
+    uint32_t week = 0;
+    uint32_t frequencyDipLeftS = 0;
+    double updateNs = 0.0;
+    size_t lineLength = 0;
+    static char lines[COMPLIANCE_LINE_PROTOCOL_SIZE];
+
+    printf("\nEN 50160 weeks from Monday %u, 1 s measurements:\n", start);
+    for (uint32_t t = start; t <= end; t++) {
+        // Эталон: значения закрываются по тем же границам часов
+        if (t % COMPLIANCE_FREQUENCY_INTERVAL_S == 0 && frequencyCount > 0) {
+            ref.frequency.push_back((float)(frequencySum / frequencyCount));
+            frequencySum = 0;
+            frequencyCount = 0;
+        }
+        if (t % COMPLIANCE_INTERVAL_S == 0 && count > 0) {
+            for (int p = 0; p < phases; p++) {
+                ref.voltage[p].push_back((float)sqrt(sumSquares[p] / count));
+                ref.thd[p].push_back((float)sqrt(thdSquares[p] / count));
+                sumSquares[p] = 0;
+                thdSquares[p] = 0;
+            }
+            ref.unbalance.push_back((float)sqrt(unbalanceSquares / count));
+            unbalanceSquares = 0;
+            count = 0;
+        }
+
+        // Сеть: суточный ход, вечерние просадки фазы C (длиннее с каждым днём), THD растёт
+        // вечером, изредка минута частоты на 1.5 % ниже номинала
+        float hour = (t % 86400) / 3600.0f;
+        float day = (float)((t - start) / 86400);
+        float base = NOMINAL_VOLTAGE * (1.0f + 0.04f * sinf(2.0f * (float)M_PI * (hour - 9.0f) / 24.0f));
+        PowerData data;
+        memset(&data, 0, sizeof(data));
+        data.voltageA = base + uniform(-2.0f, 2.0f);
+        data.voltageB = base * 0.99f + uniform(-2.0f, 2.0f);
+        data.voltageC = base + uniform(-2.0f, 2.0f);
+        if (hour >= 19.0f && hour < 19.5f + 0.2f * day) {
+            data.voltageC = NOMINAL_VOLTAGE * 0.87f + uniform(-2.0f, 2.0f);
+        }
+        data.voltageAvg = (data.voltageA + data.voltageB + data.voltageC) / 3.0f;
+        float deviation = std::max(fabsf(data.voltageA - data.voltageAvg),
+                                   std::max(fabsf(data.voltageB - data.voltageAvg), fabsf(data.voltageC - data.voltageAvg)));
+        data.unbalance = deviation / data.voltageAvg * 100.0f;
+        data.frequencyAvg = NOMINAL_FREQUENCY + uniform(-0.05f, 0.05f);
+        if (frequencyDipLeftS == 0 && nextRandom() % 200000 == 0) {
+            frequencyDipLeftS = 60;
+        }
+        if (frequencyDipLeftS > 0) {
+            data.frequencyAvg = NOMINAL_FREQUENCY * 0.985f;
+            frequencyDipLeftS--;
+        }
+        float thd[3];
+        for (int p = 0; p < phases; p++) {
+            thd[p] = 2.5f + (hour >= 18.0f && hour < 23.0f ? 3.5f + 0.15f * day : 0.0f) + uniform(-0.5f, 0.5f);
+        }
+        // Перерыв питания раз в неделю: в статистику не входит
+        bool interruption = t % (7 * 86400) >= 3 * 86400 + 3600 && t % (7 * 86400) < 3 * 86400 + 3660;
+        if (interruption) {
+            data.voltageA = data.voltageB = data.voltageC = data.voltageAvg = 0.0f;
+            data.frequencyAvg = 0.0f;
+        } else if (t < end) {
+            for (int p = 0; p < phases; p++) {
+                const float voltages[3] = {data.voltageA, data.voltageB, data.voltageC};
+                sumSquares[p] += (double)voltages[p] * voltages[p];
+                thdSquares[p] += (double)thd[p] * thd[p];
+            }
+            unbalanceSquares += (double)data.unbalance * data.unbalance;
+            count++;
+            frequencySum += data.frequencyAvg;
+            frequencyCount++;
+        }
+
+        auto began = std::chrono::steady_clock::now();
+        bool closed = stats.update(data, thd, phases, t);
+        updateNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - began).count();
+
+        if (closed) {
+            lineLength = stats.writeLineProtocol(lines, sizeof(lines), "esp32-001");
+            ok = ok && lineLength > 0;
+        }
+        // Последний интервал недели закрыт: итог недели окончательный
+        if (closed && ComplianceStats::weekStart(t) != stats.getSummary().weekStartS) {
+            printf("Week %u:", ++week);
+            ok = checkWeek(stats.getSummary(), ref, phases) && ok;
+            ref = WeekReference();
+        }
+    }
+
+    printf("\nCost:           update %.0f ns/measurement, THD %.1f us/phase (%d harmonics), state %zu bytes\n",
+           updateNs / (end - start + 1), thdNs / 1000.0, THD_MAX_HARMONIC, sizeof(ComplianceStats));
+    printf("Published:      %zu bytes per 10 min:\n%s", lineLength, lines);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+#ifndef COMPLIANCE_SIM_H
+#define COMPLIANCE_SIM_H
+
+#include <stdint.h>
+
+/**
+ * Проверка статистики EN 50160 на хосте
+ *
+ * 1. THD: блоки с 5-й, 7-й и 11-й гармониками на 49.5, 50 и 50.5 Гц через
+ *    PowerAnalyzer::analyze() и harmonicDistortion() против заданного значения.
+ * 2. Недели измерений раз в секунду (суточный ход и вечерние просадки
+ *    напряжения, рост THD, уходы частоты) через ComplianceStats; итог каждой
+ *    недели сверяется с подсчётом по всем сохранённым 10-минутным и 10-секундным
+ *    значениям. Печатает стоимость update() и размер состояния.
+ * @param weeks Моделируемых недель
+ * @return Код выхода процесса (1 — расхождение)
+ */
+int runComplianceSim(uint32_t weeks);
+
+#endif // COMPLIANCE_SIM_H
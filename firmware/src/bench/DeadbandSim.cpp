@@ -0,0 +1,307 @@
+#include "DeadbandSim.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "../config.h"
+#include "../DeadbandFilter.h"
+#include "../TelemetryCodec.h"
+
+// Синтетическая запись: измерения раз в SEND_INTERVAL_MS
+#define SYNTH_HOURS 2
+#define SYNTH_NOISE_V 0.1f              // Шум напряжения, В (ниже 0.25 % от 220 В)
+#define SYNTH_NOISE_HZ 0.004f           // Шум частоты, Гц (ниже DEADBAND_FREQUENCY_HZ)
+#define SYNTH_DRIFT_V 3.0f              // Амплитуда дрейфа напряжения за SYNTH_DRIFT_S
+#define SYNTH_DRIFT_S 1800
+#define SAG_START_S 2400                // Провал ниже VOLTAGE_MIN
+#define SAG_LENGTH_S 30
+#define FREQUENCY_START_S 4800          // Частота за FREQUENCY_DEVIATION_THRESHOLD
+#define FREQUENCY_LENGTH_S 60
+
+// Стабильный фидер: подавляется ~95–98 % точек (README)
+#define MIN_SUPPRESSION 0.9f
+
+static bool check(const char* name, bool ok, const char* detail) {
+    printf("%-44s %-8s %s\n", name, ok ? "ok" : "FAIL", detail);
+    return ok;
+}
+
+/**
+ * Флаги проблем по значениям — как их выставляет анализатор
+ */
+static void setProblems(PowerData& data) {
+    const float voltages[3] = {data.voltageA, data.voltageB, data.voltageC};
+    data.lowVoltage = false;
+    data.highVoltage = false;
+    for (int p = 0; p < 3; p++) {
+        data.lowVoltage |= voltages[p] < VOLTAGE_MIN;
+        data.highVoltage |= voltages[p] > VOLTAGE_MAX;
+    }
+    data.highUnbalance = data.unbalance > UNBALANCE_THRESHOLD;
+    data.frequencyDeviation = fabsf(data.frequencyAvg - NOMINAL_FREQUENCY) > FREQUENCY_DEVIATION_THRESHOLD;
+}
+
+static void synthesize(std::vector<PowerData>& trace) {
+    std::mt19937 rng(20240611);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    const float sqrt3 = sqrtf(3.0f);
+
+    for (uint32_t t = 0; t < SYNTH_HOURS * 3600u * 1000u / SEND_INTERVAL_MS; t++) {
+        uint32_t s = t * SEND_INTERVAL_MS / 1000;
+        float drift = SYNTH_DRIFT_V * sinf(2.0f * (float)M_PI * s / SYNTH_DRIFT_S);
+        float level = s >= SAG_START_S && s < SAG_START_S + SAG_LENGTH_S ? 0.85f : 1.0f;
+
+        PowerData data;
+        memset(&data, 0, sizeof(data));
+        data.voltageA = (NOMINAL_VOLTAGE + drift) * level + SYNTH_NOISE_V * noise(rng);
+        data.voltageB = (NOMINAL_VOLTAGE + drift) * level + SYNTH_NOISE_V * noise(rng);
+        data.voltageC = (NOMINAL_VOLTAGE + drift) * level + SYNTH_NOISE_V * noise(rng);
+        data.voltageAB = data.voltageA * sqrt3;
+        data.voltageBC = data.voltageB * sqrt3;
+        data.voltageCA = data.voltageC * sqrt3;
+        data.frequencyAvg = NOMINAL_FREQUENCY + 0.01f * sinf(2.0f * (float)M_PI * s / 600.0f) +
+                            SYNTH_NOISE_HZ * noise(rng);
+        if (s >= FREQUENCY_START_S && s < FREQUENCY_START_S + FREQUENCY_LENGTH_S) {
+            data.frequencyAvg += FREQUENCY_DEVIATION_THRESHOLD + 0.1f;
+        }
+        data.frequencyA = data.frequencyAvg;
+        data.frequencyB = data.frequencyAvg;
+        data.frequencyC = data.frequencyAvg;
+        data.unbalance = 0.5f + 0.02f * noise(rng);
+        data.timestamp = t * SEND_INTERVAL_MS;
+        setProblems(data);
+        trace.push_back(data);
+    }
+}
+
+static int columnOf(const std::vector<std::string>& header, const char* name) {
+    for (size_t i = 0; i < header.size(); i++) {
+        if (header[i] == name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static std::vector<std::string> splitCsv(const char* line) {
+    std::vector<std::string> fields;
+    std::string field;
+    for (const char* c = line; *c != '\0' && *c != '\n' && *c != '\r'; c++) {
+        if (*c == ',') {
+            fields.push_back(field);
+            field.clear();
+        } else {
+            field += *c;
+        }
+    }
+    fields.push_back(field);
+    return fields;
+}
+
+static bool readTrace(const char* path, std::vector<PowerData>& trace) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    static char line[1024];
+    if (fgets(line, sizeof(line), file) == nullptr) {
+        fprintf(stderr, "%s: empty\n", path);
+        fclose(file);
+        return false;
+    }
+    std::vector<std::string> header = splitCsv(line);
+    static const char* const names[] = {
+        "voltage_a", "voltage_b", "voltage_c", "voltage_ab", "voltage_bc", "voltage_ca",
+        "frequency_a", "frequency_b", "frequency_c", "unbalance", "active_power",
+        "energy_import_kwh", "energy_export_kwh"
+    };
+    const int count = sizeof(names) / sizeof(names[0]);
+    int columns[count];
+    for (int c = 0; c < count; c++) {
+        columns[c] = columnOf(header, names[c]);
+    }
+    int timeColumn = columnOf(header, "timestamp_ms");
+    int flagsColumn = columnOf(header, "problem_flags");
+    if (timeColumn < 0 || columns[0] < 0 || columns[6] < 0) {
+        fprintf(stderr, "%s: needs timestamp_ms, voltage_a and frequency_a columns (bench --replay --csv)\n", path);
+        fclose(file);
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        std::vector<std::string> fields = splitCsv(line);
+        if ((int)fields.size() < (int)header.size()) {
+            continue;
+        }
+        float values[count];
+        for (int c = 0; c < count; c++) {
+            values[c] = columns[c] >= 0 ? (float)atof(fields[columns[c]].c_str()) : 0.0f;
+        }
+
+        PowerData data;
+        memset(&data, 0, sizeof(data));
+        data.voltageA = values[0];
+        data.voltageB = values[1];
+        data.voltageC = values[2];
+        data.voltageAB = values[3];
+        data.voltageBC = values[4];
+        data.voltageCA = values[5];
+        data.frequencyA = values[6];
+        data.frequencyB = values[7];
+        data.frequencyC = values[8];
+        float frequencySum = 0.0f;
+        int frequencyCount = 0;
+        for (int p = 6; p < 9; p++) {
+            if (values[p] > 0.0f) {
+                frequencySum += values[p];
+                frequencyCount++;
+            }
+        }
+        data.frequencyAvg = frequencyCount > 0 ? frequencySum / frequencyCount : 0.0f;
+        data.unbalance = values[9];
+        data.activePower = values[10];
+        data.energyImportKwh = values[11];
+        data.energyExportKwh = values[12];
+        data.timestamp = (unsigned long)strtoull(fields[timeColumn].c_str(), nullptr, 10);
+        if (flagsColumn >= 0) {
+            long flags = strtol(fields[flagsColumn].c_str(), nullptr, 10);
+            data.lowVoltage = (flags & PROBLEM_LOW_VOLTAGE) != 0;
+            data.highVoltage = (flags & PROBLEM_HIGH_VOLTAGE) != 0;
+            data.highUnbalance = (flags & PROBLEM_UNBALANCE) != 0;
+            data.frequencyDeviation = (flags & PROBLEM_FREQUENCY) != 0;
+        } else {
+            setProblems(data);
+        }
+        trace.push_back(data);
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * Порог величины так же, как его считает DeadbandFilter (по умолчанию из config.h)
+ */
+static float limitOf(int index, float lastSent) {
+    static const float values[DEADBAND_FIELD_COUNT] = {
+        DEADBAND_VOLTAGE_PCT, DEADBAND_VOLTAGE_PCT, DEADBAND_VOLTAGE_PCT,
+        DEADBAND_LINE_VOLTAGE_PCT, DEADBAND_LINE_VOLTAGE_PCT, DEADBAND_LINE_VOLTAGE_PCT,
+        DEADBAND_FREQUENCY_HZ, DEADBAND_UNBALANCE_PCT, DEADBAND_POWER_W, DEADBAND_ENERGY_KWH
+    };
+    return index < 6 ? fabsf(lastSent) * values[index] / 100.0f : values[index];
+}
+
+int runDeadbandSim(const char* csvPath) {
+    std::vector<PowerData> trace;
+    if (csvPath != nullptr) {
+        if (!readTrace(csvPath, trace)) {
+            return 1;
+        }
+    } else {
+        synthesize(trace);
+    }
+    if (trace.empty()) {
+        fprintf(stderr, "%s: no measurements\n", csvPath);
+        return 1;
+    }
+
+    printf("Deadband check: %s, %zu measurements, heartbeat %d ms\n\n",
+           csvPath != nullptr ? csvPath : "synthetic feeder", trace.size(), DEADBAND_HEARTBEAT_MS);
+
+    DeadbandFilter filter;
+    filter.setEnabled(true);
+
+    float held[DEADBAND_FIELD_COUNT];
+    uint32_t sentMs[DEADBAND_FIELD_COUNT];
+    uint32_t maxGapMs[DEADBAND_FIELD_COUNT];
+    memset(held, 0, sizeof(held));
+    memset(sentMs, 0, sizeof(sentMs));
+    memset(maxGapMs, 0, sizeof(maxGapMs));
+
+    uint32_t maxStepMs = 0;
+    uint32_t points = 0;
+    uint32_t sent = 0;
+    int flagChanges = 0;
+    int flagMisses = 0;
+    int heldBeyond = 0;
+    float worstExcess = 0.0f;
+    uint8_t lastFlags = 0;
+
+    for (size_t i = 0; i < trace.size(); i++) {
+        const PowerData& data = trace[i];
+        uint32_t nowMs = (uint32_t)data.timestamp;
+        if (i > 0 && nowMs - (uint32_t)trace[i - 1].timestamp > maxStepMs) {
+            maxStepMs = nowMs - (uint32_t)trace[i - 1].timestamp;
+        }
+
+        uint8_t flags = TelemetryCodec::problemFlags(data);
+        uint16_t mask = filter.update(data, nowMs);
+        if (i > 0 && flags != lastFlags) {
+            flagChanges++;
+            flagMisses += mask != DEADBAND_ALL_FIELDS ? 1 : 0;
+        }
+        if (i == 0) {
+            flagMisses += mask != DEADBAND_ALL_FIELDS ? 1 : 0;
+        }
+        lastFlags = flags;
+
+        for (int f = 0; f < DEADBAND_FIELD_COUNT; f++) {
+            float value = DeadbandFilter::fieldValue(data, f);
+            points++;
+            if (mask & (1 << f)) {
+                if (i > 0 && nowMs - sentMs[f] > maxGapMs[f]) {
+                    maxGapMs[f] = nowMs - sentMs[f];
+                }
+                held[f] = value;
+                sentMs[f] = nowMs;
+                sent++;
+            } else {
+                // На сервере осталось held[f]: не дальше порога от текущего
+                float excess = fabsf(value - held[f]) - limitOf(f, held[f]);
+                if (excess > 1e-4f * fmaxf(1.0f, fabsf(value))) {
+                    heldBeyond++;
+                    worstExcess = fmaxf(worstExcess, excess);
+                }
+            }
+        }
+    }
+
+    uint32_t endMs = (uint32_t)trace.back().timestamp;
+    uint32_t worstGapMs = 0;
+    for (int f = 0; f < DEADBAND_FIELD_COUNT; f++) {
+        // Хвост записи без отправки тоже считается интервалом
+        worstGapMs = endMs - sentMs[f] > worstGapMs ? endMs - sentMs[f] : worstGapMs;
+        worstGapMs = maxGapMs[f] > worstGapMs ? maxGapMs[f] : worstGapMs;
+    }
+
+    bool ok = true;
+    char detail[160];
+    float ratio = 1.0f - (float)sent / (float)points;
+    DeadbandStats stats = filter.getStats();
+
+    snprintf(detail, sizeof(detail), "%.1f %% of %u points (%u heartbeats, %u forced)", ratio * 100.0f,
+             points, stats.heartbeats, stats.forced);
+    bool ratioOk = stats.evaluated == points && stats.sent == sent &&
+                   fabsf(filter.getSuppressionRatio() - ratio) < 1e-6f;
+    if (csvPath == nullptr) {
+        ratioOk &= ratio >= MIN_SUPPRESSION;
+    }
+    ok &= check(csvPath == nullptr ? "Suppression ratio >= 90 %, matches stats" : "Suppression ratio matches stats",
+                ratioOk, detail);
+
+    snprintf(detail, sizeof(detail), "longest %.1f s (step %.1f s)", worstGapMs / 1000.0f, maxStepMs / 1000.0f);
+    ok &= check("Every field sent within heartbeat + step", worstGapMs <= DEADBAND_HEARTBEAT_MS + maxStepMs, detail);
+
+    snprintf(detail, sizeof(detail), "%d flag changes, %d without full send", flagChanges, flagMisses);
+    ok &= check("Flag change and start send all fields", flagMisses == 0 &&
+                (csvPath != nullptr || flagChanges == 4), detail);
+
+    snprintf(detail, sizeof(detail), "%d beyond, worst by %.4f", heldBeyond, worstExcess);
+    ok &= check("Suppressed value within deadband of sent", heldBeyond == 0, detail);
+
+    printf("\nDeadband check %s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+#ifndef DEADBAND_SIM_H
+#define DEADBAND_SIM_H
+
+/**
+ * Проверка report-by-exception (DeadbandFilter) на записи измерений
+ *
+ * Без файла — два часа синтетической сети раз в SEND_INTERVAL_MS: шум ниже
+ * порогов, медленный дрейф напряжения и частоты, провал ниже VOLTAGE_MIN и
+ * уход частоты (смены флагов проблем). С файлом — запись PowerData в CSV
+ * (bench --replay --csv).
+ *
+ * Проверяется: доля подавленных точек (на синтетике не ниже ожидаемой для
+ * стабильного фидера) и её совпадение с getSuppressionRatio(); интервал между
+ * отправками каждой величины не больше DEADBAND_HEARTBEAT_MS плюс шаг записи;
+ * смена флагов проблем отправляет все величины; у подавленной величины
+ * последнее отправленное значение не дальше порога от текущего.
+ * @param csvPath nullptr — синтетическая запись
+ * @return Код выхода процесса (1 — проверка не прошла)
+ */
+int runDeadbandSim(const char* csvPath);
+
+#endif // DEADBAND_SIM_H
@@ -0,0 +1,220 @@
+#include "DeepCaptureBench.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "../config.h"
+#include "../hal/Hal.h"
+#include "../hal/HalNative.h"
+#include "../PowerAnalyzer.h"
+#include "../DeepCapture.h"
+
+// Кусок chunked-ответа: один TCP-сегмент (MSS 1436 у lwIP на ESP32)
+#define STREAM_CHUNK 1436
+
+// Провал фазы A: [SAG_START_MS, SAG_END_MS) до SAG_DEPTH номинала
+#define SAG_START_MS 2000
+#define SAG_END_MS 2600
+#define SAG_DEPTH 0.6f
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedUs(Clock::time_point since) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+}
+
+/**
+ * Сверить уровень пирамиды с min/max по кадрам потока
+ * @return Число несовпавших интервалов
+ */
+static uint32_t verifyLevel(const DeepCapture& capture, int level, const std::vector<int16_t>& frames,
+                            uint32_t frameCount) {
+    const int channels = PowerAnalyzer::CHANNELS;
+    uint32_t size = capture.framesPerBucket(level);
+    uint32_t expected = (frameCount + size - 1) / size;
+    if (capture.envelopeBuckets(level) != expected) {
+        return expected;
+    }
+
+    uint32_t mismatches = 0;
+    for (uint32_t bucket = 0; bucket < expected; bucket++) {
+        const int16_t* got = capture.envelopeBucket(level, bucket);
+        uint32_t last = (bucket + 1) * size < frameCount ? (bucket + 1) * size : frameCount;
+        for (int ch = 0; ch < channels; ch++) {
+            int16_t lo = frames[(size_t)bucket * size * channels + ch];
+            int16_t hi = lo;
+            for (uint32_t f = bucket * size; f < last; f++) {
+                int16_t v = frames[(size_t)f * channels + ch];
+                lo = v < lo ? v : lo;
+                hi = v > hi ? v : hi;
+            }
+            if (got[ch * 2] != lo || got[ch * 2 + 1] != hi) {
+                mismatches++;
+                break;
+            }
+        }
+    }
+    return mismatches;
+}
+
+int runDeepCaptureBench(uint32_t seconds, SyntheticGrid& grid, float voltage, const char* capturePath) {
+    NativeHal::setAdcSource(&grid);
+    PowerAnalyzer analyzer(ANALYZER_CHANNEL_PINS, ANALYZER_CHANNEL_CALIBRATION);
+    analyzer.begin();
+
+    DeepCapture capture;
+    if (!capture.begin(PowerAnalyzer::CHANNELS, PowerAnalyzer::FRAMES_PER_BLOCK, PowerAnalyzer::SAMPLE_RATE_HZ)) {
+        fprintf(stderr, "No memory for the deep capture buffer\n");
+        return 1;
+    }
+
+    CaptureHeader header;
+    analyzer.describeCapture(header, "synthetic", 0);
+    capture.start(seconds, header);
+    uint32_t generation = capture.getStatus().generation;
+
+    std::vector<uint8_t> stream;
+    uint8_t chunk[STREAM_CHUNK];
+    double acquireUs = 0.0;
+    double updateUs = 0.0;
+    double streamUs = 0.0;
+    double analyzeUs = 0.0;
+    uint32_t blocks = 0;
+    uint32_t gaps = 0;
+    uint32_t lastTimestampMs = 0;
+    float minSag = 1e9f;
+
+    // Писатель: расписание сквозное, как в задаче оцифровки DeepCaptureServer
+    const uint32_t blockUs = PowerAnalyzer::FRAMES_PER_BLOCK * PowerAnalyzer::INTERVAL_US;
+    const uint32_t beganUs = PowerAnalyzer::startNowUs();
+    uint32_t startUs = beganUs;
+    int16_t* block;
+    while ((block = capture.nextBlock()) != nullptr) {
+        uint32_t offsetMs = (startUs - beganUs) / 1000;
+        bool sag = offsetMs >= SAG_START_MS && offsetMs < SAG_END_MS;
+        grid.setPhaseVoltage(0, sag ? voltage * SAG_DEPTH : voltage);
+
+        Clock::time_point t = Clock::now();
+        uint32_t maxLateUs;
+        uint32_t late = analyzer.acquire(block, startUs, maxLateUs);
+        capture.commitBlock(Hal::millis(), late, maxLateUs);
+        acquireUs += elapsedUs(t);
+        startUs += blockUs;
+
+        uint32_t seq;
+        uint32_t timestampMs;
+        const int16_t* latest = capture.latestBlock(seq, timestampMs);
+        if (blocks > 0 && timestampMs - lastTimestampMs != blockUs / 1000) {
+            gaps++;
+        }
+        lastTimestampMs = timestampMs;
+        blocks++;
+
+        // Читатели между блоками: огибающая, поток, измерение
+        t = Clock::now();
+        capture.update();
+        updateUs += elapsedUs(t);
+
+        t = Clock::now();
+        size_t length;
+        while ((length = capture.readStream(generation, stream.size(), chunk, sizeof(chunk))) != 0 &&
+               length != DEEP_STREAM_WAIT) {
+            stream.insert(stream.end(), chunk, chunk + length);
+        }
+        streamUs += elapsedUs(t);
+
+        t = Clock::now();
+        PowerData data = analyzer.analyze(latest, PowerAnalyzer::FRAMES_PER_BLOCK, timestampMs);
+        analyzeUs += elapsedUs(t);
+        if (data.voltageA < minSag) {
+            minSag = data.voltageA;
+        }
+    }
+
+    // Запись закончена: хвост пирамиды и остаток потока
+    capture.update();
+    size_t length;
+    while ((length = capture.readStream(generation, stream.size(), chunk, sizeof(chunk))) != 0) {
+        if (length == DEEP_STREAM_WAIT) {
+            fprintf(stderr, "Stream still waiting after the capture ended\n");
+            return 1;
+        }
+        stream.insert(stream.end(), chunk, chunk + length);
+    }
+
+    // Кадры из потока: он же проверяет, что раскладка CaptureFormat собрана верно
+    DeepCaptureStatus status = capture.getStatus();
+    const size_t stride = sizeof(CaptureBlockHeader) + PowerAnalyzer::BLOCK_SAMPLES * sizeof(int16_t);
+    bool streamOk = stream.size() == sizeof(CaptureHeader) + (size_t)status.blocks * stride &&
+                    memcmp(stream.data(), &header, sizeof(header)) == 0;
+    std::vector<int16_t> frames((size_t)status.frames * PowerAnalyzer::CHANNELS);
+    for (uint32_t b = 0; streamOk && b < status.blocks; b++) {
+        CaptureBlockHeader bh;
+        memcpy(&bh, &stream[sizeof(CaptureHeader) + b * stride], sizeof(bh));
+        streamOk = bh.magic == CAPTURE_BLOCK_MAGIC && bh.seq == b &&
+                   bh.frameCount == PowerAnalyzer::FRAMES_PER_BLOCK;
+        memcpy(&frames[(size_t)b * PowerAnalyzer::BLOCK_SAMPLES],
+               &stream[sizeof(CaptureHeader) + b * stride + sizeof(bh)],
+               PowerAnalyzer::BLOCK_SAMPLES * sizeof(int16_t));
+    }
+
+    uint32_t mismatches = 0;
+    for (int level = 0; streamOk && level < DEEP_ENVELOPE_LEVELS; level++) {
+        mismatches += verifyLevel(capture, level, frames, status.frames);
+    }
+
+    // Обзор всей записи, как его запросит страница: 500 точек
+    DeepEnvelopeQuery query = capture.makeEnvelopeQuery(0, status.frames, 500);
+    std::vector<uint8_t> overview;
+    while ((length = capture.readEnvelope(query, overview.size(), chunk, sizeof(chunk))) != 0) {
+        overview.insert(overview.end(), chunk, chunk + length);
+    }
+    DeepEnvelopeHeader eh;
+    memcpy(&eh, overview.data(), sizeof(eh));
+    bool overviewOk = eh.magic == DEEP_ENVELOPE_MAGIC && eh.bucketCount >= 500 &&
+                      overview.size() == sizeof(eh) + (size_t)eh.bucketCount * PowerAnalyzer::CHANNELS * 2 * sizeof(int16_t);
+
+    printf("Deep capture: %u s, %u blocks x %d frames x %d channels, buffer %zu KB (%d s max)\n",
+           seconds, status.blocks, PowerAnalyzer::FRAMES_PER_BLOCK, PowerAnalyzer::CHANNELS,
+           capture.getBufferSize() / 1024, DEEP_CAPTURE_MAX_SECONDS);
+    printf("Schedule:     %u late frames, %u gaps between blocks\n", status.lateFrames, gaps);
+    printf("Per block:    acquire %.0f us, update %.1f us, readStream %.1f us (%zu B in %d B chunks), analyze %.1f us\n",
+           acquireUs / blocks, updateUs / blocks, streamUs / blocks, stride, STREAM_CHUNK, analyzeUs / blocks);
+    printf("Stream:       %zu bytes, %s\n", stream.size(), streamOk ? "matches the capture format" : "MISMATCH");
+    printf("Envelope:     %d levels (%u..%u frames/bucket), %u mismatched buckets vs brute force\n",
+           DEEP_ENVELOPE_LEVELS, capture.framesPerBucket(0), capture.framesPerBucket(DEEP_ENVELOPE_LEVELS - 1),
+           mismatches);
+    printf("Overview:     level %u, %u buckets x %u frames, %zu bytes, %s\n",
+           eh.level, eh.bucketCount, eh.framesPerBucket, overview.size(), overviewOk ? "ok" : "BAD");
+    printf("Sag:          phase A min %.1f V (analyze of the latest block)\n", minSag);
+
+    // Огибающая фазы A по блокам: провал виден без скачивания полного разрешения.
+    // Блок — целое число интервалов только уровня 0, на грубых они захватили бы соседей
+    printf("\n%8s %10s %10s\n", "time_ms", "A_min_V", "A_max_V");
+    const float offset = header.offsets[0];
+    const float calibration = header.calibration[0];
+    for (uint32_t f = 0; f < status.frames; f += PowerAnalyzer::FRAMES_PER_BLOCK) {
+        DeepEnvelopeQuery q = capture.makeEnvelopeQuery(f, f + PowerAnalyzer::FRAMES_PER_BLOCK,
+                                                       PowerAnalyzer::FRAMES_PER_BLOCK / DEEP_ENVELOPE_BUCKET_FRAMES);
+        int16_t lo = INT16_MAX;
+        int16_t hi = INT16_MIN;
+        for (uint32_t b = 0; b < q.bucketCount; b++) {
+            const int16_t* bucket = capture.envelopeBucket(q.level, q.firstBucket + b);
+            lo = bucket[0] < lo ? bucket[0] : lo;
+            hi = bucket[1] > hi ? bucket[1] : hi;
+        }
+        printf("%8u %10.1f %10.1f\n", f * 1000 / PowerAnalyzer::SAMPLE_RATE_HZ,
+               (lo - offset) * calibration, (hi - offset) * calibration);
+    }
+
+    if (capturePath != nullptr) {
+        FILE* out = fopen(capturePath, "wb");
+        if (out == nullptr || fwrite(stream.data(), 1, stream.size(), out) != stream.size() || fclose(out) != 0) {
+            perror(capturePath);
+            return 1;
+        }
+        fprintf(stderr, "Wrote the deep capture stream to %s\n", capturePath);
+    }
+
+    return streamOk && mismatches == 0 && overviewOk && gaps == 0 ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+#ifndef DEEP_CAPTURE_BENCH_H
+#define DEEP_CAPTURE_BENCH_H
+
+#include <stdint.h>
+#include "SyntheticGrid.h"
+
+/**
+ * Глубокий захват на хосте: писатель (acquire() блоками встык) и читатели
+ * (update(), readStream() кусками по TCP-сегменту, analyze() последнего блока)
+ * по очереди в одном потоке, как их чередует планировщик на устройстве.
+ *
+ * Во время записи фаза A проседает до 60 % на 600 мс. Проверяет, что расписание
+ * непрерывно, поток полного разрешения совпадает с записанным, а каждый
+ * интервал каждого уровня пирамиды — с min/max, посчитанными перебором.
+ * Печатает стоимость update/readStream/analyze на блок и грубую огибающую провала.
+ * @param seconds Длительность записи
+ * @param capturePath Куда сохранить поток (для --replay), nullptr — не сохранять
+ * @return Код выхода процесса (1 — проверка не прошла)
+ */
+int runDeepCaptureBench(uint32_t seconds, SyntheticGrid& grid, float voltage, const char* capturePath);
+
+#endif // DEEP_CAPTURE_BENCH_H
@@ -0,0 +1,350 @@
+#include "FlightSim.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "../config.h"
+#include "../hal/Hal.h"
+#include "../hal/HalNative.h"
+#include "../PowerAnalyzer.h"
+#include "../FrequencyTracker.h"
+#include "../FlightRecorder.h"
+#include "SyntheticGrid.h"
+
+// UTC первого блока (после NTP); не на границе миллисекунды
+#define START_US (1700000000ull * 1000000 + 123457)
+
+// UTC новой загрузки для меток записи без NTP
+#define BOOT_UTC_MS (1700000000ull * 1000 + 60000)
+
+#define NORMAL_VOLTAGE 230.0f
+#define SAG_VOLTAGE 160.0f
+
+// Пределы: RMS периода (окно — номинальный период, частота сети чуть ниже), частота
+// периода (как --rocof-sim; скачок амплитуды сдвигает один переход)
+#define RMS_LIMIT_PCT 1.0
+#define FREQUENCY_LIMIT_HZ 0.05
+
+static const int SECONDS = 8;
+static const int SAG_FROM_S = 6;
+
+/**
+ * Поток кадров задачи оцифровки: FrequencyTracker и FlightRecorder
+ */
+struct Stream {
+    PowerAnalyzer analyzer;
+    FrequencyTracker tracker;
+    std::vector<int16_t> block;
+    uint32_t startUs;
+
+    Stream() : analyzer(ANALYZER_CHANNEL_PINS, ANALYZER_CHANNEL_CALIBRATION),
+               block(PowerAnalyzer::BLOCK_SAMPLES), startUs(0) {}
+
+    void begin(FlightRecorder& recorder) {
+        analyzer.begin();
+        float offsets[FLIGHTREC_MAX_CHANNELS];
+        float sensitivities[FLIGHTREC_MAX_CHANNELS];
+        for (int ch = 0; ch < PowerAnalyzer::VOLTAGE_CHANNELS; ch++) {
+            offsets[ch] = analyzer.getOffset(ch);
+            sensitivities[ch] = analyzer.getSensitivity(ch);
+        }
+        tracker.begin(PowerAnalyzer::VOLTAGE_CHANNELS, PowerAnalyzer::SAMPLE_RATE_HZ, NOMINAL_FREQUENCY, offsets,
+                      FREQSTREAM_HYSTERESIS_COUNTS * PowerAnalyzer::FRAME_SCALE);
+        recorder.begin(PowerAnalyzer::VOLTAGE_CHANNELS, PowerAnalyzer::SAMPLE_RATE_HZ, NOMINAL_FREQUENCY,
+                       offsets, sensitivities);
+        startUs = PowerAnalyzer::startNowUs();
+    }
+
+    /**
+     * Блок FRAMES_PER_BLOCK кадров
+     * @param utcUs Время первого кадра
+     */
+    void run(FlightRecorder& recorder, uint64_t utcUs, bool timeValid) {
+        const uint32_t blockUs = PowerAnalyzer::FRAMES_PER_BLOCK * PowerAnalyzer::INTERVAL_US;
+        uint32_t maxLateUs;
+        tracker.beginBlock(utcUs);
+        recorder.beginBlock(utcUs, timeValid);
+        analyzer.acquire(block.data(), startUs, maxLateUs, [&](const int16_t* frame, int i) {
+            tracker.push(frame);
+            recorder.push(frame, tracker.getFrequency());
+        });
+        startUs += blockUs;
+    }
+};
+
+static bool check(const char* name, bool ok, const char* detail) {
+    printf("%-44s %-40s %s\n", name, detail, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+/**
+ * Провал напряжения и перезагрузка по просадке после NTP
+ */
+static bool runBrownout(SyntheticGrid& grid, double gridFrequency) {
+    const uint32_t blockUs = PowerAnalyzer::FRAMES_PER_BLOCK * PowerAnalyzer::INTERVAL_US;
+    const int blocks = SECONDS * 1000000 / blockUs;
+    bool pass = true;
+    char detail[96];
+
+    NativeHal::simulateReset(ResetReason::POWER_ON);
+    FlightRecorder* recorder = new FlightRecorder();
+    int preserved = recorder->restore(Hal::resetReason());
+    snprintf(detail, sizeof(detail), "%d records", preserved);
+    pass &= check("power-on, random RTC memory", preserved == 0, detail);
+
+    Stream stream;
+    stream.begin(*recorder);
+    for (int b = 0; b < blocks; b++) {
+        if (b == SAG_FROM_S * 1000000 / (int)blockUs) {
+            for (int ph = 0; ph < 3; ph++) {
+                grid.setPhaseVoltage(ph, SAG_VOLTAGE);
+            }
+        }
+        stream.run(*recorder, START_US + (uint64_t)b * blockUs, true);
+    }
+    uint32_t recorded = recorder->getRecordCount();
+
+    // Перезагрузка: объект в RAM пропал, RTC-память осталась
+    delete recorder;
+    NativeHal::simulateReset(ResetReason::BROWNOUT);
+    recorder = new FlightRecorder();
+    preserved = recorder->restore(Hal::resetReason());
+    snprintf(detail, sizeof(detail), "%d of %u records, %.2f s, min %.1f V", preserved, (unsigned)recorded,
+             recorder->getPreservedSpanMs() / 1000.0, recorder->getPreservedMinVoltage());
+    pass &= check("brownout: ring preserved", preserved == FLIGHTREC_RECORDS, detail);
+    if (preserved == 0) {
+        delete recorder;
+        return false;
+    }
+
+    // Метки: шаг — номинальный период, последняя — не раньше периода до конца последнего блока
+    // (при 60 Гц период не делит блок)
+    const FlightRecord* records = recorder->getPreserved();
+    const uint32_t periodMs = (uint32_t)lroundf(1000.0f / NOMINAL_FREQUENCY);
+    int badSteps = 0;
+    for (int i = 1; i < preserved; i++) {
+        uint32_t step = records[i].timeOffsetMs - records[i - 1].timeOffsetMs;
+        if (step + 1 < periodMs || step > periodMs + 1) {
+            badSteps++;
+        }
+    }
+    snprintf(detail, sizeof(detail), "%d bad steps, span %u ms", badSteps,
+             (unsigned)recorder->getPreservedSpanMs());
+    pass &= check("timestamps: one per nominal cycle", badSteps == 0, detail);
+
+    static char lines[FLIGHTREC_RECORDS * 160];
+    size_t length = recorder->writeLineProtocol(0, preserved, lines, sizeof(lines), "bench", BOOT_UTC_MS);
+    unsigned long long lastMs = 0;
+    const char* lastLine = length > 0 ? strrchr(lines, '\n') : nullptr;
+    if (lastLine != nullptr) {
+        const char* p = lastLine;
+        while (p > lines && p[-1] != ' ') {
+            p--;
+        }
+        lastMs = strtoull(p, nullptr, 10);
+    }
+    unsigned long long expectedMs = (START_US + (uint64_t)blocks * blockUs) / 1000;
+    snprintf(detail, sizeof(detail), "last %llu, expected %llu", lastMs, expectedMs);
+    pass &= check("last record at end of sampling (ntp)", lastMs <= expectedMs && expectedMs - lastMs <= periodMs,
+                  detail);
+
+    // RMS до и во время провала, частота; запись в точке провала не проверяется
+    uint64_t sagMs = (START_US + (uint64_t)SAG_FROM_S * 1000000) / 1000 - START_US / 1000;
+    double maxNormalError = 0.0;
+    double maxSagError = 0.0;
+    double maxFrequencyError = 0.0;
+    int normal = 0;
+    int sag = 0;
+    int noFrequency = 0;
+    for (int i = 0; i < preserved; i++) {
+        const FlightRecord& r = records[i];
+        // Смещения — от базы, заданной первым блоком
+        uint64_t offset = r.timeOffsetMs;
+        for (int ph = 0; ph < PowerAnalyzer::VOLTAGE_CHANNELS; ph++) {
+            double v = r.rmsDeciV[ph] / 10.0;
+            if (offset <= sagMs) {
+                maxNormalError = fmax(maxNormalError, fabs(v - NORMAL_VOLTAGE) / NORMAL_VOLTAGE * 100.0);
+            } else if (offset > sagMs + periodMs) {
+                maxSagError = fmax(maxSagError, fabs(v - SAG_VOLTAGE) / SAG_VOLTAGE * 100.0);
+            }
+        }
+        offset <= sagMs ? normal++ : sag++;
+        if (r.frequencyMhz == FLIGHTREC_NO_FREQUENCY) {
+            noFrequency++;
+        } else {
+            double f = NOMINAL_FREQUENCY + r.frequencyMhz / 1000.0;
+            maxFrequencyError = fmax(maxFrequencyError, fabs(f - gridFrequency));
+        }
+    }
+    snprintf(detail, sizeof(detail), "%d cycles, max error %.2f %%", normal, maxNormalError);
+    pass &= check("RMS before sag (230 V)", normal > 0 && maxNormalError <= RMS_LIMIT_PCT, detail);
+    snprintf(detail, sizeof(detail), "%d cycles, max error %.2f %%", sag, maxSagError);
+    pass &= check("RMS during sag (160 V)", sag > 0 && maxSagError <= RMS_LIMIT_PCT, detail);
+    snprintf(detail, sizeof(detail), "max error %.1f mHz, %d without", maxFrequencyError * 1000.0, noFrequency);
+    pass &= check("frequency", noFrequency == 0 && maxFrequencyError <= FREQUENCY_LIMIT_HZ, detail);
+
+    // Отправка кусками по FLIGHTREC_UPLOAD_CHUNK: буфер loop() вмещает кусок
+    static char chunk[FLIGHTREC_LINE_PROTOCOL_SIZE];
+    int chunks = 0;
+    int points = 0;
+    size_t maxChunk = 0;
+    for (int first = 0; first < preserved; first += FLIGHTREC_UPLOAD_CHUNK) {
+        size_t n = recorder->writeLineProtocol(first, FLIGHTREC_UPLOAD_CHUNK, chunk, sizeof(chunk),
+                                               "esp32_grid_01_long_device_id_xyz", BOOT_UTC_MS);
+        if (n == 0) {
+            break;
+        }
+        chunks++;
+        maxChunk = n > maxChunk ? n : maxChunk;
+        for (size_t k = 0; k < n; k++) {
+            points += chunk[k] == '\n';
+        }
+    }
+    snprintf(detail, sizeof(detail), "%d chunks, %d points, max %u of %u bytes", chunks, points,
+             (unsigned)maxChunk, (unsigned)sizeof(chunk));
+    pass &= check("flight_record upload chunks", points == preserved, detail);
+    printf("  %.*s\n", (int)(strchr(lines, '\n') - lines), lines);
+
+    delete recorder;
+    return pass;
+}
+
+/**
+ * Испорченный заголовок, включение питания, время до и после NTP
+ */
+static bool runResets() {
+    const uint32_t blockUs = PowerAnalyzer::FRAMES_PER_BLOCK * PowerAnalyzer::INTERVAL_US;
+    bool pass = true;
+    char detail[96];
+
+    // Заголовок испорчен (сброс посреди его записи): кольцу не верим
+    {
+        FlightRecorder recorder;
+        recorder.restore(ResetReason::POWER_ON);
+        Stream stream;
+        stream.begin(recorder);
+        for (int b = 0; b < 5; b++) {
+            stream.run(recorder, START_US + (uint64_t)b * blockUs, true);
+        }
+        size_t size;
+        FlightRecorderHeader* header = static_cast<FlightRecorderHeader*>(Hal::retainedMemory(size));
+        header->baseMs ^= 1;
+        FlightRecorder rebooted;
+        int preserved = rebooted.restore(ResetReason::WATCHDOG);
+        snprintf(detail, sizeof(detail), "%d records", preserved);
+        pass &= check("watchdog, torn header", preserved == 0, detail);
+    }
+
+    // Кольцо цело, но сброс — включение питания
+    {
+        FlightRecorder recorder;
+        recorder.restore(ResetReason::POWER_ON);
+        Stream stream;
+        stream.begin(recorder);
+        for (int b = 0; b < 5; b++) {
+            stream.run(recorder, START_US + (uint64_t)b * blockUs, true);
+        }
+        FlightRecorder rebooted;
+        int preserved = rebooted.restore(ResetReason::POWER_ON);
+        snprintf(detail, sizeof(detail), "%d records", preserved);
+        pass &= check("power-on with intact ring", preserved == 0, detail);
+    }
+
+    // Без NTP: метки от загрузки, последняя — на BOOT_UTC_MS
+    {
+        FlightRecorder recorder;
+        recorder.restore(ResetReason::POWER_ON);
+        Stream stream;
+        stream.begin(recorder);
+        const uint64_t uptimeUs = 5000000;
+        for (int b = 0; b < 10; b++) {
+            stream.run(recorder, uptimeUs + (uint64_t)b * blockUs, false);
+        }
+        FlightRecorder rebooted;
+        int preserved = rebooted.restore(ResetReason::PANIC);
+        static char lines[FLIGHTREC_RECORDS * 160];
+        size_t length = rebooted.writeLineProtocol(0, preserved, lines, sizeof(lines), "bench", BOOT_UTC_MS);
+        const char* last = length > 0 ? strrchr(lines, ' ') : nullptr;
+        unsigned long long lastMs = last != nullptr ? strtoull(last + 1, nullptr, 10) : 0;
+        bool boot = length > 0 && strstr(lines, "reset=panic,clock=boot") != nullptr;
+        snprintf(detail, sizeof(detail), "%d records, last %llu", preserved, lastMs);
+        pass &= check("panic before NTP: clock=boot", preserved == 10 * PowerAnalyzer::FRAMES_PER_BLOCK /
+                      (int)lroundf(PowerAnalyzer::SAMPLE_RATE_HZ / NOMINAL_FREQUENCY) && boot &&
+                      lastMs == BOOT_UTC_MS, detail);
+    }
+
+    // NTP посреди записи: кольцо начинается заново с UTC
+    {
+        FlightRecorder recorder;
+        recorder.restore(ResetReason::POWER_ON);
+        Stream stream;
+        stream.begin(recorder);
+        for (int b = 0; b < 5; b++) {
+            stream.run(recorder, 5000000 + (uint64_t)b * blockUs, false);
+        }
+        for (int b = 0; b < 5; b++) {
+            stream.run(recorder, START_US + (uint64_t)b * blockUs, true);
+        }
+        FlightRecorder rebooted;
+        int preserved = rebooted.restore(ResetReason::BROWNOUT);
+        static char lines[FLIGHTREC_RECORDS * 160];
+        size_t length = rebooted.writeLineProtocol(0, preserved, lines, sizeof(lines), "bench", BOOT_UTC_MS);
+        bool ntp = length > 0 && strstr(lines, "clock=ntp") != nullptr;
+        // Период, начатый до синхронизации, заканчивается уже в новом кольце
+        const int expected = 5 * PowerAnalyzer::FRAMES_PER_BLOCK /
+                             (int)lroundf(PowerAnalyzer::SAMPLE_RATE_HZ / NOMINAL_FREQUENCY);
+        snprintf(detail, sizeof(detail), "%d records after sync", preserved);
+        pass &= check("NTP sync restarts the ring", ntp && preserved >= expected && preserved <= expected + 1,
+                      detail);
+    }
+    return pass;
+}
+
+/**
+ * Цена push() на кадр: задача оцифровки вызывает его на каждый кадр
+ */
+static void measurePush() {
+    FlightRecorder recorder;
+    recorder.restore(ResetReason::POWER_ON);
+    const float offsets[FLIGHTREC_MAX_CHANNELS] = {ADC_OFFSET, ADC_OFFSET, ADC_OFFSET};
+    const float sensitivities[FLIGHTREC_MAX_CHANNELS] = {CALIBRATION_COEFF_A, CALIBRATION_COEFF_B,
+                                                         CALIBRATION_COEFF_C};
+    recorder.begin(3, PowerAnalyzer::SAMPLE_RATE_HZ, NOMINAL_FREQUENCY, offsets, sensitivities);
+    recorder.beginBlock(START_US, true);
+
+    const int frames = 1000000;
+    std::vector<int16_t> samples(3 * 1000);
+    for (size_t i = 0; i < samples.size(); i++) {
+        samples[i] = (int16_t)(ADC_OFFSET + 1000 * sinf(2.0f * (float)M_PI * (i / 3) / 200.0f + (i % 3) * 2.094f));
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        recorder.push(&samples[(i % 1000) * 3], NOMINAL_FREQUENCY);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    printf("\npush(): %.1f ns/frame on this host, %u records (budget %u us per frame on the device)\n",
+           ns / frames, (unsigned)recorder.getRecordCount(), (unsigned)PowerAnalyzer::INTERVAL_US);
+}
+
+int runFlightSim() {
+    const float gridFrequency = NOMINAL_FREQUENCY - 0.2f;
+    SyntheticGrid grid(NORMAL_VOLTAGE, gridFrequency, 8);
+    NativeHal::setAdcSource(&grid);
+    // Таблица SyntheticGrid — синус с целым периодом в мкс
+    const double frequency = 1e6 / (double)lroundf(1000000.0f / gridFrequency);
+
+    printf("Flight recorder: %d records x %u B in %d B of retained memory, %d s at %.0f V, sag to %.0f V\n\n",
+           FLIGHTREC_RECORDS, (unsigned)sizeof(FlightRecord), RETAINED_MEMORY_BYTES, SAG_FROM_S,
+           NORMAL_VOLTAGE, SAG_VOLTAGE);
+    bool pass = runBrownout(grid, frequency);
+
+    SyntheticGrid steady(NORMAL_VOLTAGE, gridFrequency, 8);
+    NativeHal::setAdcSource(&steady);
+    pass &= runResets();
+    NativeHal::setAdcSource(nullptr);
+
+    measurePush();
+    printf("\nFlight recorder check %s\n", pass ? "passed" : "FAILED");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+#ifndef FLIGHT_SIM_H
+#define FLIGHT_SIM_H
+
+/**
+ * Проверка бортового самописца (FlightRecorder)
+ *
+ * SyntheticGrid через acquire() с обработкой кадра, как в задаче оцифровки
+ * FrequencyStream: 6 с при номинале, провал до 160 В на 2 с, затем
+ * перезагрузка NativeHal::simulateReset(BROWNOUT) и restore() новым
+ * экземпляром. Проверяются число сохранённых периодов, шаг и привязка меток,
+ * RMS до и во время провала, частота, точки flight_record. Затем — что
+ * после включения питания и с испорченным заголовком ничего не
+ * восстанавливается, что без NTP метки отсчитываются от загрузки и что
+ * NTP начинает кольцо заново. В конце — цена push() на кадр.
+ * @return Код выхода процесса (1 — проверка не прошла)
+ */
+int runFlightSim();
+
+#endif // FLIGHT_SIM_H
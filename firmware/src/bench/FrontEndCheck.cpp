@@ -0,0 +1,400 @@
+#include "FrontEndCheck.h"
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "../config.h"
+#include "../hal/Hal.h"
+#include "../hal/HalNative.h"
+#include "../PowerAnalyzer.h"
+#include "../Decimator.h"
+#include "SyntheticGrid.h"
+
+// Полоса, в которой важны гармоники (до 40-й при 50 Гц)
+#define PASSBAND_HZ 2000.0
+#define PASSBAND_LIMIT_DB 0.1
+#define ALIAS_LIMIT_DB -60.0
+
+// Синус для АЧХ: амплитуда в отсчётах и длина замера в выходных кадрах
+#define TONE_AMPLITUDE 1500.0
+#define TONE_FRAMES 8192
+
+// Снижение шума должно совпасть с расчётным √Σh² с этой точностью
+#define NOISE_TOLERANCE 0.05
+
+// Сквозной путь: ошибка фазы кадров, мкс
+#define PHASE_LIMIT_US 1.0
+
+// Выигрыш в битах на выходе должен совпасть с getEnobGain() с этой точностью
+#define ENOB_TOLERANCE_BITS 0.1
+
+// Тракт с шумом АЦП меньше LSB: здесь округление до целых съедает выигрыш
+#define QUIET_NOISE_COUNTS 0.6
+
+static uint32_t randomState = 2463534242u;
+
+static uint32_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+/**
+ * Гауссов шум (сумма 12 равномерных), σ = 1
+ */
+static double nextGaussian() {
+    double sum = 0.0;
+    for (int i = 0; i < 12; i++) {
+        sum += nextRandom() / 4294967296.0;
+    }
+    return sum - 6.0;
+}
+
+static int16_t clampCounts(double value) {
+    long counts = lround(value);
+    return (int16_t)(counts < 0 ? 0 : (counts > ADC_MAX_VALUE ? ADC_MAX_VALUE : counts));
+}
+
+/**
+ * Синус через дециматор: амплитуда выхода на частоте после децимации
+ * (окно Ханна, корреляция), в дБ относительно входа
+ */
+static double toneGainDb(Decimator& decimator, double frequency, double inputRateHz) {
+    const int factor = decimator.getFactor();
+    const double outputRateHz = inputRateHz / factor;
+    // Частота, на которую ложится тон после децимации
+    double folded = fmod(frequency, outputRateHz);
+    if (folded > outputRateHz / 2) {
+        folded = outputRateHz - folded;
+    }
+
+    decimator.reset(ADC_OFFSET);
+    std::vector<double> output(TONE_FRAMES);
+    const int warmup = decimator.getTaps();
+    long n = 0;
+    for (int i = -warmup; i < TONE_FRAMES; i++) {
+        int16_t frame;
+        for (int r = 0; r < factor; r++, n++) {
+            int16_t sample = clampCounts(ADC_OFFSET + TONE_AMPLITUDE * sin(2.0 * M_PI * frequency * n / inputRateHz));
+            decimator.shift(&sample);
+        }
+        decimator.output(&frame);
+        if (i >= 0) {
+            output[i] = (double)frame / (1 << decimator.getFractionBits()) - ADC_OFFSET;
+        }
+    }
+
+    double re = 0.0;
+    double im = 0.0;
+    double windowSum = 0.0;
+    for (int i = 0; i < TONE_FRAMES; i++) {
+        double w = 0.5 - 0.5 * cos(2.0 * M_PI * i / (TONE_FRAMES - 1));
+        double angle = 2.0 * M_PI * folded * i / outputRateHz;
+        re += w * output[i] * cos(angle);
+        im += w * output[i] * sin(angle);
+        windowSum += w;
+    }
+    double amplitude = 2.0 * sqrt(re * re + im * im) / windowSum;
+    return 20.0 * log10(amplitude / TONE_AMPLITUDE + 1e-12);
+}
+
+/**
+ * Отношение σ шума на выходе и на входе (белый гауссов шум σ = 8 отсчётов)
+ */
+static double noiseRatio(Decimator& decimator) {
+    const double sigma = 8.0;
+    const int factor = decimator.getFactor();
+    decimator.reset(ADC_OFFSET);
+    double inSquares = 0.0;
+    double outSquares = 0.0;
+    long inCount = 0;
+    long outCount = 0;
+    for (int i = -decimator.getTaps(); i < 50000; i++) {
+        for (int r = 0; r < factor; r++) {
+            int16_t sample = clampCounts(ADC_OFFSET + sigma * nextGaussian());
+            decimator.shift(&sample);
+            if (i >= 0) {
+                inSquares += (double)(sample - ADC_OFFSET) * (sample - ADC_OFFSET);
+                inCount++;
+            }
+        }
+        int16_t frame;
+        decimator.output(&frame);
+        if (i >= 0) {
+            double value = (double)frame / (1 << decimator.getFractionBits()) - ADC_OFFSET;
+            outSquares += value * value;
+            outCount++;
+        }
+    }
+    return sqrt(outSquares / outCount) / sqrt(inSquares / inCount);
+}
+
+/**
+ * Кадр трёх каналов: factor подкадров в историю и свёртка, нс
+ */
+static double frameCostNs(int factor) {
+    Decimator decimator;
+    decimator.begin(3, factor, OVERSAMPLE_TAPS_PER_PHASE, OVERSAMPLE_FRACTION_BITS);
+    int16_t subframe[3] = {ADC_OFFSET, ADC_OFFSET, ADC_OFFSET};
+    int16_t frame[3];
+    volatile int sink = 0;
+    const int frames = 200000;
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        for (int r = 0; r < factor; r++) {
+            subframe[r % 3] = (int16_t)(ADC_OFFSET + (i & 255));
+            decimator.shift(subframe);
+        }
+        decimator.output(frame);
+        sink += frame[0];
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+    (void)sink;
+    return ns / frames;
+}
+
+/**
+ * ENOB 12-битного АЦП по остатку шума σ (отсчётов) на полной шкале
+ */
+static double enob(double sigma) {
+    double sinad = 20.0 * log10((ADC_MAX_VALUE + 1) / 2.0 / sqrt(2.0) / sigma);
+    return (sinad - 1.76) / 6.02;
+}
+
+/**
+ * МНК: x = a·sin + b·cos + c по фазам отсчётов
+ * @param coef a, b, c
+ * @return СКО остатка
+ */
+static double fitSine(const std::vector<double>& values, const std::vector<double>& phases, double* coef) {
+    double s[3][3] = {};
+    double y[3] = {};
+    for (size_t i = 0; i < values.size(); i++) {
+        double basis[3] = {sin(phases[i]), cos(phases[i]), 1.0};
+        for (int r = 0; r < 3; r++) {
+            y[r] += basis[r] * values[i];
+            for (int c = 0; c < 3; c++) {
+                s[r][c] += basis[r] * basis[c];
+            }
+        }
+    }
+    double det = s[0][0] * (s[1][1] * s[2][2] - s[1][2] * s[2][1]) - s[0][1] * (s[1][0] * s[2][2] - s[1][2] * s[2][0]) +
+                 s[0][2] * (s[1][0] * s[2][1] - s[1][1] * s[2][0]);
+    for (int k = 0; k < 3; k++) {
+        double m[3][3];
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                m[r][c] = c == k ? y[r] : s[r][c];
+            }
+        }
+        coef[k] = (m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                   m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0])) / det;
+    }
+    double residual = 0.0;
+    for (size_t i = 0; i < values.size(); i++) {
+        double fit = coef[0] * sin(phases[i]) + coef[1] * cos(phases[i]) + coef[2];
+        residual += (values[i] - fit) * (values[i] - fit);
+    }
+    return sqrt(residual / values.size());
+}
+
+/**
+ * Синус 50 Гц с гауссовым шумом через дециматор, целые отсчёты на входе как у АЦП
+ * @param sigma СКО шума, отсчёты
+ * @param inputSigma СКО отличия подкадров от синуса (шум и округление)
+ * @return СКО остатка кадров относительно синуса, отсчёты АЦП
+ */
+static double decimatedResidual(Decimator& decimator, double sigma, double& inputSigma) {
+    const int factor = decimator.getFactor();
+    const double inputRateHz = (double)PowerAnalyzer::SAMPLE_RATE_HZ * factor;
+    const double scale = 1 << decimator.getFractionBits();
+    decimator.reset(ADC_OFFSET);
+    std::vector<double> values;
+    std::vector<double> phases;
+    double inSquares = 0.0;
+    long n = 0;
+    for (int i = -decimator.getTaps(); i < 20000; i++) {
+        for (int r = 0; r < factor; r++, n++) {
+            double exact = ADC_OFFSET + TONE_AMPLITUDE * sin(2.0 * M_PI * 50.0 * n / inputRateHz);
+            int16_t sample = clampCounts(exact + sigma * nextGaussian());
+            decimator.shift(&sample);
+            inSquares += (sample - exact) * (sample - exact);
+        }
+        int16_t frame;
+        decimator.output(&frame);
+        if (i >= 0) {
+            values.push_back(frame / scale - ADC_OFFSET);
+            phases.push_back(2.0 * M_PI * 50.0 * (n - 1 - decimator.getDelaySubframes()) / inputRateHz);
+        }
+    }
+    inputSigma = sqrt(inSquares / n);
+    double coef[3];
+    return fitSine(values, phases, coef);
+}
+
+/**
+ * Кадры до конца тракта: выигрыш в битах по остатку синуса против
+ * getEnobGain(), с дробными битами кадра и с округлением до целых отсчётов.
+ * Не зависит от OVERSAMPLE_FACTOR сборки
+ */
+static bool runDeliveredGain() {
+    const int factor = OVERSAMPLE_FACTOR > 1 ? OVERSAMPLE_FACTOR : 4;
+    const int bits[] = {OVERSAMPLE_FRACTION_BITS, 0};
+    const double noises[] = {QUIET_NOISE_COUNTS, 4.0};
+    bool pass = true;
+    printf("\nDelivered gain, x%d, 50 Hz sine %.0f counts + gaussian noise, fit residual of frames:\n", factor,
+           TONE_AMPLITUDE);
+    printf("%-15s %11s %10s %10s %10s %s\n", "frames", "noise in", "out", "bits +", "reported", "");
+    for (size_t b = 0; b < sizeof(bits) / sizeof(bits[0]); b++) {
+        Decimator decimator;
+        if (!decimator.begin(1, factor, OVERSAMPLE_TAPS_PER_PHASE, bits[b])) {
+            printf("x%d with %d fraction bits does not fit  FAIL\n", factor, bits[b]);
+            return false;
+        }
+        for (size_t k = 0; k < sizeof(noises) / sizeof(noises[0]); k++) {
+            double inputSigma;
+            double outputSigma = decimatedResidual(decimator, noises[k], inputSigma);
+            double delivered = log2(inputSigma / outputSigma);
+            double reported = decimator.getEnobGain((float)inputSigma);
+            bool ok = fabs(delivered - reported) <= ENOB_TOLERANCE_BITS;
+            pass = pass && ok;
+            char label[32];
+            snprintf(label, sizeof(label), "1/%d count", 1 << bits[b]);
+            printf("%-15s %11.3f %10.3f %10.2f %10.2f %s\n", label, inputSigma, outputSigma, delivered, reported,
+                   ok ? "ok" : "FAIL");
+        }
+    }
+    return pass;
+}
+
+/**
+ * Сквозной путь: acquire() блоками встык, фаза A против расписания кадров
+ */
+static bool runEndToEnd() {
+    SyntheticGrid grid(230.0f, NOMINAL_FREQUENCY, 8);
+    NativeHal::setAdcSource(&grid);
+    PowerAnalyzer analyzer(ANALYZER_CHANNEL_PINS, ANALYZER_CHANNEL_CALIBRATION);
+    analyzer.begin();
+
+    // Таблица SyntheticGrid: синус с целым периодом в мкс, фаза A — sin(2π t / T)
+    const uint32_t periodUs = (uint32_t)lroundf(1000000.0f / NOMINAL_FREQUENCY);
+    const double amplitude = 230.0 / CALIBRATION_COEFF_A * sqrt(2.0);
+    const int blocks = 10;
+    std::vector<int16_t> block(PowerAnalyzer::BLOCK_SAMPLES);
+    std::vector<double> values;
+    std::vector<double> phases;
+    uint32_t startUs = PowerAnalyzer::startNowUs();
+    const uint32_t blockUs = PowerAnalyzer::FRAMES_PER_BLOCK * PowerAnalyzer::INTERVAL_US;
+    uint32_t late = 0;
+    uint32_t maxLateUs = 0;
+    for (int b = 0; b < blocks; b++) {
+        uint32_t blockMaxLateUs;
+        const uint32_t blockStartUs = startUs;
+        late += analyzer.acquire(block.data(), blockStartUs, blockMaxLateUs, [&](const int16_t* frame, int i) {
+            uint32_t frameUs = blockStartUs + (uint32_t)i * PowerAnalyzer::INTERVAL_US;
+            values.push_back((double)frame[0] / PowerAnalyzer::FRAME_SCALE - ADC_OFFSET);
+            phases.push_back(2.0 * M_PI * (frameUs % periodUs) / periodUs);
+        });
+        maxLateUs = blockMaxLateUs > maxLateUs ? blockMaxLateUs : maxLateUs;
+        startUs += blockUs;
+    }
+    NativeHal::setAdcSource(nullptr);
+
+    double coef[3];
+    double residualSigma = fitSine(values, phases, coef);
+    // Равномерный шум ±8 и округление таблицы
+    double inputSigma = sqrt((17.0 * 17.0 - 1.0) / 12.0 + 1.0 / 12.0);
+    double phaseErrorUs = atan2(coef[1], coef[0]) / (2.0 * M_PI) * periodUs;
+    double gainDb = 20.0 * log10(sqrt(coef[0] * coef[0] + coef[1] * coef[1]) / amplitude);
+    const Decimator& frontEnd = analyzer.getFrontEnd();
+    const double step = 1.0 / PowerAnalyzer::FRAME_SCALE;
+    double expectedSigma = sqrt(inputSigma * inputSigma * frontEnd.getNoiseGain() * frontEnd.getNoiseGain() +
+                                step * step / 12.0);
+    // Оценка шума анализатором по подкадрам против заданного
+    double measuredNoise = analyzer.getFrontEndInputNoise();
+
+    bool pass = fabs(phaseErrorUs) <= PHASE_LIMIT_US && fabs(gainDb) <= PASSBAND_LIMIT_DB &&
+                fabs(residualSigma / expectedSigma - 1.0) <= NOISE_TOLERANCE &&
+                fabs(measuredNoise / inputSigma - 1.0) <= NOISE_TOLERANCE &&
+                fabs(log2(inputSigma / residualSigma) - frontEnd.getEnobGain((float)measuredNoise)) <=
+                    ENOB_TOLERANCE_BITS &&
+                late == 0;
+    printf("\nacquire() + SyntheticGrid, x%d, %d blocks: phase %+.2f us (frame ready %u us after its time "
+           "through the filter), gain %+.3f dB, noise %.2f (estimated %.2f) -> %.2f counts (expected %.2f), "
+           "ENOB %.2f -> %.2f bits (reported +%.2f), late %u (max %u us), read %.1f %% + filter %.1f %% (host)  %s\n",
+           OVERSAMPLE_FACTOR, blocks, phaseErrorUs, (unsigned)PowerAnalyzer::FRONT_END_LEAD_US, gainDb, inputSigma,
+           measuredNoise, residualSigma, expectedSigma, enob(inputSigma), enob(residualSigma),
+           frontEnd.getEnobGain((float)measuredNoise), (unsigned)late, (unsigned)maxLateUs,
+           analyzer.getFrontEndReadLoad(), analyzer.getFrontEndFilterLoad(), pass ? "ok" : "FAIL");
+    return pass;
+}
+
+int runFrontEndCheck() {
+    const int factors[] = {2, 4, 8};
+    const double outputRateHz = PowerAnalyzer::SAMPLE_RATE_HZ;
+
+    printf("Front end check: %u Hz frames, %d taps per phase, passband %.0f Hz within %.2f dB, "
+           "alias into the passband below %.0f dB\n\n",
+           (unsigned)PowerAnalyzer::SAMPLE_RATE_HZ, OVERSAMPLE_TAPS_PER_PHASE, PASSBAND_HZ, PASSBAND_LIMIT_DB,
+           ALIAS_LIMIT_DB);
+    printf("%-7s %9s %5s %12s %16s %10s %10s %9s %12s %s\n", "factor", "input Hz", "taps", "passband dB",
+           "worst alias dB", "noise", "expected", "ENOB +", "ns/frame 3ch", "");
+
+    bool pass = true;
+    for (size_t f = 0; f < sizeof(factors) / sizeof(factors[0]); f++) {
+        const int factor = factors[f];
+        const double inputRateHz = outputRateHz * factor;
+        Decimator decimator;
+        if (!decimator.begin(1, factor, OVERSAMPLE_TAPS_PER_PHASE, OVERSAMPLE_FRACTION_BITS)) {
+            printf("x%-6d filter does not fit DECIMATOR_MAX_TAPS  FAIL\n", factor);
+            pass = false;
+            continue;
+        }
+
+        // Полоса: наибольшее отклонение от 0 дБ
+        double passbandDb = 0.0;
+        for (double hz = 50.0; hz <= PASSBAND_HZ; hz += 50.0) {
+            double gain = toneGainDb(decimator, hz, inputRateHz);
+            passbandDb = fabs(gain) > fabs(passbandDb) ? gain : passbandDb;
+        }
+
+        // Всё выше выходного Найквиста, что ложится в полосу (кроме самой постоянной составляющей)
+        double worstAliasDb = -200.0;
+        double worstAliasHz = 0.0;
+        for (double hz = outputRateHz / 2 + 50.0; hz < inputRateHz / 2; hz += 50.0) {
+            double folded = fmod(hz, outputRateHz);
+            folded = folded > outputRateHz / 2 ? outputRateHz - folded : folded;
+            if (folded < 50.0 || folded > PASSBAND_HZ) {
+                continue;
+            }
+            double gain = toneGainDb(decimator, hz, inputRateHz);
+            if (gain > worstAliasDb) {
+                worstAliasDb = gain;
+                worstAliasHz = hz;
+            }
+        }
+
+        double ratio = noiseRatio(decimator);
+        double expected = decimator.getNoiseGain();
+        double ns = frameCostNs(factor);
+        bool ok = fabs(passbandDb) <= PASSBAND_LIMIT_DB && worstAliasDb <= ALIAS_LIMIT_DB &&
+                  fabs(ratio / expected - 1.0) <= NOISE_TOLERANCE;
+        pass = pass && ok;
+        printf("x%-6d %9.0f %5d %12.3f %9.1f @%5.0f %10.3f %10.3f %9.2f %12.1f %s\n", factor, inputRateHz,
+               decimator.getTaps(), passbandDb, worstAliasDb, worstAliasHz, ratio, expected, -log2(ratio), ns,
+               ok ? "ok" : "FAIL");
+    }
+    printf("\nnoise: output/input sigma for white noise (8 counts); ENOB +: bits gained, log2 of the reduction\n");
+
+    pass = runDeliveredGain() && pass;
+    if (OVERSAMPLE_FACTOR > 1) {
+        pass = runEndToEnd() && pass;
+    } else {
+        printf("\nOVERSAMPLE_FACTOR is 1 in this build: acquire() reads one sample per frame, "
+               "analyzer path skipped\n");
+    }
+
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+#ifndef FRONT_END_CHECK_H
+#define FRONT_END_CHECK_H
+
+/**
+ * Проверка входного тракта с передискретизацией (Decimator)
+ *
+ * Для передискретизации ×2, ×4 и ×8 с OVERSAMPLE_TAPS_PER_PHASE отводов на
+ * фазу: АЧХ в полосе до 2 кГц по синусам через shift()/output() (окно Ханна,
+ * корреляция), подавление всего, что после децимации ложится в полосу до
+ * 2 кГц, снижение белого шума против расчётного √Σh² и прибавка
+ * эффективных бит, цена кадра трёх каналов. При OVERSAMPLE_FACTOR > 1 в
+ * сборке — ещё сквозной путь acquire() + SyntheticGrid: фаза кадров против
+ * их расписания (задержка фильтра скомпенсирована), остаток шума, ENOB и
+ * опоздавшие кадры.
+ * @return Код выхода процесса (1 — проверка не прошла)
+ */
+int runFrontEndCheck();
+
+#endif // FRONT_END_CHECK_H
@@ -0,0 +1,271 @@
+#include "HistogramSim.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "../config.h"
+#include "../hal/Hal.h"
+#include "../hal/HalNative.h"
+#include "../PowerAnalyzer.h"
+#include "../LineProtocol.h"
+#include "../VoltageHistogram.h"
+#include "SyntheticGrid.h"
+
+// Полных интервалов (перед ними — неполный)
+#define INTERVALS 3
+#define CYCLES_PER_BLOCK (PowerAnalyzer::FRAMES_PER_BLOCK / PowerAnalyzer::PERIOD_FRAMES)
+
+// Фаза A по кругу проходит столько корзин подряд, начиная с этой
+#define SWEEP_BUCKETS 8
+#define SWEEP_FIRST (VOLTAGE_HISTOGRAM_BUCKETS / 2)
+
+// Середины корзин: RMS номинального окна при 60 Гц (167 кадров на 166.7) отличается от заданного
+// до 0.25 В, шум ±2 отсчёта добавляет сотые — до края корзины 0.5 В
+static float bucketCentre(int bucket) {
+    return VOLTAGE_HISTOGRAM_LOW_V + (bucket + 0.5f) * VOLTAGE_HISTOGRAM_BUCKET_V;
+}
+
+static const int STEADY_BUCKET_B = SWEEP_FIRST + SWEEP_BUCKETS + 3;
+static const int STEADY_BUCKET_C = SWEEP_FIRST + SWEEP_BUCKETS + 7;
+
+/**
+ * Напряжения фаз в секунду second интервала
+ */
+static void voltagesAt(uint32_t second, float* voltages) {
+    voltages[0] = bucketCentre(SWEEP_FIRST + second % SWEEP_BUCKETS);
+    voltages[1] = bucketCentre(STEADY_BUCKET_B);
+    if (second % 50 == 0) {
+        voltages[2] = VOLTAGE_HISTOGRAM_LOW_V - 30.0f;
+    } else if (second % 50 == 25) {
+        voltages[2] = VOLTAGE_HISTOGRAM_LOW_V + VOLTAGE_HISTOGRAM_BUCKETS * VOLTAGE_HISTOGRAM_BUCKET_V + 30.0f;
+    } else {
+        voltages[2] = bucketCentre(STEADY_BUCKET_C);
+    }
+}
+
+/**
+ * Ожидаемые счётчики интервала
+ */
+static void expectedCounts(int phases, uint32_t (*counts)[VOLTAGE_HISTOGRAM_BUCKETS]) {
+    memset(counts, 0, sizeof(uint32_t) * VOLTAGE_HISTOGRAM_MAX_PHASES * VOLTAGE_HISTOGRAM_BUCKETS);
+    for (uint32_t s = 0; s < VOLTAGE_HISTOGRAM_PERIOD_S; s++) {
+        float voltages[3];
+        voltagesAt(s, voltages);
+        for (int ph = 0; ph < phases; ph++) {
+            counts[ph][VoltageHistogram::bucketOf(voltages[ph])] += CYCLES_PER_BLOCK;
+        }
+    }
+}
+
+/**
+ * Поле-строка key="..." из точки
+ */
+static bool extractString(const char* line, const char* key, char* out, size_t size) {
+    char pattern[8];
+    snprintf(pattern, sizeof(pattern), "%s=\"", key);
+    const char* start = strstr(line, pattern);
+    if (start == nullptr) {
+        return false;
+    }
+    start += strlen(pattern);
+    const char* end = strchr(start, '"');
+    if (end == nullptr || (size_t)(end - start) >= size) {
+        return false;
+    }
+    memcpy(out, start, end - start);
+    out[end - start] = '\0';
+    return true;
+}
+
+static bool check(const char* name, bool ok, const char* detail) {
+    printf("%-40s %-8s %s\n", name, ok ? "ok" : "FAIL", detail);
+    return ok;
+}
+
+int runHistogramSim() {
+    static const char* const phaseKeys[3] = {"a", "b", "c"};
+    const int phases = PowerAnalyzer::VOLTAGE_CHANNELS < VOLTAGE_HISTOGRAM_MAX_PHASES ? PowerAnalyzer::VOLTAGE_CHANNELS
+                                                                                      : VOLTAGE_HISTOGRAM_MAX_PHASES;
+    SyntheticGrid grid(NOMINAL_VOLTAGE, NOMINAL_FREQUENCY, 2);
+    NativeHal::setAdcSource(&grid);
+    PowerAnalyzer analyzer(ANALYZER_CHANNEL_PINS, ANALYZER_CHANNEL_CALIBRATION);
+    analyzer.begin();
+    float offsets[VOLTAGE_HISTOGRAM_MAX_PHASES];
+    float sensitivities[VOLTAGE_HISTOGRAM_MAX_PHASES];
+    for (int ph = 0; ph < phases; ph++) {
+        offsets[ph] = analyzer.getOffset(ph);
+        sensitivities[ph] = analyzer.getSensitivity(ph);
+    }
+
+    printf("Voltage histogram check: %d s periods, %d buckets of %.2f V from %.1f V, %d cycles per block, "
+           "%d phases\n\n",
+           VOLTAGE_HISTOGRAM_PERIOD_S, VOLTAGE_HISTOGRAM_BUCKETS, VOLTAGE_HISTOGRAM_BUCKET_V, VOLTAGE_HISTOGRAM_LOW_V,
+           CYCLES_PER_BLOCK, phases);
+
+    static VoltageHistogram histogram;
+    static uint32_t expected[VOLTAGE_HISTOGRAM_MAX_PHASES][VOLTAGE_HISTOGRAM_BUCKETS];
+    static uint32_t decoded[VOLTAGE_HISTOGRAM_BUCKETS];
+    static char lines[VOLTAGE_HISTOGRAM_LINE_PROTOCOL_SIZE];
+    expectedCounts(phases, expected);
+
+    // Первый интервал начинается с середины: до первого закрытия — неполный
+    const uint32_t firstS = 1700000000u - 1700000000u % VOLTAGE_HISTOGRAM_PERIOD_S + VOLTAGE_HISTOGRAM_PERIOD_S;
+    const uint32_t startS = firstS - VOLTAGE_HISTOGRAM_PERIOD_S / 2;
+    const uint32_t endS = firstS + INTERVALS * VOLTAGE_HISTOGRAM_PERIOD_S;
+    int closes = 0;
+    int exact = 0;
+    int roundTrips = 0;
+    bool timesOk = true;
+    size_t maxPointBytes = 0;
+    double addNs = 0.0;
+    uint32_t blocks = 0;
+    char detail[160];
+    for (uint32_t t = startS; t <= endS; t++) {
+        float voltages[3];
+        voltagesAt(t % VOLTAGE_HISTOGRAM_PERIOD_S, voltages);
+        for (int ph = 0; ph < 3; ph++) {
+            grid.setPhaseVoltage(ph, voltages[ph]);
+        }
+        analyzer.measure();
+
+        auto started = std::chrono::steady_clock::now();
+        bool closed = histogram.addBlock(analyzer.getLastBlock(), analyzer.getLastBlockFrames(), PowerAnalyzer::CHANNELS,
+                                         phases, PowerAnalyzer::PERIOD_FRAMES, offsets, sensitivities, t);
+        addNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+        blocks++;
+        if (!closed || !histogram.takeClosed()) {
+            continue;
+        }
+
+        closes++;
+        if (t != firstS + (closes - 1) * VOLTAGE_HISTOGRAM_PERIOD_S ||
+            histogram.getLastStartS() != t - VOLTAGE_HISTOGRAM_PERIOD_S) {
+            timesOk = false;
+        }
+        // Первый интервал неполный: с ним сравниваются только остальные
+        if (closes == 1) {
+            continue;
+        }
+        bool same = histogram.getLastCycles() == VOLTAGE_HISTOGRAM_PERIOD_S * CYCLES_PER_BLOCK;
+        for (int ph = 0; ph < phases; ph++) {
+            same = same && memcmp(histogram.getLastCounts(ph), expected[ph], sizeof(expected[ph])) == 0;
+        }
+        exact += same ? 1 : 0;
+
+        size_t length = histogram.writeLineProtocol(lines, sizeof(lines), "esp32_grid_01");
+        maxPointBytes = length > maxPointBytes ? length : maxPointBytes;
+        bool trip = length > 0;
+        for (int ph = 0; ph < phases && trip; ph++) {
+            char rle[VOLTAGE_HISTOGRAM_RLE_SIZE];
+            trip = extractString(lines, phaseKeys[ph], rle, sizeof(rle)) &&
+                   VoltageHistogram::decodeRle(rle, decoded, VOLTAGE_HISTOGRAM_BUCKETS) &&
+                   memcmp(decoded, expected[ph], sizeof(decoded)) == 0;
+        }
+        roundTrips += trip ? 1 : 0;
+        if (closes == 2) {
+            printf("%s\n", lines);
+        }
+    }
+
+    // Покадрово, как из задачи оцифровки: блоки встык, все периоды
+    static VoltageHistogram streamed;
+    streamed.begin(phases, PowerAnalyzer::PERIOD_FRAMES, offsets, sensitivities);
+    const int blocksPerSecond = PowerAnalyzer::SAMPLE_RATE_HZ / PowerAnalyzer::FRAMES_PER_BLOCK;
+    const uint32_t allCycles = VOLTAGE_HISTOGRAM_PERIOD_S * PowerAnalyzer::SAMPLE_RATE_HZ / PowerAnalyzer::PERIOD_FRAMES;
+    int streamCloses = 0;
+    int streamMatches = 0;
+    uint32_t streamCycles = 0;
+    double worstDistance = 0.0;
+    double pushNs = 0.0;
+    uint32_t frames = 0;
+    for (uint32_t t = startS; t <= endS; t++) {
+        float voltages[3];
+        voltagesAt(t % VOLTAGE_HISTOGRAM_PERIOD_S, voltages);
+        for (int ph = 0; ph < 3; ph++) {
+            grid.setPhaseVoltage(ph, voltages[ph]);
+        }
+        for (int b = 0; b < blocksPerSecond; b++) {
+            analyzer.measure();
+            const int16_t* block = analyzer.getLastBlock();
+            auto started = std::chrono::steady_clock::now();
+            streamed.beginBlock(t, true);
+            for (int i = 0; i < analyzer.getLastBlockFrames(); i++) {
+                streamed.push(block + i * PowerAnalyzer::CHANNELS);
+            }
+            pushNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+            frames += analyzer.getLastBlockFrames();
+        }
+        if (!streamed.takeClosed()) {
+            continue;
+        }
+        // Первый интервал неполный
+        if (++streamCloses == 1) {
+            continue;
+        }
+        // Период на стыке секунд делится между двумя напряжениями: доли сравниваются
+        // расстоянием полной вариации, а не счётчиками
+        streamCycles = streamed.getLastCycles();
+        double distance = 0.0;
+        for (int ph = 0; ph < phases; ph++) {
+            double sum = 0.0;
+            for (int b = 0; b < VOLTAGE_HISTOGRAM_BUCKETS; b++) {
+                sum += fabs((double)streamed.getLastCounts(ph)[b] / streamCycles -
+                            (double)expected[ph][b] / (VOLTAGE_HISTOGRAM_PERIOD_S * CYCLES_PER_BLOCK));
+            }
+            distance = sum / 2 > distance ? sum / 2 : distance;
+        }
+        worstDistance = distance > worstDistance ? distance : worstDistance;
+        bool cyclesOk = streamCycles + 1 >= allCycles && streamCycles <= allCycles + 1;
+        streamMatches += cyclesOk && distance < 0.03 ? 1 : 0;
+    }
+    NativeHal::setAdcSource(nullptr);
+
+    // Без гистограммы: точка на каждый период каждой фазы
+    char rawLine[128];
+    LineWriter raw(rawLine, sizeof(rawLine));
+    raw.begin("voltage");
+    raw.tag("device", "esp32_grid_01");
+    raw.tag("phase", "A");
+    raw.field("value", 231.53f, 2);
+    raw.end(1704067200020ull);
+    const double rawBytes = (double)raw.length() * phases * allCycles;
+
+    bool pass = true;
+    snprintf(detail, sizeof(detail), "%d closed at period boundaries", closes);
+    pass = check("intervals close on the clock", closes == INTERVALS + 1 && timesOk, detail) && pass;
+    snprintf(detail, sizeof(detail), "%d of %d full intervals", exact, INTERVALS);
+    pass = check("bucket counts exact", exact == INTERVALS, detail) && pass;
+    snprintf(detail, sizeof(detail), "%d of %d points", roundTrips, INTERVALS);
+    pass = check("RLE decodes to the counts", roundTrips == INTERVALS, detail) && pass;
+    snprintf(detail, sizeof(detail), "%d of %d intervals: %lu cycles (%lu from blocks), distance %.4f",
+             streamMatches, INTERVALS, (unsigned long)streamCycles,
+             (unsigned long)(VOLTAGE_HISTOGRAM_PERIOD_S * CYCLES_PER_BLOCK), worstDistance);
+    pass = check("per frame: every cycle, same shares", streamCloses == INTERVALS + 1 && streamMatches == INTERVALS,
+                 detail) && pass;
+
+    // Граничные случаи RLE
+    uint32_t counts[VOLTAGE_HISTOGRAM_BUCKETS] = {};
+    char rle[VOLTAGE_HISTOGRAM_RLE_SIZE];
+    bool edges = VoltageHistogram::encodeRle(counts, VOLTAGE_HISTOGRAM_BUCKETS, rle, sizeof(rle)) == 1 &&
+                 strcmp(rle, "0") == 0 && VoltageHistogram::decodeRle(rle, decoded, VOLTAGE_HISTOGRAM_BUCKETS);
+    for (int i = 0; i < VOLTAGE_HISTOGRAM_BUCKETS; i++) {
+        counts[i] = 4000000000u - i;
+    }
+    edges = edges && VoltageHistogram::encodeRle(counts, VOLTAGE_HISTOGRAM_BUCKETS, rle, sizeof(rle)) > 0 &&
+            VoltageHistogram::decodeRle(rle, decoded, VOLTAGE_HISTOGRAM_BUCKETS) &&
+            memcmp(decoded, counts, sizeof(counts)) == 0;
+    edges = edges && VoltageHistogram::encodeRle(counts, VOLTAGE_HISTOGRAM_BUCKETS, rle, 16) == 0;
+    edges = edges && !VoltageHistogram::decodeRle("1,2*1", decoded, VOLTAGE_HISTOGRAM_BUCKETS) &&
+            !VoltageHistogram::decodeRle("1,,2", decoded, VOLTAGE_HISTOGRAM_BUCKETS) &&
+            !VoltageHistogram::decodeRle("0*1000", decoded, VOLTAGE_HISTOGRAM_BUCKETS);
+    pass = check("RLE: empty, all distinct, overflow, bad", edges, "") && pass;
+
+    snprintf(detail, sizeof(detail), "%u B vs %.0f B as per-cycle points (%.3f %%)", (unsigned)maxPointBytes, rawBytes,
+             100.0 * maxPointBytes / rawBytes);
+    pass = check("point size", maxPointBytes > 0 && maxPointBytes < rawBytes / 100.0, detail) && pass;
+    printf("\naddBlock(): %.1f us per %d-frame block, push(): %.1f ns per frame\n", addNs / blocks / 1000.0,
+           PowerAnalyzer::FRAMES_PER_BLOCK, pushNs / frames);
+
+    printf("\n%s\n", pass ? "Voltage histogram check passed" : "Voltage histogram check FAILED");
+    return pass ? 0 : 1;
+}
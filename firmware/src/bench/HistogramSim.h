@@ -0,0 +1,20 @@
+#ifndef HISTOGRAM_SIM_H
+#define HISTOGRAM_SIM_H
+
+/**
+ * Проверка распределения напряжения по периодам (VoltageHistogram)
+ *
+ * Три интервала по VOLTAGE_HISTOGRAM_PERIOD_S измерений раз в секунду через
+ * measure() и SyntheticGrid (шум ±2 отсчёта): фаза A проходит по кругу
+ * середины заданных корзин, B постоянна, C иногда уходит за нижний и верхний
+ * край диапазона.
+ * Проверяются закрытие интервалов по часам, точные счётчики корзин, обратное
+ * декодирование RLE из точки voltage_histogram, размер точки против точек
+ * на каждый период. Затем те же секунды покадрово через push(), как из
+ * задачи оцифровки (блоки встык): в интервале все периоды, распределение —
+ * то же. В конце — цена addBlock() на блок и push() на кадр.
+ * @return Код выхода процесса (1 — проверка не прошла)
+ */
+int runHistogramSim();
+
+#endif // HISTOGRAM_SIM_H
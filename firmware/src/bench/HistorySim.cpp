@@ -0,0 +1,424 @@
+#include "HistorySim.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "../config.h"
+#include "../HistoryStore.h"
+
+// Секунды работы: первое и последнее измерение, синхронизация часов
+#define FIRST_S 5u
+#define LAST_S (FIRST_S + 25u * 3600u - 1u)
+#define SYNC_S 3600u
+#define UNIX_OFFSET 1704067200u
+
+// Пропуски измерений: в последних 10 минутах и внутри суток (не по границе минуты)
+#define GAP_RECENT_S (LAST_S - 300u)
+#define GAP_RECENT_LENGTH 45u
+#define GAP_DAY_S (LAST_S - 6u * 3600u + 17u)
+#define GAP_DAY_LENGTH 300u
+
+#define PHASES 3
+
+// Ответ на HISTORY_MAX_POINTS строк
+#define RESPONSE_SIZE (HISTORY_HEADER_SIZE + HISTORY_MAX_POINTS * HISTORY_ROW_CHARS + 16)
+
+static bool measuredAt(uint32_t t) {
+    return t >= FIRST_S && t <= LAST_S && !(t >= GAP_RECENT_S && t < GAP_RECENT_S + GAP_RECENT_LENGTH) &&
+           !(t >= GAP_DAY_S && t < GAP_DAY_S + GAP_DAY_LENGTH);
+}
+
+static void dataAt(uint32_t t, PowerData& data) {
+    memset(&data, 0, sizeof(data));
+    data.voltageA = 220.0f + (t % 200) * 0.05f;
+    data.voltageB = 230.0f + (t % 13) * 0.5f;
+    data.voltageC = 225.0f + (t % 7) * 1.0f;
+    data.frequencyAvg = NOMINAL_FREQUENCY + ((int)(t % 11) - 5) * 0.002f;
+    data.unbalance = 0.5f + (t % 3) * 0.1f;
+    data.activePower = -500.0f + (t % 61) * 17.0f;
+}
+
+/**
+ * Эталонная строка: средние, min/max по измерениям [fromS, fromS + stepS)
+ * @return false если измерений нет
+ */
+struct Expected {
+    double voltages[3];
+    double low;
+    double high;
+    double frequency;
+    double unbalance;
+    double power;
+};
+
+static bool expectedAt(uint32_t fromS, uint32_t stepS, Expected& out) {
+    memset(&out, 0, sizeof(out));
+    out.low = 1e9;
+    out.high = -1e9;
+    uint32_t count = 0;
+    for (uint32_t t = fromS; t < fromS + stepS; t++) {
+        if (!measuredAt(t)) {
+            continue;
+        }
+        PowerData data;
+        dataAt(t, data);
+        const float voltages[3] = {data.voltageA, data.voltageB, data.voltageC};
+        for (int ph = 0; ph < 3; ph++) {
+            out.voltages[ph] += voltages[ph];
+            out.low = voltages[ph] < out.low ? voltages[ph] : out.low;
+            out.high = voltages[ph] > out.high ? voltages[ph] : out.high;
+        }
+        out.frequency += data.frequencyAvg;
+        out.unbalance += data.unbalance;
+        out.power += data.activePower;
+        count++;
+    }
+    if (count == 0) {
+        return false;
+    }
+    for (int ph = 0; ph < 3; ph++) {
+        out.voltages[ph] /= count;
+    }
+    out.frequency /= count;
+    out.unbalance /= count;
+    out.power /= count;
+    return true;
+}
+
+struct Row {
+    unsigned long t;
+    bool empty;
+    double values[8];
+};
+
+static bool parseRow(const char* line, Row& row) {
+    memset(&row, 0, sizeof(row));
+    char rest[16];
+    if (sscanf(line, "[%lu,%4s", &row.t, rest) == 2 && strncmp(rest, "null", 4) == 0) {
+        row.empty = true;
+        return true;
+    }
+    return sscanf(line, "[%lu,%lf,%lf,%lf,%lf,%lf,%lf,%lf,%lf]", &row.t, &row.values[0], &row.values[1],
+                  &row.values[2], &row.values[3], &row.values[4], &row.values[5], &row.values[6],
+                  &row.values[7]) == 9;
+}
+
+/**
+ * Строка ответа совпадает с эталоном (округление до сотых В, мГц, Вт; для
+ * средних по точкам — на единицу последнего знака)
+ */
+static bool rowMatches(const Row& row, const Expected& expected, double slack) {
+    const double tolerances[8] = {0.005, 0.005, 0.005, 0.005, 0.005, 0.0005, 0.005, 0.5};
+    const double values[8] = {expected.voltages[0], expected.voltages[1], expected.voltages[2], expected.low,
+                              expected.high, expected.frequency, expected.unbalance, expected.power};
+    for (int i = 0; i < 8; i++) {
+        if (fabs(row.values[i] - values[i]) > tolerances[i] * (1.0 + slack) + 1e-9) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// =============================================================================
+// Проверка синтаксиса JSON (без построения документа)
+// =============================================================================
+static const char* skipSpace(const char* p) {
+    while (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') {
+        p++;
+    }
+    return p;
+}
+
+static const char* parseValue(const char* p);
+
+static const char* parseString(const char* p) {
+    if (*p != '"') {
+        return nullptr;
+    }
+    for (p++; *p != '"'; p++) {
+        if (*p == '\0' || (unsigned char)*p < 0x20) {
+            return nullptr;
+        }
+        if (*p == '\\' && *++p == '\0') {
+            return nullptr;
+        }
+    }
+    return p + 1;
+}
+
+static const char* parseContainer(const char* p, char close, bool object) {
+    p = skipSpace(p + 1);
+    if (*p == close) {
+        return p + 1;
+    }
+    while (true) {
+        if (object) {
+            p = parseString(skipSpace(p));
+            if (p == nullptr || *(p = skipSpace(p)) != ':') {
+                return nullptr;
+            }
+            p++;
+        }
+        p = parseValue(p);
+        if (p == nullptr) {
+            return nullptr;
+        }
+        p = skipSpace(p);
+        if (*p == close) {
+            return p + 1;
+        }
+        if (*p != ',') {
+            return nullptr;
+        }
+        p++;
+    }
+}
+
+static const char* parseValue(const char* p) {
+    p = skipSpace(p);
+    if (*p == '{') {
+        return parseContainer(p, '}', true);
+    }
+    if (*p == '[') {
+        return parseContainer(p, ']', false);
+    }
+    if (*p == '"') {
+        return parseString(p);
+    }
+    if (strncmp(p, "null", 4) == 0 || strncmp(p, "true", 4) == 0) {
+        return p + 4;
+    }
+    if (strncmp(p, "false", 5) == 0) {
+        return p + 5;
+    }
+    char* end;
+    strtod(p, &end);
+    return end == p ? nullptr : end;
+}
+
+static bool validJson(const char* text) {
+    const char* end = parseValue(text);
+    return end != nullptr && *skipSpace(end) == '\0';
+}
+
+// =============================================================================
+
+static char response[RESPONSE_SIZE];
+static char chunked[RESPONSE_SIZE];
+
+/**
+ * Прочитать ответ кусками по chunk байт, как веб-сервер
+ * @return Длина ответа
+ */
+static size_t readAll(const HistoryStore& store, const HistoryQuery& query, size_t chunk, char* out, size_t size) {
+    size_t total = 0;
+    size_t length;
+    while (total < size - 1 &&
+           (length = store.readJson(query, total, (uint8_t*)out + total,
+                                    chunk < size - 1 - total ? chunk : size - 1 - total)) > 0) {
+        total += length;
+    }
+    out[total] = '\0';
+    return total;
+}
+
+/**
+ * Сверить ответ с эталоном по строкам
+ * @param lastS Последнее добавленное измерение (время работы)
+ * @param slack Допуск сверх округления (средние по средним минут)
+ * @param empty Сколько строк оказалось null
+ * @return Строк, совпавших с эталоном (null там, где измерений нет, тоже совпадение)
+ */
+static uint32_t compareRows(const char* text, const HistoryQuery& query, uint32_t lastS, uint32_t offset,
+                            double slack, uint32_t& empty, bool& layoutOk) {
+    const char* rows = strstr(text, "\"points\":[\n");
+    layoutOk = rows != nullptr;
+    empty = 0;
+    if (!layoutOk) {
+        return 0;
+    }
+    rows += strlen("\"points\":[\n");
+    uint32_t matched = 0;
+    for (uint32_t r = 0; r < query.rows; r++) {
+        const char* line = rows + (size_t)r * HISTORY_ROW_CHARS;
+        layoutOk = layoutOk && line[HISTORY_ROW_CHARS - 1] == '\n' &&
+                   line[HISTORY_ROW_CHARS - 2] == (r + 1 < query.rows ? ',' : ' ');
+        Row row;
+        if (!parseRow(line, row)) {
+            layoutOk = false;
+            continue;
+        }
+        uint32_t fromS = query.fromS + r * query.stepS;
+        Expected expected;
+        bool measured;
+        if (query.tier == 0) {
+            // Первая строка, выровненная по шагу, может начинаться раньше кольца
+            uint32_t oldest = lastS + 1 - HISTORY_SECONDS;
+            uint32_t start = fromS > oldest ? fromS : oldest;
+            measured = start < fromS + query.stepS && expectedAt(start, fromS + query.stepS - start, expected);
+        } else {
+            // Минутный уровень: текущая (незакрытая) минута ещё не в кольце
+            uint32_t closedEnd = lastS - lastS % 60;
+            uint32_t span = fromS + query.stepS <= closedEnd ? query.stepS : (fromS < closedEnd ? closedEnd - fromS : 0);
+            measured = span > 0 && expectedAt(fromS, span, expected);
+        }
+        empty += row.empty ? 1 : 0;
+        if (row.t != (unsigned long)(fromS + offset)) {
+            continue;
+        }
+        if (row.empty ? !measured : (measured && rowMatches(row, expected, slack))) {
+            matched++;
+        }
+    }
+    return matched;
+}
+
+static bool check(const char* name, bool ok, const char* detail) {
+    printf("%-44s %-8s %s\n", name, ok ? "ok" : "FAIL", detail);
+    return ok;
+}
+
+int runHistorySim() {
+    printf("History store check: %d s of 1 s points, %d min of 1 min points, up to %d rows of %d B\n\n",
+           HISTORY_SECONDS, HISTORY_MINUTES, HISTORY_MAX_POINTS, HISTORY_ROW_CHARS);
+
+    static HistoryStore store;
+    bool pass = true;
+    char detail[160];
+    bool allocated = store.begin();
+    const size_t expectedMemory = (size_t)(HISTORY_SECONDS + HISTORY_MINUTES) * (sizeof(HistoryPoint) + 4);
+    snprintf(detail, sizeof(detail), "%lu B allocated once", (unsigned long)store.getMemorySize());
+    pass = check("rings allocated in begin()", allocated && store.getMemorySize() == expectedMemory, detail) && pass;
+
+    double addNs = 0.0;
+    uint32_t adds = 0;
+    bool uptimeOk = false;
+    for (uint32_t t = FIRST_S; t <= LAST_S; t++) {
+        if (!measuredAt(t)) {
+            continue;
+        }
+        PowerData data;
+        dataAt(t, data);
+        auto started = std::chrono::steady_clock::now();
+        store.add(data, PHASES, t, t >= SYNC_S ? UNIX_OFFSET + t : 0);
+        addNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+        adds++;
+
+        // До синхронизации часов метки — время работы
+        if (t == SYNC_S - 1) {
+            HistoryQuery query = store.makeQuery(t - 59, t + 1, 1);
+            size_t length = readAll(store, query, 1460, response, sizeof(response));
+            uint32_t empty;
+            bool layout;
+            uint32_t matched = compareRows(response, query, t, 0, 0.0, empty, layout);
+            uptimeOk = length > 0 && strstr(response, "\"clock\":\"uptime\"") != nullptr && !store.hasUnixTime() &&
+                       query.rows == 60 && matched == 60 && layout && validJson(response);
+        }
+    }
+    pass = check("clock is uptime before NTP", uptimeOk, "") && pass;
+
+    const uint32_t now = store.now();
+    snprintf(detail, sizeof(detail), "now %lu = uptime %lu + %lu", (unsigned long)now, (unsigned long)LAST_S,
+             (unsigned long)UNIX_OFFSET);
+    pass = check("clock is unix after NTP", store.hasUnixTime() && now == LAST_S + UNIX_OFFSET, detail) && pass;
+
+    // Последние 10 минут по секунде (запрос по умолчанию)
+    HistoryQuery seconds = store.makeQuery(now - HISTORY_SECONDS + 1, now + 1, 1);
+    size_t secondsLength = readAll(store, seconds, 1460, response, sizeof(response));
+    uint32_t empty;
+    bool layout;
+    uint32_t matched = compareRows(response, seconds, LAST_S, UNIX_OFFSET, 0.0, empty, layout);
+    printf("%.*s%.*s...\n\n", (int)seconds.headerLength, response, HISTORY_ROW_CHARS * 2,
+           response + seconds.headerLength);
+    snprintf(detail, sizeof(detail), "%lu of %lu rows, %lu null (gap %u s), %lu B", (unsigned long)matched,
+             (unsigned long)seconds.rows, (unsigned long)empty, GAP_RECENT_LENGTH, (unsigned long)secondsLength);
+    pass = check("1 s tier: last 10 min", seconds.tier == 0 && seconds.stepS == 1 && seconds.rows == HISTORY_SECONDS &&
+                                              matched == seconds.rows && empty == GAP_RECENT_LENGTH && layout,
+                 detail) && pass;
+    bool valid = validJson(response) && secondsLength == store.jsonLength(seconds);
+
+    // Шаг 10 с: среднее, min/max по секундам
+    HistoryQuery tens = store.makeQuery(now - HISTORY_SECONDS + 1, now + 1, 10);
+    readAll(store, tens, 1460, response, sizeof(response));
+    matched = compareRows(response, tens, LAST_S, UNIX_OFFSET, 1.0, empty, layout);
+    snprintf(detail, sizeof(detail), "%lu of %lu rows", (unsigned long)matched, (unsigned long)tens.rows);
+    pass = check("1 s tier downsampled to 10 s", tens.tier == 0 && tens.stepS == 10 && matched == tens.rows && layout,
+                 detail) && pass;
+    valid = valid && validJson(response);
+
+    // Сутки по минуте
+    HistoryQuery day = store.makeQuery(now - 86400 + 1, now + 1, 60);
+    size_t dayLength = readAll(store, day, 1460, response, sizeof(response));
+    matched = compareRows(response, day, LAST_S, UNIX_OFFSET, 1.0, empty, layout);
+    snprintf(detail, sizeof(detail), "%lu of %lu rows, %lu null, %lu B", (unsigned long)matched,
+             (unsigned long)day.rows, (unsigned long)empty, (unsigned long)dayLength);
+    pass = check("1 min tier: last 24 h", day.tier == 1 && day.stepS == 60 && day.rows >= HISTORY_MINUTES &&
+                                              matched == day.rows && empty >= GAP_DAY_LENGTH / 60 && layout,
+                 detail) && pass;
+    valid = valid && validJson(response) && dayLength == store.jsonLength(day);
+
+    // Сутки с шагом 1 с: шаг растёт до HISTORY_MAX_POINTS строк, уровень — минутный
+    HistoryQuery coarse = store.makeQuery(now - 86400 + 1, now + 1, 1);
+    HistoryQuery twoHours = store.makeQuery(now - 7200, now + 1, 30);
+    HistoryQuery hourly = store.makeQuery(now - 86400 + 1, now + 1, 3600);
+    readAll(store, hourly, 1460, response, sizeof(response));
+    matched = compareRows(response, hourly, LAST_S, UNIX_OFFSET, 1.0, empty, layout);
+    snprintf(detail, sizeof(detail), "24 h at 1 s -> %lu s x %lu rows, 2 h at 30 s -> %lu s, hourly %lu of %lu",
+             (unsigned long)coarse.stepS, (unsigned long)coarse.rows, (unsigned long)twoHours.stepS,
+             (unsigned long)matched, (unsigned long)hourly.rows);
+    pass = check("tier and step selection", coarse.tier == 1 && coarse.rows <= HISTORY_MAX_POINTS &&
+                                                twoHours.tier == 1 && twoHours.stepS == 60 &&
+                                                matched == hourly.rows && layout,
+                 detail) && pass;
+    valid = valid && validJson(response);
+
+    // Старше суток: кольцо перезаписано — строки null
+    HistoryQuery stale = store.makeQuery(UNIX_OFFSET + 600, UNIX_OFFSET + 1200, 60);
+    readAll(store, stale, 1460, response, sizeof(response));
+    compareRows(response, stale, LAST_S, UNIX_OFFSET, 0.0, empty, layout);
+    snprintf(detail, sizeof(detail), "%lu of %lu rows null", (unsigned long)empty, (unsigned long)stale.rows);
+    pass = check("overwritten minutes read as null", stale.rows == 10 && empty == stale.rows && layout, detail) && pass;
+    valid = valid && validJson(response);
+
+    // Пустой диапазон — тоже документ
+    HistoryQuery none = store.makeQuery(now + 100, now + 200, 1);
+    readAll(store, none, 1460, response, sizeof(response));
+    valid = valid && none.rows == 0 && validJson(response);
+    pass = check("responses are valid JSON of jsonLength()", valid, "") && pass;
+
+    // Куски любой длины дают тот же ответ
+    static const size_t chunks[] = {1, 7, HISTORY_ROW_CHARS, 1460, 5000};
+    bool same = true;
+    const HistoryQuery* queries[] = {&seconds, &day};
+    for (const HistoryQuery* query : queries) {
+        size_t whole = readAll(store, *query, sizeof(response), response, sizeof(response));
+        for (size_t chunk : chunks) {
+            same = same && readAll(store, *query, chunk, chunked, sizeof(chunked)) == whole &&
+                   memcmp(response, chunked, whole) == 0;
+        }
+    }
+    pass = check("chunked reads resume at any offset", same, "1, 7, row, 1460, 5000 B") && pass;
+
+    // Время генерации: кусками по 1460 байт (сегмент TCP), как отдаёт веб-сервер
+    const HistoryQuery* timed[] = {&seconds, &day};
+    const char* names[] = {"10 min x 1 s", "24 h x 1 min"};
+    printf("\nadd(): %.0f ns per measurement\n", addNs / adds);
+    for (int i = 0; i < 2; i++) {
+        const int repeats = 20;
+        auto started = std::chrono::steady_clock::now();
+        size_t length = 0;
+        for (int r = 0; r < repeats; r++) {
+            length = readAll(store, *timed[i], 1460, response, sizeof(response));
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count() /
+                    repeats;
+        printf("%-14s %5lu rows, %6lu B: %7.1f us per response (%.0f ns per row)\n", names[i],
+               (unsigned long)timed[i]->rows, (unsigned long)length, us, us * 1000.0 / timed[i]->rows);
+    }
+    printf("Memory: %lu B of rings (fixed), %lu B of stack per chunk, no heap per query\n",
+           (unsigned long)store.getMemorySize(), (unsigned long)HISTORY_HEADER_SIZE);
+
+    printf("\n%s\n", pass ? "History store check passed" : "History store check FAILED");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+#ifndef HISTORY_SIM_H
+#define HISTORY_SIM_H
+
+/**
+ * Проверка истории в памяти (HistoryStore) и ответа /history
+ *
+ * Сутки с лишним измерений раз в секунду с известными значениями: первый час
+ * без NTP, затем с синхронизированными часами, с пропусками в последних
+ * 10 минутах и внутри суток. Ответы readJson() разбираются по строкам и
+ * сравниваются с эталоном: секундный уровень, средние по шагу, минутный
+ * уровень (средние, min/max), выбор уровня и шага, пропуски как null.
+ * Ответ, прочитанный кусками разной длины, совпадает с прочитанным целиком.
+ * В конце — память колец, цена add() и время генерации ответа.
+ * @return Код выхода процесса (1 — проверка не прошла)
+ */
+int runHistorySim();
+
+#endif // HISTORY_SIM_H
@@ -0,0 +1,195 @@
+#include "PersistSim.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include "../config.h"
+#include "../hal/HalNative.h"
+#include "../PowerAnalyzer.h"
+#include "../PersistentStats.h"
+
+// Раздел nvs в default.csv — 0x5000 (5 страниц по 4 КБ, одна всегда свободна
+// для сборки мусора). Запись в 32 байта, 126 записей на странице. Значение-blob
+// занимает заголовок, данные и индекс blob. Ресурс флеша — 100 000 стираний.
+#define NVS_PAGES_IN_ROTATION 4
+#define NVS_ENTRIES_PER_PAGE 126
+#define NVS_ENTRY_SIZE 32
+#define FLASH_ERASE_CYCLES 100000.0
+
+/**
+ * Анализатор без АЦП: измерение задаётся напрямую, а пороги, события и
+ * интегрирование энергии — настоящие, из PowerAnalyzerBase
+ */
+class SimulatedMeter : public PowerAnalyzerBase {
+public:
+    SimulatedMeter()
+        : PowerAnalyzerBase(DEADBAND_ALL_FIELDS, 3) {
+    }
+
+    void step(float activePower, float voltage, uint32_t nowMs) {
+        PowerData data;
+        memset(&data, 0, sizeof(data));
+        data.voltageA = voltage;
+        data.voltageB = voltage;
+        data.voltageC = voltage;
+        data.voltageAvg = voltage;
+        data.frequencyA = NOMINAL_FREQUENCY;
+        data.frequencyB = NOMINAL_FREQUENCY;
+        data.frequencyC = NOMINAL_FREQUENCY;
+        data.frequencyAvg = NOMINAL_FREQUENCY;
+        data.activePower = activePower;
+        data.timestamp = nowMs;
+        publish(data, 3);
+    }
+};
+
+/**
+ * Детерминированный xorshift32: один и тот же прогон при каждом запуске
+ */
+static uint32_t randomState = 2463534242u;
+
+static uint32_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static bool chance(uint32_t oneIn) {
+    return nextRandom() % oneIn == 0;
+}
+
+static uint32_t eventTotal(const PowerEventCounters& events) {
+    return events.lowVoltage + events.highVoltage + events.highUnbalance + events.frequencyDeviation;
+}
+
+static bool sameRecord(const PersistentRecord& a, const PersistentRecord& b) {
+    return memcmp(&a, &b, sizeof(PersistentRecord)) == 0;
+}
+
+int runPersistSim(uint32_t days) {
+    NativeHal::storageReset();
+
+    std::unique_ptr<SimulatedMeter> meter(new SimulatedMeter());
+    std::unique_ptr<PersistentStats> stats(new PersistentStats());
+    stats->begin(0);
+    stats->restoreInto(*meter);
+
+    const uint32_t totalS = days * 86400;
+    uint32_t bootS = 0;
+    uint32_t burstLeftS = 0;
+    uint32_t dipLeftS = 0;
+
+    double maxEnergyLossKwh = 0.0;
+    uint32_t maxEventLoss = 0;
+    uint32_t maxUptimeLossS = 0;
+    double cutEnergyLossKwh = 0.0;
+    uint32_t cuts = 0;
+    uint32_t restoreMismatches = 0;
+
+    for (uint32_t t = 1; t <= totalS; t++) {
+        // Нагрузка: база, вечерний пик, случайные мощные приборы, днём — отдача от солнечных панелей
+        float hour = (t % 86400) / 3600.0f;
+        float power = 250.0f;
+        if (hour >= 18.0f && hour < 23.0f) {
+            power += 1500.0f;
+        }
+        if (burstLeftS == 0 && chance(1800)) {
+            burstLeftS = 600 + nextRandom() % 1800;
+        }
+        if (burstLeftS > 0) {
+            power += 2000.0f;
+            burstLeftS--;
+        }
+        if (hour >= 9.0f && hour < 16.0f) {
+            power -= 3000.0f * sinf((float)M_PI * (hour - 9.0f) / 7.0f);
+        }
+
+        // Провалы напряжения до 190 В на 5-30 с: событие lowVoltage
+        if (dipLeftS == 0 && chance(7200)) {
+            dipLeftS = 5 + nextRandom() % 26;
+        }
+        float voltage = 230.0f;
+        if (dipLeftS > 0) {
+            voltage = 190.0f;
+            dipLeftS--;
+        }
+
+        uint32_t nowMs = (t - bootS) * 1000;
+        meter->step(power, voltage, nowMs);
+        stats->update(*meter, nowMs);
+        stats->checkpoint(nowMs);
+
+        // Потеря, если питание пропадёт прямо сейчас: всё после последней контрольной точки
+        const PersistentRecord& now = stats->getRecord();
+        const PersistentRecord& saved = stats->getCheckpoint();
+        double energyLoss = (now.energyImportKwh - saved.energyImportKwh) +
+                            (now.energyExportKwh - saved.energyExportKwh);
+        if (energyLoss > maxEnergyLossKwh) {
+            maxEnergyLossKwh = energyLoss;
+        }
+        uint32_t eventLoss = eventTotal(now.events) - eventTotal(saved.events);
+        if (eventLoss > maxEventLoss) {
+            maxEventLoss = eventLoss;
+        }
+        if (now.uptimeS - saved.uptimeS > maxUptimeLossS) {
+            maxUptimeLossS = now.uptimeS - saved.uptimeS;
+        }
+
+        // Отключение питания раз в ~6 часов: новый запуск с тем, что есть во флеше
+        if (chance(6 * 3600)) {
+            PersistentRecord expected = stats->getCheckpoint();
+            cutEnergyLossKwh += energyLoss;
+            cuts++;
+
+            meter.reset(new SimulatedMeter());
+            stats.reset(new PersistentStats());
+            stats->begin(0);
+            PersistentRecord restored = stats->getCheckpoint();
+            if (!sameRecord(restored, expected)) {
+                restoreMismatches++;
+            }
+            stats->restoreInto(*meter);
+            bootS = t;
+        }
+    }
+
+    // Обрыв записи: питание пропадает посреди записи контрольной точки
+    PersistentRecord beforeTear = stats->getCheckpoint();
+    NativeHal::storageTearNextWrite();
+    uint32_t writesBeforeTear = stats->getWriteCount();
+    uint32_t t = totalS;
+    while (stats->getWriteCount() == writesBeforeTear && t < totalS + 86400) {
+        t++;
+        uint32_t nowMs = (t - bootS) * 1000;
+        meter->step(3000.0f, 230.0f, nowMs);
+        stats->update(*meter, nowMs);
+        stats->checkpoint(nowMs);
+    }
+    stats.reset(new PersistentStats());
+    stats->begin(0);
+    bool tearRecovered = sameRecord(stats->getCheckpoint(), beforeTear);
+
+    // Износ: каждая запись — заголовок, данные и индекс blob; страница стирается, когда заполнена
+    uint32_t writeCount = NativeHal::storageWriteCount();
+    double writesPerDay = (double)writeCount / days;
+    int entriesPerWrite = 2 + ((int)sizeof(PersistentRecord) + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+    double erasesPerPagePerDay = writesPerDay * entriesPerWrite / NVS_ENTRIES_PER_PAGE / NVS_PAGES_IN_ROTATION;
+    double years = FLASH_ERASE_CYCLES / erasesPerPagePerDay / 365.0;
+
+    printf("Persistence simulation: %u days, 1 s measurements, %u power cuts\n", days, cuts);
+    printf("Policy:          min %u s, every %u s, or %.3f kWh / new events; %d slots x %u bytes\n",
+           PERSIST_MIN_INTERVAL_MS / 1000, PERSIST_INTERVAL_MS / 1000, PERSIST_ENERGY_STEP_KWH,
+           PERSIST_SLOTS, (unsigned)sizeof(PersistentRecord));
+    printf("Flash writes:    %u (%.1f/day, %.0f bytes/day)\n",
+           writeCount, writesPerDay, (double)NativeHal::storageBytesWritten() / days);
+    printf("NVS wear:        %d entries/write, %.2f erases/page/day, ~%.0f years to %.0f cycles\n",
+           entriesPerWrite, erasesPerPagePerDay, years, FLASH_ERASE_CYCLES);
+    printf("Max loss on cut: %.3f kWh, %u events, %u s uptime\n",
+           maxEnergyLossKwh, maxEventLoss, maxUptimeLossS);
+    printf("Actual cuts:     %.3f kWh lost in total, restored last checkpoint %u/%u\n",
+           cutEnergyLossKwh, cuts - restoreMismatches, cuts);
+    printf("Torn write:      %s\n", tearRecovered ? "previous checkpoint restored" : "FAILED");
+
+    return restoreMismatches == 0 && tearRecovered ? 0 : 1;
+}
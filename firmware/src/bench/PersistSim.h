@@ -0,0 +1,20 @@
+#ifndef PERSIST_SIM_H
+#define PERSIST_SIM_H
+
+#include <stdint.h>
+
+/**
+ * Моделирование PersistentStats на хосте: сутки за сутками измерений раз в
+ * секунду с бытовой нагрузкой, солнечной отдачей в сеть, провалами напряжения
+ * и случайными отключениями питания. Хранилище — NativeHal (Hal::storage*).
+ *
+ * Печатает частоту записей во флеш, оценку износа страниц NVS и наибольшую
+ * потерю энергии, событий и наработки при отключении питания; проверяет, что
+ * после каждого отключения восстанавливается последняя контрольная точка, а
+ * после оборванной записи — предыдущая.
+ * @param days Моделируемых суток
+ * @return Код выхода процесса (1 — восстановление не совпало)
+ */
+int runPersistSim(uint32_t days);
+
+#endif // PERSIST_SIM_H
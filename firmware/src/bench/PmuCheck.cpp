@@ -0,0 +1,325 @@
+#include "PmuCheck.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "../config.h"
+#include "../hal/Hal.h"
+#include "../hal/HalNative.h"
+#include "../PowerAnalyzer.h"
+#include "../Synchrophasor.h"
+#include "SyntheticGrid.h"
+
+// Начало записи — не на границе секунды, чтобы выравнивание отчётов было видно
+#define START_SECOND 1700000000ull
+#define START_OFFSET_US 123457ull
+
+// Длительность случая и начальный участок без проверки (окно, история частоты)
+#define CASE_SECONDS 3
+#define SETTLE_US 1000000ull
+
+// Пределы C37.118.1 (установившийся режим)
+#define TVE_LIMIT_PCT 1.0
+#define FE_LIMIT_HZ 0.005
+#define RFE_LIMIT_HZ_S 0.4
+
+static const char* const CHANNEL_NAMES[3] = {"VA", "VB", "VC"};
+
+/**
+ * Детерминированный xorshift32: один и тот же прогон при каждом запуске
+ */
+static uint32_t randomState = 2463534242u;
+
+static uint32_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+struct PmuCase {
+    const char* name;
+    double frequencyOffset;     // Гц от номинала
+    double magnitude;           // Доля 230 В
+    double harmonic3;           // Доля основной
+    double harmonic5;
+    bool unbalance;             // B на 10 % ниже, C повёрнута на 5°
+};
+
+struct PmuResult {
+    uint32_t reports;
+    uint32_t failures;          // Кадры, не разобранные или не на сетке отчётов
+    double maxTve;              // %, худшая фаза
+    double maxPositiveTve;
+    double maxFe;               // Гц
+    double maxRfe;              // Гц/с
+};
+
+/**
+ * Угол фазора в момент отчёта по фазе сигнала в этот момент: относительно cos(2π·f0·t)
+ */
+static double phasorAngle(double signalPhase, uint64_t reportUs) {
+    double angle = signalPhase - 2.0 * M_PI * NOMINAL_FREQUENCY * (double)(reportUs % 1000000) * 1e-6;
+    return remainder(angle, 2.0 * M_PI);
+}
+
+static double tvePercent(double gotMagnitude, double gotAngle, double magnitude, double angle) {
+    double dr = gotMagnitude * cos(gotAngle) - magnitude * cos(angle);
+    double di = gotMagnitude * sin(gotAngle) - magnitude * sin(angle);
+    return 100.0 * sqrt(dr * dr + di * di) / magnitude;
+}
+
+/**
+ * Разобрать отчёт как приёмник и сравнить с идеальными фазорами
+ * @param magnitude, angle Идеальные фазоры фаз в момент отчёта
+ */
+static void checkReport(const SynchrophasorFrame& report, const SynchrophasorConfig& config, uint32_t rate,
+                        const double* magnitude, const double* angle, double frequency, PmuResult& result) {
+    uint8_t buffer[C37_DATA_FRAME_MAX];
+    size_t length = SynchrophasorCodec::encodeData(report, PMU_IDCODE,
+                                                   SynchrophasorCodec::timeQuality(true, PMU_NTP_ERROR_US),
+                                                   SynchrophasorCodec::status(true, PMU_NTP_ERROR_US, 0),
+                                                   NOMINAL_FREQUENCY, buffer, sizeof(buffer));
+    SynchrophasorFrame got;
+    uint8_t timeQuality;
+    uint16_t stat;
+    uint64_t reportUs = (uint64_t)report.soc * 1000000 + report.fracUs;
+    if (length == 0 || !SynchrophasorCodec::decodeData(buffer, length, config, got, timeQuality, stat) ||
+        (uint64_t)got.soc * 1000000 + got.fracUs != reportUs ||
+        got.fracUs != (uint64_t)((got.fracUs * rate + 500000) / 1000000) * 1000000 / rate) {
+        result.failures++;
+        return;
+    }
+    result.reports++;
+    if (reportUs < START_SECOND * 1000000 + START_OFFSET_US + SETTLE_US) {
+        return;
+    }
+
+    double positiveRe = 0.0;
+    double positiveIm = 0.0;
+    for (int p = 0; p < 3; p++) {
+        double tve = tvePercent(got.magnitude[p], got.angle[p], magnitude[p], angle[p]);
+        result.maxTve = tve > result.maxTve ? tve : result.maxTve;
+        // Прямая последовательность: поворот B на +120°, C на +240°
+        double rotated = angle[p] + p * 2.0 * M_PI / 3.0;
+        positiveRe += magnitude[p] * cos(rotated) / 3.0;
+        positiveIm += magnitude[p] * sin(rotated) / 3.0;
+    }
+    double positiveTve = tvePercent(got.positiveMagnitude, got.positiveAngle,
+                                    sqrt(positiveRe * positiveRe + positiveIm * positiveIm),
+                                    atan2(positiveIm, positiveRe));
+    double fe = fabs(got.frequency - frequency);
+    double rfe = fabs(got.rocof);
+    result.maxPositiveTve = positiveTve > result.maxPositiveTve ? positiveTve : result.maxPositiveTve;
+    result.maxFe = fe > result.maxFe ? fe : result.maxFe;
+    result.maxRfe = rfe > result.maxRfe ? rfe : result.maxRfe;
+}
+
+/**
+ * Прогнать случай через PhasorEstimator кадр за кадром
+ * @param pushNs Суммарное время push(), нс
+ */
+static PmuResult runCase(const PmuCase& c, uint32_t rate, const SynchrophasorConfig& config, double& pushNs,
+                         uint64_t& frames) {
+    const float calibration[3] = {CALIBRATION_COEFF_A, CALIBRATION_COEFF_B, CALIBRATION_COEFF_C};
+    const uint32_t sampleRate = PowerAnalyzer::SAMPLE_RATE_HZ;
+    const double frequency = NOMINAL_FREQUENCY + c.frequencyOffset;
+
+    double magnitude[3];
+    double phase0[3];
+    for (int p = 0; p < 3; p++) {
+        magnitude[p] = 230.0 * c.magnitude * (c.unbalance && p == 1 ? 0.9 : 1.0);
+        phase0[p] = -p * 2.0 * M_PI / 3.0 + (c.unbalance && p == 2 ? 5.0 * M_PI / 180.0 : 0.0);
+    }
+
+    static PhasorEstimator estimator;
+    estimator.begin(3, sampleRate, NOMINAL_FREQUENCY, calibration, 0.0f, rate);
+    PmuResult result;
+    memset(&result, 0, sizeof(result));
+
+    const uint64_t startUs = START_SECOND * 1000000 + START_OFFSET_US;
+    const uint32_t count = CASE_SECONDS * sampleRate;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t utcUs = startUs + (uint64_t)i * PowerAnalyzer::INTERVAL_US;
+        // Фаза сигнала — от начала секунды START_SECOND
+        double t = (double)(utcUs - START_SECOND * 1000000) * 1e-6;
+        int16_t frame[3];
+        for (int p = 0; p < 3; p++) {
+            double theta = 2.0 * M_PI * frequency * t + phase0[p];
+            double value = cos(theta) + c.harmonic3 * cos(3 * theta) + c.harmonic5 * cos(5 * theta);
+            int noise = (int)(nextRandom() % 5) - 2;
+            long counts = lround(ADC_OFFSET + magnitude[p] * sqrt(2.0) / calibration[p] * value) + noise;
+            frame[p] = (int16_t)(counts < 0 ? 0 : (counts > ADC_MAX_VALUE ? ADC_MAX_VALUE : counts));
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        bool ready = estimator.push(frame, utcUs);
+        pushNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+        frames++;
+        if (!ready) {
+            continue;
+        }
+
+        const SynchrophasorFrame& report = estimator.getFrame();
+        uint64_t reportUs = (uint64_t)report.soc * 1000000 + report.fracUs;
+        double tr = (double)(reportUs - START_SECOND * 1000000) * 1e-6;
+        double angle[3];
+        for (int p = 0; p < 3; p++) {
+            angle[p] = phasorAngle(2.0 * M_PI * frequency * tr + phase0[p], reportUs);
+        }
+        checkReport(report, config, rate, magnitude, angle, frequency, result);
+    }
+    return result;
+}
+
+/**
+ * Конфигурация: закодировать, разобрать и сверить; испорченный кадр не должен разбираться
+ */
+static bool checkConfig(uint32_t rate, SynchrophasorConfig& config) {
+    uint8_t buffer[C37_CONFIG_FRAME_MAX];
+    size_t length = SynchrophasorCodec::encodeConfig(PMU_IDCODE, DEVICE_ID, 3, CHANNEL_NAMES, NOMINAL_FREQUENCY,
+                                                     (uint16_t)rate, 1, (uint32_t)START_SECOND, buffer,
+                                                     sizeof(buffer));
+    if (length == 0 || !SynchrophasorCodec::decodeConfig(buffer, length, config)) {
+        return false;
+    }
+    bool ok = config.idcode == PMU_IDCODE && config.phasors == 4 && config.rate == rate &&
+              config.nominalFrequency == NOMINAL_FREQUENCY && strcmp(config.names[1], "VB") == 0 &&
+              strcmp(config.names[3], "V1") == 0 && strcmp(config.station, DEVICE_ID) == 0;
+
+    SynchrophasorConfig corrupted;
+    buffer[length / 2] ^= 0x10;
+    return ok && !SynchrophasorCodec::decodeConfig(buffer, length, corrupted);
+}
+
+/**
+ * Тот же путь, что у задачи PMU на устройстве: acquire() блоками встык,
+ * каждый кадр — в оценку во время оцифровки
+ */
+static bool runEndToEnd(uint32_t rate) {
+    const float voltage = 230.0f;
+    const float gridFrequency = NOMINAL_FREQUENCY - 0.3f;
+    SyntheticGrid grid(voltage, gridFrequency, 8);
+    NativeHal::setAdcSource(&grid);
+    PowerAnalyzer analyzer(ANALYZER_CHANNEL_PINS, ANALYZER_CHANNEL_CALIBRATION);
+    analyzer.begin();
+
+    float calibration[3];
+    for (int ch = 0; ch < 3; ch++) {
+        calibration[ch] = analyzer.getSensitivity(ch);
+    }
+    static PhasorEstimator estimator;
+    estimator.begin(PowerAnalyzer::VOLTAGE_CHANNELS, PowerAnalyzer::SAMPLE_RATE_HZ, NOMINAL_FREQUENCY,
+                    calibration, 0.0f, rate);
+    SynchrophasorConfig config;
+    checkConfig(rate, config);
+
+    // Виртуальные часы HAL сопоставлены UTC; таблица SyntheticGrid — синус с целым периодом в мкс
+    uint32_t startUs = PowerAnalyzer::startNowUs();
+    const uint64_t utcBaseUs = START_SECOND * 1000000 + START_OFFSET_US - startUs;
+    const double periodUs = (double)lroundf(1000000.0f / gridFrequency);
+    const double frequency = 1e6 / periodUs;
+    const double magnitude[3] = {voltage, voltage, voltage};
+
+    std::vector<int16_t> block(PowerAnalyzer::BLOCK_SAMPLES);
+    PmuResult result;
+    memset(&result, 0, sizeof(result));
+    const uint32_t blockUs = PowerAnalyzer::FRAMES_PER_BLOCK * PowerAnalyzer::INTERVAL_US;
+    const uint32_t blocks = CASE_SECONDS * 1000000 / blockUs;
+    for (uint32_t b = 0; b < blocks; b++) {
+        uint32_t maxLateUs;
+        const uint32_t blockStartUs = startUs;
+        analyzer.acquire(block.data(), blockStartUs, maxLateUs, [&](const int16_t* frame, int i) {
+            uint64_t utcUs = utcBaseUs + blockStartUs + (uint64_t)i * PowerAnalyzer::INTERVAL_US;
+            if (!estimator.push(frame, utcUs)) {
+                return;
+            }
+            const SynchrophasorFrame& report = estimator.getFrame();
+            uint64_t reportUs = (uint64_t)report.soc * 1000000 + report.fracUs;
+            double t = (double)(reportUs - utcBaseUs);
+            double angle[3];
+            for (int p = 0; p < 3; p++) {
+                // sin(2πt/T + сдвиг) = cos(2πt/T + сдвиг - π/2)
+                angle[p] = phasorAngle(2.0 * M_PI * fmod(t, periodUs) / periodUs - p * 2.0 * M_PI / 3.0 - M_PI / 2.0,
+                                       reportUs);
+            }
+            checkReport(report, config, rate, magnitude, angle, frequency, result);
+        });
+        startUs += blockUs;
+    }
+    NativeHal::setAdcSource(nullptr);
+
+    bool pass = result.failures == 0 && result.reports >= rate * (CASE_SECONDS - 1) &&
+                result.maxTve <= TVE_LIMIT_PCT && result.maxFe <= FE_LIMIT_HZ;
+    printf("\nacquire() + SyntheticGrid, %.0f V %.4f Hz, noise ±8, %u fps: %u reports, TVE %.3f %% "
+           "(V1 %.3f %%), FE %.2f mHz, RFE %.3f Hz/s  %s\n",
+           voltage, frequency, (unsigned)rate, (unsigned)result.reports, result.maxTve, result.maxPositiveTve,
+           result.maxFe * 1000.0, result.maxRfe, pass ? "ok" : "FAIL");
+    return pass;
+}
+
+int runPmuCheck() {
+    const bool nominal50 = NOMINAL_FREQUENCY == 50.0f;
+    const uint32_t rates[3] = {10, nominal50 ? 25u : 30u, nominal50 ? 50u : 60u};
+
+    static PhasorEstimator window;
+    const float calibration[3] = {CALIBRATION_COEFF_A, CALIBRATION_COEFF_B, CALIBRATION_COEFF_C};
+    window.begin(3, PowerAnalyzer::SAMPLE_RATE_HZ, NOMINAL_FREQUENCY, calibration, 0.0f, rates[0]);
+    printf("PMU check: %u Hz sampling, window %d frames, limits TVE %.1f %%, FE %.0f mHz, RFE %.1f Hz/s\n\n",
+           (unsigned)PowerAnalyzer::SAMPLE_RATE_HZ, window.getWindowFrames(), TVE_LIMIT_PCT,
+           FE_LIMIT_HZ * 1000.0, RFE_LIMIT_HZ_S);
+    printf("%-5s %-22s %8s %10s %10s %10s %10s\n", "fps", "case", "reports", "TVE %", "V1 TVE %", "FE mHz",
+           "RFE Hz/s");
+
+    bool pass = true;
+    double pushNs = 0.0;
+    uint64_t frames = 0;
+    for (int r = 0; r < 3; r++) {
+        const uint32_t rate = rates[r];
+        SynchrophasorConfig config;
+        if (!checkConfig(rate, config)) {
+            printf("%-5u configuration frame round trip FAILED\n", (unsigned)rate);
+            pass = false;
+            continue;
+        }
+
+        // Диапазон частоты M-класса: ±rate/5, но не больше 5 Гц
+        double range = rate / 5.0 < 5.0 ? rate / 5.0 : 5.0;
+        const PmuCase cases[] = {
+            {"nominal", 0.0, 1.0, 0.0, 0.0, false},
+            {"f -2 Hz", -2.0, 1.0, 0.0, 0.0, false},
+            {"f +2 Hz", 2.0, 1.0, 0.0, 0.0, false},
+            {"f -range", -range, 1.0, 0.0, 0.0, false},
+            {"f +range", range, 1.0, 0.0, 0.0, false},
+            {"magnitude 10 %", 0.0, 0.1, 0.0, 0.0, false},
+            {"magnitude 120 %", 0.0, 1.2, 0.0, 0.0, false},
+            {"3rd 10 % + 5th 5 %", 0.0, 1.0, 0.1, 0.05, false},
+            {"unbalance", 0.0, 1.0, 0.0, 0.0, true},
+        };
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+            if (range == 2.0 && strstr(cases[i].name, "range") != nullptr) {
+                continue;
+            }
+            PmuResult result = runCase(cases[i], rate, config, pushNs, frames);
+            bool ok = result.failures == 0 && result.reports >= rate * (CASE_SECONDS - 1) &&
+                      result.maxTve <= TVE_LIMIT_PCT && result.maxPositiveTve <= TVE_LIMIT_PCT &&
+                      result.maxFe <= FE_LIMIT_HZ && result.maxRfe <= RFE_LIMIT_HZ_S;
+            pass = pass && ok;
+            char name[40];
+            snprintf(name, sizeof(name), "%s", cases[i].name);
+            if (strstr(cases[i].name, "range") != nullptr) {
+                snprintf(name, sizeof(name), "f %+.0f Hz", cases[i].frequencyOffset);
+            }
+            printf("%-5u %-22s %8u %10.3f %10.3f %10.2f %10.3f  %s\n", (unsigned)rate, name,
+                   (unsigned)result.reports, result.maxTve, result.maxPositiveTve, result.maxFe * 1000.0,
+                   result.maxRfe, ok ? "ok" : "FAIL");
+        }
+    }
+    printf("\npush(): %.0f ns/frame on this host (budget %u us per frame on the device)\n",
+           frames > 0 ? pushNs / frames : 0.0, (unsigned)PowerAnalyzer::INTERVAL_US);
+
+    pass = runEndToEnd(rates[2]) && pass;
+    printf("\nPMU check %s\n", pass ? "passed" : "FAILED");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+#ifndef PMU_CHECK_H
+#define PMU_CHECK_H
+
+/**
+ * Проверка синхрофазоров (PhasorEstimator + SynchrophasorCodec)
+ *
+ * Трёхфазный сигнал с известными фазорами квантуется в 12-битные отсчёты с
+ * шумом и подаётся кадр за кадром с метками времени UTC. Каждый отчёт
+ * кодируется в кадр C37.118 и разбирается обратно, как его разберёт приёмник;
+ * по разобранному считаются полная векторная ошибка (TVE) каждой фазы и
+ * прямой последовательности, ошибка частоты (FE) и ROCOF (RFE) против
+ * идеальных значений в момент отчёта. Случаи при 10/25/50 кадрах/с (10/30/60
+ * при 60 Гц): номинал, частота ±2 Гц и ±rate/5 (до 5 Гц), амплитуда 10 % и
+ * 120 %, гармоники, несимметрия. Затем тот же путь, что на устройстве:
+ * acquire() с обработкой каждого кадра, SyntheticGrid через NativeHal.
+ * Пределы — TVE 1 %, FE 0.005 Гц, RFE 0.4 Гц/с.
+ * @return Код выхода процесса (1 — превышен предел или кадр не разобран)
+ */
+int runPmuCheck();
+
+#endif // PMU_CHECK_H
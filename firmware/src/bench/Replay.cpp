@@ -0,0 +1,178 @@
+#include "Replay.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "../config.h"
+#include "../hal/HalNative.h"
+#include "../PowerAnalyzer.h"
+#include "../TelemetryCodec.h"
+#include "CaptureReader.h"
+#include "BoardVariants.h"
+
+/**
+ * Воспроизведение анализатором того варианта платы, с которой сделан захват
+ */
+template <typename Analyzer>
+static int replayWith(CaptureReader& reader, const char* path, int repeat, bool csv) {
+    const CaptureHeader& header = reader.getHeader();
+
+    // Выводы, смещения и калибровка — как были на устройстве в момент записи
+    int pins[Analyzer::CHANNELS];
+    float calibration[Analyzer::CHANNELS];
+    for (int ch = 0; ch < Analyzer::CHANNELS; ch++) {
+        pins[ch] = header.channelPins[ch];
+        calibration[ch] = header.calibration[ch];
+    }
+    Analyzer analyzer(pins, calibration);
+    for (int ch = 0; ch < Analyzer::CHANNELS; ch++) {
+        analyzer.setChannel(ch, header.offsets[ch], header.calibration[ch]);
+    }
+
+    char deviceId[CAPTURE_DEVICE_ID_LEN + 1] = {0};
+    memcpy(deviceId, header.deviceId, CAPTURE_DEVICE_ID_LEN);
+
+    if (csv) {
+        printf("seq,timestamp_ms,voltage_a,voltage_b,voltage_c,voltage_ab,voltage_bc,voltage_ca,"
+               "frequency_a,frequency_b,frequency_c,unbalance,problem_flags");
+        for (int k = 0; k < Analyzer::CURRENT_CHANNELS; k++) {
+            printf(",current_%d", k + 1);
+        }
+        if (Analyzer::CURRENT_CHANNELS > 0) {
+            printf(",active_power,reactive_power,power_factor,energy_import_kwh,energy_export_kwh");
+        }
+        printf("\n");
+    } else {
+        fprintf(stderr, "Capture: %s, device %s, topology %u, %u Hz, %u channels, %zu bytes\n",
+                path, deviceId, header.topology, header.sampleRateHz, header.channelCount,
+                reader.getFileSize());
+    }
+
+    uint64_t blocks = 0;
+    uint64_t frames = 0;
+    uint64_t spanMs = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int pass = 0; pass < repeat; pass++) {
+        reader.rewind();
+        CaptureBlock block;
+        bool first = true;
+        uint32_t firstMs = 0;
+        uint32_t lastMs = 0;
+
+        while (reader.next(block)) {
+            const CaptureBlockHeader* bh = block.header;
+            PowerData data = analyzer.analyze(block.samples, bh->frameCount, bh->timestampMs);
+
+            if (csv && pass == 0) {
+                printf("%u,%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%.3f,%u",
+                       bh->seq, bh->timestampMs,
+                       data.voltageA, data.voltageB, data.voltageC,
+                       data.voltageAB, data.voltageBC, data.voltageCA,
+                       data.frequencyA, data.frequencyB, data.frequencyC,
+                       data.unbalance, TelemetryCodec::problemFlags(data));
+                for (int ch = Analyzer::VOLTAGE_CHANNELS; ch < Analyzer::CHANNELS; ch++) {
+                    printf(",%.3f", analyzer.getChannelRms(ch));
+                }
+                if (Analyzer::CURRENT_CHANNELS > 0) {
+                    printf(",%.1f,%.1f,%.3f,%.6f,%.6f", data.activePower, data.reactivePower, data.powerFactor,
+                           data.energyImportKwh, data.energyExportKwh);
+                }
+                printf("\n");
+            }
+
+            if (first) {
+                firstMs = bh->timestampMs;
+                first = false;
+            }
+            lastMs = bh->timestampMs;
+            blocks++;
+            frames += bh->frameCount;
+        }
+        // Реальная длительность записи: от первого до последнего блока плюс один интервал
+        if (!first) {
+            spanMs += (uint64_t)(lastMs - firstMs) + SEND_INTERVAL_MS;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double sampledSeconds = (double)frames / header.sampleRateHz;
+
+    fprintf(stderr,
+            "Replayed %llu blocks (%llu frames, %u resyncs) in %.3f s: %.0f samples/s, "
+            "%.0fx real time, %.0fx sampled time\n",
+            (unsigned long long)blocks, (unsigned long long)frames, reader.getResyncCount(), seconds,
+            frames * header.channelCount / seconds,
+            spanMs / 1000.0 / seconds, sampledSeconds / seconds);
+    return 0;
+}
+
+int runReplay(const char* path, int repeat, bool csv) {
+    CaptureReader reader;
+    if (!reader.open(path)) {
+        fprintf(stderr, "%s: %s\n", path, reader.getError());
+        return 1;
+    }
+
+    const CaptureHeader& header = reader.getHeader();
+    if (PowerAnalyzer::matches(header)) {
+        return replayWith<PowerAnalyzer>(reader, path, repeat, csv);
+    }
+    if (SinglePhaseAnalyzer::matches(header)) {
+        return replayWith<SinglePhaseAnalyzer>(reader, path, repeat, csv);
+    }
+    if (SplitPhaseAnalyzer::matches(header)) {
+        return replayWith<SplitPhaseAnalyzer>(reader, path, repeat, csv);
+    }
+    if (DeltaAnalyzer::matches(header)) {
+        return replayWith<DeltaAnalyzer>(reader, path, repeat, csv);
+    }
+    if (WyeSixChannelAnalyzer::matches(header)) {
+        return replayWith<WyeSixChannelAnalyzer>(reader, path, repeat, csv);
+    }
+
+    fprintf(stderr, "%s: no analyzer variant for topology %u, %u channels, %u Hz (bench/BoardVariants.h)\n",
+            path, header.topology, header.channelCount, header.sampleRateHz);
+    return 1;
+}
+
+int writeSyntheticCapture(const char* path, uint32_t blocks, SyntheticGrid& grid) {
+    FILE* out = fopen(path, "wb");
+    if (out == nullptr) {
+        perror(path);
+        return 1;
+    }
+
+    NativeHal::setAdcSource(&grid);
+    PowerAnalyzer analyzer(ANALYZER_CHANNEL_PINS, ANALYZER_CHANNEL_CALIBRATION);
+    analyzer.begin();
+
+    CaptureHeader header;
+    analyzer.describeCapture(header, "synthetic", 0);
+    fwrite(&header, sizeof(header), 1, out);
+
+    const uint32_t windowUs = PowerAnalyzer::FRAMES_PER_BLOCK * PowerAnalyzer::INTERVAL_US;
+    for (uint32_t seq = 0; seq < blocks; seq++) {
+        PowerData data = analyzer.measure();
+
+        CaptureBlockHeader bh;
+        bh.magic = CAPTURE_BLOCK_MAGIC;
+        bh.seq = seq;
+        bh.timestampMs = data.timestamp;
+        bh.frameCount = analyzer.getLastBlockFrames();
+        bh.flags = 0;
+        fwrite(&bh, sizeof(bh), 1, out);
+        fwrite(analyzer.getLastBlock(), sizeof(int16_t), (size_t)bh.frameCount * PowerAnalyzer::CHANNELS, out);
+
+        // Как в loop(): одно окно в SEND_INTERVAL_MS
+        if (SEND_INTERVAL_MS * 1000 > windowUs) {
+            NativeHal::advanceUs(SEND_INTERVAL_MS * 1000 - windowUs);
+        }
+    }
+
+    if (fclose(out) != 0) {
+        perror(path);
+        return 1;
+    }
+    fprintf(stderr, "Wrote %u synthetic blocks to %s\n", blocks, path);
+    return 0;
+}
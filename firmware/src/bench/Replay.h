@@ -0,0 +1,24 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include "SyntheticGrid.h"
+
+/**
+ * Прогнать файл захвата через analyze() варианта платы, с которой он снят
+ * (PowerAnalyzer или один из BoardVariants.h)
+ * @param path Файл захвата (CaptureFormat.h)
+ * @param repeat Сколько раз пройти файл (для замера пропускной способности)
+ * @param csv Печатать PowerData каждого блока в CSV (эталон для регрессионного сравнения)
+ * @return Код выхода процесса
+ */
+int runReplay(const char* path, int repeat, bool csv);
+
+/**
+ * Записать файл захвата с синтетической сетью тем же путём, что и устройство:
+ * PowerAnalyzer::measure() через NativeHal, блок за блоком с шагом SEND_INTERVAL_MS
+ * @return Код выхода процесса
+ */
+int writeSyntheticCapture(const char* path, uint32_t blocks, SyntheticGrid& grid);
+
+#endif // REPLAY_H
@@ -0,0 +1,320 @@
+#include "RocofSim.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "../config.h"
+#include "../hal/Hal.h"
+#include "../hal/HalNative.h"
+#include "../PowerAnalyzer.h"
+#include "../FrequencyTracker.h"
+#include "SyntheticGrid.h"
+
+// Начало записи — не на границе интервала, чтобы выравнивание по UTC было видно
+#define START_US (1700000000ull * 1000000 + 123457)
+
+// Пределы: значение на установившемся участке, ROCOF при постоянном наклоне
+#define VALUE_LIMIT_HZ 0.05
+#define VALUE_RMS_LIMIT_HZ 0.015
+#define ROCOF_LIMIT_HZ_S 0.1
+
+// Участок после изменения наклона, на котором значения и ROCOF не проверяются
+#define VALUE_SETTLE_S 0.1
+#define ROCOF_SETTLE_S (FREQSTREAM_ROCOF_WINDOW_MS / 1000.0 + 0.1)
+
+/**
+ * Детерминированный xorshift32: один и тот же прогон при каждом запуске
+ */
+static uint32_t randomState = 2463534242u;
+
+static uint32_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+/**
+ * Отрезок хода частоты: ROCOF постоянен
+ */
+struct Segment {
+    double seconds;
+    double rocof;               // Гц/с
+};
+
+struct RocofCase {
+    const char* name;
+    double startFrequency;      // Отклонение от номинала, Гц
+    Segment segments[5];
+    int segmentCount;
+    int expectedEvents;         // Начал событий
+    double lossFrom;            // Фаза A без напряжения с этого момента, с (< 0 — нет)
+    double lossSeconds;
+};
+
+struct RocofResult {
+    uint32_t values;
+    uint32_t checkedValues;
+    double sumSquares;
+    double maxValueError;
+    double maxRocofError;
+    int events;
+    int endEvents;
+    double delayMs;             // От начала первого наклона выше порога до начала события
+    double peakRocof;
+    double minFrequency;
+};
+
+/**
+ * Частота и время с последнего изменения наклона в момент t
+ */
+static double frequencyAt(const RocofCase& c, double t, double& sinceChange, double& rocof) {
+    double f = NOMINAL_FREQUENCY + c.startFrequency;
+    double start = 0.0;
+    for (int i = 0; i < c.segmentCount; i++) {
+        const Segment& s = c.segments[i];
+        if (t < start + s.seconds || i == c.segmentCount - 1) {
+            sinceChange = t - start;
+            rocof = s.rocof;
+            return f + s.rocof * (t - start);
+        }
+        f += s.rocof * s.seconds;
+        start += s.seconds;
+    }
+    sinceChange = t;
+    rocof = 0.0;
+    return f;
+}
+
+static double caseSeconds(const RocofCase& c) {
+    double total = 0.0;
+    for (int i = 0; i < c.segmentCount; i++) {
+        total += c.segments[i].seconds;
+    }
+    return total;
+}
+
+/**
+ * Начало первого отрезка с |ROCOF| не ниже порога, с (< 0 — нет такого)
+ */
+static double firstRampStart(const RocofCase& c) {
+    double start = 0.0;
+    for (int i = 0; i < c.segmentCount; i++) {
+        if (fabs(c.segments[i].rocof) >= FREQSTREAM_ROCOF_THRESHOLD) {
+            return start;
+        }
+        start += c.segments[i].seconds;
+    }
+    return -1.0;
+}
+
+static void checkSample(const RocofCase& c, const FrequencySample& s, RocofResult& result) {
+    result.values++;
+    double t = (double)(s.timeMs * 1000 - START_US) * 1e-6;
+    double sinceChange;
+    double rocof;
+    // Значение — частота последнего периода: сравнение с серединой периода, закончившегося полпериода назад
+    double truth = frequencyAt(c, t - 1.5 / NOMINAL_FREQUENCY / 2.0, sinceChange, rocof);
+    if (sinceChange >= VALUE_SETTLE_S && rocof == 0.0) {
+        double error = fabs(s.frequency - truth);
+        result.checkedValues++;
+        result.sumSquares += error * error;
+        result.maxValueError = error > result.maxValueError ? error : result.maxValueError;
+    }
+    if (sinceChange >= ROCOF_SETTLE_S && !isnan(s.rocof)) {
+        double error = fabs(s.rocof - rocof);
+        result.maxRocofError = error > result.maxRocofError ? error : result.maxRocofError;
+    }
+}
+
+static void drainEvents(FrequencyTracker& tracker, const RocofCase& c, RocofResult& result) {
+    FrequencyEvent events[FREQUENCY_TRACKER_MAX_EVENTS];
+    int count = tracker.readEvents(events, FREQUENCY_TRACKER_MAX_EVENTS);
+    for (int i = 0; i < count; i++) {
+        if (events[i].active) {
+            if (result.events == 0 && firstRampStart(c) >= 0.0) {
+                result.delayMs = (double)(events[i].startMs * 1000 - START_US) * 1e-3 - firstRampStart(c) * 1000.0;
+            }
+            result.events++;
+        } else {
+            result.endEvents++;
+            result.peakRocof = events[i].rocof;
+            result.minFrequency = events[i].frequencyMin;
+        }
+    }
+}
+
+/**
+ * Прогнать случай через FrequencyTracker блоками по FRAMES_PER_BLOCK кадров
+ */
+static RocofResult runCase(const RocofCase& c, double& pushNs, uint64_t& frames) {
+    const double calibration = CALIBRATION_COEFF_A;
+    const double amplitude = 230.0 * sqrt(2.0) / calibration;
+    const uint32_t intervalUs = PowerAnalyzer::INTERVAL_US;
+    const float offsets[3] = {(float)ADC_OFFSET, (float)ADC_OFFSET, (float)ADC_OFFSET};
+
+    static FrequencyTracker tracker;
+    tracker.begin(3, PowerAnalyzer::SAMPLE_RATE_HZ, NOMINAL_FREQUENCY, offsets, FREQSTREAM_HYSTERESIS_COUNTS);
+    RocofResult result;
+    memset(&result, 0, sizeof(result));
+
+    const uint32_t count = (uint32_t)(caseSeconds(c) * PowerAnalyzer::SAMPLE_RATE_HZ);
+    double theta = 0.0;
+    FrequencySample samples[FREQSTREAM_BUFFER_SLOTS];
+    for (uint32_t i = 0; i < count; i++) {
+        if (i % PowerAnalyzer::FRAMES_PER_BLOCK == 0) {
+            tracker.beginBlock(START_US + (uint64_t)i * intervalUs);
+        }
+        double t = (double)i * intervalUs * 1e-6;
+        double sinceChange;
+        double rocof;
+        theta += 2.0 * M_PI * frequencyAt(c, t, sinceChange, rocof) * intervalUs * 1e-6;
+        bool lost = c.lossFrom >= 0.0 && t >= c.lossFrom && t < c.lossFrom + c.lossSeconds;
+
+        int16_t frame[3];
+        for (int p = 0; p < 3; p++) {
+            double phase = theta - p * 2.0 * M_PI / 3.0;
+            double value = cos(phase) + 0.03 * cos(3 * phase) + 0.02 * cos(5 * phase);
+            int noise = (int)(nextRandom() % 17) - 8;
+            long counts = lround(ADC_OFFSET + (lost && p == 0 ? 0.0 : amplitude * value)) + noise;
+            frame[p] = (int16_t)(counts < 0 ? 0 : (counts > ADC_MAX_VALUE ? ADC_MAX_VALUE : counts));
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        tracker.push(frame);
+        pushNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+        frames++;
+
+        // Как loop(): забирать кольцо реже, чем оно заполняется
+        if (i % PowerAnalyzer::FRAMES_PER_BLOCK == PowerAnalyzer::FRAMES_PER_BLOCK - 1) {
+            int n = tracker.readSamples(samples, FREQSTREAM_BUFFER_SLOTS);
+            for (int k = 0; k < n; k++) {
+                checkSample(c, samples[k], result);
+            }
+            drainEvents(tracker, c, result);
+        }
+    }
+    if (tracker.getDropped() > 0) {
+        result.values = 0;
+    }
+    return result;
+}
+
+/**
+ * Тот же путь, что на устройстве: acquire() с обработкой кадра
+ */
+static bool runEndToEnd() {
+    const float gridFrequency = NOMINAL_FREQUENCY - 0.3f;
+    SyntheticGrid grid(230.0f, gridFrequency, 8);
+    NativeHal::setAdcSource(&grid);
+    PowerAnalyzer analyzer(ANALYZER_CHANNEL_PINS, ANALYZER_CHANNEL_CALIBRATION);
+    analyzer.begin();
+
+    float offsets[3];
+    for (int ch = 0; ch < PowerAnalyzer::VOLTAGE_CHANNELS; ch++) {
+        offsets[ch] = analyzer.getOffset(ch);
+    }
+    static FrequencyTracker tracker;
+    tracker.begin(PowerAnalyzer::VOLTAGE_CHANNELS, PowerAnalyzer::SAMPLE_RATE_HZ, NOMINAL_FREQUENCY, offsets,
+                  FREQSTREAM_HYSTERESIS_COUNTS * PowerAnalyzer::FRAME_SCALE);
+
+    // Таблица SyntheticGrid — синус с целым периодом в мкс
+    const double frequency = 1e6 / (double)lroundf(1000000.0f / gridFrequency);
+    std::vector<int16_t> block(PowerAnalyzer::BLOCK_SAMPLES);
+    uint32_t startUs = PowerAnalyzer::startNowUs();
+    const uint32_t blockUs = PowerAnalyzer::FRAMES_PER_BLOCK * PowerAnalyzer::INTERVAL_US;
+    FrequencySample samples[FREQSTREAM_BUFFER_SLOTS];
+    uint32_t values = 0;
+    double maxError = 0.0;
+    double maxRocof = 0.0;
+    for (int b = 0; b < 25; b++) {
+        uint32_t maxLateUs;
+        tracker.beginBlock(START_US + (uint64_t)b * blockUs);
+        analyzer.acquire(block.data(), startUs, maxLateUs, [&](const int16_t* frame, int i) {
+            tracker.push(frame);
+        });
+        startUs += blockUs;
+        int n = tracker.readSamples(samples, FREQSTREAM_BUFFER_SLOTS);
+        for (int k = 0; k < n; k++) {
+            values++;
+            double error = fabs(samples[k].frequency - frequency);
+            maxError = error > maxError ? error : maxError;
+            if (!isnan(samples[k].rocof)) {
+                maxRocof = fabs(samples[k].rocof) > maxRocof ? fabs(samples[k].rocof) : maxRocof;
+            }
+        }
+    }
+    NativeHal::setAdcSource(nullptr);
+
+    const uint32_t expected = 5 * FREQSTREAM_RATE - 2;
+    bool pass = values >= expected && maxError <= VALUE_LIMIT_HZ && maxRocof <= ROCOF_LIMIT_HZ_S &&
+                tracker.getEventCount() == 0;
+    printf("\nacquire() + SyntheticGrid, %.4f Hz, noise ±8, 5 s: %u values, max error %.1f mHz, "
+           "max |ROCOF| %.3f Hz/s, %u events  %s\n",
+           frequency, (unsigned)values, maxError * 1000.0, maxRocof, (unsigned)tracker.getEventCount(),
+           pass ? "ok" : "FAIL");
+    return pass;
+}
+
+int runRocofSim() {
+    const RocofCase cases[] = {
+        {"nominal", 0.0, {{10.0, 0.0}}, 1, 0, -1.0, 0.0},
+        {"f -0.3 Hz", -0.3, {{10.0, 0.0}}, 1, 0, -1.0, 0.0},
+        {"drift +0.2 Hz/s, 1 s", 0.0, {{3.0, 0.0}, {1.0, 0.2}, {4.0, 0.0}}, 3, 0, -1.0, 0.0},
+        {"trip -1 Hz/s, recovery", 0.0, {{4.0, 0.0}, {0.8, -1.0}, {3.0, 0.0}, {2.0, 0.25}, {4.0, 0.0}}, 5, 1,
+         -1.0, 0.0},
+        {"phase A lost 2 s", 0.0, {{8.0, 0.0}}, 1, 0, 3.0, 2.0},
+    };
+
+    printf("ROCOF check: %u Hz sampling, %d values/s, filter %d frames, ROCOF window %d ms, threshold %.2f Hz/s\n",
+           (unsigned)PowerAnalyzer::SAMPLE_RATE_HZ, FREQSTREAM_RATE, FREQSTREAM_FILTER_FRAMES,
+           FREQSTREAM_ROCOF_WINDOW_MS, FREQSTREAM_ROCOF_THRESHOLD);
+    printf("limits: value %.0f mHz (RMS %.0f mHz) when steady, ROCOF %.2f Hz/s on constant slopes\n\n",
+           VALUE_LIMIT_HZ * 1000.0, VALUE_RMS_LIMIT_HZ * 1000.0, ROCOF_LIMIT_HZ_S);
+    printf("%-24s %7s %9s %9s %12s %7s %9s %s\n", "case", "values", "RMS mHz", "max mHz", "ROCOF err",
+           "events", "delay ms", "peak / f_min");
+
+    bool pass = true;
+    double pushNs = 0.0;
+    uint64_t frames = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const RocofCase& c = cases[i];
+        RocofResult result = runCase(c, pushNs, frames);
+        double rms = result.checkedValues > 0 ? sqrt(result.sumSquares / result.checkedValues) : 0.0;
+        uint32_t expected = (uint32_t)(caseSeconds(c) * FREQSTREAM_RATE) - 2;
+        bool ok = result.values >= expected && result.maxValueError <= VALUE_LIMIT_HZ &&
+                  rms <= VALUE_RMS_LIMIT_HZ && result.maxRocofError <= ROCOF_LIMIT_HZ_S &&
+                  result.events == c.expectedEvents && result.endEvents == c.expectedEvents &&
+                  (c.expectedEvents == 0 || result.delayMs <= FREQSTREAM_ROCOF_WINDOW_MS);
+        pass = pass && ok;
+        printf("%-24s %7u %9.2f %9.2f %12.3f %7d", c.name, (unsigned)result.values, rms * 1000.0,
+               result.maxValueError * 1000.0, result.maxRocofError, result.events);
+        if (result.endEvents > 0) {
+            printf(" %9.0f %+.2f Hz/s, %.3f Hz", result.delayMs, result.peakRocof, result.minFrequency);
+        } else {
+            printf(" %9s", "-");
+        }
+        printf("  %s\n", ok ? "ok" : "FAIL");
+    }
+    printf("\npush(): %.0f ns/frame on this host (budget %u us per frame on the device)\n",
+           frames > 0 ? pushNs / frames : 0.0, (unsigned)PowerAnalyzer::INTERVAL_US);
+
+    // Размер точек одной пачки: буфер loop() должен вместить FREQSTREAM_RATE × FREQSTREAM_BATCH_S
+    static FrequencySample batch[FREQSTREAM_RATE * FREQSTREAM_BATCH_S];
+    for (int i = 0; i < FREQSTREAM_RATE * FREQSTREAM_BATCH_S; i++) {
+        batch[i].timeMs = START_US / 1000 + i * (1000 / FREQSTREAM_RATE);
+        batch[i].frequency = NOMINAL_FREQUENCY - 0.123f;
+        batch[i].rocof = -1.234f;
+    }
+    static char lines[FREQSTREAM_LINE_PROTOCOL_SIZE];
+    size_t length = FrequencyTracker::writeLineProtocol(batch, FREQSTREAM_RATE * FREQSTREAM_BATCH_S, lines,
+                                                        sizeof(lines), "esp32-device-with-a-long-name-01");
+    printf("batch of %d values: %u bytes of line protocol (buffer %u)  %s\n", FREQSTREAM_RATE * FREQSTREAM_BATCH_S,
+           (unsigned)length, (unsigned)sizeof(lines), length > 0 ? "ok" : "FAIL");
+    pass = pass && length > 0;
+
+    pass = runEndToEnd() && pass;
+    printf("\nROCOF check %s\n", pass ? "passed" : "FAILED");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+#ifndef ROCOF_SIM_H
+#define ROCOF_SIM_H
+
+/**
+ * Проверка частоты по периодам и ROCOF (FrequencyTracker)
+ *
+ * Трёхфазный сигнал с заданным ходом частоты (отрезки с постоянным ROCOF,
+ * фаза интегрируется точно), 3-я и 5-я гармоники и шум ±8 отсчётов
+ * подаются кадр за кадром блоками с метками UTC, как в задаче оцифровки.
+ * Случаи: номинал, 49.7 Гц, медленный дрейф ниже порога, отключение
+ * генератора (-1 Гц/с до 49.2 Гц и восстановление), обрыв фазы A. По каждому
+ * — ошибка значений на установившихся участках, ошибка ROCOF на участках с
+ * постоянным наклоном, события ROCOF и задержка их обнаружения. Затем тот же
+ * путь, что на устройстве: acquire() с обработкой кадра, SyntheticGrid через
+ * NativeHal.
+ * @return Код выхода процесса (1 — превышен предел или события не те)
+ */
+int runRocofSim();
+
+#endif // ROCOF_SIM_H
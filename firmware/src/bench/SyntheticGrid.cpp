@@ -0,0 +1,100 @@
+#include "SyntheticGrid.h"
+#include <math.h>
+#include "../config.h"
+
+static const float calibration[3] = {CALIBRATION_COEFF_A, CALIBRATION_COEFF_B, CALIBRATION_COEFF_C};
+static const float ctCalibration[3] = {CT_CALIBRATION_A, CT_CALIBRATION_B, CT_CALIBRATION_C};
+
+SyntheticGrid::SyntheticGrid(float voltage, float frequency, int noiseCounts)
+    : current(0.0f),
+      lagDegrees(0.0f),
+      frequency(frequency),
+      noiseCounts(noiseCounts),
+      noiseState(12345) {
+    periodUs = (uint32_t)lroundf(1000000.0f / frequency);
+    for (int ph = 0; ph < 3; ph++) {
+        voltages[ph] = voltage;
+        table[ph] = new int16_t[periodUs];
+        table[3 + ph] = new int16_t[periodUs];
+        buildTable(ph);
+    }
+}
+
+SyntheticGrid::~SyntheticGrid() {
+    for (int i = 0; i < 6; i++) {
+        delete[] table[i];
+    }
+}
+
+void SyntheticGrid::setPhaseVoltage(int phase, float voltage) {
+    voltages[phase] = voltage;
+    buildTable(phase);
+}
+
+void SyntheticGrid::setLoad(float amps, float lagDegrees) {
+    current = amps;
+    this->lagDegrees = lagDegrees;
+    for (int ph = 0; ph < 3; ph++) {
+        buildTable(ph);
+    }
+}
+
+void SyntheticGrid::buildTable(int phase) {
+    // Амплитуда в отсчётах: V_rms / coeff = RMS в отсчётах, × √2 = пик
+    float amplitude = voltages[phase] / calibration[phase] * sqrtf(2.0f);
+    float shift = -2.0f * (float)M_PI / 3.0f * phase;
+    fillTable(table[phase], amplitude, shift);
+
+    // Ток фазы: та же фаза минус отставание нагрузки
+    float currentAmplitude = current / ctCalibration[phase] * sqrtf(2.0f);
+    fillTable(table[3 + phase], currentAmplitude, shift - lagDegrees * (float)M_PI / 180.0f);
+}
+
+void SyntheticGrid::fillTable(int16_t* values, float amplitude, float shift) {
+    for (uint32_t t = 0; t < periodUs; t++) {
+        float angle = 2.0f * (float)M_PI * t / periodUs + shift;
+        long value = lroundf(ADC_OFFSET + amplitude * sinf(angle));
+        if (value < 0) {
+            value = 0;
+        } else if (value > ADC_MAX_VALUE) {
+            value = ADC_MAX_VALUE;
+        }
+        values[t] = (int16_t)value;
+    }
+}
+
+int SyntheticGrid::read(int pin, uint32_t timeUs) {
+    int phase;
+    if (pin == PIN_PHASE_A) {
+        phase = 0;
+    } else if (pin == PIN_PHASE_B) {
+        phase = 1;
+    } else if (pin == PIN_PHASE_C) {
+        phase = 2;
+    } else if (pin == PIN_CURRENT_A) {
+        phase = 3;
+    } else if (pin == PIN_CURRENT_B) {
+        phase = 4;
+    } else if (pin == PIN_CURRENT_C) {
+        phase = 5;
+    } else {
+        return ADC_OFFSET;
+    }
+
+    int value = table[phase][timeUs % periodUs];
+    if (noiseCounts > 0) {
+        // xorshift32: дешёвый детерминированный шум
+        noiseState ^= noiseState << 13;
+        noiseState ^= noiseState >> 17;
+        noiseState ^= noiseState << 5;
+        value += (int)(noiseState % (2 * noiseCounts + 1)) - noiseCounts;
+    }
+
+    if (value < 0) {
+        return 0;
+    }
+    if (value > ADC_MAX_VALUE) {
+        return ADC_MAX_VALUE;
+    }
+    return value;
+}
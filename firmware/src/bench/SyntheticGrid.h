@@ -0,0 +1,54 @@
+#ifndef SYNTHETIC_GRID_H
+#define SYNTHETIC_GRID_H
+
+#include <stdint.h>
+#include "../hal/HalNative.h"
+
+/**
+ * Синтетическая трёхфазная сеть на входах PIN_PHASE_A/B/C и нагрузка
+ * на трансформаторах тока PIN_CURRENT_A/B/C
+ *
+ * Синусоида каждой фазы заранее табулирована на один период с шагом 1 мкс,
+ * чтобы в замерах участвовал конвейер измерений, а не sinf().
+ * Отсчёт = ADC_OFFSET + амплитуда (по CALIBRATION_COEFF_* / CT_CALIBRATION_*) + шум ±noise.
+ */
+class SyntheticGrid : public AdcSource {
+public:
+    /**
+     * @param voltage Фазное RMS напряжение, В
+     * @param frequency Частота сети, Гц
+     * @param noiseCounts Амплитуда равномерного шума в отсчётах АЦП
+     */
+    SyntheticGrid(float voltage, float frequency, int noiseCounts);
+    ~SyntheticGrid();
+
+    /**
+     * Задать напряжение отдельной фазы (для перекоса), перестраивает таблицу
+     * @param phase 0 = A, 1 = B, 2 = C
+     */
+    void setPhaseVoltage(int phase, float voltage);
+
+    /**
+     * Задать симметричную нагрузку, перестраивает таблицы токов
+     * @param amps RMS ток каждой фазы, А (0 — без нагрузки)
+     * @param lagDegrees Отставание тока от напряжения (> 0 — индуктивная, < 0 — ёмкостная)
+     */
+    void setLoad(float amps, float lagDegrees);
+
+    int read(int pin, uint32_t timeUs) override;
+
+private:
+    float voltages[3];
+    float current;
+    float lagDegrees;
+    float frequency;
+    int noiseCounts;
+    uint32_t periodUs;
+    int16_t* table[6];      // 0..2 — напряжения фаз, 3..5 — токи
+    uint32_t noiseState;
+
+    void buildTable(int phase);
+    void fillTable(int16_t* values, float amplitude, float shift);
+};
+
+#endif // SYNTHETIC_GRID_H
@@ -0,0 +1,521 @@
+#include "TlsCheck.h"
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include "../config.h"
+#include "../hal/Hal.h"
+#include "../hal/HalNative.h"
+#include "../HttpConnection.h"
+
+#define PIN_NAMESPACE "influx"
+#define PIN_KEY "pin"
+#define WRITE_PATH "/api/v2/write?org=" INFLUXDB_ORG "&bucket=" INFLUXDB_BUCKET "&precision=ms"
+#define WRITE_HEADERS "Content-Type: text/plain\r\nAuthorization: Token " INFLUXDB_TOKEN "\r\n"
+#define TIMEOUT_MS 2000
+
+// Записей подряд; заглушка закрывает соединение после CLOSE_AFTER ответов
+// (как keepalive_requests/keepalive_timeout у nginx перед InfluxDB)
+#define BATCH 20
+#define CLOSE_AFTER 5
+#define POINT_LINES 3
+
+// Внешний сервер: /ping по одному соединению и с переподключением
+#define URL_REQUESTS 5
+
+static const char points[] =
+    "voltage,device=" DEVICE_ID ",phase=A value=230.12\n"
+    "voltage,device=" DEVICE_ID ",phase=B value=229.87\n"
+    "frequency,device=" DEVICE_ID " value=50.003\n";
+
+static bool check(const char* name, bool ok, const char* detail) {
+    printf("%-44s %-8s %s\n", name, ok ? "ok" : "FAIL", detail);
+    return ok;
+}
+
+/**
+ * Ключ P-256 и самоподписанный сертификат заглушки; hash — SHA-256 SPKI
+ */
+struct ServerKey {
+    EVP_PKEY* key;
+    X509* certificate;
+    uint8_t hash[32];
+};
+
+static bool makeKey(ServerKey& out) {
+    out.key = EVP_EC_gen("P-256");
+    out.certificate = X509_new();
+    if (out.key == nullptr || out.certificate == nullptr) {
+        return false;
+    }
+    ASN1_INTEGER_set(X509_get_serialNumber(out.certificate), 1);
+    X509_gmtime_adj(X509_getm_notBefore(out.certificate), 0);
+    X509_gmtime_adj(X509_getm_notAfter(out.certificate), 86400);
+    X509_set_pubkey(out.certificate, out.key);
+    X509_NAME* name = X509_get_subject_name(out.certificate);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"influxdb-stand-in", -1, -1, 0);
+    X509_set_issuer_name(out.certificate, name);
+    if (X509_sign(out.certificate, out.key, EVP_sha256()) == 0) {
+        return false;
+    }
+    unsigned char* der = nullptr;
+    int length = i2d_PUBKEY(out.key, &der);
+    if (length <= 0) {
+        return false;
+    }
+    SHA256(der, (size_t)length, out.hash);
+    OPENSSL_free(der);
+    return true;
+}
+
+static void freeKey(ServerKey& key) {
+    X509_free(key.certificate);
+    EVP_PKEY_free(key.key);
+}
+
+/**
+ * Заглушка InfluxDB 2.x: одно соединение за раз, в своём потоке
+ */
+class StandIn {
+public:
+    std::atomic<uint32_t> connections;
+    std::atomic<uint32_t> fullHandshakes;
+    std::atomic<uint32_t> resumedHandshakes;
+    std::atomic<uint32_t> requests;
+    std::atomic<uint32_t> lines;
+
+    /**
+     * @param key nullptr — обычный HTTP
+     * @param tickets false — возобновление только по идентификатору сессии
+     */
+    StandIn(const ServerKey* key, bool tickets)
+        : connections(0), fullHandshakes(0), resumedHandshakes(0), requests(0), lines(0),
+          key(key), tickets(tickets), context(nullptr), listenFd(-1), port(0), closeAfter(0), stopping(false) {
+    }
+
+    ~StandIn() {
+        stop();
+    }
+
+    /**
+     * @param fixedPort 0 — любой свободный
+     */
+    bool start(uint16_t fixedPort) {
+        if (key != nullptr) {
+            context = SSL_CTX_new(TLS_server_method());
+            SSL_CTX_set_max_proto_version(context, TLS1_2_VERSION);
+            SSL_CTX_use_certificate(context, key->certificate);
+            SSL_CTX_use_PrivateKey(context, key->key);
+            SSL_CTX_set_session_id_context(context, (const unsigned char*)"influx", 6);
+            if (!tickets) {
+                SSL_CTX_set_options(context, SSL_OP_NO_TICKET);
+            }
+        }
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(fixedPort);
+        socklen_t length = sizeof(address);
+        if (bind(listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listenFd, 4) != 0 ||
+            getsockname(listenFd, (struct sockaddr*)&address, &length) != 0) {
+            return false;
+        }
+        port = ntohs(address.sin_port);
+        thread = std::thread(&StandIn::run, this);
+        return true;
+    }
+
+    void stop() {
+        stopping = true;
+        if (thread.joinable()) {
+            thread.join();
+        }
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            listenFd = -1;
+        }
+        if (context != nullptr) {
+            SSL_CTX_free(context);
+            context = nullptr;
+        }
+    }
+
+    uint16_t getPort() const {
+        return port;
+    }
+
+    /**
+     * Закрывать соединение после стольких ответов (0 — держать)
+     */
+    void setCloseAfter(int responses) {
+        closeAfter = responses;
+    }
+
+private:
+    const ServerKey* key;
+    bool tickets;
+    SSL_CTX* context;
+    int listenFd;
+    uint16_t port;
+    std::atomic<int> closeAfter;
+    std::atomic<bool> stopping;
+    std::thread thread;
+
+    void run() {
+        while (!stopping) {
+            struct pollfd waiting = {listenFd, POLLIN, 0};
+            if (poll(&waiting, 1, 20) != 1) {
+                continue;
+            }
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                connections++;
+                serve(fd);
+                ::close(fd);
+            }
+        }
+    }
+
+    int receive(int fd, SSL* ssl, char* buffer, size_t size) {
+        while (!stopping) {
+            if (ssl == nullptr || SSL_pending(ssl) == 0) {
+                struct pollfd waiting = {fd, POLLIN, 0};
+                if (poll(&waiting, 1, 20) == 0) {
+                    continue;
+                }
+            }
+            return ssl != nullptr ? SSL_read(ssl, buffer, (int)size) : (int)recv(fd, buffer, size, 0);
+        }
+        return -1;
+    }
+
+    void respond(int fd, SSL* ssl, const std::string& response) {
+        if (ssl != nullptr) {
+            SSL_write(ssl, response.data(), (int)response.size());
+        } else {
+            send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        }
+    }
+
+    /**
+     * Прочитать запрос: строка запроса с заголовками и тело по Content-Length
+     */
+    bool readRequest(int fd, SSL* ssl, std::string& pending, std::string& head, std::string& body) {
+        size_t headEnd;
+        char buffer[2048];
+        while ((headEnd = pending.find("\r\n\r\n")) == std::string::npos) {
+            int received = receive(fd, ssl, buffer, sizeof(buffer));
+            if (received <= 0) {
+                return false;
+            }
+            pending.append(buffer, (size_t)received);
+        }
+        head = pending.substr(0, headEnd + 2);
+        pending.erase(0, headEnd + 4);
+        size_t length = 0;
+        size_t field = head.find("\r\nContent-Length:");
+        if (field != std::string::npos) {
+            length = strtoul(head.c_str() + field + 17, nullptr, 10);
+        }
+        while (pending.size() < length) {
+            int received = receive(fd, ssl, buffer, sizeof(buffer));
+            if (received <= 0) {
+                return false;
+            }
+            pending.append(buffer, (size_t)received);
+        }
+        body = pending.substr(0, length);
+        pending.erase(0, length);
+        return true;
+    }
+
+    void serve(int fd) {
+        SSL* ssl = nullptr;
+        if (context != nullptr) {
+            ssl = SSL_new(context);
+            SSL_set_fd(ssl, fd);
+            if (SSL_accept(ssl) != 1) {
+                SSL_free(ssl);
+                ERR_clear_error();
+                return;
+            }
+            if (SSL_session_reused(ssl)) {
+                resumedHandshakes++;
+            } else {
+                fullHandshakes++;
+            }
+        }
+
+        std::string pending;
+        std::string head;
+        std::string body;
+        int served = 0;
+        while (!stopping && readRequest(fd, ssl, pending, head, body)) {
+            requests++;
+            if (head.compare(0, 10, "GET /ping ") == 0) {
+                respond(fd, ssl, "HTTP/1.1 204 No Content\r\nX-Influxdb-Version: stand-in\r\n\r\n");
+            } else if (head.compare(0, 19, "POST /api/v2/write?") == 0) {
+                if (head.find("\r\nAuthorization: Token " INFLUXDB_TOKEN "\r\n") == std::string::npos) {
+                    static const char error[] = "{\"code\":\"unauthorized\",\"message\":\"unauthorized access\"}";
+                    char response[256];
+                    snprintf(response, sizeof(response),
+                             "HTTP/1.1 401 Unauthorized\r\nContent-Type: application/json\r\n"
+                             "Content-Length: %u\r\n\r\n%s", (unsigned)strlen(error), error);
+                    respond(fd, ssl, response);
+                } else {
+                    for (char c : body) {
+                        lines += c == '\n' ? 1 : 0;
+                    }
+                    respond(fd, ssl, "HTTP/1.1 204 No Content\r\n\r\n");
+                }
+            } else if (head.compare(0, 13, "GET /chunked ") == 0) {
+                respond(fd, ssl, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked\r\n\r\n"
+                                 "6\r\n{\"ok\":\r\n5\r\ntrue}\r\n0\r\n\r\n");
+            } else {
+                respond(fd, ssl, "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n\r\nnot found");
+            }
+            served++;
+            if (closeAfter > 0 && served >= closeAfter) {
+                break;
+            }
+        }
+        if (ssl != nullptr) {
+            SSL_shutdown(ssl);
+            SSL_free(ssl);
+            ERR_clear_error();
+        }
+    }
+};
+
+/**
+ * Записей подряд, из них с ответом 204
+ */
+static int writeBatch(HttpConnection& connection, int count) {
+    int accepted = 0;
+    for (int i = 0; i < count; i++) {
+        if (connection.request("POST", WRITE_PATH, WRITE_HEADERS, points, sizeof(points) - 1) == 204) {
+            accepted++;
+        }
+    }
+    return accepted;
+}
+
+static bool storedPinIs(const uint8_t* hash) {
+    uint8_t stored[32];
+    return Hal::storageRead(PIN_NAMESPACE, PIN_KEY, stored, sizeof(stored)) &&
+           memcmp(stored, hash, sizeof(stored)) == 0;
+}
+
+static void formatUrl(char* url, size_t size, bool tls, uint16_t port) {
+    snprintf(url, size, "%s://127.0.0.1:%u", tls ? "https" : "http", port);
+}
+
+static int runStandIn() {
+    printf("TLS check: InfluxDB stand-in on 127.0.0.1, TLS 1.2 with P-256 keys\n\n");
+    ServerKey key;
+    ServerKey rotated;
+    if (!makeKey(key) || !makeKey(rotated)) {
+        printf("cannot generate server keys\n");
+        return 1;
+    }
+    NativeHal::storageReset();
+
+    bool pass = true;
+    char url[48];
+    char detail[160];
+    StandIn server(&key, true);
+    if (!server.start(0)) {
+        printf("cannot listen on 127.0.0.1\n");
+        return 1;
+    }
+    formatUrl(url, sizeof(url), true, server.getPort());
+    HttpConnection connection;
+    connection.begin(url, TIMEOUT_MS);
+    connection.usePinStorage(PIN_NAMESPACE, PIN_KEY, true);
+    connection.setIdleTimeout(INFLUXDB_KEEPALIVE_IDLE_MS);
+
+    // Одно соединение на все записи, ключ запоминается при первом подключении
+    int accepted = writeBatch(connection, BATCH);
+    const HttpConnectionStats& stats = connection.getStats();
+    snprintf(detail, sizeof(detail), "%d of %d accepted, %lu connection, %lu reused, %lu lines at the server",
+             accepted, BATCH, (unsigned long)stats.connects, (unsigned long)stats.reusedRequests,
+             (unsigned long)server.lines.load());
+    pass = check("writes over one kept-alive connection", accepted == BATCH && stats.connects == 1 &&
+                 stats.fullHandshakes == 1 && stats.reusedRequests == BATCH - 1 &&
+                 server.lines == BATCH * POINT_LINES, detail) && pass;
+    pass = check("server key pinned on first use", storedPinIs(key.hash), "SHA-256 of the SPKI in NVS") && pass;
+
+    // Сервер закрывает соединения: новые — по тикету, без полного рукопожатия
+    HttpConnectionStats before = stats;
+    uint32_t linesBefore = server.lines;
+    server.setCloseAfter(CLOSE_AFTER);
+    accepted = writeBatch(connection, BATCH);
+    uint32_t reconnects = stats.connects - before.connects;
+    uint32_t resumed = stats.resumedHandshakes - before.resumedHandshakes;
+    snprintf(detail, sizeof(detail), "%d of %d accepted, %lu reconnects, %lu resumed, %lu stale retries",
+             accepted, BATCH, (unsigned long)reconnects, (unsigned long)resumed,
+             (unsigned long)(stats.staleRetries - before.staleRetries));
+    pass = check("closed by server: resumed by ticket", accepted == BATCH && reconnects >= BATCH / CLOSE_AFTER - 1 &&
+                 resumed == reconnects && stats.fullHandshakes == before.fullHandshakes &&
+                 stats.staleRetries - before.staleRetries == reconnects &&
+                 server.lines - linesBefore == BATCH * POINT_LINES, detail) && pass;
+
+    // Простой дольше INFLUXDB_KEEPALIVE_IDLE_MS: новое соединение без попытки по старому
+    server.setCloseAfter(0);
+    writeBatch(connection, 1);
+    before = stats;
+    NativeHal::advanceUs((INFLUXDB_KEEPALIVE_IDLE_MS + 1000) * 1000u);
+    accepted = writeBatch(connection, 1);
+    snprintf(detail, sizeof(detail), "reconnected %s, reused %lu", stats.resumedHandshakes > before.resumedHandshakes ?
+             "resumed" : "full", (unsigned long)(stats.reusedRequests - before.reusedRequests));
+    pass = check("idle connection reopened", accepted == 1 && stats.connects == before.connects + 1 &&
+                 stats.resumedHandshakes == before.resumedHandshakes + 1 &&
+                 stats.reusedRequests == before.reusedRequests, detail) && pass;
+
+    // Ответ с телом и chunked не рвут соединение
+    before = stats;
+    int unauthorized = connection.request("POST", WRITE_PATH, "Content-Type: text/plain\r\n", points,
+                                          sizeof(points) - 1);
+    bool errorBody = strstr(connection.getLastBody(), "unauthorized") != nullptr;
+    int chunked = connection.request("GET", "/chunked", nullptr, nullptr, 0);
+    bool chunkedBody = strcmp(connection.getLastBody(), "{\"ok\":true}") == 0;
+    snprintf(detail, sizeof(detail), "%d with body, %d chunked \"%s\", %lu new connections", unauthorized, chunked,
+             connection.getLastBody(), (unsigned long)(stats.connects - before.connects));
+    pass = check("error and chunked bodies, same connection", unauthorized == 401 && errorBody &&
+                 chunked == 200 && chunkedBody && stats.connects == before.connects, detail) && pass;
+
+    // Сервер с другим ключом на том же адресе: тикет не принят, ключ не совпал — запрос не уходит
+    uint16_t port = server.getPort();
+    server.stop();
+    StandIn impostor(&rotated, true);
+    bool started = impostor.start(port);
+    before = stats;
+    int refused = writeBatch(connection, 2);
+    int code = connection.request("GET", "/ping", nullptr, nullptr, 0);
+    snprintf(detail, sizeof(detail), "%d accepted, last %d, %lu pin failures, %lu requests reached the server",
+             refused, code, (unsigned long)(stats.pinFailures - before.pinFailures),
+             (unsigned long)impostor.requests.load());
+    pass = check("rotated server key rejected", started && refused == 0 && code == HttpConnection::ERROR_PIN &&
+                 stats.pinFailures - before.pinFailures == 3 && impostor.requests == 0, detail) && pass;
+    connection.setPin(rotated.hash);
+    accepted = writeBatch(connection, 1);
+    pass = check("new pin accepted and stored", accepted == 1 && storedPinIs(rotated.hash), "") && pass;
+    impostor.stop();
+
+    // Сервер без тикетов: возобновление по идентификатору сессии
+    StandIn sessionIds(&rotated, false);
+    sessionIds.start(0);
+    sessionIds.setCloseAfter(CLOSE_AFTER);
+    formatUrl(url, sizeof(url), true, sessionIds.getPort());
+    HttpConnection idConnection;
+    idConnection.begin(url, TIMEOUT_MS);
+    idConnection.usePinStorage(PIN_NAMESPACE, PIN_KEY, true);
+    accepted = writeBatch(idConnection, BATCH);
+    const HttpConnectionStats& idStats = idConnection.getStats();
+    snprintf(detail, sizeof(detail), "%d of %d accepted, %lu full, %lu resumed (server: %lu / %lu)", accepted, BATCH,
+             (unsigned long)idStats.fullHandshakes, (unsigned long)idStats.resumedHandshakes,
+             (unsigned long)sessionIds.fullHandshakes.load(), (unsigned long)sessionIds.resumedHandshakes.load());
+    pass = check("resumed by session ID", accepted == BATCH && idStats.fullHandshakes == 1 &&
+                 idStats.resumedHandshakes >= BATCH / CLOSE_AFTER - 1 &&
+                 sessionIds.resumedHandshakes == idStats.resumedHandshakes, detail) && pass;
+    sessionIds.stop();
+
+    // Обычный HTTP: то же постоянное соединение, без рукопожатий
+    StandIn plain(nullptr, true);
+    plain.start(0);
+    formatUrl(url, sizeof(url), false, plain.getPort());
+    HttpConnection plainConnection;
+    plainConnection.begin(url, TIMEOUT_MS);
+    accepted = writeBatch(plainConnection, BATCH);
+    const HttpConnectionStats& plainStats = plainConnection.getStats();
+    snprintf(detail, sizeof(detail), "%d of %d accepted, %lu connection, %lu reused", accepted, BATCH,
+             (unsigned long)plainStats.connects, (unsigned long)plainStats.reusedRequests);
+    pass = check("plain http keep-alive", accepted == BATCH && plainStats.connects == 1 &&
+                 plainStats.reusedRequests == BATCH - 1 && plainStats.fullHandshakes == 0, detail) && pass;
+    plain.stop();
+
+    // Цена рукопожатий (реальные часы хоста; на ESP32 — в статусе и /metrics)
+    uint32_t fullUs = connection.getAverageHandshakeUs(false);
+    uint32_t resumedUs = connection.getAverageHandshakeUs(true);
+    snprintf(detail, sizeof(detail), "full %lu us (%lu), resumed %lu us (%lu), resume rate %.0f %%",
+             (unsigned long)fullUs, (unsigned long)stats.fullHandshakes, (unsigned long)resumedUs,
+             (unsigned long)stats.resumedHandshakes, connection.getResumeRate() * 100.0f);
+    pass = check("resumed handshake cheaper than full", resumedUs > 0 && resumedUs < fullUs, detail) && pass;
+
+    freeKey(key);
+    freeKey(rotated);
+    printf("\n%s\n", pass ? "TLS check passed" : "TLS check FAILED");
+    return pass ? 0 : 1;
+}
+
+static int runUrl(const char* url) {
+    printf("TLS check: %s\n\n", url);
+    NativeHal::storageReset();
+    HttpConnection connection;
+    if (!connection.begin(url, HTTP_TIMEOUT_MS)) {
+        printf("%s\n", connection.getLastError());
+        return 1;
+    }
+    connection.usePinStorage(PIN_NAMESPACE, PIN_KEY, true);
+
+    bool pass = true;
+    char detail[160];
+    int answered = 0;
+    for (int i = 0; i < URL_REQUESTS; i++) {
+        answered += connection.request("GET", "/ping", nullptr, nullptr, 0) > 0 ? 1 : 0;
+    }
+    const HttpConnectionStats& stats = connection.getStats();
+    snprintf(detail, sizeof(detail), "%d of %d answered, %lu connections, %lu reused%s%s", answered, URL_REQUESTS,
+             (unsigned long)stats.connects, (unsigned long)stats.reusedRequests,
+             answered < URL_REQUESTS ? ": " : "", answered < URL_REQUESTS ? connection.getLastError() : "");
+    pass = check("/ping over one connection", answered == URL_REQUESTS, detail) && pass;
+
+    answered = 0;
+    for (int i = 0; i < URL_REQUESTS; i++) {
+        connection.close();
+        answered += connection.request("GET", "/ping", nullptr, nullptr, 0) > 0 ? 1 : 0;
+    }
+    if (connection.isSecure()) {
+        snprintf(detail, sizeof(detail), "%d of %d answered, full %lu us (%lu), resumed %lu us (%lu), rate %.0f %%",
+                 answered, URL_REQUESTS, (unsigned long)connection.getAverageHandshakeUs(false),
+                 (unsigned long)stats.fullHandshakes, (unsigned long)connection.getAverageHandshakeUs(true),
+                 (unsigned long)stats.resumedHandshakes, connection.getResumeRate() * 100.0f);
+        pass = check("/ping with a reconnect each time", answered == URL_REQUESTS &&
+                     stats.resumedHandshakes == URL_REQUESTS, detail) && pass;
+        uint8_t pin[32];
+        if (connection.getPin(pin)) {
+            printf("\nserver key sha256: ");
+            for (size_t i = 0; i < sizeof(pin); i++) {
+                printf("%02x", pin[i]);
+            }
+            printf("\n");
+        }
+    } else {
+        snprintf(detail, sizeof(detail), "%d of %d answered", answered, URL_REQUESTS);
+        pass = check("/ping with a reconnect each time", answered == URL_REQUESTS, detail) && pass;
+    }
+
+    printf("\n%s\n", pass ? "TLS check passed" : "TLS check FAILED");
+    return pass ? 0 : 1;
+}
+
+int runTlsCheck(const char* url) {
+    NativeHal::setLogEnabled(false);
+    return url != nullptr ? runUrl(url) : runStandIn();
+}
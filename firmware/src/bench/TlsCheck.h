@@ -0,0 +1,24 @@
+#ifndef TLS_CHECK_H
+#define TLS_CHECK_H
+
+/**
+ * Проверка HTTPS к InfluxDB (HttpConnection, TlsSocket)
+ *
+ * Без URL в процессе поднимается заглушка InfluxDB за TLS (OpenSSL, ключ
+ * P-256 с самоподписанным сертификатом): /ping, /api/v2/write с проверкой
+ * токена, ответ chunked. Проверяются: запись по одному соединению,
+ * отпечаток ключа при первом подключении (в NVS NativeHal), возобновление
+ * по тикету и по идентификатору сессии после закрытия соединения сервером,
+ * переподключение после простоя, отказ при смене ключа сервера без нового
+ * отпечатка, обычный http://. Печатаются времена полного и возобновлённого
+ * рукопожатий и доля возобновлений.
+ *
+ * С URL (https://host:port, например stunnel перед настоящим InfluxDB) —
+ * /ping по одному соединению и с переподключением каждый раз: времена
+ * рукопожатий, доля возобновлений и отпечаток ключа для /influx/pin.
+ * @param url nullptr — встроенная заглушка
+ * @return Код выхода процесса (1 — проверка не прошла)
+ */
+int runTlsCheck(const char* url);
+
+#endif // TLS_CHECK_H
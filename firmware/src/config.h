@@ -5,7 +5,29 @@
 // =============================================================================
 #define WIFI_SSID "Labofix2"
 #define WIFI_PASSWORD "labofix123"
-#define WIFI_CONNECT_TIMEOUT_SEC 30
+#define WIFI_CONNECT_TIMEOUT_SEC 30     // One full-scan attempt, then retried (never restarts the chip)
+
+// Fast connect: after a successful connect the AP's BSSID and channel (and,
+// with WIFI_REUSE_LEASE, the DHCP lease) are cached in NVS. The next boot
+// joins that AP directly - no scan, no DHCP exchange. If it does not come up
+// within WIFI_FAST_CONNECT_TIMEOUT_MS a normal scan + DHCP connect follows;
+// the two alternate until one succeeds (the router may still be booting after
+// the same outage). NVS is rewritten only when the AP or lease changes.
+// Reusing the lease skips DHCP renewal: reserve the address on the router.
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000
+#define WIFI_REUSE_LEASE 1
+
+// =============================================================================
+// Boot (boot measurement, InfluxDB transport)
+// Acquisition starts before the network: WiFi, NTP and the InfluxDB check run
+// in the background while measurements go to the on-device history. Once NTP
+// and the first upload are done, the seconds measured before it are uploaded
+// from the history with their own timestamps, followed by one boot point with
+// time-to-first-sample / WiFi / NTP / InfluxDB / first upload (ms since boot).
+// =============================================================================
+#define BOOT_SERIAL_WAIT_MS 0               // Wait this long for a USB serial monitor (boot log vs. first seconds)
+#define BOOT_BACKFILL_CHUNK_S 10            // History seconds per InfluxDB request
+#define BOOT_LINE_PROTOCOL_SIZE 5120        // Backfill chunk (5 points per second, DEVICE_ID up to 32 chars) or the boot point
 
 // =============================================================================
 // InfluxDB Configuration
@@ -15,6 +37,55 @@
 #define INFLUXDB_BUCKET "power_monitoring"
 #define INFLUXDB_TOKEN "c0EAjvlt2hvtT9V3a54AZi-wzkFDxFHpvORtIR7aW5olE9Z-2_vtBqp-uds3i-bdcXXL1xz4Iz_sPR0NZWslNQ=="
 
+// =============================================================================
+// InfluxDB over HTTPS
+// An https:// INFLUXDB_URL switches the writes to TLS 1.2. The connection is
+// kept open between writes; a closed one is reopened offering the saved TLS
+// session (ticket or session ID), so the full ECDHE handshake happens once
+// per server session lifetime instead of once per write.
+// The server is identified by the SHA-256 of its public key (SPKI), in NVS:
+//   openssl s_client -connect <host>:8086 </dev/null | openssl x509 -pubkey -noout |
+//     openssl pkey -pubin -outform der | sha256sum
+//   curl -X POST "http://<device>/influx/pin?secret=<INFLUXDB_PIN_SECRET>&sha256=<64 hex digits>"
+//     (&clear=1 instead of sha256 to unpin)
+// The endpoint changes who the InfluxDB token is sent to, so it requires
+// INFLUXDB_PIN_SECRET; with "" it is disabled and the pin is only set on first
+// use or by reflashing with an erased NVS.
+// =============================================================================
+#define INFLUXDB_TLS_TRUST_FIRST_KEY 1      // No pin stored: pin the first server key seen (trust on first use)
+#define INFLUXDB_PIN_SECRET ""              // Shared secret for POST /influx/pin; "" = endpoint disabled
+#define INFLUXDB_KEEPALIVE_IDLE_MS 30000    // Reopen (resumed) instead of reusing a connection idle this long
+
+// =============================================================================
+// Uplink Transport
+// Build-time default; can be switched at run time (persisted in NVS):
+//   curl -X POST "http://<device>/uplink?transport=influx|mqtt|gateway"
+// =============================================================================
+#define UPLINK_INFLUX 0             // HTTP POST, InfluxDB Line Protocol
+#define UPLINK_MQTT 1               // Persistent MQTT, binary records, QoS 1
+#define UPLINK_GATEWAY 2            // UDP binary frames to the fleet gateway (gateway/)
+#define UPLINK_TRANSPORT UPLINK_INFLUX
+
+// =============================================================================
+// MQTT Configuration
+// Topics: <prefix>/<device>/data|event|waveform|status
+// =============================================================================
+#define MQTT_HOST "192.168.1.216"
+#define MQTT_PORT 1883
+#define MQTT_USER ""
+#define MQTT_PASSWORD ""
+#define MQTT_TOPIC_PREFIX "power"
+#define MQTT_INFLIGHT_WINDOW 8          // Max unacknowledged QoS 1 messages
+#define MQTT_ACK_TIMEOUT_MS 10000       // Un-acked message is counted as lost
+#define MQTT_RECONNECT_INTERVAL_MS 5000
+#define MQTT_KEEPALIVE_SEC 15
+
+// =============================================================================
+// Fleet Gateway Configuration (UPLINK_GATEWAY)
+// =============================================================================
+#define GATEWAY_HOST "192.168.1.216"
+#define GATEWAY_PORT 8094
+
 // =============================================================================
 // Device Configuration
 // =============================================================================
@@ -27,6 +98,11 @@
 #define PIN_PHASE_B 2   // GPIO2 - ADC1_CH1
 #define PIN_PHASE_C 3   // GPIO3 - ADC1_CH2
 
+// Current transformers (SCT-013, voltage output, biased to VCC/2 like ZMPT101B)
+#define PIN_CURRENT_A 4 // GPIO4 - ADC1_CH3
+#define PIN_CURRENT_B 5 // GPIO5 - ADC1_CH4
+#define PIN_CURRENT_C 6 // GPIO6 - ADC1_CH5
+
 // Status LED (built-in on ESP32-S3-DevKitC)
 #define PIN_LED 48
 
@@ -40,6 +116,22 @@
 #define CALIBRATION_COEFF_B 0.23    // Calibration coefficient for Phase B
 #define CALIBRATION_COEFF_C 0.23    // Calibration coefficient for Phase C
 
+// Current: I_actual = ADC_RMS * CT_CALIBRATION (A per count).
+// SCT-013-030 (30 A / 1 V): 30 * 3.3 / 4095 ≈ 0.0242
+#define CT_CALIBRATION_A 0.0242f
+#define CT_CALIBRATION_B 0.0242f
+#define CT_CALIBRATION_C 0.0242f
+#define CT_NOISE_FLOOR_A 0.05f      // Current below this reads as 0 A (no load)
+
+// CT phase compensation, degrees at NOMINAL_FREQUENCY. Positive when the
+// current sample is ahead of the voltage sample: CT phase lead (typically
+// 1-4 degrees for SCT-013) plus the scan skew of the current channel read
+// after all voltage channels in a frame. Calibrate with a resistive load
+// until the power factor reads 1.000.
+#define CT_PHASE_CORRECTION_A 2.0f
+#define CT_PHASE_CORRECTION_B 2.0f
+#define CT_PHASE_CORRECTION_C 2.0f
+
 // =============================================================================
 // Grid Parameters
 // =============================================================================
@@ -57,6 +149,46 @@
 #define SAMPLES_PER_READING 2000    // Number of ADC samples for one RMS calculation
 #define SAMPLE_INTERVAL_US 100      // Microseconds between samples (10kHz = 100us)
 #define READINGS_PER_SECOND 1       // How often to calculate and send data
+#define MEASUREMENT_WINDOW_MS 200   // One analysis window (10 cycles at 50 Hz)
+
+// ADC oversampling front end. Each analyzer frame is built from
+// OVERSAMPLE_FACTOR sub-frames read at SAMPLE_INTERVAL_US / OVERSAMPLE_FACTOR
+// and decimated by a linear-phase FIR (Q15, unity DC gain, centred on the
+// frame time, OVERSAMPLE_FACTOR * OVERSAMPLE_TAPS_PER_PHASE - 1 taps). White
+// ADC noise drops by the filter's noise gain (about +0.5 bit per doubling) and
+// content above the output Nyquist no longer aliases into the band. Frames
+// keep OVERSAMPLE_FRACTION_BITS below the ADC LSB (counts << bits in int16),
+// so the filtered noise is not rounded back to whole counts; offsets and volts
+// per count are in frame units, captures record ADC_RESOLUTION + bits.
+// 1 = off (one read per channel per frame). Reads are polled: with the factor
+// too high for the ADC, frames run late - check "late frames" and the front end
+// load in the status output before raising it.
+#define OVERSAMPLE_FACTOR 1
+#define OVERSAMPLE_TAPS_PER_PHASE 12
+#define OVERSAMPLE_FRACTION_BITS 3  // Sub-LSB bits in frames when oversampling (0..3)
+
+// =============================================================================
+// Analyzer Build Configuration (PowerAnalyzer template parameters)
+// The first channels measure voltage as the topology defines; any channels
+// beyond those are CT currents, paired in order with the voltage channels
+// (current 1 with voltage 1, ...) for active/reactive power and energy.
+// One entry per channel below. With CTs on all three phases of a wye board:
+//   #define ANALYZER_CHANNELS 6
+//   #define ANALYZER_CHANNEL_PINS {PIN_PHASE_A, PIN_PHASE_B, PIN_PHASE_C,
+//                                  PIN_CURRENT_A, PIN_CURRENT_B, PIN_CURRENT_C}
+//   #define ANALYZER_CHANNEL_CALIBRATION {CALIBRATION_COEFF_A, CALIBRATION_COEFF_B, CALIBRATION_COEFF_C,
+//                                         CT_CALIBRATION_A, CT_CALIBRATION_B, CT_CALIBRATION_C}
+// =============================================================================
+#define TOPOLOGY_SINGLE_PHASE 0     // 1 voltage channel: L-N
+#define TOPOLOGY_SPLIT_PHASE 1      // 2 voltage channels: L1-N, L2-N (180 degrees apart)
+#define TOPOLOGY_WYE 2              // 3 voltage channels: A-N, B-N, C-N
+#define TOPOLOGY_DELTA 3            // 3 voltage channels: A-B, B-C, C-A (no neutral)
+
+#define ANALYZER_TOPOLOGY TOPOLOGY_WYE
+#define ANALYZER_CHANNELS 3
+#define ANALYZER_SAMPLE_RATE_HZ (1000000 / SAMPLE_INTERVAL_US)
+#define ANALYZER_CHANNEL_PINS {PIN_PHASE_A, PIN_PHASE_B, PIN_PHASE_C}
+#define ANALYZER_CHANNEL_CALIBRATION {CALIBRATION_COEFF_A, CALIBRATION_COEFF_B, CALIBRATION_COEFF_C}
 
 // =============================================================================
 // ADC Configuration
@@ -71,3 +203,248 @@
 // =============================================================================
 #define SEND_INTERVAL_MS 1000       // How often to send data (1 second)
 #define HTTP_TIMEOUT_MS 5000        // HTTP request timeout
+#define ENERGY_MAX_GAP_MS 5000      // Longer gaps between measurements are not counted as energy
+
+// =============================================================================
+// Report-by-Exception (deadband) for scalar telemetry
+// A value is sent only when it moves beyond its threshold since the last sent
+// value, or when its heartbeat expires. Problem-flag changes are sent at once.
+// Keep the heartbeat below the 5 min range of the Grafana "last()" panels.
+// =============================================================================
+#define DEADBAND_ENABLED 1
+#define DEADBAND_HEARTBEAT_MS 60000         // Resend unchanged values this often
+#define DEADBAND_VOLTAGE_PCT 0.25f          // Phase voltage, % of last sent (~0.55 V @ 220 V)
+#define DEADBAND_LINE_VOLTAGE_PCT 0.25f     // Line voltage, % of last sent
+#define DEADBAND_FREQUENCY_HZ 0.02f         // Frequency, absolute
+#define DEADBAND_UNBALANCE_PCT 0.1f         // Unbalance, absolute (percentage points)
+#define DEADBAND_POWER_W 5.0f               // Total active power, absolute (sends all power lines)
+#define DEADBAND_ENERGY_KWH 0.01f           // Net energy counter, absolute (10 Wh)
+
+// =============================================================================
+// Persistent accumulators (NVS): energy, event counters, boot count, uptime,
+// voltage min/max. Kept in RAM and checkpointed into PERSIST_SLOTS rotating
+// NVS records; the newest record with a valid CRC is restored at boot.
+// Loss on a power cut is whatever accumulated since the last checkpoint:
+// bench --persist-sim DAYS reports the write rate and the worst case.
+// =============================================================================
+#define PERSIST_NAMESPACE "accum"
+#define PERSIST_SLOTS 4
+#define PERSIST_MIN_INTERVAL_MS 60000       // Never write more often than this
+#define PERSIST_INTERVAL_MS 900000          // Write changed values at least every 15 min
+#define PERSIST_ENERGY_STEP_KWH 0.05f       // Write early after this much energy (import + export)
+
+// =============================================================================
+// Raw ADC Capture (LittleFS, replayed on the host: firmware/src/bench)
+//   curl -X POST "http://<device>/capture?blocks=60"   start (one block per measurement)
+//   curl -o capture.bin "http://<device>/capture.bin"  download
+// =============================================================================
+#define CAPTURE_PATH "/capture.bin"
+#define CAPTURE_MAX_BYTES (1024 * 1024)     // ~85 blocks of 3 x 2000 samples
+#define CAPTURE_DEFAULT_BLOCKS 60
+
+// =============================================================================
+// Deep Capture (PSRAM): seconds of gapless raw samples (inrush, motor starts)
+//   curl -X POST "http://<device>/deep?seconds=10"          start (POST /deep?stop=1 aborts)
+//   curl "http://<device>/deep"                             status, offsets, calibration (JSON)
+//   curl "http://<device>/deep/envelope?from=0&to=100000&points=1000"   min/max envelope
+//   curl -o deep.bin "http://<device>/deep/data"            full resolution (CaptureFormat.h)
+// A sampler task on DEEP_CAPTURE_CORE owns the ADC while recording; the
+// measurement loop analyzes the newest recorded block instead of sampling.
+// =============================================================================
+#define DEEP_CAPTURE_MAX_SECONDS 12         // PSRAM buffer: 12 s x 10 kHz x 3 ch x 2 B = 720 KB
+#define DEEP_CAPTURE_DEFAULT_SECONDS 10
+#define DEEP_CAPTURE_CORE 0                 // loop() runs on core 1
+#define DEEP_CAPTURE_PRIORITY 2             // Above idle, below WiFi / lwIP / async_tcp
+#define DEEP_ENVELOPE_BUCKET_FRAMES 16      // Level 0 of the min/max pyramid (1.6 ms @ 10 kHz)
+#define DEEP_ENVELOPE_FACTOR 4              // Each level merges this many buckets of the previous
+#define DEEP_ENVELOPE_LEVELS 8
+#define DEEP_ENVELOPE_MAX_POINTS 4096       // Buckets per /deep/envelope response
+
+// =============================================================================
+// Synchrophasors (PMU mode): IEEE C37.118.2-style frames over UDP
+//   curl -X POST "http://<device>/pmu?rate=50"    start (POST /pmu?stop=1 stops)
+//   curl "http://<device>/pmu"                    status, time quality, last phasors
+//   python3 tools/pmu_receiver.py --port 4713     decode and compare devices
+// A sampler task on PMU_CORE owns the ADC and estimates the fundamental
+// phasors frame by frame (2-3 nominal cycles, Hann window) at UTC-aligned
+// report times. Time comes from NTP, so angles between sites are good to
+// the NTP error (PMU_NTP_ERROR_US; 1 ms = 18 degrees at 50 Hz), which the
+// frames carry as time quality. The measurement loop analyzes the sampler's
+// blocks meanwhile, as during a deep capture.
+// =============================================================================
+#define PMU_IDCODE 1                        // C37.118 data stream ID of this device
+#define PMU_DEFAULT_RATE 50                 // Frames/s: 10, 25, 50 (50 Hz); 10..60 dividing 60 (60 Hz)
+#define PMU_UDP_HOST "192.168.1.216"        // Receiver (tools/pmu_receiver.py or a PDC)
+#define PMU_UDP_PORT 4713                   // C37.118 UDP default
+#define PMU_CONFIG_INTERVAL_S 60            // CFG-2 frame this often (spontaneous UDP has no requests)
+#define PMU_NTP_ERROR_US 1000               // Assumed UTC error right after an NTP sync (LAN server)
+#define PMU_CLOCK_DRIFT_PPM 20              // Crystal drift between syncs: time error grows by this
+#define PMU_CHANNEL_SKEW_US 0.0f            // ADC read time between consecutive channels of a frame
+#define PMU_CORE 0                          // loop() runs on core 1
+#define PMU_PRIORITY 2                      // Above idle, below WiFi / lwIP / async_tcp
+#define PMU_QUEUE_FRAMES 16                 // Frames waiting for the sender task
+
+// =============================================================================
+// Grid dynamics: per-cycle frequency and ROCOF (frequency_cycle and
+// rocof_event measurements, InfluxDB transport)
+// A sampler task on FREQSTREAM_CORE samples continuously whenever deep
+// capture and PMU mode are idle (they take the ADC over on request). Every
+// voltage channel's rising zero crossings (moving average, interpolated)
+// give one frequency per cycle; the mean over channels is resampled to
+// FREQSTREAM_RATE values/s, buffered and uploaded in batches. ROCOF is the
+// slope between the two halves of FREQSTREAM_ROCOF_WINDOW_MS.
+// =============================================================================
+#define FREQSTREAM_ENABLED 1
+#define FREQSTREAM_RATE 50                  // Values per second (must divide the sample rate)
+#define FREQSTREAM_FILTER_FRAMES 16         // Moving average before crossing detection (1.6 ms @ 10 kHz)
+#define FREQSTREAM_HYSTERESIS_COUNTS 40     // Re-arm a channel below offset minus this (ADC counts)
+#define FREQSTREAM_ROCOF_WINDOW_MS 500      // ROCOF measurement window (ENTSO-E: 500 ms)
+#define FREQSTREAM_ROCOF_THRESHOLD 0.5f     // Hz/s: |ROCOF| at or above starts a rocof_event
+#define FREQSTREAM_ROCOF_CLEAR_RATIO 0.5f   // Event ends below THRESHOLD x this ...
+#define FREQSTREAM_ROCOF_CLEAR_MS 1000      // ... for this long
+#define FREQSTREAM_BUFFER_SLOTS 512         // Values waiting for upload (~10 s, 16 B each)
+#define FREQSTREAM_BATCH_S 2                // Upload one batch this often
+#define FREQSTREAM_CORE 0                   // loop() runs on core 1
+#define FREQSTREAM_PRIORITY 2               // Above idle, below WiFi / lwIP / async_tcp
+
+// =============================================================================
+// Flight recorder (flight_record measurement, InfluxDB transport)
+// While the frequency stream samples, every nominal cycle appends one 12-byte
+// record (phase RMS, frequency) to a ring in RTC slow memory. That memory is
+// not initialized at boot, so the seconds before a brownout, watchdog or panic
+// reset survive and are uploaded once NTP and InfluxDB are up. A power-on
+// reset (supply gone long enough for RTC memory to decay) loses the ring.
+// =============================================================================
+#define FLIGHTREC_ENABLED 1
+#define FLIGHTREC_RECORDS 320               // Cycles kept (6.4 s @ 50 Hz, 12 B each)
+#define RETAINED_MEMORY_BYTES 4096          // RTC slow memory reserved (header + records)
+#define FLIGHTREC_UPLOAD_CHUNK 40           // Records per InfluxDB request after reboot
+
+// =============================================================================
+// EN 50160 compliance (power_quality, en50160 measurements; InfluxDB transport)
+// Clock-aligned 10-min values (RMS of the 1 s measurements) and 10-s frequency
+// means update weekly counters and fixed-bin histograms in RAM (~8 KB), so the
+// weekly verdict is one point lookup instead of a week-long Flux scan.
+// Weeks start on Monday 00:00 UTC. Needs NTP time: measurements before the
+// first sync and during interruptions (< PHASE_LOSS_THRESHOLD) are skipped.
+// =============================================================================
+#define COMPLIANCE_INTERVAL_S 600           // 10-min aggregation (voltage, unbalance, THD)
+#define COMPLIANCE_FREQUENCY_INTERVAL_S 10  // 10-s frequency values
+#define EN50160_VOLTAGE_BAND 10.0f          // 95 % of 10-min values within ±10 % of NOMINAL_VOLTAGE
+#define EN50160_VOLTAGE_LOW_LIMIT -15.0f    // 100 % within -15 % / +10 %
+#define EN50160_FREQUENCY_BAND 1.0f         // 99.5 % of 10-s values within ±1 % of NOMINAL_FREQUENCY
+#define EN50160_FREQUENCY_LOW_LIMIT -6.0f   // 100 % within -6 % / +4 %
+#define EN50160_FREQUENCY_HIGH_LIMIT 4.0f
+#define EN50160_UNBALANCE_LIMIT 2.0f        // 95 % of 10-min values, %
+#define EN50160_THD_LIMIT 8.0f              // 95 % of 10-min values, % (up to THD_MAX_HARMONIC)
+#define THD_MAX_HARMONIC 40                 // Goertzel per harmonic over whole cycles of the window
+
+// =============================================================================
+// Voltage distribution (voltage_histogram measurement, InfluxDB transport)
+// The continuous sampler cuts every frame into nominal cycles (all cycles are
+// counted; while deep capture or PMU holds the ADC, only the cycles of the
+// measured blocks); each cycle's RMS per phase lands in a fixed-width bucket.
+// One point per clock-aligned period carries the bucket counts as run-length
+// encoded strings, instead of one point per cycle.
+// Cycles below the range count in the first bucket, above it in the last.
+// Needs NTP time, like the compliance statistics.
+// =============================================================================
+#define VOLTAGE_HISTOGRAM_ENABLED 1
+#define VOLTAGE_HISTOGRAM_PERIOD_S 300      // One point per 5 min
+#define VOLTAGE_HISTOGRAM_LOW_V 180.0f      // Lower edge of the first bucket
+#define VOLTAGE_HISTOGRAM_BUCKET_V 1.0f     // Bucket width
+#define VOLTAGE_HISTOGRAM_BUCKETS 80        // 180..260 V
+
+// =============================================================================
+// On-device history (GET /history, JSON)
+// Fixed-memory rings of the 1 s measurements: one point per second for the
+// last HISTORY_SECONDS and per-minute aggregates (mean, min/max voltage) for
+// the last HISTORY_MINUTES. Allocated once at boot (~24 B per point), filled
+// with or without network, so the recent past stays visible when InfluxDB is
+// unreachable. Responses are streamed row by row straight from the rings.
+// =============================================================================
+#define HISTORY_ENABLED 1
+#define HISTORY_SECONDS 600                 // 1 s points: last 10 min
+#define HISTORY_MINUTES 1440                // 1 min points: last 24 h
+#define HISTORY_MAX_POINTS 1500             // Rows per response; coarser step beyond
+
+// =============================================================================
+// Streaming anomaly detection (anomaly measurement, InfluxDB transport)
+// Per metric (phase voltages, frequency): an hour-of-day baseline of EWMA
+// mean/variance, interpolated between hours so the normal daily curve is not
+// an anomaly. Residuals are averaged over ANOMALY_WINDOW_S measurements and fed
+// to a two-sided CUSUM (sustained shifts and drifts); single measurements
+// beyond ANOMALY_SPIKE_Z are spikes. Integer fixed point, ~0.8 KB per metric.
+// Baselines live in RAM: after a reboot each hour learns for ANOMALY_WARMUP
+// measurements before it may raise events (two days).
+// =============================================================================
+#define ANOMALY_ENABLED 1
+#define ANOMALY_SLOTS 24                    // Baselines per day (hour of day, UTC)
+#define ANOMALY_BASELINE_SHIFT 13           // EWMA weight 2^-13: ~2.3 days of one hour's measurements
+#define ANOMALY_WARMUP 7200                 // Measurements an hour's baseline needs before events (2 days)
+#define ANOMALY_WINDOW_S 60                 // Residual mean per CUSUM step (minute-scale wander averages out)
+#define ANOMALY_CUSUM_K 2.0f                // CUSUM slack, sigmas of the window mean
+#define ANOMALY_CUSUM_H 5.0f                // CUSUM alarm threshold, sigmas of the window mean
+#define ANOMALY_SPIKE_Z 6.0f                // Single measurement this far from baseline = spike
+#define ANOMALY_CLIP_Z 3.0f                 // Baseline learns from residuals clipped here
+#define ANOMALY_MIN_SIGMA_V 0.1f            // Noise floor of the voltage baselines
+#define ANOMALY_MIN_SIGMA_HZ 0.002f         // Noise floor of the frequency baseline
+
+// =============================================================================
+// Alerts (webhook and alert measurement)
+// Each rule raises when its value stays beyond "raise at" for "raise after" ms
+// and clears when it stays back past "clear at" (the hysteresis band) for
+// "clear after" ms; values inside the band hold the state. Voltage rules run
+// per phase. A phase below PHASE_LOSS_THRESHOLD (or with phase_loss active)
+// is reported by phase_loss only: its voltage rules and the unbalance rule
+// hold until it returns, frequency rules need one live phase.
+// Transitions are POSTed as JSON to ALERT_WEBHOOK_URL from their own task
+// right after the measurement (keep-alive, http:// or https://), in order,
+// retried with exponential backoff. The queue is bounded: when full, the new
+// notification is dropped (the receiver sees a gap in "seq").
+// Up to ALERT_MAX_RULES rules:
+//   {name, metric, direction, severity, raise at, clear at, raise after ms, clear after ms}
+// =============================================================================
+#define ALERT_RULES { \
+    {"phase_loss", ALERT_PHASE_LOSS, ALERT_BELOW, ALERT_CRITICAL, PHASE_LOSS_THRESHOLD, 150.0f, 0, 5000}, \
+    {"undervoltage", ALERT_PHASE_VOLTAGE, ALERT_BELOW, ALERT_WARNING, VOLTAGE_MIN, VOLTAGE_MIN + 4.0f, 3000, 10000}, \
+    {"overvoltage", ALERT_PHASE_VOLTAGE, ALERT_ABOVE, ALERT_WARNING, VOLTAGE_MAX, VOLTAGE_MAX - 4.0f, 3000, 10000}, \
+    {"overvoltage_critical", ALERT_PHASE_VOLTAGE, ALERT_ABOVE, ALERT_CRITICAL, NOMINAL_VOLTAGE * 1.2f, \
+     NOMINAL_VOLTAGE * 1.15f, 0, 10000}, \
+    {"unbalance", ALERT_UNBALANCE, ALERT_ABOVE, ALERT_WARNING, UNBALANCE_THRESHOLD, UNBALANCE_THRESHOLD - 1.0f, \
+     10000, 30000}, \
+    {"frequency_high", ALERT_FREQUENCY, ALERT_ABOVE, ALERT_WARNING, NOMINAL_FREQUENCY + FREQUENCY_DEVIATION_THRESHOLD, \
+     NOMINAL_FREQUENCY + FREQUENCY_DEVIATION_THRESHOLD - 0.1f, 2000, 10000}, \
+    {"frequency_low", ALERT_FREQUENCY, ALERT_BELOW, ALERT_WARNING, NOMINAL_FREQUENCY - FREQUENCY_DEVIATION_THRESHOLD, \
+     NOMINAL_FREQUENCY - FREQUENCY_DEVIATION_THRESHOLD + 0.1f, 2000, 10000}}
+#define ALERT_MAX_RULES 8
+#define ALERT_MAX_GAP_MS 5000               // Longer gap between measurements restarts the raise/clear timers
+#define ALERT_WEBHOOK_URL ""                // e.g. "https://hooks.example.net/power"; "" = no webhook
+#define ALERT_WEBHOOK_HEADERS ""            // Extra request headers, e.g. "Authorization: Bearer <token>\r\n"
+#define ALERT_WEBHOOK_TRUST_FIRST_KEY 0     // https: pin the first server key seen (NVS "alert"/"pin")
+#define ALERT_WEBHOOK_KEEPALIVE_IDLE_MS 30000
+#define ALERT_QUEUE_SIZE 16                 // Notifications waiting for delivery
+#define ALERT_RETRY_MS 1000                 // First retry after this, doubled per attempt
+#define ALERT_RETRY_MAX_MS 60000            // Backoff cap
+#define ALERT_MAX_ATTEMPTS 10               // Then the notification is dropped (~4 min of retries with the values above)
+
+// =============================================================================
+// Hot-path profiling (device_stats measurement)
+// Per-stage latency histograms (PROFILE_SCOPE in main.cpp), loop overruns,
+// late ADC samples and heap. Sent with the InfluxDB transport every
+// DEVICE_STATS_INTERVAL_MS; 0 compiles all of it out.
+// =============================================================================
+#define PROFILING_ENABLED 1
+#define DEVICE_STATS_INTERVAL_MS 60000      // Histograms cover one interval, then reset
+#define LOOP_OVERRUN_SLACK_MS 50            // Measurement started later than this = overrun
+#define SAMPLE_JITTER_THRESHOLD_US 20       // ADC frame later than this = late sample
+
+// =============================================================================
+// Web Server / Live Scope (WebSocket)
+// =============================================================================
+#define WEB_SERVER_PORT 80          // HTTP port for scope page and WebSocket
+#define SCOPE_WS_PATH "/ws"         // WebSocket endpoint for live frames
+#define SCOPE_FRAME_INTERVAL_MS 40  // Frame period: next trigger-aligned window of the block
+#define SCOPE_DECIMATION 2          // Keep every Nth waveform sample in a frame
+#define SCOPE_MAX_CLIENTS 4         // Max simultaneous scope viewers
+#define METRICS_PATH "/metrics"     // Prometheus text exposition endpoint
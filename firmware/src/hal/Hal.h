@@ -0,0 +1,115 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Причина последней перезагрузки
+ */
+enum class ResetReason : uint8_t {
+    POWER_ON,       // Включение питания: память RTC не сохранилась
+    BROWNOUT,       // Просадка питания ниже порога детектора
+    WATCHDOG,       // Сторожевые таймеры прерываний и задач
+    PANIC,          // Исключение или abort()
+    SOFTWARE,       // ESP.restart()
+    OTHER
+};
+
+/**
+ * Тонкий слой доступа к железу: АЦП, время, NVS, журнал
+ *
+ * Измерительный код (VoltageSensor, PowerAnalyzer, Oscilloscope) и сериализаторы
+ * обращаются к платформе только через этот класс. Реализация выбирается при сборке:
+ *   HalArduino.cpp — ESP32 (analogRead, micros, Serial)
+ *   HalNative.cpp  — Linux [env:native]: синтетический АЦП и виртуальные часы (HalNative.h)
+ */
+class Hal {
+public:
+    /**
+     * Настроить вывод как вход АЦП (ADC_RESOLUTION бит, полный диапазон 0-3.3 В)
+     */
+    static void adcBegin(int pin);
+
+    /**
+     * Прочитать отсчёт АЦП
+     */
+    static int adcRead(int pin);
+
+    /**
+     * Микросекунды с запуска (переполняется через ~71 минуту)
+     */
+    static uint32_t micros();
+
+    /**
+     * Миллисекунды с запуска
+     */
+    static uint32_t millis();
+
+    static void delayMs(uint32_t ms);
+    static void delayUs(uint32_t us);
+
+    /**
+     * Дождаться момента startUs + offsetUs (темп оцифровки).
+     * На ESP32 — активное ожидание, на хосте — сдвиг виртуальных часов.
+     * @return На сколько мкс момент был уже пропущен к вызову (0 — успели вовремя)
+     */
+    static uint32_t waitUntilUs(uint32_t startUs, uint32_t offsetUs);
+
+    /**
+     * Счётчик тактов для профилирования (на ESP32 — CCOUNT текущего ядра,
+     * на хосте — наносекунды монотонных часов). 32 бита: при 240 МГц
+     * переполняется за ~17 с, интервалы длиннее не измерять.
+     */
+    static uint32_t cycleCount();
+
+    /**
+     * Тактов счётчика cycleCount() в микросекунде
+     */
+    static uint32_t cyclesPerUs();
+
+    /**
+     * Свободная куча и её минимум с запуска, байт (на хосте — 0)
+     */
+    static uint32_t freeHeap();
+    static uint32_t minFreeHeap();
+
+    /**
+     * Выделить большой буфер во внешней памяти (на ESP32-S3 — PSRAM, на хосте — куча)
+     * @return nullptr если внешней памяти нет или не хватает
+     */
+    static void* allocExternal(size_t size);
+    static void freeExternal(void* data);
+
+    /**
+     * Прочитать запись энергонезависимого хранилища (на ESP32 — NVS через Preferences)
+     * @param ns Пространство имён (до 15 символов)
+     * @param key Ключ (до 15 символов)
+     * @return true если запись есть и её размер ровно size
+     */
+    static bool storageRead(const char* ns, const char* key, void* data, size_t size);
+
+    /**
+     * Записать запись энергонезависимого хранилища. Каждый вызов — стирание
+     * и запись во флеш: частоту вызовов ограничивает вызывающий (PersistentStats).
+     * @return true если записано size байт
+     */
+    static bool storageWrite(const char* ns, const char* key, const void* data, size_t size);
+
+    /**
+     * Память, которую перезагрузка не стирает (на ESP32 — RTC slow memory,
+     * RTC_NOINIT_ATTR). После включения питания содержимое не определено:
+     * проверяет вызывающий (FlightRecorder).
+     * @param size Размер, RETAINED_MEMORY_BYTES
+     */
+    static void* retainedMemory(size_t& size);
+
+    static ResetReason resetReason();
+
+    /**
+     * Строка журнала в формате printf (на ESP32 — Serial)
+     */
+    static void log(const char* format, ...) __attribute__((format(printf, 1, 2)));
+};
+
+#endif // HAL_H
@@ -0,0 +1,130 @@
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_attr.h>
+#include <esp_heap_caps.h>
+#include <esp_system.h>
+#include <stdarg.h>
+#include "Hal.h"
+#include "../config.h"
+
+// Вне .bss и без инициализации при загрузке: переживает всё, кроме включения питания
+RTC_NOINIT_ATTR static uint32_t retained[(RETAINED_MEMORY_BYTES + 3) / 4];
+
+void Hal::adcBegin(int pin) {
+    pinMode(pin, INPUT);
+    analogReadResolution(ADC_RESOLUTION);
+    analogSetAttenuation(ADC_11db);  // Full range 0-3.3V
+}
+
+int Hal::adcRead(int pin) {
+    return analogRead(pin);
+}
+
+uint32_t Hal::micros() {
+    return ::micros();
+}
+
+uint32_t Hal::millis() {
+    return ::millis();
+}
+
+void Hal::delayMs(uint32_t ms) {
+    delay(ms);
+}
+
+void Hal::delayUs(uint32_t us) {
+    delayMicroseconds(us);
+}
+
+uint32_t Hal::waitUntilUs(uint32_t startUs, uint32_t offsetUs) {
+    uint32_t elapsed = ::micros() - startUs;
+    if (elapsed >= offsetUs) {
+        return elapsed - offsetUs;
+    }
+    while (::micros() - startUs < offsetUs) {
+        // Busy wait for precise timing
+    }
+    return 0;
+}
+
+uint32_t Hal::cycleCount() {
+    return ESP.getCycleCount();
+}
+
+uint32_t Hal::cyclesPerUs() {
+    return getCpuFrequencyMhz();
+}
+
+uint32_t Hal::freeHeap() {
+    return ESP.getFreeHeap();
+}
+
+uint32_t Hal::minFreeHeap() {
+    return ESP.getMinFreeHeap();
+}
+
+void* Hal::allocExternal(size_t size) {
+    // Только PSRAM: большой буфер во внутренней RAM отнял бы память у WiFi и TCP
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+void Hal::freeExternal(void* data) {
+    heap_caps_free(data);
+}
+
+bool Hal::storageRead(const char* ns, const char* key, void* data, size_t size) {
+    Preferences prefs;
+    if (!prefs.begin(ns, true)) {
+        return false;  // Пространства ещё нет (первый запуск)
+    }
+    bool ok = prefs.getBytesLength(key) == size && prefs.getBytes(key, data, size) == size;
+    prefs.end();
+    return ok;
+}
+
+bool Hal::storageWrite(const char* ns, const char* key, const void* data, size_t size) {
+    Preferences prefs;
+    if (!prefs.begin(ns, false)) {
+        return false;
+    }
+    bool ok = prefs.putBytes(key, data, size) == size;
+    prefs.end();
+    return ok;
+}
+
+void* Hal::retainedMemory(size_t& size) {
+    size = sizeof(retained);
+    return retained;
+}
+
+ResetReason Hal::resetReason() {
+    switch (esp_reset_reason()) {
+        case ESP_RST_POWERON:
+            return ResetReason::POWER_ON;
+        case ESP_RST_BROWNOUT:
+            return ResetReason::BROWNOUT;
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+            return ResetReason::WATCHDOG;
+        case ESP_RST_PANIC:
+            return ResetReason::PANIC;
+        case ESP_RST_SW:
+            return ResetReason::SOFTWARE;
+        default:
+            return ResetReason::OTHER;
+    }
+}
+
+void Hal::log(const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    Serial.print(line);
+}
+
+#endif // ARDUINO
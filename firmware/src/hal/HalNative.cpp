@@ -0,0 +1,172 @@
+#ifndef ARDUINO
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include "Hal.h"
+#include "HalNative.h"
+#include "../config.h"
+
+static AdcSource* adcSource = nullptr;
+static bool logEnabled = true;
+static uint32_t virtualUs = 0;
+
+static std::map<std::string, std::vector<uint8_t>> storage;
+static uint32_t storageWrites = 0;
+static uint64_t storageBytes = 0;
+static bool tearNextWrite = false;
+
+static uint32_t retained[(RETAINED_MEMORY_BYTES + 3) / 4];
+static ResetReason lastResetReason = ResetReason::POWER_ON;
+
+void NativeHal::setAdcSource(AdcSource* source) {
+    adcSource = source;
+}
+
+void NativeHal::setLogEnabled(bool enabled) {
+    logEnabled = enabled;
+}
+
+void NativeHal::advanceUs(uint32_t us) {
+    virtualUs += us;
+}
+
+void NativeHal::storageReset() {
+    storage.clear();
+    storageWrites = 0;
+    storageBytes = 0;
+    tearNextWrite = false;
+}
+
+uint32_t NativeHal::storageWriteCount() {
+    return storageWrites;
+}
+
+uint64_t NativeHal::storageBytesWritten() {
+    return storageBytes;
+}
+
+void NativeHal::storageTearNextWrite() {
+    tearNextWrite = true;
+}
+
+void NativeHal::simulateReset(ResetReason reason) {
+    lastResetReason = reason;
+    if (reason == ResetReason::POWER_ON) {
+        uint32_t state = 0x9E3779B9u;
+        for (size_t i = 0; i < sizeof(retained) / sizeof(retained[0]); i++) {
+            state = state * 1664525u + 1013904223u;
+            retained[i] = state;
+        }
+    }
+}
+
+void Hal::adcBegin(int pin) {
+}
+
+int Hal::adcRead(int pin) {
+    if (adcSource == nullptr) {
+        return ADC_OFFSET;
+    }
+    return adcSource->read(pin, virtualUs);
+}
+
+uint32_t Hal::micros() {
+    return virtualUs;
+}
+
+uint32_t Hal::millis() {
+    return virtualUs / 1000;
+}
+
+void Hal::delayMs(uint32_t ms) {
+    virtualUs += ms * 1000;
+}
+
+void Hal::delayUs(uint32_t us) {
+    virtualUs += us;
+}
+
+uint32_t Hal::waitUntilUs(uint32_t startUs, uint32_t offsetUs) {
+    uint32_t elapsed = virtualUs - startUs;
+    if (elapsed >= offsetUs) {
+        return elapsed - offsetUs;
+    }
+    virtualUs = startUs + offsetUs;
+    return 0;
+}
+
+uint32_t Hal::cycleCount() {
+    // Настоящие часы хоста, а не виртуальные: профилируем время вычислений
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t Hal::cyclesPerUs() {
+    return 1000;
+}
+
+uint32_t Hal::freeHeap() {
+    return 0;
+}
+
+uint32_t Hal::minFreeHeap() {
+    return 0;
+}
+
+void* Hal::allocExternal(size_t size) {
+    return malloc(size);
+}
+
+void Hal::freeExternal(void* data) {
+    free(data);
+}
+
+bool Hal::storageRead(const char* ns, const char* key, void* data, size_t size) {
+    auto it = storage.find(std::string(ns) + "/" + key);
+    if (it == storage.end() || it->second.size() != size) {
+        return false;
+    }
+    memcpy(data, it->second.data(), size);
+    return true;
+}
+
+bool Hal::storageWrite(const char* ns, const char* key, const void* data, size_t size) {
+    std::vector<uint8_t>& entry = storage[std::string(ns) + "/" + key];
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    entry.assign(bytes, bytes + size);
+    if (tearNextWrite) {
+        // Вторая половина не дописана: стёртый флеш читается как 0xFF
+        memset(entry.data() + size / 2, 0xFF, size - size / 2);
+        tearNextWrite = false;
+    }
+    storageWrites++;
+    storageBytes += size;
+    return true;
+}
+
+void* Hal::retainedMemory(size_t& size) {
+    size = sizeof(retained);
+    return retained;
+}
+
+ResetReason Hal::resetReason() {
+    return lastResetReason;
+}
+
+void Hal::log(const char* format, ...) {
+    if (!logEnabled) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+#endif // !ARDUINO
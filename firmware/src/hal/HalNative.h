@@ -0,0 +1,70 @@
+#ifndef HAL_NATIVE_H
+#define HAL_NATIVE_H
+
+#include <stdint.h>
+#include "Hal.h"
+
+/**
+ * Источник отсчётов АЦП для сборки на хосте
+ */
+class AdcSource {
+public:
+    virtual ~AdcSource() {}
+
+    /**
+     * @param pin Вывод АЦП (PIN_PHASE_*)
+     * @param timeUs Виртуальное время отсчёта
+     * @return Отсчёт 0..ADC_MAX_VALUE
+     */
+    virtual int read(int pin, uint32_t timeUs) = 0;
+};
+
+/**
+ * Управление HAL на хосте ([env:native])
+ *
+ * Время виртуальное: оно идёт только через delayMs/delayUs/waitUntilUs, поэтому
+ * окно измерения в 200 мс проходит за время вычислений, а частота по
+ * переходам через ноль считается так же, как на устройстве.
+ */
+class NativeHal {
+public:
+    /**
+     * Подключить источник АЦП (nullptr — все входы читают ADC_OFFSET)
+     */
+    static void setAdcSource(AdcSource* source);
+
+    /**
+     * Включить/выключить вывод Hal::log в stdout
+     */
+    static void setLogEnabled(bool enabled);
+
+    /**
+     * Сдвинуть виртуальные часы
+     */
+    static void advanceUs(uint32_t us);
+
+    /**
+     * Хранилище (Hal::storage*) в памяти процесса: стереть всё и обнулить счётчики
+     */
+    static void storageReset();
+
+    /**
+     * Сколько раз и сколько байт записано с последнего storageReset()
+     */
+    static uint32_t storageWriteCount();
+    static uint64_t storageBytesWritten();
+
+    /**
+     * Оборвать следующую запись на половине (пропадание питания во время записи):
+     * запись остаётся в хранилище испорченной
+     */
+    static void storageTearNextWrite();
+
+    /**
+     * Перезагрузка для Hal::resetReason(). Память Hal::retainedMemory() остаётся,
+     * при POWER_ON заполняется мусором, как RTC-память после включения питания.
+     */
+    static void simulateReset(ResetReason reason);
+};
+
+#endif // HAL_NATIVE_H
@@ -0,0 +1,86 @@
+#ifndef TLS_SOCKET_H
+#define TLS_SOCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Клиентское TCP-соединение, по выбору поверх TLS 1.2, с возобновлением сессии
+ *
+ * После полного рукопожатия сокет запоминает сессию (тикет RFC 5077 или
+ * идентификатор сессии) и предлагает её при следующем connect(): сервер,
+ * принявший её, пропускает сертификат и обмен ключами (ECDHE + подпись —
+ * самая дорогая часть на ESP32). Сессия переживает close() и обрыв
+ * соединения; забывается forgetSession() и неудачным рукопожатием.
+ *
+ * Сертификат сервера здесь не проверяется цепочкой: вызывающий сверяет
+ * getPeerKeyHash() со своим отпечатком (HttpConnection). Возобновлённая
+ * сессия ключа не показывает — она выдана сервером, прошедшим сверку.
+ *
+ * Реализация выбирается при сборке:
+ *   TlsSocketArduino.cpp — ESP32: сокеты lwIP и mbedTLS из ESP-IDF
+ *   TlsSocketNative.cpp  — Linux [env:native]: сокеты POSIX и OpenSSL (не выше TLS 1.2, как mbedTLS)
+ * Не потокобезопасен: один экземпляр — одна задача.
+ */
+class TlsSocket {
+public:
+    TlsSocket();
+    ~TlsSocket();
+
+    /**
+     * Подключиться (открытое соединение сначала закрывается)
+     * @param tls false — обычный TCP
+     * @param timeoutMs Таймаут подключения и каждого чтения/записи
+     * @return false при ошибке (текст — getError())
+     */
+    bool connect(const char* host, uint16_t port, bool tls, uint32_t timeoutMs);
+
+    /**
+     * Записать всё
+     * @return false при ошибке или таймауте; соединение закрывается
+     */
+    bool write(const void* data, size_t length);
+
+    /**
+     * Прочитать, что пришло (ждёт не дольше таймаута)
+     * @return Байт; 0 — соединение закрыто сервером; -1 — ошибка или таймаут
+     */
+    int read(void* buffer, size_t size);
+
+    void close();
+    bool isOpen() const;
+
+    /**
+     * Последнее рукопожатие: с предложенной сессией / сервер её принял
+     */
+    bool wasSessionOffered() const;
+    bool wasResumed() const;
+
+    /**
+     * Длительность последнего рукопожатия TLS (без TCP), мкс реальных часов
+     */
+    uint32_t getHandshakeUs() const;
+
+    /**
+     * SHA-256 открытого ключа сервера (SubjectPublicKeyInfo в DER, как
+     * pin-sha256 в HPKP и `openssl pkey -pubin -outform der | sha256sum`)
+     * @return false если последнее рукопожатие было возобновлённым или без TLS
+     */
+    bool getPeerKeyHash(uint8_t hash[32]) const;
+
+    /**
+     * Забыть сессию: следующее рукопожатие будет полным
+     */
+    void forgetSession();
+
+    const char* getError() const;
+
+private:
+    struct Impl;
+    Impl* impl;
+
+    TlsSocket(const TlsSocket&);
+    TlsSocket& operator=(const TlsSocket&);
+};
+
+#endif // TLS_SOCKET_H
@@ -0,0 +1,337 @@
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <lwip/netdb.h>
+#include <lwip/sockets.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/error.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/version.h>
+#include "TlsSocket.h"
+
+// Поля контекста (state, pk_raw) открыты в mbedTLS 2.x: arduino-esp32 2.0.x / ESP-IDF 4.4
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+#error "TlsSocketArduino.cpp targets mbedTLS 2.x (arduino-esp32 2.0.x)"
+#endif
+
+#define ERROR_SIZE 96
+
+struct TlsSocket::Impl {
+    int fd;
+    bool tls;
+    bool configured;
+    bool sessionValid;
+    bool sessionOffered;
+    bool resumed;
+    uint32_t handshakeUs;
+    bool keyHashValid;
+    uint8_t keyHash[32];
+    char error[ERROR_SIZE];
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_ssl_config config;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_session session;
+};
+
+static void setError(char (&error)[ERROR_SIZE], const char* what, int code) {
+    if (code != 0) {
+        char reason[64];
+        mbedtls_strerror(code, reason, sizeof(reason));
+        snprintf(error, sizeof(error), "%s: -0x%04x %s", what, (unsigned)-code, reason);
+    } else {
+        snprintf(error, sizeof(error), "%s: errno %d", what, errno);
+    }
+}
+
+static int bioSend(void* context, const unsigned char* data, size_t length) {
+    int sent = lwip_send(*(int*)context, data, length, 0);
+    if (sent >= 0) {
+        return sent;
+    }
+    return errno == EAGAIN || errno == EWOULDBLOCK ? MBEDTLS_ERR_SSL_TIMEOUT : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+static int bioRecv(void* context, unsigned char* buffer, size_t size) {
+    int received = lwip_recv(*(int*)context, buffer, size, 0);
+    if (received >= 0) {
+        return received;
+    }
+    return errno == EAGAIN || errno == EWOULDBLOCK ? MBEDTLS_ERR_SSL_TIMEOUT : MBEDTLS_ERR_NET_RECV_FAILED;
+}
+
+/**
+ * TCP-подключение с таймаутом (неблокирующий connect + select)
+ */
+static int tcpConnect(char (&error)[ERROR_SIZE], const char* host, uint16_t port, uint32_t timeoutMs) {
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* address = nullptr;
+    if (lwip_getaddrinfo(host, service, &hints, &address) != 0 || address == nullptr) {
+        snprintf(error, sizeof(error), "cannot resolve %s", host);
+        return -1;
+    }
+
+    int fd = lwip_socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (fd < 0) {
+        lwip_freeaddrinfo(address);
+        setError(error, "socket", 0);
+        return -1;
+    }
+    int flags = lwip_fcntl(fd, F_GETFL, 0);
+    lwip_fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int result = lwip_connect(fd, address->ai_addr, address->ai_addrlen);
+    lwip_freeaddrinfo(address);
+    if (result < 0 && errno == EINPROGRESS) {
+        fd_set writable;
+        FD_ZERO(&writable);
+        FD_SET(fd, &writable);
+        struct timeval timeout;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_usec = (timeoutMs % 1000) * 1000;
+        int socketError = 0;
+        socklen_t length = sizeof(socketError);
+        if (lwip_select(fd + 1, nullptr, &writable, nullptr, &timeout) == 1 &&
+            lwip_getsockopt(fd, SOL_SOCKET, SO_ERROR, &socketError, &length) == 0) {
+            errno = socketError;
+            result = socketError == 0 ? 0 : -1;
+        } else {
+            errno = ETIMEDOUT;
+        }
+    }
+    if (result < 0) {
+        setError(error, "connect", 0);
+        lwip_close(fd);
+        return -1;
+    }
+    lwip_fcntl(fd, F_SETFL, flags);
+
+    // Заголовки и тело уходят отдельными записями: без задержки Нагла
+    int noDelay = 1;
+    lwip_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    struct timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    lwip_setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    lwip_setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+/**
+ * Генератор случайных чисел и конфигурация клиента — один раз на сокет
+ */
+static bool configure(mbedtls_entropy_context& entropy, mbedtls_ctr_drbg_context& drbg, mbedtls_ssl_config& config,
+                      char (&error)[ERROR_SIZE]) {
+    static const char personalization[] = "power-monitor";
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_ssl_config_init(&config);
+    int result = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy,
+                                       (const unsigned char*)personalization, sizeof(personalization) - 1);
+    if (result == 0) {
+        result = mbedtls_ssl_config_defaults(&config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                             MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+    if (result != 0) {
+        setError(error, "configure", result);
+        mbedtls_ssl_config_free(&config);
+        mbedtls_ctr_drbg_free(&drbg);
+        mbedtls_entropy_free(&entropy);
+        return false;
+    }
+    mbedtls_ssl_conf_authmode(&config, MBEDTLS_SSL_VERIFY_NONE);
+    mbedtls_ssl_conf_rng(&config, mbedtls_ctr_drbg_random, &drbg);
+    mbedtls_ssl_conf_session_tickets(&config, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    return true;
+}
+
+TlsSocket::TlsSocket()
+    : impl(new Impl()) {
+    impl->fd = -1;
+    impl->tls = false;
+    impl->configured = false;
+    impl->sessionValid = false;
+    impl->sessionOffered = false;
+    impl->resumed = false;
+    impl->handshakeUs = 0;
+    impl->keyHashValid = false;
+    impl->error[0] = '\0';
+    mbedtls_ssl_session_init(&impl->session);
+}
+
+TlsSocket::~TlsSocket() {
+    close();
+    forgetSession();
+    if (impl->configured) {
+        mbedtls_ssl_config_free(&impl->config);
+        mbedtls_ctr_drbg_free(&impl->drbg);
+        mbedtls_entropy_free(&impl->entropy);
+    }
+    delete impl;
+}
+
+bool TlsSocket::connect(const char* host, uint16_t port, bool tls, uint32_t timeoutMs) {
+    close();
+    impl->sessionOffered = false;
+    impl->resumed = false;
+    impl->handshakeUs = 0;
+    impl->keyHashValid = false;
+
+    if (tls && !impl->configured) {
+        if (!configure(impl->entropy, impl->drbg, impl->config, impl->error)) {
+            return false;
+        }
+        impl->configured = true;
+    }
+    impl->fd = tcpConnect(impl->error, host, port, timeoutMs);
+    if (impl->fd < 0 || !tls) {
+        return impl->fd >= 0;
+    }
+
+    // Буферы записей (~2 x 16 КБ) выделяются здесь и освобождаются в close():
+    // при живом соединении переподключений почти нет
+    mbedtls_ssl_init(&impl->ssl);
+    impl->tls = true;
+    int result = mbedtls_ssl_setup(&impl->ssl, &impl->config);
+    if (result == 0) {
+        result = mbedtls_ssl_set_hostname(&impl->ssl, host);
+    }
+    if (result != 0) {
+        setError(impl->error, "setup", result);
+        close();
+        return false;
+    }
+    mbedtls_ssl_set_bio(&impl->ssl, &impl->fd, bioSend, bioRecv, nullptr);
+    if (impl->sessionValid && mbedtls_ssl_set_session(&impl->ssl, &impl->session) == 0) {
+        impl->sessionOffered = true;
+    }
+
+    // По шагам: принятая сервером сессия пропускает состояние SERVER_CERTIFICATE
+    uint32_t started = micros();
+    bool certificateSeen = false;
+    while (impl->ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        if (impl->ssl.state == MBEDTLS_SSL_SERVER_CERTIFICATE) {
+            certificateSeen = true;
+        }
+        result = mbedtls_ssl_handshake_step(&impl->ssl);
+        if (result != 0) {
+            setError(impl->error, "handshake", result);
+            close();
+            // Сервер мог отвергнуть сессию вместе с соединением: следующая попытка — полная
+            forgetSession();
+            return false;
+        }
+    }
+    impl->handshakeUs = micros() - started;
+    impl->resumed = impl->sessionOffered && !certificateSeen;
+
+    if (!impl->resumed) {
+        const mbedtls_x509_crt* certificate = mbedtls_ssl_get_peer_cert(&impl->ssl);
+        if (certificate != nullptr &&
+            mbedtls_sha256_ret(certificate->pk_raw.p, certificate->pk_raw.len, impl->keyHash, 0) == 0) {
+            impl->keyHashValid = true;
+        }
+    }
+
+    // Копия сессии с тикетом, если сервер его выдал
+    impl->sessionValid = mbedtls_ssl_get_session(&impl->ssl, &impl->session) == 0;
+    return true;
+}
+
+bool TlsSocket::write(const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (length > 0 && impl->fd >= 0) {
+        int written;
+        if (impl->tls) {
+            written = mbedtls_ssl_write(&impl->ssl, bytes, length);
+        } else {
+            written = lwip_send(impl->fd, bytes, length, 0);
+        }
+        if (written <= 0) {
+            setError(impl->error, "write", impl->tls ? written : 0);
+            close();
+            return false;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return length == 0;
+}
+
+int TlsSocket::read(void* buffer, size_t size) {
+    if (impl->fd < 0) {
+        return -1;
+    }
+    if (!impl->tls) {
+        int received = lwip_recv(impl->fd, buffer, size, 0);
+        if (received < 0) {
+            setError(impl->error, "read", 0);
+        }
+        return received < 0 ? -1 : received;
+    }
+    int received = mbedtls_ssl_read(&impl->ssl, (unsigned char*)buffer, size);
+    if (received >= 0 || received == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+        return received > 0 ? received : 0;
+    }
+    setError(impl->error, "read", received);
+    return -1;
+}
+
+void TlsSocket::close() {
+    if (impl->tls) {
+        if (impl->fd >= 0) {
+            mbedtls_ssl_close_notify(&impl->ssl);
+        }
+        mbedtls_ssl_free(&impl->ssl);
+        impl->tls = false;
+    }
+    if (impl->fd >= 0) {
+        lwip_close(impl->fd);
+        impl->fd = -1;
+    }
+}
+
+bool TlsSocket::isOpen() const {
+    return impl->fd >= 0;
+}
+
+bool TlsSocket::wasSessionOffered() const {
+    return impl->sessionOffered;
+}
+
+bool TlsSocket::wasResumed() const {
+    return impl->resumed;
+}
+
+uint32_t TlsSocket::getHandshakeUs() const {
+    return impl->handshakeUs;
+}
+
+bool TlsSocket::getPeerKeyHash(uint8_t hash[32]) const {
+    if (!impl->keyHashValid) {
+        return false;
+    }
+    memcpy(hash, impl->keyHash, sizeof(impl->keyHash));
+    return true;
+}
+
+void TlsSocket::forgetSession() {
+    mbedtls_ssl_session_free(&impl->session);
+    mbedtls_ssl_session_init(&impl->session);
+    impl->sessionValid = false;
+}
+
+const char* TlsSocket::getError() const {
+    return impl->error;
+}
+
+#endif // ARDUINO
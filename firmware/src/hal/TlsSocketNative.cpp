@@ -0,0 +1,301 @@
+#ifndef ARDUINO
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <openssl/err.h>
+#include <openssl/sha.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include "TlsSocket.h"
+
+#define ERROR_SIZE 96
+
+struct TlsSocket::Impl {
+    int fd;
+    SSL_CTX* context;
+    SSL* ssl;
+    SSL_SESSION* session;
+    bool sessionOffered;
+    bool resumed;
+    uint32_t handshakeUs;
+    bool keyHashValid;
+    uint8_t keyHash[32];
+    char error[ERROR_SIZE];
+};
+
+static uint32_t monotonicUs() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void setError(char (&error)[ERROR_SIZE], const char* what, unsigned long code) {
+    if (code != 0) {
+        char reason[64];
+        ERR_error_string_n(code, reason, sizeof(reason));
+        snprintf(error, sizeof(error), "%s: %s", what, reason);
+    } else {
+        snprintf(error, sizeof(error), "%s: %s", what, strerror(errno));
+    }
+    ERR_clear_error();
+}
+
+/**
+ * TCP-подключение с таймаутом (неблокирующий connect + poll)
+ */
+static int tcpConnect(char (&error)[ERROR_SIZE], const char* host, uint16_t port, uint32_t timeoutMs) {
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* address = nullptr;
+    if (getaddrinfo(host, service, &hints, &address) != 0 || address == nullptr) {
+        snprintf(error, sizeof(error), "cannot resolve %s", host);
+        return -1;
+    }
+
+    int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(address);
+        setError(error, "socket", 0);
+        return -1;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int result = ::connect(fd, address->ai_addr, address->ai_addrlen);
+    freeaddrinfo(address);
+    if (result < 0 && errno == EINPROGRESS) {
+        struct pollfd waiting = {fd, POLLOUT, 0};
+        int socketError = 0;
+        socklen_t length = sizeof(socketError);
+        if (poll(&waiting, 1, (int)timeoutMs) == 1 &&
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &socketError, &length) == 0) {
+            errno = socketError;
+            result = socketError == 0 ? 0 : -1;
+        } else {
+            errno = ETIMEDOUT;
+        }
+    }
+    if (result < 0) {
+        setError(error, "connect", 0);
+        ::close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, flags);
+
+    // Заголовки и тело уходят отдельными записями: без задержки Нагла
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    struct timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+TlsSocket::TlsSocket()
+    : impl(new Impl()) {
+    impl->fd = -1;
+    impl->context = nullptr;
+    impl->ssl = nullptr;
+    impl->session = nullptr;
+    impl->sessionOffered = false;
+    impl->resumed = false;
+    impl->handshakeUs = 0;
+    impl->keyHashValid = false;
+    impl->error[0] = '\0';
+    // OpenSSL пишет в сокет через write(): запись в закрытое сервером
+    // соединение должна вернуть ошибку, а не завершить процесс
+    signal(SIGPIPE, SIG_IGN);
+}
+
+TlsSocket::~TlsSocket() {
+    close();
+    forgetSession();
+    if (impl->context != nullptr) {
+        SSL_CTX_free(impl->context);
+    }
+    delete impl;
+}
+
+bool TlsSocket::connect(const char* host, uint16_t port, bool tls, uint32_t timeoutMs) {
+    close();
+    impl->sessionOffered = false;
+    impl->resumed = false;
+    impl->handshakeUs = 0;
+    impl->keyHashValid = false;
+
+    impl->fd = tcpConnect(impl->error, host, port, timeoutMs);
+    if (impl->fd < 0) {
+        return false;
+    }
+    if (!tls) {
+        return true;
+    }
+
+    if (impl->context == nullptr) {
+        impl->context = SSL_CTX_new(TLS_client_method());
+        if (impl->context == nullptr) {
+            setError(impl->error, "SSL_CTX_new", ERR_get_error());
+            close();
+            return false;
+        }
+        SSL_CTX_set_max_proto_version(impl->context, TLS1_2_VERSION);
+        SSL_CTX_set_verify(impl->context, SSL_VERIFY_NONE, nullptr);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+        SSL_CTX_set_options(impl->context, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+    }
+
+    impl->ssl = SSL_new(impl->context);
+    SSL_set_fd(impl->ssl, impl->fd);
+    SSL_set_tlsext_host_name(impl->ssl, host);
+    if (impl->session != nullptr) {
+        SSL_set_session(impl->ssl, impl->session);
+        impl->sessionOffered = true;
+    }
+
+    uint32_t started = monotonicUs();
+    if (SSL_connect(impl->ssl) != 1) {
+        setError(impl->error, "handshake", ERR_get_error());
+        close();
+        // Сервер мог отвергнуть сессию вместе с соединением: следующая попытка — полная
+        forgetSession();
+        return false;
+    }
+    impl->handshakeUs = monotonicUs() - started;
+    impl->resumed = SSL_session_reused(impl->ssl) == 1;
+
+    if (!impl->resumed) {
+        X509* certificate = SSL_get1_peer_certificate(impl->ssl);
+        if (certificate != nullptr) {
+            unsigned char* der = nullptr;
+            int length = i2d_X509_PUBKEY(X509_get_X509_PUBKEY(certificate), &der);
+            if (length > 0) {
+                SHA256(der, (size_t)length, impl->keyHash);
+                impl->keyHashValid = true;
+            }
+            OPENSSL_free(der);
+            X509_free(certificate);
+        }
+    }
+
+    SSL_SESSION* session = SSL_get1_session(impl->ssl);
+    if (session != nullptr && SSL_SESSION_is_resumable(session)) {
+        forgetSession();
+        impl->session = session;
+    } else if (session != nullptr) {
+        SSL_SESSION_free(session);
+    }
+    return true;
+}
+
+bool TlsSocket::write(const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (length > 0 && impl->fd >= 0) {
+        int written;
+        if (impl->ssl != nullptr) {
+            written = SSL_write(impl->ssl, bytes, (int)length);
+        } else {
+            written = (int)::send(impl->fd, bytes, length, MSG_NOSIGNAL);
+        }
+        if (written <= 0) {
+            setError(impl->error, "write", impl->ssl != nullptr ? ERR_get_error() : 0);
+            close();
+            return false;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return length == 0;
+}
+
+int TlsSocket::read(void* buffer, size_t size) {
+    if (impl->fd < 0) {
+        return -1;
+    }
+    if (impl->ssl == nullptr) {
+        ssize_t received = ::recv(impl->fd, buffer, size, 0);
+        if (received < 0) {
+            setError(impl->error, "read", 0);
+        }
+        return received < 0 ? -1 : (int)received;
+    }
+    int received = SSL_read(impl->ssl, buffer, (int)size);
+    if (received > 0) {
+        return received;
+    }
+    int code = SSL_get_error(impl->ssl, received);
+    if (code == SSL_ERROR_ZERO_RETURN) {
+        return 0;
+    }
+    // Закрытие без close_notify — тоже конец соединения, не ошибка протокола
+    if (code == SSL_ERROR_SYSCALL && errno == 0) {
+        ERR_clear_error();
+        return 0;
+    }
+    setError(impl->error, "read", ERR_get_error());
+    return -1;
+}
+
+void TlsSocket::close() {
+    if (impl->ssl != nullptr) {
+        SSL_shutdown(impl->ssl);
+        SSL_free(impl->ssl);
+        ERR_clear_error();
+        impl->ssl = nullptr;
+    }
+    if (impl->fd >= 0) {
+        ::close(impl->fd);
+        impl->fd = -1;
+    }
+}
+
+bool TlsSocket::isOpen() const {
+    return impl->fd >= 0;
+}
+
+bool TlsSocket::wasSessionOffered() const {
+    return impl->sessionOffered;
+}
+
+bool TlsSocket::wasResumed() const {
+    return impl->resumed;
+}
+
+uint32_t TlsSocket::getHandshakeUs() const {
+    return impl->handshakeUs;
+}
+
+bool TlsSocket::getPeerKeyHash(uint8_t hash[32]) const {
+    if (!impl->keyHashValid) {
+        return false;
+    }
+    memcpy(hash, impl->keyHash, sizeof(impl->keyHash));
+    return true;
+}
+
+void TlsSocket::forgetSession() {
+    if (impl->session != nullptr) {
+        SSL_SESSION_free(impl->session);
+        impl->session = nullptr;
+    }
+}
+
+const char* TlsSocket::getError() const {
+    return impl->error;
+}
+
+#endif // ARDUINO
@@ -9,7 +9,7 @@
  * - Определение частоты сети
  * - Расчёт межфазных (линейных) напряжений
  * - Определение перекоса фаз
- * - Отправка данных в InfluxDB каждую секунду
+ * - Отправка данных в InfluxDB каждую секунду (только изменившиеся величины + heartbeat)
  * - Индикация состояния через встроенный LED
  * 
  * Аппаратное обеспечение:
@@ -21,10 +21,36 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <time.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <sys/time.h>
+#include <ESPAsyncWebServer.h>
 #include "config.h"
 #include "PowerAnalyzer.h"
 #include "InfluxClient.h"
 #include "Oscilloscope.h"
+#include "ScopeServer.h"
+#include "MetricsExporter.h"
+#include "MqttUplink.h"
+#include "GatewayUplink.h"
+#include "TelemetryCodec.h"
+#include "DeadbandFilter.h"
+#include "CaptureRecorder.h"
+#include "DeepCapture.h"
+#include "DeepCaptureServer.h"
+#include "PmuServer.h"
+#include "FrequencyStream.h"
+#include "FlightRecorder.h"
+#include "PersistentStats.h"
+#include "ComplianceStats.h"
+#include "AnomalyDetector.h"
+#include "AlertEngine.h"
+#include "AlertNotifier.h"
+#include "VoltageHistogram.h"
+#include "HistoryStore.h"
+#include "HistoryServer.h"
+#include "BootTimeline.h"
+#include "Profiler.h"
 
 // NTP Configuration
 #define NTP_SERVER "pool.ntp.org"
@@ -32,19 +58,104 @@
 #define DAYLIGHT_OFFSET_SEC 0   // No DST
 
 // Глобальные объекты
-PowerAnalyzer analyzer;
+PowerAnalyzer analyzer(ANALYZER_CHANNEL_PINS, ANALYZER_CHANNEL_CALIBRATION);
 InfluxClient influxClient;
-Oscilloscope oscilloscope(PIN_PHASE_A, PIN_PHASE_B, PIN_PHASE_C);
+Oscilloscope oscilloscope;
+AsyncWebServer webServer(WEB_SERVER_PORT);
+ScopeServer scopeServer;
+DeadbandFilter deadband;
+AlertEngine alertEngine;
+AlertNotifier alertNotifier;
+MetricsExporter metricsExporter(analyzer, influxClient, deadband, alertEngine, alertNotifier);
+MqttUplink mqttUplink;
+GatewayUplink gatewayUplink;
+CaptureRecorder captureRecorder;
+DeepCapture deepCapture;
+DeepCaptureServer deepCaptureServer(analyzer, deepCapture);
+PmuServer pmuServer(analyzer);
+FlightRecorder flightRecorder;
+#if VOLTAGE_HISTOGRAM_ENABLED
+VoltageHistogram voltageHistogram;
+FrequencyStream frequencyStream(analyzer, flightRecorder, &voltageHistogram);
+#else
+FrequencyStream frequencyStream(analyzer, flightRecorder, nullptr);
+#endif
+PersistentStats persistentStats;
+ComplianceStats complianceStats;
+#if ANOMALY_ENABLED
+AnomalyDetector anomalyDetector;
+#endif
+#if HISTORY_ENABLED
+HistoryStore historyStore;
+HistoryServer historyServer(historyStore);
+#endif
+BootTimeline bootTimeline;
+
+// Запрос захвата из веб-обработчика (задача async_tcp); выполняется в loop().
+// >0 — начать запись стольких блоков, -1 — остановить
+volatile int32_t pendingCaptureBlocks = 0;
+
+// Запрос сброса min/max напряжения из веб-обработчика; выполняется в loop()
+volatile bool pendingExtremesReset = false;
+
+// Новый отпечаток ключа InfluxDB из веб-обработчика; применяется в loop(),
+// где идут записи. 1 — задать pendingPin, -1 — снять
+volatile int8_t pendingPinAction = 0;
+uint8_t pendingPin[32];
+
+// Транспорт, выбранный через /uplink; переключается в loop(), где идут отправки. -1 — нет запроса
+volatile int8_t pendingUplinkTransport = -1;
+
+// Задача доставки тревог на webhook (будится из loop() при новом переходе)
+TaskHandle_t alertTask = nullptr;
+
+// Активный транспорт (UPLINK_INFLUX / UPLINK_MQTT / UPLINK_GATEWAY), переопределяется из NVS
+uint8_t uplinkTransport = UPLINK_TRANSPORT;
+uint8_t lastProblemFlags = 0;
 
 // Тайминги
 unsigned long lastMeasurement = 0;
-unsigned long lastWifiCheck = 0;
 unsigned long lastStatusPrint = 0;
 unsigned long lastWaveform = 0;
+unsigned long lastScopeFrame = 0;
+uint32_t lastScopeGeneration = 0;   // Снимок осциллографа, уже отправленный зрителям
+uint32_t lastScopeBlock = UINT32_MAX; // Блок задачи оцифровки, с которого снимает осциллограф
+int scopeCursor = -1;                 // Кадр блока, с которого искать следующее окно (-1 — блок исчерпан)
+unsigned long lastDeviceStats = 0;
+unsigned long lastFrequencyBatch = 0;
+unsigned long lastFlightUpload = 0;
+int flightUploaded = 0;             // Сохранённых записей самописца уже отправлено
+unsigned long lastBootUpload = 0;
+bool bootReported = false;          // Точка boot отправлена
+uint32_t backfillFromS = 0;         // Секунды работы [from, to) до первой отправки, ещё не досланные
+uint32_t backfillToS = 0;
+
+// Последний блок задачи оцифровки (глубокий захват, PMU или поток частоты), уже отданный в измерение
+uint32_t lastStreamBlock = UINT32_MAX;
 
 // Интервал отправки waveform (5 секунд)
 #define WAVEFORM_SEND_INTERVAL_MS 5000
 
+// Буферы Line Protocol (статические: сериализация не трогает кучу)
+static char powerLines[POWER_LINE_PROTOCOL_SIZE];
+static char waveformLines[WAVEFORM_LINE_PROTOCOL_SIZE];
+static char complianceLines[COMPLIANCE_LINE_PROTOCOL_SIZE];
+#if ANOMALY_ENABLED
+static char anomalyLines[ANOMALY_LINE_PROTOCOL_SIZE];
+#endif
+static char alertLines[ALERT_LINE_PROTOCOL_SIZE];
+#if VOLTAGE_HISTOGRAM_ENABLED
+static char histogramLines[VOLTAGE_HISTOGRAM_LINE_PROTOCOL_SIZE];
+#endif
+static char frequencyLines[FREQSTREAM_LINE_PROTOCOL_SIZE];
+static char rocofLines[FREQSTREAM_EVENT_LINE_PROTOCOL_SIZE];
+static FrequencySample frequencyBatch[FREQSTREAM_RATE * FREQSTREAM_BATCH_S];
+static char flightLines[FLIGHTREC_LINE_PROTOCOL_SIZE];
+static char bootLines[BOOT_LINE_PROTOCOL_SIZE];
+#if PROFILING_ENABLED
+static char deviceStatsLines[DEVICE_STATS_LINE_PROTOCOL_SIZE];
+#endif
+
 // Счётчики
 unsigned long measurementCount = 0;
 unsigned long wifiReconnects = 0;
@@ -55,104 +166,580 @@ unsigned long wifiReconnects = 0;
 #endif
 
 /**
- * Подключение к WiFi с таймаутом
+ * Точка доступа и аренда DHCP последнего подключения (NVS "wifi")
  */
-bool connectWiFi() {
-    Serial.println();
-    Serial.print("[WiFi] Connecting to ");
-    Serial.println(WIFI_SSID);
-    
-    WiFi.mode(WIFI_STA);
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < WIFI_CONNECT_TIMEOUT_SEC * 2) {
-        delay(500);
-        Serial.print(".");
-        attempts++;
-        
-        // Мигаем LED
-        digitalWrite(LED_BUILTIN, attempts % 2);
+struct WiFiCache {
+    char ssid[33];          // Кэш другой сети (перепрошили SSID) не используется
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+WiFiCache wifiCache;
+bool wifiCacheValid = false;
+bool wifiConnected = false;
+bool wifiFastAttempt = false;       // Текущая попытка — по кэшу, без сканирования
+unsigned long wifiAttemptStart = 0;
+
+// Проверка InfluxDB в фоновой задаче: -1 — идёт или не запускалась, иначе результат /ping
+volatile int8_t influxPingResult = -1;
+volatile uint32_t influxPingMs = 0;
+
+/**
+ * Прочитать кэш из NVS (кэш другого SSID не используется)
+ */
+void loadWiFiCache() {
+    Preferences prefs;
+    prefs.begin("wifi", true);
+    wifiCacheValid = prefs.getBytes("cache", &wifiCache, sizeof(wifiCache)) == sizeof(wifiCache) &&
+                     strncmp(wifiCache.ssid, WIFI_SSID, sizeof(wifiCache.ssid)) == 0 &&
+                     wifiCache.channel != 0;
+    prefs.end();
+}
+
+/**
+ * Запомнить точку доступа и аренду; NVS пишется, только если что-то изменилось
+ */
+void saveWiFiCache() {
+    WiFiCache current;
+    memset(&current, 0, sizeof(current));
+    strncpy(current.ssid, WIFI_SSID, sizeof(current.ssid) - 1);
+    const uint8_t* bssid = WiFi.BSSID();
+    if (bssid != nullptr) {
+        memcpy(current.bssid, bssid, sizeof(current.bssid));
+    }
+    current.channel = (uint8_t)WiFi.channel();
+    current.ip = (uint32_t)WiFi.localIP();
+    current.gateway = (uint32_t)WiFi.gatewayIP();
+    current.subnet = (uint32_t)WiFi.subnetMask();
+    current.dns = (uint32_t)WiFi.dnsIP();
+    if (wifiCacheValid && memcmp(&current, &wifiCache, sizeof(current)) == 0) {
+        return;
     }
     
-    Serial.println();
-    
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("[WiFi] Connected!");
-        Serial.print("[WiFi] IP address: ");
-        Serial.println(WiFi.localIP());
-        Serial.print("[WiFi] RSSI: ");
-        Serial.print(WiFi.RSSI());
-        Serial.println(" dBm");
-        return true;
+    Preferences prefs;
+    prefs.begin("wifi", false);
+    prefs.putBytes("cache", &current, sizeof(current));
+    prefs.end();
+    wifiCache = current;
+    wifiCacheValid = true;
+    Serial.printf("[WiFi] Cached BSSID %02x:%02x:%02x:%02x:%02x:%02x, channel %u for fast connect\n",
+                  current.bssid[0], current.bssid[1], current.bssid[2], current.bssid[3], current.bssid[4],
+                  current.bssid[5], current.channel);
+}
+
+/**
+ * Начать подключение к WiFi (не ждёт: за попыткой следит serviceWiFi())
+ * @param fast По кэшу: сразу к известной точке на известном канале и, с
+ *             WIFI_REUSE_LEASE, с прошлым адресом без обмена DHCP
+ */
+void startWiFi(bool fast) {
+    wifiFastAttempt = fast && wifiCacheValid;
+    wifiAttemptStart = millis();
+    if (wifiFastAttempt) {
+#if WIFI_REUSE_LEASE
+        WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway), IPAddress(wifiCache.subnet),
+                    IPAddress(wifiCache.dns));
+#endif
+        Serial.printf("[WiFi] Fast connect to %s (channel %u)\n", WIFI_SSID, wifiCache.channel);
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD, wifiCache.channel, wifiCache.bssid);
     } else {
-        Serial.println("[WiFi] Connection failed!");
-        return false;
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);  // Снова DHCP
+        Serial.printf("[WiFi] Connecting to %s\n", WIFI_SSID);
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
     }
 }
 
 /**
- * Синхронизация времени через NTP
+ * Фоновая задача: /ping InfluxDB, не задерживая loop() и измерения
  */
-bool syncTime() {
-    Serial.println("[NTP] Syncing time...");
-    configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER);
-    
-    // Ждём синхронизации (максимум 10 секунд)
-    int attempts = 0;
+void influxPingTask(void* arg) {
+    bool reachable = influxClient.ping();
+    influxPingMs = millis();
+    influxPingResult = reachable ? 1 : 0;
+    vTaskDelete(nullptr);
+}
+
+/**
+ * Фоновая задача: переходы тревог на webhook. Спит, пока очередь пуста или
+ * до следующего повтора; без WiFi попытки не тратятся.
+ */
+void alertWebhookTask(void* arg) {
+    for (;;) {
+        uint32_t waitMs = WiFi.status() == WL_CONNECTED ? alertNotifier.service() : 500;
+        ulTaskNotifyTake(pdTRUE, waitMs == ALERT_NOTIFY_IDLE ? portMAX_DELAY : pdMS_TO_TICKS(waitMs));
+    }
+}
+
+/**
+ * Переходы тревог: в журнал и на webhook (из своей задачи). Не блокирует:
+ * точки alert в InfluxDB — sendAlerts() вместе с остальными отправками
+ */
+void publishAlerts(const AlertEvent* events, int count) {
     time_t now = time(nullptr);
-    while (now < 1700000000 && attempts < 20) {  // 1700000000 = ~2023 год
-        delay(500);
-        Serial.print(".");
-        now = time(nullptr);
-        attempts++;
+    uint32_t unixTime = now > 1700000000 ? (uint32_t)now : 0;
+    for (int i = 0; i < count; i++) {
+        const AlertEvent& e = events[i];
+        const AlertRule& rule = alertEngine.getRule(e.rule);
+        Serial.printf("%s [ALERT] %s%s%s %s: %.2f (%s %lu ms)\n", e.active ? "⚠️ " : "✓", rule.name,
+                      e.phase >= 0 ? " " : "", e.phase >= 0 ? AlertEngine::phaseName(e.phase) : "",
+                      e.active ? "raised" : "cleared", e.value, e.active ? "beyond threshold" : "lasted",
+                      (unsigned long)e.durationMs);
+        if (alertNotifier.isEnabled()) {
+            char payload[ALERT_PAYLOAD_SIZE];
+            size_t length = alertEngine.writeJson(e, DEVICE_ID, unixTime, payload, sizeof(payload));
+            if (length == 0 || !alertNotifier.enqueue(payload, length)) {
+                Serial.println("[Alerts] Webhook queue full, notification dropped");
+            }
+        }
+    }
+    if (alertTask != nullptr) {
+        xTaskNotifyGive(alertTask);
+    }
+}
+
+/**
+ * Точки alert в InfluxDB. Запись синхронная (до HTTP_TIMEOUT_MS и рукопожатия
+ * TLS) — только после всех потребителей блока измерения
+ */
+void sendAlerts(const AlertEvent* events, int count) {
+    if (count == 0 || uplinkTransport != UPLINK_INFLUX) {
+        return;
+    }
+    size_t length = alertEngine.writeLineProtocol(events, count, alertLines, sizeof(alertLines), DEVICE_ID);
+    if (length == 0 || influxClient.send(alertLines, length) != SendStatus::SUCCESS) {
+        Serial.println("[Alerts] alert send failed");
+    }
+}
+
+/**
+ * Подключение установлено: кэш, NTP и проверка InfluxDB — в фоне
+ */
+void onWiFiConnected(unsigned long currentTime) {
+    if (bootTimeline.mark(BootStage::WIFI, currentTime)) {
+        bootTimeline.setFastConnect(wifiFastAttempt);
+        if (uplinkTransport == UPLINK_INFLUX &&
+            // Стек с запасом на рукопожатие TLS (ECDHE) для https://. Ядро 1, как loop():
+            // на ядре 0 задача оцифровки (FREQSTREAM_PRIORITY) не уступает время ниже себя
+            xTaskCreatePinnedToCore(influxPingTask, "influx_ping", 12288, nullptr, 1, nullptr, 1) != pdPASS) {
+            Serial.println("[InfluxDB] Cannot start the ping task, will check on data send");
+        }
+    }
+    Serial.printf("[WiFi] Connected%s in %lu ms: IP %s, RSSI %d dBm\n", wifiFastAttempt ? " (fast)" : "",
+                  currentTime - wifiAttemptStart, WiFi.localIP().toString().c_str(), WiFi.RSSI());
+    Serial.printf("[WebServer] Listening on http://%s:%d/\n", WiFi.localIP().toString().c_str(), WEB_SERVER_PORT);
+    saveWiFiCache();
+    
+    // SNTP работает в фоне и дальше пересинхронизирует сам; после
+    // переподключения — сразу
+    configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER);
+}
+
+/**
+ * WiFi, NTP и проверка InfluxDB без блокировок (каждый проход loop()).
+ * Неудачная попытка по кэшу сменяется обычной (сканирование + DHCP) и
+ * наоборот; перезагрузки нет — измерения и история идут и без сети.
+ */
+void serviceWiFi(unsigned long currentTime) {
+    bool connected = WiFi.status() == WL_CONNECTED;
+    if (connected && !wifiConnected) {
+        wifiConnected = true;
+        onWiFiConnected(currentTime);
+    } else if (!connected && wifiConnected) {
+        wifiConnected = false;
+        wifiReconnects++;
+        Serial.println("[WiFi] Connection lost, reconnecting...");
+        // Сокет остался от прежней сети: после переподключения — новый, по сессии TLS
+        influxClient.disconnect();
+        WiFi.disconnect();
+        startWiFi(true);
+    } else if (!connected) {
+        unsigned long timeoutMs = wifiFastAttempt ? WIFI_FAST_CONNECT_TIMEOUT_MS : WIFI_CONNECT_TIMEOUT_SEC * 1000UL;
+        if (currentTime - wifiAttemptStart >= timeoutMs) {
+            Serial.printf("[WiFi] %s failed after %lu ms\n", wifiFastAttempt ? "Fast connect" : "Connection",
+                          currentTime - wifiAttemptStart);
+            WiFi.disconnect();
+            startWiFi(!wifiFastAttempt);
+        }
     }
-    Serial.println();
     
-    if (now > 1700000000) {
+    time_t now = time(nullptr);
+    if (now > 1700000000 && bootTimeline.mark(BootStage::NTP, currentTime)) {
         struct tm timeinfo;
         localtime_r(&now, &timeinfo);
         Serial.printf("[NTP] Time synced: %04d-%02d-%02d %02d:%02d:%02d UTC\n",
                       timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
                       timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+    }
+    
+    int8_t ping = influxPingResult;
+    if (ping >= 0) {
+        influxPingResult = -1;
+        if (ping > 0) {
+            bootTimeline.mark(BootStage::INFLUX, influxPingMs);
+            Serial.println("[InfluxDB] Server is reachable!");
+        } else {
+            Serial.println("[InfluxDB] Warning: Server not responding to ping, will retry on data send...");
+        }
+    }
+}
+
+/**
+ * Название транспорта для логов
+ */
+const char* uplinkName(uint8_t transport) {
+    switch (transport) {
+        case UPLINK_MQTT:
+            return "MQTT";
+        case UPLINK_GATEWAY:
+            return "Gateway UDP";
+        default:
+            return "InfluxDB HTTP";
+    }
+}
+
+/**
+ * Прочитать выбранный транспорт из NVS (по умолчанию UPLINK_TRANSPORT из config.h)
+ */
+void loadUplinkTransport() {
+    Preferences prefs;
+    prefs.begin("uplink", true);
+    uplinkTransport = prefs.getUChar("transport", UPLINK_TRANSPORT);
+    prefs.end();
+    
+    Serial.printf("[Uplink] Transport: %s\n", uplinkName(uplinkTransport));
+}
+
+/**
+ * Переключить транспорт на лету и сохранить выбор в NVS (только из loop())
+ */
+void setUplinkTransport(uint8_t transport) {
+    Preferences prefs;
+    prefs.begin("uplink", false);
+    prefs.putUChar("transport", transport);
+    prefs.end();
+    
+    uplinkTransport = transport;
+    mqttUplink.setEnabled(transport == UPLINK_MQTT);
+    
+    Serial.printf("[Uplink] Switched to %s\n", uplinkName(transport));
+}
+
+/**
+ * Сверить секрет /influx/pin с INFLUXDB_PIN_SECRET за время, не зависящее от
+ * совпавшего префикса
+ * @return false и при пустом INFLUXDB_PIN_SECRET
+ */
+bool pinSecretMatches(const String& given) {
+    static const char expected[] = INFLUXDB_PIN_SECRET;
+    const size_t expectedLength = sizeof(expected) - 1;
+    uint8_t difference = given.length() != expectedLength;
+    for (size_t i = 0; i < expectedLength; i++) {
+        difference |= (uint8_t)(expected[i] ^ (i < given.length() ? given[i] : 0));
+    }
+    return expectedLength > 0 && difference == 0;
+}
+
+/**
+ * Запуск веб-сервера: страница осциллографа из LittleFS + WebSocket поток + /metrics
+ */
+void startWebServer() {
+    if (!LittleFS.begin(true)) {
+        Serial.println("[WebServer] LittleFS mount failed, scope page unavailable");
+    }
+    
+    scopeServer.begin(webServer);
+    metricsExporter.begin(webServer);
+    deepCaptureServer.begin(webServer);
+    pmuServer.begin(webServer);
+    frequencyStream.begin(webServer);
+#if HISTORY_ENABLED
+    historyServer.begin(webServer);
+#endif
+    
+    // POST /uplink?transport=influx|mqtt|gateway — выбор транспорта без перепрошивки
+    webServer.on("/uplink", HTTP_POST, [](AsyncWebServerRequest* request) {
+        if (!request->hasParam("transport")) {
+            request->send(400, "text/plain", "missing transport");
+            return;
+        }
+        const String& value = request->getParam("transport")->value();
+        uint8_t transport;
+        if (value == "mqtt") {
+            transport = UPLINK_MQTT;
+        } else if (value == "gateway") {
+            transport = UPLINK_GATEWAY;
+        } else if (value == "influx") {
+            transport = UPLINK_INFLUX;
+        } else {
+            request->send(400, "text/plain", "transport must be influx, mqtt or gateway");
+            return;
+        }
+        pendingUplinkTransport = (int8_t)transport;
+        request->send(200, "text/plain", uplinkName(transport));
+    });
+    // POST /influx/pin?secret=..&sha256=<64 hex> — отпечаток ключа InfluxDB (SHA-256 SPKI),
+    // &clear=1 — снять. Отпечаток решает, кому уходит токен, поэтому без секрета не меняется
+    webServer.on("/influx/pin", HTTP_POST, [](AsyncWebServerRequest* request) {
+        if (sizeof(INFLUXDB_PIN_SECRET) == 1) {
+            request->send(403, "text/plain", "disabled: set INFLUXDB_PIN_SECRET");
+            return;
+        }
+        if (!request->hasParam("secret") || !pinSecretMatches(request->getParam("secret")->value())) {
+            Serial.println("[InfluxDB] Pin change refused: bad secret");
+            request->send(403, "text/plain", "bad secret");
+            return;
+        }
+        if (request->hasParam("clear")) {
+            pendingPinAction = -1;
+            request->send(200, "text/plain", "unpinning");
+            return;
+        }
+        const String value = request->hasParam("sha256") ? request->getParam("sha256")->value() : String("");
+        if (value.length() != 64) {
+            request->send(400, "text/plain", "sha256 must be 64 hex digits");
+            return;
+        }
+        for (int i = 0; i < 64; i++) {
+            if (!isxdigit((unsigned char)value[i])) {
+                request->send(400, "text/plain", "sha256 must be 64 hex digits");
+                return;
+            }
+        }
+        for (int i = 0; i < 32; i++) {
+            pendingPin[i] = (uint8_t)strtoul(value.substring(i * 2, i * 2 + 2).c_str(), nullptr, 16);
+        }
+        pendingPinAction = 1;
+        request->send(200, "text/plain", "pinning");
+    });
+    // POST /capture?blocks=N — записать N окон сырых отсчётов, POST /capture?stop=1 — прервать.
+    // Готовый файл скачивается как обычная статика: GET /capture.bin
+    webServer.on("/capture", HTTP_POST, [](AsyncWebServerRequest* request) {
+        if (request->hasParam("stop")) {
+            pendingCaptureBlocks = -1;
+            request->send(200, "text/plain", "stopping");
+            return;
+        }
+        int32_t blocks = CAPTURE_DEFAULT_BLOCKS;
+        if (request->hasParam("blocks")) {
+            blocks = request->getParam("blocks")->value().toInt();
+        }
+        if (blocks <= 0) {
+            request->send(400, "text/plain", "blocks must be positive");
+            return;
+        }
+        pendingCaptureBlocks = blocks;
+        request->send(202, "text/plain", "recording " CAPTURE_PATH);
+    });
+    // POST /stats/reset — начать min/max напряжения заново (энергия и события не сбрасываются)
+    webServer.on("/stats/reset", HTTP_POST, [](AsyncWebServerRequest* request) {
+        pendingExtremesReset = true;
+        request->send(200, "text/plain", "resetting min/max");
+    });
+    webServer.serveStatic("/", LittleFS, "/").setDefaultFile("index.html");
+    webServer.begin();
+    
+    // Адрес — в логе подключения WiFi
+    Serial.printf("[WebServer] Started on port %d\n", WEB_SERVER_PORT);
+}
+
+#if PROFILING_ENABLED
+/**
+ * Публикация device_stats (InfluxDB) и начало нового интервала гистограмм
+ */
+void publishDeviceStats() {
+    if (uplinkTransport == UPLINK_INFLUX) {
+        size_t length = Profiler::writeLineProtocol(deviceStatsLines, sizeof(deviceStatsLines), DEVICE_ID);
+        if (influxClient.send(deviceStatsLines, length) != SendStatus::SUCCESS) {
+            Serial.println("[Profiler] device_stats send failed");
+        }
+    }
+    Profiler::resetWindow();
+}
+#endif
+
+/**
+ * Последний блок той задачи оцифровки, что сейчас владеет АЦП
+ */
+const int16_t* latestStreamBlock(uint32_t& seq, uint32_t& timestampMs) {
+    if (deepCaptureServer.isSampling()) {
+        return deepCapture.latestBlock(seq, timestampMs);
+    }
+    if (pmuServer.isSampling()) {
+        return pmuServer.latestBlock(seq, timestampMs);
+    }
+    return frequencyStream.latestBlock(seq, timestampMs);
+}
+
+/**
+ * Блок seq из latestStreamBlock() ещё цел: глубокий захват блоки не переписывает,
+ * поток частоты и PMU — через HANDOFF_BLOCKS - 1 блоков
+ */
+bool streamBlockHeld(uint32_t seq) {
+    if (deepCaptureServer.isSampling()) {
         return true;
-    } else {
-        Serial.println("[NTP] Time sync failed!");
-        return false;
     }
+    if (pmuServer.isSampling()) {
+        return pmuServer.holdsBlock(seq);
+    }
+    return frequencyStream.holdsBlock(seq);
 }
 
+static_assert(WAVEFORM_INTERVAL_US % PowerAnalyzer::INTERVAL_US == 0,
+              "Waveform points must fall on analyzer frames");
+
+// Окна живого осциллографа в одном блоке — через SCOPE_FRAME_INTERVAL_MS его времени
+static const int SCOPE_ADVANCE_FRAMES = SCOPE_FRAME_INTERVAL_MS * 1000 / PowerAnalyzer::INTERVAL_US;
+
 /**
- * Проверка и переподключение WiFi
+ * Осциллограмма — срез блока (только что проанализированного или блока
+ * задачи оцифровки) со смещениями и калибровкой анализатора: своей оцифровки нет
+ * @return Первый кадр окна, -1 если после searchFrom окно не помещается
  */
-void checkWiFi() {
-    if (WiFi.status() != WL_CONNECTED) {
-        Serial.println("[WiFi] Connection lost, reconnecting...");
-        wifiReconnects++;
-        
-        WiFi.disconnect();
-        delay(1000);
-        if (connectWiFi()) {
-            syncTime();  // Пересинхронизируем время после реконнекта
+int tapWaveform(const int16_t* block, int blockFrames, unsigned long timestampMs, int searchFrom) {
+    PROFILE_SCOPE(ProfileStage::WAVEFORM_CAPTURE);
+    float offsets[PowerAnalyzer::VOLTAGE_CHANNELS];
+    float sensitivities[PowerAnalyzer::VOLTAGE_CHANNELS];
+    for (int ch = 0; ch < PowerAnalyzer::VOLTAGE_CHANNELS; ch++) {
+        offsets[ch] = analyzer.getOffset(ch);
+        sensitivities[ch] = analyzer.getSensitivity(ch);
+    }
+    return oscilloscope.tap(block, blockFrames, PowerAnalyzer::CHANNELS, PowerAnalyzer::VOLTAGE_CHANNELS,
+                            offsets, sensitivities, PowerAnalyzer::FRAME_SCALE, PowerAnalyzer::INTERVAL_US,
+                            timestampMs, searchFrom);
+}
+
+/**
+ * Частота по периодам и ROCOF (InfluxDB): события сразу, значения раз в FREQSTREAM_BATCH_S
+ */
+void publishFrequency(unsigned long currentTime) {
+    FrequencyTracker& tracker = frequencyStream.getTracker();
+    bool influx = uplinkTransport == UPLINK_INFLUX;
+    
+    FrequencyEvent events[FREQUENCY_TRACKER_MAX_EVENTS];
+    int eventCount = tracker.readEvents(events, FREQUENCY_TRACKER_MAX_EVENTS);
+    for (int i = 0; i < eventCount; i++) {
+        if (events[i].active) {
+            Serial.printf("⚠️  [ROCOF] %.2f Hz/s at %.3f Hz\n", events[i].rocof, events[i].frequencyMin);
+        } else {
+            Serial.printf("[ROCOF] Event ended after %lu ms, peak %.2f Hz/s, f %.3f..%.3f Hz\n",
+                          (unsigned long)events[i].durationMs, events[i].rocof,
+                          events[i].frequencyMin, events[i].frequencyMax);
         }
     }
+    // Метки UTC: до NTP значения и события не отправляются
+    bool timeValid = time(nullptr) > 1700000000;
+    if (eventCount > 0 && influx && timeValid) {
+        size_t length = FrequencyTracker::writeEventLineProtocol(events, eventCount, rocofLines,
+                                                                 sizeof(rocofLines), DEVICE_ID);
+        if (length == 0 || influxClient.send(rocofLines, length) != SendStatus::SUCCESS) {
+            Serial.println("[ROCOF] rocof_event send failed");
+        }
+    }
+    
+    if (currentTime - lastFrequencyBatch < FREQSTREAM_BATCH_S * 1000UL) {
+        return;
+    }
+    const int batchMax = sizeof(frequencyBatch) / sizeof(frequencyBatch[0]);
+    int count = tracker.readSamples(frequencyBatch, batchMax);
+    // Полная пачка — в буфере есть ещё: следующая уйдёт на следующем проходе
+    if (count < batchMax) {
+        lastFrequencyBatch = currentTime;
+    }
+    if (count == 0 || !influx || !timeValid) {
+        return;
+    }
+    size_t length = FrequencyTracker::writeLineProtocol(frequencyBatch, count, frequencyLines,
+                                                        sizeof(frequencyLines), DEVICE_ID);
+    if (length == 0 || influxClient.send(frequencyLines, length) != SendStatus::SUCCESS) {
+        Serial.println("[FreqStream] frequency_cycle send failed");
+    }
 }
 
 /**
- * Мигание LED для индикации
- * @param count Количество миганий
- * @param onTime Время включения (мс)
- * @param offTime Время выключения (мс)
+ * Отправка записи самописца (InfluxDB): по FLIGHTREC_UPLOAD_CHUNK точек за проход,
+ * после неудачи — повтор через 5 секунд
  */
-void blinkLED(int count, int onTime = 100, int offTime = 100) {
-    for (int i = 0; i < count; i++) {
-        digitalWrite(LED_BUILTIN, HIGH);
-        delay(onTime);
-        digitalWrite(LED_BUILTIN, LOW);
-        if (i < count - 1) {
-            delay(offTime);
+void publishFlightRecord(unsigned long currentTime) {
+    int preserved = flightRecorder.getPreservedCount();
+    if (preserved == 0 || uplinkTransport != UPLINK_INFLUX || time(nullptr) <= 1700000000) {
+        return;
+    }
+    if (lastFlightUpload != 0 && currentTime - lastFlightUpload < 5000) {
+        return;
+    }
+    
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    uint64_t bootUtcMs = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 - millis();
+    size_t length = flightRecorder.writeLineProtocol(flightUploaded, FLIGHTREC_UPLOAD_CHUNK, flightLines,
+                                                     sizeof(flightLines), DEVICE_ID, bootUtcMs);
+    if (length == 0 || influxClient.send(flightLines, length) != SendStatus::SUCCESS) {
+        Serial.println("[FlightRec] flight_record send failed");
+        lastFlightUpload = currentTime;
+        return;
+    }
+    lastFlightUpload = 0;
+    flightUploaded += FLIGHTREC_UPLOAD_CHUNK;
+    if (flightUploaded >= preserved) {
+        Serial.printf("[FlightRec] %d cycles before %s reset uploaded\n", preserved,
+                      FlightRecorder::resetReasonName(flightRecorder.getResetReason()));
+        flightRecorder.releasePreserved();
+    }
+}
+
+/**
+ * Досылка измеренного до первой отправки (InfluxDB): секунды из истории со
+ * своими метками времени, по BOOT_BACKFILL_CHUNK_S за проход, затем точка
+ * boot. Ждёт NTP и первую отправку; после неудачи — повтор через 5 секунд
+ */
+void publishBoot(unsigned long currentTime) {
+    if (bootReported || uplinkTransport != UPLINK_INFLUX || !bootTimeline.reached(BootStage::FIRST_UPLOAD) ||
+        time(nullptr) <= 1700000000) {
+        return;
+    }
+    if (lastBootUpload != 0 && currentTime - lastBootUpload < 5000) {
+        return;
+    }
+    
+#if HISTORY_ENABLED
+    if (backfillFromS < backfillToS) {
+        // Смещение unix-времени история узнаёт со следующим измерением после NTP
+        if (!historyStore.hasUnixTime()) {
+            return;
+        }
+        // Старше кольца секундного уровня досылать нечего
+        if (backfillToS - backfillFromS > HISTORY_SECONDS) {
+            backfillFromS = backfillToS - HISTORY_SECONDS;
         }
+        uint32_t end = backfillToS - backfillFromS > BOOT_BACKFILL_CHUNK_S ? backfillFromS + BOOT_BACKFILL_CHUNK_S
+                                                                            : backfillToS;
+        size_t length = historyStore.writeLineProtocol(backfillFromS, end, bootLines, sizeof(bootLines), DEVICE_ID);
+        if (length > 0 && influxClient.send(bootLines, length) != SendStatus::SUCCESS) {
+            Serial.println("[Boot] backfill send failed");
+            lastBootUpload = currentTime;
+            return;
+        }
+        bootTimeline.addBackfill(end - backfillFromS);
+        backfillFromS = end;
+        lastBootUpload = 0;
+        return;
+    }
+#endif
+    
+    size_t length = bootTimeline.writeLineProtocol(bootLines, sizeof(bootLines), DEVICE_ID,
+                                                   FlightRecorder::resetReasonName(flightRecorder.getResetReason()));
+    if (length == 0 || influxClient.send(bootLines, length) != SendStatus::SUCCESS) {
+        Serial.println("[Boot] boot send failed");
+        lastBootUpload = currentTime;
+        return;
     }
+    bootReported = true;
+    Serial.printf("[Boot] Reported, %lu s before the first upload backfilled\n",
+                  (unsigned long)bootTimeline.getBackfill());
 }
 
 /**
@@ -176,8 +763,16 @@ void printStatus(const PowerData& data) {
     Serial.println();
     Serial.printf("Unbalance: %.2f %%\n", data.unbalance);
     
+    if (PowerAnalyzer::CURRENT_CHANNELS > 0) {
+        Serial.println();
+        Serial.printf("Current: A %.2f A, B %.2f A, C %.2f A\n", data.currentA, data.currentB, data.currentC);
+        Serial.printf("Power: P %.1f W, Q %.1f var, S %.1f VA, PF %.3f\n",
+                      data.activePower, data.reactivePower, data.apparentPower, data.powerFactor);
+        Serial.printf("Energy: import %.3f kWh, export %.3f kWh\n", data.energyImportKwh, data.energyExportKwh);
+    }
+    
     if (analyzer.hasProblems()) {
-        Serial.printf("⚠️  Problems: %s\n", analyzer.getProblemsDescription().c_str());
+        Serial.printf("⚠️  Problems: %s\n", analyzer.getProblemsDescription());
     } else {
         Serial.println("✓ All parameters OK");
     }
@@ -186,16 +781,180 @@ void printStatus(const PowerData& data) {
     Serial.printf("InfluxDB: sent=%lu, failed=%lu\n", 
                   influxClient.getSuccessCount(), 
                   influxClient.getFailCount());
+    const HttpConnection& influxConnection = influxClient.getConnection();
+    const HttpConnectionStats& http = influxConnection.getStats();
+    if (influxConnection.isSecure()) {
+        Serial.printf("InfluxDB TLS: %lu connections for %lu writes (reused %lu), handshakes full=%lu avg %.1f ms "
+                      "max %.1f ms, resumed=%lu avg %.1f ms, resume rate %.0f %%, pin failures=%lu\n",
+                      (unsigned long)http.connects, (unsigned long)http.requests, (unsigned long)http.reusedRequests,
+                      (unsigned long)http.fullHandshakes, influxConnection.getAverageHandshakeUs(false) / 1000.0f,
+                      http.maxFullHandshakeUs / 1000.0f, (unsigned long)http.resumedHandshakes,
+                      influxConnection.getAverageHandshakeUs(true) / 1000.0f,
+                      influxConnection.getResumeRate() * 100.0f, (unsigned long)http.pinFailures);
+    } else {
+        Serial.printf("InfluxDB HTTP: %lu connections for %lu writes (reused %lu)\n",
+                      (unsigned long)http.connects, (unsigned long)http.requests, (unsigned long)http.reusedRequests);
+    }
+    DeadbandStats db = deadband.getStats();
+    Serial.printf("Deadband: sent=%lu of %lu points (heartbeat=%lu, forced=%lu), suppressed %.1f %%\n",
+                  (unsigned long)db.sent, (unsigned long)db.evaluated,
+                  (unsigned long)db.heartbeats, (unsigned long)db.forced,
+                  deadband.getSuppressionRatio() * 100.0f);
+    const PersistentRecord& stored = persistentStats.getRecord();
+    Serial.printf("Persisted: boot #%lu, uptime %lu h, min/max %.1f/%.1f V, checkpoints=%lu (#%lu), failed=%lu\n",
+                  (unsigned long)stored.bootCount, (unsigned long)(stored.uptimeS / 3600),
+                  stored.minVoltage, stored.maxVoltage,
+                  (unsigned long)persistentStats.getWriteCount(),
+                  (unsigned long)persistentStats.getCheckpoint().sequence,
+                  (unsigned long)persistentStats.getWriteFailures());
+    const ComplianceSummary& quality = complianceStats.getSummary();
+    if (quality.intervals > 0) {
+        Serial.printf("EN 50160 week: %lu x 10 min, V %.1f %% in band, f %.2f %%, unb %.1f %%, THD %.1f %% (p95 %.1f %%) -> %s\n",
+                      (unsigned long)quality.intervals, quality.voltageInBandPct, quality.frequencyInBandPct,
+                      quality.unbalanceInLimitPct, quality.thdInLimitPct, quality.thdP95,
+                      quality.compliant ? "compliant" : "NOT compliant");
+    }
+#if VOLTAGE_HISTOGRAM_ENABLED
+    if (voltageHistogram.getLastCycles() > 0 || voltageHistogram.getCurrentCycles() > 0) {
+        Serial.printf("Histogram: %lu cycles this period, last period %lu cycles\n",
+                      (unsigned long)voltageHistogram.getCurrentCycles(),
+                      (unsigned long)voltageHistogram.getLastCycles());
+    }
+#endif
+#if HISTORY_ENABLED
+    const HistoryQueryStats& history = historyServer.getStats();
+    Serial.printf("History: %lu s + %lu min stored in %lu B, last query %lu rows %lu B in %lu us "
+                  "(render, max %lu us), heap -%lu B\n",
+                  (unsigned long)historyStore.storedPoints(0), (unsigned long)historyStore.storedPoints(1),
+                  (unsigned long)historyStore.getMemorySize(), (unsigned long)history.rows,
+                  (unsigned long)history.bytes, (unsigned long)history.renderUs,
+                  (unsigned long)history.maxRenderUs, (unsigned long)history.heapUsed);
+#endif
+#if ANOMALY_ENABLED
+    Serial.printf("Anomalies: %lu events, baselines %s, active:%s%s%s%s\n",
+                  (unsigned long)anomalyDetector.getEventCount(),
+                  anomalyDetector.isWarmedUp(ANOMALY_VOLTAGE_A) ? "ready" : "learning",
+                  anomalyDetector.isActive(ANOMALY_VOLTAGE_A) ? " A" : "",
+                  anomalyDetector.isActive(ANOMALY_VOLTAGE_B) ? " B" : "",
+                  anomalyDetector.isActive(ANOMALY_VOLTAGE_C) ? " C" : "",
+                  anomalyDetector.isActive(ANOMALY_FREQUENCY) ? " f" : "");
+#endif
+    Serial.printf("Alerts: %lu transitions, active:", (unsigned long)alertEngine.getTransitionCount());
+    for (int r = 0; r < alertEngine.getRuleCount(); r++) {
+        const AlertRule& rule = alertEngine.getRule(r);
+        for (int p = 0; p < (AlertEngine::isPerPhase(rule) ? PowerAnalyzer::PHASES : 1); p++) {
+            if (alertEngine.isActive(r, p)) {
+                Serial.printf(" %s%s%s", rule.name, AlertEngine::isPerPhase(rule) ? " " : "",
+                              AlertEngine::isPerPhase(rule) ? AlertEngine::phaseName(p) : "");
+            }
+        }
+    }
+    if (alertNotifier.isEnabled()) {
+        const AlertNotifierStats& webhook = alertNotifier.getStats();
+        Serial.printf(" | webhook: delivered=%lu, retries=%lu, pending=%lu, dropped: queue full=%lu, "
+                      "rejected=%lu, expired=%lu | latency last %.1f ms, max %.1f ms\n",
+                      (unsigned long)webhook.delivered, (unsigned long)webhook.retries,
+                      (unsigned long)alertNotifier.pending(), (unsigned long)webhook.dropped,
+                      (unsigned long)webhook.rejected, (unsigned long)webhook.expired,
+                      webhook.lastLatencyUs / 1000.0f, webhook.maxLatencyUs / 1000.0f);
+    } else {
+        Serial.println();
+    }
+    Serial.print("Boot:");
+    for (int i = 0; i < (int)BootStage::COUNT; i++) {
+        BootStage stage = (BootStage)i;
+        if (bootTimeline.reached(stage)) {
+            Serial.printf(" %s %lu ms,", BootTimeline::stageName(stage), (unsigned long)bootTimeline.at(stage));
+        } else {
+            Serial.printf(" %s -,", BootTimeline::stageName(stage));
+        }
+    }
+    Serial.printf(" WiFi %s, backfill %lu s%s\n", bootTimeline.isFastConnect() ? "fast" : "scan",
+                  (unsigned long)bootTimeline.getBackfill(), bootReported ? ", reported" : "");
     Serial.printf("WiFi reconnects: %lu, RSSI: %d dBm\n", 
                   wifiReconnects, WiFi.RSSI());
+    if (uplinkTransport == UPLINK_MQTT) {
+        MqttStats mqtt = mqttUplink.getStats();
+        Serial.printf("MQTT: pub=%lu, ack=%lu, dropped=%lu, lost=%lu | %.1f msg/s, %.0f B/s | "
+                      "latency avg=%.1f ms max=%.1f ms\n",
+                      mqtt.published, mqtt.acked, mqtt.dropped, mqtt.lost,
+                      mqtt.messagesPerSecond, mqtt.bytesPerSecond,
+                      mqtt.avgLatencyMs, mqtt.maxLatencyMs);
+    }
+    if (uplinkTransport == UPLINK_GATEWAY) {
+        Serial.printf("Gateway: sent=%lu, failed=%lu\n",
+                      gatewayUplink.getSuccessCount(),
+                      gatewayUplink.getFailCount());
+    }
+    Serial.printf("Scope: frames=%lu, dropped=%lu\n",
+                  scopeServer.getFramesSent(),
+                  scopeServer.getFramesDropped());
+    if (deepCapture.isAvailable()) {
+        DeepCaptureStatus deep = deepCapture.getStatus();
+        Serial.printf("Deep capture: %s, %lu/%lu frames, late=%lu (max %lu us), PSRAM %u KB\n",
+                      deep.state == DeepCaptureState::CAPTURING ? "recording" : "idle",
+                      (unsigned long)deep.frames, (unsigned long)deep.targetFrames,
+                      (unsigned long)deep.lateFrames, (unsigned long)deep.maxLateUs,
+                      (unsigned)(deepCapture.getBufferSize() / 1024));
+    }
+    if (pmuServer.isSampling()) {
+        uint32_t errorUs = PmuServer::timeErrorUs();
+        Serial.printf("PMU: %lu fps, sent=%lu, failed=%lu, dropped=%lu, time error %ld us\n",
+                      (unsigned long)pmuServer.getRate(),
+                      (unsigned long)pmuServer.getFramesSent(),
+                      (unsigned long)pmuServer.getFramesFailed(),
+                      (unsigned long)pmuServer.getFramesDropped(),
+                      errorUs == UINT32_MAX ? -1L : (long)errorUs);
+    }
+    if (frequencyStream.isSampling()) {
+        FrequencyTracker& tracker = frequencyStream.getTracker();
+        FrequencySample last;
+        bool hasLast = tracker.getLastSample(last);
+        Serial.printf("FreqStream: %lu values, dropped=%lu, ROCOF events=%lu%s, late=%lu (max %lu us)",
+                      (unsigned long)tracker.getSampleCount(), (unsigned long)tracker.getDropped(),
+                      (unsigned long)tracker.getEventCount(), tracker.isEventActive() ? " (active)" : "",
+                      (unsigned long)frequencyStream.getLateFrames(), (unsigned long)frequencyStream.getMaxLateUs());
+        if (hasLast && !isnan(last.rocof)) {
+            Serial.printf(" | %.3f Hz, %.3f Hz/s\n", last.frequency, last.rocof);
+        } else if (hasLast) {
+            Serial.printf(" | %.3f Hz\n", last.frequency);
+        } else {
+            Serial.println();
+        }
+    }
+    if (flightRecorder.getRecordCount() > 0 || flightRecorder.getPreservedCount() > 0) {
+        Serial.printf("FlightRec: %lu cycles recorded, %d preserved before %s reset pending upload\n",
+                      (unsigned long)flightRecorder.getRecordCount(), flightRecorder.getPreservedCount(),
+                      FlightRecorder::resetReasonName(flightRecorder.getResetReason()));
+    }
+#if PROFILING_ENABLED
+    const StageHistogram& cycle = Profiler::getStage(ProfileStage::CYCLE);
+    const StageHistogram& measure = Profiler::getStage(ProfileStage::MEASURE);
+    const LoopHealth& health = Profiler::getHealth();
+    Serial.printf("Loop: cycle p99=%lu us max=%lu us, measure max=%lu us, overruns=%lu, "
+                  "late samples=%lu (max %lu us) | heap free=%lu min=%lu\n",
+                  (unsigned long)Profiler::percentileUs(cycle, 0.99f), (unsigned long)cycle.maxUs,
+                  (unsigned long)measure.maxUs, (unsigned long)health.overruns,
+                  (unsigned long)health.lateSamples, (unsigned long)health.maxSampleLateUs,
+                  (unsigned long)Hal::freeHeap(), (unsigned long)Hal::minFreeHeap());
+#endif
+    if (OVERSAMPLE_FACTOR > 1) {
+        const Decimator& frontEnd = analyzer.getFrontEnd();
+        const float noise = analyzer.getFrontEndInputNoise();
+        Serial.printf("Front end: x%d, %d taps, ADC noise %.2f counts, +%.2f bits, "
+                      "load read %.1f%% + filter %.1f%% of the sampling core\n",
+                      OVERSAMPLE_FACTOR, frontEnd.getTaps(), noise, frontEnd.getEnobGain(noise),
+                      analyzer.getFrontEndReadLoad(), analyzer.getFrontEndFilterLoad());
+    }
     Serial.println("----------------------------------------");
     Serial.println();
 }
 
 void setup() {
-    // Инициализация Serial
+    // Инициализация Serial. Монитор по USB не ждём (BOOT_SERIAL_WAIT_MS):
+    // первые секунды после восстановления питания важнее начала лога
     Serial.begin(115200);
-    while (!Serial && millis() < 3000) {
+    while (!Serial && millis() < BOOT_SERIAL_WAIT_MS) {
         delay(10);
     }
     
@@ -209,49 +968,74 @@ void setup() {
     pinMode(LED_BUILTIN, OUTPUT);
     digitalWrite(LED_BUILTIN, LOW);
     
-    // Подключение к WiFi
-    if (!connectWiFi()) {
-        Serial.println("[ERROR] WiFi connection failed. Restarting in 10 seconds...");
-        delay(10000);
-        ESP.restart();
+    // Накопители из NVS — до первого измерения, чтобы перезапуск тоже был посчитан
+    persistentStats.begin(millis());
+    persistentStats.restoreInto(analyzer);
+    
+    // Самописец: секунды до сброса из RTC-памяти — до первой записи в неё
+    ResetReason resetReason = Hal::resetReason();
+    int preserved = flightRecorder.restore(resetReason);
+    Serial.printf("[FlightRec] Reset reason: %s\n", FlightRecorder::resetReasonName(resetReason));
+    if (preserved > 0) {
+        Serial.printf("[FlightRec] %d cycles (%.1f s) before reset preserved, min %.1f V\n",
+                      preserved, flightRecorder.getPreservedSpanMs() / 1000.0f,
+                      flightRecorder.getPreservedMinVoltage());
     }
     
-    // Синхронизация времени через NTP
-    if (!syncTime()) {
-        Serial.println("[WARNING] Time sync failed, timestamps may be incorrect!");
-        // Продолжаем работу, но данные могут не записаться в InfluxDB
+    // Измерения — раньше сети: смещения по одному блоку, первое измерение в
+    // первом проходе loop(), история пишется и без WiFi
+    analyzer.begin();
+    
+    // Буфер глубокого захвата в PSRAM (на платах без PSRAM захват недоступен)
+    deepCapture.begin(PowerAnalyzer::CHANNELS, PowerAnalyzer::FRAMES_PER_BLOCK, PowerAnalyzer::SAMPLE_RATE_HZ);
+    
+#if HISTORY_ENABLED
+    // Кольца истории: выделяются один раз, до первого измерения
+    if (historyStore.begin()) {
+        Serial.printf("[History] %lu B for %d s + %d min points\n",
+                      (unsigned long)historyStore.getMemorySize(), HISTORY_SECONDS, HISTORY_MINUTES);
+    } else {
+        Serial.println("[History] Not enough memory, history disabled");
     }
+#endif
     
-    // Быстрая проверка доступности InfluxDB
+    // Выбор транспорта и MQTT (подключается в loop(), если выбран)
+    loadUplinkTransport();
+    mqttUplink.begin(MQTT_HOST, MQTT_PORT, DEVICE_ID, MQTT_USER, MQTT_PASSWORD);
+    mqttUplink.setEnabled(uplinkTransport == UPLINK_MQTT);
+    gatewayUplink.begin(GATEWAY_HOST, GATEWAY_PORT, DEVICE_ID);
     influxClient.begin(INFLUXDB_URL, INFLUXDB_ORG, INFLUXDB_BUCKET, INFLUXDB_TOKEN);
     
-    Serial.println("[InfluxDB] Checking connection...");
-    if (influxClient.ping()) {
-        Serial.println("[InfluxDB] Server is reachable!");
-        blinkLED(2, 200, 200);
+    // Webhook тревог: своя задача на ядре 1 с приоритетом 2 — вытесняет loop() (приоритет 1),
+    // и уведомление не ждёт отправок в InfluxDB. Ядро 0 не трогает: там задача оцифровки
+    // занята непрерывно, и рукопожатие отнимало бы у неё кванты. Стек с запасом на
+    // рукопожатие TLS (ECDHE) для https://
+    if (alertNotifier.begin(ALERT_WEBHOOK_URL, ALERT_WEBHOOK_HEADERS) && alertNotifier.isEnabled()) {
+        if (xTaskCreatePinnedToCore(alertWebhookTask, "alert_webhook", 12288, nullptr, 2, &alertTask, 1) == pdPASS) {
+            Serial.printf("[Alerts] %d rules, webhook %s\n", alertEngine.getRuleCount(), ALERT_WEBHOOK_URL);
+        } else {
+            Serial.println("[Alerts] Cannot start the webhook task, notifications disabled");
+        }
     } else {
-        Serial.println("[InfluxDB] Warning: Server not responding to ping");
-        Serial.println("[InfluxDB] Will retry on data send...");
-        blinkLED(5, 100, 100);
+        Serial.printf("[Alerts] %d rules, no webhook\n", alertEngine.getRuleCount());
     }
     
-    // Инициализация анализатора напряжения
-    Serial.println();
-    analyzer.begin();
+    // WiFi в фоне: по кэшу точки доступа, NTP и /ping InfluxDB — после подключения
+    // (serviceWiFi()). Кэш ведём сами, поэтому настройки ядра во flash не пишем
+    WiFi.persistent(false);
+    WiFi.mode(WIFI_STA);
+    loadWiFiCache();
+    startWiFi(true);
     
-    // Инициализация осциллографа
-    oscilloscope.begin();
-    Serial.println("[Oscilloscope] Initialized");
+    // Веб-осциллограф (слушает с момента подключения)
+    startWebServer();
     
     Serial.println();
-    Serial.println("[READY] Starting measurements...");
+    Serial.printf("[READY] Starting measurements %lu ms after boot\n", (unsigned long)millis());
     Serial.printf("[CONFIG] Interval: %d ms, Device ID: %s\n", 
                   SEND_INTERVAL_MS, DEVICE_ID);
     Serial.println();
     
-    // Сигнал готовности
-    blinkLED(3, 300, 200);
-    
     // Первое измерение
     lastMeasurement = millis() - SEND_INTERVAL_MS;
 }
@@ -259,27 +1043,258 @@ void setup() {
 void loop() {
     unsigned long currentTime = millis();
     
-    // Периодическая проверка WiFi (каждые 30 секунд)
-    if (currentTime - lastWifiCheck >= 30000) {
-        lastWifiCheck = currentTime;
-        checkWiFi();
+    // WiFi, NTP и проверка InfluxDB идут в фоне, измерения их не ждут
+    serviceWiFi(currentTime);
+    
+    if (pendingPinAction != 0) {
+        influxClient.setPin(pendingPinAction > 0 ? pendingPin : nullptr);
+        Serial.printf("[InfluxDB] Server key %s\n", pendingPinAction > 0 ? "pinned" : "unpinned");
+        pendingPinAction = 0;
     }
     
+    // Транспорт из /uplink: переключаем между отправками, а не посреди них
+    int8_t transportRequest = pendingUplinkTransport;
+    if (transportRequest >= 0) {
+        pendingUplinkTransport = -1;
+        setUplinkTransport((uint8_t)transportRequest);
+    }
+    
+    // Обслуживание MQTT (переподключение, таймауты PUBACK, статистика)
+    mqttUplink.loop();
+    
+    // Задачи оцифровки: АЦП у одной из них. Глубокий захват и PMU исключают друг
+    // друга, поток частоты работает в остальное время и уступает им по запросу
+    frequencyStream.loop(deepCaptureServer.hasStartRequest() || pmuServer.hasStartRequest() ||
+                         deepCaptureServer.isSampling() || pmuServer.isSampling());
+    deepCaptureServer.loop(pmuServer.isSampling());
+    pmuServer.loop(deepCaptureServer.isSampling());
+    bool streamSampling = deepCaptureServer.isSampling() || pmuServer.isSampling() ||
+                          frequencyStream.isSampling();
+    
+    // Частота по периодам: события ROCOF сразу, значения — пачками
+    publishFrequency(currentTime);
+    
+    // Запись самописца до сброса (после перезагрузки по просадке, сторожу, панике)
+    publishFlightRecord(currentTime);
+    
+    // Измеренное до первой отправки и хронология запуска
+    publishBoot(currentTime);
+    
     // Основной цикл измерений
     if (currentTime - lastMeasurement >= SEND_INTERVAL_MS) {
+        PROFILE_SCOPE(ProfileStage::CYCLE);
+#if PROFILING_ENABLED
+        Profiler::recordLoopLateness(currentTime - lastMeasurement - SEND_INTERVAL_MS);
+#endif
         lastMeasurement = currentTime;
         measurementCount++;
         
         // Индикация начала измерения
         digitalWrite(LED_BUILTIN, HIGH);
         
-        // Измерение
-        PowerData data = analyzer.measure();
+        // Измерение. Пока АЦП занят задачей оцифровки, анализируем её последний
+        // блок (тот же не анализируем дважды)
+        PowerData data;
+        const int16_t* block = nullptr;
+        int blockFrames = 0;
+        if (streamSampling) {
+            uint32_t seq;
+            uint32_t timestampMs;
+            const int16_t* streamBlock = latestStreamBlock(seq, timestampMs);
+            if (streamBlock != nullptr && seq != lastStreamBlock) {
+                PROFILE_SCOPE(ProfileStage::MEASURE);
+                lastStreamBlock = seq;
+                // Задача перепишет слот через 400 мс, а проход ниже (тревоги, захват в
+                // LittleFS, THD) бывает дольше: все потребители читают копию
+                analyzer.loadBlock(streamBlock, PowerAnalyzer::FRAMES_PER_BLOCK);
+                if (streamBlockHeld(seq)) {
+                    block = analyzer.getLastBlock();
+                    blockFrames = analyzer.getLastBlockFrames();
+                    data = analyzer.analyze(block, blockFrames, timestampMs);
+                } else {
+                    Serial.println("[Measure] Stream block overwritten while copying, skipped");
+                    data = analyzer.getLastData();
+                }
+            } else {
+                data = analyzer.getLastData();
+            }
+        } else {
+            {
+                PROFILE_SCOPE(ProfileStage::MEASURE);
+                data = analyzer.measure();
+            }
+            block = analyzer.getLastBlock();
+            blockFrames = analyzer.getLastBlockFrames();
+#if PROFILING_ENABLED
+            Profiler::recordSampling(analyzer.getLateSamples(), analyzer.getMaxSampleLateUs());
+#endif
+        }
+        
+        // Время до первого измерения; с этой секунды история досылается после первой отправки
+        if (block != nullptr && bootTimeline.mark(BootStage::FIRST_SAMPLE, millis())) {
+            backfillFromS = currentTime / 1000;
+            Serial.printf("[Boot] First sample %lu ms after boot\n",
+                          (unsigned long)bootTimeline.at(BootStage::FIRST_SAMPLE));
+        }
         
-        // Формирование и отправка данных
-        String lineProtocol = analyzer.toLineProtocol(DEVICE_ID);
+        // Тревоги — первыми после измерения: переход уходит на webhook до записей в InfluxDB
+        AlertEvent alertEvents[ALERT_MAX_EVENTS];
+        int alertCount = 0;
+        if (block != nullptr) {
+            alertCount = alertEngine.update(data, PowerAnalyzer::PHASES, (uint32_t)data.timestamp, alertEvents);
+            if (alertCount > 0) {
+                publishAlerts(alertEvents, alertCount);
+            }
+        }
         
-        SendStatus status = influxClient.send(lineProtocol);
+        // Осциллограмма — тот же блок, что и измерение
+        if (block != nullptr) {
+            int start = tapWaveform(block, blockFrames, data.timestamp, 0);
+            // Живой осциллограф продолжает с этого блока: из потока — тот же слот, без
+            // потока — копия в анализаторе до следующего измерения
+            lastScopeBlock = streamSampling ? lastStreamBlock : UINT32_MAX;
+            scopeCursor = start < 0 ? -1 : start + SCOPE_ADVANCE_FRAMES;
+        }
+        
+        // Захват сырых отсчётов для воспроизведения на хосте
+        int32_t captureRequest = pendingCaptureBlocks;
+        if (captureRequest != 0) {
+            pendingCaptureBlocks = 0;
+            if (captureRequest > 0) {
+                captureRecorder.start(LittleFS, CAPTURE_PATH, captureRequest, analyzer, DEVICE_ID);
+            } else {
+                captureRecorder.stop();
+            }
+        }
+        if (block != nullptr) {
+            captureRecorder.append(block, blockFrames, data.timestamp);
+        }
+        
+        // Накопители: в RAM каждое измерение, в NVS — по правилам PersistentStats
+        if (pendingExtremesReset) {
+            pendingExtremesReset = false;
+            persistentStats.resetExtremes();
+        }
+        persistentStats.update(analyzer, currentTime);
+        persistentStats.checkpoint(currentTime);
+        
+#if HISTORY_ENABLED
+        // История в памяти: только новые измерения, с сетью и без
+        if (block != nullptr) {
+            time_t now = time(nullptr);
+            historyStore.add(data, PowerAnalyzer::PHASES, currentTime / 1000, now > 1700000000 ? (uint32_t)now : 0);
+        }
+#endif
+        
+        // EN 50160: THD нового блока и 10-минутные значения; по закрытии интервала — итог недели
+        if (block != nullptr) {
+            bool intervalClosed;
+            {
+                PROFILE_SCOPE(ProfileStage::COMPLIANCE);
+                float thd[3] = {0.0f, 0.0f, 0.0f};
+                for (int p = 0; p < PowerAnalyzer::PHASES; p++) {
+                    thd[p] = analyzer.harmonicDistortion(block, blockFrames, p);
+                }
+                time_t now = time(nullptr);
+                intervalClosed = now > 1700000000 &&
+                                 complianceStats.update(data, thd, PowerAnalyzer::PHASES, (uint32_t)now);
+            }
+            if (intervalClosed && uplinkTransport == UPLINK_INFLUX) {
+                size_t length = complianceStats.writeLineProtocol(complianceLines, sizeof(complianceLines), DEVICE_ID);
+                if (length == 0 || influxClient.send(complianceLines, length) != SendStatus::SUCCESS) {
+                    Serial.println("[Compliance] en50160 send failed");
+                }
+            }
+        }
+        
+#if VOLTAGE_HISTOGRAM_ENABLED
+        // Распределение RMS периодов: одна точка на закрытый интервал. Пока идёт поток
+        // частоты, периоды считает его задача (все); без него — периоды блоков измерений
+        if (block != nullptr && !frequencyStream.isSampling()) {
+            time_t now = time(nullptr);
+            float offsets[PowerAnalyzer::VOLTAGE_CHANNELS];
+            float sensitivities[PowerAnalyzer::VOLTAGE_CHANNELS];
+            for (int ch = 0; ch < PowerAnalyzer::VOLTAGE_CHANNELS; ch++) {
+                offsets[ch] = analyzer.getOffset(ch);
+                sensitivities[ch] = analyzer.getSensitivity(ch);
+            }
+            if (now > 1700000000) {
+                voltageHistogram.addBlock(block, blockFrames, PowerAnalyzer::CHANNELS, PowerAnalyzer::VOLTAGE_CHANNELS,
+                                          PowerAnalyzer::PERIOD_FRAMES, offsets, sensitivities, (uint32_t)now);
+            }
+        }
+        if (voltageHistogram.takeClosed() && uplinkTransport == UPLINK_INFLUX) {
+            size_t length = voltageHistogram.writeLineProtocol(histogramLines, sizeof(histogramLines), DEVICE_ID);
+            if (length == 0 || influxClient.send(histogramLines, length) != SendStatus::SUCCESS) {
+                Serial.println("[Histogram] voltage_histogram send failed");
+            }
+        }
+#endif
+        
+#if ANOMALY_ENABLED
+        // Аномалии относительно базовой линии часа суток (до NTP — по времени работы)
+        if (block != nullptr) {
+            AnomalyEvent events[ANOMALY_MAX_EVENTS];
+            time_t now = time(nullptr);
+            uint32_t timeS = now > 1700000000 ? (uint32_t)now : currentTime / 1000;
+            int count = anomalyDetector.update(data, PowerAnalyzer::PHASES, timeS, events);
+            for (int i = 0; i < count; i++) {
+                Serial.printf("⚠️  [ANOMALY] %s %s: %.3f vs baseline %.3f (score %.1f sigma)\n",
+                              AnomalyDetector::metricName(events[i].metric),
+                              AnomalyDetector::kindName(events[i].kind),
+                              events[i].value, events[i].baseline, events[i].score);
+            }
+            if (count > 0 && uplinkTransport == UPLINK_INFLUX) {
+                size_t length = AnomalyDetector::writeLineProtocol(events, count, anomalyLines,
+                                                                   sizeof(anomalyLines), DEVICE_ID);
+                if (length == 0 || influxClient.send(anomalyLines, length) != SendStatus::SUCCESS) {
+                    Serial.println("[Anomaly] send failed");
+                }
+            }
+        }
+#endif
+        
+        // Блок больше не нужен: теперь можно ждать InfluxDB
+        sendAlerts(alertEvents, alertCount);
+        
+        // Report-by-exception: отправляем только величины, вышедшие за deadband.
+        // Смена флагов проблем всегда даёт полную маску, поэтому события не теряются.
+        SendStatus status = SendStatus::SUCCESS;
+        uint8_t problemFlags = TelemetryCodec::problemFlags(data);
+        uint16_t fieldMask = deadband.update(data, currentTime);
+        
+        // Формирование и отправка данных выбранным транспортом
+        if (fieldMask != 0) {
+            if (uplinkTransport == UPLINK_MQTT) {
+                PROFILE_SCOPE(ProfileStage::POWER_SEND);
+                // Бинарная запись компактна (40 байт) — шлём целиком при любом изменении
+                status = mqttUplink.publishPower(data);
+                if (problemFlags != lastProblemFlags) {
+                    mqttUplink.publishEvent(data, lastProblemFlags);
+                }
+            } else if (uplinkTransport == UPLINK_GATEWAY) {
+                PROFILE_SCOPE(ProfileStage::POWER_SEND);
+                status = gatewayUplink.publishPower(data, problemFlags != lastProblemFlags, lastProblemFlags);
+            } else {
+                size_t length;
+                {
+                    PROFILE_SCOPE(ProfileStage::POWER_SERIALIZE);
+                    length = analyzer.writeLineProtocol(powerLines, sizeof(powerLines), DEVICE_ID, fieldMask);
+                }
+                PROFILE_SCOPE(ProfileStage::POWER_SEND);
+                status = influxClient.send(powerLines, length);
+            }
+            
+            // Не дошло — следующее измерение отправит все величины заново
+            if (status != SendStatus::SUCCESS) {
+                deadband.invalidate();
+            } else if (bootTimeline.mark(BootStage::FIRST_UPLOAD, currentTime)) {
+                backfillToS = currentTime / 1000;
+                Serial.printf("[Boot] First upload %lu ms after boot, %lu s measured before it\n",
+                              (unsigned long)currentTime, (unsigned long)(backfillToS - backfillFromS));
+            }
+        }
+        lastProblemFlags = problemFlags;
         
         // Индикация результата
         if (status == SendStatus::SUCCESS) {
@@ -300,32 +1315,65 @@ void loop() {
             lastStatusPrint = currentTime;
             printStatus(data);
         }
-        
-        // При проблемах выводим сразу
-        if (analyzer.hasProblems()) {
-            Serial.printf("⚠️  [ALERT] %s | A=%.1fV B=%.1fV C=%.1fV | Unb=%.1f%% | F=%.2fHz\n",
-                         analyzer.getProblemsDescription().c_str(),
-                         data.voltageA, data.voltageB, data.voltageC,
-                         data.unbalance, data.frequencyAvg);
+    }
+    
+    // Живой осциллограф: раз в SCOPE_FRAME_INTERVAL_MS следующее синхронизированное окно
+    // блока, через SCOPE_FRAME_INTERVAL_MS его времени от предыдущего. Блоки потока
+    // (5 в секунду) дают полную частоту кадров, без потока — окна блока измерения
+    // (до 200 мс в секунду). Цифры — последнего измерения
+    scopeServer.loop();
+    if (scopeServer.hasClients() && currentTime - lastScopeFrame >= SCOPE_FRAME_INTERVAL_MS) {
+        if (streamSampling) {
+            uint32_t seq;
+            uint32_t timestampMs;
+            const int16_t* streamBlock = latestStreamBlock(seq, timestampMs);
+            if (streamBlock != nullptr && seq != lastScopeBlock) {
+                lastScopeBlock = seq;
+                scopeCursor = 0;
+            }
+            if (streamBlock != nullptr && scopeCursor >= 0) {
+                int start = tapWaveform(streamBlock, PowerAnalyzer::FRAMES_PER_BLOCK, timestampMs, scopeCursor);
+                scopeCursor = start < 0 ? -1 : start + SCOPE_ADVANCE_FRAMES;
+                if (start >= 0 && !streamBlockHeld(seq)) {
+                    // Слот уже переписывается: окно не показываем
+                    lastScopeGeneration = oscilloscope.getGeneration();
+                }
+            }
+        } else if (lastScopeBlock == UINT32_MAX && scopeCursor >= 0) {
+            int start = tapWaveform(analyzer.getLastBlock(), analyzer.getLastBlockFrames(),
+                                    analyzer.getLastData().timestamp, scopeCursor);
+            scopeCursor = start < 0 ? -1 : start + SCOPE_ADVANCE_FRAMES;
+        }
+        if (oscilloscope.getGeneration() != lastScopeGeneration) {
+            lastScopeFrame = currentTime;
+            lastScopeGeneration = oscilloscope.getGeneration();
+            
+            const WaveformData& wave = oscilloscope.getData();
+            scopeServer.publish(wave, analyzer.getLastData(), wave.offsets[0], wave.offsets[1], wave.offsets[2]);
         }
     }
     
-    // Отправка waveform для осциллографа (раз в 5 секунд)
-    if (currentTime - lastWaveform >= WAVEFORM_SEND_INTERVAL_MS) {
+    // Отправка waveform для осциллографа (раз в 5 секунд), центрированной смещениями анализатора
+    if (currentTime - lastWaveform >= WAVEFORM_SEND_INTERVAL_MS && oscilloscope.getGeneration() != 0) {
         lastWaveform = currentTime;
         
-        // Захватываем waveform (~20ms блокировка)
-        oscilloscope.capture();
-        
-        // Получаем offset'ы от анализатора для центрирования
-        // Используем ADC_OFFSET как приближение
-        String waveformData = oscilloscope.toLineProtocol(
-            DEVICE_ID, 
-            ADC_OFFSET, ADC_OFFSET, ADC_OFFSET
-        );
-        
-        // Отправляем в InfluxDB
-        SendStatus wfStatus = influxClient.send(waveformData);
+        const WaveformData& wave = oscilloscope.getData();
+        SendStatus wfStatus;
+        if (uplinkTransport == UPLINK_MQTT) {
+            PROFILE_SCOPE(ProfileStage::WAVEFORM_SEND);
+            wfStatus = mqttUplink.publishWaveform(wave, wave.offsets[0], wave.offsets[1], wave.offsets[2]);
+        } else if (uplinkTransport == UPLINK_GATEWAY) {
+            PROFILE_SCOPE(ProfileStage::WAVEFORM_SEND);
+            wfStatus = gatewayUplink.publishWaveform(wave, wave.offsets[0], wave.offsets[1], wave.offsets[2]);
+        } else {
+            size_t length;
+            {
+                PROFILE_SCOPE(ProfileStage::WAVEFORM_SERIALIZE);
+                length = oscilloscope.writeLineProtocol(waveformLines, sizeof(waveformLines), DEVICE_ID);
+            }
+            PROFILE_SCOPE(ProfileStage::WAVEFORM_SEND);
+            wfStatus = influxClient.send(waveformLines, length);
+        }
         if (wfStatus == SendStatus::SUCCESS) {
             Serial.println("[Oscilloscope] Waveform sent");
         } else {
@@ -333,6 +1381,17 @@ void loop() {
         }
     }
     
+#if PROFILING_ENABLED
+    // Статистика горячего пути (раз в минуту)
+    if (currentTime - lastDeviceStats >= DEVICE_STATS_INTERVAL_MS) {
+        lastDeviceStats = currentTime;
+        publishDeviceStats();
+    }
+#endif
+    
+    // Счётчики для /metrics: обработчик читает копию, а не объекты loop()
+    metricsExporter.publish();
+    
     // Небольшая задержка для стабильности
     delay(10);
 }
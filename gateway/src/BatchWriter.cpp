@@ -0,0 +1,103 @@
+#include "BatchWriter.h"
+#include <chrono>
+#include <cstdio>
+
+BatchWriter::BatchWriter(BoundedQueue<PointChunk>& queue, GatewayStats& stats, SinkFactory factory,
+                         size_t batchPoints, int flushMs, int maxRetries)
+    : queue(queue),
+      stats(stats),
+      factory(factory),
+      batchPoints(batchPoints),
+      flushMs(flushMs),
+      maxRetries(maxRetries) {
+}
+
+BatchWriter::~BatchWriter() {
+    stop();
+}
+
+void BatchWriter::start(int threads) {
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([this] { run(); });
+    }
+}
+
+void BatchWriter::stop() {
+    for (std::thread& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers.clear();
+}
+
+void BatchWriter::run() {
+    typedef std::chrono::steady_clock Clock;
+
+    std::unique_ptr<PointSink> sink = factory();
+    std::vector<PointChunk> chunks;
+    chunks.reserve(256);
+
+    std::string body;
+    body.reserve(batchPoints * 64);
+    uint32_t points = 0;
+    Clock::time_point batchStart = Clock::now();
+
+    while (true) {
+        chunks.clear();
+        size_t taken = queue.popBatch(chunks, 256, std::chrono::milliseconds(50));
+
+        for (PointChunk& chunk : chunks) {
+            if (points == 0) {
+                batchStart = Clock::now();
+            }
+            body.append(chunk.lines);
+            points += chunk.points;
+
+            if (points >= batchPoints) {
+                flush(*sink, body, points);
+                points = 0;
+            }
+        }
+
+        bool expired = points > 0 &&
+                       Clock::now() - batchStart >= std::chrono::milliseconds(flushMs);
+        bool finished = taken == 0 && queue.isClosed() && queue.size() == 0;
+
+        if (expired || (finished && points > 0)) {
+            flush(*sink, body, points);
+            points = 0;
+        }
+        if (finished) {
+            break;
+        }
+    }
+}
+
+void BatchWriter::flush(PointSink& sink, std::string& body, uint32_t points) {
+    for (int attempt = 0; attempt <= maxRetries; attempt++) {
+        WriteStatus status = sink.write(body);
+        if (status == WriteStatus::SUCCESS) {
+            stats.pointsWritten += points;
+            stats.batchesWritten++;
+            stats.bytesWritten += body.size();
+            body.clear();
+            return;
+        }
+        if (status == WriteStatus::REJECTED) {
+            // Повтор той же пачки получит тот же ответ, а очередь за ней копится
+            fprintf(stderr, "[BatchWriter] Batch of %u points rejected by InfluxDB, dropped\n", points);
+            stats.pointsRejected += points;
+            stats.batchesRejected++;
+            body.clear();
+            return;
+        }
+
+        // Экспоненциальная пауза: 100, 200, 400 ... мс
+        std::this_thread::sleep_for(std::chrono::milliseconds(100 << attempt));
+    }
+
+    fprintf(stderr, "[BatchWriter] Batch of %u points dropped after %d retries\n", points, maxRetries);
+    stats.pointsFailed += points;
+    body.clear();
+}
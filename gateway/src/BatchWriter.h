@@ -0,0 +1,55 @@
+#ifndef BATCH_WRITER_H
+#define BATCH_WRITER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "BoundedQueue.h"
+#include "GatewayStats.h"
+#include "InfluxSink.h"
+
+/**
+ * Объединение точек от всех устройств в крупные пачки записи
+ *
+ * Каждый поток записи держит своё соединение (PointSink) и копит строки,
+ * пока не наберёт batchPoints точек или не истечёт flushMs с первой точки.
+ * Пока InfluxDB недоступна, поток повторяет запись с паузой — очередь
+ * заполняется, и обратное давление доходит до потоков приёма. Пачка,
+ * отклонённая сервером (4xx), отбрасывается сразу, без повторов.
+ */
+class BatchWriter {
+public:
+    typedef std::function<std::unique_ptr<PointSink>()> SinkFactory;
+
+    BatchWriter(BoundedQueue<PointChunk>& queue, GatewayStats& stats, SinkFactory factory,
+                size_t batchPoints, int flushMs, int maxRetries);
+    ~BatchWriter();
+
+    /**
+     * Запустить потоки записи
+     * @param threads Количество потоков (и соединений с InfluxDB)
+     */
+    void start(int threads);
+
+    /**
+     * Дописать остаток очереди и остановить потоки (очередь должна быть закрыта)
+     */
+    void stop();
+
+private:
+    BoundedQueue<PointChunk>& queue;
+    GatewayStats& stats;
+    SinkFactory factory;
+    size_t batchPoints;
+    int flushMs;
+    int maxRetries;
+
+    std::vector<std::thread> workers;
+
+    void run();
+    void flush(PointSink& sink, std::string& body, uint32_t points);
+};
+
+#endif // BATCH_WRITER_H
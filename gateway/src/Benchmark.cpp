@@ -0,0 +1,190 @@
+#include "Benchmark.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "BatchWriter.h"
+#include "BoundedQueue.h"
+#include "GatewayStats.h"
+#include "Ingest.h"
+#include "InfluxSink.h"
+#include "TelemetryCodec.h"
+
+static const int POINTS_PER_FRAME = 8;  // FrameProcessor::renderPower
+static const int SEND_BATCH = 32;
+
+static std::atomic<bool> benchRunning(false);
+static std::atomic<uint64_t> framesSent(0);
+
+Benchmark::Benchmark(const GatewayOptions& options) : options(options) {
+}
+
+void Benchmark::sendLoop(int firstDevice, int deviceCount, uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int bufferSize = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    connect(fd, (sockaddr*)&addr, sizeof(addr));
+
+    // Кадры заранее: в бенчмарке меряем шлюз, а не кодирование на стороне устройств
+    std::vector<std::vector<uint8_t>> frames(deviceCount);
+    for (int d = 0; d < deviceCount; d++) {
+        char deviceId[FRAME_DEVICE_ID_LEN + 1];
+        snprintf(deviceId, sizeof(deviceId), "bench-%05d", firstDevice + d);
+
+        PowerData data;
+        memset(&data, 0, sizeof(data));
+        data.voltageA = 220.0f + (d % 7) * 0.5f;
+        data.voltageB = 221.0f - (d % 5) * 0.3f;
+        data.voltageC = 219.5f + (d % 3) * 0.7f;
+        data.voltageAB = 381.0f;
+        data.voltageBC = 382.0f;
+        data.voltageCA = 380.5f;
+        data.frequencyA = data.frequencyB = data.frequencyC = data.frequencyAvg = 50.0f;
+        data.unbalance = 0.8f;
+
+        std::vector<uint8_t>& frame = frames[d];
+        frame.resize(FRAME_MAX_SIZE);
+        size_t length = sizeof(FrameHeader);
+        length += TelemetryCodec::encodePower(data, 0, (uint32_t)time(nullptr),
+                                              frame.data() + length, frame.size() - length);
+        TelemetryCodec::writeFrameHeader(frame.data(), deviceId, 1, (uint16_t)length);
+        frame.resize(length);
+    }
+
+    iovec iov[SEND_BATCH];
+    mmsghdr messages[SEND_BATCH];
+    memset(messages, 0, sizeof(messages));
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    uint64_t round = 0;
+    int next = 0;
+
+    while (benchRunning) {
+        // Один «раунд» = по кадру от каждого устройства
+        for (int sent = 0; sent < deviceCount && benchRunning;) {
+            int batch = 0;
+            while (batch < SEND_BATCH && sent + batch < deviceCount) {
+                std::vector<uint8_t>& frame = frames[next];
+                iov[batch].iov_base = frame.data();
+                iov[batch].iov_len = frame.size();
+                messages[batch].msg_hdr.msg_iov = &iov[batch];
+                messages[batch].msg_hdr.msg_iovlen = 1;
+                next = (next + 1) % deviceCount;
+                batch++;
+            }
+            int n = sendmmsg(fd, messages, batch, 0);
+            if (n > 0) {
+                framesSent += n;
+            }
+            sent += batch;
+        }
+        round++;
+
+        if (options.benchRateHz > 0) {
+            Clock::time_point due = start + std::chrono::microseconds((int64_t)(round * 1e6 / options.benchRateHz));
+            std::this_thread::sleep_until(due);
+        }
+    }
+
+    close(fd);
+}
+
+int Benchmark::run() {
+    GatewayStats stats;
+    BoundedQueue<PointChunk> queue(options.queueChunks);
+
+    BatchWriter::SinkFactory factory;
+    if (options.benchmarkInflux) {
+        GatewayOptions o = options;
+        factory = [o]() -> std::unique_ptr<PointSink> {
+            return std::unique_ptr<PointSink>(new InfluxSink(o.influxUrl, o.org, o.bucket, o.token, o.httpTimeoutMs));
+        };
+    } else {
+        factory = []() -> std::unique_ptr<PointSink> {
+            return std::unique_ptr<PointSink>(new NullSink());
+        };
+    }
+
+    BatchWriter writer(queue, stats, factory, options.batchPoints, options.flushMs, options.maxRetries);
+    UdpIngest udp(queue, stats);
+    if (!udp.start(0, options.ingestThreads)) {
+        return 1;
+    }
+    writer.start(options.writerThreads);
+
+    printf("[Benchmark] devices=%d senders=%d ingest=%d writers=%d rate=%s sink=%s\n",
+           options.benchDevices, options.benchSenders, options.ingestThreads, options.writerThreads,
+           options.benchRateHz > 0 ? "paced" : "max",
+           options.benchmarkInflux ? options.influxUrl.c_str() : "null");
+
+    benchRunning = true;
+    std::vector<std::thread> senders;
+    int perSender = (options.benchDevices + options.benchSenders - 1) / options.benchSenders;
+    for (int s = 0; s < options.benchSenders; s++) {
+        int first = s * perSender;
+        int count = std::min(perSender, options.benchDevices - first);
+        if (count <= 0) {
+            break;
+        }
+        uint16_t port = udp.getPort();
+        senders.emplace_back([this, first, count, port] { sendLoop(first, count, port); });
+    }
+
+    // Прогрев, затем окно измерения
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    uint64_t sent0 = framesSent;
+    uint64_t received0 = stats.framesReceived;
+    uint64_t written0 = stats.pointsWritten;
+    uint64_t batches0 = stats.batchesWritten;
+    uint64_t bytes0 = stats.bytesWritten;
+    uint64_t dropped0 = stats.framesDropped;
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::this_thread::sleep_for(std::chrono::seconds(options.benchSeconds));
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    uint64_t sent = framesSent - sent0;
+    uint64_t received = stats.framesReceived - received0;
+    uint64_t written = stats.pointsWritten - written0;
+    uint64_t batches = stats.batchesWritten - batches0;
+    uint64_t bytes = stats.bytesWritten - bytes0;
+    uint64_t dropped = stats.framesDropped - dropped0;
+
+    benchRunning = false;
+    for (std::thread& sender : senders) {
+        sender.join();
+    }
+    udp.stop();
+    queue.close();
+    writer.stop();
+
+    double lost = sent > 0 ? 100.0 * (double)(sent - std::min(sent, received)) / (double)sent : 0.0;
+    double pointsPerSec = written / elapsed;
+
+    printf("[Benchmark] Window %.1f s\n", elapsed);
+    printf("  frames sent:        %.0f /s\n", sent / elapsed);
+    printf("  frames decoded:     %.0f /s (lost before decode %.2f%%, backpressure drops %llu)\n",
+           received / elapsed, lost, (unsigned long long)dropped);
+    printf("  points written:     %.0f /s in %.1f batches/s (avg %.0f points/batch, %.1f MB/s line protocol)\n",
+           pointsPerSec, batches / elapsed, batches > 0 ? (double)written / batches : 0.0,
+           bytes / elapsed / 1e6);
+    printf("  %s: %.0f points/s = %.0f devices x %d points/s (1 Hz PowerData)\n",
+           options.benchRateHz > 0 ? "sustained at offered load" : "sustained capacity",
+           pointsPerSec, std::floor(pointsPerSec / POINTS_PER_FRAME), POINTS_PER_FRAME);
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "GatewayOptions.h"
+
+/**
+ * Встроенный бенчмарк шлюза
+ *
+ * Поднимает полный путь приёма (UDP на loopback → разбор → очередь →
+ * пачки) и нагружает его синтетическими устройствами, которые шлют
+ * кадры PowerData, закодированные тем же TelemetryCodec, что и прошивка.
+ * По умолчанию запись идёт в NullSink — измеряется сам шлюз.
+ * Итог: устойчивые точки/с и эквивалентное число устройств при 1 Гц.
+ */
+class Benchmark {
+public:
+    explicit Benchmark(const GatewayOptions& options);
+
+    /**
+     * @return Код завершения процесса
+     */
+    int run();
+
+private:
+    GatewayOptions options;
+
+    void sendLoop(int firstDevice, int deviceCount, uint16_t port);
+};
+
+#endif // BENCHMARK_H
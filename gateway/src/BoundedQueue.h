@@ -0,0 +1,106 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/**
+ * Ограниченная очередь между потоками приёма и потоками записи.
+ * Заполненная очередь — сигнал обратного давления: UDP отбрасывает кадры,
+ * TCP перестаёт читать сокет и тормозит отправителя.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+    /**
+     * Добавить без ожидания
+     * @return false если очередь заполнена или закрыта
+     */
+    bool tryPush(T&& item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed || items.size() >= capacity) {
+                return false;
+            }
+            items.push_back(std::move(item));
+        }
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * Добавить, ожидая свободного места не дольше timeout
+     */
+    bool push(T&& item, std::chrono::milliseconds timeout) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!notFull.wait_for(lock, timeout, [this] { return closed || items.size() < capacity; })) {
+                return false;
+            }
+            if (closed) {
+                return false;
+            }
+            items.push_back(std::move(item));
+        }
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * Забрать до maxItems элементов, ожидая первый не дольше timeout
+     * @return Количество забранных элементов
+     */
+    size_t popBatch(std::vector<T>& out, size_t maxItems, std::chrono::milliseconds timeout) {
+        size_t taken = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait_for(lock, timeout, [this] { return closed || !items.empty(); });
+            while (!items.empty() && taken < maxItems) {
+                out.push_back(std::move(items.front()));
+                items.pop_front();
+                taken++;
+            }
+        }
+        if (taken > 0) {
+            notFull.notify_all();
+        }
+        return taken;
+    }
+
+    /**
+     * Закрыть очередь: новые элементы не принимаются, ожидающие просыпаются
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    bool isClosed() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return closed;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+};
+
+#endif // BOUNDED_QUEUE_H
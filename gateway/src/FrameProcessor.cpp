@@ -0,0 +1,115 @@
+#include "FrameProcessor.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+FrameProcessor::FrameProcessor(GatewayStats& stats) : stats(stats) {
+    memset(&waveform, 0, sizeof(waveform));
+}
+
+bool FrameProcessor::process(const uint8_t* data, size_t size, uint32_t receivedSec, PointChunk& chunk) {
+    FrameHeader frame;
+    if (!TelemetryCodec::decodeFrameHeader(data, size, frame) || frame.length > size) {
+        stats.framesInvalid++;
+        return false;
+    }
+
+    // deviceId в кадре может занимать всё поле без завершающего нуля
+    char device[FRAME_DEVICE_ID_LEN + 1];
+    memcpy(device, frame.deviceId, FRAME_DEVICE_ID_LEN);
+    device[FRAME_DEVICE_ID_LEN] = '\0';
+
+    // Пробел, запятая и '=' ломают тег Line Protocol
+    for (char* c = device; *c != '\0'; c++) {
+        if (*c == ' ' || *c == ',' || *c == '=') {
+            *c = '_';
+        }
+    }
+
+    size_t offset = sizeof(FrameHeader);
+    for (uint8_t r = 0; r < frame.recordCount; r++) {
+        RecordHeader header;
+        if (!TelemetryCodec::decodeRecordHeader(data + offset, frame.length - offset, header)) {
+            stats.framesInvalid++;
+            return false;
+        }
+
+        const uint8_t* payload = data + offset + sizeof(RecordHeader);
+        uint32_t ts = header.unixTime != 0 ? header.unixTime : receivedSec;
+
+        switch (header.type) {
+            case RECORD_POWER: {
+                PowerData power;
+                if (TelemetryCodec::decodePower(header, payload, power)) {
+                    renderPower(device, power, ts, chunk);
+                }
+                break;
+            }
+            case RECORD_EVENT: {
+                EventRecord event;
+                if (TelemetryCodec::decodeEvent(header, payload, event)) {
+                    renderEvent(device, event, ts, chunk);
+                }
+                break;
+            }
+            case RECORD_WAVEFORM:
+                if (TelemetryCodec::decodeWaveform(header, payload, waveform)) {
+                    renderWaveform(device, waveform, ts, chunk);
+                }
+                break;
+            default:
+                break;  // Неизвестные типы пропускаем — совместимость с новыми прошивками
+        }
+
+        offset += sizeof(RecordHeader) + header.length;
+    }
+
+    stats.framesReceived++;
+    return true;
+}
+
+void FrameProcessor::appendLine(PointChunk& chunk, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (len > 0) {
+        chunk.lines.append(line, (size_t)len < sizeof(line) ? (size_t)len : sizeof(line) - 1);
+        chunk.lines.push_back('\n');
+        chunk.points++;
+    }
+}
+
+void FrameProcessor::renderPower(const char* device, const PowerData& d, uint32_t ts, PointChunk& chunk) {
+    appendLine(chunk, "voltage,device=%s,phase=A value=%.2f %u", device, d.voltageA, ts);
+    appendLine(chunk, "voltage,device=%s,phase=B value=%.2f %u", device, d.voltageB, ts);
+    appendLine(chunk, "voltage,device=%s,phase=C value=%.2f %u", device, d.voltageC, ts);
+    appendLine(chunk, "line_voltage,device=%s,phases=AB value=%.2f %u", device, d.voltageAB, ts);
+    appendLine(chunk, "line_voltage,device=%s,phases=BC value=%.2f %u", device, d.voltageBC, ts);
+    appendLine(chunk, "line_voltage,device=%s,phases=CA value=%.2f %u", device, d.voltageCA, ts);
+    appendLine(chunk, "frequency,device=%s value=%.3f %u", device, d.frequencyAvg, ts);
+    appendLine(chunk, "unbalance,device=%s value=%.2f %u", device, d.unbalance, ts);
+}
+
+void FrameProcessor::renderEvent(const char* device, const EventRecord& e, uint32_t ts, PointChunk& chunk) {
+    appendLine(chunk,
+               "power_event,device=%s flags=%ui,raised=%ui,cleared=%ui,"
+               "voltage_a=%.2f,voltage_b=%.2f,voltage_c=%.2f,frequency=%.3f %u",
+               device, e.problemFlags, e.raised, e.cleared,
+               e.voltage[0] / 100.0f, e.voltage[1] / 100.0f, e.voltage[2] / 100.0f,
+               e.frequency / 1000.0f, ts);
+}
+
+void FrameProcessor::renderWaveform(const char* device, const WaveformData& w, uint32_t ts, PointChunk& chunk) {
+    const int16_t* phases[3] = { w.phaseA, w.phaseB, w.phaseC };
+    const char names[3] = { 'A', 'B', 'C' };
+
+    for (uint32_t i = 0; i < w.sampleCount; i++) {
+        for (int p = 0; p < 3; p++) {
+            appendLine(chunk, "waveform,device=%s,phase=%c,idx=%u value=%d %u",
+                       device, names[p], i, phases[p][i], ts);
+        }
+    }
+}
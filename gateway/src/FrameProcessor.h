@@ -0,0 +1,43 @@
+#ifndef FRAME_PROCESSOR_H
+#define FRAME_PROCESSOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "GatewayStats.h"
+#include "TelemetryCodec.h"
+
+/**
+ * Разбор бинарных кадров устройств и перевод записей в Line Protocol
+ *
+ * Кадр декодируется теми же структурами, что и в прошивке (PowerData,
+ * WaveformData, TelemetryCodec). Строки совпадают с тем, что устройство
+ * отправляло бы в InfluxDB напрямую, плюс метка времени (precision=s).
+ * Объект не потокобезопасен — по одному на поток приёма.
+ */
+class FrameProcessor {
+public:
+    explicit FrameProcessor(GatewayStats& stats);
+
+    /**
+     * Разобрать один кадр и дописать его точки в chunk
+     * @param data Кадр (FrameHeader + записи)
+     * @param size Размер данных
+     * @param receivedSec Время приёма, если устройство не знает UTC
+     * @return false если кадр повреждён
+     */
+    bool process(const uint8_t* data, size_t size, uint32_t receivedSec, PointChunk& chunk);
+
+private:
+    GatewayStats& stats;
+    WaveformData waveform;  // Рабочий буфер, ~600 байт
+
+    void renderPower(const char* device, const PowerData& data, uint32_t ts, PointChunk& chunk);
+    void renderEvent(const char* device, const EventRecord& event, uint32_t ts, PointChunk& chunk);
+    void renderWaveform(const char* device, const WaveformData& data, uint32_t ts, PointChunk& chunk);
+
+    static void appendLine(PointChunk& chunk, const char* format, ...)
+        __attribute__((format(printf, 2, 3)));
+};
+
+#endif // FRAME_PROCESSOR_H
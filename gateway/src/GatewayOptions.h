@@ -0,0 +1,36 @@
+#ifndef GATEWAY_OPTIONS_H
+#define GATEWAY_OPTIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Параметры шлюза (командная строка, токен — из INFLUX_TOKEN)
+ */
+struct GatewayOptions {
+    uint16_t udpPort = 8094;
+    uint16_t tcpPort = 8094;
+    int ingestThreads = 4;
+    int writerThreads = 2;
+    size_t queueChunks = 16384;     // Ёмкость очереди в порциях (порция = пачка recvmmsg или кадр TCP)
+    size_t batchPoints = 5000;      // Точек в одной записи InfluxDB
+    int flushMs = 1000;             // Максимальная задержка точки в шлюзе
+    int maxRetries = 5;
+    int httpTimeoutMs = 5000;
+
+    std::string influxUrl = "http://localhost:8086";
+    std::string org = "home";
+    std::string bucket = "power_monitoring";
+    std::string token;
+
+    // Бенчмарк
+    bool benchmark = false;
+    bool benchmarkInflux = false;   // Писать в настоящую InfluxDB вместо NullSink
+    int benchDevices = 100;
+    int benchSeconds = 10;
+    int benchSenders = 2;
+    double benchRateHz = 0;         // Кадров в секунду на устройство, 0 = без ограничения
+};
+
+#endif // GATEWAY_OPTIONS_H
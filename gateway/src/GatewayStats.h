@@ -0,0 +1,33 @@
+#ifndef GATEWAY_STATS_H
+#define GATEWAY_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * Порция готовых строк Line Protocol от одного или нескольких кадров
+ */
+struct PointChunk {
+    std::string lines;      // Строки, каждая завершается '\n'
+    uint32_t points;
+};
+
+/**
+ * Счётчики шлюза (обновляются из всех потоков)
+ */
+struct GatewayStats {
+    std::atomic<uint64_t> framesReceived{0};
+    std::atomic<uint64_t> framesInvalid{0};
+    std::atomic<uint64_t> framesDropped{0};     // Очередь заполнена (обратное давление)
+    std::atomic<uint64_t> pointsQueued{0};
+    std::atomic<uint64_t> pointsWritten{0};
+    std::atomic<uint64_t> pointsFailed{0};      // Пачка не записана после повторов
+    std::atomic<uint64_t> pointsRejected{0};    // Пачка отклонена сервером (4xx), без повторов
+    std::atomic<uint64_t> batchesRejected{0};
+    std::atomic<uint64_t> batchesWritten{0};
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> tcpConnections{0};
+};
+
+#endif // GATEWAY_STATS_H
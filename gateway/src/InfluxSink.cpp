@@ -0,0 +1,210 @@
+#include "InfluxSink.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+InfluxSink::InfluxSink(const std::string& url, const std::string& org, const std::string& bucket,
+                       const std::string& token, int timeoutMs)
+    : token(token),
+      timeoutMs(timeoutMs),
+      fd(-1) {
+    // http://host[:port][/]
+    std::string rest = url;
+    const std::string scheme = "http://";
+    if (rest.compare(0, scheme.size(), scheme) == 0) {
+        rest = rest.substr(scheme.size());
+    }
+    size_t slash = rest.find('/');
+    if (slash != std::string::npos) {
+        rest = rest.substr(0, slash);
+    }
+    size_t colon = rest.find(':');
+    host = rest.substr(0, colon);
+    port = colon == std::string::npos ? "8086" : rest.substr(colon + 1);
+
+    writePath = "/api/v2/write?org=" + org + "&bucket=" + bucket + "&precision=s";
+}
+
+InfluxSink::~InfluxSink() {
+    disconnect();
+}
+
+bool InfluxSink::connectToServer() {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+        fprintf(stderr, "[InfluxSink] Cannot resolve %s\n", host.c_str());
+        return false;
+    }
+
+    for (addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+
+        timeval tv;
+        tv.tv_sec = timeoutMs / 1000;
+        tv.tv_usec = (timeoutMs % 1000) * 1000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+
+    if (fd < 0) {
+        fprintf(stderr, "[InfluxSink] Connection to %s:%s failed\n", host.c_str(), port.c_str());
+        return false;
+    }
+    return true;
+}
+
+void InfluxSink::disconnect() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+bool InfluxSink::sendAll(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += sent;
+        size -= (size_t)sent;
+    }
+    return true;
+}
+
+int InfluxSink::readResponse() {
+    std::string response;
+    char buffer[4096];
+    size_t headerEnd = std::string::npos;
+
+    while (headerEnd == std::string::npos) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return -1;
+        }
+        response.append(buffer, (size_t)n);
+        headerEnd = response.find("\r\n\r\n");
+    }
+
+    int code = -1;
+    if (sscanf(response.c_str(), "HTTP/1.%*d %d", &code) != 1) {
+        return -1;
+    }
+
+    // Дочитываем тело по Content-Length, чтобы соединение осталось пригодным
+    size_t contentLength = 0;
+    bool keepAlive = true;
+    size_t pos = 0;
+    while (pos < headerEnd) {
+        size_t eol = response.find("\r\n", pos);
+        std::string line = response.substr(pos, eol - pos);
+        if (strncasecmp(line.c_str(), "Content-Length:", 15) == 0) {
+            contentLength = strtoul(line.c_str() + 15, nullptr, 10);
+        } else if (strncasecmp(line.c_str(), "Connection:", 11) == 0 &&
+                   line.find("close") != std::string::npos) {
+            keepAlive = false;
+        }
+        pos = eol + 2;
+    }
+
+    size_t bodyReceived = response.size() - (headerEnd + 4);
+    while (bodyReceived < contentLength) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return -1;
+        }
+        bodyReceived += (size_t)n;
+    }
+
+    if (code != 204) {
+        fprintf(stderr, "[InfluxSink] HTTP %d: %s\n", code,
+                response.substr(headerEnd + 4, 200).c_str());
+    }
+    if (!keepAlive) {
+        disconnect();
+    }
+    return code;
+}
+
+WriteStatus InfluxSink::write(const std::string& body) {
+    char header[1024];
+    int headerLen = snprintf(header, sizeof(header),
+                             "POST %s HTTP/1.1\r\n"
+                             "Host: %s:%s\r\n"
+                             "Authorization: Token %s\r\n"
+                             "Content-Type: text/plain; charset=utf-8\r\n"
+                             "Content-Length: %zu\r\n"
+                             "Connection: keep-alive\r\n"
+                             "\r\n",
+                             writePath.c_str(), host.c_str(), port.c_str(),
+                             token.c_str(), body.size());
+    if (headerLen <= 0 || (size_t)headerLen >= sizeof(header)) {
+        return WriteStatus::REJECTED;
+    }
+
+    // Одна повторная попытка: сервер мог закрыть простаивавшее keep-alive соединение
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (fd < 0 && !connectToServer()) {
+            return WriteStatus::RETRY;
+        }
+
+        if (sendAll(header, (size_t)headerLen) && sendAll(body.data(), body.size())) {
+            int code = readResponse();
+            if (code == 204) {
+                return WriteStatus::SUCCESS;
+            }
+            if (code >= 400 && code < 500 && code != 408 && code != 429) {
+                return WriteStatus::REJECTED;  // Пачка отклонена как есть — повтор не поможет
+            }
+            if (code > 0) {
+                return WriteStatus::RETRY;     // Сервер перегружен или недоступен за прокси
+            }
+        }
+        disconnect();
+    }
+    return WriteStatus::RETRY;
+}
+
+bool InfluxSink::ping() {
+    if (fd < 0 && !connectToServer()) {
+        return false;
+    }
+
+    char request[256];
+    int len = snprintf(request, sizeof(request),
+                       "GET /ping HTTP/1.1\r\nHost: %s:%s\r\nConnection: keep-alive\r\n\r\n",
+                       host.c_str(), port.c_str());
+    if (!sendAll(request, (size_t)len)) {
+        disconnect();
+        return false;
+    }
+    return readResponse() == 204;
+}
@@ -0,0 +1,83 @@
+#ifndef INFLUX_SINK_H
+#define INFLUX_SINK_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Результат записи пачки
+ */
+enum class WriteStatus {
+    SUCCESS,
+    RETRY,          // Нет соединения, таймаут, 408/429/5xx — повтор может пройти
+    REJECTED        // Сервер отклонил пачку (400, 401, 413, 422...) — повтор не поможет
+};
+
+/**
+ * Получатель пачек Line Protocol
+ */
+class PointSink {
+public:
+    virtual ~PointSink() {}
+
+    /**
+     * Записать пачку
+     * @param body Строки Line Protocol
+     */
+    virtual WriteStatus write(const std::string& body) = 0;
+};
+
+/**
+ * Пустой получатель для бенчмарка: измеряет сам шлюз без InfluxDB
+ */
+class NullSink : public PointSink {
+public:
+    WriteStatus write(const std::string&) override { return WriteStatus::SUCCESS; }
+};
+
+/**
+ * Запись в InfluxDB 2.x: POST /api/v2/write по постоянному HTTP/1.1 соединению
+ *
+ * Одно соединение на поток записи, переподключение при ошибке.
+ * Поддерживается только http:// (шлюз стоит рядом с InfluxDB).
+ */
+class InfluxSink : public PointSink {
+public:
+    /**
+     * @param url Например "http://localhost:8086"
+     * @param org Организация
+     * @param bucket Bucket
+     * @param token Токен авторизации
+     * @param timeoutMs Таймаут сокета
+     */
+    InfluxSink(const std::string& url, const std::string& org, const std::string& bucket,
+               const std::string& token, int timeoutMs);
+    ~InfluxSink() override;
+
+    WriteStatus write(const std::string& body) override;
+
+    /**
+     * Проверить доступность сервера (GET /ping → 204)
+     */
+    bool ping();
+
+private:
+    std::string host;
+    std::string port;
+    std::string writePath;
+    std::string token;
+    int timeoutMs;
+    int fd;
+
+    bool connectToServer();
+    void disconnect();
+    bool sendAll(const char* data, size_t size);
+
+    /**
+     * Прочитать ответ целиком (для keep-alive нужно дочитать тело)
+     * @return HTTP код или -1 при ошибке
+     */
+    int readResponse();
+};
+
+#endif // INFLUX_SINK_H
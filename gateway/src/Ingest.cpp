@@ -0,0 +1,318 @@
+#include "Ingest.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "FrameProcessor.h"
+
+static const int UDP_BATCH = 64;
+static const int SOCKET_TIMEOUT_MS = 200;
+
+static void setReceiveTimeout(int fd, int timeoutMs) {
+    timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+// =============================================================================
+// UdpIngest
+// =============================================================================
+
+UdpIngest::UdpIngest(BoundedQueue<PointChunk>& queue, GatewayStats& stats)
+    : queue(queue),
+      stats(stats),
+      running(false),
+      boundPort(0) {
+}
+
+UdpIngest::~UdpIngest() {
+    stop();
+}
+
+int UdpIngest::openSocket(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+    // Запас на всплески: ядро ограничит значением net.core.rmem_max
+    int bufferSize = 8 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    setReceiveTimeout(fd, SOCKET_TIMEOUT_MS);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "[UdpIngest] bind(%u) failed: %s\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool UdpIngest::start(uint16_t port, int threads) {
+    // Первый сокет определяет порт (важно для port = 0), остальные присоединяются
+    int first = openSocket(port);
+    if (first < 0) {
+        return false;
+    }
+
+    sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(first, (sockaddr*)&addr, &len);
+    boundPort = ntohs(addr.sin_port);
+    sockets.push_back(first);
+
+    for (int i = 1; i < threads; i++) {
+        int fd = openSocket(boundPort);
+        if (fd < 0) {
+            break;
+        }
+        sockets.push_back(fd);
+    }
+
+    running = true;
+    for (int fd : sockets) {
+        workers.emplace_back([this, fd] { run(fd); });
+    }
+
+    printf("[UdpIngest] Listening on UDP :%u with %zu threads\n", boundPort, sockets.size());
+    return true;
+}
+
+void UdpIngest::stop() {
+    running = false;
+    for (std::thread& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers.clear();
+    for (int fd : sockets) {
+        close(fd);
+    }
+    sockets.clear();
+}
+
+uint16_t UdpIngest::getPort() const {
+    return boundPort;
+}
+
+void UdpIngest::run(int fd) {
+    FrameProcessor processor(stats);
+
+    std::vector<uint8_t> storage((size_t)UDP_BATCH * FRAME_MAX_SIZE);
+    uint8_t* buffers[UDP_BATCH];
+    iovec iov[UDP_BATCH];
+    mmsghdr messages[UDP_BATCH];
+
+    for (int i = 0; i < UDP_BATCH; i++) {
+        buffers[i] = storage.data() + (size_t)i * FRAME_MAX_SIZE;
+        iov[i].iov_base = buffers[i];
+        iov[i].iov_len = FRAME_MAX_SIZE;
+        memset(&messages[i], 0, sizeof(messages[i]));
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (running) {
+        int received = recvmmsg(fd, messages, UDP_BATCH, MSG_WAITFORONE, nullptr);
+        if (received <= 0) {
+            continue;  // Таймаут — проверяем флаг остановки
+        }
+
+        uint32_t now = (uint32_t)time(nullptr);
+        PointChunk chunk;
+        chunk.points = 0;
+        chunk.lines.reserve((size_t)received * 8 * 64);
+
+        int frames = 0;
+        for (int i = 0; i < received; i++) {
+            if (processor.process(buffers[i], messages[i].msg_len, now, chunk)) {
+                frames++;
+            }
+        }
+
+        if (chunk.points == 0) {
+            continue;
+        }
+
+        uint32_t points = chunk.points;
+        if (queue.tryPush(std::move(chunk))) {
+            stats.pointsQueued += points;
+        } else {
+            stats.framesDropped += frames;
+        }
+    }
+}
+
+// =============================================================================
+// TcpIngest
+// =============================================================================
+
+TcpIngest::TcpIngest(BoundedQueue<PointChunk>& queue, GatewayStats& stats)
+    : queue(queue),
+      stats(stats),
+      running(false),
+      listenFd(-1) {
+}
+
+TcpIngest::~TcpIngest() {
+    stop();
+}
+
+bool TcpIngest::start(uint16_t port) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setReceiveTimeout(listenFd, SOCKET_TIMEOUT_MS);
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 128) != 0) {
+        fprintf(stderr, "[TcpIngest] listen(%u) failed: %s\n", port, strerror(errno));
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    running = true;
+    acceptor = std::thread([this] { acceptLoop(); });
+
+    printf("[TcpIngest] Listening on TCP :%u\n", port);
+    return true;
+}
+
+void TcpIngest::stop() {
+    running = false;
+    if (acceptor.joinable()) {
+        acceptor.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (int fd : connections) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+    for (Handler& handler : handlers) {
+        if (handler.thread.joinable()) {
+            handler.thread.join();
+        }
+    }
+    handlers.clear();
+
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+void TcpIngest::acceptLoop() {
+    while (running) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+
+        setReceiveTimeout(fd, SOCKET_TIMEOUT_MS);
+        stats.tcpConnections++;
+
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        reapHandlers();
+        connections.insert(fd);
+        handlers.emplace_back();
+        Handler& handler = handlers.back();
+        handler.thread = std::thread([this, fd, &handler] {
+            handleConnection(fd);
+            handler.done = true;
+        });
+    }
+}
+
+void TcpIngest::reapHandlers() {
+    for (auto it = handlers.begin(); it != handlers.end();) {
+        if (it->done) {
+            it->thread.join();
+            it = handlers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool TcpIngest::readExact(int fd, uint8_t* buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = recv(fd, buffer + done, size - done, 0);
+        if (n > 0) {
+            done += (size_t)n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && running) {
+            continue;  // Таймаут чтения — соединение живо, ждём дальше
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TcpIngest::handleConnection(int fd) {
+    FrameProcessor processor(stats);
+    uint8_t buffer[FRAME_MAX_SIZE];
+
+    while (running) {
+        FrameHeader header;
+        if (!readExact(fd, buffer, sizeof(FrameHeader)) ||
+            !TelemetryCodec::decodeFrameHeader(buffer, sizeof(FrameHeader), header)) {
+            break;  // Разрыв или рассинхронизация потока — закрываем соединение
+        }
+        if (!readExact(fd, buffer + sizeof(FrameHeader), header.length - sizeof(FrameHeader))) {
+            break;
+        }
+
+        PointChunk chunk;
+        chunk.points = 0;
+        if (!processor.process(buffer, header.length, (uint32_t)time(nullptr), chunk) || chunk.points == 0) {
+            continue;
+        }
+
+        // Обратное давление: ждём места в очереди, не читая сокет
+        uint32_t points = chunk.points;
+        bool queued = false;
+        while (running && !queue.isClosed() && !queued) {
+            queued = queue.push(std::move(chunk), std::chrono::milliseconds(SOCKET_TIMEOUT_MS));
+        }
+        if (queued) {
+            stats.pointsQueued += points;
+        } else {
+            stats.framesDropped++;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    connections.erase(fd);
+    close(fd);
+}
@@ -0,0 +1,90 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "BoundedQueue.h"
+#include "GatewayStats.h"
+
+/**
+ * Приём кадров по UDP: несколько потоков на одном порту (SO_REUSEPORT),
+ * ядро распределяет датаграммы между ними. Каждый поток читает пачками
+ * через recvmmsg() и складывает точки всей пачки в одну порцию очереди.
+ * При заполненной очереди кадры отбрасываются (UDP без управления потоком).
+ */
+class UdpIngest {
+public:
+    UdpIngest(BoundedQueue<PointChunk>& queue, GatewayStats& stats);
+    ~UdpIngest();
+
+    /**
+     * Открыть порт и запустить потоки
+     * @param port UDP-порт (0 — выбрать свободный, см. getPort())
+     * @return false если порт не удалось открыть
+     */
+    bool start(uint16_t port, int threads);
+
+    void stop();
+
+    uint16_t getPort() const;
+
+private:
+    BoundedQueue<PointChunk>& queue;
+    GatewayStats& stats;
+    std::atomic<bool> running;
+    uint16_t boundPort;
+    std::vector<int> sockets;
+    std::vector<std::thread> workers;
+
+    int openSocket(uint16_t port);
+    void run(int fd);
+};
+
+/**
+ * Приём кадров по TCP: поток на соединение, кадры идут подряд
+ * (FrameHeader.length задаёт границы). При заполненной очереди поток
+ * перестаёт читать сокет — окно TCP закрывается и устройство притормаживает.
+ * Потоки закрытых соединений присоединяются при следующем подключении, так
+ * что переподключения устройств не копят потоки.
+ */
+class TcpIngest {
+public:
+    TcpIngest(BoundedQueue<PointChunk>& queue, GatewayStats& stats);
+    ~TcpIngest();
+
+    bool start(uint16_t port);
+    void stop();
+
+private:
+    BoundedQueue<PointChunk>& queue;
+    GatewayStats& stats;
+    std::atomic<bool> running;
+    int listenFd;
+    std::thread acceptor;
+
+    // Поток соединения; done — handleConnection() вернулся, поток можно присоединить
+    struct Handler {
+        std::thread thread;
+        std::atomic<bool> done{false};
+    };
+
+    std::mutex connectionsMutex;
+    std::set<int> connections;
+    std::list<Handler> handlers;    // Завершённые убираются при следующем accept()
+
+    /**
+     * Присоединить завершённые потоки соединений (под connectionsMutex)
+     */
+    void reapHandlers();
+
+    void acceptLoop();
+    void handleConnection(int fd);
+    bool readExact(int fd, uint8_t* buffer, size_t size);
+};
+
+#endif // INGEST_H
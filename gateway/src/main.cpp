@@ -0,0 +1,219 @@
+/**
+ * Шлюз парка устройств: бинарные кадры по UDP/TCP → пачки в InfluxDB
+ *
+ * Устройства (UPLINK_GATEWAY) шлют компактные кадры TelemetryCodec вместо
+ * HTTP/Line Protocol. Шлюз разбирает их в нескольких потоках приёма,
+ * объединяет точки всех устройств и пишет в InfluxDB крупными пачками
+ * по постоянным соединениям.
+ *
+ *   oscillator-gateway --influx-url http://localhost:8086 --org home --bucket power_monitoring
+ *   oscillator-gateway --bench --devices 500 --seconds 10
+ */
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include "BatchWriter.h"
+#include "Benchmark.h"
+#include "BoundedQueue.h"
+#include "GatewayOptions.h"
+#include "GatewayStats.h"
+#include "Ingest.h"
+#include "InfluxSink.h"
+
+static std::atomic<bool> stopRequested(false);
+
+static void onSignal(int) {
+    stopRequested = true;
+}
+
+static void printUsage(const char* program) {
+    printf("Usage: %s [options]\n"
+           "  --udp-port N        UDP port for device frames (default 8094, 0 = off)\n"
+           "  --tcp-port N        TCP port for device frames (default 8094, 0 = off)\n"
+           "  --ingest-threads N  UDP receive threads (default 4)\n"
+           "  --writer-threads N  InfluxDB writer threads/connections (default 2)\n"
+           "  --queue N           Queue capacity in chunks (default 16384)\n"
+           "  --batch-points N    Points per InfluxDB write (default 5000)\n"
+           "  --flush-ms N        Max time a point waits in the gateway (default 1000)\n"
+           "  --influx-url URL    InfluxDB base URL (default http://localhost:8086)\n"
+           "  --org NAME          InfluxDB organization (default home)\n"
+           "  --bucket NAME       InfluxDB bucket (default power_monitoring)\n"
+           "  Token is read from the INFLUX_TOKEN environment variable.\n"
+           "\n"
+           "Benchmark:\n"
+           "  --bench             Run the built-in load test and exit\n"
+           "  --devices N         Simulated devices (default 100)\n"
+           "  --seconds N         Measurement window (default 10)\n"
+           "  --senders N         Sender threads (default 2)\n"
+           "  --rate HZ           Frames per second per device (default 0 = max)\n"
+           "  --bench-influx      Write to the real InfluxDB instead of a null sink\n",
+           program);
+}
+
+static bool parseOptions(int argc, char** argv, GatewayOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        auto needValue = [&]() -> bool {
+            if (value == nullptr) {
+                fprintf(stderr, "Missing value for %s\n", arg);
+                return false;
+            }
+            i++;
+            return true;
+        };
+
+        if (strcmp(arg, "--udp-port") == 0) {
+            if (!needValue()) return false;
+            options.udpPort = (uint16_t)atoi(value);
+        } else if (strcmp(arg, "--tcp-port") == 0) {
+            if (!needValue()) return false;
+            options.tcpPort = (uint16_t)atoi(value);
+        } else if (strcmp(arg, "--ingest-threads") == 0) {
+            if (!needValue()) return false;
+            options.ingestThreads = atoi(value);
+        } else if (strcmp(arg, "--writer-threads") == 0) {
+            if (!needValue()) return false;
+            options.writerThreads = atoi(value);
+        } else if (strcmp(arg, "--queue") == 0) {
+            if (!needValue()) return false;
+            options.queueChunks = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--batch-points") == 0) {
+            if (!needValue()) return false;
+            options.batchPoints = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--flush-ms") == 0) {
+            if (!needValue()) return false;
+            options.flushMs = atoi(value);
+        } else if (strcmp(arg, "--influx-url") == 0) {
+            if (!needValue()) return false;
+            options.influxUrl = value;
+        } else if (strcmp(arg, "--org") == 0) {
+            if (!needValue()) return false;
+            options.org = value;
+        } else if (strcmp(arg, "--bucket") == 0) {
+            if (!needValue()) return false;
+            options.bucket = value;
+        } else if (strcmp(arg, "--bench") == 0) {
+            options.benchmark = true;
+        } else if (strcmp(arg, "--bench-influx") == 0) {
+            options.benchmarkInflux = true;
+        } else if (strcmp(arg, "--devices") == 0) {
+            if (!needValue()) return false;
+            options.benchDevices = atoi(value);
+        } else if (strcmp(arg, "--seconds") == 0) {
+            if (!needValue()) return false;
+            options.benchSeconds = atoi(value);
+        } else if (strcmp(arg, "--senders") == 0) {
+            if (!needValue()) return false;
+            options.benchSenders = atoi(value);
+        } else if (strcmp(arg, "--rate") == 0) {
+            if (!needValue()) return false;
+            options.benchRateHz = atof(value);
+        } else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (options.ingestThreads < 1 || options.writerThreads < 1 ||
+        options.queueChunks == 0 || options.batchPoints == 0 || options.benchSenders < 1) {
+        fprintf(stderr, "Thread counts, queue and batch sizes must be positive\n");
+        return false;
+    }
+
+    const char* token = getenv("INFLUX_TOKEN");
+    if (token != nullptr) {
+        options.token = token;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    GatewayOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    if (options.benchmark) {
+        Benchmark benchmark(options);
+        return benchmark.run();
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    {
+        InfluxSink probe(options.influxUrl, options.org, options.bucket, options.token, options.httpTimeoutMs);
+        if (probe.ping()) {
+            printf("[Gateway] InfluxDB %s is reachable\n", options.influxUrl.c_str());
+        } else {
+            printf("[Gateway] Warning: InfluxDB %s not responding, will retry on write\n",
+                   options.influxUrl.c_str());
+        }
+    }
+
+    GatewayStats stats;
+    BoundedQueue<PointChunk> queue(options.queueChunks);
+
+    BatchWriter writer(queue, stats,
+                       [&options]() -> std::unique_ptr<PointSink> {
+                           return std::unique_ptr<PointSink>(new InfluxSink(
+                               options.influxUrl, options.org, options.bucket,
+                               options.token, options.httpTimeoutMs));
+                       },
+                       options.batchPoints, options.flushMs, options.maxRetries);
+    writer.start(options.writerThreads);
+
+    UdpIngest udp(queue, stats);
+    TcpIngest tcp(queue, stats);
+    if (options.udpPort != 0 && !udp.start(options.udpPort, options.ingestThreads)) {
+        return 1;
+    }
+    if (options.tcpPort != 0 && !tcp.start(options.tcpPort)) {
+        return 1;
+    }
+
+    // Статистика раз в 10 секунд
+    uint64_t lastWritten = 0;
+    auto lastReport = std::chrono::steady_clock::now();
+    while (!stopRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - lastReport).count();
+        if (elapsed < 10.0) {
+            continue;
+        }
+
+        uint64_t written = stats.pointsWritten;
+        printf("[Gateway] frames=%llu invalid=%llu dropped=%llu | written=%llu (%.0f points/s) "
+               "failed=%llu rejected=%llu batches=%llu queue=%zu tcp=%llu\n",
+               (unsigned long long)stats.framesReceived.load(),
+               (unsigned long long)stats.framesInvalid.load(),
+               (unsigned long long)stats.framesDropped.load(),
+               (unsigned long long)written, (written - lastWritten) / elapsed,
+               (unsigned long long)stats.pointsFailed.load(),
+               (unsigned long long)stats.pointsRejected.load(),
+               (unsigned long long)stats.batchesWritten.load(),
+               queue.size(),
+               (unsigned long long)stats.tcpConnections.load());
+        fflush(stdout);
+
+        lastWritten = written;
+        lastReport = now;
+    }
+
+    printf("[Gateway] Stopping, flushing queued points...\n");
+    udp.stop();
+    tcp.stop();
+    queue.close();
+    writer.stop();
+    return 0;
+}
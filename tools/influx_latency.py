@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+"""
+Нагрузочная проверка истории в InfluxDB: задержка запросов дашборда по сырым
+данным и по агрегатам power_monitoring_1m / power_monitoring_1h.
+
+Запрос — тот же, что у панели «История напряжений»
+(docker/grafana/dashboards/power-monitoring.json), bucket выбирает переменная
+дашборда ${bucket}. Для каждого диапазона запрос идёт и в сырой bucket (как до
+агрегатов), и в выбранный, и печатается медиана, p95 и число строк.
+
+    docker-compose -f docker/docker-compose.yml up -d influxdb
+    python3 tools/influx_latency.py seed --days 30         # 1 с данных на 30 суток
+    python3 tools/influx_latency.py backfill --days 30     # агрегаты за тот же период
+    python3 tools/influx_latency.py measure --runs 5
+
+Задачи прореживания считают только новые данные, поэтому засеянную историю
+(и историю, записанную до появления задач) агрегирует backfill — теми же
+файлами docker/influxdb/tasks/*.flux.
+"""
+
+import argparse
+import datetime
+import json
+import math
+import os
+import random
+import re
+import statistics
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+DASHBOARD = os.path.join(ROOT, "docker", "grafana", "dashboards", "power-monitoring.json")
+TASKS_DIR = os.path.join(ROOT, "docker", "influxdb", "tasks")
+
+RAW_BUCKET = "power_monitoring"
+HISTORY_PANEL_ID = 7                # «История напряжений»
+MAX_DATA_POINTS = 1000              # Ширина панели в точках, как у Grafana
+RANGES = [("1h", 3600), ("12h", 12 * 3600), ("24h", 86400),
+          ("7d", 7 * 86400), ("30d", 30 * 86400)]
+WRITE_BATCH = 5000
+
+
+class Influx:
+    def __init__(self, url, org, token):
+        self.url = url.rstrip("/")
+        self.org = org
+        self.token = token
+
+    def request(self, path, params, body, content_type):
+        query = urllib.parse.urlencode(dict(params, org=self.org))
+        req = urllib.request.Request(
+            "%s%s?%s" % (self.url, path, query), data=body.encode(), method="POST",
+            headers={"Authorization": "Token " + self.token,
+                     "Content-Type": content_type,
+                     "Accept": "application/csv"})
+        try:
+            with urllib.request.urlopen(req, timeout=300) as resp:
+                return resp.read().decode()
+        except urllib.error.HTTPError as e:
+            raise SystemExit("InfluxDB %s: %s" % (e.code, e.read().decode().strip()))
+
+    def write(self, bucket, lines):
+        self.request("/api/v2/write", {"bucket": bucket, "precision": "s"},
+                     "\n".join(lines), "text/plain; charset=utf-8")
+
+    def query(self, flux):
+        return self.request("/api/v2/query", {}, flux, "application/vnd.flux")
+
+
+def rfc3339(ts):
+    return datetime.datetime.fromtimestamp(ts, datetime.timezone.utc).strftime("%Y-%m-%dT%H:%M:%SZ")
+
+
+def csv_rows(text):
+    """Строки данных в ответе /api/v2/query (без заголовков таблиц)"""
+    return [line for line in text.splitlines()
+            if line and "result,table" not in line and not line.startswith("#")]
+
+
+def load_dashboard():
+    with open(DASHBOARD, encoding="utf-8") as f:
+        dashboard = json.load(f)
+    panel = next(p for p in dashboard["panels"] if p["id"] == HISTORY_PANEL_ID)
+    variable = next(v for v in dashboard["templating"]["list"] if v["name"] == "bucket")
+    return panel["targets"][0]["query"], variable["query"]
+
+
+def substitute(flux, start, stop, device="", bucket="", window=None):
+    """Подстановки Grafana: макросы v.* и переменные дашборда"""
+    flux = flux.replace("v.timeRangeStart", "time(v: \"%s\")" % rfc3339(start))
+    flux = flux.replace("v.timeRangeStop", "time(v: \"%s\")" % rfc3339(stop))
+    if window is not None:
+        flux = flux.replace("v.windowPeriod", "%ds" % window)
+    return flux.replace("${device}", device).replace("${bucket}", bucket)
+
+
+def seed(influx, args):
+    """Синтетическая история с шагом 1 с: суточный ход напряжения и шум"""
+    stop = int(time.time())
+    start = stop - args.days * 86400
+    rng = random.Random(1)
+    lines = []
+    written = 0
+    began = time.monotonic()
+    for ts in range(start, stop):
+        daily = 5.0 * math.sin(2 * math.pi * (ts % 86400) / 86400)
+        phases = [230.0 + daily + offset + rng.gauss(0, 0.8) for offset in (0.0, -1.5, 1.0)]
+        for name, value in zip("ABC", phases):
+            lines.append("voltage,device=%s,phase=%s value=%.2f %d" % (args.device, name, value, ts))
+        for name, (a, b) in zip(("AB", "BC", "CA"), ((0, 1), (1, 2), (2, 0))):
+            lines.append("line_voltage,device=%s,phases=%s value=%.2f %d"
+                         % (args.device, name, math.sqrt(3) * (phases[a] + phases[b]) / 2, ts))
+        lines.append("frequency,device=%s value=%.3f %d" % (args.device, 50.0 + rng.gauss(0, 0.02), ts))
+        avg = sum(phases) / 3
+        unbalance = max(abs(v - avg) for v in phases) / avg * 100
+        lines.append("unbalance,device=%s value=%.2f %d" % (args.device, unbalance, ts))
+        if len(lines) >= WRITE_BATCH:
+            influx.write(RAW_BUCKET, lines)
+            written += len(lines)
+            lines = []
+            if written % (WRITE_BATCH * 200) == 0:
+                print("  %d points, %s" % (written, rfc3339(ts)))
+    if lines:
+        influx.write(RAW_BUCKET, lines)
+        written += len(lines)
+    print("Seeded %d points (%d days, device %s) in %.1f s"
+          % (written, args.days, args.device, time.monotonic() - began))
+
+
+def task_flux(name, start, stop):
+    """Задача прореживания как обычный запрос за [start, stop)"""
+    with open(os.path.join(TASKS_DIR, name), encoding="utf-8") as f:
+        flux = f.read()
+    flux = re.sub(r"^option task = .*$", "", flux, flags=re.M)
+    flux = re.sub(r"^windowStart = .*$", "windowStart = time(v: \"%s\")" % rfc3339(start), flux, flags=re.M)
+    return re.sub(r"^windowStop = .*$", "windowStop = time(v: \"%s\")" % rfc3339(stop), flux, flags=re.M)
+
+
+def backfill(influx, args):
+    """Агрегаты за прошедшие сутки: сначала поминутные, затем часовые из них"""
+    stop = int(time.time()) // 3600 * 3600
+    start = stop - args.days * 86400
+    for name in ("downsample_1m.flux", "downsample_1h.flux"):
+        began = time.monotonic()
+        for day in range(start, stop, 86400):
+            influx.query(task_flux(name, day, min(day + 86400, stop)))
+        print("Backfilled %s over %d days in %.1f s" % (name, args.days, time.monotonic() - began))
+
+
+def measure(influx, args):
+    history, choose = load_dashboard()
+    stop = int(time.time())
+    print("%-5s %-22s %10s %10s %8s   %10s %10s %8s  %7s"
+          % ("range", "bucket", "raw p50", "raw p95", "rows", "p50", "p95", "rows", "speedup"))
+    for label, span in RANGES:
+        start = stop - span
+        bucket = csv_rows(influx.query(substitute(choose, start, stop)))[0].split(",")[-1]
+        window = max(1, span // MAX_DATA_POINTS)
+        results = []
+        for target in (RAW_BUCKET, bucket):
+            flux = substitute(history, start, stop, args.device, target, window)
+            times = []
+            for _ in range(args.runs):
+                began = time.monotonic()
+                rows = len(csv_rows(influx.query(flux)))
+                times.append((time.monotonic() - began) * 1000)
+            p95 = sorted(times)[max(0, math.ceil(len(times) * 0.95) - 1)]
+            results.append((statistics.median(times), p95, rows))
+        (raw50, raw95, raw_rows), (sel50, sel95, sel_rows) = results
+        print("%-5s %-22s %8.0f ms %7.0f ms %8d   %7.0f ms %7.0f ms %8d  %6.1fx"
+              % (label, bucket, raw50, raw95, raw_rows, sel50, sel95, sel_rows, raw50 / max(sel50, 0.1)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Задержка запросов истории: сырые данные и агрегаты")
+    parser.add_argument("--url", default="http://localhost:8086")
+    parser.add_argument("--org", default="home")
+    parser.add_argument("--token", default=os.environ.get("INFLUX_TOKEN", "my-super-secret-token"))
+    parser.add_argument("--device", default="bench-001", help="Тег device синтетических данных")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("seed", help="Записать синтетическую историю с шагом 1 с")
+    p.add_argument("--days", type=int, default=7, help="Суток истории (сырой bucket хранит 30)")
+    p = sub.add_parser("backfill", help="Посчитать агрегаты за прошедшие сутки")
+    p.add_argument("--days", type=int, default=7)
+    p = sub.add_parser("measure", help="Сравнить задержку запросов")
+    p.add_argument("--runs", type=int, default=5, help="Повторов каждого запроса")
+
+    args = parser.parse_args()
+    influx = Influx(args.url, args.org, args.token)
+    {"seed": seed, "backfill": backfill, "measure": measure}[args.command](influx, args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+Подписчик для проверки MQTT-транспорта на локальном mosquitto.
+
+Декодирует бинарные записи TelemetryCodec (firmware/src/TelemetryCodec.h)
+и раз в 10 секунд печатает скорость приёма и пропуски по номеру записи.
+
+    pip install paho-mqtt
+    python3 tools/mqtt_monitor.py --host localhost
+"""
+
+import argparse
+import struct
+import time
+
+import paho.mqtt.client as mqtt
+
+HEADER = struct.Struct("<BBHIII")          # RecordHeader, 16 байт
+POWER = struct.Struct("<3H3H4HHBB")        # PowerRecord, 24 байта
+EVENT = struct.Struct("<BBBB3HH")          # EventRecord, 12 байт
+WAVEFORM = struct.Struct("<HH")            # WaveformRecordHeader
+
+RECORD_POWER, RECORD_EVENT, RECORD_WAVEFORM = 1, 2, 3
+FLAG_NAMES = ["LOW_V", "HIGH_V", "UNBALANCE", "FREQ_DEV"]
+
+
+def flags_str(mask):
+    names = [name for bit, name in enumerate(FLAG_NAMES) if mask & (1 << bit)]
+    return " ".join(names) if names else "-"
+
+
+class Monitor:
+    def __init__(self, verbose):
+        self.verbose = verbose
+        self.devices = {}
+        self.window_start = time.monotonic()
+
+    def on_message(self, client, userdata, msg):
+        parts = msg.topic.split("/")
+        if len(parts) != 3:
+            return
+        _, device, kind = parts
+        if kind == "status":
+            print(f"[{device}] status: {msg.payload.decode(errors='replace')}")
+            return
+
+        payload = msg.payload
+        if len(payload) < HEADER.size:
+            print(f"[{device}] short record ({len(payload)} bytes)")
+            return
+
+        rtype, version, length, seq, unix_time, uptime_ms = HEADER.unpack_from(payload)
+        stats = self.devices.setdefault(device, {"count": 0, "bytes": 0, "gaps": 0, "last_seq": None})
+        if stats["last_seq"] is not None and seq > stats["last_seq"] + 1:
+            stats["gaps"] += seq - stats["last_seq"] - 1
+        stats["last_seq"] = seq
+        stats["count"] += 1
+        stats["bytes"] += len(payload)
+
+        body = payload[HEADER.size:HEADER.size + length]
+        if rtype == RECORD_POWER and self.verbose:
+            v = POWER.unpack(body)
+            print(f"[{device}] #{seq} U={v[0]/100:.1f}/{v[1]/100:.1f}/{v[2]/100:.1f} V "
+                  f"f={v[9]/1000:.3f} Hz unb={v[10]/100:.2f}% flags={flags_str(v[11])}")
+        elif rtype == RECORD_EVENT:
+            flags, raised, cleared, _, ua, ub, uc, freq = EVENT.unpack(body)
+            print(f"[{device}] EVENT #{seq} raised={flags_str(raised)} cleared={flags_str(cleared)} "
+                  f"U={ua/100:.1f}/{ub/100:.1f}/{uc/100:.1f} V f={freq/1000:.3f} Hz")
+        elif rtype == RECORD_WAVEFORM and self.verbose:
+            samples, interval_us = WAVEFORM.unpack_from(body)
+            print(f"[{device}] waveform #{seq}: {samples} samples x3 @ {interval_us} us")
+
+    def report(self):
+        now = time.monotonic()
+        elapsed = now - self.window_start
+        if elapsed < 10:
+            return
+        for device, stats in self.devices.items():
+            print(f"[{device}] {stats['count'] / elapsed:.2f} msg/s, {stats['bytes'] / elapsed:.0f} B/s, "
+                  f"gaps={stats['gaps']}")
+            stats["count"] = stats["bytes"] = 0
+        self.window_start = now
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="localhost")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--prefix", default="power")
+    parser.add_argument("-v", "--verbose", action="store_true", help="печатать каждую запись")
+    args = parser.parse_args()
+
+    monitor = Monitor(args.verbose)
+    client = mqtt.Client()
+    client.on_message = monitor.on_message
+    client.connect(args.host, args.port)
+    client.subscribe(f"{args.prefix}/+/+", qos=1)
+
+    client.loop_start()
+    try:
+        while True:
+            time.sleep(1)
+            monitor.report()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        client.loop_stop()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+"""
+Приёмник синхрофазоров устройств в режиме PMU (кадры IEEE C37.118.2-2011 по UDP).
+
+Разбирает CFG-2 и кадры данных (FORMAT 0: векторы int16 в прямоугольных
+координатах, частота и ROCOF int16) и печатает по строке на отчёт: амплитуды и
+углы каналов, частоту, ROCOF, качество времени. Если поток шлют несколько
+устройств (разные PMU_IDCODE), для отчётов с одной меткой времени печатается
+разность углов прямой последовательности относительно первого IDCODE — так
+видно, насколько осмысленно сравнение при синхронизации по NTP.
+
+    curl -X POST "http://<ip-устройства>/pmu?rate=50"
+    python3 tools/pmu_receiver.py --port 4713
+    python3 tools/pmu_receiver.py --port 4713 --every 50     # строка раз в секунду
+
+Пока CFG-2 устройства не получен (первый кадр после запуска и далее раз в
+PMU_CONFIG_INTERVAL_S), его кадры данных пропускаются.
+"""
+
+import argparse
+import math
+import socket
+import struct
+import time
+
+SYNC_DATA = 0xAA01
+SYNC_CONFIG2 = 0xAA31
+NAME_LEN = 16
+STAT_NOT_SYNCED = 0x2000
+
+
+def crc_ccitt(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def check_frame(data):
+    if len(data) < 18:
+        return None
+    sync, size = struct.unpack_from(">HH", data, 0)
+    if size != len(data) or crc_ccitt(data[:-2]) != struct.unpack_from(">H", data, size - 2)[0]:
+        return None
+    return sync
+
+
+def decode_config(data):
+    time_base, num_pmu = struct.unpack_from(">IH", data, 14)
+    if num_pmu != 1:
+        return None
+    station = data[20:20 + NAME_LEN].decode("ascii", "replace").rstrip()
+    idcode, fmt, phnmr, annmr, dgnmr = struct.unpack_from(">HHHHH", data, 36)
+    if fmt != 0 or annmr != 0 or dgnmr != 0:
+        return None
+    offset = 46
+    names = []
+    for _ in range(phnmr):
+        names.append(data[offset:offset + NAME_LEN].decode("ascii", "replace").rstrip())
+        offset += NAME_LEN
+    units = [struct.unpack_from(">I", data, offset + 4 * i)[0] & 0xFFFFFF for i in range(phnmr)]
+    offset += 4 * phnmr
+    fnom, cfgcnt, rate = struct.unpack_from(">HHh", data, offset)
+    return {
+        "idcode": idcode,
+        "station": station,
+        "time_base": time_base,
+        "names": names,
+        "units": units,
+        "nominal": 50.0 if fnom & 1 else 60.0,
+        "cfgcnt": cfgcnt,
+        "rate": rate,
+    }
+
+
+def decode_data(data, config):
+    if len(data) != 22 + 4 * len(config["names"]):
+        return None
+    soc, fracsec, stat = struct.unpack_from(">IIH", data, 6)
+    phasors = []
+    offset = 16
+    for unit in config["units"]:
+        re, im = struct.unpack_from(">hh", data, offset)
+        offset += 4
+        scale = unit * 1e-5
+        phasors.append((math.hypot(re, im) * scale, math.degrees(math.atan2(im, re))))
+    dfreq, drocof = struct.unpack_from(">hh", data, offset)
+    return {
+        "time": soc + (fracsec & 0xFFFFFF) / config["time_base"],
+        "tq": (fracsec >> 24) & 0x0F,
+        "stat": stat,
+        "phasors": phasors,
+        "frequency": config["nominal"] + dfreq / 1000.0,
+        "rocof": drocof / 100.0,
+    }
+
+
+def wrap_degrees(angle):
+    return (angle + 180.0) % 360.0 - 180.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="C37.118 synchrophasor receiver")
+    parser.add_argument("--port", type=int, default=4713)
+    parser.add_argument("--every", type=int, default=1, help="print every N-th report per device")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", args.port))
+    print("Listening on UDP %d" % args.port)
+
+    configs = {}
+    counts = {}
+    latest = {}             # idcode -> (время отчёта, угол прямой последовательности)
+    bad = 0
+    while True:
+        data, address = sock.recvfrom(2048)
+        sync = check_frame(data)
+        if sync is None:
+            bad += 1
+            print("%s: bad frame (%d bytes, %d total)" % (address[0], len(data), bad))
+            continue
+        idcode = struct.unpack_from(">H", data, 4)[0]
+
+        if sync == SYNC_CONFIG2:
+            config = decode_config(data)
+            if config is None:
+                print("%s: unsupported CFG-2" % address[0])
+                continue
+            if configs.get(idcode, {}).get("cfgcnt") != config["cfgcnt"]:
+                print("%s: CFG-2 id=%d '%s' %s, %d fps, f0 %.0f Hz" % (
+                    address[0], idcode, config["station"], ",".join(config["names"]),
+                    config["rate"], config["nominal"]))
+            configs[idcode] = config
+            continue
+
+        if sync != SYNC_DATA or idcode not in configs:
+            continue
+        config = configs[idcode]
+        frame = decode_data(data, config)
+        if frame is None:
+            print("%s: data frame does not match CFG-2" % address[0])
+            continue
+
+        # Прямая последовательность — последний вектор при трёх фазах, иначе первый
+        positive = frame["phasors"][-1] if len(frame["phasors"]) == 4 else frame["phasors"][0]
+        latest[idcode] = (frame["time"], positive[1])
+        counts[idcode] = counts.get(idcode, 0) + 1
+        if counts[idcode] % args.every != 0:
+            continue
+
+        line = "id=%d %s.%06d" % (idcode, time.strftime("%H:%M:%S", time.gmtime(int(frame["time"]))),
+                                  round((frame["time"] % 1) * 1e6))
+        for name, (magnitude, angle) in zip(config["names"], frame["phasors"]):
+            line += "  %s %6.1f V %7.2f°" % (name, magnitude, angle)
+        line += "  f %.3f Hz  ROCOF %+.2f Hz/s  TQ %X" % (frame["frequency"], frame["rocof"], frame["tq"])
+        if frame["stat"] & STAT_NOT_SYNCED:
+            line += "  NOT SYNCED"
+
+        reference = min(latest)
+        if reference != idcode and abs(latest[reference][0] - frame["time"]) < 1e-6:
+            line += "  Δφ(id=%d) %+.2f°" % (reference, wrap_degrees(positive[1] - latest[reference][1]))
+        print(line)
+
+
+if __name__ == "__main__":
+    main()